@@ -124,10 +124,12 @@ public class ColorTuningPreference extends DialogPreference {
         for (String filePath : FILE_PATH) {
             int value = sharedPrefs.getInt(filePath, MAX_VALUE);
             Utils.writeColor(filePath, value);
+            Utils.persistValue(filePath, Utils.colorValue(value));
         }
         for (String filePath : GAMMA_FILE_PATH) {
             int value = sharedPrefs.getInt(filePath, GAMMA_DEFAULT_VALUE);
             Utils.writeColor(filePath, value);
+            Utils.persistValue(filePath, Utils.colorValue(value));
         }
     }
 
@@ -185,6 +187,7 @@ public class ColorTuningPreference extends DialogPreference {
             Editor editor = getEditor();
             editor.putInt(mFilePath, mSeekBar.getProgress());
             editor.commit();
+            Utils.persistValue(mFilePath, Utils.colorValue(mSeekBar.getProgress()));
         }
 
         @Override
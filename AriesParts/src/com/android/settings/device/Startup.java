@@ -8,9 +8,14 @@ public class Startup extends BroadcastReceiver {
 
     @Override
     public void onReceive(final Context context, final Intent bootintent) {
-        ColorTuningPreference.restore(context);
-        Mdnie.restore(context);
-        TouchKeyBacklightTimeout.restore(context);
+        // aries_restore applied the sysfs settings before the framework started,
+        // unless they are still to be migrated from the preferences
+        if (!Utils.isPersisted()) {
+            ColorTuningPreference.restore(context);
+            Mdnie.restore(context);
+            TouchKeyBacklightTimeout.restore(context);
+        }
+        // goes through SamsungServiceMode, it needs the framework
         Hspa.restore(context);
     }
 
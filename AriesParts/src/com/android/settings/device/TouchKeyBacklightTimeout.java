@@ -24,12 +24,15 @@ public class TouchKeyBacklightTimeout implements OnPreferenceChangeListener {
         }
 
         SharedPreferences sharedPrefs = PreferenceManager.getDefaultSharedPreferences(context);
-        Utils.writeValue(FILE, sharedPrefs.getString(DeviceSettings.KEY_BACKLIGHT_TIMEOUT, "1600"));
+        String value = sharedPrefs.getString(DeviceSettings.KEY_BACKLIGHT_TIMEOUT, "1600");
+        Utils.writeValue(FILE, value);
+        Utils.persistValue(FILE, value);
     }
 
     @Override
     public boolean onPreferenceChange(Preference preference, Object newValue) {
         Utils.writeValue(FILE, (String) newValue);
+        Utils.persistValue(FILE, (String) newValue);
         return true;
     }
 
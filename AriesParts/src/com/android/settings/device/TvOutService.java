@@ -25,6 +25,9 @@ public class TvOutService extends Service {
     public static final String COMMAND_DISABLE = "disable";
     public static final String COMMAND_CHANGE_SYSTEM = "system";
 
+    // Read by the hdmi hal, it only drives the tv while this is set
+    private static final String PROP_TVOUT_ENABLE = "sys.tvout.enable";
+
     private TvOut mTvOut;
     private SharedPreferences mPref;
     private int mSystem;
@@ -131,6 +134,7 @@ public class TvOutService extends Service {
 
         mTvOut._EnableTvOut();
         mTvOut._setTvoutCableConnected(1);
+        SystemProperties.set(PROP_TVOUT_ENABLE, "1");
 
         // Start tvouthack service used to bombard screen refresh messages
         SystemProperties.set("ctl.start", "tvouthack");
@@ -138,6 +142,7 @@ public class TvOutService extends Service {
 
     private void disable() {
         SystemProperties.set("ctl.stop", "tvouthack");
+        SystemProperties.set(PROP_TVOUT_ENABLE, "0");
 
         mTvOut._DisableTvOut();
         mTvOut._setTvoutCableConnected(0);
@@ -1,13 +1,22 @@
 package com.android.settings.device;
 
+import java.io.BufferedReader;
 import java.io.File;
 import java.io.FileNotFoundException;
 import java.io.FileOutputStream;
 import java.io.FileInputStream;
+import java.io.FileReader;
 import java.io.IOException;
+import java.util.LinkedHashMap;
+import java.util.Map;
 
 public class Utils {
 
+    /**
+     * The values aries_restore writes back at boot, "<path> <value>" lines.
+     */
+    private static final String RESTORE_FILE = "/data/system/ariesparts.conf";
+
     /**
      * Read a string value to the specified file.
      * @param filename      The filename
@@ -49,6 +58,59 @@ public class Utils {
         }
     }
 
+    /**
+     * Record the value of the specified file for aries_restore, which writes it
+     * back from init before the framework starts.
+     * @param filename      The filename
+     * @param value         The value
+     */
+    public static synchronized void persistValue(String filename, String value) {
+        Map<String, String> values = new LinkedHashMap<String, String>();
+        try {
+            BufferedReader reader = new BufferedReader(new FileReader(RESTORE_FILE));
+            String line;
+            while ((line = reader.readLine()) != null) {
+                int sep = line.indexOf(' ');
+                if (sep > 0) {
+                    values.put(line.substring(0, sep), line.substring(sep + 1));
+                }
+            }
+            reader.close();
+        } catch (FileNotFoundException e) {
+            // first value persisted
+        } catch (IOException e) {
+            e.printStackTrace();
+        }
+        values.put(filename, value);
+
+        StringBuilder content = new StringBuilder();
+        for (Map.Entry<String, String> entry : values.entrySet()) {
+            content.append(entry.getKey()).append(' ').append(entry.getValue()).append('\n');
+        }
+        // aries_restore never sees half a file
+        File tmp = new File(RESTORE_FILE + ".tmp");
+        try {
+            FileOutputStream fos = new FileOutputStream(tmp);
+            fos.write(content.toString().getBytes());
+            fos.getFD().sync();
+            fos.close();
+            if (!tmp.renameTo(new File(RESTORE_FILE))) {
+                tmp.delete();
+            }
+        } catch (IOException e) {
+            e.printStackTrace();
+        }
+    }
+
+    /**
+     * Check whether aries_restore has values to restore, it has none until the
+     * preferences of an older version were migrated.
+     * @return              Whether the values are persisted
+     */
+    public static boolean isPersisted() {
+        return fileExists(RESTORE_FILE);
+    }
+
     /**
      * Write the "color value" to the specified file. The value is scaled from
      * an integer to an unsigned integer by multiplying by 2.
@@ -56,7 +118,16 @@ public class Utils {
      * @param value         The value of max value Integer.MAX
      */
     public static void writeColor(String filename, int value) {
-        writeValue(filename, String.valueOf((long) value * 2));
+        writeValue(filename, colorValue(value));
+    }
+
+    /**
+     * The string writeColor() writes for the value.
+     * @param value         The value of max value Integer.MAX
+     * @return              The scaled value
+     */
+    public static String colorValue(int value) {
+        return String.valueOf((long) value * 2);
     }
 
     /**
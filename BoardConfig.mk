@@ -65,6 +65,14 @@ BOARD_V4L2_DEVICE := /dev/video1
 BOARD_CAMERA_DEVICE := /dev/video0
 BOARD_SECOND_CAMERA_DEVICE := /dev/video2
 
+# MFC stream buffers the OMX video decoders keep in flight, 2 is the old
+# decode/convert overlap
+BOARD_MFC_INPUT_BUFFER_NUM := 4
+# run the codec colour conversions on the FIMC when it is free, CPU/GPU otherwise
+BOARD_USE_OMX_FIMC_CSC := true
+# hand the decoded NV12T pictures to the hwcomposer by address, no conversion
+BOARD_USE_OMX_ANB_ZERO_COPY := true
+
 # FM Radio
 #BOARD_HAVE_FM_RADIO := true
 #BOARD_FM_DEVICE := si4709
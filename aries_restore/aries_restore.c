@@ -0,0 +1,143 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "aries_restore"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <cutils/log.h>
+
+/* "<path> <value>" lines, kept by AriesParts' Utils.persistValue() */
+#define SETTINGS_PATH "/data/system/ariesparts.conf"
+
+#define MAX_LINE    256
+#define MAX_VALUE   64
+
+/* Writes the device settings AriesParts persisted back to the kernel, once
+ * from init at post-fs-data before the framework starts. A node that already
+ * holds the value is left alone, so a setting at its kernel default costs a
+ * read. Only the nodes AriesParts owns are written, whatever the file says.
+ */
+static const char *nodes[] = {
+    "/sys/class/mdnieset_ui/switch_mdnieset_ui/mdnieset_ui_file_cmd",
+    "/sys/class/misc/notification/bl_timeout",
+    "/sys/devices/virtual/misc/color_tuning/red_multiplier",
+    "/sys/devices/virtual/misc/color_tuning/green_multiplier",
+    "/sys/devices/virtual/misc/color_tuning/blue_multiplier",
+    "/sys/devices/virtual/misc/color_tuning/red_v1_offset",
+    "/sys/devices/virtual/misc/color_tuning/green_v1_offset",
+    "/sys/devices/virtual/misc/color_tuning/blue_v1_offset",
+};
+
+static int is_node(const char *path)
+{
+    size_t i;
+
+    for (i = 0; i < sizeof(nodes) / sizeof(nodes[0]); i++) {
+        if (!strcmp(nodes[i], path))
+            return 1;
+    }
+    return 0;
+}
+
+static void strip(char *s)
+{
+    size_t len = strlen(s);
+
+    while (len > 0 && (s[len - 1] == '\n' || s[len - 1] == '\r' ||
+                       s[len - 1] == ' ' || s[len - 1] == '\t'))
+        s[--len] = '\0';
+}
+
+/* 0 written, 1 already set, -1 on error */
+static int restore(const char *path, const char *value)
+{
+    char current[MAX_VALUE];
+    ssize_t count;
+    int fd;
+
+    fd = open(path, O_RDWR);
+    if (fd < 0) {
+        /* not in this kernel, AriesParts hides the setting as well */
+        if (errno != ENOENT)
+            ALOGE("Can't open %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    count = read(fd, current, sizeof(current) - 1);
+    if (count > 0) {
+        current[count] = '\0';
+        strip(current);
+        if (!strcmp(current, value)) {
+            close(fd);
+            return 1;
+        }
+    }
+
+    if (write(fd, value, strlen(value)) < 0) {
+        ALOGE("Can't write %s to %s: %s\n", value, path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    close(fd);
+    return 0;
+}
+
+int main() {
+    char line[MAX_LINE];
+    int written = 0;
+    int skipped = 0;
+    FILE *f;
+
+    f = fopen(SETTINGS_PATH, "r");
+    if (f == NULL) {
+        /* nothing changed yet, or AriesParts has still to migrate its
+         * preferences on the first boot completed */
+        ALOGI("No %s, nothing to restore\n", SETTINGS_PATH);
+        return 0;
+    }
+
+    while (fgets(line, sizeof(line), f) != NULL) {
+        char *value;
+
+        strip(line);
+        value = strchr(line, ' ');
+        if (value == NULL || value[1] == '\0')
+            continue;
+        *value++ = '\0';
+        if (!is_node(line) || strlen(value) >= MAX_VALUE) {
+            ALOGW("Ignoring %s\n", line);
+            continue;
+        }
+
+        switch (restore(line, value)) {
+        case 0:
+            written++;
+            break;
+        case 1:
+            skipped++;
+            break;
+        }
+    }
+    fclose(f);
+
+    ALOGI("Restored %d settings, %d already set\n", written, skipped);
+    return 0;
+}
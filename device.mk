@@ -113,6 +113,10 @@ PRODUCT_PACKAGES += \
 PRODUCT_PACKAGES += \
     bdaddr_read
 
+# AriesParts settings restored at boot
+PRODUCT_PACKAGES += \
+    aries_restore
+
 # charger
 PRODUCT_PACKAGES += \
     charger \
@@ -140,6 +144,8 @@ PRODUCT_PACKAGES += \
 # Board modules
 PRODUCT_PACKAGES += \
     lights.s5pc110 \
+    libfimc \
+    libsecmem \
     hwcomposer.s5pc110 \
 
 ifeq ($(BOARD_HAVE_HDMI),true)
@@ -19,6 +19,8 @@
 
 #include <linux/videodev2.h>
 
+#include <sec_v4l2.h>
+
 /*
  * G E N E R A L S
  *
@@ -156,6 +158,15 @@ typedef struct _s5p_fimc_t {
 
     int                 use_ext_out_mem;
     unsigned int        hw_ver;
+
+    /* configuration last written to the driver, zero when unknown */
+    int                 applied_valid;
+    s5p_fimc_params_t   applied;
+    int                 applied_rotation;
+    int                 applied_h_flip;
+    int                 applied_v_flip;
+    /* other users of the node, in this process or not */
+    struct sec_v4l2_gen gen;
 } s5p_fimc_t;
 
 #endif
@@ -104,6 +104,12 @@ struct v4l2_pix_format_s5p_tvout {
     struct v4l2_pix_format  pix_fmt;
 };
 
+/* VIDIOC_S_BASEADDR, the video layer takes the new addresses at vsync */
+struct s5p_tv_buf_src {
+    void *base_y;
+    void *base_c;
+};
+
 struct vid_overlay_param {
     struct v4l2_vid_overlay_src     src;
     struct v4l2_rect                src_crop;
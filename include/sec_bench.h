@@ -0,0 +1,53 @@
+/*
+ * Copyright@ Samsung Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+#ifndef __SEC_BENCH_H__
+#define __SEC_BENCH_H__
+
+//---------------------------------------------------------//
+// Output of the benchmark tools
+//
+// Progress and errors go to stderr, tagged with the LOG_TAG of
+// the tool. stdout only carries the results, one line each:
+//
+//   RESULT <config> <metric> <value> <unit>
+//
+// so two builds can be compared with a diff or a script.
+//---------------------------------------------------------//
+
+#include <stdio.h>
+
+#ifndef LOG_TAG
+#define LOG_TAG "sec-bench"
+#endif
+
+#define LOGI(fmt, ...)                  \
+    do {                                \
+        fprintf(stderr, LOG_TAG "/I: " fmt "\n", ##__VA_ARGS__); \
+    } while (0)
+
+#define LOGE(fmt, ...)                  \
+    do {                                \
+        fprintf(stderr, LOG_TAG "/E: " fmt "\n", ##__VA_ARGS__); \
+    } while (0)
+
+#define RESULT(config, metric, value, unit)     \
+    do {                                        \
+        printf("RESULT %s %s %.2f %s\n", config, metric, (double)(value), unit); \
+        fflush(stdout);                         \
+    } while (0)
+
+#endif // __SEC_BENCH_H__
@@ -0,0 +1,141 @@
+/*
+ * Copyright@ Samsung Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+#ifndef __SEC_LATENCY_H__
+#define __SEC_LATENCY_H__
+
+//---------------------------------------------------------//
+// Capture to display latency probe
+//
+// With debug.sec.latency set to 1 when the camera, the codec
+// or the hwcomposer is opened, every camera frame gets a stamp
+// with its number and its V4L2 capture time on CLOCK_MONOTONIC,
+// the one clock all the processes share. A stage that sees the
+// stamp adds now - capture to its own histogram:
+//
+//  - the camera at dequeue, after the preview went to the
+//    window and after the record frame went to the client
+//  - the encoder when a frame comes in and goes out, the
+//    decoder when its picture goes out
+//  - the hwcomposer when an overlay window pans to it, the
+//    frame shows at the vsync after
+//
+// Where the stamp travels:
+//
+//  - preview: over the first 16 luma pixels of the window
+//    buffer, the probe does mark the picture
+//  - record: in the metadata buffer behind the frame size, at
+//    SEC_LATENCY_METADATA_OFFSET
+//  - through the codecs as the OMX buffer timestamp, which the
+//    encoder gets from the camera as capture time minus the
+//    start of the recording. the encoder publishes that
+//    difference, a decoder of the same media server fed the
+//    same timestamps in a loopback gets the capture time back
+//  - out of a decoder into the display: behind the addresses
+//    of a native buffer that holds them instead of the picture
+//
+// A stage logs or dumps its histogram the way it does its
+// other statistics.
+//---------------------------------------------------------//
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <cutils/properties.h>
+
+#define SEC_LATENCY_PROPERTY            "debug.sec.latency"
+// capture time minus OMX timestamp, in us, of the recording last started.
+// the encoders and decoders are libraries of their own, each with its own
+// copy of the OMX common code, and the media server may not set debug
+// properties: the environment is what the process has to share it
+#define SEC_LATENCY_BASE_ENV            "SEC_LATENCY_BASE_US"
+
+#define SEC_LATENCY_MAGIC               (0x3154414cU)   // "LAT1"
+// a stage that knows the capture time but not the camera's frame number
+#define SEC_LATENCY_FRAME_UNKNOWN       (0xffffffffU)
+
+// in the camera's record metadata, after type, two addresses, index,
+// reserved, width, height and a pad word
+#define SEC_LATENCY_METADATA_OFFSET     (32)
+
+// 16 bytes, the same on every side of a process boundary
+struct sec_latency_stamp {
+    int64_t     capture_ns;     // CLOCK_MONOTONIC
+    uint32_t    magic;
+    uint32_t    frame;
+};
+
+static inline int sec_latency_enabled(void)
+{
+    char value[PROPERTY_VALUE_MAX];
+
+    property_get(SEC_LATENCY_PROPERTY, value, "0");
+    return atoi(value) != 0;
+}
+
+static inline int64_t sec_latency_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static inline void sec_latency_stamp_set(struct sec_latency_stamp *stamp,
+                                         uint32_t frame, int64_t capture_ns)
+{
+    stamp->capture_ns = capture_ns;
+    stamp->magic = SEC_LATENCY_MAGIC;
+    stamp->frame = frame;
+}
+
+// once per recording, a reader racing it may see the base before
+static inline void sec_latency_base_publish(int64_t base_us)
+{
+    char value[32];
+
+    snprintf(value, sizeof(value), "%lld", (long long)base_us);
+    setenv(SEC_LATENCY_BASE_ENV, value, 1);
+}
+
+// 0 while no encoder published one
+static inline int64_t sec_latency_base_get(void)
+{
+    const char *value = getenv(SEC_LATENCY_BASE_ENV);
+
+    return value ? strtoll(value, NULL, 10) : 0;
+}
+
+// dst may be pixels or a buffer of another process, no alignment assumed
+static inline void sec_latency_stamp_write(void *dst, const struct sec_latency_stamp *stamp)
+{
+    memcpy(dst, stamp, sizeof(*stamp));
+}
+
+// 0 when src holds a stamp, -1 when it holds anything else
+static inline int sec_latency_stamp_read(const void *src, struct sec_latency_stamp *stamp)
+{
+    memcpy(stamp, src, sizeof(*stamp));
+    if (stamp->magic != SEC_LATENCY_MAGIC || stamp->capture_ns <= 0)
+        return -1;
+
+    return 0;
+}
+
+#endif // __SEC_LATENCY_H__
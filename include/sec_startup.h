@@ -0,0 +1,104 @@
+/*
+ * Copyright@ Samsung Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+#ifndef __SEC_STARTUP_H__
+#define __SEC_STARTUP_H__
+
+//---------------------------------------------------------//
+// Open time of the HALs
+//
+// The open of a HAL is timed as a row of phases, each one ended
+// by sec_startup_phase() with its name. sec_startup_end() logs
+// a single line under the SecStartup tag, whatever the tag of
+// the HAL, with every phase, the total and the uptime the open
+// ended at:
+//
+//   adb logcat -s SecStartup
+//
+// Nothing is allocated, a struct sec_startup on the stack of
+// the open function does.
+//---------------------------------------------------------//
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <android/log.h>
+
+#define SEC_STARTUP_LOG_TAG     "SecStartup"
+#define SEC_STARTUP_MAX_PHASES  8
+
+struct sec_startup {
+    const char *hal;
+    int64_t     start_ns;
+    int64_t     last_ns;
+    int         count;
+    const char *phase[SEC_STARTUP_MAX_PHASES];
+    int64_t     phase_ns[SEC_STARTUP_MAX_PHASES];
+};
+
+static inline int64_t sec_startup_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static inline void sec_startup_begin(struct sec_startup *s, const char *hal)
+{
+    s->hal = hal;
+    s->start_ns = sec_startup_now();
+    s->last_ns = s->start_ns;
+    s->count = 0;
+}
+
+// the phases past the last slot are added to it
+static inline void sec_startup_phase(struct sec_startup *s, const char *phase)
+{
+    int64_t now = sec_startup_now();
+    int i = s->count;
+
+    if (i < SEC_STARTUP_MAX_PHASES) {
+        s->phase[i] = phase;
+        s->phase_ns[i] = 0;
+        s->count++;
+    } else {
+        i = SEC_STARTUP_MAX_PHASES - 1;
+    }
+    s->phase_ns[i] += now - s->last_ns;
+    s->last_ns = now;
+}
+
+// ret is what the open returns, a failed one is logged as such
+static inline void sec_startup_end(struct sec_startup *s, int ret)
+{
+    char line[256];
+    int64_t now = sec_startup_now();
+    int len;
+    int i;
+
+    len = snprintf(line, sizeof(line), "%s: %s %.1fms at %.3fs:",
+                   s->hal, (ret < 0) ? "failed" : "opened",
+                   (now - s->start_ns) / 1e6, now / 1e9);
+    for (i = 0; i < s->count && len > 0 && len < (int)sizeof(line); i++) {
+        len += snprintf(line + len, sizeof(line) - len, " %s %.1f",
+                        s->phase[i], s->phase_ns[i] / 1e6);
+    }
+
+    __android_log_write(ANDROID_LOG_INFO, SEC_STARTUP_LOG_TAG, line);
+}
+
+#endif // __SEC_STARTUP_H__
@@ -0,0 +1,81 @@
+/*
+ * Copyright@ Samsung Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+#ifndef __SEC_THREAD_H__
+#define __SEC_THREAD_H__
+
+//---------------------------------------------------------//
+// Scheduling roles for the threads the HALs start themselves
+//
+// A thread calls sec_thread_set_role() first thing with what it
+// works for. The role picks the same nice level and cgroup the
+// framework gives its own threads of that kind, so a HAL thread
+// competes with them on equal terms. Threads started through
+// android::Thread get this from run() and don't need it.
+//
+// There is no real time role: the servers the HALs run in don't
+// have CAP_SYS_NICE, SCHED_FIFO and SCHED_RR are not theirs to
+// take.
+//---------------------------------------------------------//
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include <cutils/sched_policy.h>
+#include <system/thread_defs.h>
+
+enum sec_thread_role {
+    SEC_THREAD_ROLE_DISPLAY = 0,    // feeds a vsync: composition, fimc display jobs
+    SEC_THREAD_ROLE_AUDIO,          // feeds the audio path
+    SEC_THREAD_ROLE_VIDEO,          // codec work a display or an encoder waits on
+    SEC_THREAD_ROLE_BACKGROUND,     // nobody waits on it
+};
+
+// 0 or -errno of the first step that failed, the thread runs on either way
+static inline int sec_thread_set_role(enum sec_thread_role role)
+{
+    SchedPolicy policy = SP_FOREGROUND;
+    int prio;
+    int ret;
+
+    switch (role) {
+    case SEC_THREAD_ROLE_DISPLAY:
+        prio = ANDROID_PRIORITY_URGENT_DISPLAY;
+        break;
+    case SEC_THREAD_ROLE_AUDIO:
+        prio = ANDROID_PRIORITY_AUDIO;
+        break;
+    case SEC_THREAD_ROLE_VIDEO:
+        prio = ANDROID_PRIORITY_DISPLAY;
+        break;
+    case SEC_THREAD_ROLE_BACKGROUND:
+    default:
+        prio = ANDROID_PRIORITY_BACKGROUND;
+        policy = SP_BACKGROUND;
+        break;
+    }
+
+    ret = set_sched_policy(gettid(), policy);
+
+    // per thread on linux, PRIO_PROCESS 0 is the calling thread
+    if (setpriority(PRIO_PROCESS, 0, prio) < 0 && ret == 0)
+        ret = -errno;
+
+    return ret;
+}
+
+#endif // __SEC_THREAD_H__
@@ -0,0 +1,51 @@
+/*
+ * Copyright@ Samsung Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+#ifndef __SEC_TRACE_H__
+#define __SEC_TRACE_H__
+
+//---------------------------------------------------------//
+// Systrace markers shared by the HALs
+//
+// Each module sets ATRACE_TAG to its category before this is
+// included: camera ATRACE_TAG_CAMERA, hwcomposer, hdmi and libfimc
+// ATRACE_TAG_GRAPHICS, omx ATRACE_TAG_VIDEO, audio
+// ATRACE_TAG_AUDIO. Slices and counters are named
+// "<module>:<stage>", counters carry the buffer index or the
+// depth of a queue so one frame can be followed from the
+// camera through the encoder to the display.
+//---------------------------------------------------------//
+
+#include <cutils/trace.h>
+
+#define SEC_TRACE_BEGIN(name)               atrace_begin(ATRACE_TAG, name)
+#define SEC_TRACE_END()                     atrace_end(ATRACE_TAG)
+#define SEC_TRACE_ASYNC_BEGIN(name, cookie) atrace_async_begin(ATRACE_TAG, name, cookie)
+#define SEC_TRACE_ASYNC_END(name, cookie)   atrace_async_end(ATRACE_TAG, name, cookie)
+#define SEC_TRACE_INT(name, value)          atrace_int(ATRACE_TAG, name, value)
+
+#ifdef __cplusplus
+// ends the slice when the scope is left, whichever way
+class SecTraceScope {
+public:
+    SecTraceScope(const char *name) { atrace_begin(ATRACE_TAG, name); }
+    ~SecTraceScope() { atrace_end(ATRACE_TAG); }
+};
+
+#define SEC_TRACE_SCOPE(name)               SecTraceScope __secTraceScope(name)
+#endif
+
+#endif // __SEC_TRACE_H__
@@ -0,0 +1,73 @@
+/*
+ * Copyright@ Samsung Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+#ifndef __SEC_TVOUT_H__
+#define __SEC_TVOUT_H__
+
+//---------------------------------------------------------//
+// TV out cable and setting
+//
+// The tv out cable goes in the headset jack, sec_jack reports it
+// on the h2w switch along with the headsets. Its state is a mask
+// of the jack devices, only SEC_TVOUT_CABLE is the tv.
+//
+// A cable is not enough to start the tv: the TV Out setting of
+// DeviceSettings sets SEC_TVOUT_ENABLE_PROPERTY while it is on.
+//---------------------------------------------------------//
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <cutils/properties.h>
+
+#define SEC_TVOUT_SWITCH_STATE      "/sys/class/switch/h2w/state"
+#define SEC_TVOUT_SWITCH_UEVENT     "/switch/h2w"
+#define SEC_TVOUT_ENABLE_PROPERTY   "sys.tvout.enable"
+
+// SEC_TVOUT_DEVICE of sec_jack
+#define SEC_TVOUT_CABLE             (1 << 5)
+
+// 1 if the switch state has the tv out cable in
+static inline int sec_tvout_cable(int state)
+{
+    return state > 0 && (state & SEC_TVOUT_CABLE) != 0;
+}
+
+// the cable out of an fd on SEC_TVOUT_SWITCH_STATE, -1 if it can't be read
+static inline int sec_tvout_read_cable(int fd)
+{
+    char    state[8];
+    ssize_t len;
+
+    if (fd < 0)
+        return -1;
+    len = pread(fd, state, sizeof(state) - 1, 0);
+    if (len <= 0)
+        return -1;
+    state[len] = '\0';
+    return sec_tvout_cable(strtol(state, NULL, 10));
+}
+
+// 1 while the user has the tv out switched on
+static inline int sec_tvout_enabled(void)
+{
+    char value[PROPERTY_VALUE_MAX];
+
+    property_get(SEC_TVOUT_ENABLE_PROPERTY, value, "0");
+    return atoi(value) != 0;
+}
+
+#endif // __SEC_TVOUT_H__
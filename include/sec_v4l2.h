@@ -0,0 +1,328 @@
+/*
+ * Copyright@ Samsung Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+#ifndef __SEC_V4L2_H__
+#define __SEC_V4L2_H__
+
+//---------------------------------------------------------//
+// V4L2 node helpers shared by the camera, libfimc and tvout
+//
+// The modules keep their own wrappers for the ioctls only
+// they use and for their log messages, the plumbing every
+// node needs lives here once:
+//
+//  - S_FMT through a cache of the last request, a node that
+//    already has the format is not told again
+//  - QUERYBUF and mmap into a map kept across requests, the
+//    fimc buffers sit in reserved memory so a mapping of the
+//    same offset and length stays good
+//  - REQBUFS, QBUF, DQBUF and STREAMON/OFF, DQBUF with the
+//    buffer time on CLOCK_MONOTONIC
+//  - poll on one node that rides out EINTR
+//  - a generation count of a node shared between processes,
+//    so a user that caches its configuration knows when
+//    someone else programmed the node
+//
+// All return 0, a count or an index on success and -errno on
+// failure, logging is the caller's.
+//---------------------------------------------------------//
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include <linux/videodev2.h>
+
+// the last format a node took, zeroed when the node is opened
+struct sec_v4l2_fmt_cache {
+    int                 valid;
+    struct v4l2_format  fmt;
+};
+
+// the count sits in a file of SEC_V4L2_GEN_DIR, one per node, mapped by
+// every process that opens the node
+#define SEC_V4L2_GEN_DIR    "/dev/sec_v4l2"
+
+// how often a node was programmed, count is NULL when it couldn't be mapped
+struct sec_v4l2_gen {
+    volatile int32_t   *count;
+    int32_t             seen;
+};
+
+// where a buffer of an mmap node is mapped, start is NULL when it isn't
+struct sec_v4l2_map {
+    void               *start;
+    size_t              length;
+    uint32_t            offset;
+};
+
+static inline void sec_v4l2_fmt_reset(struct sec_v4l2_fmt_cache *cache)
+{
+    memset(cache, 0, sizeof(*cache));
+}
+
+// fmt is compared as a whole, so it is zeroed before it is filled in. the
+// driver's answer comes back in fmt only when S_FMT ran
+static inline int sec_v4l2_s_fmt(int fd, struct sec_v4l2_fmt_cache *cache,
+                                 struct v4l2_format *fmt)
+{
+    struct v4l2_format req = *fmt;
+
+    if (cache != NULL && cache->valid && !memcmp(&cache->fmt, &req, sizeof(req)))
+        return 0;
+
+    if (ioctl(fd, VIDIOC_S_FMT, fmt) < 0) {
+        int err = -errno;
+        // the node may have taken part of it
+        if (cache != NULL)
+            cache->valid = 0;
+        return err;
+    }
+
+    if (cache != NULL) {
+        cache->fmt = req;
+        cache->valid = 1;
+    }
+
+    return 0;
+}
+
+// the buffer count the driver granted
+static inline int sec_v4l2_reqbufs(int fd, enum v4l2_buf_type type,
+                                   enum v4l2_memory memory, int count)
+{
+    struct v4l2_requestbuffers req;
+
+    memset(&req, 0, sizeof(req));
+    req.count = count;
+    req.type = type;
+    req.memory = memory;
+
+    if (ioctl(fd, VIDIOC_REQBUFS, &req) < 0)
+        return -errno;
+
+    return req.count;
+}
+
+static inline void sec_v4l2_unmap_buffer(struct sec_v4l2_map *map)
+{
+    if (map->start != NULL)
+        munmap(map->start, map->length);
+    map->start = NULL;
+    map->length = 0;
+    map->offset = 0;
+}
+
+// a map of the same offset and length is kept, anything else is mapped again
+static inline int sec_v4l2_map_buffer(int fd, enum v4l2_buf_type type, int index,
+                                      struct sec_v4l2_map *map)
+{
+    struct v4l2_buffer buf;
+    void *start;
+
+    memset(&buf, 0, sizeof(buf));
+    buf.type = type;
+    buf.memory = V4L2_MEMORY_MMAP;
+    buf.index = index;
+
+    if (ioctl(fd, VIDIOC_QUERYBUF, &buf) < 0)
+        return -errno;
+
+    if (map->start != NULL) {
+        if (map->offset == buf.m.offset && map->length == buf.length)
+            return 0;
+        sec_v4l2_unmap_buffer(map);
+    }
+
+    start = mmap(0, buf.length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, buf.m.offset);
+    if (start == MAP_FAILED)
+        return -errno;
+
+    map->start = start;
+    map->length = buf.length;
+    map->offset = buf.m.offset;
+
+    return 0;
+}
+
+static inline int sec_v4l2_streamon(int fd, enum v4l2_buf_type type)
+{
+    if (ioctl(fd, VIDIOC_STREAMON, &type) < 0)
+        return -errno;
+
+    return 0;
+}
+
+static inline int sec_v4l2_streamoff(int fd, enum v4l2_buf_type type)
+{
+    if (ioctl(fd, VIDIOC_STREAMOFF, &type) < 0)
+        return -errno;
+
+    return 0;
+}
+
+// userptr is what a USERPTR node takes, the fimc wants its plane addresses there
+static inline int sec_v4l2_qbuf(int fd, enum v4l2_buf_type type,
+                                enum v4l2_memory memory, int index,
+                                unsigned long userptr)
+{
+    struct v4l2_buffer buf;
+
+    memset(&buf, 0, sizeof(buf));
+    buf.type = type;
+    buf.memory = memory;
+    buf.index = index;
+    if (memory == V4L2_MEMORY_USERPTR)
+        buf.m.userptr = userptr;
+
+    if (ioctl(fd, VIDIOC_QBUF, &buf) < 0)
+        return -errno;
+
+    return 0;
+}
+
+static inline int64_t sec_v4l2_clock_ns(clockid_t clock)
+{
+    struct timespec ts;
+
+    clock_gettime(clock, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// depending on the kernel the fimc stamps buffers with the wall clock, the
+// monotonic clock or not at all, the dequeue time stands in for a stamp
+// that looks like neither
+static inline int64_t sec_v4l2_timestamp(const struct timeval *tv)
+{
+    const int64_t second = 1000000000LL;
+    int64_t now = sec_v4l2_clock_ns(CLOCK_MONOTONIC);
+    int64_t ts = (int64_t)tv->tv_sec * second + (int64_t)tv->tv_usec * 1000;
+    int64_t real;
+
+    if (ts == 0)
+        return now;
+
+    if (ts <= now && now - ts < second)
+        return ts;
+
+    real = sec_v4l2_clock_ns(CLOCK_REALTIME);
+    if (ts <= real && real - ts < second)
+        return now - (real - ts);
+
+    return now;
+}
+
+// the index of the buffer, timestamp may be NULL
+static inline int sec_v4l2_dqbuf(int fd, enum v4l2_buf_type type,
+                                 enum v4l2_memory memory, int64_t *timestamp)
+{
+    struct v4l2_buffer buf;
+
+    memset(&buf, 0, sizeof(buf));
+    buf.type = type;
+    buf.memory = memory;
+
+    if (ioctl(fd, VIDIOC_DQBUF, &buf) < 0)
+        return -errno;
+
+    if (timestamp != NULL)
+        *timestamp = sec_v4l2_timestamp(&buf.timestamp);
+
+    return buf.index;
+}
+
+// > 0 with revents of the node, 0 on timeout
+static inline int sec_v4l2_poll(int fd, short events, int timeout_ms)
+{
+    struct pollfd pfd;
+    int ret;
+
+    pfd.fd = fd;
+    pfd.events = events;
+    pfd.revents = 0;
+
+    do {
+        ret = poll(&pfd, 1, timeout_ms);
+    } while (ret < 0 && errno == EINTR);
+
+    if (ret < 0)
+        return -errno;
+
+    return ret ? pfd.revents : 0;
+}
+
+// Users of a shared node lock it with flock() around their work. With
+// the lock held, a user bumps the count before it programs the node, and
+// finds its own configuration still in the driver only while the count
+// is the one its last bump left. Without the count nothing is known, the
+// node is always taken as changed.
+static inline void sec_v4l2_gen_open(struct sec_v4l2_gen *gen, int fd)
+{
+    char path[64];
+    struct stat st;
+    void *count;
+    int gen_fd;
+
+    gen->count = NULL;
+    gen->seen = 0;
+
+    if (fstat(fd, &st) < 0)
+        return;
+
+    snprintf(path, sizeof(path), SEC_V4L2_GEN_DIR "/%lx", (unsigned long)st.st_rdev);
+    gen_fd = open(path, O_RDWR | O_CREAT, 0666);
+    if (gen_fd < 0)
+        return;
+    // the camera and the display run as different users, umask aside
+    fchmod(gen_fd, 0666);
+
+    if (ftruncate(gen_fd, sizeof(int32_t)) == 0) {
+        count = mmap(0, sizeof(int32_t), PROT_READ | PROT_WRITE, MAP_SHARED, gen_fd, 0);
+        if (count != MAP_FAILED)
+            gen->count = (volatile int32_t *)count;
+    }
+    close(gen_fd);
+}
+
+static inline void sec_v4l2_gen_close(struct sec_v4l2_gen *gen)
+{
+    if (gen->count != NULL)
+        munmap((void *)gen->count, sizeof(int32_t));
+    gen->count = NULL;
+}
+
+// 1 if someone else programmed the node since this user last did
+static inline int sec_v4l2_gen_changed(const struct sec_v4l2_gen *gen)
+{
+    return gen->count == NULL || *gen->count != gen->seen;
+}
+
+static inline void sec_v4l2_gen_bump(struct sec_v4l2_gen *gen)
+{
+    if (gen->count != NULL)
+        gen->seen = __sync_add_and_fetch(gen->count, 1);
+}
+
+#endif // __SEC_V4L2_H__
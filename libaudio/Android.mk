@@ -2,13 +2,15 @@ LOCAL_PATH:= $(call my-dir)
 
 include $(CLEAR_VARS)
 LOCAL_SRC_FILES:= \
-	AudioHardware.cpp
+	AudioHardware.cpp \
+	PolyphaseResampler.cpp
 
 LOCAL_MODULE := audio.primary.aries
 LOCAL_MODULE_PATH := $(TARGET_OUT_SHARED_LIBRARIES)/hw
 LOCAL_STATIC_LIBRARIES:= libmedia_helper
 LOCAL_SHARED_LIBRARIES:= \
 	libutils \
+	libcutils \
 	libhardware_legacy \
 	libtinyalsa \
 	libaudioutils
@@ -18,6 +20,7 @@ LOCAL_MODULE_TAGS := optional
 
 LOCAL_SHARED_LIBRARIES += libdl
 LOCAL_C_INCLUDES += \
+	$(LOCAL_PATH)/../include \
 	external/tinyalsa/include \
 	$(call include-path-for, audio-effects) \
 	$(call include-path-for, audio-utils)
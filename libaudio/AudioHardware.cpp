@@ -18,6 +18,7 @@
 
 #define LOG_NDEBUG 0
 #define LOG_TAG "AudioHardware"
+#define ATRACE_TAG ATRACE_TAG_AUDIO
 
 #include <utils/Log.h>
 #include <utils/String8.h>
@@ -28,15 +29,26 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/resource.h>
+#include <sched.h>
+#include <time.h>
 #include <dlfcn.h>
 #include <fcntl.h>
 
+#if defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
 #include "AudioHardware.h"
+#include <sec_startup.h>
+#include <sec_trace.h>
 #include <media/AudioRecord.h>
 #include <audio_effects/effect_aec.h>
 
 extern "C" {
 #include <tinyalsa/asoundlib.h>
+#include <cutils/properties.h>
+#include <audio_utils/primitives.h>
+#include <cutils/atomic.h>
 }
 
 #ifdef HAVE_FM_RADIO
@@ -46,13 +58,46 @@ extern "C" {
 
 namespace android_audio_legacy {
 
+// the WM8994 AIF1 clocks all of these natively, 11025 is left to the resampler
+// as its kernel machine driver has no clock setup for it
 const uint32_t AudioHardware::inputConfigTable[][AudioHardware::INPUT_CONFIG_CNT] = {
-        {8000, 4},
-        {11025, 4},
-        {16000, 2},
-        {22050, 2},
-        {32000, 1},
-        {44100, 1}
+        {8000, 4, 1},
+        {11025, 4, 0},
+        {16000, 2, 1},
+        {22050, 2, 1},
+        {32000, 1, 1},
+        {44100, 1, 1}
+};
+
+const uint32_t AudioHardware::inputPeriodTable[][AudioHardware::INPUT_PERIOD_CNT] = {
+        {AUDIO_HW_IN_PERIOD_SZ, AUDIO_HW_IN_PERIOD_CNT},
+        // the preprocessing and the recognizer get each 10ms block sooner
+        {AUDIO_HW_IN_LL_PERIOD_SZ, AUDIO_HW_IN_LL_PERIOD_CNT},
+        // nobody waits on a recording, the encoder takes it in large chunks
+        {AUDIO_HW_IN_LONG_PERIOD_SZ, AUDIO_HW_IN_LONG_PERIOD_CNT}
+};
+
+// indexed by the MIXER_CTL_* ids
+const char * const AudioHardware::mixerCtlNames[AudioHardware::MIXER_CTL_CNT] = {
+        "Playback Path",
+        "Voice Call Path",
+        "Capture MIC Path",
+        "Input Source",
+        "FM Radio Path",
+        "Codec Status"
+};
+
+const uint32_t AudioHardware::outputConfigTable[][AudioHardware::OUTPUT_CONFIG_CNT] = {
+        // start once the whole buffer is queued
+        {AUDIO_HW_OUT_PERIOD_SZ, AUDIO_HW_OUT_PERIOD_CNT, 0, AUDIO_HW_OUT_SAMPLERATE},
+        // start with the first period, the buffer only holds two
+        {AUDIO_HW_OUT_LL_PERIOD_SZ, AUDIO_HW_OUT_LL_PERIOD_CNT, AUDIO_HW_OUT_LL_PERIOD_SZ,
+         AUDIO_HW_OUT_SAMPLERATE},
+        // one wakeup every 93ms for screen off music
+        {AUDIO_HW_OUT_DB_PERIOD_SZ, AUDIO_HW_OUT_DB_PERIOD_CNT, 0, AUDIO_HW_OUT_SAMPLERATE},
+        // the rate of the sink, nothing resampled on the way
+        {AUDIO_HW_OUT_HDMI_PERIOD_SZ, AUDIO_HW_OUT_HDMI_PERIOD_CNT, 0,
+         AUDIO_HW_OUT_HDMI_SAMPLERATE}
 };
 
 //  trace driver operations for dump
@@ -64,7 +109,11 @@ enum {
     DRV_PCM_OPEN,
     DRV_PCM_CLOSE,
     DRV_PCM_WRITE,
+    DRV_PCM_STOP,
+    DRV_PCM_START,
+    DRV_PCM_WAIT,
     DRV_PCM_READ,
+    DRV_PCM_PREPARE,
     DRV_MIXER_OPEN,
     DRV_MIXER_CLOSE,
     DRV_MIXER_GET,
@@ -88,37 +137,119 @@ const char *AudioHardware::inputPathNameVoiceRecognition = "Voice Recognition";
 AudioHardware::AudioHardware() :
     mInit(false),
     mMicMute(false),
+    mPcmDriver(NULL),
     mPcm(NULL),
     mMixer(NULL),
     mPcmOpenCnt(0),
     mMixerOpenCnt(0),
     mInCallAudioMode(false),
+    mInCallPrepared(false),
     mVoiceVol(1.0f),
+    mMasterGain(AUDIO_HW_GAIN_UNITY),
+    mMasterGainOut(AUDIO_HW_GAIN_UNITY),
     mInputSource(AUDIO_SOURCE_DEFAULT),
     mBluetoothNrec(true),
     mTTYMode(TTY_MODE_OFF),
     mSecRilLibHandle(NULL),
     mRilClient(0),
     mActivatedCP(false),
+    mRilSeq(0),
+    mRilDoneSeq(0),
+    mRilLastError(0),
+    mRilExit(false),
     mEchoReference(NULL),
 #ifdef HAVE_FM_RADIO
     mFmFd(-1),
     mFmVolume(1),
+    mFmLevel(-1),
     mFmResumeAfterCall(false),
+    mFmTarget(-1),
+    mFmStepNs(0),
+    mFmRampExit(false),
 #endif
-    mDriverOp(DRV_NONE)
+    mDriverOp(DRV_NONE),
+    mPcmProfile(OUTPUT_PROFILE_NORMAL),
+    mPcmMmap(false),
+    mPcmStartThreshold(0),
+    mPlaybackRoute(NULL),
+    mStandbyWakeNs(0),
+    mStandbyExit(false)
 {
+    struct sec_startup startup;
+    sec_startup_begin(&startup, "audio");
+
+    memset(mMixerCtls, 0, sizeof(mMixerCtls));
+    memset(mMixQueues, 0, sizeof(mMixQueues));
+
+    char value[PROPERTY_VALUE_MAX];
+    property_get("persist.audio.warm_standby", value, "0");
+    mWarmStandby = atoi(value) != 0;
+    property_get("persist.audio.native_capture", value, "1");
+    mNativeCapture = atoi(value) != 0;
+    property_get("persist.audio.mmap", value, "1");
+    mMmapEnabled = atoi(value) != 0;
+    property_get("persist.audio.standby_delay_ms", value, "500");
+    mStandbyDelayMs = atoi(value);
+    if (mStandbyDelayMs > 0) {
+        mStandbyThread = new StandbyThread(this);
+        mStandbyThread->run("AudioStandbyThread", ANDROID_PRIORITY_BACKGROUND);
+    }
+#ifdef HAVE_FM_RADIO
+    mFmRampThread = new FmRampThread(this);
+    mFmRampThread->run("AudioFmRampThread", ANDROID_PRIORITY_BACKGROUND);
+#endif
+    sec_startup_phase(&startup, "config");
+
     loadRILD();
+    if (mSecRilLibHandle) {
+        mRilThread = new RilThread(this);
+        mRilThread->run("AudioRilThread", ANDROID_PRIORITY_AUDIO);
+    }
+    sec_startup_phase(&startup, "rild");
     mInit = true;
+    // the mixer and the pcm open with the first stream, not here
+    sec_startup_end(&startup, 0);
 }
 
 AudioHardware::~AudioHardware()
 {
+    if (mStandbyThread != 0) {
+        {
+            AutoMutex lock(mStandbyLock);
+            mStandbyExit = true;
+            mStandbyCond.signal();
+        }
+        mStandbyThread->requestExitAndWait();
+        mStandbyThread.clear();
+    }
+#ifdef HAVE_FM_RADIO
+    if (mFmRampThread != 0) {
+        {
+            AutoMutex lock(mLock);
+            mFmRampExit = true;
+            mFmRampCond.signal();
+        }
+        mFmRampThread->requestExitAndWait();
+        mFmRampThread.clear();
+    }
+#endif
     for (size_t index = 0; index < mInputs.size(); index++) {
         closeInputStream(mInputs[index].get());
     }
     mInputs.clear();
     closeOutputStream((AudioStreamOut*)mOutput.get());
+    if (mFastOutput != 0) {
+        closeOutputStream((AudioStreamOut*)mFastOutput.get());
+    }
+    if (mDeepOutput != 0) {
+        closeOutputStream((AudioStreamOut*)mDeepOutput.get());
+    }
+    if (mHdmiOutput != 0) {
+        closeOutputStream((AudioStreamOut*)mHdmiOutput.get());
+    }
+    for (int i = 0; i < OUTPUT_SLOT_CNT; i++) {
+        delete[] mMixQueues[i].buf;
+    }
 
     if (mMixer) {
         TRACE_DRIVER_IN(DRV_MIXER_CLOSE)
@@ -131,6 +262,17 @@ AudioHardware::~AudioHardware()
         TRACE_DRIVER_OUT
     }
 
+    if (mRilThread != 0) {
+        // what is queued still goes out before the client is closed
+        {
+            AutoMutex lock(mRilLock);
+            mRilExit = true;
+            mRilCond.signal();
+        }
+        mRilThread->requestExitAndWait();
+        mRilThread.clear();
+    }
+
     if (mSecRilLibHandle) {
         if (disconnectRILD(mRilClient) != RIL_CLIENT_ERR_SUCCESS)
             ALOGE("Disconnect_RILD() error");
@@ -216,29 +358,200 @@ status_t AudioHardware::connectRILDIfRequired(void)
     return OK;
 }
 
+uint32_t AudioHardware::postRilCommand(int cmd, int arg0, int arg1)
+{
+    if (mRilThread == 0) {
+        return 0;
+    }
+
+    AutoMutex lock(mRilLock);
+    if (cmd != RIL_CMD_CLOCK_SYNC) {
+        for (ssize_t i = (ssize_t)mRilCommands.size() - 1; i >= 0; i--) {
+            int queued = mRilCommands[i].cmd;
+            if (queued == RIL_CMD_CLOCK_SYNC) {
+                break;
+            }
+            if (queued == cmd) {
+                ALOGV("postRilCommand() %d replaces seq %u", cmd, mRilCommands[i].seq);
+                mRilCommands.removeAt(i);
+                break;
+            }
+        }
+    }
+
+    RilCommand c;
+    c.cmd = cmd;
+    c.arg0 = arg0;
+    c.arg1 = arg1;
+    c.seq = ++mRilSeq;
+    mRilCommands.add(c);
+    mRilCond.signal();
+    return c.seq;
+}
+
+bool AudioHardware::rilThreadLoop()
+{
+    RilCommand c;
+    {
+        AutoMutex lock(mRilLock);
+        while (mRilCommands.isEmpty() && !mRilExit) {
+            mRilCond.wait(mRilLock);
+        }
+        if (mRilCommands.isEmpty()) {
+            return false;
+        }
+        c = mRilCommands[0];
+        mRilCommands.removeAt(0);
+    }
+
+    int rc = INVALID_OPERATION;
+    if (connectRILDIfRequired() == OK) {
+        switch (c.cmd) {
+        case RIL_CMD_CLOCK_SYNC:
+            rc = setCallClockSync(mRilClient, (SoundClockCondition)c.arg0);
+            break;
+        case RIL_CMD_AUDIO_PATH:
+            rc = setCallAudioPath(mRilClient, (AudioPath)c.arg0);
+            break;
+        case RIL_CMD_VOLUME:
+            rc = setCallVolume(mRilClient, (SoundType)c.arg0, c.arg1);
+            break;
+        case RIL_CMD_CONNECT:
+            rc = RIL_CLIENT_ERR_SUCCESS;
+            break;
+        }
+    }
+    ALOGE_IF(rc != RIL_CLIENT_ERR_SUCCESS, "rilThreadLoop() command %d seq %u failed: %d",
+             c.cmd, c.seq, rc);
+
+    AutoMutex lock(mRilLock);
+    mRilDoneSeq = c.seq;
+    mRilLastError = rc;
+    return true;
+}
+
+void AudioHardware::scheduleStandby(nsecs_t deadline)
+{
+    AutoMutex lock(mStandbyLock);
+    if (mStandbyWakeNs == 0 || deadline < mStandbyWakeNs) {
+        mStandbyWakeNs = deadline;
+        mStandbyCond.signal();
+    }
+}
+
+bool AudioHardware::standbyThreadLoop()
+{
+    {
+        AutoMutex lock(mStandbyLock);
+        while (mStandbyWakeNs == 0 && !mStandbyExit) {
+            mStandbyCond.wait(mStandbyLock);
+        }
+        if (mStandbyExit) {
+            return false;
+        }
+        nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+        if (now < mStandbyWakeNs) {
+            mStandbyCond.waitRelative(mStandbyLock, mStandbyWakeNs - now);
+            return true;
+        }
+        mStandbyWakeNs = 0;
+    }
+
+    Vector< sp<AudioStreamOutALSA> > outputs;
+    Vector< sp<AudioStreamInALSA> > inputs;
+    {
+        AutoMutex lock(mLock);
+        sp<AudioStreamOutALSA> slots[] = { mOutput, mFastOutput, mDeepOutput, mHdmiOutput };
+        for (size_t i = 0; i < sizeof(slots) / sizeof(slots[0]); i++) {
+            if (slots[i] != 0) {
+                outputs.add(slots[i]);
+            }
+        }
+        for (size_t i = 0; i < mInputs.size(); i++) {
+            inputs.add(mInputs[i]);
+        }
+    }
+
+    // Mutex acquisition order is always out -> in -> hw, one stream at a time here
+    nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+    nsecs_t next = 0;
+    for (size_t i = 0; i < outputs.size() + inputs.size(); i++) {
+        nsecs_t deadline = (i < outputs.size()) ? outputs[i]->checkStandbyTimeout(now) :
+                inputs[i - outputs.size()]->checkStandbyTimeout(now);
+        if (deadline != 0 && (next == 0 || deadline < next)) {
+            next = deadline;
+        }
+    }
+    if (next != 0) {
+        scheduleStandby(next);
+    }
+    return true;
+}
+
 AudioStreamOut* AudioHardware::openOutputStream(
     uint32_t devices, int *format, uint32_t *channels,
     uint32_t *sampleRate, status_t *status)
+{
+    // interactive and VoIP builds trade power for a short kernel buffer
+    char value[PROPERTY_VALUE_MAX];
+    property_get("persist.audio.low_latency", value, "0");
+    int profile = atoi(value) ? OUTPUT_PROFILE_LOW_LATENCY : OUTPUT_PROFILE_NORMAL;
+
+    return openOutputStream_l(OUTPUT_SLOT_PRIMARY, profile, devices, format, channels,
+                              sampleRate, status);
+}
+
+AudioStreamOut* AudioHardware::openOutputStreamWithFlags(
+    uint32_t devices, audio_output_flags_t flags, int *format,
+    uint32_t *channels, uint32_t *sampleRate, status_t *status)
+{
+    if ((flags & AUDIO_OUTPUT_FLAG_DIRECT) &&
+            (devices & AudioSystem::DEVICE_OUT_AUX_DIGITAL)) {
+        return openOutputStream_l(OUTPUT_SLOT_HDMI, OUTPUT_PROFILE_HDMI, devices,
+                                  format, channels, sampleRate, status);
+    }
+    if (flags & AUDIO_OUTPUT_FLAG_DEEP_BUFFER) {
+        return openOutputStream_l(OUTPUT_SLOT_DEEP_BUFFER, OUTPUT_PROFILE_DEEP_BUFFER, devices,
+                                  format, channels, sampleRate, status);
+    }
+    if (flags & AUDIO_OUTPUT_FLAG_FAST) {
+        return openOutputStream_l(OUTPUT_SLOT_FAST, OUTPUT_PROFILE_LOW_LATENCY, devices,
+                                  format, channels, sampleRate, status);
+    }
+
+    return openOutputStream(devices, format, channels, sampleRate, status);
+}
+
+AudioStreamOut* AudioHardware::openOutputStream_l(int slot,
+    int profile, uint32_t devices, int *format, uint32_t *channels,
+    uint32_t *sampleRate, status_t *status)
 {
     sp <AudioStreamOutALSA> out;
+    sp <AudioStreamOutALSA>& output = (slot == OUTPUT_SLOT_FAST) ? mFastOutput :
+            ((slot == OUTPUT_SLOT_DEEP_BUFFER) ? mDeepOutput :
+            ((slot == OUTPUT_SLOT_HDMI) ? mHdmiOutput : mOutput));
     status_t rc;
 
     { // scope for the lock
         Mutex::Autolock lock(mLock);
 
-        // only one output stream allowed
-        if (mOutput != 0) {
+        // one primary, one fast, one deep buffer and one HDMI output allowed
+        if (output != 0) {
             if (status) {
                 *status = INVALID_OPERATION;
             }
             return NULL;
         }
 
+        if (slot != OUTPUT_SLOT_HDMI && mMixQueues[slot].buf == NULL) {
+            mMixQueues[slot].buf = new int16_t[AUDIO_HW_OUT_MIX_FRAMES * 2];
+        }
+
         out = new AudioStreamOutALSA();
 
-        rc = out->set(this, devices, format, channels, sampleRate);
+        rc = out->set(this, devices, profile, format, channels, sampleRate);
         if (rc == NO_ERROR) {
-            mOutput = out;
+            output = out;
         }
     }
 
@@ -259,20 +572,30 @@ void AudioHardware::closeOutputStream(AudioStreamOut* out) {
     sp<AudioStreamInALSA> spIn;
     {
         Mutex::Autolock lock(mLock);
-        if (mOutput == 0 || mOutput.get() != out) {
+        if (mDeepOutput != 0 && mDeepOutput.get() == out) {
+            spOut = mDeepOutput;
+            mDeepOutput.clear();
+        } else if (mHdmiOutput != 0 && mHdmiOutput.get() == out) {
+            spOut = mHdmiOutput;
+            mHdmiOutput.clear();
+        } else if (mFastOutput != 0 && mFastOutput.get() == out) {
+            spOut = mFastOutput;
+            mFastOutput.clear();
+        } else if (mOutput != 0 && mOutput.get() == out) {
+            spOut = mOutput;
+            mOutput.clear();
+            if (mEchoReference != NULL) {
+                spIn = getActiveInput_l();
+            }
+        } else {
             ALOGW("Attempt to close invalid output stream");
             return;
         }
-        spOut = mOutput;
-        mOutput.clear();
-        if (mEchoReference != NULL) {
-            spIn = getActiveInput_l();
-        }
     }
     if (spIn != 0) {
         // this will safely release the echo reference by calling releaseEchoReference()
         // after placing the active input in standby
-        spIn->standby();
+        spIn->standbyNow();
     }
 
     spOut.clear();
@@ -387,11 +710,16 @@ status_t AudioHardware::setMode(int mode)
     if (status == NO_ERROR) {
         bool modeNeedsCPActive = mMode == AudioSystem::MODE_IN_CALL ||
                                     mMode == AudioSystem::MODE_RINGTONE;
+        bool modeLeadsToCall = mMode == AudioSystem::MODE_RINGTONE ||
+                                    mMode == AudioSystem::MODE_IN_COMMUNICATION;
+        if (modeLeadsToCall) {
+            prepareInCall_l();
+        }
         // activate call clock in radio when entering in call or ringtone mode
         if (modeNeedsCPActive)
         {
-            if ((!mActivatedCP) && (mSecRilLibHandle) && (connectRILDIfRequired() == OK)) {
-                setCallClockSync(mRilClient, SOUND_CLOCK_START);
+            if ((!mActivatedCP) && (mSecRilLibHandle)) {
+                postRilCommand(RIL_CMD_CLOCK_SYNC, SOUND_CLOCK_START);
                 mActivatedCP = true;
             }
         }
@@ -412,19 +740,21 @@ status_t AudioHardware::setMode(int mode)
             setInputSource_l(AUDIO_SOURCE_DEFAULT);
             setVoiceVolume_l(mVoiceVol);
             mInCallAudioMode = true;
+            // the call has its own mixer reference now
+            unprepareInCall_l();
+            // the routing request that follows the mode finds the path set already
+            if (mOutput != 0) {
+                setIncallPath_l(mOutput->device());
+            }
+        }
+        if (mMode != AudioSystem::MODE_IN_CALL && !modeLeadsToCall) {
+            unprepareInCall_l();
         }
         if (mMode != AudioSystem::MODE_IN_CALL && mInCallAudioMode) {
             setInputSource_l(mInputSource);
             if (mMixer != NULL) {
-                TRACE_DRIVER_IN(DRV_MIXER_GET)
-                struct mixer_ctl *ctl= mixer_get_ctl_by_name(mMixer, "Playback Path");
-                TRACE_DRIVER_OUT
-                if (ctl != NULL) {
-                    ALOGV("setMode() reset Playback Path to RCV");
-                    TRACE_DRIVER_IN(DRV_MIXER_SEL)
-                    mixer_ctl_set_enum_by_string(ctl, "RCV");
-                    TRACE_DRIVER_OUT
-                }
+                ALOGV("setMode() reset Playback Path to RCV");
+                setPlaybackRoute_l("RCV");
             }
             ALOGV("setMode() closePcmOut_l()");
             closeMixer_l();
@@ -482,7 +812,7 @@ status_t AudioHardware::setMicMute(bool state)
     }
 
     if (spIn != 0) {
-        spIn->standby();
+        spIn->standbyNow();
     }
 
     return NO_ERROR;
@@ -554,6 +884,7 @@ status_t AudioHardware::setParameters(const String8& keyValuePairs)
     // fm radio on
     key = String8(AudioParameter::keyFmOn);
     if (param.get(key, value) == NO_ERROR) {
+        AutoMutex lock(mLock);
         enableFMRadio();
     }
     param.remove(key);
@@ -561,6 +892,7 @@ status_t AudioHardware::setParameters(const String8& keyValuePairs)
     // fm radio off
     key = String8(AudioParameter::keyFmOff);
     if (param.get(key, value) == NO_ERROR) {
+        AutoMutex lock(mLock);
         disableFMRadio();
     }
     param.remove(key);
@@ -613,8 +945,7 @@ void AudioHardware::setVoiceVolume_l(float volume)
 
     mVoiceVol = volume;
 
-    if ( (AudioSystem::MODE_IN_CALL == mMode) && (mSecRilLibHandle) &&
-         (connectRILDIfRequired() == OK) ) {
+    if ( (AudioSystem::MODE_IN_CALL == mMode) && (mSecRilLibHandle) ) {
 
         uint32_t device = AudioSystem::DEVICE_OUT_EARPIECE;
         if (mOutput != 0) {
@@ -653,33 +984,97 @@ void AudioHardware::setVoiceVolume_l(float volume)
                 type = SOUND_TYPE_VOICE;
                 break;
         }
-        setCallVolume(mRilClient, type, int_volume);
+        postRilCommand(RIL_CMD_VOLUME, type, int_volume);
     }
 
 }
 
+// The output driving the pcm ramps to the new gain, AudioFlinger leaves its
+// software master volume at unity when this succeeds.
 status_t AudioHardware::setMasterVolume(float volume)
 {
     ALOGV("Set master volume to %f.\n", volume);
-    // We return an error code here to let the audioflinger do in-software
-    // volume on top of the maximum volume that we set through the SND API.
-    // return error - software mixer will handle it
-    return -1;
+    if (volume < 0.0f || volume > 1.0f) {
+        return BAD_VALUE;
+    }
+    AutoMutex lock(mLock);
+    mMasterGain = (int32_t)(volume * AUDIO_HW_GAIN_UNITY + 0.5f);
+    return NO_ERROR;
+}
+
+// where the master gain goes over the next frames, false when it stays at unity
+bool AudioHardware::masterGain_l(size_t frames, int32_t *from, int32_t *to, size_t *rampFrames)
+{
+    *from = mMasterGainOut;
+    *to = mMasterGain;
+    *rampFrames = 0;
+    if (mMasterGainOut == mMasterGain) {
+        return mMasterGain != AUDIO_HW_GAIN_UNITY;
+    }
+
+    int32_t step = AUDIO_HW_GAIN_UNITY / (AUDIO_HW_OUT_SAMPLERATE * AUDIO_HW_VOLUME_RAMP_MS / 1000);
+    int32_t delta = mMasterGain - mMasterGainOut;
+    size_t needed = (size_t)((abs(delta) + step - 1) / step);
+    if (needed > frames) {
+        *to = mMasterGainOut + ((delta > 0) ? 1 : -1) * step * (int32_t)frames;
+        needed = frames;
+    }
+    *rampFrames = needed;
+    mMasterGainOut = *to;
+    return true;
 }
 
 #ifdef HAVE_FM_RADIO
 status_t AudioHardware::setFmVolume(float v)
+{
+    AutoMutex lock(mLock);
+    setFmVolume_l(v);
+    return NO_ERROR;
+}
+
+// the tuner volume goes through every level in between, spread over
+// AUDIO_HW_VOLUME_RAMP_MS, rather than jumping. the ramp thread does the
+// stepping, the caller doesn't wait for it
+void AudioHardware::setFmVolume_l(float v)
 {
     mFmVolume = v;
     if (mFmFd > 0) {
-        __u8 fmVolume = (AudioSystem::logToLinear(v) + 5) / 7;
-        ALOGD("%s %f %d", __func__, v, (int) fmVolume);
-        if (ioctl(mFmFd, Si4709_IOC_VOLUME_SET, &fmVolume) < 0) {
-            ALOGE("set_volume_fm error.");
-            return -EIO;
-        }
+        int target = (AudioSystem::logToLinear(v) + 5) / 7;
+        int steps = (mFmLevel < 0) ? 0 : abs(target - mFmLevel);
+        ALOGD("%s %f %d", __func__, v, target);
+        mFmTarget = target;
+        mFmStepNs = steps ? milliseconds(AUDIO_HW_VOLUME_RAMP_MS) / steps : 0;
+        mFmRampCond.signal();
     }
-    return NO_ERROR;
+}
+
+bool AudioHardware::fmRampThreadLoop()
+{
+    AutoMutex lock(mLock);
+    while (!mFmRampExit && (mFmFd < 0 || mFmTarget < 0 || mFmLevel == mFmTarget)) {
+        mFmRampCond.wait(mLock);
+    }
+    if (mFmRampExit) {
+        return false;
+    }
+
+    int level = mFmTarget;
+    if (mFmLevel >= 0) {
+        level = mFmLevel + ((mFmTarget > mFmLevel) ? 1 : -1);
+    }
+    __u8 fmVolume = level;
+    if (ioctl(mFmFd, Si4709_IOC_VOLUME_SET, &fmVolume) < 0) {
+        ALOGE("set_volume_fm error.");
+        mFmLevel = -1;
+        mFmTarget = -1;
+        return true;
+    }
+    mFmLevel = level;
+    if (mFmLevel != mFmTarget) {
+        // mLock is free meanwhile, a new target cuts the wait short
+        mFmRampCond.waitRelative(mLock, mFmStepNs);
+    }
+    return true;
 }
 #endif
 
@@ -699,6 +1094,47 @@ static bool tryLock(Mutex& mutex)
     return locked;
 }
 
+// Sleeps until the frames of a failed write() or read() would have been
+// played or captured. The deadline runs on across consecutive failures so
+// AudioFlinger keeps the pace of the audio clock whatever the driver took to
+// fail, it restarts from the call time after a success resets it to 0.
+static void paceFailedIo(nsecs_t *deadlineNs, nsecs_t callNs, size_t frames, uint32_t rate)
+{
+    if (*deadlineNs < callNs) {
+        *deadlineNs = callNs;
+    }
+    *deadlineNs += (nsecs_t)frames * 1000000000LL / rate;
+
+    struct timespec ts;
+    ts.tv_sec = *deadlineNs / 1000000000LL;
+    ts.tv_nsec = *deadlineNs % 1000000000LL;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+    }
+}
+
+// The pcm timestamp is on the clock the kernel stamps the pcm with, the wall
+// clock on older ones. Moves it to CLOCK_MONOTONIC, which the video renderer
+// and the frame timestamps run on.
+static void pcmTimeToMonotonic(struct timespec *ts)
+{
+    const int64_t second = 1000000000LL;
+    struct timespec mono, real;
+    clock_gettime(CLOCK_MONOTONIC, &mono);
+    clock_gettime(CLOCK_REALTIME, &real);
+
+    int64_t t = ts->tv_sec * second + ts->tv_nsec;
+    int64_t m = mono.tv_sec * second + mono.tv_nsec;
+    int64_t r = real.tv_sec * second + real.tv_nsec;
+
+    if (t <= m && m - t < second) {
+        return;
+    }
+    // neither clock, taken as now
+    t = (t <= r && r - t < second) ? m - (r - t) : m;
+    ts->tv_sec = t / second;
+    ts->tv_nsec = t % second;
+}
+
 status_t AudioHardware::dump(int fd, const Vector<String16>& args)
 {
     const size_t SIZE = 256;
@@ -720,12 +1156,22 @@ status_t AudioHardware::dump(int fd, const Vector<String16>& args)
     result.append(buffer);
     snprintf(buffer, SIZE, "\tmPcmOpenCnt: %d\n", mPcmOpenCnt);
     result.append(buffer);
+    snprintf(buffer, SIZE, "\tmPcmProfile: %d%s\n", mPcmProfile, (mPcmMmap) ? " mmap" : "");
+    result.append(buffer);
+    snprintf(buffer, SIZE, "\tmPcmDriver: %p\n", mPcmDriver);
+    result.append(buffer);
+    snprintf(buffer, SIZE, "\tWarm standby %s, route %s\n", (mWarmStandby) ? "ON" : "OFF",
+             (mPlaybackRoute) ? mPlaybackRoute : "unknown");
+    result.append(buffer);
+    snprintf(buffer, SIZE, "\tMix queues: %d %d %d frames\n", mMixQueues[OUTPUT_SLOT_PRIMARY].framesIn,
+             mMixQueues[OUTPUT_SLOT_FAST].framesIn, mMixQueues[OUTPUT_SLOT_DEEP_BUFFER].framesIn);
+    result.append(buffer);
     snprintf(buffer, SIZE, "\tmMixer: %p\n", mMixer);
     result.append(buffer);
     snprintf(buffer, SIZE, "\tmMixerOpenCnt: %d\n", mMixerOpenCnt);
     result.append(buffer);
-    snprintf(buffer, SIZE, "\tIn Call Audio Mode %s\n",
-             (mInCallAudioMode) ? "ON" : "OFF");
+    snprintf(buffer, SIZE, "\tIn Call Audio Mode %s%s\n",
+             (mInCallAudioMode) ? "ON" : "OFF", (mInCallPrepared) ? " (prepared)" : "");
     result.append(buffer);
     snprintf(buffer, SIZE, "\tInput source %d\n", mInputSource);
     result.append(buffer);
@@ -736,6 +1182,12 @@ status_t AudioHardware::dump(int fd, const Vector<String16>& args)
     snprintf(buffer, SIZE, "\tCP %s\n",
              (mActivatedCP) ? "Activated" : "Deactivated");
     result.append(buffer);
+    {
+        AutoMutex lock(mRilLock);
+        snprintf(buffer, SIZE, "\tRIL commands: %d queued, seq %u done %u, last error %d\n",
+                 mRilCommands.size(), mRilSeq, mRilDoneSeq, mRilLastError);
+        result.append(buffer);
+    }
     snprintf(buffer, SIZE, "\tmDriverOp: %d\n", mDriverOp);
     result.append(buffer);
 
@@ -746,6 +1198,24 @@ status_t AudioHardware::dump(int fd, const Vector<String16>& args)
         mOutput->dump(fd, args);
     }
 
+    snprintf(buffer, SIZE, "\n\tmFastOutput %p dump:\n", mFastOutput.get());
+    write(fd, buffer, strlen(buffer));
+    if (mFastOutput != 0) {
+        mFastOutput->dump(fd, args);
+    }
+
+    snprintf(buffer, SIZE, "\n\tmDeepOutput %p dump:\n", mDeepOutput.get());
+    write(fd, buffer, strlen(buffer));
+    if (mDeepOutput != 0) {
+        mDeepOutput->dump(fd, args);
+    }
+
+    snprintf(buffer, SIZE, "\n\tmHdmiOutput %p dump:\n", mHdmiOutput.get());
+    write(fd, buffer, strlen(buffer));
+    if (mHdmiOutput != 0) {
+        mHdmiOutput->dump(fd, args);
+    }
+
     snprintf(buffer, SIZE, "\n\t%d inputs opened:\n", mInputs.size());
     write(fd, buffer, strlen(buffer));
     for (size_t i = 0; i < mInputs.size(); i++) {
@@ -757,13 +1227,38 @@ status_t AudioHardware::dump(int fd, const Vector<String16>& args)
     return NO_ERROR;
 }
 
+// a ringing phone or a voip call often turns into MODE_IN_CALL. The mixer
+// controls are resolved and rild connected now, entering the call is then
+// left with the stream standby and the route writes.
+void AudioHardware::prepareInCall_l()
+{
+    if (mInCallPrepared || mInCallAudioMode) {
+        return;
+    }
+    if (openMixer_l() == NULL) {
+        return;
+    }
+    mInCallPrepared = true;
+    ALOGV("prepareInCall_l()");
+    postRilCommand(RIL_CMD_CONNECT, 0);
+}
+
+void AudioHardware::unprepareInCall_l()
+{
+    if (!mInCallPrepared) {
+        return;
+    }
+    mInCallPrepared = false;
+    ALOGV("unprepareInCall_l()");
+    closeMixer_l();
+}
+
 status_t AudioHardware::setIncallPath_l(uint32_t device)
 {
     ALOGV("setIncallPath_l: device %x", device);
 
     // Setup sound path for CP clocking
-    if ((mSecRilLibHandle) &&
-        (connectRILDIfRequired() == OK)) {
+    if (mSecRilLibHandle) {
 
         if (mMode == AudioSystem::MODE_IN_CALL) {
             ALOGD("### incall mode route (%d)", device);
@@ -804,19 +1299,13 @@ status_t AudioHardware::setIncallPath_l(uint32_t device)
                     break;
             }
 
-            setCallAudioPath(mRilClient, path);
+            postRilCommand(RIL_CMD_AUDIO_PATH, path);
 
             if (mMixer != NULL) {
-                TRACE_DRIVER_IN(DRV_MIXER_GET)
-                struct mixer_ctl *ctl= mixer_get_ctl_by_name(mMixer, "Voice Call Path");
-                TRACE_DRIVER_OUT
-                ALOGE_IF(ctl == NULL, "setIncallPath_l() could not get mixer ctl");
-                if (ctl != NULL) {
-                    ALOGV("setIncallPath_l() Voice Call Path, (%x)", device);
-                    TRACE_DRIVER_IN(DRV_MIXER_SEL)
-                    mixer_ctl_set_enum_by_string(ctl, getVoiceRouteFromDevice(device));
-                    TRACE_DRIVER_OUT
-                }
+                ALOGV("setIncallPath_l() Voice Call Path, (%x)", device);
+                status_t rc = setMixerEnum_l(MIXER_CTL_VOICE_CALL_PATH,
+                                             getVoiceRouteFromDevice(device));
+                ALOGE_IF(rc == NO_INIT, "setIncallPath_l() could not get mixer ctl");
             }
         }
     }
@@ -844,7 +1333,7 @@ void AudioHardware::enableFMRadio() {
         if (mFmFd < 0) {
             mFmFd = open("/dev/radio0", O_RDWR);
             // In case setFmVolume was called before FM was enabled, we save the volume and call it here.
-            setFmVolume(mFmVolume);
+            setFmVolume_l(mFmVolume);
         }
     }
 }
@@ -856,15 +1345,7 @@ void AudioHardware::disableFMRadio() {
         // Disable FM radio flag to allow the codec to be turned off
         // (the flag is automatically set by the kernel driver when FM is enabled)
         // No need to turn off the FM Radio path as the kernel driver will handle that
-        TRACE_DRIVER_IN(DRV_MIXER_GET)
-        struct mixer_ctl *ctl = mixer_get_control(mMixer, "Codec Status", 0);
-        TRACE_DRIVER_OUT
-
-        if (ctl != NULL) {
-            TRACE_DRIVER_IN(DRV_MIXER_SEL)
-            mixer_ctl_select(ctl, "FMR_FLAG_CLEAR");
-            TRACE_DRIVER_OUT
-        }
+        setMixerEnum_l(MIXER_CTL_CODEC_STATUS, "FMR_FLAG_CLEAR");
 
         closeMixer_l();
         closePcmOut_l();
@@ -873,6 +1354,8 @@ void AudioHardware::disableFMRadio() {
     if (mFmFd > 0) {
         close(mFmFd);
         mFmFd = -1;
+        mFmLevel = -1;
+        mFmTarget = -1;
     }
 }
 
@@ -917,29 +1400,15 @@ status_t AudioHardware::setFMRadioPath_l(uint32_t device)
 
     if (mMixer != NULL) {
         ALOGV("setFMRadioPath_l() mixer is open");
-        TRACE_DRIVER_IN(DRV_MIXER_GET)
-        struct mixer_ctl *ctl= mixer_get_control(mMixer, "FM Radio Path", 0);
-        TRACE_DRIVER_OUT
-
-        if (ctl != NULL) {
-            ALOGV("setFMRadioPath_l() FM Radio Path, (%s)", fmpath);
-            TRACE_DRIVER_IN(DRV_MIXER_SEL)
-            mixer_ctl_select(ctl, fmpath);
-            TRACE_DRIVER_OUT
-        } else {
+        ALOGV("setFMRadioPath_l() FM Radio Path, (%s)", fmpath);
+        if (setMixerEnum_l(MIXER_CTL_FM_RADIO_PATH, fmpath) == NO_INIT) {
             ALOGE("setFMRadioPath_l() could not get FM Radio Path mixer ctl");
         }
 
-        TRACE_DRIVER_IN(DRV_MIXER_GET)
-        ctl = mixer_get_control(mMixer, "Playback Path", 0);
-        TRACE_DRIVER_OUT
-
         const char *route = getOutputRouteFromDevice(device);
         ALOGV("setFMRadioPath_l() Playpack Path, (%s)", route);
-        if (ctl) {
-            TRACE_DRIVER_IN(DRV_MIXER_SEL)
-            mixer_ctl_select(ctl, route);
-            TRACE_DRIVER_OUT
+        if (getMixerCtl_l(MIXER_CTL_PLAYBACK_PATH) != NULL) {
+            setPlaybackRoute_l(route);
         }
         else {
             ALOGE("setFMRadioPath_l() could not get Playback Path mixer ctl");
@@ -952,24 +1421,34 @@ status_t AudioHardware::setFMRadioPath_l(uint32_t device)
 }
 #endif
 
-struct pcm *AudioHardware::openPcmOut_l()
+struct pcm *AudioHardware::openPcmOut_l(int profile)
 {
-    ALOGD("openPcmOut_l() mPcmOpenCnt: %d", mPcmOpenCnt);
+    ALOGD("openPcmOut_l() mPcmOpenCnt: %d profile: %d", mPcmOpenCnt, profile);
+    if (mPcmOpenCnt > 0 && profile != mPcmProfile) {
+        if (outputConfigTable[profile][OUTPUT_CONFIG_SAMPLE_RATE] != pcmRate_l()) {
+            // the frames would play at the wrong pitch
+            ALOGW("openPcmOut_l() pcm_out already open at %u Hz", pcmRate_l());
+            return NULL;
+        }
+        // in call and FM radio keep the driver open, the stream has to live
+        // with the geometry it was opened with
+        ALOGW("openPcmOut_l() pcm_out already open with profile %d", mPcmProfile);
+    }
     if (mPcmOpenCnt++ == 0) {
         if (mPcm != NULL) {
             ALOGE("openPcmOut_l() mPcmOpenCnt == 0 and mPcm == %p\n", mPcm);
             mPcmOpenCnt--;
             return NULL;
         }
-        unsigned flags = PCM_OUT;
+        unsigned flags = PCM_OUT | (mMmapEnabled ? PCM_MMAP : 0);
 
         struct pcm_config config = {
             channels : 2,
-            rate : AUDIO_HW_OUT_SAMPLERATE,
-            period_size : AUDIO_HW_OUT_PERIOD_SZ,
-            period_count : AUDIO_HW_OUT_PERIOD_CNT,
+            rate : outputConfigTable[profile][OUTPUT_CONFIG_SAMPLE_RATE],
+            period_size : outputConfigTable[profile][OUTPUT_CONFIG_PERIOD_SIZE],
+            period_count : outputConfigTable[profile][OUTPUT_CONFIG_PERIOD_COUNT],
             format : PCM_FORMAT_S16_LE,
-            start_threshold : 0,
+            start_threshold : outputConfigTable[profile][OUTPUT_CONFIG_START_THRESHOLD],
             stop_threshold : 0,
             silence_threshold : 0,
         };
@@ -977,6 +1456,16 @@ struct pcm *AudioHardware::openPcmOut_l()
         TRACE_DRIVER_IN(DRV_PCM_OPEN)
         mPcm = pcm_open(0, 0, flags, &config);
         TRACE_DRIVER_OUT
+        if (!pcm_is_ready(mPcm) && (flags & PCM_MMAP)) {
+            ALOGW("openPcmOut_l() no mmap pcm_out: %s, using read/write", pcm_get_error(mPcm));
+            TRACE_DRIVER_IN(DRV_PCM_CLOSE)
+            pcm_close(mPcm);
+            TRACE_DRIVER_OUT
+            flags &= ~PCM_MMAP;
+            TRACE_DRIVER_IN(DRV_PCM_OPEN)
+            mPcm = pcm_open(0, 0, flags, &config);
+            TRACE_DRIVER_OUT
+        }
         if (!pcm_is_ready(mPcm)) {
             ALOGE("openPcmOut_l() cannot open pcm_out driver: %s\n", pcm_get_error(mPcm));
             TRACE_DRIVER_IN(DRV_PCM_CLOSE)
@@ -984,75 +1473,359 @@ struct pcm *AudioHardware::openPcmOut_l()
             TRACE_DRIVER_OUT
             mPcmOpenCnt--;
             mPcm = NULL;
+        } else {
+            mPcmProfile = profile;
+            mPcmMmap = (flags & PCM_MMAP) != 0;
+            // pcm_open() turns a 0 threshold into the whole buffer
+            mPcmStartThreshold = config.start_threshold;
+            if (mPcmStartThreshold == 0) {
+                mPcmStartThreshold = config.period_size * config.period_count;
+            }
         }
     }
     return mPcm;
 }
 
-void AudioHardware::closePcmOut_l()
+// sets the Playback Path unless it is what the last output applied
+void AudioHardware::setPlaybackRoute_l(const char *route)
 {
-    ALOGD("closePcmOut_l() mPcmOpenCnt: %d", mPcmOpenCnt);
-    if (mPcmOpenCnt == 0) {
-        ALOGE("closePcmOut_l() mPcmOpenCnt == 0");
+    if (mPlaybackRoute != NULL && !strcmp(mPlaybackRoute, route)) {
         return;
     }
-
-    if (--mPcmOpenCnt == 0) {
-        TRACE_DRIVER_IN(DRV_PCM_CLOSE)
-        pcm_close(mPcm);
-        TRACE_DRIVER_OUT
-        mPcm = NULL;
+    ALOGV("setPlaybackRoute_l() %s", route);
+    if (setMixerEnum_l(MIXER_CTL_PLAYBACK_PATH, route) == NO_ERROR) {
+        mPlaybackRoute = route;
     }
 }
 
-struct mixer *AudioHardware::openMixer_l()
+// an output in warm standby keeps the pcm with its geometry, let it go when
+// another profile is about to open the driver
+void AudioHardware::dropWarmOutputs_l(AudioStreamOutALSA *out, int profile)
 {
-    ALOGV("openMixer_l() mMixerOpenCnt: %d", mMixerOpenCnt);
-    if (mMixerOpenCnt++ == 0) {
-        if (mMixer != NULL) {
-            ALOGE("openMixer_l() mMixerOpenCnt == 0 and mMixer == %p\n", mMixer);
-            mMixerOpenCnt--;
-            return NULL;
-        }
-        TRACE_DRIVER_IN(DRV_MIXER_OPEN)
-        mMixer = mixer_open(0);
-        TRACE_DRIVER_OUT
-        if (mMixer == NULL) {
-            ALOGE("openMixer_l() cannot open mixer");
-            mMixerOpenCnt--;
-            return NULL;
+    AudioStreamOutALSA *outputs[] = { mOutput.get(), mFastOutput.get(), mDeepOutput.get(),
+                                      mHdmiOutput.get() };
+
+    for (size_t i = 0; i < sizeof(outputs) / sizeof(outputs[0]); i++) {
+        AudioStreamOutALSA *warm = outputs[i];
+        if (warm != NULL && warm != out && warm->isWarm_l() && profile != mPcmProfile) {
+            ALOGV("dropWarmOutputs_l() closing warm output %p", warm);
+            warm->close_l();
         }
     }
-    return mMixer;
 }
 
-void AudioHardware::closeMixer_l()
+void AudioHardware::setPcmDriver_l(AudioStreamOutALSA *out)
 {
-    ALOGV("closeMixer_l() mMixerOpenCnt: %d", mMixerOpenCnt);
-    if (mMixerOpenCnt == 0) {
-        ALOGE("closeMixer_l() mMixerOpenCnt == 0");
-        return;
+    ALOGV("setPcmDriver_l() %p -> %p", mPcmDriver, out);
+    mPcmDriver = out;
+    mMixCond.broadcast();
+}
+
+void AudioHardware::releasePcmDriver_l(AudioStreamOutALSA *out)
+{
+    if (mPcmDriver == out) {
+        // the queued frames go out with the other output taking over
+        setPcmDriver_l(NULL);
     }
+}
 
-    if (--mMixerOpenCnt == 0) {
-        TRACE_DRIVER_IN(DRV_MIXER_CLOSE)
-        mixer_close(mMixer);
-        TRACE_DRIVER_OUT
-        mMixer = NULL;
+AudioHardware::MixQueue *AudioHardware::mixQueue_l(AudioStreamOutALSA *out)
+{
+    if (out == mFastOutput.get()) {
+        return &mMixQueues[OUTPUT_SLOT_FAST];
+    }
+    if (out == mDeepOutput.get()) {
+        return &mMixQueues[OUTPUT_SLOT_DEEP_BUFFER];
     }
+    return &mMixQueues[OUTPUT_SLOT_PRIMARY];
 }
 
-const char *AudioHardware::getOutputRouteFromDevice(uint32_t device)
+// the longest queue, the driver mixes as many frames as it writes
+size_t AudioHardware::mixFramesIn_l()
 {
-    switch (device) {
-    case AudioSystem::DEVICE_OUT_EARPIECE:
-        return "RCV";
-    case AudioSystem::DEVICE_OUT_SPEAKER:
-        if (mMode == AudioSystem::MODE_RINGTONE) return "RING_SPK";
-        else return "SPK";
-    case AudioSystem::DEVICE_OUT_WIRED_HEADPHONE:
-        if (mMode == AudioSystem::MODE_RINGTONE) return "RING_NO_MIC";
-        else return "HP_NO_MIC";
+    size_t framesIn = 0;
+    for (int i = 0; i < OUTPUT_SLOT_CNT; i++) {
+        if (mMixQueues[i].framesIn > framesIn) {
+            framesIn = mMixQueues[i].framesIn;
+        }
+    }
+    return framesIn;
+}
+
+size_t AudioHardware::pushMixFrames_l(AudioStreamOutALSA *out, const int16_t *frames,
+                                      size_t count)
+{
+    MixQueue *q = mixQueue_l(out);
+    size_t written = 0;
+
+    while (written < count && q->framesIn < AUDIO_HW_OUT_MIX_FRAMES) {
+        size_t pos = (q->read + q->framesIn) % AUDIO_HW_OUT_MIX_FRAMES;
+        size_t chunk = count - written;
+        if (chunk > AUDIO_HW_OUT_MIX_FRAMES - q->framesIn)
+            chunk = AUDIO_HW_OUT_MIX_FRAMES - q->framesIn;
+        if (chunk > AUDIO_HW_OUT_MIX_FRAMES - pos)
+            chunk = AUDIO_HW_OUT_MIX_FRAMES - pos;
+
+        memcpy(q->buf + pos * 2, frames + written * 2, chunk * 2 * sizeof(int16_t));
+        q->framesIn += chunk;
+        written += chunk;
+    }
+    return written;
+}
+
+// saturating int16 add, 16 samples per iteration with neon
+static void mixSamples(int16_t *dst, const int16_t *src, size_t samples)
+{
+    size_t i = 0;
+#if defined(__ARM_NEON__)
+    for (; i + 16 <= samples; i += 16) {
+        int16x8_t d0 = vld1q_s16(dst + i);
+        int16x8_t d1 = vld1q_s16(dst + i + 8);
+        d0 = vqaddq_s16(d0, vld1q_s16(src + i));
+        d1 = vqaddq_s16(d1, vld1q_s16(src + i + 8));
+        vst1q_s16(dst + i, d0);
+        vst1q_s16(dst + i + 8, d1);
+    }
+#endif
+    for (; i < samples; i++) {
+        dst[i] = clamp16((int32_t)dst[i] + src[i]);
+    }
+}
+
+// Scales stereo frames by a Q15 gain going linearly from 'from' to 'to' over
+// the first rampFrames frames, then staying at 'to'. Unity is left alone.
+static void applyGainRamp(int16_t *frames, size_t count, int32_t from, int32_t to,
+                          size_t rampFrames)
+{
+    // Q23 so that the per frame step keeps its precision on short ramps
+    int32_t g = from << 8;
+    int32_t dg = rampFrames ? ((to - from) << 8) / (int32_t)rampFrames : 0;
+    int32_t gmax = (AUDIO_HW_GAIN_UNITY - 1) << 8;
+    size_t i = 0;
+
+    if (rampFrames > count) {
+        rampFrames = count;
+    }
+#if defined(__ARM_NEON__)
+    int32x4_t vg = { g + dg, g + 2 * dg, g + 3 * dg, g + 4 * dg };
+    int32x4_t vdg = vdupq_n_s32(4 * dg);
+    int32x4_t vmax = vdupq_n_s32(gmax);
+    for (; i + 4 <= rampFrames; i += 4) {
+        int16x4_t g4 = vshrn_n_s32(vminq_s32(vg, vmax), 8);
+        int16x4x2_t g8 = vzip_s16(g4, g4);
+        int16x8_t s = vld1q_s16(frames + 2 * i);
+        vst1q_s16(frames + 2 * i, vqrdmulhq_s16(s, vcombine_s16(g8.val[0], g8.val[1])));
+        vg = vaddq_s32(vg, vdg);
+    }
+    g += (int32_t)i * dg;
+#endif
+    for (; i < rampFrames; i++) {
+        g += dg;
+        int32_t gain = ((g < gmax) ? g : gmax) >> 8;
+        frames[2 * i] = (int16_t)((frames[2 * i] * gain + (1 << 14)) >> 15);
+        frames[2 * i + 1] = (int16_t)((frames[2 * i + 1] * gain + (1 << 14)) >> 15);
+    }
+
+    if (to >= AUDIO_HW_GAIN_UNITY) {
+        return;
+    }
+    size_t samples = count * 2;
+    i *= 2;
+#if defined(__ARM_NEON__)
+    for (; i + 8 <= samples; i += 8) {
+        vst1q_s16(frames + i, vqrdmulhq_n_s16(vld1q_s16(frames + i), (int16_t)to));
+    }
+#endif
+    for (; i < samples; i++) {
+        frames[i] = (int16_t)((frames[i] * to + (1 << 14)) >> 15);
+    }
+}
+
+// mix adds the frames queued by all outputs to the ones in frames, otherwise
+// frames is overwritten with their sum
+size_t AudioHardware::pullMixFrames_l(int16_t *frames, size_t count, bool mix)
+{
+    size_t pulled = 0;
+
+    if (!mix) {
+        size_t framesIn = mixFramesIn_l();
+        memset(frames, 0, ((framesIn < count) ? framesIn : count) * 2 * sizeof(int16_t));
+    }
+    for (int i = 0; i < OUTPUT_SLOT_CNT; i++) {
+        MixQueue *q = &mMixQueues[i];
+        size_t read = 0;
+
+        while (read < count && q->framesIn > 0) {
+            size_t chunk = count - read;
+            if (chunk > q->framesIn)
+                chunk = q->framesIn;
+            if (chunk > AUDIO_HW_OUT_MIX_FRAMES - q->read)
+                chunk = AUDIO_HW_OUT_MIX_FRAMES - q->read;
+
+            mixSamples(frames + read * 2, q->buf + q->read * 2, chunk * 2);
+            q->read = (q->read + chunk) % AUDIO_HW_OUT_MIX_FRAMES;
+            q->framesIn -= chunk;
+            read += chunk;
+        }
+        if (read > pulled) {
+            pulled = read;
+        }
+    }
+    if (pulled) {
+        mMixCond.broadcast();
+    }
+    return pulled;
+}
+
+// TIMED_OUT means the driving output stopped writing without going to standby
+status_t AudioHardware::waitMixSpace_l()
+{
+    nsecs_t timeout = ms2ns(2 * mPcmDriver->latency() + 20);
+
+    return mMixCond.waitRelative(mLock, timeout);
+}
+
+void AudioHardware::resetMix_l(AudioStreamOutALSA *out)
+{
+    MixQueue *q = mixQueue_l(out);
+    q->read = 0;
+    q->framesIn = 0;
+    mMixCond.broadcast();
+}
+
+void AudioHardware::closePcmOut_l()
+{
+    ALOGD("closePcmOut_l() mPcmOpenCnt: %d", mPcmOpenCnt);
+    if (mPcmOpenCnt == 0) {
+        ALOGE("closePcmOut_l() mPcmOpenCnt == 0");
+        return;
+    }
+
+    if (--mPcmOpenCnt == 0) {
+        TRACE_DRIVER_IN(DRV_PCM_CLOSE)
+        pcm_close(mPcm);
+        TRACE_DRIVER_OUT
+        mPcm = NULL;
+        // the codec may drop the path with the stream, apply it again
+        mPlaybackRoute = NULL;
+    }
+}
+
+struct mixer *AudioHardware::openMixer_l()
+{
+    ALOGV("openMixer_l() mMixerOpenCnt: %d", mMixerOpenCnt);
+    if (mMixerOpenCnt++ == 0) {
+        if (mMixer != NULL) {
+            ALOGE("openMixer_l() mMixerOpenCnt == 0 and mMixer == %p\n", mMixer);
+            mMixerOpenCnt--;
+            return NULL;
+        }
+        TRACE_DRIVER_IN(DRV_MIXER_OPEN)
+        mMixer = mixer_open(0);
+        TRACE_DRIVER_OUT
+        if (mMixer == NULL) {
+            ALOGE("openMixer_l() cannot open mixer");
+            mMixerOpenCnt--;
+            return NULL;
+        }
+        resolveMixerCtls_l();
+    }
+    return mMixer;
+}
+
+// the name searches are done once here, routing afterwards only compares
+// against the few values of the control it sets
+void AudioHardware::resolveMixerCtls_l()
+{
+    for (int id = 0; id < MIXER_CTL_CNT; id++) {
+        MixerCtl *mc = &mMixerCtls[id];
+
+        TRACE_DRIVER_IN(DRV_MIXER_GET)
+        mc->ctl = mixer_get_ctl_by_name(mMixer, mixerCtlNames[id]);
+        TRACE_DRIVER_OUT
+        mc->numEnums = 0;
+        mc->lastValue = NULL;
+        if (mc->ctl == NULL) {
+            ALOGV("resolveMixerCtls_l() no %s control", mixerCtlNames[id]);
+            continue;
+        }
+
+        unsigned int num = mixer_ctl_get_num_enums(mc->ctl);
+        if (num > MIXER_CTL_MAX_ENUMS) {
+            ALOGW("resolveMixerCtls_l() %s has %u values, keeping %d",
+                  mixerCtlNames[id], num, MIXER_CTL_MAX_ENUMS);
+            num = MIXER_CTL_MAX_ENUMS;
+        }
+        for (unsigned int i = 0; i < num; i++) {
+            mc->enums[i] = mixer_ctl_get_enum_string(mc->ctl, i);
+        }
+        mc->numEnums = num;
+    }
+}
+
+// value is usually one of our route literals, the last one is remembered
+// by address so repeated routes don't even compare strings
+status_t AudioHardware::setMixerEnum_l(int id, const char *value)
+{
+    MixerCtl *mc = &mMixerCtls[id];
+    int index = -1;
+
+    if (mc->ctl == NULL) {
+        return NO_INIT;
+    }
+
+    if (value == mc->lastValue) {
+        index = mc->lastIndex;
+    } else {
+        for (unsigned int i = 0; i < mc->numEnums; i++) {
+            if (mc->enums[i] != NULL && !strcmp(mc->enums[i], value)) {
+                index = i;
+                break;
+            }
+        }
+        if (index < 0) {
+            ALOGE("setMixerEnum_l() %s has no value %s", mixerCtlNames[id], value);
+            return BAD_VALUE;
+        }
+        mc->lastValue = value;
+        mc->lastIndex = index;
+    }
+
+    TRACE_DRIVER_IN(DRV_MIXER_SEL)
+    int rc = mixer_ctl_set_value(mc->ctl, 0, index);
+    TRACE_DRIVER_OUT
+    return rc == 0 ? NO_ERROR : INVALID_OPERATION;
+}
+
+void AudioHardware::closeMixer_l()
+{
+    ALOGV("closeMixer_l() mMixerOpenCnt: %d", mMixerOpenCnt);
+    if (mMixerOpenCnt == 0) {
+        ALOGE("closeMixer_l() mMixerOpenCnt == 0");
+        return;
+    }
+
+    if (--mMixerOpenCnt == 0) {
+        // the control handles and value strings belong to the mixer
+        memset(mMixerCtls, 0, sizeof(mMixerCtls));
+        TRACE_DRIVER_IN(DRV_MIXER_CLOSE)
+        mixer_close(mMixer);
+        TRACE_DRIVER_OUT
+        mMixer = NULL;
+    }
+}
+
+const char *AudioHardware::getOutputRouteFromDevice(uint32_t device)
+{
+    switch (device) {
+    case AudioSystem::DEVICE_OUT_EARPIECE:
+        return "RCV";
+    case AudioSystem::DEVICE_OUT_SPEAKER:
+        if (mMode == AudioSystem::MODE_RINGTONE) return "RING_SPK";
+        else return "SPK";
+    case AudioSystem::DEVICE_OUT_WIRED_HEADPHONE:
+        if (mMode == AudioSystem::MODE_RINGTONE) return "RING_NO_MIC";
+        else return "HP_NO_MIC";
     case AudioSystem::DEVICE_OUT_WIRED_HEADSET:
         if (mMode == AudioSystem::MODE_RINGTONE) return "RING_HP";
         else return "HP";
@@ -1064,6 +1837,9 @@ const char *AudioHardware::getOutputRouteFromDevice(uint32_t device)
     case AudioSystem::DEVICE_OUT_BLUETOOTH_SCO_HEADSET:
     case AudioSystem::DEVICE_OUT_BLUETOOTH_SCO_CARKIT:
         return "BT";
+    case AudioSystem::DEVICE_OUT_AUX_DIGITAL:
+        // the HDMI link takes the frames off the I2S, the codec outputs stay off
+        return "OFF";
     default:
         return "OFF";
     }
@@ -1126,6 +1902,23 @@ const char *AudioHardware::getInputRouteFromDevice(uint32_t device)
     }
 }
 
+// the codec has a single clock for both directions, the capture can only run at its own
+// rate while no output has the pcm open
+bool AudioHardware::nativeCaptureRate_l(uint32_t sampleRate)
+{
+    size_t size = sizeof(inputConfigTable)/sizeof(uint32_t)/INPUT_CONFIG_CNT;
+
+    if (!mNativeCapture || mPcmOpenCnt != 0 || sampleRate == AUDIO_HW_IN_SAMPLERATE) {
+        return false;
+    }
+    for (size_t i = 0; i < size; i++) {
+        if (inputConfigTable[i][INPUT_CONFIG_SAMPLE_RATE] == sampleRate) {
+            return inputConfigTable[i][INPUT_CONFIG_NATIVE] != 0;
+        }
+    }
+    return false;
+}
+
 uint32_t AudioHardware::getInputSampleRate(uint32_t sampleRate)
 {
     size_t i;
@@ -1142,6 +1935,23 @@ uint32_t AudioHardware::getInputSampleRate(uint32_t sampleRate)
 }
 
 // getActiveInput_l() must be called with mLock held
+sp <AudioHardware::AudioStreamOutALSA> AudioHardware::pcmOutput_l()
+{
+    if (mHdmiOutput != 0 && mPcmDriver == mHdmiOutput.get()) {
+        return mHdmiOutput;
+    }
+    if (mDeepOutput != 0 && mPcmDriver == mDeepOutput.get()) {
+        return mDeepOutput;
+    }
+    if (mFastOutput != 0 && mPcmDriver == mFastOutput.get()) {
+        return mFastOutput;
+    }
+    if (mOutput != 0 && mPcmDriver == mOutput.get()) {
+        return mOutput;
+    }
+    return NULL;
+}
+
 sp <AudioHardware::AudioStreamInALSA> AudioHardware::getActiveInput_l()
 {
     sp< AudioHardware::AudioStreamInALSA> spIn;
@@ -1164,10 +1974,7 @@ status_t AudioHardware::setInputSource_l(audio_source source)
      if (source != mInputSource) {
          if ((source == AUDIO_SOURCE_DEFAULT) || (mMode != AudioSystem::MODE_IN_CALL)) {
              if (mMixer) {
-                 TRACE_DRIVER_IN(DRV_MIXER_GET)
-                 struct mixer_ctl *ctl= mixer_get_ctl_by_name(mMixer, "Input Source");
-                 TRACE_DRIVER_OUT
-                 if (ctl == NULL) {
+                 if (getMixerCtl_l(MIXER_CTL_INPUT_SOURCE) == NULL) {
                      return NO_INIT;
                  }
                  const char* sourceName;
@@ -1189,10 +1996,8 @@ status_t AudioHardware::setInputSource_l(audio_source source)
                      default:
                          return NO_INIT;
                  }
-                 ALOGV("mixer_ctl_set_enum_by_string, Input Source, (%s)", sourceName);
-                 TRACE_DRIVER_IN(DRV_MIXER_SEL)
-                 mixer_ctl_set_enum_by_string(ctl, sourceName);
-                 TRACE_DRIVER_OUT
+                 ALOGV("setMixerEnum_l, Input Source, (%s)", sourceName);
+                 setMixerEnum_l(MIXER_CTL_INPUT_SOURCE, sourceName);
              }
          }
          mInputSource = source;
@@ -1201,9 +2006,22 @@ status_t AudioHardware::setInputSource_l(audio_source source)
      return NO_ERROR;
 }
 
-struct echo_reference_itfe *AudioHardware::getEchoReference(audio_format_t format,
-                                                              uint32_t channelCount,
-                                                              uint32_t samplingRate)
+int AudioHardware::inputProfile_l() const
+{
+    switch (mInputSource) {
+    case AUDIO_SOURCE_VOICE_RECOGNITION:
+    case AUDIO_SOURCE_VOICE_COMMUNICATION:
+        return INPUT_PROFILE_LOW_LATENCY;
+    case AUDIO_SOURCE_CAMCORDER:
+        return INPUT_PROFILE_LONG;
+    default:
+        return INPUT_PROFILE_NORMAL;
+    }
+}
+
+EchoReference *AudioHardware::getEchoReference(audio_format_t format,
+                                               uint32_t channelCount,
+                                               uint32_t samplingRate)
 {
     ALOGV("AudioHardware::getEchoReference %p", mEchoReference);
     releaseEchoReference(mEchoReference);
@@ -1211,32 +2029,374 @@ struct echo_reference_itfe *AudioHardware::getEchoReference(audio_format_t forma
         uint32_t wrChannelCount = popcount(mOutput->channels());
         uint32_t wrSampleRate = mOutput->sampleRate();
 
-        int status = create_echo_reference(AUDIO_FORMAT_PCM_16_BIT,
-                              channelCount,
-                              samplingRate,
-                              AUDIO_FORMAT_PCM_16_BIT,
-                              wrChannelCount,
-                              wrSampleRate,
-                              &mEchoReference);
-        if (status == 0) {
+        mEchoReference = new EchoReference(channelCount,
+                                           samplingRate,
+                                           wrChannelCount,
+                                           wrSampleRate);
+        if (mEchoReference->initCheck() == NO_ERROR) {
             mOutput->addEchoReference(mEchoReference);
+        } else {
+            delete mEchoReference;
+            mEchoReference = NULL;
         }
     }
     return mEchoReference;
 }
 
-void AudioHardware::releaseEchoReference(struct echo_reference_itfe *reference)
+void AudioHardware::releaseEchoReference(EchoReference *reference)
 {
     ALOGV("AudioHardware::releaseEchoReference %p", mEchoReference);
     if (mEchoReference != NULL && reference == mEchoReference) {
         if (mOutput != NULL) {
             mOutput->removeEchoReference(reference);
         }
-        release_echo_reference(mEchoReference);
+        delete mEchoReference;
         mEchoReference = NULL;
     }
 }
 
+//------------------------------------------------------------------------------
+//  StreamStats
+//------------------------------------------------------------------------------
+
+void StreamStats::reset()
+{
+    memset(this, 0, sizeof(*this));
+}
+
+void StreamStats::onCall(nsecs_t now)
+{
+    if (lastCallNs != 0) {
+        nsecs_t ms = (now - lastCallNs) / 1000000;
+        int bin = 0;
+        while (bin < STATS_HIST_BINS - 1 && ms >= (1 << bin)) {
+            bin++;
+        }
+        intervalHist[bin]++;
+    }
+    lastCallNs = now;
+}
+
+void StreamStats::onIo(nsecs_t start, nsecs_t end)
+{
+    nsecs_t ns = end - start;
+    ioCount++;
+    ioTotalNs += ns;
+    if (ns > ioMaxNs) {
+        ioMaxNs = ns;
+    }
+}
+
+void StreamStats::onEnterStandby(nsecs_t now)
+{
+    standbyEnter++;
+    standbyStartNs = now;
+    // the first call after standby is no interval
+    lastCallNs = 0;
+}
+
+void StreamStats::onExitStandby(nsecs_t now)
+{
+    standbyExit++;
+    if (standbyStartNs != 0) {
+        nsecs_t ns = now - standbyStartNs;
+        standbyTotalNs += ns;
+        if (ns > standbyMaxNs) {
+            standbyMaxNs = ns;
+        }
+        standbyStartNs = 0;
+    }
+}
+
+void StreamStats::dump(String8& result, const char *xrunName) const
+{
+    const size_t SIZE = 256;
+    char buffer[SIZE];
+
+    snprintf(buffer, SIZE, "\t\tCall interval (ms) <1:%u <2:%u <4:%u <8:%u <16:%u <32:%u "
+             "<64:%u >=64:%u\n",
+             intervalHist[0], intervalHist[1], intervalHist[2], intervalHist[3],
+             intervalHist[4], intervalHist[5], intervalHist[6], intervalHist[7]);
+    result.append(buffer);
+    snprintf(buffer, SIZE, "\t\tTransfers: %u, avg %lld us, max %lld us\n", ioCount,
+             ioCount ? (long long)(ioTotalNs / ioCount / 1000) : 0LL,
+             (long long)(ioMaxNs / 1000));
+    result.append(buffer);
+    snprintf(buffer, SIZE, "\t\t%s: %u, errors: %u\n", xrunName, xruns, errors);
+    result.append(buffer);
+    snprintf(buffer, SIZE, "\t\tStandby enter %u exit %u, total %lld ms, max %lld ms\n",
+             standbyEnter, standbyExit, (long long)(standbyTotalNs / 1000000),
+             (long long)(standbyMaxNs / 1000000));
+    result.append(buffer);
+}
+
+//------------------------------------------------------------------------------
+//  EchoReference
+//------------------------------------------------------------------------------
+
+static int echoRefGetNextBuffer(struct resampler_buffer_provider *provider,
+                                struct resampler_buffer* buffer)
+{
+    return ((EchoReference::BufferProvider *)provider)->mReference->getNextBuffer(buffer);
+}
+
+static void echoRefReleaseBuffer(struct resampler_buffer_provider *provider,
+                                 struct resampler_buffer* buffer)
+{
+    ((EchoReference::BufferProvider *)provider)->mReference->releaseBuffer(buffer);
+}
+
+EchoReference::EchoReference(uint32_t rdChannelCount, uint32_t rdSampleRate,
+                             uint32_t wrChannelCount, uint32_t wrSampleRate) :
+    mRdChannelCount(rdChannelCount), mRdSampleRate(rdSampleRate),
+    mWrChannelCount(wrChannelCount), mWrSampleRate(wrSampleRate),
+    mRing(NULL), mRingFrames(1), mSeq(0), mWrHead(0), mWr(0), mWrStopped(true),
+    mRd(0), mRdLimit(0), mResampler(NULL)
+{
+    memset(&mMark, 0, sizeof(mMark));
+
+    if ((rdChannelCount != 1 && rdChannelCount != 2) ||
+            (wrChannelCount != 1 && wrChannelCount != 2)) {
+        ALOGE("EchoReference() unsupported channel counts rd %d wr %d",
+              rdChannelCount, wrChannelCount);
+        return;
+    }
+
+    while (mRingFrames < (wrSampleRate * ECHO_REF_RING_MS) / 1000) {
+        mRingFrames <<= 1;
+    }
+
+    if (rdSampleRate != wrSampleRate) {
+        mProvider.mProvider.get_next_buffer = echoRefGetNextBuffer;
+        mProvider.mProvider.release_buffer = echoRefReleaseBuffer;
+        mProvider.mReference = this;
+        int status = create_resampler(wrSampleRate,
+                                      rdSampleRate,
+                                      rdChannelCount,
+                                      RESAMPLER_QUALITY_VOIP,
+                                      &mProvider.mProvider,
+                                      &mResampler);
+        if (status != 0) {
+            ALOGE("EchoReference() resampler init failed: %d", status);
+            mResampler = NULL;
+            return;
+        }
+    }
+
+    mRing = new int16_t[mRingFrames * rdChannelCount];
+}
+
+EchoReference::~EchoReference()
+{
+    if (mResampler != NULL) {
+        release_resampler(mResampler);
+    }
+    delete[] mRing;
+}
+
+void EchoReference::write(const struct echo_reference_buffer *b)
+{
+    Mark mark = mMark;
+
+    if (b == NULL) {
+        if (mWrStopped) {
+            return;
+        }
+        mWrStopped = true;
+        mark.renderNs = 0;
+    } else {
+        if (mWrStopped) {
+            // frames still in the ring don't follow these ones
+            mWrStopped = false;
+            mark.start = mWr;
+        }
+
+        // never wait for the reader, what it could not keep up with is overwritten
+        uint32_t frames = b->frame_count;
+        const int16_t *src = (const int16_t *)b->raw;
+        if (frames > mRingFrames) {
+            src += (frames - mRingFrames) * mWrChannelCount;
+            frames = mRingFrames;
+        }
+        // the reader checks the head after its copy, so it must be out before
+        // any of the frames it covers
+        android_atomic_release_store((int32_t)(mWr + frames), &mWrHead);
+        android_memory_barrier();
+        for (uint32_t i = 0; i < frames; i++) {
+            int16_t *dst = mRing + ((mWr + i) & (mRingFrames - 1)) * mRdChannelCount;
+            if (mWrChannelCount == mRdChannelCount) {
+                dst[0] = src[0];
+                if (mRdChannelCount == 2) {
+                    dst[1] = src[1];
+                }
+            } else if (mWrChannelCount == 2) {
+                dst[0] = (int16_t)(((int32_t)src[0] + src[1]) >> 1);
+            } else {
+                dst[0] = dst[1] = src[0];
+            }
+            src += mWrChannelCount;
+        }
+        mWr += frames;
+
+        mark.end = mWr;
+        mark.renderNs = (int64_t)b->time_stamp.tv_sec * 1000000000LL +
+                        b->time_stamp.tv_nsec + b->delay_ns;
+        if (mark.renderNs == 0) {
+            mark.renderNs = 1;
+        }
+    }
+
+    // odd while the mark is being updated, the frames above are visible before it
+    android_atomic_release_store(mSeq + 1, &mSeq);
+    android_memory_barrier();
+    mMark = mark;
+    android_atomic_release_store(mSeq + 1, &mSeq);
+}
+
+void EchoReference::loadMark(Mark *mark)
+{
+    int32_t seq;
+    do {
+        while ((seq = android_atomic_acquire_load(&mSeq)) & 1) {
+            sched_yield();
+        }
+        *mark = *(volatile Mark *)&mMark;
+        android_memory_barrier();
+    } while (seq != android_atomic_acquire_load(&mSeq));
+}
+
+// true when the writer got around the ring onto frames read since from
+bool EchoReference::lapped(uint32_t from)
+{
+    // what was copied is read before the head is
+    android_memory_barrier();
+    uint32_t head = (uint32_t)android_atomic_acquire_load(&mWrHead);
+    return head - from > mRingFrames;
+}
+
+void EchoReference::skip(uint32_t frames)
+{
+    mRd += frames;
+    if (mResampler != NULL) {
+        mResampler->reset(mResampler);
+    }
+}
+
+status_t EchoReference::read(struct echo_reference_buffer *b)
+{
+    Mark mark;
+
+    loadMark(&mark);
+
+    if (b == NULL) {
+        skip(mark.end - mRd);
+        return NO_ERROR;
+    }
+
+    size_t frames = b->frame_count;
+    // the capture delay comes in the field the echo delay goes out in
+    int64_t captureDelayNs = b->delay_ns;
+    b->frame_count = 0;
+    b->delay_ns = 0;
+
+    if (mark.renderNs == 0) {
+        skip(mark.end - mRd);
+        return NOT_ENOUGH_DATA;
+    }
+    // older than the restart of the output, or already overwritten
+    if ((int32_t)(mRd - mark.start) < 0) {
+        skip(mark.start - mRd);
+    }
+    // the writer may be over the oldest frames right now
+    uint32_t head = (uint32_t)android_atomic_acquire_load(&mWrHead);
+    if (head - mRd > mRingFrames) {
+        skip(head - mRingFrames - mRd);
+    }
+
+    int64_t captureNs = (int64_t)b->time_stamp.tv_sec * 1000000000LL +
+                        b->time_stamp.tv_nsec - captureDelayNs;
+    int64_t refNs = mark.renderNs -
+                    ((int64_t)(int32_t)(mark.end - 1 - mRd) * 1000000000LL) / mWrSampleRate;
+    int64_t delayNs = captureNs - refNs;
+
+    if (delayNs > (int64_t)ECHO_REF_SYNC_MS * 1000000) {
+        uint32_t drop = (uint32_t)((delayNs * mWrSampleRate) / 1000000000LL);
+        if (drop > mark.end - mRd) {
+            drop = mark.end - mRd;
+        }
+        ALOGV("EchoReference::read() dropping %u frames, delay %lld ns", drop, delayNs);
+        skip(drop);
+        delayNs -= ((int64_t)drop * 1000000000LL) / mWrSampleRate;
+    } else if (delayNs < -(int64_t)ECHO_REF_SYNC_MS * 1000000) {
+        // not rendered yet when this capture was made
+        return NOT_ENOUGH_DATA;
+    }
+    if (delayNs < 0) {
+        delayNs = 0;
+    }
+
+    uint32_t from = mRd;
+    mRdLimit = mark.end;
+    if (mResampler == NULL) {
+        int16_t *dst = (int16_t *)b->raw;
+        uint32_t avail = mRdLimit - mRd;
+        if (frames > avail) {
+            frames = avail;
+        }
+        for (size_t done = 0; done < frames; ) {
+            uint32_t rd = mRd & (mRingFrames - 1);
+            size_t count = mRingFrames - rd;
+            if (count > frames - done) {
+                count = frames - done;
+            }
+            memcpy(dst + done * mRdChannelCount, mRing + rd * mRdChannelCount,
+                   count * mRdChannelCount * sizeof(int16_t));
+            mRd += count;
+            done += count;
+        }
+    } else {
+        mResampler->resample_from_provider(mResampler, (int16_t *)b->raw, &frames);
+        delayNs += mResampler->delay_ns(mResampler);
+    }
+
+    if (lapped(from)) {
+        // some of it was overwritten while copied, the next read resyncs
+        // on the oldest frames still in the ring
+        ALOGV("EchoReference::read() overrun, %u frames dropped", mRd - from);
+        skip(0);
+        return NOT_ENOUGH_DATA;
+    }
+
+    b->frame_count = frames;
+    b->delay_ns = (int32_t)delayNs;
+    return frames != 0 ? NO_ERROR : NOT_ENOUGH_DATA;
+}
+
+int EchoReference::getNextBuffer(struct resampler_buffer *buffer)
+{
+    uint32_t rd = mRd & (mRingFrames - 1);
+    size_t avail = mRdLimit - mRd;
+
+    if (avail > mRingFrames - rd) {
+        avail = mRingFrames - rd;
+    }
+    if (avail == 0) {
+        buffer->raw = NULL;
+        buffer->frame_count = 0;
+        return NOT_ENOUGH_DATA;
+    }
+    if (buffer->frame_count > avail) {
+        buffer->frame_count = avail;
+    }
+    buffer->i16 = mRing + rd * mRdChannelCount;
+    return 0;
+}
+
+void EchoReference::releaseBuffer(struct resampler_buffer *buffer)
+{
+    mRd += buffer->frame_count;
+}
+
 
 //------------------------------------------------------------------------------
 //  AudioStreamOutALSA
@@ -1246,12 +2406,20 @@ AudioHardware::AudioStreamOutALSA::AudioStreamOutALSA() :
     mHardware(0), mPcm(0), mMixer(0), mRouteCtl(0),
     mStandby(true), mDevices(0), mChannels(AUDIO_HW_OUT_CHANNELS),
     mSampleRate(AUDIO_HW_OUT_SAMPLERATE), mBufferSize(AUDIO_HW_OUT_PERIOD_BYTES),
+    mProfile(OUTPUT_PROFILE_NORMAL),
+    mMixing(false), mMixScratch(NULL), mMixScratchSize(0),
+    mFramesWritten(0), mFramesPresentedBase(0), mPresentedFrames(0),
+    mMmapStarted(false), mErrorPaceNs(0), mStandbyDeadline(0),
+    mRoutePending(false), mPendingDevices(0), mRouteReqNs(0),
+    mRampPos(AUDIO_HW_OUT_SAMPLERATE * AUDIO_HW_ROUTE_RAMP_MS / 1000),
     mDriverOp(DRV_NONE), mStandbyCnt(0), mSleepReq(false), mEchoReference(NULL)
 {
+    mPresentedTime.tv_sec = 0;
+    mPresentedTime.tv_nsec = 0;
 }
 
 status_t AudioHardware::AudioStreamOutALSA::set(
-    AudioHardware* hw, uint32_t devices, int *pFormat,
+    AudioHardware* hw, uint32_t devices, int profile, int *pFormat,
     uint32_t *pChannels, uint32_t *pRate)
 {
     int lFormat = pFormat ? *pFormat : 0;
@@ -1260,6 +2428,7 @@ status_t AudioHardware::AudioStreamOutALSA::set(
 
     mHardware = hw;
     mDevices = devices;
+    mSampleRate = outputConfigTable[profile][OUTPUT_CONFIG_SAMPLE_RATE];
 
     // fix up defaults
     if (lFormat == 0) lFormat = format();
@@ -1282,14 +2451,72 @@ status_t AudioHardware::AudioStreamOutALSA::set(
 
     mChannels = lChannels;
     mSampleRate = lRate;
-    mBufferSize = AUDIO_HW_OUT_PERIOD_BYTES;
+    mProfile = profile;
+    // one kernel period per write
+    mBufferSize = outputConfigTable[profile][OUTPUT_CONFIG_PERIOD_SIZE] * frameSize();
 
     return NO_ERROR;
 }
 
 AudioHardware::AudioStreamOutALSA::~AudioStreamOutALSA()
 {
-    standby();
+    if (mHardware != NULL) {
+        AutoMutex lock(mLock);
+        AutoMutex hwLock(mHardware->lock());
+        // no warm standby for a closed stream
+        doStandby_l();
+    }
+    delete[] mMixScratch;
+}
+
+int16_t *AudioHardware::AudioStreamOutALSA::mixScratch(size_t bytes)
+{
+    if (mMixScratchSize < bytes) {
+        delete[] mMixScratch;
+        mMixScratch = new int16_t[bytes / sizeof(int16_t)];
+        mMixScratchSize = mMixScratch != NULL ? bytes : 0;
+    }
+    return mMixScratch;
+}
+
+// queues the frames for the output driving the pcm. When that one goes to
+// standby or stops draining, this output drives the pcm from now on and
+// buffer/bytes are left pointing at what it has to write itself
+status_t AudioHardware::AudioStreamOutALSA::writeMixed_l(const uint8_t **buffer, size_t *bytes)
+{
+    AutoMutex hwLock(mHardware->lock());
+    const int16_t *src = (const int16_t *)*buffer;
+    size_t frames = *bytes / frameSize();
+    size_t done = 0;
+
+    while (done < frames && mHardware->pcmDriverActive_l()) {
+        done += mHardware->pushMixFrames_l(this, src + done * 2, frames - done);
+        if (done < frames && mHardware->waitMixSpace_l() != NO_ERROR) {
+            break;
+        }
+    }
+    if (done == frames) {
+        *bytes = 0;
+        return NO_ERROR;
+    }
+
+    size_t queued = mHardware->mixFramesIn_l();
+    ALOGD("AudioHardware pcm playback takes over the driver, %d frames queued", queued);
+    size_t size = (queued + frames - done) * frameSize();
+    int16_t *out = mixScratch(size);
+    if (out == NULL) {
+        return NO_MEMORY;
+    }
+    mHardware->pullMixFrames_l(out, queued, false);
+    memcpy(out + queued * 2, src + done * 2, (frames - done) * frameSize());
+    mMixing = false;
+
+    if (open_l() != NO_ERROR) {
+        return NO_INIT;
+    }
+    *buffer = (const uint8_t *)out;
+    *bytes = size;
+    return NO_ERROR;
 }
 
 int AudioHardware::AudioStreamOutALSA::getPlaybackDelay(size_t frames,
@@ -1311,7 +2538,7 @@ int AudioHardware::AudioStreamOutALSA::getPlaybackDelay(size_t frames,
     // adjust render time stamp with delay added by current driver buffer.
     // Add the duration of current frame as we want the render time of the last
     // sample being written.
-    long delayNs = (long)(((int64_t)(kernelFr + frames)* 1000000000) /AUDIO_HW_OUT_SAMPLERATE);
+    long delayNs = (long)(((int64_t)(kernelFr + frames)* 1000000000) / sampleRate());
 
     ALOGV("AudioStreamOutALSA::getPlaybackDelay delayNs: [%ld], "\
          "kernelFr:[%d], frames:[%d], buffSize:[%d], time_stamp:[%ld].[%ld]",
@@ -1326,9 +2553,13 @@ int AudioHardware::AudioStreamOutALSA::getPlaybackDelay(size_t frames,
 ssize_t AudioHardware::AudioStreamOutALSA::write(const void* buffer, size_t bytes)
 {
     //ALOGV("-----AudioStreamInALSA::write(%p, %d) START", buffer, (int)bytes);
+    SEC_TRACE_SCOPE("audio:write");
     status_t status = NO_INIT;
     const uint8_t* p = static_cast<const uint8_t*>(buffer);
+    size_t count = bytes;
+    bool mixInPlace = false;
     int ret;
+    nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
 
     if (mHardware == NULL) return NO_INIT;
 
@@ -1341,11 +2572,56 @@ ssize_t AudioHardware::AudioStreamOutALSA::write(const void* buffer, size_t byte
     { // scope for the lock
 
         AutoMutex lock(mLock);
+        bool wasStandby = mStandby;
+        mStats.onCall(now);
+
+        if (mStandbyDeadline != 0) {
+            // back within the standby delay, the pcm is prepared and routed
+            mStandbyDeadline = 0;
+            AutoMutex hwLock(mHardware->lock());
+            if (!mHardware->pcmDriverActive_l()) {
+                mHardware->setPcmDriver_l(this);
+            }
+        }
+
+        // a stopped output just opens on the new route
+        uint32_t devices;
+        bool reroute = takePendingRoute(now, mStandby, &devices);
+        if (reroute && mStandby) {
+            mDevices = devices;
+            reroute = false;
+        }
+
+        if (mStandby) {
+            AutoMutex hwLock(mHardware->lock());
+
+            if (mHardware->pcmDriverActive_l() && mHardware->pcmRate_l() != mSampleRate) {
+                goto Busy;
+            }
+            if (mHardware->pcmDriverActive_l()) {
+                // the other output plays, mix into it rather than reopening the pcm
+                ALOGD("AudioHardware pcm playback is exiting standby, mixed.");
+                mMixing = true;
+                mStandby = false;
+            }
+        }
+
+        if (mStandby && mPcm != NULL) {
+            AutoMutex hwLock(mHardware->lock());
+
+            // warm standby, the pcm is still configured and the input can stay
+            ALOGV("AudioHardware pcm playback is exiting warm standby.");
+            if (open_l() != NO_ERROR) {
+                goto Error;
+            }
+            mStandby = false;
+        }
 
         if (mStandby) {
             AutoMutex hwLock(mHardware->lock());
 
             ALOGD("AudioHardware pcm playback is exiting standby.");
+            mHardware->dropWarmOutputs_l(this, mProfile);
             sp<AudioStreamInALSA> spIn = mHardware->getActiveInput_l();
             while (spIn != 0) {
                 int cnt = spIn->prepareLock();
@@ -1382,36 +2658,188 @@ ssize_t AudioHardware::AudioStreamOutALSA::write(const void* buffer, size_t byte
             mStandby = false;
         }
 
-        if (mEchoReference != NULL) {
-            struct echo_reference_buffer b;
-            b.raw = (void *)buffer;
-            b.frame_count = bytes / frameSize();
+        if (wasStandby && !mStandby) {
+            mStats.onExitStandby(now);
+        }
 
-            getPlaybackDelay(bytes / frameSize(), &b);
-            mEchoReference->write(mEchoReference, &b);
+        if (!mMixing) {
+            AutoMutex hwLock(mHardware->lock());
+
+            if (!mHardware->isPcmDriver_l(this)) {
+                // the other output took the driver while we were not writing
+                ALOGD("AudioHardware pcm playback is mixed from now on.");
+                close_l();
+                mMixing = true;
+            } else if (mHardware->pcmMmap_l()) {
+                // the other output is mixed in place in the DMA buffer
+                mixInPlace = mHardware->mixFramesIn_l() > 0;
+            } else if (mHardware->mixFramesIn_l() > 0) {
+                int16_t *mixed = mixScratch(count);
+                if (mixed != NULL) {
+                    memcpy(mixed, p, count);
+                    mHardware->pullMixFrames_l(mixed, count / frameSize(), true);
+                    p = (const uint8_t *)mixed;
+                }
+            }
         }
 
-        TRACE_DRIVER_IN(DRV_PCM_WRITE)
-        ret = pcm_write(mPcm,(void*) p, bytes);
-        TRACE_DRIVER_OUT
+        if (reroute) {
+            AutoMutex hwLock(mHardware->lock());
+            // the output driving the pcm owns the path, in call the modem does
+            if (mMixing || mHardware->mode() == AudioSystem::MODE_IN_CALL ||
+                    !strcmp(mHardware->getOutputRouteFromDevice(devices),
+                            mHardware->getOutputRouteFromDevice(mDevices))) {
+                mDevices = devices;
+                reroute = false;
+            }
+        }
 
-        if (ret == 0) {
-            //ALOGV("-----AudioStreamInALSA::write(%p, %d) END", buffer, (int)bytes);
-            return bytes;
+        if (mMixing) {
+            status = writeMixed_l(&p, &count);
+            if (status != NO_ERROR) {
+                goto Error;
+            }
+            if (count == 0) {
+                return bytes;
+            }
         }
-        ALOGW("write error: %d", errno);
-        status = -errno;
+
+        if (reroute) {
+            p = rampFrames_l(p, count, true, &mixInPlace);
+        } else if (mRampPos < mSampleRate * AUDIO_HW_ROUTE_RAMP_MS / 1000) {
+            p = rampFrames_l(p, count, false, &mixInPlace);
+        }
+        p = applyMasterGain_l(p, count, &mixInPlace);
+
+        size_t frames = count / frameSize();
+        if (!mHardware->pcmMmap_l()) {
+            size_t avail;
+            struct timespec tstamp;
+            if (pcm_get_htimestamp(mPcm, &avail, &tstamp) == 0) {
+                if (avail >= pcm_get_buffer_size(mPcm)) {
+                    mStats.xruns++;
+                }
+            } else if (mFramesWritten >= mHardware->pcmStartThreshold_l()) {
+                // it should be running, the driver stopped it on underrun
+                mStats.xruns++;
+            }
+
+            if (mEchoReference != NULL) {
+                struct echo_reference_buffer b;
+                b.raw = (void *)p;
+                b.frame_count = count / frameSize();
+
+                getPlaybackDelay(count / frameSize(), &b);
+                mEchoReference->write(&b);
+            }
+        }
+
+        for (int retry = 0; ; retry++) {
+            nsecs_t ioStart = systemTime(SYSTEM_TIME_MONOTONIC);
+            SEC_TRACE_BEGIN("audio:pcm_write");
+            if (mHardware->pcmMmap_l()) {
+                // p and count advance with what was committed, a retry resumes
+                ret = writeMmap_l(&p, &count, mixInPlace);
+            } else {
+                TRACE_DRIVER_IN(DRV_PCM_WRITE)
+                ret = pcm_write(mPcm,(void*) p, count);
+                TRACE_DRIVER_OUT
+                if (ret != 0) {
+                    ret = -errno;
+                }
+            }
+            SEC_TRACE_END();
+            mStats.onIo(ioStart, systemTime(SYSTEM_TIME_MONOTONIC));
+
+            if (ret == 0) {
+                mFramesWritten += frames;
+                mErrorPaceNs = 0;
+                updatePresentation_l();
+                if (reroute) {
+                    switchRoute_l(devices, frames / 2);
+                }
+                //ALOGV("-----AudioStreamInALSA::write(%p, %d) END", buffer, (int)bytes);
+                return bytes;
+            }
+            ALOGW("write error: %d", ret);
+            if (retry == AUDIO_HW_XRUN_RETRIES || recover_l() != NO_ERROR) {
+                break;
+            }
+            mStats.errors++;
+        }
+        if (reroute) {
+            // reopened on the new path after standby
+            mDevices = devices;
+        }
+        status = ret;
     }
 Error:
-    standby();
+    mStats.errors++;
+    standbyNow();
 
-    // Simulate audio output timing in case of error
-    usleep((((bytes * 1000) / frameSize()) * 1000) / sampleRate());
+    paceFailedIo(&mErrorPaceNs, now, bytes / frameSize(), sampleRate());
     ALOGE("AudioStreamOutALSA::write END WITH ERROR !!!!!!!!!(%p, %u)", buffer, bytes);
     return status;
+
+Busy:
+    // the other output has the pcm at its own rate, this one is silent
+    // until it lets go
+    paceFailedIo(&mErrorPaceNs, now, bytes / frameSize(), sampleRate());
+    return bytes;
 }
 
+// AudioFlinger calls this long after the last frames played. The pcm is only
+// prepared, which drops the stale data silently, and the driver role handed
+// back. The stream goes to standby if no write comes within the delay.
 status_t AudioHardware::AudioStreamOutALSA::standby()
+{
+    if (mHardware == NULL) return NO_INIT;
+    if (mHardware->standbyDelayMs() == 0) return standbyNow();
+
+    nsecs_t deadline;
+    mSleepReq = true;
+    {
+        AutoMutex lock(mLock);
+        mSleepReq = false;
+        AutoMutex hwLock(mHardware->lock());
+
+        if (mStandbyDeadline != 0) {
+            return NO_ERROR;
+        }
+        if (mStandby || mMixing || mPcm == NULL || recover_l() != NO_ERROR) {
+            doStandby_l(mHardware->warmStandby());
+            return NO_ERROR;
+        }
+        mHardware->releasePcmDriver_l(this);
+        if (mEchoReference != NULL) {
+            mEchoReference->write(NULL);
+        }
+        mFramesPresentedBase += mFramesWritten;
+        mFramesWritten = 0;
+        deadline = systemTime(SYSTEM_TIME_MONOTONIC) + milliseconds(mHardware->standbyDelayMs());
+        mStandbyDeadline = deadline;
+    }
+    mHardware->scheduleStandby(deadline);
+
+    return NO_ERROR;
+}
+
+// idle outputs past their deadline go to standby, otherwise returns the deadline
+nsecs_t AudioHardware::AudioStreamOutALSA::checkStandbyTimeout(nsecs_t now)
+{
+    AutoMutex lock(mLock);
+    if (mStandbyDeadline == 0 || now < mStandbyDeadline) {
+        return mStandbyDeadline;
+    }
+    AutoMutex hwLock(mHardware->lock());
+    ALOGV("AudioStreamOutALSA standby delay elapsed");
+    // the delay already kept the pcm ready for a quick restart, a stream
+    // idle for that long really closes
+    doStandby_l();
+    return 0;
+}
+
+status_t AudioHardware::AudioStreamOutALSA::standbyNow()
 {
     if (mHardware == NULL) return NO_INIT;
 
@@ -1423,26 +2851,43 @@ status_t AudioHardware::AudioStreamOutALSA::standby()
         { // scope for the AudioHardware lock
             AutoMutex hwLock(mHardware->lock());
 
-            doStandby_l();
+            doStandby_l(mHardware->warmStandby());
         }
     }
 
     return NO_ERROR;
 }
 
-void AudioHardware::AudioStreamOutALSA::doStandby_l()
+// warm keeps the pcm open but stopped so the next write only has to restart
+// it. the codec path and mixer stay up with it, which costs idle power, warm
+// is only used when persist.audio.warm_standby asks for it
+void AudioHardware::AudioStreamOutALSA::doStandby_l(bool warm)
 {
     mStandbyCnt++;
+    mStandbyDeadline = 0;
 
     if (!mStandby) {
         ALOGD("AudioHardware pcm playback is going to standby.");
         // stop echo reference capture
         if (mEchoReference != NULL) {
-            mEchoReference->write(mEchoReference, NULL);
+            mEchoReference->write(NULL);
         }
         mStandby = true;
+        mStats.onEnterStandby(systemTime(SYSTEM_TIME_MONOTONIC));
     }
 
+    if (mMixing) {
+        // nobody is going to play what is still queued
+        mHardware->resetMix_l(this);
+        mMixing = false;
+    }
+    if (warm && mPcm != NULL) {
+        TRACE_DRIVER_IN(DRV_PCM_STOP)
+        pcm_stop(mPcm);
+        TRACE_DRIVER_OUT
+        mHardware->releasePcmDriver_l(this);
+        return;
+    }
     close_l();
 }
 
@@ -1457,30 +2902,37 @@ void AudioHardware::AudioStreamOutALSA::close_l()
         mHardware->closePcmOut_l();
         mPcm = NULL;
     }
+    mHardware->releasePcmDriver_l(this);
 }
 
+// whatever survived warm standby is reused
 status_t AudioHardware::AudioStreamOutALSA::open_l()
 {
-    ALOGV("open pcm_out driver");
-    mPcm = mHardware->openPcmOut_l();
     if (mPcm == NULL) {
-        return NO_INIT;
+        ALOGV("open pcm_out driver");
+        mPcm = mHardware->openPcmOut_l(mProfile);
+        if (mPcm == NULL) {
+            return NO_INIT;
+        }
     }
-
-    mMixer = mHardware->openMixer_l();
-    if (mMixer) {
-        ALOGV("open playback normal");
-        TRACE_DRIVER_IN(DRV_MIXER_GET)
-        mRouteCtl = mixer_get_ctl_by_name(mMixer, "Playback Path");
-        TRACE_DRIVER_OUT
+    // stopped or just opened either way, the position restarts with the stream
+    mMmapStarted = false;
+    mFramesPresentedBase += mFramesWritten;
+    mFramesWritten = 0;
+    mHardware->setPcmDriver_l(this);
+
+    if (mMixer == NULL) {
+        mMixer = mHardware->openMixer_l();
+        if (mMixer) {
+            ALOGV("open playback normal");
+            mRouteCtl = mHardware->getMixerCtl_l(MIXER_CTL_PLAYBACK_PATH);
+        }
     }
     if (mHardware->mode() != AudioSystem::MODE_IN_CALL) {
         const char *route = mHardware->getOutputRouteFromDevice(mDevices);
         ALOGV("write() wakeup setting route %s", route);
         if (mRouteCtl) {
-            TRACE_DRIVER_IN(DRV_MIXER_SEL)
-            mixer_ctl_set_enum_by_string(mRouteCtl, route);
-            TRACE_DRIVER_OUT
+            mHardware->setPlaybackRoute_l(route);
         }
     }
     return NO_ERROR;
@@ -1507,7 +2959,9 @@ status_t AudioHardware::AudioStreamOutALSA::dump(int fd, const Vector<String16>&
     result.append(buffer);
     snprintf(buffer, SIZE, "\t\tmRouteCtl: %p\n", mRouteCtl);
     result.append(buffer);
-    snprintf(buffer, SIZE, "\t\tStandby %s\n", (mStandby) ? "ON" : "OFF");
+    snprintf(buffer, SIZE, "\t\tStandby %s\n",
+             (mStandby) ? ((mPcm != NULL) ? "WARM" : "ON") :
+             ((mStandbyDeadline != 0) ? "IDLE" : "OFF"));
     result.append(buffer);
     snprintf(buffer, SIZE, "\t\tmDevices: 0x%08x\n", mDevices);
     result.append(buffer);
@@ -1517,8 +2971,22 @@ status_t AudioHardware::AudioStreamOutALSA::dump(int fd, const Vector<String16>&
     result.append(buffer);
     snprintf(buffer, SIZE, "\t\tmBufferSize: %d\n", mBufferSize);
     result.append(buffer);
+    snprintf(buffer, SIZE, "\t\tmProfile: %d\n", mProfile);
+    result.append(buffer);
+    snprintf(buffer, SIZE, "\t\tMixing %s\n", (mMixing) ? "ON" : "OFF");
+    result.append(buffer);
+    snprintf(buffer, SIZE, "\t\tLatency: %u ms\n", latency());
+    result.append(buffer);
+    {
+        AutoMutex lock(mPositionLock);
+        snprintf(buffer, SIZE, "\t\tPresented: %llu frames at %ld.%09ld\n",
+                 (unsigned long long)mPresentedFrames, (long)mPresentedTime.tv_sec,
+                 mPresentedTime.tv_nsec);
+    }
+    result.append(buffer);
     snprintf(buffer, SIZE, "\t\tmDriverOp: %d\n", mDriverOp);
     result.append(buffer);
+    mStats.dump(result, "Underruns");
 
     ::write(fd, result.string(), result.size());
 
@@ -1535,31 +3003,29 @@ status_t AudioHardware::AudioStreamOutALSA::setParameters(const String8& keyValu
     AudioParameter param = AudioParameter(keyValuePairs);
     status_t status = NO_ERROR;
     int device;
-    ALOGD("AudioStreamOutALSA::setParameters() %s", keyValuePairs.string());
+    ALOGV("AudioStreamOutALSA::setParameters() %s", keyValuePairs.string());
 
     if (mHardware == NULL) return NO_INIT;
 
-    mSleepReq = true;
+    if (param.getInt(String8(AudioParameter::keyRouting), device) == NO_ERROR)
     {
-        AutoMutex lock(mLock);
-        mSleepReq = false;
-        if (param.getInt(String8(AudioParameter::keyRouting), device) == NO_ERROR)
-        {
-            if (device != 0) {
-                AutoMutex hwLock(mHardware->lock());
-
-                if (mDevices != (uint32_t)device) {
-                    mDevices = (uint32_t)device;
-                    if (mHardware->mode() != AudioSystem::MODE_IN_CALL) {
-                        doStandby_l();
-                    }
-                }
-                if (mHardware->mode() == AudioSystem::MODE_IN_CALL) {
-                    mHardware->setIncallPath_l(device);
+        if (device != 0) {
+            // write() picks the last request up between two buffers, without
+            // waiting for it here nor making it sleep
+            {
+                AutoMutex lock(mRouteLock);
+                if (!mRoutePending) {
+                    mRouteReqNs = systemTime(SYSTEM_TIME_MONOTONIC);
                 }
+                mRoutePending = true;
+                mPendingDevices = (uint32_t)device;
+            }
+            AutoMutex hwLock(mHardware->lock());
+            if (mHardware->mode() == AudioSystem::MODE_IN_CALL) {
+                mHardware->setIncallPath_l(device);
             }
-            param.remove(String8(AudioParameter::keyRouting));
         }
+        param.remove(String8(AudioParameter::keyRouting));
     }
 
     if (param.size()) {
@@ -1578,17 +3044,282 @@ String8 AudioHardware::AudioStreamOutALSA::getParameters(const String8& keys)
     String8 key = String8(AudioParameter::keyRouting);
 
     if (param.get(key, value) == NO_ERROR) {
-        param.addInt(key, (int)mDevices);
+        AutoMutex lock(mRouteLock);
+        param.addInt(key, (int)(mRoutePending ? mPendingDevices : mDevices));
     }
 
     ALOGV("AudioStreamOutALSA::getParameters() %s", param.toString().string());
     return param.toString();
 }
 
+// frames written since the output left standby minus what the hardware pointer has not
+// reached yet
 status_t AudioHardware::AudioStreamOutALSA::getRenderPosition(uint32_t *dspFrames)
 {
-    //TODO
-    return INVALID_OPERATION;
+    AutoMutex lock(mLock);
+    size_t avail;
+    struct timespec tstamp;
+
+    if (mStandby || mMixing || mPcm == NULL) {
+        return INVALID_OPERATION;
+    }
+    if (pcm_get_htimestamp(mPcm, &avail, &tstamp) < 0) {
+        return INVALID_OPERATION;
+    }
+    size_t queued = pcm_get_buffer_size(mPcm) - avail;
+    *dspFrames = (uint32_t)(mFramesWritten > queued ? mFramesWritten - queued : 0);
+    return NO_ERROR;
+}
+
+// The position the video of a playback is timed to: frames played over the life of
+// the stream, sampled from the hardware pointer once a write, so it follows the DAC
+// and not latency()'s period count. A caller between writes extrapolates from it.
+void AudioHardware::AudioStreamOutALSA::updatePresentation_l()
+{
+    size_t avail;
+    struct timespec tstamp;
+
+    if (pcm_get_htimestamp(mPcm, &avail, &tstamp) < 0) {
+        return;
+    }
+    pcmTimeToMonotonic(&tstamp);
+
+    size_t bufferSize = pcm_get_buffer_size(mPcm);
+    size_t queued = avail < bufferSize ? bufferSize - avail : 0;
+
+    AutoMutex lock(mPositionLock);
+    mPresentedFrames = mFramesPresentedBase +
+            (mFramesWritten > queued ? mFramesWritten - queued : 0);
+    mPresentedTime = tstamp;
+}
+
+status_t AudioHardware::AudioStreamOutALSA::getPresentationPosition(uint64_t *frames,
+                                                                    struct timespec *timestamp)
+{
+    // frames written while mixing play on the other output
+    if (mMixing) {
+        return INVALID_OPERATION;
+    }
+
+    AutoMutex lock(mPositionLock);
+    if (mPresentedTime.tv_sec == 0 && mPresentedTime.tv_nsec == 0) {
+        return INVALID_OPERATION;
+    }
+    *frames = mPresentedFrames;
+    *timestamp = mPresentedTime;
+    return NO_ERROR;
+}
+
+// copies frames straight into the DMA buffer, what the other output queued is mixed in
+// there. The hardware lock is only taken for the mix, never while waiting for room.
+int AudioHardware::AudioStreamOutALSA::writeMmap_l(const uint8_t **buffer, size_t *bytes,
+                                                   bool mix)
+{
+    size_t frames = *bytes / frameSize();
+    unsigned int bufferFrames = pcm_get_buffer_size(mPcm);
+    unsigned int startThreshold = mHardware->pcmStartThreshold_l();
+    // twice a period, pcm_wait() times out only if the DMA stalled
+    int timeoutMs = (int)((2000 * outputConfigTable[mHardware->pcmProfile_l()]
+                          [OUTPUT_CONFIG_PERIOD_SIZE]) / mHardware->pcmRate_l()) + 1;
+
+    while (frames > 0) {
+        int avail = pcm_avail_update(mPcm);
+        if (avail < 0) {
+            ALOGW("writeMmap_l() pcm_avail_update: %d", avail);
+            return avail;
+        }
+        if (mMmapStarted && (unsigned int)avail >= bufferFrames) {
+            mStats.xruns++;
+        }
+        if (!mMmapStarted && bufferFrames - avail >= startThreshold) {
+            TRACE_DRIVER_IN(DRV_PCM_START)
+            pcm_start(mPcm);
+            TRACE_DRIVER_OUT
+            mMmapStarted = true;
+        }
+        if (avail == 0) {
+            // full, hence above the threshold and started
+            TRACE_DRIVER_IN(DRV_PCM_WAIT)
+            int rc = pcm_wait(mPcm, timeoutMs);
+            TRACE_DRIVER_OUT
+            if (rc <= 0) {
+                ALOGW("writeMmap_l() pcm_wait: %d", rc);
+                return rc < 0 ? rc : -ETIMEDOUT;
+            }
+            continue;
+        }
+
+        void *area;
+        unsigned int offset;
+        unsigned int count = ((size_t)avail < frames) ? avail : frames;
+        if (pcm_mmap_begin(mPcm, &area, &offset, &count) < 0) {
+            return -errno;
+        }
+        int16_t *dst = (int16_t *)((uint8_t *)area + pcm_frames_to_bytes(mPcm, offset));
+        memcpy(dst, *buffer, count * frameSize());
+        if (mix) {
+            AutoMutex hwLock(mHardware->lock());
+            mix = mHardware->pullMixFrames_l(dst, count, true) == count;
+        }
+
+        if (mEchoReference != NULL) {
+            struct echo_reference_buffer b;
+            b.raw = (void *)dst;
+            b.frame_count = count;
+
+            getPlaybackDelay(count, &b);
+            mEchoReference->write(&b);
+        }
+
+        TRACE_DRIVER_IN(DRV_PCM_WRITE)
+        int rc = pcm_mmap_commit(mPcm, offset, count);
+        TRACE_DRIVER_OUT
+        if (rc < 0) {
+            return rc;
+        }
+        *buffer += count * frameSize();
+        *bytes -= count * frameSize();
+        frames -= count;
+    }
+    return 0;
+}
+
+// the routing request once it is AUDIO_HW_ROUTE_BATCH_MS old, or right away
+// when forced
+bool AudioHardware::AudioStreamOutALSA::takePendingRoute(nsecs_t now, bool force,
+                                                         uint32_t *devices)
+{
+    AutoMutex lock(mRouteLock);
+    if (!mRoutePending ||
+            (!force && now - mRouteReqNs < milliseconds(AUDIO_HW_ROUTE_BATCH_MS))) {
+        return false;
+    }
+    mRoutePending = false;
+    *devices = mPendingDevices;
+    return true;
+}
+
+// Fades the first AUDIO_HW_ROUTE_RAMP_MS of the buffer in, continuing from
+// mRampPos, or fades out over at most its first half and mutes the rest so that
+// the path switches on silence. Returns the buffer to write, a scratch copy
+// unless the frames already are in there.
+const uint8_t *AudioHardware::AudioStreamOutALSA::rampFrames_l(const uint8_t *buffer,
+                                                               size_t bytes, bool fadeOut,
+                                                               bool *mixInPlace)
+{
+    size_t frames = bytes / frameSize();
+    size_t rampLen = mSampleRate * AUDIO_HW_ROUTE_RAMP_MS / 1000;
+    int16_t *out = writableFrames_l(buffer, bytes, mixInPlace);
+
+    if (out == NULL) {
+        return buffer;
+    }
+
+    if (fadeOut) {
+        if (rampLen > frames / 2) {
+            rampLen = frames / 2;
+        }
+        for (size_t i = 0; i < frames; i++) {
+            int32_t gain = i < rampLen ? (int32_t)(((rampLen - i) << 15) / rampLen) : 0;
+            out[2 * i] = (int16_t)((out[2 * i] * gain) >> 15);
+            out[2 * i + 1] = (int16_t)((out[2 * i + 1] * gain) >> 15);
+        }
+        mRampPos = 0;
+    } else {
+        for (size_t i = 0; i < frames && mRampPos < rampLen; i++, mRampPos++) {
+            int32_t gain = (int32_t)((mRampPos << 15) / rampLen);
+            out[2 * i] = (int16_t)((out[2 * i] * gain) >> 15);
+            out[2 * i + 1] = (int16_t)((out[2 * i + 1] * gain) >> 15);
+        }
+    }
+    return (const uint8_t *)out;
+}
+
+// Master gain of the frames about to be written, the other outputs included.
+const uint8_t *AudioHardware::AudioStreamOutALSA::applyMasterGain_l(const uint8_t *buffer,
+                                                                    size_t bytes,
+                                                                    bool *mixInPlace)
+{
+    size_t frames = bytes / frameSize();
+    int32_t from, to;
+    size_t rampFrames;
+
+    {
+        AutoMutex hwLock(mHardware->lock());
+        if (!mHardware->masterGain_l(frames, &from, &to, &rampFrames)) {
+            return buffer;
+        }
+    }
+    int16_t *out = writableFrames_l(buffer, bytes, mixInPlace);
+    if (out == NULL) {
+        return buffer;
+    }
+    applyGainRamp(out, frames, from, to, rampFrames);
+    return (const uint8_t *)out;
+}
+
+// the frames in mMixScratch, with what the other outputs queued mixed in
+// there rather than in the DMA buffer so that they are processed as well
+int16_t *AudioHardware::AudioStreamOutALSA::writableFrames_l(const uint8_t *buffer,
+                                                             size_t bytes, bool *mixInPlace)
+{
+    int16_t *out = mMixScratch;
+
+    if (buffer != (const uint8_t *)mMixScratch) {
+        out = mixScratch(bytes);
+        if (out == NULL) {
+            return NULL;
+        }
+        memcpy(out, buffer, bytes);
+    }
+    if (*mixInPlace) {
+        AutoMutex hwLock(mHardware->lock());
+        mHardware->pullMixFrames_l(out, bytes / frameSize(), true);
+        *mixInPlace = false;
+    }
+    return out;
+}
+
+// Called once the faded buffer is queued: waits for the hardware to be half way
+// in its silent tail, then switches the path. What follows fades in.
+void AudioHardware::AudioStreamOutALSA::switchRoute_l(uint32_t devices, size_t silentFrames)
+{
+    size_t avail;
+    struct timespec tstamp;
+
+    if (pcm_get_htimestamp(mPcm, &avail, &tstamp) == 0) {
+        size_t queued = pcm_get_buffer_size(mPcm) - avail;
+        if (queued > silentFrames / 2) {
+            usleep((useconds_t)(((uint64_t)(queued - silentFrames / 2) * 1000000) /
+                                mSampleRate));
+        }
+    }
+
+    AutoMutex hwLock(mHardware->lock());
+    mDevices = devices;
+    if (mRouteCtl) {
+        const char *route = mHardware->getOutputRouteFromDevice(mDevices);
+        ALOGV("switchRoute_l() setting route %s", route);
+        mHardware->setPlaybackRoute_l(route);
+    }
+}
+
+// The driver stops the stream on an xrun or a suspend. Preparing it again is
+// enough to carry on, the next write restarts it once the threshold is reached.
+status_t AudioHardware::AudioStreamOutALSA::recover_l()
+{
+    if (mPcm == NULL) {
+        return NO_INIT;
+    }
+    TRACE_DRIVER_IN(DRV_PCM_PREPARE)
+    int rc = pcm_prepare(mPcm);
+    TRACE_DRIVER_OUT
+    if (rc != 0) {
+        ALOGE("AudioStreamOutALSA::recover_l() pcm_prepare failed: %s", pcm_get_error(mPcm));
+        return INVALID_OPERATION;
+    }
+    mMmapStarted = false;
+    return NO_ERROR;
 }
 
 int AudioHardware::AudioStreamOutALSA::prepareLock()
@@ -1609,7 +3340,7 @@ void AudioHardware::AudioStreamOutALSA::unlock() {
     mLock.unlock();
 }
 
-void AudioHardware::AudioStreamOutALSA::addEchoReference(struct echo_reference_itfe *reference)
+void AudioHardware::AudioStreamOutALSA::addEchoReference(EchoReference *reference)
 {
     ALOGV("AudioStreamOutALSA::addEchoReference %p", mEchoReference);
     if (mEchoReference == NULL) {
@@ -1617,11 +3348,11 @@ void AudioHardware::AudioStreamOutALSA::addEchoReference(struct echo_reference_i
     }
 }
 
-void AudioHardware::AudioStreamOutALSA::removeEchoReference(struct echo_reference_itfe *reference)
+void AudioHardware::AudioStreamOutALSA::removeEchoReference(EchoReference *reference)
 {
     ALOGV("AudioStreamOutALSA::removeEchoReference %p", mEchoReference);
     if (mEchoReference == reference) {
-        mEchoReference->write(mEchoReference, NULL);
+        mEchoReference->write(NULL);
         mEchoReference = NULL;
     }
 }
@@ -1635,9 +3366,13 @@ AudioHardware::AudioStreamInALSA::AudioStreamInALSA() :
     mHardware(0), mPcm(0), mMixer(0), mRouteCtl(0),
     mStandby(true), mDevices(0), mChannels(AUDIO_HW_IN_CHANNELS), mChannelCount(1),
     mSampleRate(AUDIO_HW_IN_SAMPLERATE), mBufferSize(AUDIO_HW_IN_PERIOD_BYTES),
-    mDownSampler(NULL), mReadStatus(NO_ERROR), mInputBuf(NULL),
+    mDownSampler(NULL), mPcmRate(AUDIO_HW_IN_SAMPLERATE), mPcmPeriod(AUDIO_HW_IN_PERIOD_SZ),
+    mPcmPeriodCount(AUDIO_HW_IN_PERIOD_CNT), mPcmProfile(INPUT_PROFILE_NORMAL),
+    mMmap(false), mMmapStarted(false), mMmapOffset(0), mErrorPaceNs(0), mStandbyDeadline(0),
+    mReadStatus(NO_ERROR), mInputBuf(NULL),
     mDriverOp(DRV_NONE), mStandbyCnt(0), mSleepReq(false),
-    mProcBuf(NULL), mProcBufSize(0), mRefBuf(NULL), mRefBufSize(0),
+    mProcBuf(NULL), mProcBufSize(0), mProcBlock(0), mProcRead(0), mProcFramesIn(0),
+    mRefBuf(NULL), mRefBufSize(0),
     mEchoReference(NULL), mNeedEchoReference(false)
 {
 }
@@ -1674,34 +3409,29 @@ status_t AudioHardware::AudioStreamInALSA::set(
     mChannels = *pChannels;
     mChannelCount = AudioSystem::popCount(mChannels);
     mSampleRate = rate;
-    if (mSampleRate != AUDIO_HW_OUT_SAMPLERATE) {
-        mBufferProvider.mProvider.get_next_buffer = getNextBufferStatic;
-        mBufferProvider.mProvider.release_buffer = releaseBufferStatic;
-        mBufferProvider.mInputStream = this;
-        int status = create_resampler(AUDIO_HW_OUT_SAMPLERATE,
-                                                    mSampleRate,
-                                                    mChannelCount,
-                                                    RESAMPLER_QUALITY_VOIP,
-                                                    &mBufferProvider.mProvider,
-                                                    &mDownSampler);
-        if (status != 0) {
-            ALOGW("AudioStreamInALSA::set() downsampler init failed: %d", status);
+    if (mSampleRate != AUDIO_HW_IN_SAMPLERATE) {
+        // only used when open_l() cannot run the pcm at mSampleRate
+        mDownSampler = new PolyphaseResampler(AUDIO_HW_IN_SAMPLERATE,
+                                              mSampleRate,
+                                              mChannelCount);
+        if (!mDownSampler->initCheck()) {
+            ALOGW("AudioStreamInALSA::set() downsampler init failed");
+            delete mDownSampler;
             mDownSampler = NULL;
-            return status;
+            return NO_INIT;
         }
     }
-    mInputBuf = new int16_t[AUDIO_HW_IN_PERIOD_SZ * mChannelCount];
+    // the longest period of any profile, native or not
+    mInputBuf = new int16_t[AUDIO_HW_IN_LONG_PERIOD_SZ * mChannelCount];
 
     return NO_ERROR;
 }
 
 AudioHardware::AudioStreamInALSA::~AudioStreamInALSA()
 {
-    standby();
+    standbyNow();
 
-    if (mDownSampler != NULL) {
-        release_resampler(mDownSampler);
-    }
+    delete mDownSampler;
     delete[] mInputBuf;
     delete[] mProcBuf;
 }
@@ -1711,31 +3441,46 @@ AudioHardware::AudioStreamInALSA::~AudioStreamInALSA()
 ssize_t AudioHardware::AudioStreamInALSA::readFrames(void* buffer, ssize_t frames)
 {
     ssize_t framesWr = 0;
+    bool resampling = mPcmRate != mSampleRate;
     while (framesWr < frames) {
+        int16_t *dst = (int16_t *)((char *)buffer + framesWr * frameSize());
         size_t framesRd = frames - framesWr;
-        if (mDownSampler != NULL) {
-            mDownSampler->resample_from_provider(mDownSampler,
-                    (int16_t *)((char *)buffer + framesWr * frameSize()),
-                    &framesRd);
-        } else {
-            struct resampler_buffer buf = {
-                    { raw : NULL, },
-                    frame_count : framesRd,
-            };
-            getNextBuffer(&buf);
-            if (buf.raw != NULL) {
-                memcpy((char *)buffer + framesWr * frameSize(),
-                        buf.raw,
-                        buf.frame_count * frameSize());
-                framesRd = buf.frame_count;
+
+        // whole periods at the native rate don't need mInputBuf
+        if (!resampling && !mMmap && mInputFramesIn == 0 && framesRd >= mPcmPeriod &&
+                mPcm != NULL) {
+            countOverrun();
+            nsecs_t ioStart = systemTime(SYSTEM_TIME_MONOTONIC);
+            TRACE_DRIVER_IN(DRV_PCM_READ)
+            mReadStatus = pcm_read(mPcm, (void *)dst, mPcmPeriod * frameSize());
+            TRACE_DRIVER_OUT
+            mStats.onIo(ioStart, systemTime(SYSTEM_TIME_MONOTONIC));
+            if (mReadStatus != 0) {
+                return mReadStatus;
             }
-            releaseBuffer(&buf);
+            framesWr += mPcmPeriod;
+            continue;
         }
-        // mReadStatus is updated by getNextBuffer() also called by
-        // mDownSampler->resample_from_provider()
+
+        struct resampler_buffer buf = {
+                { raw : NULL, },
+                frame_count : resampling ? mPcmPeriod : framesRd,
+        };
+        getNextBuffer(&buf);
+        // mReadStatus is updated by getNextBuffer()
         if (mReadStatus != 0) {
             return mReadStatus;
         }
+        if (resampling) {
+            // the resampler writes straight into the caller's buffer
+            size_t inFrames = buf.frame_count;
+            mDownSampler->resample(buf.i16, &inFrames, dst, &framesRd);
+            buf.frame_count = inFrames;
+        } else {
+            memcpy(dst, buf.raw, buf.frame_count * frameSize());
+            framesRd = buf.frame_count;
+        }
+        releaseBuffer(&buf);
         framesWr += framesRd;
     }
     return framesWr;
@@ -1743,38 +3488,56 @@ ssize_t AudioHardware::AudioStreamInALSA::readFrames(void* buffer, ssize_t frame
 
 // processFrames() reads frames from kernel driver (via readFrames()), calls the active
 // audio pre processings and output the number of frames requested to the buffer specified
+// mProcBuf is a ring of mProcBufSize frames followed by mProcBlock guard frames: when the
+// unprocessed frames wrap, their head is mirrored past the end so that process() always
+// gets at least one block in place
 ssize_t AudioHardware::AudioStreamInALSA::processFrames(void* buffer, ssize_t frames)
 {
     ssize_t framesWr = 0;
     while (framesWr < frames) {
-        // first reload enough frames at the end of process input buffer
-        if (mProcFramesIn < (size_t)frames) {
-            // expand process input buffer if necessary
-            if (mProcBufSize < (size_t)frames) {
-                mProcBufSize = (size_t)frames;
-                mProcBuf = (int16_t *)realloc(mProcBuf,
-                                              mProcBufSize * mChannelCount * sizeof(int16_t));
-                ALOGV("processFrames(): mProcBuf %p size extended to %d frames",
-                     mProcBuf, mProcBufSize);
+        // first reload enough frames after the unprocessed ones, wrapping at the ring end
+        size_t target = ((size_t)frames < mProcBufSize) ? (size_t)frames : mProcBufSize;
+        ssize_t framesRd = 0;
+        while (mProcFramesIn < target) {
+            size_t wr = (mProcRead + mProcFramesIn) % mProcBufSize;
+            size_t count = target - mProcFramesIn;
+            if (count > mProcBufSize - wr) {
+                count = mProcBufSize - wr;
             }
-            ssize_t framesRd = readFrames(mProcBuf + mProcFramesIn * mChannelCount,
-                                          frames - mProcFramesIn);
+            framesRd = readFrames(mProcBuf + wr * mChannelCount, count);
             if (framesRd < 0) {
-                framesWr = framesRd;
                 break;
             }
             mProcFramesIn += framesRd;
         }
+        if (framesRd < 0) {
+            framesWr = framesRd;
+            break;
+        }
 
         if (mEchoReference != NULL) {
             pushEchoReference(mProcFramesIn);
         }
 
+        size_t contig = mProcBufSize - mProcRead;
+        if (contig >= mProcFramesIn) {
+            contig = mProcFramesIn;
+        } else if (contig < mProcBlock) {
+            size_t mirror = mProcFramesIn - contig;
+            if (mirror > mProcBlock - contig) {
+                mirror = mProcBlock - contig;
+            }
+            memcpy(mProcBuf + mProcBufSize * mChannelCount,
+                   mProcBuf,
+                   mirror * mChannelCount * sizeof(int16_t));
+            contig += mirror;
+        }
+
         //inBuf.frameCount and outBuf.frameCount indicate respectively the maximum number of frames
         //to be consumed and produced by process()
         audio_buffer_t inBuf = {
-                mProcFramesIn,
-                {mProcBuf}
+                contig,
+                {mProcBuf + mProcRead * mChannelCount}
         };
         audio_buffer_t outBuf = {
                 frames - framesWr,
@@ -1782,20 +3545,19 @@ ssize_t AudioHardware::AudioStreamInALSA::processFrames(void* buffer, ssize_t fr
         };
 
         for (size_t i = 0; i < mPreprocessors.size(); i++) {
+            nsecs_t cpuStart = systemTime(SYSTEM_TIME_THREAD);
             (*mPreprocessors[i])->process(mPreprocessors[i],
                                                    &inBuf,
                                                    &outBuf);
+            PreprocessorStats& ps = mPreprocessorStats.editItemAt(i);
+            ps.cpuNs += systemTime(SYSTEM_TIME_THREAD) - cpuStart;
+            ps.calls++;
         }
 
         // process() has updated the number of frames consumed and produced in
         // inBuf.frameCount and outBuf.frameCount respectively
-        // move remaining frames to the beginning of mProcBuf
         mProcFramesIn -= inBuf.frameCount;
-        if (mProcFramesIn) {
-            memcpy(mProcBuf,
-                   mProcBuf + inBuf.frameCount * mChannelCount,
-                   mProcFramesIn * mChannelCount * sizeof(int16_t));
-        }
+        mProcRead = (mProcRead + inBuf.frameCount) % mProcBufSize;
 
         // if not enough frames were passed to process(), read more and retry.
         if (outBuf.frameCount == 0) {
@@ -1825,7 +3587,7 @@ int32_t AudioHardware::AudioStreamInALSA::updateEchoReference(size_t frames)
 
         getCaptureDelay(frames, &b);
 
-        if (mEchoReference->read(mEchoReference, &b) == NO_ERROR)
+        if (mEchoReference->read(&b) == NO_ERROR)
         {
             mRefFramesIn += b.frame_count;
             ALOGV("updateEchoReference2: mRefFramesIn:[%d], mRefBufSize:[%d], "\
@@ -1925,15 +3687,15 @@ void AudioHardware::AudioStreamInALSA::getCaptureDelay(size_t frames,
     // read frames available in audio HAL input buffer
     // add number of frames being read as we want the capture time of first sample in current
     // buffer
-    long bufDelay = (long)(((int64_t)(mInputFramesIn + mProcFramesIn) * 1000000000)
-                                    / AUDIO_HW_IN_SAMPLERATE);
+    long bufDelay = (long)(((int64_t)mInputFramesIn * 1000000000) / mPcmRate +
+                           ((int64_t)mProcFramesIn * 1000000000) / mSampleRate);
     // add delay introduced by resampler
     long rsmpDelay = 0;
-    if (mDownSampler) {
-        rsmpDelay = mDownSampler->delay_ns(mDownSampler);
+    if (mPcmRate != mSampleRate) {
+        rsmpDelay = mDownSampler->delayNs();
     }
 
-    long kernelDelay = (long)(((int64_t)kernelFr * 1000000000) / AUDIO_HW_IN_SAMPLERATE);
+    long kernelDelay = (long)(((int64_t)kernelFr * 1000000000) / mPcmRate);
 
     // correct capture time stamp
     long delayNs = kernelDelay + bufDelay + rsmpDelay;
@@ -1951,7 +3713,9 @@ void AudioHardware::AudioStreamInALSA::getCaptureDelay(size_t frames,
 ssize_t AudioHardware::AudioStreamInALSA::read(void* buffer, ssize_t bytes)
 {
     //ALOGV("-----AudioStreamInALSA::read(%p, %d) START", buffer, (int)bytes);
+    SEC_TRACE_SCOPE("audio:read");
     status_t status = NO_INIT;
+    nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
 
     if (mHardware == NULL) return NO_INIT;
 
@@ -1963,12 +3727,15 @@ ssize_t AudioHardware::AudioStreamInALSA::read(void* buffer, ssize_t bytes)
 
     { // scope for the lock
         AutoMutex lock(mLock);
+        mStats.onCall(now);
+        // within the standby delay the pcm is prepared and restarts by itself
+        mStandbyDeadline = 0;
 
         if (mStandby) {
             AutoMutex hwLock(mHardware->lock());
 
             ALOGD("AudioHardware pcm capture is exiting standby.");
-            sp<AudioStreamOutALSA> spOut = mHardware->output();
+            sp<AudioStreamOutALSA> spOut = mHardware->pcmOutput_l();
             while (spOut != 0) {
                 spOut->prepareLock();
                 mHardware->lock().unlock();
@@ -1979,11 +3746,11 @@ ssize_t AudioHardware::AudioStreamInALSA::read(void* buffer, ssize_t bytes)
                 mHardware->lock().lock();
                 // make sure that another thread did not change output state
                 // while the mutex is released
-                if (spOut == mHardware->output()) {
+                if (spOut == mHardware->pcmOutput_l()) {
                     break;
                 }
                 spOut->unlock();
-                spOut = mHardware->output();
+                spOut = mHardware->pcmOutput_l();
             }
             // open output before input
             if (spOut != 0) {
@@ -2010,37 +3777,86 @@ ssize_t AudioHardware::AudioStreamInALSA::read(void* buffer, ssize_t bytes)
                 goto Error;
             }
             mStandby = false;
+            mStats.onExitStandby(now);
         }
 
         size_t framesRq = bytes / mChannelCount/sizeof(int16_t);
         ssize_t framesRd;
 
-        if (mPreprocessors.size() == 0) {
-            framesRd = readFrames(buffer, framesRq);
-        } else {
-            framesRd = processFrames(buffer, framesRq);
-        }
+        for (int retry = 0; ; retry++) {
+            SEC_TRACE_BEGIN("audio:pcm_read");
+            if (mPreprocessors.size() == 0) {
+                framesRd = readFrames(buffer, framesRq);
+            } else {
+                framesRd = processFrames(buffer, framesRq);
+            }
+            SEC_TRACE_END();
 
-        if (framesRd >= 0) {
-            //ALOGV("-----AudioStreamInALSA::read(%p, %d) END", buffer, (int)bytes);
-            return framesRd * mChannelCount * sizeof(int16_t);
-        }
+            if (framesRd >= 0) {
+                mErrorPaceNs = 0;
+                //ALOGV("-----AudioStreamInALSA::read(%p, %d) END", buffer, (int)bytes);
+                return framesRd * mChannelCount * sizeof(int16_t);
+            }
 
-        ALOGW("read error: %d", (int)framesRd);
+            ALOGW("read error: %d", (int)framesRd);
+            if (retry == AUDIO_HW_XRUN_RETRIES || recover_l() != NO_ERROR) {
+                break;
+            }
+            mStats.errors++;
+        }
         status = framesRd;
     }
 
 Error:
+    mStats.errors++;
+    standbyNow();
 
-    standby();
-
-    // Simulate audio output timing in case of error
-    usleep((((bytes * 1000) / frameSize()) * 1000) / sampleRate());
+    paceFailedIo(&mErrorPaceNs, now, bytes / frameSize(), sampleRate());
     ALOGE("-----AudioStreamInALSA::read(%p, %d) END ERROR", buffer, (int)bytes);
     return status;
 }
 
+// same as the output, capture stops but the pcm stays open for the delay
 status_t AudioHardware::AudioStreamInALSA::standby()
+{
+    if (mHardware == NULL) return NO_INIT;
+    if (mHardware->standbyDelayMs() == 0) return standbyNow();
+
+    nsecs_t deadline;
+    mSleepReq = true;
+    {
+        AutoMutex lock(mLock);
+        mSleepReq = false;
+        AutoMutex hwLock(mHardware->lock());
+
+        if (mStandbyDeadline != 0) {
+            return NO_ERROR;
+        }
+        if (mStandby || recover_l() != NO_ERROR) {
+            doStandby_l();
+            return NO_ERROR;
+        }
+        deadline = systemTime(SYSTEM_TIME_MONOTONIC) + milliseconds(mHardware->standbyDelayMs());
+        mStandbyDeadline = deadline;
+    }
+    mHardware->scheduleStandby(deadline);
+
+    return NO_ERROR;
+}
+
+nsecs_t AudioHardware::AudioStreamInALSA::checkStandbyTimeout(nsecs_t now)
+{
+    AutoMutex lock(mLock);
+    if (mStandbyDeadline == 0 || now < mStandbyDeadline) {
+        return mStandbyDeadline;
+    }
+    AutoMutex hwLock(mHardware->lock());
+    ALOGV("AudioStreamInALSA standby delay elapsed");
+    doStandby_l();
+    return 0;
+}
+
+status_t AudioHardware::AudioStreamInALSA::standbyNow()
 {
     if (mHardware == NULL) return NO_INIT;
 
@@ -2061,12 +3877,14 @@ status_t AudioHardware::AudioStreamInALSA::standby()
 void AudioHardware::AudioStreamInALSA::doStandby_l()
 {
     mStandbyCnt++;
+    mStandbyDeadline = 0;
 
     if (!mStandby) {
         ALOGD("AudioHardware pcm capture is going to standby.");
+        mStats.onEnterStandby(systemTime(SYSTEM_TIME_MONOTONIC));
         if (mEchoReference != NULL) {
             // stop reading from echo reference
-            mEchoReference->read(mEchoReference, NULL);
+            mEchoReference->read(NULL);
             // Mutex acquisition order is always out -> in -> hw
             sp<AudioStreamOutALSA> spOut = mHardware->output();
             if (spOut != 0) {
@@ -2110,58 +3928,97 @@ void AudioHardware::AudioStreamInALSA::close_l()
     mRefBufSize = 0;
 }
 
-status_t AudioHardware::AudioStreamInALSA::open_l()
+// mmap first when enabled, then read()
+status_t AudioHardware::AudioStreamInALSA::openPcm_l(struct pcm_config *config)
 {
-    unsigned flags = PCM_IN;
+    unsigned flags = PCM_IN | (mHardware->mmapEnabled() ? PCM_MMAP : 0);
+
+    while (true) {
+        TRACE_DRIVER_IN(DRV_PCM_OPEN)
+        mPcm = pcm_open(0, 0, flags, config);
+        TRACE_DRIVER_OUT
+        if (pcm_is_ready(mPcm)) {
+            mMmap = (flags & PCM_MMAP) != 0;
+            mMmapStarted = false;
+            return NO_ERROR;
+        }
+        ALOGW("openPcm_l() flags %x: %s", flags, pcm_get_error(mPcm));
+        TRACE_DRIVER_IN(DRV_PCM_CLOSE)
+        pcm_close(mPcm);
+        TRACE_DRIVER_OUT
+        mPcm = NULL;
+        if (!(flags & PCM_MMAP)) {
+            return NO_INIT;
+        }
+        flags &= ~PCM_MMAP;
+    }
+}
 
+status_t AudioHardware::AudioStreamInALSA::open_l()
+{
+    int profile = mHardware->inputProfile_l();
+    uint32_t periodSize = inputPeriodTable[profile][INPUT_PERIOD_SIZE];
     struct pcm_config config = {
         channels : mChannelCount,
         rate : AUDIO_HW_IN_SAMPLERATE,
-        period_size : AUDIO_HW_IN_PERIOD_SZ,
-        period_count : AUDIO_HW_IN_PERIOD_CNT,
+        period_size : periodSize,
+        period_count : inputPeriodTable[profile][INPUT_PERIOD_COUNT],
         format : PCM_FORMAT_S16_LE,
         start_threshold : 0,
         stop_threshold : 0,
         silence_threshold : 0,
     };
 
-    ALOGV("open pcm_in driver");
-    TRACE_DRIVER_IN(DRV_PCM_OPEN)
-    mPcm = pcm_open(0, 0, flags, &config);
-    TRACE_DRIVER_OUT
-    if (!pcm_is_ready(mPcm)) {
-        ALOGE("cannot open pcm_in driver: %s\n", pcm_get_error(mPcm));
-        TRACE_DRIVER_IN(DRV_PCM_CLOSE)
-        pcm_close(mPcm);
-        TRACE_DRIVER_OUT
-        mPcm = NULL;
-        return NO_INIT;
+    if (mHardware->nativeCaptureRate_l(mSampleRate)) {
+        // same period duration, one normal period is one read() buffer
+        config.rate = mSampleRate;
+        config.period_size = (mBufferSize / frameSize()) * periodSize / AUDIO_HW_IN_PERIOD_SZ;
+        ALOGV("open pcm_in driver at %d Hz", mSampleRate);
+        if (openPcm_l(&config) != NO_ERROR) {
+            ALOGW("pcm_in driver refused %d Hz", mSampleRate);
+            config.rate = AUDIO_HW_IN_SAMPLERATE;
+            config.period_size = periodSize;
+        }
+    }
+
+    if (mPcm == NULL) {
+        ALOGV("open pcm_in driver");
+        if (openPcm_l(&config) != NO_ERROR) {
+            ALOGE("cannot open pcm_in driver");
+            return NO_INIT;
+        }
     }
+    mPcmRate = config.rate;
+    mPcmPeriod = config.period_size;
+    mPcmPeriodCount = config.period_count;
+    mPcmProfile = profile;
 
     if (mDownSampler != NULL) {
-        mDownSampler->reset(mDownSampler);
+        mDownSampler->reset();
     }
     mInputFramesIn = 0;
 
-    mProcBufSize = 0;
+    // room for the largest read() plus one preprocessing block, the block is mirrored
+    // after the ring end when the unprocessed frames wrap
+    mProcBlock = (mSampleRate * AUDIO_HW_IN_PROC_BLOCK_MS) / 1000;
+    mProcBufSize = mBufferSize / frameSize() + mProcBlock;
+    delete[] mProcBuf;
+    mProcBuf = new int16_t[(mProcBufSize + mProcBlock) * mChannelCount];
+    mProcRead = 0;
     mProcFramesIn = 0;
     mRefBufSize = 0;
     mRefFramesIn = 0;
 
     mMixer = mHardware->openMixer_l();
     if (mMixer) {
-        TRACE_DRIVER_IN(DRV_MIXER_GET)
-        mRouteCtl = mixer_get_ctl_by_name(mMixer, "Capture MIC Path");
-        TRACE_DRIVER_OUT
+        mRouteCtl = mHardware->getMixerCtl_l(MIXER_CTL_CAPTURE_MIC_PATH);
     }
 
     if (mHardware->mode() != AudioSystem::MODE_IN_CALL) {
         const char *route = mHardware->getInputRouteFromDevice(mDevices);
         ALOGV("read() wakeup setting route %s", route);
         if (mRouteCtl) {
-            TRACE_DRIVER_IN(DRV_MIXER_SEL)
-            mixer_ctl_set_enum_by_string(mRouteCtl, route);
-            TRACE_DRIVER_OUT
+            mHardware->setMixerEnum_l(MIXER_CTL_CAPTURE_MIC_PATH, route);
         }
     }
 
@@ -2187,7 +4044,8 @@ status_t AudioHardware::AudioStreamInALSA::dump(int fd, const Vector<String16>&
     result.append(buffer);
     snprintf(buffer, SIZE, "\t\tmMixer: %p\n", mMixer);
     result.append(buffer);
-    snprintf(buffer, SIZE, "\t\tStandby %s\n", (mStandby) ? "ON" : "OFF");
+    snprintf(buffer, SIZE, "\t\tStandby %s\n",
+             (mStandby) ? "ON" : ((mStandbyDeadline != 0) ? "IDLE" : "OFF"));
     result.append(buffer);
     snprintf(buffer, SIZE, "\t\tmDevices: 0x%08x\n", mDevices);
     result.append(buffer);
@@ -2195,10 +4053,31 @@ status_t AudioHardware::AudioStreamInALSA::dump(int fd, const Vector<String16>&
     result.append(buffer);
     snprintf(buffer, SIZE, "\t\tmSampleRate: %d\n", mSampleRate);
     result.append(buffer);
+    snprintf(buffer, SIZE, "\t\tmPcmRate: %d (%s)\n", mPcmRate,
+             (mPcmRate == mSampleRate) ? "native" : "resampled");
+    result.append(buffer);
     snprintf(buffer, SIZE, "\t\tmBufferSize: %d\n", mBufferSize);
     result.append(buffer);
+    snprintf(buffer, SIZE, "\t\tmPcmPeriod: %d x %d (profile %d)\n",
+             mPcmPeriod, mPcmPeriodCount, mPcmProfile);
+    result.append(buffer);
     snprintf(buffer, SIZE, "\t\tmDriverOp: %d\n", mDriverOp);
     result.append(buffer);
+    mStats.dump(result, "Overruns");
+    if (locked && tryLock(mLock)) {
+        for (size_t i = 0; i < mPreprocessors.size(); i++) {
+            effect_descriptor_t desc;
+            const PreprocessorStats& ps = mPreprocessorStats[i];
+            if ((*mPreprocessors[i])->get_descriptor(mPreprocessors[i], &desc) != 0) {
+                strcpy(desc.name, "unknown");
+            }
+            snprintf(buffer, SIZE, "\t\tPreprocessor %s: %u blocks, cpu %lld ms, avg %lld us\n",
+                     desc.name, ps.calls, (long long)(ps.cpuNs / 1000000),
+                     ps.calls ? (long long)(ps.cpuNs / ps.calls / 1000) : 0LL);
+            result.append(buffer);
+        }
+        mLock.unlock();
+    }
     write(fd, result.string(), result.size());
 
     return NO_ERROR;
@@ -2231,6 +4110,11 @@ status_t AudioHardware::AudioStreamInALSA::setParameters(const String8& keyValue
             mHardware->setInputSource_l((audio_source)value);
             mHardware->closeMixer_l();
 
+            // the periods are taken at pcm open, the next read() reopens with the new ones
+            if (!mStandby && mPcmProfile != mHardware->inputProfile_l()) {
+                doStandby_l();
+            }
+
             param.remove(String8(AudioParameter::keyInputSource));
         }
 
@@ -2283,7 +4167,7 @@ status_t AudioHardware::AudioStreamInALSA::addAudioEffect(effect_handle_t effect
         if (memcmp(&desc.type, FX_IID_AEC, sizeof(effect_uuid_t)) == 0) {
             ALOGV("AudioStreamInALSA::addAudioEffect() mNeedEchoReference true");
             mNeedEchoReference = true;
-            standby();
+            standbyNow();
         }
         ALOGV("AudioStreamInALSA::addAudioEffect() name %s", desc.name);
     } else {
@@ -2291,7 +4175,8 @@ status_t AudioHardware::AudioStreamInALSA::addAudioEffect(effect_handle_t effect
     }
 
     AutoMutex lock(mLock);
-    mPreprocessors.add(effect);
+    PreprocessorStats ps = { 0, 0 };
+    mPreprocessorStats.insertAt(ps, mPreprocessors.add(effect));
     return NO_ERROR;
 }
 
@@ -2304,6 +4189,7 @@ status_t AudioHardware::AudioStreamInALSA::removeAudioEffect(effect_handle_t eff
         for (size_t i = 0; i < mPreprocessors.size(); i++) {
             if (mPreprocessors[i] == effect) {
                 mPreprocessors.removeAt(i);
+                mPreprocessorStats.removeAt(i);
                 status = NO_ERROR;
                 break;
             }
@@ -2316,7 +4202,7 @@ status_t AudioHardware::AudioStreamInALSA::removeAudioEffect(effect_handle_t eff
             if (memcmp(&desc.type, FX_IID_AEC, sizeof(effect_uuid_t)) == 0) {
                 ALOGV("AudioStreamInALSA::removeAudioEffect() mNeedEchoReference false");
                 mNeedEchoReference = false;
-                standby();
+                standbyNow();
             }
         }
     }
@@ -2324,25 +4210,6 @@ status_t AudioHardware::AudioStreamInALSA::removeAudioEffect(effect_handle_t eff
     return status;
 }
 
-extern "C" {
-int AudioHardware::AudioStreamInALSA::getNextBufferStatic(
-                                                    struct resampler_buffer_provider *provider,
-                                                    struct resampler_buffer* buffer)
-{
-    ResamplerBufferProvider *bufferProvider = (ResamplerBufferProvider *)provider;
-    return bufferProvider->mInputStream->getNextBuffer(buffer);
-}
-
-void AudioHardware::AudioStreamInALSA::releaseBufferStatic(
-                                                    struct resampler_buffer_provider *provider,
-                                                    struct resampler_buffer* buffer)
-{
-    ResamplerBufferProvider *bufferProvider = (ResamplerBufferProvider *)provider;
-    return bufferProvider->mInputStream->releaseBuffer(buffer);
-}
-
-}; // extern "C"
-
 status_t AudioHardware::AudioStreamInALSA::getNextBuffer(struct resampler_buffer *buffer)
 {
     if (mPcm == NULL) {
@@ -2352,29 +4219,127 @@ status_t AudioHardware::AudioStreamInALSA::getNextBuffer(struct resampler_buffer
         return NO_INIT;
     }
 
+    if (mMmap) {
+        return getNextMmapBuffer(buffer);
+    }
+
     if (mInputFramesIn == 0) {
+        countOverrun();
+        nsecs_t ioStart = systemTime(SYSTEM_TIME_MONOTONIC);
         TRACE_DRIVER_IN(DRV_PCM_READ)
-        mReadStatus = pcm_read(mPcm,(void*) mInputBuf, AUDIO_HW_IN_PERIOD_SZ * frameSize());
+        mReadStatus = pcm_read(mPcm,(void*) mInputBuf, mPcmPeriod * frameSize());
         TRACE_DRIVER_OUT
+        mStats.onIo(ioStart, systemTime(SYSTEM_TIME_MONOTONIC));
         if (mReadStatus != 0) {
             buffer->raw = NULL;
             buffer->frame_count = 0;
             return mReadStatus;
         }
-        mInputFramesIn = AUDIO_HW_IN_PERIOD_SZ;
+        mInputFramesIn = mPcmPeriod;
     }
 
     buffer->frame_count = (buffer->frame_count > mInputFramesIn) ? mInputFramesIn:buffer->frame_count;
-    buffer->i16 = mInputBuf + (AUDIO_HW_IN_PERIOD_SZ - mInputFramesIn) * mChannelCount;
+    buffer->i16 = mInputBuf + (mPcmPeriod - mInputFramesIn) * mChannelCount;
 
     return mReadStatus;
 }
 
+// same as the output, what was captured before the overrun is dropped with
+// the period being read
+status_t AudioHardware::AudioStreamInALSA::recover_l()
+{
+    if (mPcm == NULL) {
+        return NO_INIT;
+    }
+    TRACE_DRIVER_IN(DRV_PCM_PREPARE)
+    int rc = pcm_prepare(mPcm);
+    TRACE_DRIVER_OUT
+    if (rc != 0) {
+        ALOGE("AudioStreamInALSA::recover_l() pcm_prepare failed: %s", pcm_get_error(mPcm));
+        return INVALID_OPERATION;
+    }
+    mMmapStarted = false;
+    mInputFramesIn = 0;
+    mReadStatus = NO_ERROR;
+    return NO_ERROR;
+}
+
+// the kernel ring is full when read() comes late, from there on frames are dropped
+void AudioHardware::AudioStreamInALSA::countOverrun()
+{
+    size_t avail;
+    struct timespec tstamp;
+    if (pcm_get_htimestamp(mPcm, &avail, &tstamp) == 0 &&
+            avail >= pcm_get_buffer_size(mPcm)) {
+        mStats.xruns++;
+    }
+}
+
 void AudioHardware::AudioStreamInALSA::releaseBuffer(struct resampler_buffer *buffer)
 {
+    if (mMmap) {
+        if (mPcm != NULL && buffer->frame_count != 0) {
+            TRACE_DRIVER_IN(DRV_PCM_READ)
+            int rc = pcm_mmap_commit(mPcm, mMmapOffset, buffer->frame_count);
+            TRACE_DRIVER_OUT
+            if (rc < 0) {
+                mReadStatus = rc;
+            }
+        }
+        return;
+    }
     mInputFramesIn -= buffer->frame_count;
 }
 
+// hands out the captured frames in place in the DMA buffer, releaseBuffer() commits them
+status_t AudioHardware::AudioStreamInALSA::getNextMmapBuffer(struct resampler_buffer *buffer)
+{
+    int avail;
+    // twice a period, pcm_wait() times out only if the DMA stalled
+    int timeoutMs = (int)((2000 * mPcmPeriod) / mPcmRate) + 1;
+
+    if (!mMmapStarted) {
+        TRACE_DRIVER_IN(DRV_PCM_START)
+        pcm_start(mPcm);
+        TRACE_DRIVER_OUT
+        mMmapStarted = true;
+    }
+    nsecs_t ioStart = systemTime(SYSTEM_TIME_MONOTONIC);
+    avail = pcm_avail_update(mPcm);
+    if (avail > 0 && (unsigned int)avail >= pcm_get_buffer_size(mPcm)) {
+        mStats.xruns++;
+    }
+    while (avail == 0) {
+        TRACE_DRIVER_IN(DRV_PCM_WAIT)
+        int rc = pcm_wait(mPcm, timeoutMs);
+        TRACE_DRIVER_OUT
+        if (rc <= 0) {
+            avail = rc < 0 ? rc : -ETIMEDOUT;
+            break;
+        }
+        avail = pcm_avail_update(mPcm);
+    }
+    mStats.onIo(ioStart, systemTime(SYSTEM_TIME_MONOTONIC));
+
+    void *area;
+    unsigned int count = buffer->frame_count;
+    if ((size_t)avail < count) {
+        count = avail;
+    }
+    if (avail < 0 || pcm_mmap_begin(mPcm, &area, &mMmapOffset, &count) < 0) {
+        ALOGW("getNextMmapBuffer() no frames: %d", avail);
+        buffer->raw = NULL;
+        buffer->frame_count = 0;
+        mReadStatus = avail < 0 ? avail : -errno;
+        return mReadStatus;
+    }
+
+    buffer->raw = (uint8_t *)area + pcm_frames_to_bytes(mPcm, mMmapOffset);
+    buffer->frame_count = count;
+    mReadStatus = NO_ERROR;
+    return mReadStatus;
+}
+
 size_t AudioHardware::AudioStreamInALSA::getBufferSize(uint32_t sampleRate, int channelCount)
 {
     size_t i;
@@ -26,20 +26,25 @@
 #include <hardware_legacy/AudioHardwareBase.h>
 #include <media/mediarecorder.h>
 #include <hardware/audio_effect.h>
+#include <system/audio.h>
 
 #include "secril-client.h"
 
 #include <audio_utils/resampler.h>
 #include <audio_utils/echo_reference.h>
 
+#include "PolyphaseResampler.h"
+
 extern "C" {
     struct pcm;
+    struct pcm_config;
     struct mixer;
     struct mixer_ctl;
 };
 
 namespace android_audio_legacy {
     using android::AutoMutex;
+    using android::Condition;
     using android::Mutex;
     using android::RefBase;
     using android::SortedVector;
@@ -59,6 +64,18 @@ namespace android_audio_legacy {
 // Kernel pcm out buffer size in frames at 44.1kHz
 #define AUDIO_HW_OUT_PERIOD_SZ 1024
 #define AUDIO_HW_OUT_PERIOD_CNT 4
+// Low latency kernel pcm out buffer size in frames at 44.1kHz
+#define AUDIO_HW_OUT_LL_PERIOD_SZ 256
+#define AUDIO_HW_OUT_LL_PERIOD_CNT 2
+// Deep buffer kernel pcm out buffer size in frames at 44.1kHz
+#define AUDIO_HW_OUT_DB_PERIOD_SZ 4096
+#define AUDIO_HW_OUT_DB_PERIOD_CNT 4
+// HDMI sinks run at 48kHz, the direct output feeds the I2S at that rate
+#define AUDIO_HW_OUT_HDMI_SAMPLERATE 48000
+#define AUDIO_HW_OUT_HDMI_PERIOD_SZ 1024
+#define AUDIO_HW_OUT_HDMI_PERIOD_CNT 4
+// Frames one output can queue while the other one drives the pcm
+#define AUDIO_HW_OUT_MIX_FRAMES (AUDIO_HW_OUT_DB_PERIOD_SZ * 2)
 // Default audio output buffer size in bytes
 #define AUDIO_HW_OUT_PERIOD_BYTES (AUDIO_HW_OUT_PERIOD_SZ * 2 * sizeof(int16_t))
 
@@ -71,8 +88,129 @@ namespace android_audio_legacy {
 // Kernel pcm in buffer size in frames at 44.1kHz (before resampling)
 #define AUDIO_HW_IN_PERIOD_SZ 1024
 #define AUDIO_HW_IN_PERIOD_CNT 4
+// Voice recognition and communication capture: 12ms periods
+#define AUDIO_HW_IN_LL_PERIOD_SZ 512
+#define AUDIO_HW_IN_LL_PERIOD_CNT 4
+// Camcorder capture: 46ms periods, half the wakeups
+#define AUDIO_HW_IN_LONG_PERIOD_SZ 2048
+#define AUDIO_HW_IN_LONG_PERIOD_CNT 4
 // Default audio input buffer size in bytes (8kHz mono)
 #define AUDIO_HW_IN_PERIOD_BYTES ((AUDIO_HW_IN_PERIOD_SZ*sizeof(int16_t))/8)
+// Pre processing effects (AEC, NS, AGC) work on 10ms blocks
+#define AUDIO_HW_IN_PROC_BLOCK_MS 10
+
+// pcm_prepare() and retry that many times on a driver error before standby
+#define AUDIO_HW_XRUN_RETRIES 2
+
+// routing requests closer than that are applied together by the next write()
+#define AUDIO_HW_ROUTE_BATCH_MS 20
+// fade out before and in after a playback path switch
+#define AUDIO_HW_ROUTE_RAMP_MS 10
+
+// master volume applied by the HAL, Q15, ramping full scale in that time
+#define AUDIO_HW_GAIN_UNITY (1 << 15)
+#define AUDIO_HW_VOLUME_RAMP_MS 20
+
+// Echo reference ring duration, at least the playback latency plus one capture period
+#define ECHO_REF_RING_MS 500
+// Reference frames older than this relative to the capture are dropped, frames
+// rendered later than the capture wait for the next read
+#define ECHO_REF_SYNC_MS 20
+
+// Runtime counters of a stream, printed by its dump(). Updated under the stream
+// lock by the thread calling write() or read(), read without it by dump().
+#define STATS_HIST_BINS 8
+
+struct StreamStats {
+    // time between two write() or read() calls, bin 0 below 1ms then
+    // doubling, the last bin is everything above 64ms
+    uint32_t    intervalHist[STATS_HIST_BINS];
+    nsecs_t     lastCallNs;
+    // time spent in pcm_write(), pcm_read() or the mmap transfer
+    uint32_t    ioCount;
+    nsecs_t     ioTotalNs;
+    nsecs_t     ioMaxNs;
+    // ring ran empty (playback) or full (capture), and failed transfers
+    uint32_t    xruns;
+    uint32_t    errors;
+    uint32_t    standbyEnter;
+    uint32_t    standbyExit;
+    nsecs_t     standbyStartNs;
+    nsecs_t     standbyTotalNs;
+    nsecs_t     standbyMaxNs;
+
+                StreamStats() { reset(); }
+    void        reset();
+    void        onCall(nsecs_t now);
+    void        onIo(nsecs_t start, nsecs_t end);
+    void        onEnterStandby(nsecs_t now);
+    void        onExitStandby(nsecs_t now);
+    void        dump(android::String8& result, const char *xrunName) const;
+};
+
+// Playback frames handed to the AEC of the capture stream. One write() thread and
+// one read() thread, neither one takes a lock or waits for the other: frames go
+// through a single producer / single consumer ring and the render time stamp of
+// the last published frame is exchanged through a sequence counter. The writer
+// overwrites what the reader could not keep up with, the reader finds out from
+// the write head and resyncs.
+class EchoReference
+{
+public:
+                        EchoReference(uint32_t rdChannelCount, uint32_t rdSampleRate,
+                                      uint32_t wrChannelCount, uint32_t wrSampleRate);
+                        ~EchoReference();
+            status_t    initCheck() const { return mRing != NULL ? NO_ERROR : NO_INIT; }
+
+    // playback side, b->time_stamp + b->delay_ns is the render time of the last frame.
+    // NULL when the output stops.
+            void        write(const struct echo_reference_buffer *b);
+    // capture side, b->time_stamp - b->delay_ns is the capture time of the first frame.
+    // frame_count is updated with the frames returned and delay_ns with the echo delay.
+    // NULL when the input stops.
+            status_t    read(struct echo_reference_buffer *b);
+
+    // the resampler's buffer provider, called from read() on the capture thread
+    struct BufferProvider {
+        struct resampler_buffer_provider mProvider;
+        EchoReference *mReference;
+    };
+            int         getNextBuffer(struct resampler_buffer *buffer);
+            void        releaseBuffer(struct resampler_buffer *buffer);
+
+private:
+    struct Mark {
+        uint32_t start;      // first frame written since the output (re)started
+        uint32_t end;        // frames published
+        int64_t  renderNs;   // render time of frame end - 1, 0 while stopped
+    };
+
+            void        loadMark(Mark *mark);
+            void        skip(uint32_t frames);
+            bool        lapped(uint32_t from);
+
+    uint32_t            mRdChannelCount;
+    uint32_t            mRdSampleRate;
+    uint32_t            mWrChannelCount;
+    uint32_t            mWrSampleRate;
+    // frames at the write rate and the read channel count, power of 2
+    int16_t            *mRing;
+    uint32_t            mRingFrames;
+
+    // written by the playback thread only
+    volatile int32_t    mSeq;
+    Mark                mMark;
+    // frames the ring is being written up to, raised before the frames go in
+    volatile int32_t    mWrHead;
+    uint32_t            mWr;
+    bool                mWrStopped;
+
+    // used by the capture thread only
+    uint32_t            mRd;
+    uint32_t            mRdLimit;
+    struct resampler_itfe *mResampler;
+    BufferProvider      mProvider;
+};
 
 
 class AudioHardware : public AudioHardwareBase
@@ -109,6 +247,11 @@ public:
         uint32_t devices, int *format=0, uint32_t *channels=0,
         uint32_t *sampleRate=0, status_t *status=0);
 
+    virtual AudioStreamOut* openOutputStreamWithFlags(
+        uint32_t devices, audio_output_flags_t flags=(audio_output_flags_t)0,
+        int *format=0, uint32_t *channels=0,
+        uint32_t *sampleRate=0, status_t *status=0);
+
     virtual AudioStreamIn* openInputStream(
         uint32_t devices, int *format, uint32_t *channels,
         uint32_t *sampleRate, status_t *status,
@@ -126,14 +269,19 @@ public:
             const char *getVoiceRouteFromDevice(uint32_t device);
 
             status_t setIncallPath_l(uint32_t device);
+            void prepareInCall_l();
+            void unprepareInCall_l();
 
 #ifdef HAVE_FM_RADIO
             void enableFMRadio();
             void disableFMRadio();
             status_t setFMRadioPath_l(uint32_t device);
+            void setFmVolume_l(float volume);
 #endif
 
             status_t setInputSource_l(audio_source source);
+            // INPUT_PROFILE_* the current input source captures with
+            int inputProfile_l() const;
 
             void setVoiceVolume_l(float volume);
 
@@ -142,18 +290,61 @@ public:
 
            Mutex& lock() { return mLock; }
 
-           struct pcm *openPcmOut_l();
+           struct pcm *openPcmOut_l(int profile = OUTPUT_PROFILE_NORMAL);
            void closePcmOut_l();
+           // geometry of the open pcm_out, mmap when the driver allows it
+           bool pcmMmap_l() { return mPcmMmap; }
+           int pcmProfile_l() { return mPcmProfile; }
+           uint32_t pcmRate_l()
+               { return outputConfigTable[mPcmProfile][OUTPUT_CONFIG_SAMPLE_RATE]; }
+           unsigned int pcmStartThreshold_l() { return mPcmStartThreshold; }
+           bool mmapEnabled() { return mMmapEnabled; }
+
+           // one output drives the pcm, the other ones queue their frames
+           // for the driver to mix in
+           bool pcmDriverActive_l() { return mPcmDriver != NULL; }
+           bool isPcmDriver_l(AudioStreamOutALSA *out) { return mPcmDriver == out; }
+           void setPcmDriver_l(AudioStreamOutALSA *out);
+           void releasePcmDriver_l(AudioStreamOutALSA *out);
+           size_t mixFramesIn_l();
+           size_t pushMixFrames_l(AudioStreamOutALSA *out, const int16_t *frames, size_t count);
+           size_t pullMixFrames_l(int16_t *frames, size_t count, bool mix);
+           status_t waitMixSpace_l();
+           void resetMix_l(AudioStreamOutALSA *out);
+
+           bool warmStandby() { return mWarmStandby; }
+           // AudioFlinger's standby only idles the streams for that long
+           uint32_t standbyDelayMs() { return mStandbyDelayMs; }
+           void scheduleStandby(nsecs_t deadline);
+           bool nativeCaptureRate_l(uint32_t sampleRate);
+           void dropWarmOutputs_l(AudioStreamOutALSA *out, int profile);
+           bool masterGain_l(size_t frames, int32_t *from, int32_t *to, size_t *rampFrames);
+           void setPlaybackRoute_l(const char *route);
+
+           // controls resolved by openMixer_l(), NULL while the mixer is closed
+           enum {
+               MIXER_CTL_PLAYBACK_PATH,
+               MIXER_CTL_VOICE_CALL_PATH,
+               MIXER_CTL_CAPTURE_MIC_PATH,
+               MIXER_CTL_INPUT_SOURCE,
+               MIXER_CTL_FM_RADIO_PATH,
+               MIXER_CTL_CODEC_STATUS,
+               MIXER_CTL_CNT
+           };
+           struct mixer_ctl *getMixerCtl_l(int id) { return mMixerCtls[id].ctl; }
+           status_t setMixerEnum_l(int id, const char *value);
 
            struct mixer *openMixer_l();
            void closeMixer_l();
 
            sp <AudioStreamOutALSA>  output() { return mOutput; }
+           // the output holding the pcm out driver, if any
+           sp <AudioStreamOutALSA>  pcmOutput_l();
 
-           struct echo_reference_itfe *getEchoReference(audio_format_t format,
+           EchoReference *getEchoReference(audio_format_t format,
                                           uint32_t channelCount,
                                           uint32_t samplingRate);
-           void releaseEchoReference(struct echo_reference_itfe *reference);
+           void releaseEchoReference(EchoReference *reference);
 
 protected:
     virtual status_t dump(int fd, const Vector<String16>& args);
@@ -170,6 +361,29 @@ private:
     bool            mInit;
     bool            mMicMute;
     sp <AudioStreamOutALSA>                 mOutput;
+    sp <AudioStreamOutALSA>                 mFastOutput;
+    sp <AudioStreamOutALSA>                 mDeepOutput;
+    // direct to AUX_DIGITAL, never mixed with the others
+    sp <AudioStreamOutALSA>                 mHdmiOutput;
+    AudioStreamOutALSA*                     mPcmDriver;
+    // stereo frames queued by each output that doesn't drive the pcm, the
+    // HDMI one plays at its own rate and never queues any
+    enum {
+        OUTPUT_SLOT_PRIMARY,
+        OUTPUT_SLOT_FAST,
+        OUTPUT_SLOT_DEEP_BUFFER,
+        OUTPUT_SLOT_HDMI,
+        OUTPUT_SLOT_CNT
+    };
+    struct MixQueue {
+        int16_t    *buf;
+        size_t      read;
+        size_t      framesIn;
+    };
+    MixQueue        mMixQueues[OUTPUT_SLOT_CNT];
+    Condition       mMixCond;
+
+    MixQueue       *mixQueue_l(AudioStreamOutALSA *out);
     SortedVector < sp<AudioStreamInALSA> >   mInputs;
     Mutex           mLock;
     struct pcm*     mPcm;
@@ -177,7 +391,13 @@ private:
     uint32_t        mPcmOpenCnt;
     uint32_t        mMixerOpenCnt;
     bool            mInCallAudioMode;
+    // the mixer is held open and rild connected ahead of MODE_IN_CALL
+    bool            mInCallPrepared;
     float           mVoiceVol;
+    // the gain requested by setMasterVolume() and the one reached by the
+    // last buffer written, both Q15
+    int32_t         mMasterGain;
+    int32_t         mMasterGainOut;
 
     audio_source    mInputSource;
     bool            mBluetoothNrec;
@@ -196,12 +416,73 @@ private:
     int             (*setCallClockSync)(HRilClient, SoundClockCondition);
     void            loadRILD(void);
     status_t        connectRILDIfRequired(void);
-    struct echo_reference_itfe *mEchoReference;
+
+    // secril-client calls are made by mRilThread in queue order so that rild never
+    // holds up the hardware lock. A route or volume still queued is replaced by a
+    // newer one of the same kind unless a clock sync sits in between.
+    enum {
+        RIL_CMD_CLOCK_SYNC,
+        RIL_CMD_AUDIO_PATH,
+        RIL_CMD_VOLUME,
+        RIL_CMD_CONNECT     // nothing but the connection, ahead of a call
+    };
+    struct RilCommand {
+        int         cmd;
+        int         arg0;
+        int         arg1;
+        uint32_t    seq;
+    };
+    class RilThread : public android::Thread
+    {
+    public:
+                    RilThread(AudioHardware *hw) : Thread(false), mHardware(hw) {}
+    private:
+        virtual bool threadLoop() { return mHardware->rilThreadLoop(); }
+        AudioHardware *mHardware;
+    };
+    uint32_t        postRilCommand(int cmd, int arg0, int arg1 = 0);
+    bool            rilThreadLoop();
+
+    sp<RilThread>   mRilThread;
+    Mutex           mRilLock;
+    Condition       mRilCond;
+    Vector<RilCommand> mRilCommands;
+    // last queued and last completed command, completions come in queue order
+    uint32_t        mRilSeq;
+    uint32_t        mRilDoneSeq;
+    int             mRilLastError;
+    bool            mRilExit;
+    EchoReference  *mEchoReference;
+
+            AudioStreamOut* openOutputStream_l(int slot,
+                                               int profile, uint32_t devices,
+                                               int *format, uint32_t *channels,
+                                               uint32_t *sampleRate, status_t *status);
 
 #ifdef HAVE_FM_RADIO
     int             mFmFd;
     float           mFmVolume;
+    // last level given to the tuner, -1 until FM is on
+    int             mFmLevel;
     bool            mFmResumeAfterCall;
+
+    // walks the tuner volume to mFmTarget one level at a time, with mLock
+    class FmRampThread : public android::Thread
+    {
+    public:
+                    FmRampThread(AudioHardware *hw) : Thread(false), mHardware(hw) {}
+    private:
+        virtual bool threadLoop() { return mHardware->fmRampThreadLoop(); }
+        AudioHardware *mHardware;
+    };
+    bool            fmRampThreadLoop();
+
+    sp<FmRampThread> mFmRampThread;
+    // signalled with mLock held when the target changes
+    Condition       mFmRampCond;
+    int             mFmTarget;
+    nsecs_t         mFmStepNs;
+    bool            mFmRampExit;
 #endif
 
     //  trace driver operations for dump
@@ -213,13 +494,100 @@ private:
     enum {
         INPUT_CONFIG_SAMPLE_RATE,
         INPUT_CONFIG_BUFFER_RATIO,
+        INPUT_CONFIG_NATIVE,
         INPUT_CONFIG_CNT
     };
 
     // contains the list of valid sampling rates for input streams as well as the ratio
     // between the kernel buffer size and audio hal buffer size for each sampling rate
+    // and whether the codec can capture at that rate
     static const uint32_t  inputConfigTable[][INPUT_CONFIG_CNT];
 
+    // row index in inputPeriodTable[][]
+    enum {
+        INPUT_PROFILE_NORMAL,
+        INPUT_PROFILE_LOW_LATENCY,
+        INPUT_PROFILE_LONG,
+        INPUT_PROFILE_CNT
+    };
+
+    // column index in inputPeriodTable[][]
+    enum {
+        INPUT_PERIOD_SIZE,
+        INPUT_PERIOD_COUNT,
+        INPUT_PERIOD_CNT
+    };
+
+    // kernel buffer geometry of each input profile at AUDIO_HW_IN_SAMPLERATE, a native
+    // rate capture scales the period by the same ratio to the normal one
+    static const uint32_t  inputPeriodTable[][INPUT_PERIOD_CNT];
+
+    // row index in outputConfigTable[][]
+    enum {
+        OUTPUT_PROFILE_NORMAL,
+        OUTPUT_PROFILE_LOW_LATENCY,
+        OUTPUT_PROFILE_DEEP_BUFFER,
+        OUTPUT_PROFILE_HDMI,
+        OUTPUT_PROFILE_CNT
+    };
+
+    // column index in outputConfigTable[][]
+    enum {
+        OUTPUT_CONFIG_PERIOD_SIZE,
+        OUTPUT_CONFIG_PERIOD_COUNT,
+        OUTPUT_CONFIG_START_THRESHOLD,
+        OUTPUT_CONFIG_SAMPLE_RATE,
+        OUTPUT_CONFIG_CNT
+    };
+
+    // kernel buffer geometry and rate of each output profile. There is one pcm_out,
+    // outputs of different rates take turns on it and are never mixed together
+    static const uint32_t  outputConfigTable[][OUTPUT_CONFIG_CNT];
+    // profile the pcm out driver was opened with
+    int             mPcmProfile;
+    bool            mPcmMmap;
+    unsigned int    mPcmStartThreshold;
+// Values kept per mixer control, the routing enums are much shorter
+#define MIXER_CTL_MAX_ENUMS 32
+
+    struct MixerCtl {
+        struct mixer_ctl *ctl;
+        unsigned int numEnums;
+        const char *enums[MIXER_CTL_MAX_ENUMS];
+        // last value set, by address
+        const char *lastValue;
+        int lastIndex;
+    };
+
+    static const char * const mixerCtlNames[MIXER_CTL_CNT];
+    MixerCtl        mMixerCtls[MIXER_CTL_CNT];
+            void    resolveMixerCtls_l();
+
+    // last route set on the Playback Path, NULL when unknown
+    const char*     mPlaybackRoute;
+    bool            mWarmStandby;
+    bool            mNativeCapture;
+    bool            mMmapEnabled;
+
+    // puts the idle streams in standby once their delay ran out
+    class StandbyThread : public android::Thread
+    {
+    public:
+                    StandbyThread(AudioHardware *hw) : Thread(false), mHardware(hw) {}
+    private:
+        virtual bool threadLoop() { return mHardware->standbyThreadLoop(); }
+        AudioHardware *mHardware;
+    };
+    bool            standbyThreadLoop();
+
+    uint32_t        mStandbyDelayMs;
+    sp<StandbyThread> mStandbyThread;
+    Mutex           mStandbyLock;
+    Condition       mStandbyCond;
+    // earliest deadline of the idle streams, 0 when none
+    nsecs_t         mStandbyWakeNs;
+    bool            mStandbyExit;
+
     class AudioStreamOutALSA : public AudioStreamOut, public RefBase
     {
     public:
@@ -227,6 +595,7 @@ private:
         virtual ~AudioStreamOutALSA();
         status_t set(AudioHardware* mHardware,
                      uint32_t devices,
+                     int profile,
                      int *pFormat,
                      uint32_t *pChannels,
                      uint32_t *pRate);
@@ -239,13 +608,15 @@ private:
         virtual int format()
             const { return AUDIO_HW_OUT_FORMAT; }
         virtual uint32_t latency()
-            const { return (1000 * AUDIO_HW_OUT_PERIOD_CNT *
-                            (bufferSize()/frameSize()))/sampleRate() +
+            const { return (1000 * outputConfigTable[mProfile][OUTPUT_CONFIG_PERIOD_COUNT] *
+                            outputConfigTable[mProfile][OUTPUT_CONFIG_PERIOD_SIZE])/sampleRate() +
                 AUDIO_HW_OUT_LATENCY_MS; }
         virtual status_t setVolume(float left, float right)
         { return INVALID_OPERATION; }
         virtual ssize_t write(const void* buffer, size_t bytes);
         virtual status_t standby();
+                status_t standbyNow();
+                nsecs_t checkStandbyTimeout(nsecs_t now);
                 bool checkStandby();
 
         virtual status_t dump(int fd, const Vector<String16>& args);
@@ -253,23 +624,40 @@ private:
         virtual String8 getParameters(const String8& keys);
         uint32_t device() { return mDevices; }
         virtual status_t getRenderPosition(uint32_t *dspFrames);
+        // frames the DAC played by timestamp on CLOCK_MONOTONIC, never waits on the pcm
+        virtual status_t getPresentationPosition(uint64_t *frames, struct timespec *timestamp);
 
-                void doStandby_l();
+                void doStandby_l(bool warm = false);
                 void close_l();
                 status_t open_l();
                 int standbyCnt() { return mStandbyCnt; }
+                bool isWarm_l() { return mStandby && mPcm != NULL; }
 
                 int prepareLock();
                 void lock();
                 void unlock();
 
-                void addEchoReference(struct echo_reference_itfe *reference);
-                void removeEchoReference(struct echo_reference_itfe *reference);
+                void addEchoReference(EchoReference *reference);
+                void removeEchoReference(EchoReference *reference);
 
     private:
 
                 int computeEchoReferenceDelay(size_t frames, struct timespec *echoRefRenderTime);
                 int getPlaybackDelay(size_t frames, struct echo_reference_buffer *buffer);
+                status_t writeMixed_l(const uint8_t **buffer, size_t *bytes);
+                int16_t *mixScratch(size_t bytes);
+                int writeMmap_l(const uint8_t **buffer, size_t *bytes, bool mix);
+                status_t recover_l();
+                void updatePresentation_l();
+                bool takePendingRoute(nsecs_t now, bool force, uint32_t *devices);
+                int16_t *writableFrames_l(const uint8_t *buffer, size_t bytes, bool *mixInPlace);
+                const uint8_t *rampFrames_l(const uint8_t *buffer, size_t bytes, bool fadeOut,
+                                            bool *mixInPlace);
+                const uint8_t *applyMasterGain_l(const uint8_t *buffer, size_t bytes,
+                                                 bool *mixInPlace);
+                void switchRoute_l(uint32_t devices, size_t silentFrames);
+
+        StreamStats mStats;
 
         Mutex mLock;
         AudioHardware* mHardware;
@@ -282,11 +670,37 @@ private:
         uint32_t mChannels;
         uint32_t mSampleRate;
         size_t mBufferSize;
+        int mProfile;
+        // frames go to the other output instead of the pcm
+        bool mMixing;
+        int16_t *mMixScratch;
+        size_t mMixScratchSize;
+        // frames handed to the pcm since the last open_l(), for getRenderPosition()
+        size_t mFramesWritten;
+        // frames of the pcm runs before, standby comes after they played
+        uint64_t mFramesPresentedBase;
+        // the hardware pointer as of the last write, mPositionLock is never held
+        // across a pcm call
+        Mutex mPositionLock;
+        uint64_t mPresentedFrames;
+        struct timespec mPresentedTime;
+        bool mMmapStarted;
+        // when the buffers dropped on consecutive errors would have been played
+        nsecs_t mErrorPaceNs;
+        // idle after standby() until then, 0 when writing or in standby
+        nsecs_t mStandbyDeadline;
+        // routing requests wait here for write(), mRouteLock never blocks on the pcm
+        Mutex mRouteLock;
+        bool mRoutePending;
+        uint32_t mPendingDevices;
+        nsecs_t mRouteReqNs;
+        // frames of fade in played since the last path switch
+        size_t mRampPos;
         //  trace driver operations for dump
         int mDriverOp;
         int mStandbyCnt;
         bool mSleepReq;
-        struct echo_reference_itfe *mEchoReference;
+        EchoReference *mEchoReference;
     };
 
     class AudioStreamInALSA : public AudioStreamIn, public RefBase
@@ -309,6 +723,8 @@ private:
         virtual ssize_t read(void* buffer, ssize_t bytes);
         virtual status_t dump(int fd, const Vector<String16>& args);
         virtual status_t standby();
+                status_t standbyNow();
+                nsecs_t checkStandbyTimeout(nsecs_t now);
                 bool checkStandby();
         virtual status_t setParameters(const String8& keyValuePairs);
         virtual String8 getParameters(const String8& keys);
@@ -324,23 +740,12 @@ private:
 
         static size_t getBufferSize(uint32_t sampleRate, int channelCount);
 
-        // resampler_buffer_provider
-        static int getNextBufferStatic(struct resampler_buffer_provider *provider,
-                             struct resampler_buffer* buffer);
-        static void releaseBufferStatic(struct resampler_buffer_provider *provider,
-                             struct resampler_buffer* buffer);
-
         int prepareLock();
         void lock();
         void unlock();
 
      private:
 
-        struct ResamplerBufferProvider {
-            struct resampler_buffer_provider mProvider;
-            AudioStreamInALSA *mInputStream;
-        };
-
         ssize_t readFrames(void* buffer, ssize_t frames);
         ssize_t processFrames(void* buffer, ssize_t frames);
         int32_t updateEchoReference(size_t frames);
@@ -350,9 +755,19 @@ private:
         status_t setPreProcessorEchoDelay(effect_handle_t handle, int32_t delayUs);
         status_t setPreprocessorParam(effect_handle_t handle, effect_param_t *param);
 
-        // BufferProvider
+        // kernel period buffer, or the DMA buffer itself in mmap mode
         status_t getNextBuffer(struct resampler_buffer* buffer);
         void releaseBuffer(struct resampler_buffer* buffer);
+        status_t getNextMmapBuffer(struct resampler_buffer* buffer);
+        void countOverrun();
+        status_t recover_l();
+
+        struct PreprocessorStats {
+            nsecs_t cpuNs;
+            uint32_t calls;
+        };
+        StreamStats mStats;
+        status_t openPcm_l(struct pcm_config *config);
 
         Mutex mLock;
         AudioHardware* mHardware;
@@ -366,8 +781,17 @@ private:
         uint32_t mChannelCount;
         uint32_t mSampleRate;
         size_t mBufferSize;
-        struct resampler_itfe *mDownSampler;
-        struct ResamplerBufferProvider mBufferProvider;
+        PolyphaseResampler *mDownSampler;
+        // rate and period the pcm was opened with, mSampleRate when captured natively
+        uint32_t mPcmRate;
+        size_t mPcmPeriod;
+        size_t mPcmPeriodCount;
+        int mPcmProfile;
+        bool mMmap;
+        bool mMmapStarted;
+        unsigned int mMmapOffset;
+        nsecs_t mErrorPaceNs;
+        nsecs_t mStandbyDeadline;
         status_t mReadStatus;
         size_t mInputFramesIn;
         int16_t *mInputBuf;
@@ -376,13 +800,18 @@ private:
         int mStandbyCnt;
         bool mSleepReq;
         SortedVector<effect_handle_t> mPreprocessors;
+        // same order as mPreprocessors
+        Vector<PreprocessorStats> mPreprocessorStats;
+        // ring of unprocessed frames, see processFrames()
         int16_t *mProcBuf;
         size_t mProcBufSize;
+        size_t mProcBlock;
+        size_t mProcRead;
         size_t mProcFramesIn;
         int16_t *mRefBuf;
         size_t mRefBufSize;
         size_t mRefFramesIn;
-        struct echo_reference_itfe *mEchoReference;
+        EchoReference *mEchoReference;
         bool mNeedEchoReference;
     };
 
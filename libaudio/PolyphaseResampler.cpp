@@ -0,0 +1,191 @@
+/*
+** Copyright 2010, The Android Open-Source Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#include <math.h>
+#include <string.h>
+
+#define LOG_TAG "PolyphaseResampler"
+
+#include <utils/Log.h>
+
+#if defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+#include "PolyphaseResampler.h"
+
+namespace android_audio_legacy {
+
+// pass band edge relative to the lower of the two Nyquist rates
+#define RSMP_CUTOFF 0.9
+
+static uint32_t gcd(uint32_t a, uint32_t b)
+{
+    while (b != 0) {
+        uint32_t r = a % b;
+        a = b;
+        b = r;
+    }
+    return a;
+}
+
+PolyphaseResampler::PolyphaseResampler(uint32_t inRate, uint32_t outRate,
+                                       uint32_t channelCount) :
+    mInRate(inRate), mChannelCount(channelCount), mL(0), mM(0), mTaps(RSMP_TAPS),
+    mCoefs(NULL), mPhase(0)
+{
+    mWork[0] = mWork[1] = NULL;
+
+    if (inRate == 0 || outRate == 0 || channelCount < 1 || channelCount > 2) {
+        ALOGE("PolyphaseResampler() bad config %u -> %u, %u channels",
+              inRate, outRate, channelCount);
+        return;
+    }
+
+    uint32_t g = gcd(inRate, outRate);
+    mL = outRate / g;
+    mM = inRate / g;
+    if (mM > mL) {
+        uint32_t taps = (RSMP_TAPS * mM / mL / 2 + 7) & ~7;
+        if (taps > mTaps) {
+            mTaps = taps;
+        }
+    }
+
+    // prototype low pass at mL * inRate, mTaps * mL long with a Blackman window
+    uint32_t len = mL * mTaps;
+    double fc = RSMP_CUTOFF * 0.5 * (inRate < outRate ? inRate : outRate) / ((double)mL * inRate);
+    double *h = new double[len];
+    double sum = 0;
+    for (uint32_t k = 0; k < len; k++) {
+        double x = (double)k - (len - 1) / 2.0;
+        double s = (x == 0) ? 2 * fc : sin(2 * M_PI * fc * x) / (M_PI * x);
+        double w = 0.42 - 0.5 * cos(2 * M_PI * k / (len - 1)) +
+                   0.08 * cos(4 * M_PI * k / (len - 1));
+        h[k] = s * w;
+        sum += h[k];
+    }
+
+    // unity gain for each phase on average
+    mCoefs = new int16_t[len];
+    for (uint32_t p = 0; p < mL; p++) {
+        for (uint32_t j = 0; j < mTaps; j++) {
+            double c = h[p + j * mL] * mL / sum * 32768.0;
+            if (c > 32767.0) c = 32767.0;
+            if (c < -32768.0) c = -32768.0;
+            mCoefs[p * mTaps + mTaps - 1 - j] = (int16_t)lrint(c);
+        }
+    }
+    delete[] h;
+
+    for (uint32_t c = 0; c < mChannelCount; c++) {
+        mWork[c] = new int16_t[mTaps - 1 + RSMP_BLOCK];
+    }
+    reset();
+
+    ALOGV("PolyphaseResampler() %u -> %u, %u phases of %u taps", inRate, outRate, mL, mTaps);
+}
+
+PolyphaseResampler::~PolyphaseResampler()
+{
+    delete[] mCoefs;
+    delete[] mWork[0];
+    delete[] mWork[1];
+}
+
+void PolyphaseResampler::reset()
+{
+    for (uint32_t c = 0; c < mChannelCount; c++) {
+        memset(mWork[c], 0, (mTaps - 1) * sizeof(int16_t));
+    }
+    mPhase = 0;
+}
+
+int32_t PolyphaseResampler::delayNs() const
+{
+    return (int32_t)(((int64_t)mTaps * 1000000000) / (2 * mInRate));
+}
+
+inline int32_t PolyphaseResampler::dot(const int16_t *x, const int16_t *h) const
+{
+    int32_t acc;
+#if defined(__ARM_NEON__)
+    int32x4_t acc0 = vdupq_n_s32(0);
+    int32x4_t acc1 = vdupq_n_s32(0);
+    for (uint32_t j = 0; j < mTaps; j += 8) {
+        int16x8_t vx = vld1q_s16(x + j);
+        int16x8_t vh = vld1q_s16(h + j);
+        acc0 = vmlal_s16(acc0, vget_low_s16(vx), vget_low_s16(vh));
+        acc1 = vmlal_s16(acc1, vget_high_s16(vx), vget_high_s16(vh));
+    }
+    acc0 = vaddq_s32(acc0, acc1);
+    int32x2_t acc2 = vadd_s32(vget_low_s32(acc0), vget_high_s32(acc0));
+    acc = vget_lane_s32(vpadd_s32(acc2, acc2), 0);
+#else
+    acc = 0;
+    for (uint32_t j = 0; j < mTaps; j++) {
+        acc += (int32_t)x[j] * h[j];
+    }
+#endif
+    acc = (acc + (1 << 14)) >> 15;
+    if (acc > 32767) acc = 32767;
+    if (acc < -32768) acc = -32768;
+    return acc;
+}
+
+void PolyphaseResampler::resample(const int16_t *in, size_t *inFrames,
+                                  int16_t *out, size_t *outFrames)
+{
+    size_t inDone = 0;
+    size_t outDone = 0;
+
+    while (inDone < *inFrames && outDone < *outFrames) {
+        size_t n = *inFrames - inDone;
+        if (n > RSMP_BLOCK) {
+            n = RSMP_BLOCK;
+        }
+        const int16_t *src = in + inDone * mChannelCount;
+        for (size_t k = 0; k < n; k++) {
+            for (uint32_t c = 0; c < mChannelCount; c++) {
+                mWork[c][mTaps - 1 + k] = src[k * mChannelCount + c];
+            }
+        }
+
+        // output frame at time t needs input frames up to t / mL of this block
+        uint32_t t = mPhase;
+        while (t / mL < n && outDone < *outFrames) {
+            const int16_t *h = mCoefs + (t % mL) * mTaps;
+            for (uint32_t c = 0; c < mChannelCount; c++) {
+                out[outDone * mChannelCount + c] = dot(mWork[c] + t / mL, h);
+            }
+            outDone++;
+            t += mM;
+        }
+
+        // frames not reached yet are left to the caller when out is full
+        size_t used = t / mL < n ? t / mL : n;
+        for (uint32_t c = 0; c < mChannelCount; c++) {
+            memmove(mWork[c], mWork[c] + used, (mTaps - 1) * sizeof(int16_t));
+        }
+        mPhase = t - used * mL;
+        inDone += used;
+    }
+
+    *inFrames = inDone;
+    *outFrames = outDone;
+}
+
+}; // namespace android_audio_legacy
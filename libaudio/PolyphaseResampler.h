@@ -0,0 +1,70 @@
+/*
+** Copyright 2010, The Android Open-Source Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#ifndef ANDROID_POLYPHASE_RESAMPLER_H
+#define ANDROID_POLYPHASE_RESAMPLER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+namespace android_audio_legacy {
+
+// Taps per phase, a multiple of 8 for the neon dot product. Downsampling
+// stretches the filter by half the decimation ratio to keep the transition
+// band under the output Nyquist rate.
+#define RSMP_TAPS 32
+// Input frames de-interleaved per pass
+#define RSMP_BLOCK 256
+
+// Fixed point windowed sinc resampler for 16 bit mono or stereo frames.
+// The rate ratio is reduced to outRate/inRate = L/M and the filter is split in
+// L phases of mTaps Q15 coefficients.
+class PolyphaseResampler
+{
+public:
+                        PolyphaseResampler(uint32_t inRate, uint32_t outRate,
+                                           uint32_t channelCount);
+                        ~PolyphaseResampler();
+            bool        initCheck() const { return mCoefs != NULL; }
+
+    // consumes up to *inFrames from in and writes up to *outFrames to out,
+    // both are updated with the frames actually used
+            void        resample(const int16_t *in, size_t *inFrames,
+                                 int16_t *out, size_t *outFrames);
+            void        reset();
+    // group delay of the filter
+            int32_t     delayNs() const;
+
+private:
+            int32_t     dot(const int16_t *x, const int16_t *h) const;
+
+    uint32_t            mInRate;
+    uint32_t            mChannelCount;
+    uint32_t            mL;
+    uint32_t            mM;
+    uint32_t            mTaps;
+    // mL phases of mTaps taps, reversed so that they run with the input
+    int16_t            *mCoefs;
+    // per channel: the last mTaps - 1 input frames then one block
+    int16_t            *mWork[2];
+    // time of the next output frame, in 1/mL input frames past the history
+    uint32_t            mPhase;
+};
+
+}; // namespace android_audio_legacy
+
+#endif // ANDROID_POLYPHASE_RESAMPLER_H
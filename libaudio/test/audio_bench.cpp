@@ -0,0 +1,495 @@
+/*
+** Copyright 2010, The Android Open-Source Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+/*
+ * Plays a train of short chirps through the HAL and captures them back, by
+ * an acoustic (speaker to mic) or an analog loopback, to measure the round
+ * trip latency from write() to read() and its jitter, along with the cpu
+ * time of each write() and read() call. It runs once per output profile and
+ * per preprocessing chain so the period geometries can be compared.
+ *
+ * The HAL is loaded with dlopen() and created with createAudioHardware(),
+ * stop the media server first: "stop media; audio-bench".
+ *
+ * usage: audio-bench [-t seconds per run] [-o primary,fast,deep]
+ *                    [-e aec,ns,agc] [-r capture rate] [-l hal library]
+ *
+ * the config of a result is the output profile and preprocessing chain.
+ */
+
+#include <hardware_legacy/AudioHardwareInterface.h>
+#include <hardware_legacy/AudioSystemLegacy.h>
+#include <media/EffectsFactoryApi.h>
+#include <audio_effects/effect_aec.h>
+#include <audio_effects/effect_ns.h>
+#include <audio_effects/effect_agc.h>
+#include <utils/threads.h>
+#include <utils/Timers.h>
+#include <utils/Vector.h>
+#include <utils/String8.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <unistd.h>
+#include <dlfcn.h>
+
+#include <sec_bench.h>
+
+using namespace android;
+using namespace android_audio_legacy;
+
+typedef AudioHardwareInterface *(*create_hw_t)(void);
+
+static const char *kDefaultHal = "/system/lib/hw/audio.primary.aries.so";
+static const uint32_t kOutRate = 44100;
+// chirp length and spacing, far enough apart for the longest buffers
+static const int kChirpMs = 10;
+static const int kChirpPeriodMs = 500;
+// normalized correlation accepted as a detection
+static const float kDetectLevel = 0.5f;
+
+// ---------------------------------------------------------------------------
+// test signal
+
+// linear sweep 1kHz to 5kHz with a Hann window, the same at any rate
+static void makeChirp(Vector<float> &chirp, uint32_t rate)
+{
+    size_t len = rate * kChirpMs / 1000;
+    double T = kChirpMs / 1000.0;
+
+    chirp.clear();
+    for (size_t i = 0; i < len; i++) {
+        double t = (double)i / rate;
+        double w = 0.5 - 0.5 * cos(2 * M_PI * i / (len - 1));
+        chirp.add((float)(w * sin(2 * M_PI * (1000.0 * t + 2000.0 * t * t / T))));
+    }
+}
+
+// matched filter over the captured stream, one onset per chirp
+struct Detector {
+    Vector<float>   tmpl;
+    double          tmplEnergy;
+    Vector<float>   history;
+    size_t          pos;
+    // best correlation of the chirp being detected and where it started
+    float           peak;
+    int64_t         peakFrame;
+    int64_t         frame;
+    int64_t         holdoff;
+
+    void init(uint32_t rate) {
+        makeChirp(tmpl, rate);
+        tmplEnergy = 0;
+        for (size_t i = 0; i < tmpl.size(); i++) {
+            tmplEnergy += tmpl[i] * tmpl[i];
+        }
+        history.clear();
+        history.insertAt(0.0f, 0, tmpl.size());
+        pos = 0;
+        peak = 0;
+        peakFrame = -1;
+        frame = 0;
+        holdoff = 0;
+    }
+
+    // returns the stream frame the chirp started at, or -1
+    int64_t push(int16_t sample) {
+        size_t len = tmpl.size();
+        int64_t onset = -1;
+
+        history.editItemAt(pos) = sample / 32768.0f;
+        pos = (pos + 1) % len;
+        frame++;
+        if (frame < holdoff) {
+            return -1;
+        }
+
+        double c = 0, e = 0;
+        for (size_t j = 0; j < len; j++) {
+            float x = history[(pos + j) % len];
+            c += x * tmpl[j];
+            e += x * x;
+        }
+        float ncc = (e > 0) ? (float)(c / sqrt(e * tmplEnergy)) : 0;
+
+        if (ncc > kDetectLevel && ncc > peak) {
+            peak = ncc;
+            peakFrame = frame - len;
+        } else if (peakFrame >= 0 && frame - peakFrame > (int64_t)(2 * len)) {
+            // past the chirp, the peak is final
+            onset = peakFrame;
+            holdoff = frame + len * (kChirpPeriodMs / kChirpMs) / 2;
+            peak = 0;
+            peakFrame = -1;
+        }
+        return onset;
+    }
+};
+
+// ---------------------------------------------------------------------------
+// one loopback run
+
+struct Run {
+    AudioStreamOut     *out;
+    AudioStreamIn      *in;
+    uint32_t            inRate;
+    nsecs_t             end;
+
+    Mutex               lock;
+    // when each chirp left the application, in order
+    Vector<nsecs_t>     played;
+    Vector<double>      latencies;
+
+    nsecs_t             writeCpu;
+    nsecs_t             readCpu;
+    int                 writes;
+    int                 reads;
+    int                 writeErrors;
+    int                 readErrors;
+};
+
+static void *playThread(void *arg)
+{
+    Run *run = (Run *)arg;
+    size_t frames = run->out->bufferSize() / run->out->frameSize();
+    int16_t *buf = new int16_t[frames * 2];
+    Vector<float> chirp;
+    size_t period = kOutRate * kChirpPeriodMs / 1000;
+    size_t phase = 0;
+
+    makeChirp(chirp, kOutRate);
+    androidSetThreadPriority(0, ANDROID_PRIORITY_AUDIO);
+
+    while (systemTime(SYSTEM_TIME_MONOTONIC) < run->end) {
+        int start = -1;
+        for (size_t i = 0; i < frames; i++) {
+            int16_t s = 0;
+            if (phase < chirp.size()) {
+                s = (int16_t)(chirp[phase] * 16384);
+            }
+            if (phase == 0) {
+                start = i;
+            }
+            buf[2 * i] = buf[2 * i + 1] = s;
+            phase = (phase + 1) % period;
+        }
+
+        nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+        nsecs_t cpu = systemTime(SYSTEM_TIME_THREAD);
+        ssize_t ret = run->out->write(buf, frames * run->out->frameSize());
+        run->writeCpu += systemTime(SYSTEM_TIME_THREAD) - cpu;
+        run->writes++;
+        if (ret < 0) {
+            run->writeErrors++;
+            continue;
+        }
+        if (start >= 0) {
+            AutoMutex lock(run->lock);
+            run->played.add(now + (nsecs_t)start * 1000000000LL / kOutRate);
+        }
+    }
+
+    delete[] buf;
+    return NULL;
+}
+
+static void *captureThread(void *arg)
+{
+    Run *run = (Run *)arg;
+    size_t frames = run->in->bufferSize() / run->in->frameSize();
+    int16_t *buf = new int16_t[frames];
+    Detector det;
+    size_t next = 0;
+
+    det.init(run->inRate);
+    androidSetThreadPriority(0, ANDROID_PRIORITY_AUDIO);
+
+    while (systemTime(SYSTEM_TIME_MONOTONIC) < run->end) {
+        nsecs_t cpu = systemTime(SYSTEM_TIME_THREAD);
+        ssize_t ret = run->in->read(buf, frames * sizeof(int16_t));
+        run->readCpu += systemTime(SYSTEM_TIME_THREAD) - cpu;
+        nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+        run->reads++;
+        if (ret <= 0) {
+            run->readErrors++;
+            continue;
+        }
+
+        size_t got = ret / sizeof(int16_t);
+        int64_t first = det.frame;
+        for (size_t i = 0; i < got; i++) {
+            int64_t onset = det.push(buf[i]);
+            if (onset < 0) {
+                continue;
+            }
+            // the buffer was complete when read() returned
+            nsecs_t captured = now - (first + got - onset) * 1000000000LL / run->inRate;
+
+            AutoMutex lock(run->lock);
+            // the last chirp played before it, earlier ones were missed
+            while (next + 1 < run->played.size() && run->played[next + 1] < captured) {
+                next++;
+            }
+            if (next < run->played.size() && run->played[next] < captured) {
+                run->latencies.add((captured - run->played[next]) / 1000000.0);
+                next++;
+            }
+        }
+    }
+
+    delete[] buf;
+    return NULL;
+}
+
+// ---------------------------------------------------------------------------
+// preprocessing
+
+static effect_handle_t createPreprocessor(const char *name, int session, uint32_t rate)
+{
+    const effect_uuid_t *type;
+    if (!strcmp(name, "aec")) {
+        type = FX_IID_AEC;
+    } else if (!strcmp(name, "ns")) {
+        type = FX_IID_NS;
+    } else if (!strcmp(name, "agc")) {
+        type = FX_IID_AGC;
+    } else {
+        LOGE("unknown preprocessor %s", name);
+        return NULL;
+    }
+
+    uint32_t count = 0;
+    EffectQueryNumberEffects(&count);
+    for (uint32_t i = 0; i < count; i++) {
+        effect_descriptor_t desc;
+        if (EffectQueryEffect(i, &desc) != 0 || memcmp(&desc.type, type, sizeof(*type))) {
+            continue;
+        }
+        effect_handle_t handle;
+        if (EffectCreate(&desc.uuid, session, 0, &handle) != 0) {
+            break;
+        }
+
+        // what AudioFlinger does before attaching an effect to an input
+        effect_config_t config;
+        memset(&config, 0, sizeof(config));
+        config.inputCfg.samplingRate = config.outputCfg.samplingRate = rate;
+        config.inputCfg.channels = config.outputCfg.channels = AUDIO_CHANNEL_IN_MONO;
+        config.inputCfg.format = config.outputCfg.format = AUDIO_FORMAT_PCM_16_BIT;
+        config.inputCfg.accessMode = EFFECT_BUFFER_ACCESS_READ;
+        config.outputCfg.accessMode = EFFECT_BUFFER_ACCESS_WRITE;
+        config.inputCfg.mask = config.outputCfg.mask = EFFECT_CONFIG_ALL;
+        int reply;
+        uint32_t size = sizeof(reply);
+        (*handle)->command(handle, EFFECT_CMD_INIT, 0, NULL, &size, &reply);
+        size = sizeof(reply);
+        (*handle)->command(handle, EFFECT_CMD_SET_CONFIG, sizeof(config), &config,
+                           &size, &reply);
+        size = sizeof(reply);
+        (*handle)->command(handle, EFFECT_CMD_ENABLE, 0, NULL, &size, &reply);
+        return handle;
+    }
+    LOGE("no %s preprocessor in the effects library", name);
+    return NULL;
+}
+
+// ---------------------------------------------------------------------------
+
+static double mean(const Vector<double> &v)
+{
+    double sum = 0;
+    for (size_t i = 0; i < v.size(); i++) {
+        sum += v[i];
+    }
+    return v.size() ? sum / v.size() : 0;
+}
+
+static int runLoopback(AudioHardwareInterface *hw, const char *profile, const char *chain,
+                       uint32_t inRate, int seconds)
+{
+    audio_output_flags_t flags = AUDIO_OUTPUT_FLAG_NONE;
+    if (!strcmp(profile, "fast")) {
+        flags = AUDIO_OUTPUT_FLAG_FAST;
+    } else if (!strcmp(profile, "deep")) {
+        flags = AUDIO_OUTPUT_FLAG_DEEP_BUFFER;
+    }
+
+    String8 config = String8::format("%s+%s@%u", profile, chain ? chain : "none", inRate);
+    int format = AudioSystem::PCM_16_BIT;
+    uint32_t channels = AudioSystem::CHANNEL_OUT_STEREO;
+    uint32_t rate = kOutRate;
+    status_t status;
+    Vector<effect_handle_t> effects;
+    Run *run = new Run();
+    int ret = -1;
+
+    run->out = hw->openOutputStreamWithFlags(AudioSystem::DEVICE_OUT_SPEAKER, flags,
+                                             &format, &channels, &rate, &status);
+    if (run->out == NULL) {
+        LOGE("%s: cannot open output: %d", config.string(), status);
+        delete run;
+        return -1;
+    }
+
+    format = AudioSystem::PCM_16_BIT;
+    channels = AudioSystem::CHANNEL_IN_MONO;
+    rate = inRate;
+    run->in = hw->openInputStream(AudioSystem::DEVICE_IN_BUILTIN_MIC, &format, &channels,
+                                  &rate, &status, (AudioSystem::audio_in_acoustics)0);
+    if (run->in == NULL) {
+        LOGE("%s: cannot open input: %d", config.string(), status);
+        goto close_out;
+    }
+    run->inRate = rate;
+
+    if (chain != NULL) {
+        char names[64];
+        strncpy(names, chain, sizeof(names) - 1);
+        names[sizeof(names) - 1] = '\0';
+        for (char *name = strtok(names, ","); name != NULL; name = strtok(NULL, ",")) {
+            effect_handle_t handle = createPreprocessor(name, 1, run->inRate);
+            if (handle == NULL || run->in->addAudioEffect(handle) != NO_ERROR) {
+                LOGE("%s: cannot add %s", config.string(), name);
+                if (handle != NULL) {
+                    EffectRelease(handle);
+                }
+                goto close_in;
+            }
+            effects.add(handle);
+        }
+    }
+
+    LOGI("%s: out %u bytes %u ms, in %u bytes, %d s", config.string(),
+         run->out->bufferSize(), run->out->latency(), run->in->bufferSize(), seconds);
+
+    {
+        pthread_t player, capture;
+        run->end = systemTime(SYSTEM_TIME_MONOTONIC) + seconds_to_nanoseconds(seconds);
+        pthread_create(&capture, NULL, captureThread, run);
+        pthread_create(&player, NULL, playThread, run);
+        pthread_join(player, NULL);
+        pthread_join(capture, NULL);
+    }
+    run->out->standby();
+    run->in->standby();
+
+    if (run->latencies.size() == 0) {
+        LOGE("%s: none of the %d chirps came back, check the loopback", config.string(),
+             run->played.size());
+    } else {
+        double m = mean(run->latencies);
+        double lo = run->latencies[0], hi = run->latencies[0], var = 0;
+        for (size_t i = 0; i < run->latencies.size(); i++) {
+            double l = run->latencies[i];
+            lo = l < lo ? l : lo;
+            hi = l > hi ? l : hi;
+            var += (l - m) * (l - m);
+        }
+        RESULT(config.string(), "latency_mean", m, "ms");
+        RESULT(config.string(), "latency_min", lo, "ms");
+        RESULT(config.string(), "latency_max", hi, "ms");
+        RESULT(config.string(), "latency_jitter", sqrt(var / run->latencies.size()), "ms");
+        RESULT(config.string(), "chirps_detected",
+               100.0 * run->latencies.size() / run->played.size(), "%");
+        ret = 0;
+    }
+    RESULT(config.string(), "write_cpu",
+           run->writes ? run->writeCpu / 1000.0 / run->writes : 0, "us");
+    RESULT(config.string(), "read_cpu",
+           run->reads ? run->readCpu / 1000.0 / run->reads : 0, "us");
+    RESULT(config.string(), "write_errors", run->writeErrors, "calls");
+    RESULT(config.string(), "read_errors", run->readErrors, "calls");
+
+close_in:
+    for (size_t i = 0; i < effects.size(); i++) {
+        run->in->removeAudioEffect(effects[i]);
+        EffectRelease(effects[i]);
+    }
+    hw->closeInputStream(run->in);
+close_out:
+    hw->closeOutputStream(run->out);
+    delete run;
+    return ret;
+}
+
+int main(int argc, char** argv) {
+    const char *library = kDefaultHal;
+    const char *profiles = "primary,fast,deep";
+    const char *chain = NULL;
+    uint32_t inRate = 44100;
+    int seconds = 10;
+    int opt;
+    int ret = 0;
+
+    while ((opt = getopt(argc, argv, "t:o:e:r:l:")) != -1) {
+        switch (opt) {
+        case 't':
+            seconds = atoi(optarg);
+            break;
+        case 'o':
+            profiles = optarg;
+            break;
+        case 'e':
+            chain = optarg;
+            break;
+        case 'r':
+            inRate = atoi(optarg);
+            break;
+        case 'l':
+            library = optarg;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-t seconds] [-o primary,fast,deep] [-e aec,ns,agc] "
+                    "[-r capture rate] [-l hal library]\n", argv[0]);
+            return -EINVAL;
+        }
+    }
+
+    void *lib = dlopen(library, RTLD_NOW);
+    if (lib == NULL) {
+        LOGE("cannot load %s: %s", library, dlerror());
+        return -ENODEV;
+    }
+    create_hw_t create = (create_hw_t)dlsym(lib, "createAudioHardware");
+    if (create == NULL) {
+        LOGE("%s has no createAudioHardware()", library);
+        return -ENODEV;
+    }
+    AudioHardwareInterface *hw = create();
+    if (hw == NULL || hw->initCheck() != NO_ERROR) {
+        LOGE("%s: HAL init failed", library);
+        return -ENODEV;
+    }
+    hw->setMode(AudioSystem::MODE_NORMAL);
+
+    char list[64];
+    strncpy(list, profiles, sizeof(list) - 1);
+    list[sizeof(list) - 1] = '\0';
+    char *save;
+    for (char *profile = strtok_r(list, ",", &save); profile != NULL;
+            profile = strtok_r(NULL, ",", &save)) {
+        if (runLoopback(hw, profile, NULL, inRate, seconds) < 0)
+            ret = -1;
+        if (chain != NULL && runLoopback(hw, profile, chain, inRate, seconds) < 0)
+            ret = -1;
+    }
+
+    delete hw;
+    LOGI("Audio bench result: %d", ret);
+    return ret;
+}
@@ -32,6 +32,7 @@
 #include <string.h>
 #include <stdlib.h>
 #include <sys/poll.h>
+#include <sys/file.h>
 #include "SecCamera.h"
 #include "cutils/properties.h"
 
@@ -145,29 +146,37 @@ static int fimc_poll(struct pollfd *events)
     return ret;
 }
 
-int SecCamera::previewPoll(bool preview)
+/* one poll over the preview node and, while recording, the record node.
+ * returns the nodes with a frame as FRAME_NODE bits, 0 if nothing came
+ * within a second and < 0 on error.
+ */
+int SecCamera::previewPoll(void)
 {
+    struct pollfd events[2];
+    int count = 1;
     int ret;
 
-    if (preview) {
 #ifdef ENABLE_ESD_PREVIEW_CHECK
-        int status = 0;
-
-        if (!(++m_esd_check_count % 60)) {
-            status = getCameraSensorESDStatus();
-            m_esd_check_count = 0;
-            if (status) {
-               ALOGE("ERR(%s) ESD status(%d)", __func__, status);
-               return status;
-            }
+    int status = 0;
+
+    if (!(++m_esd_check_count % 60)) {
+        status = getCameraSensorESDStatus();
+        m_esd_check_count = 0;
+        if (status) {
+           ALOGE("ERR(%s) ESD status(%d)", __func__, status);
+           m_poll_timeout = true;
+           return 0;
         }
+    }
 #endif
 
-        ret = poll(&m_events_c, 1, 1000);
-    } else {
-        ret = poll(&m_events_c2, 1, 1000);
+    events[0] = m_events_c;
+    if (m_flag_record_start) {
+        events[1] = m_events_c2;
+        count = 2;
     }
 
+    ret = poll(events, count, 1000);
     if (ret < 0) {
         ALOGE("ERR(%s):poll error\n", __func__);
         return ret;
@@ -175,10 +184,38 @@ int SecCamera::previewPoll(bool preview)
 
     if (ret == 0) {
         ALOGE("ERR(%s):No data in 1 secs.. Camera Device Reset \n", __func__);
+        m_poll_timeout = true;
         return ret;
     }
 
-    return ret;
+    if (events[0].revents)
+        m_frames_ready |= FRAME_PREVIEW;
+    if (count > 1 && events[1].revents)
+        m_frames_ready |= FRAME_RECORD;
+
+    return m_frames_ready;
+}
+
+/* wait for a frame on one node, a frame the last previewPoll() saw counts.
+ * returns 1 when there is one and 0 on timeout.
+ */
+int SecCamera::waitFrame(int node)
+{
+    if (m_poll_timeout) {
+        m_poll_timeout = false;
+        return 0;
+    }
+
+    while (!(m_frames_ready & node)) {
+        int ret = previewPoll();
+        if (ret <= 0) {
+            m_poll_timeout = false;
+            return ret;
+        }
+    }
+
+    m_frames_ready &= ~node;
+    return 1;
 }
 
 static int fimc_v4l2_querycap(int fp)
@@ -232,12 +269,14 @@ static int fimc_v4l2_s_input(int fp, int index)
     return ret;
 }
 
-static int fimc_v4l2_s_fmt(int fp, int width, int height, unsigned int fmt, int flag_capture)
+static int fimc_v4l2_s_fmt(int fp, struct sec_v4l2_fmt_cache *cache,
+                           int width, int height, unsigned int fmt, int flag_capture)
 {
     struct v4l2_format v4l2_fmt;
     struct v4l2_pix_format pixfmt;
     int ret;
 
+    memset(&v4l2_fmt, 0, sizeof(v4l2_fmt));
     v4l2_fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
 
     memset(&pixfmt, 0, sizeof(pixfmt));
@@ -252,8 +291,8 @@ static int fimc_v4l2_s_fmt(int fp, int width, int height, unsigned int fmt, int
 
     v4l2_fmt.fmt.pix = pixfmt;
 
-    /* Set up for capture */
-    ret = ioctl(fp, VIDIOC_S_FMT, &v4l2_fmt);
+    /* Set up for capture, a node that has the format already is skipped */
+    ret = sec_v4l2_s_fmt(fp, cache, &v4l2_fmt);
     if (ret < 0) {
         ALOGE("ERR(%s):VIDIOC_S_FMT failed\n", __func__);
         return -1;
@@ -262,7 +301,8 @@ static int fimc_v4l2_s_fmt(int fp, int width, int height, unsigned int fmt, int
     return 0;
 }
 
-static int fimc_v4l2_s_fmt_cap(int fp, int width, int height, unsigned int fmt)
+static int fimc_v4l2_s_fmt_cap(int fp, struct sec_v4l2_fmt_cache *cache,
+                               int width, int height, unsigned int fmt)
 {
     struct v4l2_format v4l2_fmt;
     struct v4l2_pix_format pixfmt;
@@ -270,6 +310,7 @@ static int fimc_v4l2_s_fmt_cap(int fp, int width, int height, unsigned int fmt)
 
     memset(&pixfmt, 0, sizeof(pixfmt));
 
+    memset(&v4l2_fmt, 0, sizeof(v4l2_fmt));
     v4l2_fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
 
     pixfmt.width = width;
@@ -286,7 +327,7 @@ static int fimc_v4l2_s_fmt_cap(int fp, int width, int height, unsigned int fmt)
     //ALOGE("ori_w %d, ori_h %d, w %d, h %d\n", width, height, v4l2_fmt.fmt.pix.width, v4l2_fmt.fmt.pix.height);
 
     /* Set up for capture */
-    ret = ioctl(fp, VIDIOC_S_FMT, &v4l2_fmt);
+    ret = sec_v4l2_s_fmt(fp, cache, &v4l2_fmt);
     if (ret < 0) {
         ALOGE("ERR(%s):VIDIOC_S_FMT failed\n", __func__);
         return ret;
@@ -321,49 +362,45 @@ static int fimc_v4l2_enum_fmt(int fp, unsigned int fmt)
     return 0;
 }
 
-static int fimc_v4l2_reqbufs(int fp, enum v4l2_buf_type type, int nr_bufs)
+static int fimc_v4l2_reqbufs(int fp, enum v4l2_buf_type type, int nr_bufs,
+                             enum v4l2_memory memory = V4L2_MEMORY_MMAP)
 {
-    struct v4l2_requestbuffers req;
     int ret;
 
-    req.count = nr_bufs;
-    req.type = type;
-    req.memory = V4L2_MEMORY_MMAP;
-
-    ret = ioctl(fp, VIDIOC_REQBUFS, &req);
+    ret = sec_v4l2_reqbufs(fp, type, memory, nr_bufs);
     if (ret < 0) {
         ALOGE("ERR(%s):VIDIOC_REQBUFS failed\n", __func__);
         return -1;
     }
 
-    return req.count;
+    return ret;
 }
 
 static int fimc_v4l2_querybuf(int fp, struct fimc_buffer *buffer, enum v4l2_buf_type type)
 {
-    struct v4l2_buffer v4l2_buf;
+    struct sec_v4l2_map map;
     int ret;
 
     ALOGI("%s :", __func__);
 
-    v4l2_buf.type = type;
-    v4l2_buf.memory = V4L2_MEMORY_MMAP;
-    v4l2_buf.index = buffer->index;
+    /* fimc buffers live in reserved memory, a mapping from an earlier
+     * request of the same buffer is still good
+     */
+    map.start = buffer->start;
+    map.length = buffer->length;
+    map.offset = buffer->offset;
+
+    ret = sec_v4l2_map_buffer(fp, type, buffer->index, &map);
+
+    buffer->start = map.start;
+    buffer->length = map.length;
+    buffer->offset = map.offset;
 
-    ret = ioctl(fp , VIDIOC_QUERYBUF, &v4l2_buf);
     if (ret < 0) {
-        ALOGE("ERR(%s):VIDIOC_QUERYBUF failed\n", __func__);
+        ALOGE("ERR(%s):VIDIOC_QUERYBUF or mmap() failed : %s\n", __func__, strerror(-ret));
         return -1;
     }
 
-    if ((buffer->start = (char *)mmap(0, v4l2_buf.length,
-                                         PROT_READ | PROT_WRITE, MAP_SHARED,
-                                         fp, v4l2_buf.m.offset)) < 0) {
-         ALOGE("%s %d] mmap() failed\n",__func__, __LINE__);
-         return -1;
-    }
-    buffer->length = v4l2_buf.length;
-
     ALOGI("%s: buffer->start = %p buffer->length = %d buffer->index = %d",
          __func__, buffer->start, buffer->length, buffer->index);
 
@@ -372,10 +409,9 @@ static int fimc_v4l2_querybuf(int fp, struct fimc_buffer *buffer, enum v4l2_buf_
 
 static int fimc_v4l2_streamon(int fp)
 {
-    enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
     int ret;
 
-    ret = ioctl(fp, VIDIOC_STREAMON, &type);
+    ret = sec_v4l2_streamon(fp, V4L2_BUF_TYPE_VIDEO_CAPTURE);
     if (ret < 0) {
         ALOGE("ERR(%s):VIDIOC_STREAMON failed\n", __func__);
         return ret;
@@ -386,11 +422,10 @@ static int fimc_v4l2_streamon(int fp)
 
 static int fimc_v4l2_streamoff(int fp)
 {
-    enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
     int ret;
 
     ALOGV("%s :", __func__);
-    ret = ioctl(fp, VIDIOC_STREAMOFF, &type);
+    ret = sec_v4l2_streamoff(fp, V4L2_BUF_TYPE_VIDEO_CAPTURE);
     if (ret < 0) {
         ALOGE("ERR(%s):VIDIOC_STREAMOFF failed\n", __func__);
         return ret;
@@ -401,14 +436,26 @@ static int fimc_v4l2_streamoff(int fp)
 
 static int fimc_v4l2_qbuf(int fp, int index)
 {
-    struct v4l2_buffer v4l2_buf;
     int ret;
 
-    v4l2_buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    v4l2_buf.memory = V4L2_MEMORY_MMAP;
-    v4l2_buf.index = index;
+    ret = sec_v4l2_qbuf(fp, V4L2_BUF_TYPE_VIDEO_CAPTURE, V4L2_MEMORY_MMAP, index, 0);
+    if (ret < 0) {
+        ALOGE("ERR(%s):VIDIOC_QBUF failed\n", __func__);
+        return ret;
+    }
+
+    return 0;
+}
+
+/* fimc takes the physical plane addresses of a user buffer through
+ * m.userptr, the same way the overlay path in libhwcomposer does it
+ */
+static int fimc_v4l2_qbuf_userptr(int fp, int index, struct fimc_user_buffer *buffer)
+{
+    int ret;
 
-    ret = ioctl(fp, VIDIOC_QBUF, &v4l2_buf);
+    ret = sec_v4l2_qbuf(fp, V4L2_BUF_TYPE_VIDEO_CAPTURE, V4L2_MEMORY_USERPTR,
+                        index, (unsigned long)buffer);
     if (ret < 0) {
         ALOGE("ERR(%s):VIDIOC_QBUF failed\n", __func__);
         return ret;
@@ -417,21 +464,133 @@ static int fimc_v4l2_qbuf(int fp, int index)
     return 0;
 }
 
-static int fimc_v4l2_dqbuf(int fp)
+/* one memory to memory pass of the fimc post processor, src and dst
+ * are physical addresses of single plane images in the same format,
+ * programmed like fimc_flush() in libhwcomposer
+ */
+static int fimc_m2m_scale(int fp, unsigned int fmt,
+                          unsigned int src_addr, int src_width, int src_height,
+                          unsigned int dst_addr, int dst_width, int dst_height)
 {
+    struct v4l2_control vc;
+    struct v4l2_framebuffer fbuf;
+    struct v4l2_format v4l2_fmt;
+    struct v4l2_crop crop;
+    struct v4l2_requestbuffers req;
     struct v4l2_buffer v4l2_buf;
-    int ret;
+    struct fimc_user_buffer src_buf;
+    enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+    int ret = -1;
+
+    vc.id = V4L2_CID_ROTATION;
+    vc.value = 0;
+    if (ioctl(fp, VIDIOC_S_CTRL, &vc) < 0) {
+        ALOGE("ERR(%s):V4L2_CID_ROTATION failed\n", __func__);
+        return -1;
+    }
+
+    // destination, an overlay window covering the whole buffer
+    if (ioctl(fp, VIDIOC_G_FBUF, &fbuf) < 0) {
+        ALOGE("ERR(%s):VIDIOC_G_FBUF failed\n", __func__);
+        return -1;
+    }
+    fbuf.base = (void *)dst_addr;
+    fbuf.fmt.width = dst_width;
+    fbuf.fmt.height = dst_height;
+    fbuf.fmt.pixelformat = fmt;
+    if (ioctl(fp, VIDIOC_S_FBUF, &fbuf) < 0) {
+        ALOGE("ERR(%s):VIDIOC_S_FBUF failed\n", __func__);
+        return -1;
+    }
+
+    memset(&v4l2_fmt, 0, sizeof(v4l2_fmt));
+    v4l2_fmt.type = V4L2_BUF_TYPE_VIDEO_OVERLAY;
+    v4l2_fmt.fmt.win.w.width = dst_width;
+    v4l2_fmt.fmt.win.w.height = dst_height;
+    if (ioctl(fp, VIDIOC_S_FMT, &v4l2_fmt) < 0) {
+        ALOGE("ERR(%s):VIDIOC_S_FMT overlay failed\n", __func__);
+        return -1;
+    }
+
+    // source, handed over by physical address
+    memset(&v4l2_fmt, 0, sizeof(v4l2_fmt));
+    v4l2_fmt.type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+    v4l2_fmt.fmt.pix.width = src_width;
+    v4l2_fmt.fmt.pix.height = src_height;
+    v4l2_fmt.fmt.pix.pixelformat = fmt;
+    v4l2_fmt.fmt.pix.field = V4L2_FIELD_NONE;
+    if (ioctl(fp, VIDIOC_S_FMT, &v4l2_fmt) < 0) {
+        ALOGE("ERR(%s):VIDIOC_S_FMT output failed\n", __func__);
+        return -1;
+    }
+
+    crop.type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+    crop.c.left = 0;
+    crop.c.top = 0;
+    crop.c.width = src_width;
+    crop.c.height = src_height;
+    if (ioctl(fp, VIDIOC_S_CROP, &crop) < 0) {
+        ALOGE("ERR(%s):VIDIOC_S_CROP failed\n", __func__);
+        return -1;
+    }
+
+    req.count = 1;
+    req.type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+    req.memory = V4L2_MEMORY_USERPTR;
+    if (ioctl(fp, VIDIOC_REQBUFS, &req) < 0) {
+        ALOGE("ERR(%s):VIDIOC_REQBUFS failed\n", __func__);
+        return -1;
+    }
 
-    v4l2_buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    v4l2_buf.memory = V4L2_MEMORY_MMAP;
+    if (ioctl(fp, VIDIOC_STREAMON, &type) < 0) {
+        ALOGE("ERR(%s):VIDIOC_STREAMON failed\n", __func__);
+        goto clear;
+    }
 
-    ret = ioctl(fp, VIDIOC_DQBUF, &v4l2_buf);
+    memset(&src_buf, 0, sizeof(src_buf));
+    src_buf.base[0] = src_addr;
+    v4l2_buf.type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+    v4l2_buf.memory = V4L2_MEMORY_USERPTR;
+    v4l2_buf.m.userptr = (unsigned long)&src_buf;
+    v4l2_buf.length = 0;
+    v4l2_buf.index = 0;
+    if (ioctl(fp, VIDIOC_QBUF, &v4l2_buf) < 0) {
+        ALOGE("ERR(%s):VIDIOC_QBUF failed\n", __func__);
+    } else if (ioctl(fp, VIDIOC_DQBUF, &v4l2_buf) < 0) {
+        ALOGE("ERR(%s):VIDIOC_DQBUF failed\n", __func__);
+    } else {
+        ret = 0;
+    }
+
+    if (ioctl(fp, VIDIOC_STREAMOFF, &type) < 0) {
+        ALOGE("ERR(%s):VIDIOC_STREAMOFF failed\n", __func__);
+        ret = -1;
+    }
+
+clear:
+    req.count = 0;
+    ioctl(fp, VIDIOC_REQBUFS, &req);
+
+    return ret;
+}
+
+static int fimc_v4l2_dqbuf(int fp, enum v4l2_memory memory = V4L2_MEMORY_MMAP,
+                           nsecs_t *timestamp = NULL)
+{
+    int64_t frame_time;
+    int ret;
+
+    /* the buffer time comes on the clock of the frame timestamps */
+    ret = sec_v4l2_dqbuf(fp, V4L2_BUF_TYPE_VIDEO_CAPTURE, memory, &frame_time);
     if (ret < 0) {
         ALOGE("ERR(%s):VIDIOC_DQBUF failed, dropped frame\n", __func__);
         return ret;
     }
 
-    return v4l2_buf.index;
+    if (timestamp)
+        *timestamp = frame_time;
+
+    return ret;
 }
 
 static int fimc_v4l2_g_ctrl(int fp, unsigned int id)
@@ -451,6 +610,16 @@ static int fimc_v4l2_g_ctrl(int fp, unsigned int id)
     return ctrl.value;
 }
 
+static int fimc_v4l2_g_recognition(int fp, unsigned int index,
+                                   struct v4l2_recognition *recog)
+{
+    memset(recog, 0, sizeof(*recog));
+    recog->pattern = V4L2_RECOG_PATTERN_FACE;
+    recog->detect_idx = index;
+
+    return ioctl(fp, VIDIOC_G_RECOGNITION, recog);
+}
+
 static int fimc_v4l2_s_ctrl(int fp, unsigned int id, unsigned int value)
 {
     struct v4l2_control ctrl;
@@ -490,6 +659,46 @@ static int fimc_v4l2_s_ext_ctrl(int fp, unsigned int id, void *value)
     return ret;
 }
 
+#ifdef V4L2_EVENT_CTRL
+static int fimc_v4l2_subscribe_ctrl_event(int fp, unsigned int id)
+{
+    struct v4l2_event_subscription sub;
+
+    memset(&sub, 0, sizeof(sub));
+    sub.type = V4L2_EVENT_CTRL;
+    sub.id = id;
+
+    return ioctl(fp, VIDIOC_SUBSCRIBE_EVENT, &sub);
+}
+
+/* wait for control change events and drain them.  returns 1 when there
+ * was one, 0 on timeout and < 0 on error.
+ */
+static int fimc_v4l2_wait_ctrl_event(int fp, int timeout_ms)
+{
+    struct pollfd events;
+    struct v4l2_event ev;
+    int ret;
+
+    events.fd = fp;
+    events.events = POLLPRI;
+    events.revents = 0;
+
+    ret = poll(&events, 1, timeout_ms);
+    if (ret <= 0)
+        return ret;
+
+    do {
+        if (ioctl(fp, VIDIOC_DQEVENT, &ev) < 0) {
+            ALOGE("ERR(%s):VIDIOC_DQEVENT failed\n", __func__);
+            return -1;
+        }
+    } while (ev.pending > 0);
+
+    return 1;
+}
+#endif
+
 static int fimc_v4l2_g_parm(int fp, struct v4l2_streamparm *streamparm)
 {
     int ret;
@@ -524,12 +733,46 @@ static int fimc_v4l2_s_parm(int fp, struct v4l2_streamparm *streamparm)
     return 0;
 }
 
+static int fimc_v4l2_cropcap(int fp, struct v4l2_rect *bounds)
+{
+    struct v4l2_cropcap cropcap;
+
+    memset(&cropcap, 0, sizeof(cropcap));
+    cropcap.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+
+    if (ioctl(fp, VIDIOC_CROPCAP, &cropcap) < 0) {
+        ALOGE("ERR(%s):VIDIOC_CROPCAP failed\n", __func__);
+        return -1;
+    }
+
+    *bounds = cropcap.bounds;
+    return 0;
+}
+
+static int fimc_v4l2_s_crop(int fp, const struct v4l2_rect *rect)
+{
+    struct v4l2_crop crop;
+
+    crop.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    crop.c = *rect;
+
+    if (ioctl(fp, VIDIOC_S_CROP, &crop) < 0) {
+        ALOGE("ERR(%s):VIDIOC_S_CROP failed\n", __func__);
+        return -1;
+    }
+
+    return 0;
+}
+
 // ======================================================================
 // Constructor & Destructor
 
 SecCamera::SecCamera() :
             m_flag_init(0),
             m_camera_id(CAMERA_ID_BACK),
+            m_latency_probe(false),
+            m_preview_frame_id(0),
+            m_record_frame_id(0),
             m_preview_v4lformat(V4L2_PIX_FMT_NV21),
             m_preview_width      (0),
             m_preview_height     (0),
@@ -545,11 +788,15 @@ SecCamera::SecCamera() :
             m_wdr(-1),
             m_anti_shake(-1),
             m_zoom_level(-1),
+            m_zoom_ratio(ZOOM_RATIO_MIN),
             m_object_tracking(-1),
             m_smart_auto(-1),
             m_beauty_shot(-1),
             m_vintage_mode(-1),
             m_face_detect(-1),
+            m_object_tracking_start_stop(OT_STOP),
+            m_recognition_failed(false),
+            m_face_count(0),
             m_gps_latitude(-1),
             m_gps_longitude(-1),
             m_gps_altitude(-1),
@@ -563,13 +810,27 @@ SecCamera::SecCamera() :
             m_video_gamma(-1),
             m_slow_ae(-1),
             m_camera_af_flag(-1),
+            m_af_events(-1),
             m_flag_camera_start(0),
             m_jpeg_thumbnail_width (0),
             m_jpeg_thumbnail_height(0),
             m_jpeg_quality(100),
-            m_capture_bufs(NULL),
+            m_preview_user_bufs_count(0),
+            m_preview_zero_copy(false),
             m_capture_bufs_size(0),
-            m_capture_burst(false)
+            m_capture_burst(false),
+            m_capture_scale_index(-1),
+            m_scaler_fd(-1),
+            m_ctrl_batching(false),
+            m_ctrl_batch_count(0),
+            m_sensor_init_pending(false),
+            m_sensor_init_ret(0),
+            m_flag_record_prepared(0),
+            m_frames_ready(0),
+            m_poll_timeout(false),
+            m_record_prepared_width(0),
+            m_record_prepared_height(0),
+            m_record_inflight(0)
 #ifdef ENABLE_ESD_PREVIEW_CHECK
             ,
             m_esd_check_count(0)
@@ -591,6 +852,17 @@ SecCamera::SecCamera() :
     m_params->sharpness = -1;
     m_params->white_balance = -1;
 
+    memset(m_preview_user_bufs, 0, sizeof(m_preview_user_bufs));
+    for (int i = 0; i < MAX_BUFFERS; i++) {
+        m_preview_buf_state[i] = PREVIEW_BUF_IDLE;
+        m_preview_buf_refs[i] = 0;
+    }
+
+    memset(m_capture_bufs, 0, sizeof(m_capture_bufs));
+
+    m_poll_time.setName("poll");
+    m_dqbuf_time.setName("dqbuf");
+
     ALOGV("%s :", __func__);
 }
 
@@ -605,6 +877,9 @@ SecCamera::~SecCamera()
     ALOGV("%s :", __func__);
 }
 
+static bool s_input_probed[MAX_CAMERAS];
+static char s_sensor_name[MAX_CAMERAS][32];
+
 int SecCamera::initCamera(int index)
 {
     ALOGV("%s :", __func__);
@@ -616,10 +891,19 @@ int SecCamera::initCamera(int index)
          * reset between shot to shot
          */
         m_camera_af_flag = -1;
+        /* event subscriptions belong to the fd, see setAutofocus() */
+        m_af_events = -1;
+        m_recognition_failed = false;
+        m_face_count = 0;
 
         m_cam_fd_temp = -1;
         m_cam_fd2_temp = -1;
 
+        if (index < 0 || MAX_CAMERAS <= index) {
+            ALOGE("ERR(%s):Invalid camera index(%d)", __func__, index);
+            return -1;
+        }
+
         m_cam_fd = open(CAMERA_DEV_NAME, O_RDWR);
         if (m_cam_fd < 0) {
             ALOGE("ERR(%s):Cannot open %s (error : %s)\n", __func__, CAMERA_DEV_NAME, strerror(errno));
@@ -628,13 +912,6 @@ int SecCamera::initCamera(int index)
 
         ALOGV("initCamera: m_cam_fd(%d), m_jpeg_fd(%d)", m_cam_fd, m_jpeg_fd);
 
-        ret = fimc_v4l2_querycap(m_cam_fd);
-        CHECK(ret);
-        if (!fimc_v4l2_enuminput(m_cam_fd, index))
-            return -1;
-        ret = fimc_v4l2_s_input(m_cam_fd, index);
-        CHECK(ret);
-
         m_cam_fd2 = open(CAMERA_DEV_NAME2, O_RDWR);
         if (m_cam_fd2 < 0) {
             ALOGE("ERR(%s):Cannot open %s (error : %s)\n", __func__, CAMERA_DEV_NAME2, strerror(errno));
@@ -642,13 +919,35 @@ int SecCamera::initCamera(int index)
         }
 
         ALOGV("initCamera: m_cam_fd2(%d)", m_cam_fd2);
+        sec_v4l2_gen_open(&m_cam_gen2, m_cam_fd2);
 
-        ret = fimc_v4l2_querycap(m_cam_fd2);
-        CHECK(ret);
-        if (!fimc_v4l2_enuminput(m_cam_fd2, index))
-            return -1;
-        ret = fimc_v4l2_s_input(m_cam_fd2, index);
-        CHECK(ret);
+        sec_v4l2_fmt_reset(&m_cam_fmt);
+        sec_v4l2_fmt_reset(&m_cam_fmt2);
+
+        m_latency_probe = sec_latency_enabled();
+        m_preview_frame_id = 0;
+        m_record_frame_id = 0;
+
+        /* the nodes and their inputs don't change while we run, so they
+         * are only probed on the first open of each camera
+         */
+        if (!s_input_probed[index]) {
+            const __u8 *name;
+
+            ret = fimc_v4l2_querycap(m_cam_fd);
+            CHECK(ret);
+            name = fimc_v4l2_enuminput(m_cam_fd, index);
+            if (!name)
+                return -1;
+            strncpy(s_sensor_name[index], (const char *)name, sizeof(s_sensor_name[index]) - 1);
+
+            ret = fimc_v4l2_querycap(m_cam_fd2);
+            CHECK(ret);
+            if (!fimc_v4l2_enuminput(m_cam_fd2, index))
+                return -1;
+
+            s_input_probed[index] = true;
+        }
 
         m_camera_id = index;
 
@@ -670,11 +969,56 @@ int SecCamera::initCamera(int index)
 
         setExifFixedAttribute();
 
+        /* selecting the input powers the sensor up, which takes a while.
+         * it runs while the HAL sets up the preview window and is waited
+         * for before the first use of the sensor.
+         */
+        m_sensor_init_ret = 0;
+        m_sensor_init_pending = pthread_create(&m_sensor_init_thread, NULL,
+                                               sensorInitThread, this) == 0;
+        if (!m_sensor_init_pending) {
+            ALOGW("WARN(%s):selecting the input synchronously", __func__);
+            sensorInitThread(this);
+            ret = m_sensor_init_ret;
+            CHECK(ret);
+        }
+
         m_flag_init = 1;
     }
     return 0;
 }
 
+void *SecCamera::sensorInitThread(void *arg)
+{
+    SecCamera *cam = (SecCamera *)arg;
+    nsecs_t start = systemTime();
+
+    int ret = fimc_v4l2_s_input(cam->m_cam_fd, cam->m_camera_id);
+    if (ret == 0)
+        ret = fimc_v4l2_s_input(cam->m_cam_fd2, cam->m_camera_id);
+
+    ALOGV("%s: sensor %d up in %lld ms", __func__, cam->m_camera_id,
+            ns2ms(systemTime() - start));
+    cam->m_sensor_init_ret = ret;
+    return NULL;
+}
+
+int SecCamera::waitSensorInit(void)
+{
+    Mutex::Autolock lock(m_sensor_init_lock);
+
+    if (m_sensor_init_pending) {
+        pthread_join(m_sensor_init_thread, NULL);
+        m_sensor_init_pending = false;
+    }
+
+    if (m_sensor_init_ret < 0) {
+        ALOGE("ERR(%s):Fail on selecting the sensor input", __func__);
+        return -1;
+    }
+    return 0;
+}
+
 void SecCamera::resetCamera()
 {
     ALOGV("%s :", __func__);
@@ -688,7 +1032,16 @@ void SecCamera::deinitCamera()
 
     if (m_flag_init) {
 
+        waitSensorInit();
         stopRecord();
+        releaseCapturePool();
+        releaseRecordBufs();
+
+        if (m_scaler_fd > -1) {
+            sec_v4l2_gen_close(&m_scaler_gen);
+            close(m_scaler_fd);
+            m_scaler_fd = -1;
+        }
 
         /* close m_cam_fd after stopRecord() because stopRecord()
          * uses m_cam_fd to change frame rate
@@ -701,6 +1054,7 @@ void SecCamera::deinitCamera()
 
         ALOGV("deinitCamera: m_cam_fd2(%d)", m_cam_fd2);
         if (m_cam_fd2 > -1) {
+            sec_v4l2_gen_close(&m_cam_gen2);
             close(m_cam_fd2);
             m_cam_fd2 = -1;
         }
@@ -794,6 +1148,8 @@ int SecCamera::startPreview(void)
     }
 
     CHECK_FD(m_cam_fd);
+    if (waitSensorInit() < 0)
+        return -1;
 
     memset(&m_events_c, 0, sizeof(m_events_c));
     m_events_c.fd = m_cam_fd;
@@ -804,16 +1160,42 @@ int SecCamera::startPreview(void)
     CHECK(ret);
 
     if (m_camera_id == CAMERA_ID_BACK)
-        ret = fimc_v4l2_s_fmt(m_cam_fd, m_preview_width, m_preview_height, m_preview_v4lformat, 0);
+        ret = fimc_v4l2_s_fmt(m_cam_fd, &m_cam_fmt, m_preview_width, m_preview_height, m_preview_v4lformat, 0);
     else
-        ret = fimc_v4l2_s_fmt(m_cam_fd, m_preview_height, m_preview_width, m_preview_v4lformat, 0);
+        ret = fimc_v4l2_s_fmt(m_cam_fd, &m_cam_fmt, m_preview_height, m_preview_width, m_preview_v4lformat, 0);
     CHECK(ret);
 
-    ret = fimc_v4l2_reqbufs(m_cam_fd, V4L2_BUF_TYPE_VIDEO_CAPTURE, MAX_BUFFERS);
-    CHECK(ret);
+    /* without a crop all zoom is left to the sensor */
+    if (fimc_v4l2_cropcap(m_cam_fd, &m_crop_bounds) < 0) {
+        ALOGW("%s: fimc can't crop, zoom by the sensor only", __func__);
+        m_crop_bounds.width = 0;
+        m_zoom_ratio = zoomLevelRatio(m_zoom_level);
+    } else {
+        applyZoomCrop(m_cam_fd);
+    }
+
+    /* try to let fimc write straight into the buffers registered by
+     * setPreviewUserBuffer(), otherwise fall back to our own mmap buffers
+     */
+    m_preview_zero_copy = false;
+    if (m_preview_user_bufs_count > 0) {
+        ret = fimc_v4l2_reqbufs(m_cam_fd, V4L2_BUF_TYPE_VIDEO_CAPTURE,
+                                m_preview_user_bufs_count, V4L2_MEMORY_USERPTR);
+        if (ret == m_preview_user_bufs_count) {
+            m_preview_zero_copy = true;
+        } else {
+            ALOGW("%s: fimc can't capture into user buffers, using mmap", __func__);
+            fimc_v4l2_reqbufs(m_cam_fd, V4L2_BUF_TYPE_VIDEO_CAPTURE, 0, V4L2_MEMORY_USERPTR);
+        }
+    }
+
+    if (!m_preview_zero_copy) {
+        ret = fimc_v4l2_reqbufs(m_cam_fd, V4L2_BUF_TYPE_VIDEO_CAPTURE, MAX_BUFFERS);
+        CHECK(ret);
+    }
 
-    ALOGV("%s : m_preview_width: %d m_preview_height: %d m_angle: %d\n",
-            __func__, m_preview_width, m_preview_height, m_angle);
+    ALOGV("%s : m_preview_width: %d m_preview_height: %d m_angle: %d zero_copy: %d\n",
+            __func__, m_preview_width, m_preview_height, m_angle, m_preview_zero_copy);
 
     ret = fimc_v4l2_s_ctrl(m_cam_fd,
                            V4L2_CID_CAMERA_CHECK_DATALINE, m_chk_dataline);
@@ -824,15 +1206,28 @@ int SecCamera::startPreview(void)
         CHECK(ret);
     }
 
-    /* start with all buffers in queue */
-    for (int i = 0; i < MAX_BUFFERS; i++) {
-        ret = fimc_v4l2_qbuf(m_cam_fd, i);
+    /* start with all buffers in queue, except user buffers that are
+     * still on the display
+     */
+    if (!m_preview_zero_copy) {
+        for (int i = 0; i < MAX_BUFFERS; i++)
+            m_preview_buf_state[i] = PREVIEW_BUF_IDLE;
+    }
+
+    for (int i = 0; i < (m_preview_zero_copy ? m_preview_user_bufs_count : MAX_BUFFERS); i++) {
+        if (m_preview_buf_state[i] != PREVIEW_BUF_IDLE)
+            continue;
+        ret = queuePreviewBuf(i);
         CHECK(ret);
     }
 
+    m_preview_ts_filter.reset();
+
     ret = startStream();
     CHECK(ret);
 
+    m_frames_ready &= ~FRAME_PREVIEW;
+    m_poll_timeout = false;
     m_flag_camera_start = 1;
 
     // It is a delay for a new frame, not to show the previous bigger ugly picture frame.
@@ -857,28 +1252,218 @@ int SecCamera::stopPreview(void)
 
     CHECK_FD(m_cam_fd);
 
+    /* a record node prepared for a recording that never started must not
+     * outlive preview, the sensor may be set up for a snapshot next
+     */
+    if (m_flag_record_prepared > 0 && m_flag_record_start == 0)
+        stopRecord();
+
     int ret = stopStream();
     CHECK(ret);
 
+    /* streamoff took back everything the driver had */
+    for (int i = 0; i < MAX_BUFFERS; i++) {
+        if (m_preview_buf_state[i] != PREVIEW_BUF_CLIENT)
+            m_preview_buf_state[i] = PREVIEW_BUF_IDLE;
+        m_preview_buf_refs[i] = 0;
+    }
+
+    /* user buffers go back to their owner, drop our references */
+    if (m_preview_zero_copy) {
+        fimc_v4l2_reqbufs(m_cam_fd, V4L2_BUF_TYPE_VIDEO_CAPTURE, 0, V4L2_MEMORY_USERPTR);
+        m_preview_zero_copy = false;
+    }
+
     m_flag_camera_start = 0;
 
     return ret;
 }
 
+int SecCamera::setPreviewUserBufferCount(int count)
+{
+    ALOGV("%s(count(%d))", __func__, count);
+
+    if (count < 0 || MAX_BUFFERS < count) {
+        ALOGE("ERR(%s):Invalid count(%d)", __func__, count);
+        return -1;
+    }
+
+    if (m_flag_camera_start) {
+        ALOGE("ERR(%s):Preview is running", __func__);
+        return -1;
+    }
+
+    m_preview_user_bufs_count = count;
+    memset(m_preview_user_bufs, 0, sizeof(m_preview_user_bufs));
+    for (int i = 0; i < MAX_BUFFERS; i++) {
+        m_preview_buf_state[i] = PREVIEW_BUF_IDLE;
+        m_preview_buf_refs[i] = 0;
+    }
+
+    return 0;
+}
+
+int SecCamera::setPreviewUserBuffer(int index, unsigned int addr_y,
+                                    unsigned int addr_cb, unsigned int addr_cr)
+{
+    if (!(0 <= index && index < m_preview_user_bufs_count)) {
+        ALOGE("ERR(%s):wrong index = %d", __func__, index);
+        return -1;
+    }
+
+    if (m_preview_buf_state[index] == PREVIEW_BUF_DRIVER ||
+        m_preview_buf_state[index] == PREVIEW_BUF_HAL) {
+        ALOGE("ERR(%s):buffer %d is in use", __func__, index);
+        return -1;
+    }
+
+    int y_size = m_preview_width * m_preview_height;
+
+    m_preview_user_bufs[index].base[0] = addr_y;
+    m_preview_user_bufs[index].base[1] = addr_cb;
+    m_preview_user_bufs[index].base[2] = addr_cr;
+    m_preview_user_bufs[index].length[0] = y_size;
+    m_preview_user_bufs[index].length[1] = y_size / 4;
+    m_preview_user_bufs[index].length[2] = y_size / 4;
+    m_preview_buf_state[index] = PREVIEW_BUF_IDLE;
+
+    return 0;
+}
+
+bool SecCamera::isPreviewZeroCopy(void) const
+{
+    return m_preview_zero_copy;
+}
+
+int SecCamera::queuePreviewBuf(int index)
+{
+    int ret;
+
+    if (m_preview_zero_copy)
+        ret = fimc_v4l2_qbuf_userptr(m_cam_fd, index, &m_preview_user_bufs[index]);
+    else
+        ret = fimc_v4l2_qbuf(m_cam_fd, index);
+
+    if (ret == 0)
+        m_preview_buf_state[index] = PREVIEW_BUF_DRIVER;
+
+    return ret;
+}
+
+int SecCamera::retainPreviewFrame(int index)
+{
+    if (!(0 <= index && index < MAX_BUFFERS) ||
+        m_preview_buf_state[index] != PREVIEW_BUF_HAL) {
+        ALOGE("ERR(%s):buffer %d isn't held", __func__, index);
+        return -1;
+    }
+
+    m_preview_buf_refs[index]++;
+
+    return 0;
+}
+
+int SecCamera::releasePreviewFrame(int index)
+{
+    if (!(0 <= index && index < MAX_BUFFERS)) {
+        ALOGE("ERR(%s):wrong index = %d", __func__, index);
+        return -1;
+    }
+
+    switch (m_preview_buf_state[index]) {
+    case PREVIEW_BUF_HAL:
+        if (--m_preview_buf_refs[index] > 0)
+            return 0;
+        break;
+    case PREVIEW_BUF_DRIVER:
+        ALOGW("%s: buffer %d is already queued", __func__, index);
+        return 0;
+    case PREVIEW_BUF_CLIENT:
+        ALOGE("ERR(%s):buffer %d has no user buffer attached", __func__, index);
+        return -1;
+    default:
+        break;
+    }
+
+    m_preview_buf_state[index] = PREVIEW_BUF_IDLE;
+    m_preview_buf_refs[index] = 0;
+
+    /* queued by startPreview() */
+    if (m_flag_camera_start == 0)
+        return 0;
+
+    CHECK_FD(m_cam_fd);
+
+    return queuePreviewBuf(index);
+}
+
+/* the buffer left with the window, it comes back through
+ * setPreviewUserBuffer()
+ */
+int SecCamera::detachPreviewFrame(int index)
+{
+    if (!m_preview_zero_copy || !(0 <= index && index < m_preview_user_bufs_count) ||
+        m_preview_buf_state[index] != PREVIEW_BUF_HAL) {
+        ALOGE("ERR(%s):buffer %d isn't held", __func__, index);
+        return -1;
+    }
+
+    m_preview_buf_state[index] = PREVIEW_BUF_CLIENT;
+    m_preview_buf_refs[index] = 0;
+
+    return 0;
+}
+
 //Recording
-int SecCamera::startRecord(void)
+/* fimc2 records and is the post processor of the tvout and the codecs'
+ * color conversion as well. they lock it around each job and cache their
+ * setup against its generation, the record node is changed the same way.
+ */
+class RecordNodeLock {
+public:
+    RecordNodeLock(int fd, struct sec_v4l2_gen *gen) : m_fd(fd)
+    {
+        flock(m_fd, LOCK_EX);
+        m_changed = sec_v4l2_gen_changed(gen);
+        sec_v4l2_gen_bump(gen);
+    }
+    ~RecordNodeLock() { flock(m_fd, LOCK_UN); }
+
+    /* someone else had the node since the camera last changed it */
+    bool changed() const { return m_changed; }
+
+private:
+    int  m_fd;
+    bool m_changed;
+};
+
+/* bring the record node up and keep it streaming, so that startRecord()
+ * later only has to drop the frames that piled up meanwhile.  a node
+ * prepared for another recording size is set up again.
+ */
+int SecCamera::prepareRecord(void)
 {
     int ret, i;
 
     ALOGV("%s :", __func__);
 
-    // aleady started
-    if (m_flag_record_start > 0) {
-        ALOGE("ERR(%s):Preview was already started\n", __func__);
+    if (m_flag_record_start > 0)
         return 0;
+
+    if (m_flag_record_prepared > 0) {
+        if (m_record_prepared_width == m_recording_width &&
+            m_record_prepared_height == m_recording_height)
+            return 0;
+        stopRecord();
     }
 
     CHECK_FD(m_cam_fd2);
+    if (waitSensorInit() < 0)
+        return -1;
+
+    RecordNodeLock node(m_cam_fd2, &m_cam_gen2);
+    if (node.changed())
+        sec_v4l2_fmt_reset(&m_cam_fmt2);
 
     /* enum_fmt, s_fmt sample */
     ret = fimc_v4l2_enum_fmt(m_cam_fd2, V4L2_PIX_FMT_NV12T);
@@ -888,17 +1473,20 @@ int SecCamera::startRecord(void)
          __func__, m_recording_width, m_recording_height);
 
     if(m_camera_id == CAMERA_ID_BACK)
-        ret = fimc_v4l2_s_fmt(m_cam_fd2, m_recording_width,
+        ret = fimc_v4l2_s_fmt(m_cam_fd2, &m_cam_fmt2, m_recording_width,
                               m_recording_height, V4L2_PIX_FMT_NV12T, 0);
     else
-        ret = fimc_v4l2_s_fmt(m_cam_fd2, m_recording_height,
+        ret = fimc_v4l2_s_fmt(m_cam_fd2, &m_cam_fmt2, m_recording_height,
                               m_recording_width, V4L2_PIX_FMT_NV12T, 0);
     CHECK(ret);
 
-    ret = fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_FRAME_RATE,
-                            m_params->capture.timeperframe.denominator);
-    CHECK(ret);
+    /* record the same view preview shows */
+    applyZoomCrop(m_cam_fd2);
 
+    /* a picture taken while recording earlier left its mappings, the
+     * driver refuses REQBUFS while they are held
+     */
+    releaseRecordBufs();
     ret = fimc_v4l2_reqbufs(m_cam_fd2, V4L2_BUF_TYPE_VIDEO_CAPTURE, MAX_BUFFERS);
     CHECK(ret);
 
@@ -911,13 +1499,52 @@ int SecCamera::startRecord(void)
     ret = fimc_v4l2_streamon(m_cam_fd2);
     CHECK(ret);
 
-    // Get and throw away the first frame since it is often garbled.
     memset(&m_events_c2, 0, sizeof(m_events_c2));
     m_events_c2.fd = m_cam_fd2;
     m_events_c2.events = POLLIN | POLLERR;
+
+    m_record_prepared_width = m_recording_width;
+    m_record_prepared_height = m_recording_height;
+    m_flag_record_prepared = 1;
+
+    return 0;
+}
+
+int SecCamera::startRecord(void)
+{
+    int ret, i;
+
+    ALOGV("%s :", __func__);
+
+    // aleady started
+    if (m_flag_record_start > 0) {
+        ALOGE("ERR(%s):Preview was already started\n", __func__);
+        return 0;
+    }
+
+    ret = prepareRecord();
+    CHECK(ret);
+
+    ret = fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_FRAME_RATE,
+                            m_params->capture.timeperframe.denominator);
+    CHECK(ret);
+
+    /* whatever the node captured before now is stale, and the first
+     * frame after streamon is often garbled, so throw it all away
+     */
     ret = fimc_poll(&m_events_c2);
     CHECK(ret);
+    for (i = 0; i < MAX_BUFFERS && poll(&m_events_c2, 1, 0) > 0; i++) {
+        int index = fimc_v4l2_dqbuf(m_cam_fd2, V4L2_MEMORY_MMAP, NULL);
+        if (index < 0)
+            break;
+        ret = fimc_v4l2_qbuf(m_cam_fd2, index);
+        CHECK(ret);
+    }
+
+    m_record_ts_filter.reset();
 
+    m_frames_ready &= ~FRAME_RECORD;
     m_flag_record_start = 1;
 
     return 0;
@@ -929,25 +1556,43 @@ int SecCamera::stopRecord(void)
 
     ALOGV("%s :", __func__);
 
-    if (m_flag_record_start == 0) {
+    if (m_flag_record_start == 0 && m_flag_record_prepared == 0) {
         ALOGW("%s: doing nothing because m_flag_record_start is zero", __func__);
         return 0;
     }
 
     CHECK_FD(m_cam_fd2);
 
+    int was_recording = m_flag_record_start;
     m_flag_record_start = 0;
+    m_flag_record_prepared = 0;
 
-    ret = fimc_v4l2_streamoff(m_cam_fd2);
-    CHECK(ret);
+    {
+        /* streamoff takes every buffer back from whoever has it */
+        Mutex::Autolock lock(m_record_lock);
+        m_record_inflight = 0;
+    }
 
-    ret = fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_FRAME_RATE,
-                            FRAME_RATE_AUTO);
+    {
+        RecordNodeLock node(m_cam_fd2, &m_cam_gen2);
+        ret = fimc_v4l2_streamoff(m_cam_fd2);
+    }
     CHECK(ret);
 
+    if (was_recording) {
+        ret = fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_FRAME_RATE,
+                                FRAME_RATE_AUTO);
+        CHECK(ret);
+    }
+
     return 0;
 }
 
+bool SecCamera::isRecordPrepared(void) const
+{
+    return m_flag_record_prepared > 0;
+}
+
 unsigned int SecCamera::getRecPhyAddrY(int index)
 {
     unsigned int addr_y;
@@ -970,92 +1615,296 @@ unsigned int SecCamera::getRecPhyAddrC(int index)
     return addr_c;
 }
 
+/* cpu view of a dequeued NV12T record frame, for snapshots while
+ * recording.  width and height are those of the node, which are swapped
+ * against the recording size on the front camera.
+ */
+int SecCamera::getRecordFrameAddr(int index, unsigned char **y,
+                                  unsigned char **cbcr,
+                                  int *width, int *height)
+{
+    CHECK_FD(m_cam_fd2);
+
+    if (index < 0 || MAX_BUFFERS <= index || !m_flag_record_start) {
+        ALOGE("ERR(%s):no record frame %d", __func__, index);
+        return -1;
+    }
+
+    fimc_buffer *buf = &m_record_bufs[index];
+    buf->index = index;
+    if (fimc_v4l2_querybuf(m_cam_fd2, buf, V4L2_BUF_TYPE_VIDEO_CAPTURE) < 0)
+        return -1;
+
+    unsigned int addr_y = getRecPhyAddrY(index);
+    unsigned int addr_c = getRecPhyAddrC(index);
+    if (addr_y == 0xffffffff || addr_c == 0xffffffff || addr_c < addr_y ||
+        addr_c - addr_y >= (unsigned int)buf->length) {
+        ALOGE("ERR(%s):bad record frame %d addresses", __func__, index);
+        return -1;
+    }
+
+    *y = (unsigned char *)buf->start;
+    *cbcr = (unsigned char *)buf->start + (addr_c - addr_y);
+    if (m_camera_id == CAMERA_ID_BACK) {
+        *width = m_record_prepared_width;
+        *height = m_record_prepared_height;
+    } else {
+        *width = m_record_prepared_height;
+        *height = m_record_prepared_width;
+    }
+
+    return 0;
+}
+
 unsigned int SecCamera::getPhyAddrY(int index)
 {
     unsigned int addr_y;
 
     CHECK_FD(m_cam_fd);
 
-    addr_y = fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_PADDR_Y, index);
-    CHECK((int)addr_y);
-    return addr_y;
-}
+    if (m_preview_zero_copy && 0 <= index && index < m_preview_user_bufs_count)
+        return m_preview_user_bufs[index].base[0];
+
+    addr_y = fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_PADDR_Y, index);
+    CHECK((int)addr_y);
+    return addr_y;
+}
+
+unsigned int SecCamera::getPhyAddrC(int index)
+{
+    unsigned int addr_c;
+
+    CHECK_FD(m_cam_fd);
+
+    if (m_preview_zero_copy && 0 <= index && index < m_preview_user_bufs_count)
+        return m_preview_user_bufs[index].base[1];
+
+    addr_c = fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_PADDR_CBCR, index);
+    CHECK((int)addr_c);
+    return addr_c;
+}
+
+int SecCamera::pausePreview()
+{
+    return fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_STREAM_PAUSE, 0);
+}
+
+int SecCamera::resumePreview()
+{
+    return fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_STREAM_PAUSE, 1);
+}
+
+int SecCamera::getPreview(nsecs_t *timestamp)
+{
+    nsecs_t frame_time;
+    int index;
+    int ret;
+
+    CHECK_FD(m_cam_fd);
+
+    nsecs_t start = systemTime();
+    ret = m_flag_camera_start ? waitFrame(FRAME_PREVIEW) : 0;
+    m_poll_time.add(systemTime() - start);
+
+    if (m_flag_camera_start == 0) {
+        ALOGE("ERR(%s):preview isn't running", __func__);
+        return -1;
+    }
+    if (ret == 0)
+        return PREVIEW_TIMEOUT;
+    if (ret < 0)
+        return -1;
+
+    start = systemTime();
+
+    /* the frame belongs to the caller until releasePreviewFrame() */
+    index = fimc_v4l2_dqbuf(m_cam_fd,
+                            m_preview_zero_copy ? V4L2_MEMORY_USERPTR : V4L2_MEMORY_MMAP,
+                            &frame_time);
+    m_dqbuf_time.add(systemTime() - start);
+    if (!(0 <= index && index < (m_preview_zero_copy ? m_preview_user_bufs_count : MAX_BUFFERS))) {
+        ALOGE("ERR(%s):wrong index = %d", __func__, index);
+        return -1;
+    }
+
+    m_preview_buf_state[index] = PREVIEW_BUF_HAL;
+    m_preview_buf_refs[index] = 1;
+
+    /* the capture time as the driver gave it, before the filter */
+    if (m_latency_probe)
+        sec_latency_stamp_set(&m_preview_stamp[index], m_preview_frame_id++, frame_time);
+
+    if (timestamp)
+        *timestamp = m_preview_ts_filter.filter(frame_time);
+
+    readFrameMetadata();
+
+    return index;
+}
+
+/* the sensor's face and tracking results for the frame just dequeued, so
+ * the HAL never has to ask for them control by control
+ */
+void SecCamera::readFrameMetadata(void)
+{
+    struct v4l2_recognition recog;
+
+    m_face_count = 0;
+    if (m_face_detect > FACE_DETECTION_OFF && !m_recognition_failed) {
+        if (fimc_v4l2_g_recognition(m_cam_fd, 0, &recog) < 0) {
+            /* not every sensor driver knows it, don't ask every frame */
+            ALOGW("%s: VIDIOC_G_RECOGNITION failed, no face metadata", __func__);
+            m_recognition_failed = true;
+        } else {
+            int count = MIN(recog.data.detect_cnt, MAX_DETECTED_FACES);
+            for (int i = 0; i < count; i++) {
+                if (i > 0 && fimc_v4l2_g_recognition(m_cam_fd, i, &recog) < 0)
+                    break;
+                m_faces[i] = recog.data.o;
+                m_face_count++;
+            }
+        }
+    }
+
+    if (m_object_tracking_start_stop == OT_START)
+        m_obj_tracking_status = fimc_v4l2_g_ctrl(m_cam_fd, V4L2_CID_CAMERA_OBJ_TRACKING_STATUS);
+    else
+        m_obj_tracking_status = OBJECT_TRACKING_STATUS_BASE;
+}
+
+/* faces in preview pixels, valid until the next getPreview() */
+int SecCamera::getFrameFaces(struct v4l2_rect *faces, int max_faces) const
+{
+    int count = MIN(m_face_count, max_faces);
+
+    for (int i = 0; i < count; i++)
+        faces[i] = m_faces[i];
+    return count;
+}
+
+int SecCamera::getFrameTrackingStatus(void) const
+{
+    return m_obj_tracking_status;
+}
+
+/* GAUDI Project([arun.c@samsung.com]) 2010.05.20. [Implemented ESD code]
+ * When there is no data for more than 1 second from the camera we inform
+ * the FIMC driver by calling fimc_v4l2_s_input() with a special value = 1000
+ * FIMC driver identify that there is something wrong with the camera
+ * and it restarts the sensor.
+ *
+ * The stream is restarted with the buffers it had, frames held by the
+ * caller stay valid and go back through releasePreviewFrame().
+ */
+int SecCamera::recoverSensor(void)
+{
+    int ret;
+
+    ALOGW("%s: restarting sensor %d", __func__, m_camera_id);
+
+    CHECK_FD(m_cam_fd);
+    if (m_flag_camera_start == 0)
+        return 0;
+
+    if (stopStream() < 0)
+        ALOGW("WARN(%s):streamoff failed on the hung sensor", __func__);
+
+    for (int i = 0; i < MAX_BUFFERS; i++) {
+        if (m_preview_buf_state[i] == PREVIEW_BUF_DRIVER)
+            m_preview_buf_state[i] = PREVIEW_BUF_IDLE;
+    }
+
+    ret = fimc_v4l2_s_input(m_cam_fd, 1000);
+    CHECK(ret);
+
+    for (int i = 0; i < (m_preview_zero_copy ? m_preview_user_bufs_count : MAX_BUFFERS); i++) {
+        if (m_preview_buf_state[i] != PREVIEW_BUF_IDLE)
+            continue;
+        ret = queuePreviewBuf(i);
+        CHECK(ret);
+    }
+
+    m_preview_ts_filter.reset();
 
-unsigned int SecCamera::getPhyAddrC(int index)
-{
-    unsigned int addr_c;
+    ret = startStream();
+    CHECK(ret);
 
-    CHECK_FD(m_cam_fd);
+    m_frames_ready &= ~FRAME_PREVIEW;
+    m_poll_timeout = false;
 
-    addr_c = fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_PADDR_CBCR, index);
-    CHECK((int)addr_c);
-    return addr_c;
+    return 0;
 }
 
-int SecCamera::pausePreview()
+void SecCamera::resetPreviewStats(void)
 {
-    return fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_STREAM_PAUSE, 0);
+    m_poll_time.reset();
+    m_dqbuf_time.reset();
 }
 
-int SecCamera::resumePreview()
+void SecCamera::dumpPreviewStats(String8& result) const
 {
-    return fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_STREAM_PAUSE, 1);
+    int count[PREVIEW_BUF_CLIENT + 1] = { 0 };
+
+    for (int i = 0; i < MAX_BUFFERS; i++)
+        count[m_preview_buf_state[i]]++;
+
+    result.appendFormat("  buffers idle(%d) driver(%d) hal(%d) client(%d)\n",
+                        count[PREVIEW_BUF_IDLE], count[PREVIEW_BUF_DRIVER],
+                        count[PREVIEW_BUF_HAL], count[PREVIEW_BUF_CLIENT]);
+    m_poll_time.dump(result);
+    m_dqbuf_time.dump(result);
 }
 
-int SecCamera::getPreview()
+int SecCamera::getRecordFrame(nsecs_t *timestamp)
 {
+    nsecs_t frame_time;
     int index;
-    int ret;
-
-    CHECK_FD(m_cam_fd);
 
-    if (m_flag_camera_start == 0 || previewPoll(true) == 0) {
-        ALOGE("ERR(%s):Start Camera Device Reset \n", __func__);
-        /* GAUDI Project([arun.c@samsung.com]) 2010.05.20. [Implemented ESD code] */
-        /*
-         * When there is no data for more than 1 second from the camera we inform
-         * the FIMC driver by calling fimc_v4l2_s_input() with a special value = 1000
-         * FIMC driver identify that there is something wrong with the camera
-         * and it restarts the sensor.
-         */
-        stopPreview();
-        /* Reset Only Camera Device */
-        ret = fimc_v4l2_querycap(m_cam_fd);
-        CHECK(ret);
-        if (fimc_v4l2_enuminput(m_cam_fd, m_camera_id))
-            return -1;
-        ret = fimc_v4l2_s_input(m_cam_fd, 1000);
-        CHECK(ret);
-        ret = startPreview();
-        if (ret < 0) {
-            ALOGE("ERR(%s): startPreview() return %d\n", __func__, ret);
-            return 0;
-        }
+    if (m_flag_record_start == 0) {
+        ALOGE("%s: m_flag_record_start is 0", __func__);
+        return -1;
     }
 
-    index = fimc_v4l2_dqbuf(m_cam_fd);
+    CHECK_FD(m_cam_fd2);
+
+    if (waitFrame(FRAME_RECORD) <= 0) {
+        ALOGE("ERR(%s):no record frame", __func__);
+        return -1;
+    }
+    index = fimc_v4l2_dqbuf(m_cam_fd2, V4L2_MEMORY_MMAP, &frame_time);
     if (!(0 <= index && index < MAX_BUFFERS)) {
         ALOGE("ERR(%s):wrong index = %d", __func__, index);
         return -1;
     }
 
-    ret = fimc_v4l2_qbuf(m_cam_fd, index);
-    CHECK(ret);
+    {
+        Mutex::Autolock lock(m_record_lock);
+        m_record_inflight |= 1 << index;
+    }
+
+    if (m_latency_probe)
+        sec_latency_stamp_set(&m_record_stamp[index], m_record_frame_id++, frame_time);
+
+    if (timestamp)
+        *timestamp = m_record_ts_filter.filter(frame_time);
 
     return index;
 }
 
-int SecCamera::getRecordFrame()
+const struct sec_latency_stamp *SecCamera::getPreviewStamp(int index) const
 {
-    if (m_flag_record_start == 0) {
-        ALOGE("%s: m_flag_record_start is 0", __func__);
-        return -1;
-    }
+    if (!m_latency_probe || !(0 <= index && index < MAX_BUFFERS))
+        return NULL;
 
-    CHECK_FD(m_cam_fd2);
+    return &m_preview_stamp[index];
+}
+
+const struct sec_latency_stamp *SecCamera::getRecordStamp(int index) const
+{
+    if (!m_latency_probe || !(0 <= index && index < MAX_BUFFERS))
+        return NULL;
 
-    previewPoll(false);
-    return fimc_v4l2_dqbuf(m_cam_fd2);
+    return &m_record_stamp[index];
 }
 
 int SecCamera::releaseRecordFrame(int index)
@@ -1073,9 +1922,28 @@ int SecCamera::releaseRecordFrame(int index)
 
     CHECK_FD(m_cam_fd2);
 
+    {
+        /* a second release would queue a buffer fimc is already filling */
+        Mutex::Autolock lock(m_record_lock);
+        if (!(0 <= index && index < MAX_BUFFERS) ||
+            !(m_record_inflight & (1 << index))) {
+            ALOGW("%s: record frame %d isn't out, ignoring", __func__, index);
+            return 0;
+        }
+        m_record_inflight &= ~(1 << index);
+    }
+
     return fimc_v4l2_qbuf(m_cam_fd2, index);
 }
 
+/* frames the encoder still holds, fimc records to the rest */
+int SecCamera::getRecordFramesInFlight(void)
+{
+    Mutex::Autolock lock(m_record_lock);
+
+    return __builtin_popcount(m_record_inflight);
+}
+
 int SecCamera::setPreviewSize(int width, int height, int pixel_format)
 {
     ALOGV("%s(width(%d), height(%d), format(%d))", __func__, width, height, pixel_format);
@@ -1135,6 +2003,8 @@ int SecCamera::beginSnapshot(bool burst)
     int nframes, ret = 0;
 
     CHECK_FD(m_cam_fd);
+    if (waitSensorInit() < 0)
+        return -1;
 
     LOG_TIME_DEFINE(0)
     LOG_TIME_DEFINE(1)
@@ -1156,18 +2026,34 @@ int SecCamera::beginSnapshot(bool burst)
     CHECK(ret);
 
     if (m_camera_id == CAMERA_ID_BACK)
-        ret = fimc_v4l2_s_fmt_cap(m_cam_fd, m_snapshot_width, m_snapshot_height,
+        ret = fimc_v4l2_s_fmt_cap(m_cam_fd, &m_cam_fmt, m_snapshot_width, m_snapshot_height,
                 m_snapshot_v4lformat);
     else
-        ret = fimc_v4l2_s_fmt_cap(m_cam_fd, m_snapshot_height, m_snapshot_width,
+        ret = fimc_v4l2_s_fmt_cap(m_cam_fd, &m_cam_fmt, m_snapshot_height, m_snapshot_width,
                 m_snapshot_v4lformat);
     CHECK(ret);
 
-    nframes = 1;
-    ret = fimc_v4l2_reqbufs(m_cam_fd, V4L2_BUF_TYPE_VIDEO_CAPTURE, nframes);
-    CHECK(ret);
+    /* preview shares the queue so the buffers are requested every shot,
+     * the driver refuses REQBUFS while the old ones are still mapped
+     */
+    releaseCapturePool();
+
+    nframes = burst ? MAX_BURST_BUFFERS : 1;
+
+    /* a software encoded snapshot asks for one more buffer, which is never
+     * queued, for fimc to scale the thumbnail into
+     */
+    m_capture_scale_index = -1;
+    if (m_snapshot_v4lformat == V4L2_PIX_FMT_YUYV) {
+        ret = fimc_v4l2_reqbufs(m_cam_fd, V4L2_BUF_TYPE_VIDEO_CAPTURE, nframes + 1);
+        if (ret > nframes)
+            m_capture_scale_index = nframes;
+    }
+    if (m_capture_scale_index < 0) {
+        ret = fimc_v4l2_reqbufs(m_cam_fd, V4L2_BUF_TYPE_VIDEO_CAPTURE, nframes);
+        CHECK(ret);
+    }
 
-    m_capture_bufs = (fimc_buffer *) malloc(sizeof(fimc_buffer) * nframes);
     m_capture_bufs_size = nframes;
     m_capture_burst = burst;
     for(int i = 0; i < m_capture_bufs_size; i++) {
@@ -1177,6 +2063,13 @@ int SecCamera::beginSnapshot(bool burst)
         ret = fimc_v4l2_qbuf(m_cam_fd, i);
         CHECK(ret);
     }
+    if (m_capture_scale_index >= 0) {
+        fimc_buffer *buf = &m_capture_bufs[m_capture_scale_index];
+
+        buf->index = m_capture_scale_index;
+        if (fimc_v4l2_querybuf(m_cam_fd, buf, V4L2_BUF_TYPE_VIDEO_CAPTURE) < 0)
+            m_capture_scale_index = -1;
+    }
 
     ret = fimc_v4l2_streamon(m_cam_fd);
     CHECK(ret);
@@ -1199,35 +2092,94 @@ int SecCamera::endSnapshot(void)
     CHECK_FD(m_cam_fd);
 
     LOG_TIME_DEFINE(0)
-    LOG_TIME_DEFINE(1)
 
     LOG_TIME_START(0)
-    if(m_capture_bufs) {
-        for(int i = 0; i < m_capture_bufs_size; i++) {
-            if (m_capture_bufs[i].start) {
-                munmap(m_capture_bufs[i].start, m_capture_bufs[i].length);
-                ALOGV("munmap():virt. addr %p size = %d\n",
-                        m_capture_bufs[i].start, m_capture_bufs[i].length);
-            }
-        }
-        free(m_capture_bufs);
-        m_capture_bufs = NULL;
-    }
-    LOG_TIME_END(0)
-
-    LOG_TIME_START(1)
     ret = fimc_v4l2_streamoff(m_cam_fd);
+    /* preview requests its buffers on the same queue next */
+    releaseCapturePool();
     CHECK(ret);
-    LOG_TIME_END(1)
+    LOG_TIME_END(0)
 
     return ret;
 }
 
+void SecCamera::releaseRecordBufs(void)
+{
+    for (int i = 0; i < MAX_BUFFERS; i++) {
+        if (m_record_bufs[i].start) {
+            munmap(m_record_bufs[i].start, m_record_bufs[i].length);
+            m_record_bufs[i].start = NULL;
+        }
+    }
+}
+
+void SecCamera::releaseCapturePool(void)
+{
+    for (int i = 0; i < MAX_BURST_BUFFERS + 1; i++) {
+        if (m_capture_bufs[i].start) {
+            munmap(m_capture_bufs[i].start, m_capture_bufs[i].length);
+            ALOGV("munmap():virt. addr %p size = %d\n",
+                    m_capture_bufs[i].start, m_capture_bufs[i].length);
+        }
+    }
+    memset(m_capture_bufs, 0, sizeof(m_capture_bufs));
+    m_capture_bufs_size = 0;
+    m_capture_scale_index = -1;
+}
+
+/* scale a captured YCbYCr frame with the fimc1 post processor into the
+ * spare snapshot buffer and copy the result out.  the capture buffer
+ * must still be dequeued.
+ */
+int SecCamera::scaleSnapshotFrame(int index, unsigned char *dst, int width, int height)
+{
+    if (m_capture_scale_index < 0 || m_snapshot_v4lformat != V4L2_PIX_FMT_YUYV)
+        return -1;
+
+    fimc_buffer *scale_buf = &m_capture_bufs[m_capture_scale_index];
+    if ((size_t)(width * height * 2) > scale_buf->length)
+        return -1;
+
+    if (m_scaler_fd < 0) {
+        m_scaler_fd = open(SCALER_DEV_NAME, O_RDWR);
+        if (m_scaler_fd < 0) {
+            ALOGW("WARN(%s):Cannot open %s (error : %s)", __func__,
+                 SCALER_DEV_NAME, strerror(errno));
+            return -1;
+        }
+        sec_v4l2_gen_open(&m_scaler_gen, m_scaler_fd);
+    }
+
+    unsigned int src_addr = fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_PADDR_Y, index);
+    unsigned int dst_addr = fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_PADDR_Y,
+                                             m_capture_scale_index);
+    if ((int)src_addr <= 0 || (int)dst_addr <= 0)
+        return -1;
+
+    // the overlay's libfimc jobs lock the node, the thumbnail can be
+    // scaled on the CPU instead of holding up a frame
+    if (flock(m_scaler_fd, LOCK_EX | LOCK_NB) < 0 && errno == EWOULDBLOCK)
+        return -1;
+
+    sec_v4l2_gen_bump(&m_scaler_gen);
+    int ret = fimc_m2m_scale(m_scaler_fd, V4L2_PIX_FMT_YUYV,
+                             src_addr, m_snapshot_width, m_snapshot_height,
+                             dst_addr, width, height);
+    flock(m_scaler_fd, LOCK_UN);
+    if (ret < 0)
+        return -1;
+
+    memcpy(dst, scale_buf->start, width * height * 2);
+    return 0;
+}
+
 /*
- * Set Jpeg quality & exif info and get JPEG data from camera ISP
+ * Set Jpeg quality & exif info and get JPEG data from camera ISP.
+ * In burst mode a caller that passes index keeps the buffer until it
+ * calls releaseSnapshotFrame(), otherwise it is requeued right away.
  */
 int SecCamera::getJpeg(unsigned int *phyaddr, unsigned char** jpeg_buf,
-                       unsigned int *jpeg_size)
+                       unsigned int *jpeg_size, int *index_out)
 {
     ALOGV("%s :", __func__);
 
@@ -1259,10 +2211,16 @@ int SecCamera::getJpeg(unsigned int *phyaddr, unsigned char** jpeg_buf,
         return -1;
     }
     if(m_capture_burst) {
-        ret = fimc_v4l2_qbuf(m_cam_fd, index);
-        CHECK(ret);
+        if (index_out != NULL) {
+            *index_out = index;
+        } else {
+            ret = fimc_v4l2_qbuf(m_cam_fd, index);
+            CHECK(ret);
+        }
     } else {
         fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_STREAM_PAUSE, 0);
+        if (index_out != NULL)
+            *index_out = -1;
     }
     LOG_TIME_END(0)
 
@@ -1288,7 +2246,22 @@ int SecCamera::getJpeg(unsigned int *phyaddr, unsigned char** jpeg_buf,
     return 0;
 }
 
-int SecCamera::getExif(unsigned char *pExifDst, unsigned char *pThumbSrc)
+/* hand a burst buffer kept by getJpeg() back to the driver */
+int SecCamera::releaseSnapshotFrame(int index)
+{
+    if (!m_capture_burst || index < 0)
+        return 0;
+
+    if (!(index < m_capture_bufs_size)) {
+        ALOGE("ERR(%s):wrong index = %d", __func__, index);
+        return -1;
+    }
+
+    return fimc_v4l2_qbuf(m_cam_fd, index);
+}
+
+int SecCamera::getExif(unsigned char *pExifDst, unsigned char *pThumbSrc,
+                       int width, int height)
 {
     JpegEncoder jpgEnc;
 
@@ -1350,6 +2323,12 @@ int SecCamera::getExif(unsigned char *pExifDst, unsigned char *pThumbSrc)
 
     setExifChangedAttribute();
 
+    /* the picture doesn't come from a snapshot, e.g. zero shutter lag */
+    if (width > 0 && height > 0) {
+        mExifInfo.width = width;
+        mExifInfo.height = height;
+    }
+
     ALOGV("%s: calling jpgEnc.makeExif, mExifInfo.width set to %d, height to %d\n",
          __func__, mExifInfo.width, mExifInfo.height);
 
@@ -1393,9 +2372,34 @@ int SecCamera::getPostViewOffset(void)
     return m_postview_offset;
 }
 
+/* copies the encoder output into a buffer the caller already has */
+class SecJpegBufferSink : public SecJpegSink {
+    unsigned char *mBuf;
+public:
+    SecJpegBufferSink(unsigned char *buf) : mBuf(buf) { }
+    virtual unsigned char *getBuffer(unsigned int size) { return mBuf; }
+};
+
+/*
+ * Capture a frame into yuv_buf and encode it.  When thumb_buf is given
+ * it also gets the frame scaled to the thumbnail size, by fimc when it
+ * can and in software otherwise.
+ */
 int SecCamera::getJpeg(unsigned char *yuv_buf, unsigned char *jpeg_buf,
-                       unsigned int *jpeg_size)
+                       unsigned int *jpeg_size, unsigned char *thumb_buf,
+                       int thumb_width, int thumb_height)
+{
+    SecJpegBufferSink sink(jpeg_buf);
+
+    return getJpeg(yuv_buf, &sink, jpeg_size, thumb_buf, thumb_width, thumb_height);
+}
+
+int SecCamera::getJpeg(unsigned char *yuv_buf, SecJpegSink *sink,
+                       unsigned int *jpeg_size, unsigned char *thumb_buf,
+                       int thumb_width, int thumb_height)
 {
+    bool thumb_done = false;
+
     ALOGV("%s :", __func__);
 
     int index, ret = 0;
@@ -1417,26 +2421,35 @@ int SecCamera::getJpeg(unsigned char *yuv_buf, unsigned char *jpeg_buf,
         ALOGE("ERR(%s):wrong index = %d", __func__, index);
         return -1;
     }
-    if(m_capture_burst) {
-        ret = fimc_v4l2_qbuf(m_cam_fd, index);
-        CHECK(ret);
-    } else {
+    if(!m_capture_burst)
         fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_STREAM_PAUSE, 0);
-    }
     ALOGV("Snapshot dqueued buffer = %d snapshot_width = %d snapshot_height = %d",
             index, m_snapshot_width, m_snapshot_height);
     LOG_TIME_END(0)
 
+    /* everything below reads the capture buffer in place, yuv_buf only
+     * gets a copy when the caller wants the postview
+     */
+    unsigned char *frame = (unsigned char*)m_capture_bufs[index].start;
+
     LOG_TIME_START(1)
-    ALOGV("%s : calling memcpy from m_capture_bufs", __func__);
-    memcpy(yuv_buf, (unsigned char*)m_capture_bufs[index].start,
-            m_snapshot_width * m_snapshot_height * 2);
+    if (yuv_buf != NULL) {
+        ALOGV("%s : calling memcpy from m_capture_bufs", __func__);
+        memcpy(yuv_buf, frame, m_snapshot_width * m_snapshot_height * 2);
+    }
+    if (thumb_buf != NULL) {
+        thumb_done = scaleSnapshotFrame(index, thumb_buf, thumb_width, thumb_height) == 0;
+        if (!thumb_done)
+            thumb_done = scaleYuyvBilinear(frame, m_snapshot_width, m_snapshot_height,
+                                           thumb_buf, thumb_width, thumb_height);
+        if (!thumb_done) {
+            ALOGE("ERR(%s):Fail on thumbnail scaling", __func__);
+            ret = -1;
+        }
+    }
     LOG_TIME_END(1)
 
     LOG_TIME_START(2)
-    /* JPEG encoding */
-    JpegEncoder jpgEnc;
-    int inFormat = JPG_MODESEL_YCBCR;
     int outFormat = JPG_422;
 
     switch (m_snapshot_v4lformat) {
@@ -1454,10 +2467,43 @@ int SecCamera::getJpeg(unsigned char *yuv_buf, unsigned char *jpeg_buf,
         break;
     }
 
+    if (ret == 0)
+        ret = encodeJpeg(frame, m_snapshot_width, m_snapshot_height, outFormat,
+                         sink, jpeg_size);
+    LOG_TIME_END(2)
+
+    // the encoder is done with the frame, the sensor can fill the buffer again
+    if(m_capture_burst && fimc_v4l2_qbuf(m_cam_fd, index) < 0)
+        ret = -1;
+    CHECK(ret);
+
+    LOG_CAMERA("getJpeg intervals: capture(%lu), postview(%lu), yuv2Jpeg(%lu)  us",
+                    LOG_TIME(0), LOG_TIME(1), LOG_TIME(2));
+
+    return 0;
+}
+
+int SecCamera::encodeJpeg(unsigned char *yuv_buf, int width, int height,
+                          int sampling, unsigned char *jpeg_buf,
+                          unsigned int *jpeg_size)
+{
+    SecJpegBufferSink sink(jpeg_buf);
+
+    return encodeJpeg(yuv_buf, width, height, sampling, &sink, jpeg_size);
+}
+
+/* encode YCbCr 4:2:2 interleaved data with the jpeg encoder */
+int SecCamera::encodeJpeg(unsigned char *yuv_buf, int width, int height,
+                          int sampling, SecJpegSink *sink,
+                          unsigned int *jpeg_size)
+{
+    JpegEncoder jpgEnc;
+    int inFormat = JPG_MODESEL_YCBCR;
+
     if (jpgEnc.setConfig(JPEG_SET_ENCODE_IN_FORMAT, inFormat) != JPG_SUCCESS)
         ALOGE("[JPEG_SET_ENCODE_IN_FORMAT] Error\n");
 
-    if (jpgEnc.setConfig(JPEG_SET_SAMPING_MODE, outFormat) != JPG_SUCCESS)
+    if (jpgEnc.setConfig(JPEG_SET_SAMPING_MODE, sampling) != JPG_SUCCESS)
         ALOGE("[JPEG_SET_SAMPING_MODE] Error\n");
 
     image_quality_type_t jpegQuality;
@@ -1472,13 +2518,13 @@ int SecCamera::getJpeg(unsigned char *yuv_buf, unsigned char *jpeg_buf,
 
     if (jpgEnc.setConfig(JPEG_SET_ENCODE_QUALITY, jpegQuality) != JPG_SUCCESS)
         ALOGE("[JPEG_SET_ENCODE_QUALITY] Error\n");
-    if (jpgEnc.setConfig(JPEG_SET_ENCODE_WIDTH, m_snapshot_width) != JPG_SUCCESS)
+    if (jpgEnc.setConfig(JPEG_SET_ENCODE_WIDTH, width) != JPG_SUCCESS)
         ALOGE("[JPEG_SET_ENCODE_WIDTH] Error\n");
 
-    if (jpgEnc.setConfig(JPEG_SET_ENCODE_HEIGHT, m_snapshot_height) != JPG_SUCCESS)
+    if (jpgEnc.setConfig(JPEG_SET_ENCODE_HEIGHT, height) != JPG_SUCCESS)
         ALOGE("[JPEG_SET_ENCODE_HEIGHT] Error\n");
 
-    unsigned int snapshot_size = m_snapshot_width * m_snapshot_height * 2;
+    unsigned int snapshot_size = width * height * 2;
     unsigned char *pInBuf = (unsigned char *)jpgEnc.getInBuf(snapshot_size);
 
     if (pInBuf == NULL) {
@@ -1489,7 +2535,6 @@ int SecCamera::getJpeg(unsigned char *yuv_buf, unsigned char *jpeg_buf,
 
     setExifChangedAttribute();
     jpgEnc.encode(jpeg_size, &mExifInfo);
-    LOG_TIME_END(2)
 
     uint64_t outbuf_size;
     unsigned char *pOutBuf = (unsigned char *)jpgEnc.getOutBuf(&outbuf_size);
@@ -1499,10 +2544,12 @@ int SecCamera::getJpeg(unsigned char *yuv_buf, unsigned char *jpeg_buf,
         return -1;
     }
 
-    memcpy(jpeg_buf, pOutBuf, outbuf_size);
-
-    LOG_CAMERA("getJpeg intervals: capture(%lu), memcpy(%lu), yuv2Jpeg(%lu)  us",
-                    LOG_TIME(0), LOG_TIME(1), LOG_TIME(2));
+    unsigned char *jpeg_buf = sink->getBuffer(*jpeg_size);
+    if (jpeg_buf == NULL) {
+        ALOGE("ERR(%s):no buffer for %u bytes of jpeg", __func__, *jpeg_size);
+        return -1;
+    }
+    memcpy(jpeg_buf, pOutBuf, *jpeg_size);
 
     return 0;
 }
@@ -1606,6 +2653,15 @@ int SecCamera::setAutofocus(void)
 
     CHECK_FD(m_cam_fd);
 
+#ifdef V4L2_EVENT_CTRL
+    /* subscribe before starting, so the result can't be missed */
+    if (m_af_events < 0) {
+        m_af_events = fimc_v4l2_subscribe_ctrl_event(m_cam_fd,
+                            V4L2_CID_CAMERA_AUTO_FOCUS_RESULT_FIRST) == 0;
+        ALOGV("%s: af result %s", __func__, m_af_events ? "by event" : "polled");
+    }
+#endif
+
     if (fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_SET_AUTO_FOCUS, AUTO_FOCUS_ON) < 0) {
             ALOGE("ERR(%s):Fail on V4L2_CID_CAMERA_SET_AUTO_FOCUS", __func__);
         return -1;
@@ -1622,11 +2678,37 @@ int SecCamera::getAutoFocusResult(void)
 
     CHECK_FD(m_cam_fd);
 
-    for (count = 0; count < FIRST_AF_SEARCH_COUNT; count++) {
-        ret = fimc_v4l2_g_ctrl(m_cam_fd, V4L2_CID_CAMERA_AUTO_FOCUS_RESULT_FIRST);
-        if (ret != AF_PROGRESS)
-            break;
+    count = 0;
+    ret = fimc_v4l2_g_ctrl(m_cam_fd, V4L2_CID_CAMERA_AUTO_FOCUS_RESULT_FIRST);
+
+#ifdef V4L2_EVENT_CTRL
+    /* sleep until the sensor reports a change instead of reading the
+     * status over i2c every AF_DELAY
+     */
+    if (m_af_events > 0) {
+        nsecs_t deadline = systemTime() + us2ns(FIRST_AF_SEARCH_COUNT * AF_DELAY);
+
+        while (ret == AF_PROGRESS) {
+            int left = ns2ms(deadline - systemTime());
+            if (left <= 0) {
+                count = FIRST_AF_SEARCH_COUNT;
+                break;
+            }
+            int event = fimc_v4l2_wait_ctrl_event(m_cam_fd, left);
+            if (event < 0) {
+                ALOGW("%s: af events failed, polling", __func__);
+                m_af_events = 0;
+                break;
+            }
+            if (event > 0)
+                ret = fimc_v4l2_g_ctrl(m_cam_fd, V4L2_CID_CAMERA_AUTO_FOCUS_RESULT_FIRST);
+        }
+    }
+#endif
+
+    for (; ret == AF_PROGRESS && count < FIRST_AF_SEARCH_COUNT; count++) {
         usleep(AF_DELAY);
+        ret = fimc_v4l2_g_ctrl(m_cam_fd, V4L2_CID_CAMERA_AUTO_FOCUS_RESULT_FIRST);
     }
 
     if ((count >= FIRST_AF_SEARCH_COUNT) || (ret != AF_SUCCESS)) {
@@ -1745,6 +2827,11 @@ int SecCamera::setFrameRate(int frame_rate)
     return 0;
 }
 
+int SecCamera::getFrameRate(void)
+{
+    return m_params->capture.timeperframe.denominator;
+}
+
 // -----------------------------------
 
 int SecCamera::setVerticalMirror(void)
@@ -1787,12 +2874,13 @@ int SecCamera::setWhiteBalance(int white_balance)
     }
 
     if (m_params->white_balance != white_balance) {
-        m_params->white_balance = white_balance;
         if (m_flag_camera_start) {
-            if (fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_WHITE_BALANCE, white_balance) < 0) {
+            if (setCameraCtrl(V4L2_CID_CAMERA_WHITE_BALANCE, white_balance, &m_params->white_balance) < 0) {
                 ALOGE("ERR(%s):Fail on V4L2_CID_CAMERA_WHITE_BALANCE", __func__);
                 return -1;
             }
+        } else {
+            m_params->white_balance = white_balance;
         }
     }
 
@@ -1819,12 +2907,13 @@ int SecCamera::setBrightness(int brightness)
     }
 
     if (m_params->brightness != brightness) {
-        m_params->brightness = brightness;
         if (m_flag_camera_start) {
-            if (fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_BRIGHTNESS, brightness) < 0) {
+            if (setCameraCtrl(V4L2_CID_CAMERA_BRIGHTNESS, brightness, &m_params->brightness) < 0) {
                 ALOGE("ERR(%s):Fail on V4L2_CID_CAMERA_BRIGHTNESS", __func__);
                 return -1;
             }
+        } else {
+            m_params->brightness = brightness;
         }
     }
 
@@ -1849,12 +2938,13 @@ int SecCamera::setImageEffect(int image_effect)
     }
 
     if (m_params->effects != image_effect) {
-        m_params->effects = image_effect;
         if (m_flag_camera_start) {
-            if (fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_EFFECT, image_effect) < 0) {
+            if (setCameraCtrl(V4L2_CID_CAMERA_EFFECT, image_effect, &m_params->effects) < 0) {
                  ALOGE("ERR(%s):Fail on V4L2_CID_CAMERA_EFFECT", __func__);
                  return -1;
             }
+        } else {
+            m_params->effects = image_effect;
         }
     }
 
@@ -1878,12 +2968,13 @@ int SecCamera::setAntiBanding(int anti_banding)
     }
 
     if (m_anti_banding != anti_banding) {
-        m_anti_banding = anti_banding;
         if (m_flag_camera_start) {
-            if (fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_ANTI_BANDING, anti_banding) < 0) {
+            if (setCameraCtrl(V4L2_CID_CAMERA_ANTI_BANDING, anti_banding, &m_anti_banding) < 0) {
                  ALOGE("ERR(%s):Fail on V4L2_CID_CAMERA_ANTI_BANDING", __func__);
                  return -1;
             }
+        } else {
+            m_anti_banding = anti_banding;
         }
     }
 
@@ -1901,12 +2992,13 @@ int SecCamera::setSceneMode(int scene_mode)
     }
 
     if (m_params->scene_mode != scene_mode) {
-        m_params->scene_mode = scene_mode;
         if (m_flag_camera_start) {
-            if (fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_SCENE_MODE, scene_mode) < 0) {
+            if (setCameraCtrl(V4L2_CID_CAMERA_SCENE_MODE, scene_mode, &m_params->scene_mode) < 0) {
                 ALOGE("ERR(%s):Fail on V4L2_CID_CAMERA_SCENE_MODE", __func__);
                 return -1;
             }
+        } else {
+            m_params->scene_mode = scene_mode;
         }
     }
 
@@ -1930,12 +3022,13 @@ int SecCamera::setFlashMode(int flash_mode)
     }
 
     if (m_params->flash_mode != flash_mode) {
-        m_params->flash_mode = flash_mode;
         if (m_flag_camera_start) {
-            if (fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_FLASH_MODE, flash_mode) < 0) {
+            if (setCameraCtrl(V4L2_CID_CAMERA_FLASH_MODE, flash_mode, &m_params->flash_mode) < 0) {
                 ALOGE("ERR(%s):Fail on V4L2_CID_CAMERA_FLASH_MODE", __func__);
                 return -1;
             }
+        } else {
+            m_params->flash_mode = flash_mode;
         }
     }
 
@@ -1958,12 +3051,13 @@ int SecCamera::setISO(int iso_value)
     }
 
     if (m_params->iso != iso_value) {
-        m_params->iso = iso_value;
         if (m_flag_camera_start) {
-            if (fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_ISO, iso_value) < 0) {
+            if (setCameraCtrl(V4L2_CID_CAMERA_ISO, iso_value, &m_params->iso) < 0) {
                 ALOGE("ERR(%s):Fail on V4L2_CID_CAMERA_ISO", __func__);
                 return -1;
             }
+        } else {
+            m_params->iso = iso_value;
         }
     }
 
@@ -1987,12 +3081,13 @@ int SecCamera::setContrast(int contrast_value)
     }
 
     if (m_params->contrast != contrast_value) {
-        m_params->contrast = contrast_value;
         if (m_flag_camera_start) {
-            if (fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_CONTRAST, contrast_value) < 0) {
+            if (setCameraCtrl(V4L2_CID_CAMERA_CONTRAST, contrast_value, &m_params->contrast) < 0) {
                 ALOGE("ERR(%s):Fail on V4L2_CID_CAMERA_CONTRAST", __func__);
                 return -1;
             }
+        } else {
+            m_params->contrast = contrast_value;
         }
     }
 
@@ -2016,12 +3111,13 @@ int SecCamera::setSaturation(int saturation_value)
     }
 
     if (m_params->saturation != saturation_value) {
-        m_params->saturation = saturation_value;
         if (m_flag_camera_start) {
-            if (fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_SATURATION, saturation_value) < 0) {
+            if (setCameraCtrl(V4L2_CID_CAMERA_SATURATION, saturation_value, &m_params->saturation) < 0) {
                 ALOGE("ERR(%s):Fail on V4L2_CID_CAMERA_SATURATION", __func__);
                 return -1;
             }
+        } else {
+            m_params->saturation = saturation_value;
         }
     }
 
@@ -2045,12 +3141,13 @@ int SecCamera::setSharpness(int sharpness_value)
     }
 
     if (m_params->sharpness != sharpness_value) {
-        m_params->sharpness = sharpness_value;
         if (m_flag_camera_start) {
-            if (fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_SHARPNESS, sharpness_value) < 0) {
+            if (setCameraCtrl(V4L2_CID_CAMERA_SHARPNESS, sharpness_value, &m_params->sharpness) < 0) {
                 ALOGE("ERR(%s):Fail on V4L2_CID_CAMERA_SHARPNESS", __func__);
                 return -1;
             }
+        } else {
+            m_params->sharpness = sharpness_value;
         }
     }
 
@@ -2074,12 +3171,13 @@ int SecCamera::setWDR(int wdr_value)
     }
 
     if (m_wdr != wdr_value) {
-        m_wdr = wdr_value;
         if (m_flag_camera_start) {
-            if (fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_WDR, wdr_value) < 0) {
+            if (setCameraCtrl(V4L2_CID_CAMERA_WDR, wdr_value, &m_wdr) < 0) {
                 ALOGE("ERR(%s):Fail on V4L2_CID_CAMERA_WDR", __func__);
                 return -1;
             }
+        } else {
+            m_wdr = wdr_value;
         }
     }
 
@@ -2103,12 +3201,13 @@ int SecCamera::setAntiShake(int anti_shake)
     }
 
     if (m_anti_shake != anti_shake) {
-        m_anti_shake = anti_shake;
         if (m_flag_camera_start) {
-            if (fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_ANTI_SHAKE, anti_shake) < 0) {
+            if (setCameraCtrl(V4L2_CID_CAMERA_ANTI_SHAKE, anti_shake, &m_anti_shake) < 0) {
                 ALOGE("ERR(%s):Fail on V4L2_CID_CAMERA_ANTI_SHAKE", __func__);
                 return -1;
             }
+        } else {
+            m_anti_shake = anti_shake;
         }
     }
 
@@ -2133,12 +3232,13 @@ int SecCamera::setMetering(int metering_value)
     }
 
     if (m_params->metering != metering_value) {
-        m_params->metering = metering_value;
         if (m_flag_camera_start) {
-            if (fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_METERING, metering_value) < 0) {
+            if (setCameraCtrl(V4L2_CID_CAMERA_METERING, metering_value, &m_params->metering) < 0) {
                 ALOGE("ERR(%s):Fail on V4L2_CID_CAMERA_METERING", __func__);
                 return -1;
             }
+        } else {
+            m_params->metering = metering_value;
         }
     }
 
@@ -2162,12 +3262,13 @@ int SecCamera::setJpegQuality(int jpeg_quality)
     }
 
     if (m_jpeg_quality != jpeg_quality) {
-        m_jpeg_quality = jpeg_quality;
         if (m_flag_camera_start && (m_camera_id == CAMERA_ID_BACK)) {
-            if (fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAM_JPEG_QUALITY, jpeg_quality) < 0) {
+            if (setCameraCtrl(V4L2_CID_CAM_JPEG_QUALITY, jpeg_quality, &m_jpeg_quality) < 0) {
                 ALOGE("ERR(%s):Fail on V4L2_CID_CAM_JPEG_QUALITY", __func__);
                 return -1;
             }
+        } else {
+            m_jpeg_quality = jpeg_quality;
         }
     }
 
@@ -2191,12 +3292,25 @@ int SecCamera::setZoom(int zoom_level)
     }
 
     if (m_zoom_level != zoom_level) {
-        m_zoom_level = zoom_level;
         if (m_flag_camera_start) {
-            if (fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_ZOOM, zoom_level) < 0) {
+            if (setCameraCtrl(V4L2_CID_CAMERA_ZOOM, zoom_level, &m_zoom_level) < 0) {
                 ALOGE("ERR(%s):Fail on V4L2_CID_CAMERA_ZOOM", __func__);
                 return -1;
             }
+        } else {
+            m_zoom_level = zoom_level;
+        }
+    }
+
+    // the sensor does all of it, the crop goes back to the whole frame
+    if (m_zoom_ratio != zoomLevelRatio(zoom_level)) {
+        m_zoom_ratio = zoomLevelRatio(zoom_level);
+        if (m_flag_camera_start) {
+            applyZoomCrop(m_cam_fd);
+            if (m_flag_record_prepared) {
+                RecordNodeLock node(m_cam_fd2, &m_cam_gen2);
+                applyZoomCrop(m_cam_fd2);
+            }
         }
     }
 
@@ -2208,6 +3322,77 @@ int SecCamera::getZoom(void)
     return m_zoom_level;
 }
 
+/*
+ * Zooms on the fimc capture crop, which takes effect with the next frames
+ * and costs no sensor settle time. The crop only narrows what the sensor
+ * sends: zooming out below the sensor level drops the sensor back to no
+ * zoom once and leaves everything to the crop from then on.
+ */
+int SecCamera::setZoomRatio(int ratio)
+{
+    int max_ratio = zoomLevelRatio(ZOOM_LEVEL_MAX - 1);
+
+    ALOGV("%s(ratio (%d))", __func__, ratio);
+
+    if (ratio < ZOOM_RATIO_MIN)
+        ratio = ZOOM_RATIO_MIN;
+    if (ratio > max_ratio)
+        ratio = max_ratio;
+
+    if (!m_flag_camera_start || !m_crop_bounds.width)
+        return setZoom((ratio - ZOOM_RATIO_MIN) / ZOOM_RATIO_STEP);
+
+    if (ratio < zoomLevelRatio(m_zoom_level) && setZoom(ZOOM_LEVEL_0) < 0)
+        return -1;
+
+    if (m_zoom_ratio == ratio)
+        return 0;
+    m_zoom_ratio = ratio;
+
+    if (applyZoomCrop(m_cam_fd) < 0)
+        return -1;
+    if (m_flag_record_prepared) {
+        RecordNodeLock node(m_cam_fd2, &m_cam_gen2);
+        applyZoomCrop(m_cam_fd2);
+    }
+
+    return 0;
+}
+
+int SecCamera::getZoomRatio(void)
+{
+    return m_zoom_ratio;
+}
+
+int SecCamera::zoomLevelRatio(int zoom_level)
+{
+    if (zoom_level < ZOOM_LEVEL_0)
+        zoom_level = ZOOM_LEVEL_0;
+    return ZOOM_RATIO_MIN + zoom_level * ZOOM_RATIO_STEP;
+}
+
+// the centre of the camera input, what m_zoom_ratio asks on top of the sensor
+int SecCamera::applyZoomCrop(int fd)
+{
+    struct v4l2_rect rect;
+    int crop_ratio;
+
+    if (!m_crop_bounds.width)
+        return -1;
+
+    crop_ratio = m_zoom_ratio * 100 / zoomLevelRatio(m_zoom_level);
+    if (crop_ratio < 100)
+        crop_ratio = 100;
+
+    // fimc wants the input window in 16 pixel wide, even line high steps
+    rect.width = (m_crop_bounds.width * 100 / crop_ratio) & ~15;
+    rect.height = (m_crop_bounds.height * 100 / crop_ratio) & ~1;
+    rect.left = m_crop_bounds.left + (((m_crop_bounds.width - rect.width) / 2) & ~1);
+    rect.top = m_crop_bounds.top + (((m_crop_bounds.height - rect.height) / 2) & ~1);
+
+    return fimc_v4l2_s_crop(fd, &rect);
+}
+
 //======================================================================
 
 int SecCamera::setObjectTracking(int object_tracking)
@@ -2243,8 +3428,8 @@ int SecCamera::setObjectTrackingStartStop(int start_stop)
     ALOGV("%s(object_tracking_start_stop (%d))", __func__, start_stop);
 
     if (m_object_tracking_start_stop != start_stop) {
-        m_object_tracking_start_stop = start_stop;
-        if (fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_OBJ_TRACKING_START_STOP, start_stop) < 0) {
+        if (setCameraCtrl(V4L2_CID_CAMERA_OBJ_TRACKING_START_STOP, start_stop,
+                          &m_object_tracking_start_stop) < 0) {
             ALOGE("ERR(%s):Fail on V4L2_CID_CAMERA_OBJ_TRACKING_START_STOP", __func__);
             return -1;
         }
@@ -2258,8 +3443,8 @@ int SecCamera::setTouchAFStartStop(int start_stop)
     ALOGV("%s(touch_af_start_stop (%d))", __func__, start_stop);
 
     if (m_touch_af_start_stop != start_stop && m_flag_camera_start) {
-        m_touch_af_start_stop = start_stop;
-        if (fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_TOUCH_AF_START_STOP, start_stop) < 0) {
+        if (setCameraCtrl(V4L2_CID_CAMERA_TOUCH_AF_START_STOP, start_stop,
+                          &m_touch_af_start_stop) < 0) {
             ALOGE("ERR(%s):Fail on V4L2_CID_CAMERA_TOUCH_AF_START_STOP", __func__);
             return -1;
         }
@@ -2280,12 +3465,13 @@ int SecCamera::setSmartAuto(int smart_auto)
     }
 
     if (m_smart_auto != smart_auto) {
-        m_smart_auto = smart_auto;
         if (m_flag_camera_start) {
-            if (fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_SMART_AUTO, smart_auto) < 0) {
+            if (setCameraCtrl(V4L2_CID_CAMERA_SMART_AUTO, smart_auto, &m_smart_auto) < 0) {
                 ALOGE("ERR(%s):Fail on V4L2_CID_CAMERA_SMART_AUTO", __func__);
                 return -1;
             }
+        } else {
+            m_smart_auto = smart_auto;
         }
     }
 
@@ -2324,12 +3510,13 @@ int SecCamera::setBeautyShot(int beauty_shot)
     }
 
     if (m_beauty_shot != beauty_shot) {
-        m_beauty_shot = beauty_shot;
         if (m_flag_camera_start) {
-            if (fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_BEAUTY_SHOT, beauty_shot) < 0) {
+            if (setCameraCtrl(V4L2_CID_CAMERA_BEAUTY_SHOT, beauty_shot, &m_beauty_shot) < 0) {
                 ALOGE("ERR(%s):Fail on V4L2_CID_CAMERA_BEAUTY_SHOT", __func__);
                 return -1;
             }
+        } else {
+            m_beauty_shot = beauty_shot;
         }
 
         setFaceDetect(FACE_DETECTION_ON_BEAUTY);
@@ -2355,12 +3542,13 @@ int SecCamera::setVintageMode(int vintage_mode)
     }
 
     if (m_vintage_mode != vintage_mode) {
-        m_vintage_mode = vintage_mode;
         if (m_flag_camera_start) {
-            if (fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_VINTAGE_MODE, vintage_mode) < 0) {
+            if (setCameraCtrl(V4L2_CID_CAMERA_VINTAGE_MODE, vintage_mode, &m_vintage_mode) < 0) {
                 ALOGE("ERR(%s):Fail on V4L2_CID_CAMERA_VINTAGE_MODE", __func__);
                 return -1;
             }
+        } else {
+            m_vintage_mode = vintage_mode;
         }
     }
 
@@ -2384,13 +3572,13 @@ int SecCamera::setFocusMode(int focus_mode)
     }
 
     if (m_params->focus_mode != focus_mode) {
-        m_params->focus_mode = focus_mode;
-
         if (m_flag_camera_start) {
-            if (fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_FOCUS_MODE, focus_mode) < 0) {
+            if (setCameraCtrl(V4L2_CID_CAMERA_FOCUS_MODE, focus_mode, &m_params->focus_mode) < 0) {
                 ALOGE("ERR(%s):Fail on V4L2_CID_CAMERA_FOCUS_MODE", __func__);
                 return -1;
             }
+        } else {
+            m_params->focus_mode = focus_mode;
         }
     }
 
@@ -2409,18 +3597,19 @@ int SecCamera::setFaceDetect(int face_detect)
     ALOGV("%s(face_detect(%d))", __func__, face_detect);
 
     if (m_face_detect != face_detect) {
-        m_face_detect = face_detect;
         if (m_flag_camera_start) {
-            if (m_face_detect != FACE_DETECTION_OFF) {
-                if (fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_FOCUS_MODE, FOCUS_MODE_AUTO) < 0) {
+            if (face_detect != FACE_DETECTION_OFF) {
+                if (setCameraCtrl(V4L2_CID_CAMERA_FOCUS_MODE, FOCUS_MODE_AUTO) < 0) {
                     ALOGE("ERR(%s):Fail on V4L2_CID_CAMERA_FOCUS_MODin face detecion", __func__);
                     return -1;
                 }
             }
-            if (fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_FACE_DETECTION, face_detect) < 0) {
+            if (setCameraCtrl(V4L2_CID_CAMERA_FACE_DETECTION, face_detect, &m_face_detect) < 0) {
                 ALOGE("ERR(%s):Fail on V4L2_CID_CAMERA_FACE_DETECTION", __func__);
                 return -1;
             }
+        } else {
+            m_face_detect = face_detect;
         }
     }
 
@@ -2509,7 +3698,7 @@ int SecCamera::setFaceDetectLockUnlock(int facedetect_lockunlock)
 {
     ALOGV("%s(facedetect_lockunlock(%d))", __func__, facedetect_lockunlock);
 
-    if (fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_FACEDETECT_LOCKUNLOCK, facedetect_lockunlock) < 0) {
+    if (setCameraCtrl(V4L2_CID_CAMERA_FACEDETECT_LOCKUNLOCK, facedetect_lockunlock) < 0) {
         ALOGE("ERR(%s):Fail on V4L2_CID_CAMERA_FACEDETECT_LOCKUNLOCK", __func__);
         return -1;
     }
@@ -2525,11 +3714,11 @@ int SecCamera::setObjectPosition(int x, int y)
     //    x = x - 80;
 
     if (m_flag_camera_start) {
-        if (fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_OBJECT_POSITION_X, x) < 0) {
+        if (setCameraCtrl(V4L2_CID_CAMERA_OBJECT_POSITION_X, x) < 0) {
             ALOGE("ERR(%s):Fail on V4L2_CID_CAMERA_OBJECT_POSITION_X", __func__);
             return -1;
         }
-        if (fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_OBJECT_POSITION_Y, y) < 0) {
+        if (setCameraCtrl(V4L2_CID_CAMERA_OBJECT_POSITION_Y, y) < 0) {
             ALOGE("ERR(%s):Fail on V4L2_CID_CAMERA_OBJECT_POSITION_Y", __func__);
             return -1;
         }
@@ -2550,12 +3739,13 @@ int SecCamera::setGamma(int gamma)
      }
 
      if (m_video_gamma != gamma) {
-         m_video_gamma = gamma;
          if (m_flag_camera_start) {
-             if (fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_SET_GAMMA, gamma) < 0) {
+             if (setCameraCtrl(V4L2_CID_CAMERA_SET_GAMMA, gamma, &m_video_gamma) < 0) {
                  ALOGE("ERR(%s):Fail on V4L2_CID_CAMERA_SET_GAMMA", __func__);
                  return -1;
              }
+         } else {
+             m_video_gamma = gamma;
          }
      }
 
@@ -2573,13 +3763,14 @@ int SecCamera::setSlowAE(int slow_ae)
          return -1;
      }
 
-     if (m_slow_ae!= slow_ae) {
-         m_slow_ae = slow_ae;
+     if (m_slow_ae != slow_ae) {
          if (m_flag_camera_start) {
-             if (fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_SET_SLOW_AE, slow_ae) < 0) {
+             if (setCameraCtrl(V4L2_CID_CAMERA_SET_SLOW_AE, slow_ae, &m_slow_ae) < 0) {
                  ALOGE("ERR(%s):Fail on V4L2_CID_CAMERA_SET_SLOW_AE", __func__);
                  return -1;
              }
+         } else {
+             m_slow_ae = slow_ae;
          }
      }
 
@@ -2597,6 +3788,13 @@ int SecCamera::setRecordingSize(int width, int height)
      return 0;
 }
 
+/* what the record node streams, the last size prepareRecord() set up */
+void SecCamera::getRecordingSize(int *width, int *height)
+{
+    *width  = m_record_prepared_width;
+    *height = m_record_prepared_height;
+}
+
 //======================================================================
 
 int SecCamera::setExifOrientationInfo(int orientationInfo)
@@ -2613,10 +3811,94 @@ int SecCamera::setExifOrientationInfo(int orientationInfo)
 }
 
 //======================================================================
+/* set a sensor control now, or queue it while a batch is open.  cache is
+ * where the setter keeps the value, it is written once the sensor took it.
+ * while queued the cache already holds the new value, so the other setters
+ * of the batch see it, and a failed commit puts the old one back.  a
+ * control queued twice keeps its first slot so the order the sensor sees
+ * is kept.
+ */
+int SecCamera::setCameraCtrl(unsigned int id, int value, int *cache)
+{
+    struct camera_ctrl *ctrl;
+
+    if (!m_ctrl_batching) {
+        if (fimc_v4l2_s_ctrl(m_cam_fd, id, value) < 0)
+            return -1;
+        if (cache)
+            *cache = value;
+        return 0;
+    }
+
+    for (int i = 0; i < m_ctrl_batch_count; i++) {
+        ctrl = &m_ctrl_batch[i];
+        if (ctrl->id == id) {
+            ctrl->value = value;
+            if (cache && !ctrl->cache) {
+                ctrl->cache = cache;
+                ctrl->old = *cache;
+            }
+            if (cache)
+                *cache = value;
+            return 0;
+        }
+    }
+
+    if (m_ctrl_batch_count == MAX_CTRL_BATCH) {
+        if (commitControlBatch() < 0)
+            return -1;
+        m_ctrl_batching = true;
+    }
+
+    ctrl = &m_ctrl_batch[m_ctrl_batch_count++];
+    ctrl->id = id;
+    ctrl->value = value;
+    ctrl->cache = cache;
+    ctrl->old = cache ? *cache : 0;
+    if (cache)
+        *cache = value;
+
+    return 0;
+}
+
+void SecCamera::beginControlBatch(void)
+{
+    m_ctrl_batching = true;
+    m_ctrl_batch_count = 0;
+}
+
+/* send the queued controls in order.  the sensor controls are all private
+ * ids, which VIDIOC_S_EXT_CTRLS doesn't take, so each goes by VIDIOC_S_CTRL:
+ * the batch saves the controls set again or set back within one call.  on
+ * a failure the caches of the control and the ones after it go back to
+ * what the sensor has.
+ */
+int SecCamera::commitControlBatch(void)
+{
+    int count = m_ctrl_batch_count;
+    int ret = 0;
+
+    m_ctrl_batching = false;
+    m_ctrl_batch_count = 0;
+
+    for (int i = 0; i < count; i++) {
+        struct camera_ctrl *ctrl = &m_ctrl_batch[i];
+
+        if (ret == 0 && fimc_v4l2_s_ctrl(m_cam_fd, ctrl->id, ctrl->value) < 0) {
+            ALOGE("ERR(%s):Fail on control %#x", __func__, ctrl->id);
+            ret = -1;
+        }
+        if (ret < 0 && ctrl->cache)
+            *ctrl->cache = ctrl->old;
+    }
+
+    return ret;
+}
+
 int SecCamera::setBatchReflection()
 {
     if (m_flag_camera_start) {
-        if (fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_BATCH_REFLECTION, 1) < 0) {
+        if (setCameraCtrl(V4L2_CID_CAMERA_BATCH_REFLECTION, 1) < 0) {
              ALOGE("ERR(%s):Fail on V4L2_CID_CAMERA_BATCH_REFLECTION", __func__);
              return -1;
         }
@@ -2693,12 +3975,13 @@ int SecCamera::setBlur(int blur_level)
     }
 
     if (m_blur_level != blur_level) {
-        m_blur_level = blur_level;
         if (m_flag_camera_start) {
-            if (fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_VGA_BLUR, blur_level) < 0) {
+            if (setCameraCtrl(V4L2_CID_CAMERA_VGA_BLUR, blur_level, &m_blur_level) < 0) {
                 ALOGE("ERR(%s):Fail on V4L2_CID_CAMERA_VGA_BLUR", __func__);
                 return -1;
             }
+        } else {
+            m_blur_level = blur_level;
         }
     }
     return 0;
@@ -2747,7 +4030,7 @@ const __u8* SecCamera::getCameraSensorName(void)
 {
     ALOGV("%s", __func__);
 
-    return fimc_v4l2_enuminput(m_cam_fd, getCameraId());
+    return (const __u8 *)s_sensor_name[getCameraId()];
 }
 
 #ifdef ENABLE_ESD_PREVIEW_CHECK
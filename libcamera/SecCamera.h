@@ -36,8 +36,12 @@
 
 #include <linux/videodev2.h>
 #include <videodev2_samsung.h>
+#include <sec_v4l2.h>
+#include <sec_latency.h>
 
 #include "JpegEncoder.h"
+#include "SecCameraStats.h"
+#include "SecCameraScaler.h"
 
 #include <utils/threads.h>
 
@@ -136,11 +140,23 @@ namespace android {
 
 #define CAMERA_DEV_NAME   "/dev/video0"
 #define CAMERA_DEV_NAME2  "/dev/video2"
+/* fimc1 post processor, shared with the hwcomposer */
+#define SCALER_DEV_NAME   "/dev/video1"
 
 
 #define BPP             2
 #define MIN(x, y)       (((x) < (y)) ? (x) : (y))
 #define MAX_BUFFERS     8
+/* enough for the sensor to keep capturing while a shot is delivered */
+#define MAX_BURST_BUFFERS   3
+/* sensor controls collected by one setParameters() call */
+#define MAX_CTRL_BATCH      32
+#define MAX_CAMERAS         2
+/* faces the back sensor reports per frame */
+#define MAX_DETECTED_FACES  5
+/* zoom ratios x100, one ZOOM_LEVEL_* apart, as in KEY_ZOOM_RATIOS */
+#define ZOOM_RATIO_MIN      100
+#define ZOOM_RATIO_STEP     25
 
 #define FIRST_AF_SEARCH_COUNT   600
 #define AF_PROGRESS             0x05
@@ -190,17 +206,58 @@ struct fimc_buffer {
     void    *start;
     size_t  length;
     int     index;
+    off_t   offset;
 };
 typedef struct fimc_buffer fimc_buffer;
 
+/* same layout as struct fimc_buf in s5p_fimc.h, which can't be included
+ * here because of the fimc_buffer clash
+ */
+struct fimc_user_buffer {
+    unsigned int    base[3];
+    size_t          length[3];
+};
+
+/* receives the jpeg encoder output.  getBuffer() is called once the
+ * stream size is known and returns where the stream is copied to, so
+ * the caller can place it straight into the memory it delivers.
+ */
+class SecJpegSink {
+public:
+    virtual ~SecJpegSink() { }
+    virtual unsigned char *getBuffer(unsigned int size) = 0;
+};
+
 class SecCamera {
 public:
 
+    /* who owns a preview buffer.  a frame returned by getPreview() is held
+     * by the HAL until every retainPreviewFrame() has been matched by a
+     * releasePreviewFrame(), only then it goes back to the driver
+     */
+    enum PREVIEW_BUF_STATE {
+        PREVIEW_BUF_IDLE,       /* ours, ready to be queued */
+        PREVIEW_BUF_DRIVER,     /* queued to fimc */
+        PREVIEW_BUF_HAL,        /* dequeued and in use */
+        PREVIEW_BUF_CLIENT,     /* handed to the window, zero copy only */
+    };
+
     enum CAMERA_ID {
         CAMERA_ID_BACK  = 0,
         CAMERA_ID_FRONT = 1,
     };
 
+    /* nodes reported ready by previewPoll() */
+    enum FRAME_NODE {
+        FRAME_PREVIEW   = 1 << 0,
+        FRAME_RECORD    = 1 << 1,
+    };
+
+    /* getPreview() got no frame in time, see recoverSensor() */
+    enum {
+        PREVIEW_TIMEOUT = -2,
+    };
+
     enum JPEG_QUALITY {
         JPEG_QUALITY_ECONOMY    = 0,
         JPEG_QUALITY_NORMAL     = 50,
@@ -280,14 +337,36 @@ public:
     int             startPreview(void);
     int             stopPreview(void);
 
+    int             prepareRecord(void);
     int             startRecord(void);
     int             stopRecord(void);
-    int             getRecordFrame(void);
+    bool            isRecordPrepared(void) const;
+    int             getRecordFrame(nsecs_t *timestamp = NULL);
     int             releaseRecordFrame(int index);
+    int             getRecordFramesInFlight(void);
+    /* the latency probe's stamps of the frames dequeued last, NULL with
+     * the probe off, see sec_latency.h
+     */
+    const struct sec_latency_stamp *getPreviewStamp(int index) const;
+    const struct sec_latency_stamp *getRecordStamp(int index) const;
     unsigned int    getRecPhyAddrY(int);
     unsigned int    getRecPhyAddrC(int);
-
-    int             getPreview(void);
+    int             getRecordFrameAddr(int index, unsigned char **y,
+                                       unsigned char **cbcr,
+                                       int *width, int *height);
+
+    int             getPreview(nsecs_t *timestamp = NULL);
+    int             retainPreviewFrame(int index);
+    int             releasePreviewFrame(int index);
+    int             detachPreviewFrame(int index);
+
+    int             setPreviewUserBufferCount(int count);
+    int             setPreviewUserBuffer(int index, unsigned int addr_y,
+                                         unsigned int addr_cb, unsigned int addr_cr);
+    bool            isPreviewZeroCopy(void) const;
+
+    void            resetPreviewStats(void);
+    void            dumpPreviewStats(String8& result) const;
     int             setPreviewSize(int width, int height, int pixel_format);
     void            getPreviewSize(int *width, int *height, int *frame_size);
     void            getPreviewMaxSize(int *width, int *height);
@@ -354,10 +433,15 @@ public:
 
     int             setZoom(int zoom_level);
     int             getZoom(void);
+    int             setZoomRatio(int ratio);
+    int             getZoomRatio(void);
+    static int      zoomLevelRatio(int zoom_level);
 
     int             setObjectTracking(int object_tracking);
     int             getObjectTracking(void);
     int             getObjectTrackingStatus(void);
+    int             getFrameFaces(struct v4l2_rect *faces, int max_faces) const;
+    int             getFrameTrackingStatus(void) const;
 
     int             setSmartAuto(int smart_auto);
     int             getSmartAuto(void);
@@ -390,10 +474,13 @@ public:
     int             setAntiBanding(int anti_banding);
     int             getPostview(void);
     int             setRecordingSize(int width, int height);
+    void            getRecordingSize(int *width, int *height);
     int             setGamma(int gamma);
     int             setSlowAE(int slow_ae);
     int             setExifOrientationInfo(int orientationInfo);
     int             setBatchReflection(void);
+    void            beginControlBatch(void);
+    int             commitControlBatch(void);
     int             beginSnapshot(bool burst = false);
     int             endSnapshot(void);
     int             setCameraSensorReset(void);
@@ -410,17 +497,31 @@ public:
     int             setDefultIMEI(int imei);
     int             getDefultIMEI(void);
     const __u8*     getCameraSensorName(void);
-    int             previewPoll(bool preview);
+    int             previewPoll(void);
+    int             recoverSensor(void);
 #ifdef ENABLE_ESD_PREVIEW_CHECK
     int             getCameraSensorESDStatus(void);
 #endif // ENABLE_ESD_PREVIEW_CHECK
 
     int             setFrameRate(int frame_rate);
+    int             getFrameRate(void);
     int             getJpeg(unsigned int *phyaddr, unsigned char** jpeg_buf,
-                            unsigned int *jpeg_size);
+                            unsigned int *jpeg_size, int *index = NULL);
+    int             releaseSnapshotFrame(int index);
     int             getJpeg(unsigned char *yuv_buf, unsigned char* jpeg_buf,
-                            unsigned int *jpeg_size);
-    int             getExif(unsigned char *pExifDst, unsigned char *pThumbSrc);
+                            unsigned int *jpeg_size, unsigned char *thumb_buf = NULL,
+                            int thumb_width = 0, int thumb_height = 0);
+    int             getJpeg(unsigned char *yuv_buf, SecJpegSink *sink,
+                            unsigned int *jpeg_size, unsigned char *thumb_buf = NULL,
+                            int thumb_width = 0, int thumb_height = 0);
+    int             getExif(unsigned char *pExifDst, unsigned char *pThumbSrc,
+                            int width = 0, int height = 0);
+    int             encodeJpeg(unsigned char *yuv_buf, int width, int height,
+                               int sampling, unsigned char *jpeg_buf,
+                               unsigned int *jpeg_size);
+    int             encodeJpeg(unsigned char *yuv_buf, int width, int height,
+                               int sampling, SecJpegSink *sink,
+                               unsigned int *jpeg_size);
 
     void            getPostViewConfig(int*, int*, int*);
     void            getThumbnailConfig(int *width, int *height, int *size);
@@ -477,11 +578,15 @@ private:
     int             m_camera_id;
 
     int             m_cam_fd;
+    /* the format each node took last, S_FMT with it again is skipped */
+    struct sec_v4l2_fmt_cache m_cam_fmt;
 
     int             m_cam_fd_temp;
     int             m_cam_fd2_temp;
 
     int             m_cam_fd2;
+    struct sec_v4l2_fmt_cache m_cam_fmt2;
+    struct sec_v4l2_gen m_cam_gen2;
     struct pollfd   m_events_c2;
     int             m_flag_record_start;
 
@@ -502,12 +607,22 @@ private:
     int             m_wdr;
     int             m_anti_shake;
     int             m_zoom_level;
+    /* the sensor zoom and the fimc crop on top of it, 0 wide if fimc can't crop */
+    int             m_zoom_ratio;
+    struct v4l2_rect m_crop_bounds;
+    int             applyZoomCrop(int fd);
     int             m_object_tracking;
     int             m_smart_auto;
     int             m_beauty_shot;
     int             m_vintage_mode;
     int             m_face_detect;
     int             m_object_tracking_start_stop;
+    /* recognition results read with the last preview frame */
+    bool            m_recognition_failed;
+    int             m_face_count;
+    struct v4l2_rect m_faces[MAX_DETECTED_FACES];
+    int             m_obj_tracking_status;
+    void            readFrameMetadata(void);
     int             m_recording_width;
     int             m_recording_height;
     long            m_gps_latitude;
@@ -525,6 +640,8 @@ private:
     int             m_caf_on_off;
     int             m_default_imei;
     int             m_camera_af_flag;
+    /* af result comes as a control event: -1 not tried yet, 0 no, 1 yes */
+    int             m_af_events;
 
     int             m_flag_camera_start;
 
@@ -541,15 +658,91 @@ private:
 
     exif_attribute_t mExifInfo;
 
-    fimc_buffer*    m_capture_bufs;
+    struct fimc_user_buffer m_preview_user_bufs[MAX_BUFFERS];
+    int             m_preview_user_bufs_count;
+    bool            m_preview_zero_copy;
+
+    int             m_preview_buf_state[MAX_BUFFERS];
+    int             m_preview_buf_refs[MAX_BUFFERS];
+
+    SecCameraHistogram m_poll_time;
+    SecCameraHistogram m_dqbuf_time;
+
+    SecCameraTimestampFilter m_preview_ts_filter;
+    SecCameraTimestampFilter m_record_ts_filter;
+
+    /* debug.sec.latency when the camera was opened */
+    bool            m_latency_probe;
+    uint32_t        m_preview_frame_id;
+    uint32_t        m_record_frame_id;
+    struct sec_latency_stamp m_preview_stamp[MAX_BUFFERS];
+    struct sec_latency_stamp m_record_stamp[MAX_BUFFERS];
+
+    /* snapshot buffers, mapped from beginSnapshot() to endSnapshot() */
+    fimc_buffer     m_capture_bufs[MAX_BURST_BUFFERS + 1];
     int             m_capture_bufs_size;
     bool            m_capture_burst;
+    /* spare snapshot buffer fimc1 scales thumbnails into, -1 if none */
+    int             m_capture_scale_index;
+    int             m_scaler_fd;
+    /* the overlay caches its fimc1 setup, it is told about every scale */
+    struct sec_v4l2_gen m_scaler_gen;
     struct pollfd   m_events_c;
 
+    /* a sensor control queued while batching, cache and old as in
+     * setCameraCtrl()
+     */
+    struct camera_ctrl {
+        unsigned int    id;
+        int             value;
+        int            *cache;
+        int             old;
+    };
+
+    /* while batching, sensor controls are queued and sent together by
+     * commitControlBatch()
+     */
+    bool            m_ctrl_batching;
+    int             m_ctrl_batch_count;
+    struct camera_ctrl m_ctrl_batch[MAX_CTRL_BATCH];
+
+    /* the sensor input is selected in the background, see initCamera() */
+    Mutex           m_sensor_init_lock;
+    pthread_t       m_sensor_init_thread;
+    bool            m_sensor_init_pending;
+    int             m_sensor_init_ret;
+
+    /* record node streaming ahead of startRecord(), see prepareRecord() */
+    int             m_flag_record_prepared;
+
+    /* frames seen by previewPoll() but not taken yet, FRAME_NODE bits */
+    int             m_frames_ready;
+    bool            m_poll_timeout;
+    int             m_record_prepared_width;
+    int             m_record_prepared_height;
+    /* cpu mappings of the record buffers, made on first use and dropped
+     * before the node requests its buffers again */
+    fimc_buffer     m_record_bufs[MAX_BUFFERS];
+    /* record buffers dequeued and not queued back yet, a bit per index.
+     * the encoder releases them from its own thread.
+     */
+    Mutex           m_record_lock;
+    unsigned int    m_record_inflight;
+
     inline int      m_frameSize(int format, int width, int height);
 
+    int             setCameraCtrl(unsigned int id, int value, int *cache = NULL);
+    static void     *sensorInitThread(void *arg);
+    int             waitSensorInit(void);
+    void            releaseCapturePool(void);
+    void            releaseRecordBufs(void);
+    int             scaleSnapshotFrame(int index, unsigned char *dst,
+                                       int width, int height);
+
     int             startStream();
     int             stopStream();
+    int             queuePreviewBuf(int index);
+    int             waitFrame(int node);
 
     void            setExifChangedAttribute();
     void            setExifFixedAttribute();
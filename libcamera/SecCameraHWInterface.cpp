@@ -19,14 +19,24 @@
 
 //#define LOG_NDEBUG 0
 #define LOG_TAG "CameraHardwareSec"
+#define ATRACE_TAG ATRACE_TAG_CAMERA
 #include <utils/Log.h>
 
 #include "SecCameraHWInterface.h"
 #include <utils/threads.h>
+#include <cutils/atomic.h>
+#include <cutils/properties.h>
 #include <fcntl.h>
 #include <sys/mman.h>
 
 #include <MetadataBufferType.h>
+#include <hal_public.h>
+#include <color_space_convertor.h>
+#include <sec_trace.h>
+
+#ifndef GRALLOC_USAGE_PHYS_CONTIG
+#define GRALLOC_USAGE_PHYS_CONTIG GRALLOC_USAGE_PRIVATE_1
+#endif
 
 #define BACK_CAMERA_AUTO_FOCUS_DISTANCES_STR       "0.10,1.20,Infinity"
 #define BACK_CAMERA_MACRO_FOCUS_DISTANCES_STR      "0.10,0.20,Infinity"
@@ -53,6 +63,12 @@ struct addrs {
     unsigned int addr_cbcr;
     unsigned int buf_index;
     unsigned int reserved;
+    // lets an encoder set up for another size refuse the frame
+    unsigned int width;
+    unsigned int height;
+    // the stamp at SEC_LATENCY_METADATA_OFFSET, zeroed with the probe off
+    unsigned int pad;
+    struct sec_latency_stamp stamp;
 };
 
 struct addrs_cap {
@@ -64,36 +80,116 @@ struct addrs_cap {
 static const int INITIAL_SKIP_FRAME = 3;
 static const int EFFECT_SKIP_FRAME = 1;
 
+/* preview frames waiting for the callback thread, the oldest one is
+ * dropped when the client falls behind unless this is turned off
+ */
+static const int DEFAULT_CALLBACK_QUEUE_DEPTH = 2;
+
 gralloc_module_t const* CameraHardwareSec::mGrallocHal = NULL;
 
+const char *CameraHardwareSec::kPreviewStageNames[STAGE_MAX] = {
+    "window dequeue",
+    "gralloc lock",
+    "copy",
+    "callback copy",
+    "callback",
+    "window enqueue",
+    "frame",
+};
+
+const char *CameraHardwareSec::kLatencyStageNames[LATENCY_MAX] = {
+    "capture to dequeue",
+    "capture to preview posted",
+    "capture to record posted",
+};
+
+/* time to first preview frame over all opens of either camera */
+static Mutex gFirstFrameStatsLock;
+static SecCameraHistogram gFirstFrameStats("open to first frame");
+
 CameraHardwareSec::CameraHardwareSec(int cameraId)
         :
           mCaptureMode(SNAPSHOT),
           mCaptureInProgress(false),
           mCaptureCancel(false),
+          mZslCapture(false),
+          mVideoSnapshot(false),
+          mVideoSnapshotPending(false),
+          mVideoSnapshotStatus(NO_ERROR),
+          mVideoSnapshotHeap(NULL),
+          mVideoSnapshotWidth(0),
+          mVideoSnapshotHeight(0),
           mFaceDetectStarted(false),
+          mFaceMetadataHeap(NULL),
+          mLastFaceCount(0),
           mPreviewPaused(false),
+          mBurstHead(0),
+          mBurstQueued(0),
+          mBurstInFlight(0),
+          mBurstDone(true),
+          mExifHeap(NULL),
           mParameters(),
+          mParametersSynced(false),
+          mFlatZoomLevel(0),
+          mFlatParametersValid(false),
           mPreviewMemory(0),
+          mPreviewCbHeap(0),
+          mPreviewHeapWidth(0),
+          mPreviewHeapHeight(0),
+          mPreviewHeapFrameSize(0),
           mRawHeap(0),
           mRecordHeap(0),
+          mVideoConsumers(1),
           mSecCamera(NULL),
           mCameraSensorName(NULL),
           mSkipFrame(0),
           mWindow(NULL),
+          mPreviewZeroCopy(false),
+          mPreviewBufWindow(NULL),
+          mPreviewBufCount(0),
+          mWindowBufferCount(0),
+          mWindowExtraBuffers(0),
           mNotifyCb(0),
           mDataCb(0),
           mDataCbTimestamp(0),
           mCallbackCookie(0),
           mMsgEnabled(0),
-          mRecordRunning(false),
+          mRecordRunning(0),
+          mRecordingHint(false),
           mPostViewWidth(0),
           mPostViewHeight(0),
-          mPostViewSize(0)
+          mPostViewSize(0),
+          mZslEnabled(false),
+          mZslShutterTime(0),
+          mZslHeap(NULL),
+          mZslWidth(0),
+          mZslHeight(0),
+          mZslNext(0),
+          mZslPinned(-1),
+          mSmoothZoom(false),
+          mSmoothZoomStop(false),
+          mZoomTarget(ZOOM_RATIO_MIN),
+          mZoomLevel(0)
 {
     int ret;
 
     ALOGV("%s :", __func__);
+    memset(mPreviewBufHandles, 0, sizeof(mPreviewBufHandles));
+    memset(mZslTimestamp, 0, sizeof(mZslTimestamp));
+    memset((void *)mRecordFrameRefs, 0, sizeof(mRecordFrameRefs));
+    for (int i = 0; i < MAX_BURST_BUFFERS; i++) {
+        mCaptureHeaps[i].jpegHeap = NULL;
+        mCaptureHeaps[i].jpegSize = 0;
+        mCaptureHeaps[i].postviewSize = 0;
+        mCaptureHeaps[i].thumbnailSize = 0;
+        mCaptureHeaps[i].busy = false;
+    }
+    for (int i = 0; i < STAGE_MAX; i++)
+        mPreviewStats[i].setName(kPreviewStageNames[i]);
+    for (int i = 0; i < LATENCY_MAX; i++)
+        mLatencyStats[i].setName(kLatencyStageNames[i]);
+    mOpenTime = systemTime();
+    mFirstFrameLatency = 0;
     mSecCamera = SecCamera::createInstance();
     if (mSecCamera == NULL) {
         ALOGE("ERR(%s):Fail on mSecCamera object creation", __func__);
@@ -125,7 +221,34 @@ status_t CameraHardwareSec::init()
          mPostViewWidth,mPostViewHeight,mPostViewSize);
     
     initDefaultParameters(mSecCamera->getCameraId());
-    
+
+    char value[PROPERTY_VALUE_MAX];
+    property_get("persist.camera.cb_queue_depth", value, "");
+    mCallbackQueueDepth = atoi(value);
+    if (mCallbackQueueDepth < 1 || kCallbackQueueMax < mCallbackQueueDepth)
+        mCallbackQueueDepth = DEFAULT_CALLBACK_QUEUE_DEPTH;
+    property_get("persist.camera.cb_drop_oldest", value, "1");
+    mCallbackDropOldest = atoi(value) != 0;
+    ALOGV("%s: callback queue depth %d drop %s", __func__, mCallbackQueueDepth,
+         mCallbackDropOldest ? "oldest" : "newest");
+    property_get("persist.camera.fps_governor", value, "1");
+    mGovernorEnabled = atoi(value) != 0;
+    mGovernorChanges = 0;
+    resetFpsGovernor();
+
+    mCallbackRead = 0;
+    mCallbackWrite = 0;
+    mCallbackDrops = 0;
+    memset((void *)mCallbackSlotBusy, 0, sizeof(mCallbackSlotBusy));
+    sem_init(&mCallbackSem, 0, 0);
+    mExitCallbackThread = false;
+    mCallbackDelivering = false;
+    mCallbackWidth = 0;
+    mCallbackHeight = 0;
+    mCallbackNV21 = true;
+    mCallbackInterval = 0;
+    mCallbackLast = 0;
+
     mExitAutoFocusThread = false;
     mExitPreviewThread = false;
     /* whether the PreviewThread is active in preview or stopped.  we
@@ -133,25 +256,25 @@ status_t CameraHardwareSec::init()
      */
     mPreviewRunning = false;
     mPreviewThread = new PreviewThread(this);
+    mAutoFocusRequestTime = 0;
+    mAutoFocusStats.setName("autofocus");
     mAutoFocusThread = new AutoFocusThread(this);
+    mExitWatchdogThread = false;
+    mWatchdogState = WATCHDOG_IDLE;
+    mRecoveryCount = 0;
+    mRecoveryFailures = 0;
+    mRecoveryStats.setName("sensor recovery");
+    mWatchdogThread = new WatchdogThread(this);
     mPictureThread = new PictureThread(this);
-    
+    mBurstThread = new BurstThread(this);
+    mCallbackThread = new CallbackThread(this);
+
     return NO_ERROR;
 }
 
-void CameraHardwareSec::initDefaultParameters(int cameraId)
+void CameraHardwareSec::buildDefaultParameters(int cameraId, CameraParameters& p,
+                                               CameraParameters& ip)
 {
-    if (mSecCamera == NULL) {
-        ALOGE("ERR(%s):mSecCamera object is NULL", __func__);
-        return;
-    }
-
-    SecCameraParameters p;
-    SecCameraParameters ip;
-
-    mCameraSensorName = mSecCamera->getCameraSensorName();
-    ALOGV("CameraSensorName: %s", mCameraSensorName);
-
     int preview_max_width   = 0;
     int preview_max_height  = 0;
     int snapshot_max_width  = 0;
@@ -169,8 +292,6 @@ void CameraHardwareSec::initDefaultParameters(int cameraId)
               "640x480");
     }
 
-    p.getSupportedPreviewSizes(mSupportedPreviewSizes);
-
     // If these fail, then we are using an invalid cameraId and we'll leave the
     // sizes at zero to catch the error.
     mSecCamera->getPreviewMaxSize(&preview_max_width,
@@ -297,11 +418,12 @@ void CameraHardwareSec::initDefaultParameters(int cameraId)
         p.set(SecCameraParameters::KEY_MAX_ZOOM, "12");
         p.set(SecCameraParameters::KEY_ZOOM_RATIOS, "100,125,150,175,200,225,250,275,300,325,350,375,400");
         p.set(SecCameraParameters::KEY_ZOOM_SUPPORTED, SecCameraParameters::TRUE);
+        p.set(SecCameraParameters::KEY_SMOOTH_ZOOM_SUPPORTED, SecCameraParameters::TRUE);
 
         /* signal that we have face detection in back camera
          * TODO: findout how much faces ce147 can detect
          */
-        p.set(SecCameraParameters::KEY_MAX_NUM_DETECTED_FACES_HW, 5);
+        p.set(SecCameraParameters::KEY_MAX_NUM_DETECTED_FACES_HW, MAX_DETECTED_FACES);
         p.set(SecCameraParameters::KEY_MAX_NUM_DETECTED_FACES_SW, 0);
 
         /* we have two ranges, 4-30fps for night mode and
@@ -324,6 +446,21 @@ void CameraHardwareSec::initDefaultParameters(int cameraId)
         p.set(SecCameraParameters::KEY_FOCAL_LENGTH, "0.9");
     }
 
+    // pictures while recording come from the record node, see storeVideoSnapshotFrame()
+    p.set(SecCameraParameters::KEY_VIDEO_SNAPSHOT_SUPPORTED, SecCameraParameters::TRUE);
+
+    // zero shutter lag captures from the preview frames, see storeZslFrame()
+    p.set(SecCameraParameters::KEY_ZSL_SUPPORTED, SecCameraParameters::TRUE);
+    p.set(SecCameraParameters::KEY_ZSL, SecCameraParameters::FALSE);
+
+    // smaller preview callbacks for vision clients, the display keeps its size
+    p.set(SecCameraParameters::KEY_SUPPORTED_PREVIEW_CALLBACK_SIZES,
+          "640x480,352x288,320x240,176x144");
+
+    // one record stream can feed a local recording and a live stream
+    p.set(SecCameraParameters::KEY_VIDEO_CONSUMERS, 1);
+    p.set(SecCameraParameters::KEY_MAX_VIDEO_CONSUMERS, kMaxVideoConsumers);
+
     parameterString = SecCameraParameters::WHITE_BALANCE_AUTO;
     parameterString.append(",");
     parameterString.append(SecCameraParameters::WHITE_BALANCE_INCANDESCENT);
@@ -371,9 +508,51 @@ void CameraHardwareSec::initDefaultParameters(int cameraId)
     p.set(SecCameraParameters::KEY_MAX_CONTRAST, "2");
     p.set(SecCameraParameters::KEY_MIN_CONTRAST, "-2");
     p.set(SecCameraParameters::KEY_CONTRAST_STEP, "0.5");
+}
+
+/* the defaults only depend on the camera id, so they are built on the
+ * first open of each camera and copied on later ones
+ */
+static Mutex gDefaultParametersLock;
+static bool gDefaultParametersValid[2];
+static CameraParameters gDefaultParameters[2];
+static CameraParameters gDefaultInternalParameters[2];
+
+void CameraHardwareSec::initDefaultParameters(int cameraId)
+{
+    if (mSecCamera == NULL) {
+        ALOGE("ERR(%s):mSecCamera object is NULL", __func__);
+        return;
+    }
+
+    CameraParameters p;
+    CameraParameters ip;
+
+    mCameraSensorName = mSecCamera->getCameraSensorName();
+    ALOGV("CameraSensorName: %s", mCameraSensorName);
+
+    if (cameraId < 0 || 2 <= cameraId) {
+        buildDefaultParameters(cameraId, p, ip);
+    } else {
+        Mutex::Autolock lock(gDefaultParametersLock);
+        if (!gDefaultParametersValid[cameraId]) {
+            buildDefaultParameters(cameraId, gDefaultParameters[cameraId],
+                                   gDefaultInternalParameters[cameraId]);
+            gDefaultParametersValid[cameraId] = true;
+        }
+        p = gDefaultParameters[cameraId];
+        ip = gDefaultInternalParameters[cameraId];
+    }
+
+    p.getSupportedPreviewSizes(mSupportedPreviewSizes);
 
     mParameters = p;
     mInternalParameters = ip;
+    /* the sensor hasn't seen any of these yet */
+    mParametersSynced = false;
+    mZoomLock.lock();
+    mFlatParametersValid = false;
+    mZoomLock.unlock();
 
     /* make sure mSecCamera has all the settings we do.  applications
      * aren't required to call setParameters themselves (only if they
@@ -401,39 +580,29 @@ CameraHardwareSec::~CameraHardwareSec()
 // here I don't know what I am doing, so now debugging
 status_t CameraHardwareSec::setPreviewWindow(struct preview_stream_ops *window)
 {
-    int min_bufs;
-
     ALOGV("%s: mWindow %p", __func__, mWindow);
 
     Mutex::Autolock lock(mPreviewLock);
 
+    /* zero copy preview holds buffers of the old window, so it has to
+     * stop before the window goes away
+     */
+    if (mPreviewRunning && !mPreviewStartDeferred && (window || mPreviewZeroCopy)) {
+        ALOGI("stop preview (window change)");
+        stopPreview_l();
+    }
+
     mWindow = window;
     if (!window) {
         ALOGE("preview window is NULL!");
         return OK;
     }
 
-    if (mPreviewRunning && !mPreviewStartDeferred) {
-        ALOGI("stop preview (window change)");
-        stopPreview_l();
-    }
-
-    if (window->get_min_undequeued_buffer_count(window, &min_bufs)) {
-        ALOGE("%s: could not retrieve min undequeued buffer count", __func__);
+    /* a new window starts from what the last one needed */
+    mWindowBufferCount = 0;
+    if (setWindowBufferCount_l(false) != NO_ERROR)
         return INVALID_OPERATION;
-    }
 
-    if (min_bufs >= kBufferCount) {
-        ALOGE("%s: min undequeued buffer count %d is too high (expecting at most %d)", __func__,
-             min_bufs, kBufferCount - 1);
-    }
-    
-    ALOGV("%s: setting buffer count to %d", __func__, kBufferCount);
-    if (window->set_buffer_count(window, kBufferCount)) {
-        ALOGE("%s: could not set buffer count", __func__);
-        return INVALID_OPERATION;
-    }
-    
     int preview_width;
     int preview_height;
     mParameters.getPreviewSize(&preview_width, &preview_height);
@@ -442,9 +611,17 @@ status_t CameraHardwareSec::setPreviewWindow(struct preview_stream_ops *window)
     const char *str_preview_format = mParameters.getPreviewFormat();
     ALOGV("%s: preview format %s", __func__, str_preview_format);
     
-    if (window->set_usage(window, GRALLOC_USAGE_SW_WRITE_OFTEN)) {
-        ALOGE("%s: could not set usage on gralloc buffer", __func__);
-        return INVALID_OPERATION;
+    /* ask for physically contiguous buffers so fimc can capture straight
+     * into them, the copy in previewThread() is used if we don't get them
+     */
+    if (window->set_usage(window, GRALLOC_USAGE_SW_WRITE_OFTEN |
+                                  GRALLOC_USAGE_SW_READ_OFTEN |
+                                  GRALLOC_USAGE_PHYS_CONTIG)) {
+        ALOGW("%s: could not set physically contiguous usage", __func__);
+        if (window->set_usage(window, GRALLOC_USAGE_SW_WRITE_OFTEN)) {
+            ALOGE("%s: could not set usage on gralloc buffer", __func__);
+            return INVALID_OPERATION;
+        }
     }
     
     if (window->set_buffers_geometry(window,
@@ -488,6 +665,7 @@ void CameraHardwareSec::setCallbacks(camera_notify_callback notify_cb,
                                      camera_request_memory get_memory,
                                      void *user)
 {
+    Mutex::Autolock lock(mCallbackLock);
     mNotifyCb = notify_cb;
     mDataCb = data_cb;
     mDataCbTimestamp = data_cb_timestamp;
@@ -519,11 +697,13 @@ bool CameraHardwareSec::msgTypeEnabled(int32_t msgType)
 // ---------------------------------------------------------------------------
 void CameraHardwareSec::setSkipFrame(int frame)
 {
-    Mutex::Autolock lock(mSkipFrameLock);
-    if (frame < mSkipFrame)
-        return;
+    int32_t skip;
 
-    mSkipFrame = frame;
+    do {
+        skip = android_atomic_acquire_load(&mSkipFrame);
+        if (frame < skip)
+            return;
+    } while (android_atomic_release_cas(skip, frame, &mSkipFrame) != 0);
 }
 
 int CameraHardwareSec::previewThreadWrapper()
@@ -533,11 +713,15 @@ int CameraHardwareSec::previewThreadWrapper()
         mPreviewLock.lock();
         while (!mPreviewRunning || mPreviewPaused || mExitPreviewThread) {
             ALOGV("%s: calling mSecCamera->stopPreview() and waiting", __func__);
+            mSensorLock.lock();
             if(mPreviewPaused) {
                 mSecCamera->pausePreview();
             } else {
                 mSecCamera->stopPreview();
+                freePreviewBuffers_l();
+                flushCallbackFrames();
             }
+            mSensorLock.unlock();
             /* signal that we're stopping */
             mPreviewStoppedCondition.signal();
             if(mExitPreviewThread) {
@@ -555,124 +739,290 @@ int CameraHardwareSec::previewThreadWrapper()
 }
 
 int CameraHardwareSec::previewThread()
+{
+    /* the watchdog owns the sensor while it restarts it, frames resume
+     * once it is done
+     */
+    mWatchdogLock.lock();
+    if (mWatchdogState != WATCHDOG_IDLE) {
+        mWatchdogCondition.waitRelative(mWatchdogLock, milliseconds(100));
+        mWatchdogLock.unlock();
+        return NO_ERROR;
+    }
+    mWatchdogLock.unlock();
+
+    SEC_TRACE_SCOPE("camera:preview");
+
+    /* one wait covers both nodes and each is served when it has a frame,
+     * so a late record frame never holds up preview and the other way round
+     */
+    SEC_TRACE_BEGIN("camera:poll");
+    int ready = mSecCamera->previewPoll();
+    SEC_TRACE_END();
+    if (ready < 0) {
+        ALOGE("ERR(%s):Fail on SecCamera->previewPoll()", __func__);
+        return UNKNOWN_ERROR;
+    }
+
+    int ret = NO_ERROR;
+    // on a timeout getPreview() resets the sensor
+    if (ready == 0 || (ready & SecCamera::FRAME_PREVIEW)) {
+        ret = previewFrame();
+        stepSmoothZoom();
+    }
+    if (ready & SecCamera::FRAME_RECORD) {
+        int record_ret = recordFrame();
+        if (ret == NO_ERROR)
+            ret = record_ret;
+    }
+
+    return ret;
+}
+
+int CameraHardwareSec::previewFrame()
 {
     int             index;
     nsecs_t         timestamp;
     unsigned int    phyYAddr;
     unsigned int    phyCAddr;
-    struct addrs*   addrs;
     int             width, height, frame_size, offset;
 
-    index = mSecCamera->getPreview();
+    index = mSecCamera->getPreview(&timestamp);
+    if (index == SecCamera::PREVIEW_TIMEOUT) {
+        requestSensorRecovery();
+        return NO_ERROR;
+    }
     if (index < 0) {
         ALOGE("ERR(%s):Fail on SecCamera->getPreview()", __func__);
         return UNKNOWN_ERROR;
     }
-    mSkipFrameLock.lock();
-    if (mSkipFrame > 0) {
-        mSkipFrame--;
-        mSkipFrameLock.unlock();
+    SEC_TRACE_INT("camera:preview_index", index);
+
+    const struct sec_latency_stamp *stamp = mSecCamera->getPreviewStamp(index);
+    bool posted = false;
+    if (stamp)
+        mLatencyStats[LATENCY_DEQUEUE].add(sec_latency_now() - stamp->capture_ns);
+
+    /* setSkipFrame() may raise the count meanwhile, so only take one
+     * frame off when nobody changed it under us
+     */
+    int32_t skip;
+    while ((skip = android_atomic_acquire_load(&mSkipFrame)) > 0) {
+        if (android_atomic_release_cas(skip, skip - 1, &mSkipFrame) == 0) {
+            mSecCamera->releasePreviewFrame(index);
+            return NO_ERROR;
+        }
+    }
+
+    /* dropped on purpose by the governor, before anyone spends time on it */
+    if (mFrameDecimation > 1 && ++mDecimationCount % mFrameDecimation) {
+        mSecCamera->releasePreviewFrame(index);
         return NO_ERROR;
     }
-    mSkipFrameLock.unlock();
 
-    timestamp = systemTime(SYSTEM_TIME_MONOTONIC);
+    /* only this thread writes it, dump() reads it under the stats lock */
+    if (mFirstFrameLatency == 0) {
+        nsecs_t latency = systemTime() - mOpenTime;
+        ALOGI("%s: first preview frame %lld ms after open", __func__,
+             ns2ms(latency));
+        Mutex::Autolock lock(gFirstFrameStatsLock);
+        mFirstFrameLatency = latency;
+        gFirstFrameStats.add(latency);
+    }
+
+    nsecs_t frame_start = systemTime(SYSTEM_TIME_MONOTONIC);
+    nsecs_t start;
+
+    int cb_slot = -1;
+    if ((mMsgEnabled & CAMERA_MSG_PREVIEW_FRAME) && callbackDue(timestamp))
+        cb_slot = reserveCallbackSlot();
 
     phyYAddr = mSecCamera->getPhyAddrY(index);
     phyCAddr = mSecCamera->getPhyAddrC(index);
     if (phyYAddr == 0xffffffff || phyCAddr == 0xffffffff) {
         ALOGE("ERR(%s):Fail on SecCamera getPhyAddr Y addr = %0x C addr = %0x",
              __func__, phyYAddr, phyCAddr);
+        mSecCamera->releasePreviewFrame(index);
         return UNKNOWN_ERROR;
     }
 
     mSecCamera->getPreviewSize(&width, &height, &frame_size);
     offset = frame_size * index;
 
-    // draw new frame into window
-    if(mWindow && mGrallocHal) {
+    if (mFaceDetectStarted && (mMsgEnabled & CAMERA_MSG_PREVIEW_METADATA))
+        sendFaceMetadata(width, height);
+
+    if (mPreviewZeroCopy) {
+        buffer_handle_t *buf_handle = mPreviewBufHandles[index];
+        int ret;
+
+        // fimc wrote the frame into the window buffer, only the client
+        // callback and the zero shutter lag ring need a copy, and the
+        // latency probe its stamp
+        if (cb_slot >= 0 || mZslEnabled || stamp) {
+            void *vaddr;
+            start = systemTime();
+            ret = mGrallocHal->lock(mGrallocHal,
+                                    *buf_handle,
+                                    GRALLOC_USAGE_SW_READ_OFTEN |
+                                    (stamp ? GRALLOC_USAGE_SW_WRITE_RARELY : 0),
+                                    0, 0, width, height, &vaddr);
+            mPreviewStats[STAGE_GRALLOC_LOCK].add(systemTime() - start);
+            if (!ret) {
+                const int y_size = width * height;
+                char *y = (char *)vaddr;
+
+                // YV12 keeps V before U
+                if (cb_slot >= 0) {
+                    start = systemTime();
+                    fillPreviewCallbackFrame(cb_slot, y, y + y_size + y_size / 4,
+                                             y + y_size, width, height);
+                    mPreviewStats[STAGE_CALLBACK_COPY].add(systemTime() - start);
+                }
+                if (mZslEnabled)
+                    storeZslFrame(y, y + y_size + y_size / 4, y + y_size,
+                                  width, height, timestamp);
+                // after the copies, only the display sees it
+                if (stamp)
+                    sec_latency_stamp_write(y, stamp);
+
+                mGrallocHal->unlock(mGrallocHal, *buf_handle);
+            } else {
+                ALOGE("%s: Could not obtain gralloc buffer", __func__);
+            }
+        }
+
+        mPreviewBufHandles[index] = NULL;
+        mSecCamera->detachPreviewFrame(index);
+        start = systemTime();
+        ret = mPreviewBufWindow->enqueue_buffer(mPreviewBufWindow, buf_handle);
+        mPreviewStats[STAGE_WINDOW_ENQUEUE].add(systemTime() - start);
+        if (ret != 0) {
+            ALOGE("%s: Could not enqueue gralloc buffer: %i!", __func__, ret);
+        } else {
+            posted = true;
+        }
+
+        // a slot the window had no buffer for stays empty, fimc would run
+        // a buffer short for good, so every frame tries them all again
+        for (int i = 0; i < mPreviewBufCount; i++) {
+            if (mPreviewBufHandles[i] == NULL && queuePreviewBuffer(i) != NO_ERROR) {
+                if (i == index)
+                    ALOGE("ERR(%s):Fail on queuePreviewBuffer(%d)", __func__, i);
+                break;
+            }
+        }
+    } else if(mWindow && mGrallocHal) {
+        // draw new frame into window
         buffer_handle_t *buf_handle;
         int stride;
         int ret;
 
-        if (0 != (ret = mWindow->dequeue_buffer(mWindow, &buf_handle, &stride))) {
+        start = systemTime();
+        ret = mWindow->dequeue_buffer(mWindow, &buf_handle, &stride);
+        start = systemTime() - start;
+        mPreviewStats[STAGE_WINDOW_DEQUEUE].add(start);
+        mGovernorDequeueTime += start;
+        if (ret != 0) {
             ALOGE("%s: Could not dequeue gralloc buffer: %i!", __func__, ret);
         } else {
             void *vaddr;
-            if (!mGrallocHal->lock(mGrallocHal,
-                                   *buf_handle,
-                                   GRALLOC_USAGE_SW_WRITE_OFTEN,
-                                   0, 0, width, height, &vaddr)) {
+            start = systemTime();
+            ret = mGrallocHal->lock(mGrallocHal,
+                                    *buf_handle,
+                                    GRALLOC_USAGE_SW_WRITE_OFTEN,
+                                    0, 0, width, height, &vaddr);
+            mPreviewStats[STAGE_GRALLOC_LOCK].add(systemTime() - start);
+            if (!ret) {
                 char *frame = ((char *)mPreviewMemory->data) + offset;
+                char *y = (char *)vaddr;
+                const int uv_stride = ALIGN(stride / 2, 16);
 
-                // the code below assumes YUV, not RGB
-                {
-                    int h;
-                    char *src = frame;
-                    char *ptr = (char *)vaddr;
-                
-                    // Copy the Y plane, while observing the stride
-                    for (h = 0; h < height; h++) {
-                        memcpy(ptr, src, width);
-                        ptr += stride;
-                        src += width;
-                    }
-                
-                    {
-                        // U
-                        char *v = ptr;
-                        ptr += stride * height / 4;
-                        for (h = 0; h < height / 2; h++) {
-                            memcpy(ptr, src, width / 2);
-                            ptr += stride / 2;
-                            src += width / 2;
-                        }
-                        // V
-                        ptr = v;
-                        for (h = 0; h < height / 2; h++) {
-                            memcpy(ptr, src, width / 2);
-                            ptr += stride / 2;
-                            src += width / 2;
-                        }
-                    }
-                }
+                // YV12 keeps the V plane before the U plane
+                char *v = y + stride * height;
+                char *u = v + uv_stride * height / 2;
+
+                start = systemTime();
+                csc_linear_to_strided(y, u, v, frame, width, height, stride, uv_stride);
+                mPreviewStats[STAGE_COPY].add(systemTime() - start);
+                if (stamp)
+                    sec_latency_stamp_write(y, stamp);
 
                 mGrallocHal->unlock(mGrallocHal, *buf_handle);
             } else {
                 ALOGE("%s: Could not obtain gralloc buffer", __func__);
             }
 
-            if (0 != (ret = mWindow->enqueue_buffer(mWindow, buf_handle))) {
+            start = systemTime();
+            ret = mWindow->enqueue_buffer(mWindow, buf_handle);
+            mPreviewStats[STAGE_WINDOW_ENQUEUE].add(systemTime() - start);
+            if (ret != 0) {
                 ALOGE("%s: Could not enqueue gralloc buffer: %i!", __func__, ret);
+            } else {
+                posted = true;
             }
         }
     }
 
-    // Notify the client of a new frame.
-    if (mMsgEnabled & CAMERA_MSG_PREVIEW_FRAME) {
-        const char * preview_format = mParameters.getPreviewFormat();
-        if (!strcmp(preview_format, CameraParameters::PIXEL_FORMAT_YUV420SP)) {
-            // Color conversion from YUV420 to NV21
-            char *vu = ((char *)mPreviewMemory->data) + offset + width * height;
-            const int uv_size = (width * height) >> 1;
-            char saved_uv[uv_size];
-            memcpy(saved_uv, vu, uv_size);
-            char *u = saved_uv;
-            char *v = u + (uv_size >> 1);
-
-            int h = 0;
-            while (h < width * height / 4) {
-                *vu++ = *v++;
-                *vu++ = *u++;
-                ++h;
-            }
+    if (stamp && posted)
+        mLatencyStats[LATENCY_PREVIEW].add(sec_latency_now() - stamp->capture_ns);
+
+    // Notify the client of a new frame, the callback thread delivers it
+    // so a slow client can't hold up the capture
+    if (cb_slot >= 0) {
+        if (!mPreviewZeroCopy) {
+            const int y_size = width * height;
+            char *y = ((char *)mPreviewMemory->data) + offset;
+
+            start = systemTime();
+            fillPreviewCallbackFrame(cb_slot, y, y + y_size,
+                                     y + y_size + y_size / 4, width, height);
+            mPreviewStats[STAGE_CALLBACK_COPY].add(systemTime() - start);
         }
-        mDataCb(CAMERA_MSG_PREVIEW_FRAME, mPreviewMemory, index, NULL, mCallbackCookie);
+        queueCallbackFrame(cb_slot);
     }
 
-    Mutex::Autolock lock(mRecordLock);
-    if (mRecordRunning == true) {
-        index = mSecCamera->getRecordFrame();
+    if (mZslEnabled && !mPreviewZeroCopy) {
+        const int y_size = width * height;
+        char *y = ((char *)mPreviewMemory->data) + offset;
+
+        storeZslFrame(y, y + y_size, y + y_size + y_size / 4,
+                      width, height, timestamp);
+    }
+
+    // everything is copied out, fimc can have the buffer back
+    if (!mPreviewZeroCopy)
+        mSecCamera->releasePreviewFrame(index);
+
+    nsecs_t frame_time = systemTime(SYSTEM_TIME_MONOTONIC) - frame_start;
+    mPreviewStats[STAGE_FRAME].add(frame_time);
+    if (mGovernorEnabled)
+        updateFpsGovernor(frame_time);
+
+    return NO_ERROR;
+}
+
+int CameraHardwareSec::recordFrame()
+{
+    int             index;
+    nsecs_t         timestamp;
+    unsigned int    phyYAddr;
+    unsigned int    phyCAddr;
+    int             width, height;
+    struct addrs*   addrs;
+    const struct sec_latency_stamp *stamp = NULL;
+
+    if (!android_atomic_acquire_load(&mRecordRunning))
+        return NO_ERROR;
+
+    {
+        /* stopRecording() turns the node off under this lock, so recheck */
+        Mutex::Autolock lock(mRecordLock);
+        if (!mRecordRunning)
+            return NO_ERROR;
+
+        SEC_TRACE_SCOPE("camera:record");
+        index = mSecCamera->getRecordFrame(&timestamp);
         if (index < 0) {
             ALOGE("ERR(%s):Fail on SecCamera->getRecord()", __func__);
             return UNKNOWN_ERROR;
@@ -686,21 +1036,545 @@ int CameraHardwareSec::previewThread()
         }
 
         addrs = (struct addrs *)mRecordHeap->data;
+        mSecCamera->getRecordingSize(&width, &height);
 
         addrs[index].type   = kMetadataBufferTypeCameraSource;
         addrs[index].addr_y = phyYAddr;
         addrs[index].addr_cbcr = phyCAddr;
         addrs[index].buf_index = index;
+        addrs[index].width = width;
+        addrs[index].height = height;
+        addrs[index].pad = 0;
+        stamp = mSecCamera->getRecordStamp(index);
+        if (stamp)
+            addrs[index].stamp = *stamp;
+        else
+            memset(&addrs[index].stamp, 0, sizeof(addrs[index].stamp));
+        SEC_TRACE_INT("camera:record_index", index);
+        SEC_TRACE_INT("camera:record_inflight", mSecCamera->getRecordFramesInFlight());
+    }
+
+    if (mVideoSnapshotPending)
+        storeVideoSnapshotFrame(index);
 
-        // Notify the client of a new frame.
-        if (mMsgEnabled & CAMERA_MSG_VIDEO_FRAME) {
-            mDataCbTimestamp(timestamp, CAMERA_MSG_VIDEO_FRAME, mRecordHeap,
-                             index, mCallbackCookie);
+    /* a frame that races with stopRecording() comes back through
+     * releaseRecordingFrame() after the node stopped, which
+     * SecCamera::releaseRecordFrame() ignores.
+     */
+    if (mMsgEnabled & CAMERA_MSG_VIDEO_FRAME) {
+        /* each encoder reads the frame in place and gives it back once */
+        android_atomic_release_store(mVideoConsumers, &mRecordFrameRefs[index]);
+        mDataCbTimestamp(timestamp, CAMERA_MSG_VIDEO_FRAME, mRecordHeap,
+                         index, mCallbackCookie);
+        if (stamp)
+            mLatencyStats[LATENCY_RECORD].add(sec_latency_now() - stamp->capture_ns);
+    } else {
+        mSecCamera->releaseRecordFrame(index);
+    }
+    return NO_ERROR;
+}
+
+/* called from the preview thread only, which then waits for the watchdog */
+void CameraHardwareSec::requestSensorRecovery()
+{
+    Mutex::Autolock lock(mWatchdogLock);
+
+    if (mWatchdogState == WATCHDOG_IDLE) {
+        ALOGW("%s: no frame from the sensor, recovering", __func__);
+        mWatchdogState = WATCHDOG_REQUESTED;
+        mWatchdogCondition.broadcast();
+    }
+}
+
+int CameraHardwareSec::watchdogThread()
+{
+    mWatchdogLock.lock();
+    while (mWatchdogState != WATCHDOG_REQUESTED && !mExitWatchdogThread)
+        mWatchdogCondition.wait(mWatchdogLock);
+    if (mExitWatchdogThread) {
+        mWatchdogLock.unlock();
+        return NO_ERROR;
+    }
+    mWatchdogState = WATCHDOG_RECOVERING;
+    mWatchdogLock.unlock();
+
+    nsecs_t start = systemTime();
+    mSensorLock.lock();
+    int ret = mSecCamera->recoverSensor();
+    mSensorLock.unlock();
+    nsecs_t duration = systemTime() - start;
+
+    if (ret < 0)
+        ALOGE("ERR(%s):Fail on mSecCamera->recoverSensor(), retrying on the next timeout",
+             __func__);
+    else
+        ALOGW("%s: sensor back after %lld ms", __func__, ns2ms(duration));
+
+    mWatchdogLock.lock();
+    mRecoveryCount++;
+    if (ret < 0)
+        mRecoveryFailures++;
+    mRecoveryStats.add(duration);
+    mWatchdogState = WATCHDOG_IDLE;
+    mWatchdogCondition.broadcast();
+    mWatchdogLock.unlock();
+
+    return NO_ERROR;
+}
+
+/* copy a frame into the callback heap in the format the client asked for,
+ * the source belongs to the display path and must not be modified
+ */
+void CameraHardwareSec::fillPreviewCallbackFrame(int index, char *y, char *u, char *v,
+                                                 int width, int height)
+{
+    const int y_size = width * height;
+    const int cb_y_size = mCallbackWidth * mCallbackHeight;
+    char *dst = ((char *)mPreviewCbHeap->data) + (cb_y_size * 3 / 2) * index;
+
+    // a smaller stream is scaled straight into the slot, nothing copied first
+    if (cb_y_size != y_size) {
+        unsigned char *dst_y = (unsigned char *)dst;
+        unsigned char *dst_cb, *dst_cr;
+        int uv_step;
+
+        if (mCallbackNV21) {
+            dst_cr = dst_y + cb_y_size;
+            dst_cb = dst_cr + 1;
+            uv_step = 2;
         } else {
-            mSecCamera->releaseRecordFrame(index);
+            dst_cb = dst_y + cb_y_size;
+            dst_cr = dst_cb + cb_y_size / 4;
+            uv_step = 1;
         }
+        scaleYuv420Bilinear((unsigned char *)y, (unsigned char *)u,
+                            (unsigned char *)v, width, height,
+                            dst_y, dst_cb, dst_cr,
+                            mCallbackWidth, mCallbackHeight, uv_step);
+        return;
+    }
+
+    memcpy(dst, y, y_size);
+
+    if (mCallbackNV21) {
+        // NV21 interleaves chroma as V then U
+        csc_interleave_memcpy(dst + y_size, v, u, y_size / 4);
+    } else {
+        memcpy(dst + y_size, u, y_size / 4);
+        memcpy(dst + y_size + y_size / 4, v, y_size / 4);
+    }
+}
+
+/* keep a copy of the frame for zero shutter lag capture.  only the
+ * preview thread writes the ring, the picture thread pins the slot it
+ * encodes so the copy below never lands on it.
+ */
+void CameraHardwareSec::storeZslFrame(char *y, char *u, char *v,
+                                      int width, int height, nsecs_t timestamp)
+{
+    const int y_size = width * height;
+    const int frame_size = y_size * 3 / 2;
+    int slot;
+
+    {
+        Mutex::Autolock lock(mZslLock);
+        if (mZslHeap == NULL || mZslWidth != width || mZslHeight != height) {
+            if (mZslPinned >= 0)
+                return;
+            RELEASE_MEMORY_BUFFER(mZslHeap);
+            mZslHeap = mGetMemoryCb(-1, frame_size, kZslFrameCount, 0);
+            if (mZslHeap == NULL) {
+                ALOGE("ERR(%s):Fail on zero shutter lag heap allocation", __func__);
+                return;
+            }
+            mZslWidth = width;
+            mZslHeight = height;
+            mZslNext = 0;
+            memset(mZslTimestamp, 0, sizeof(mZslTimestamp));
+        }
+
+        slot = mZslNext;
+        if (slot == mZslPinned)
+            slot = (slot + 1) % kZslFrameCount;
+        mZslNext = (slot + 1) % kZslFrameCount;
+        mZslTimestamp[slot] = 0;
+    }
+
+    char *dst = ((char *)mZslHeap->data) + frame_size * slot;
+    memcpy(dst, y, y_size);
+    memcpy(dst + y_size, u, y_size / 4);
+    memcpy(dst + y_size + y_size / 4, v, y_size / 4);
+
+    Mutex::Autolock lock(mZslLock);
+    mZslTimestamp[slot] = timestamp;
+}
+
+/* pick the stored frame closest to the shutter, -1 if there is none */
+int CameraHardwareSec::pinZslFrame(nsecs_t shutter)
+{
+    Mutex::Autolock lock(mZslLock);
+    nsecs_t best_diff = 0;
+
+    mZslPinned = -1;
+    for (int i = 0; i < kZslFrameCount; i++) {
+        if (mZslTimestamp[i] == 0)
+            continue;
+        nsecs_t diff = mZslTimestamp[i] - shutter;
+        if (diff < 0)
+            diff = -diff;
+        if (mZslPinned < 0 || diff < best_diff) {
+            mZslPinned = i;
+            best_diff = diff;
+        }
+    }
+    return mZslPinned;
+}
+
+void CameraHardwareSec::unpinZslFrame()
+{
+    Mutex::Autolock lock(mZslLock);
+    mZslPinned = -1;
+}
+
+void CameraHardwareSec::releaseZslFrames()
+{
+    Mutex::Autolock lock(mZslLock);
+    RELEASE_MEMORY_BUFFER(mZslHeap);
+    memset(mZslTimestamp, 0, sizeof(mZslTimestamp));
+    mZslNext = 0;
+    mZslPinned = -1;
+}
+
+/* convert the record frame the picture thread is waiting for.  the
+ * preview thread still owns the buffer here, so the encoder gets it only
+ * after the copy.
+ */
+void CameraHardwareSec::storeVideoSnapshotFrame(int index)
+{
+    unsigned char *y, *cbcr;
+    int width, height;
+
+    Mutex::Autolock lock(mCaptureLock);
+    if (!mVideoSnapshotPending)
+        return;
+    mVideoSnapshotPending = false;
+    mVideoSnapshotStatus = UNKNOWN_ERROR;
+
+    if (mSecCamera->getRecordFrameAddr(index, &y, &cbcr, &width, &height) < 0) {
+        ALOGE("ERR(%s):Fail on SecCamera->getRecordFrameAddr(%d)", __func__, index);
+        mVideoSnapshotCondition.broadcast();
+        return;
+    }
+
+    const int y_size = width * height;
+    const int frame_size = y_size * 3 / 2;
+    if (mVideoSnapshotHeap == NULL || (int)mVideoSnapshotHeap->size < frame_size) {
+        RELEASE_MEMORY_BUFFER(mVideoSnapshotHeap);
+        mVideoSnapshotHeap = mGetMemoryCb(-1, frame_size, 1, 0);
+        if (mVideoSnapshotHeap == NULL) {
+            ALOGE("ERR(%s):Fail on video snapshot heap allocation", __func__);
+            mVideoSnapshotCondition.broadcast();
+            return;
+        }
+    }
+
+    char *dst = (char *)mVideoSnapshotHeap->data;
+    csc_tiled_to_linear(dst, (char *)y, width, height);
+    csc_tiled_to_linear_deinterleave(dst + y_size, dst + y_size + y_size / 4,
+                                     (char *)cbcr, width, height / 2);
+    mVideoSnapshotWidth = width;
+    mVideoSnapshotHeight = height;
+    mVideoSnapshotStatus = NO_ERROR;
+    mVideoSnapshotCondition.broadcast();
+}
+
+/* busy and total jiffies of all cpus since boot, false if unknown */
+static bool readCpuTicks(unsigned long long *busy, unsigned long long *total)
+{
+    unsigned long long user, nice, sys, idle, iowait = 0, irq = 0, softirq = 0;
+    FILE *fp = fopen("/proc/stat", "r");
+
+    if (fp == NULL)
+        return false;
+    int n = fscanf(fp, "cpu %llu %llu %llu %llu %llu %llu %llu",
+                   &user, &nice, &sys, &idle, &iowait, &irq, &softirq);
+    fclose(fp);
+    if (n < 4)
+        return false;
+
+    *total = user + nice + sys + idle + iowait + irq + softirq;
+    *busy = *total - idle - iowait;
+    return true;
+}
+
+/* start a fresh measurement at the rate the app asked for.  the sensor is
+ * left alone, startPreview() and stopRecord() program it themselves.  its
+ * rate may still be one the governor stepped down to, the governor steps
+ * it back up to the asked rate from there.
+ */
+void CameraHardwareSec::resetFpsGovernor()
+{
+    mGovernorFps = mSecCamera->getFrameRate();
+    /* a scene mode with the sensor on auto keeps the governor off */
+    mGovernorNominalFps = mGovernorFps == FRAME_RATE_AUTO ?
+            FRAME_RATE_AUTO : mParameters.getPreviewFrameRate();
+    mParameters.getPreviewFpsRange(&mGovernorMinFps, &mGovernorMaxFps);
+    mFrameDecimation = 1;
+    mDecimationCount = 0;
+    mGovernorWindowStart = 0;
+    mGovernorOverloaded = 0;
+    mGovernorIdle = 0;
+}
+
+/* mRecordLock must be held, so a recording can't start behind our back */
+void CameraHardwareSec::setGovernorRate_l(int fps, int decimation)
+{
+    if (fps != mGovernorFps) {
+        if (mSecCamera->setFrameRate(fps) < 0) {
+            ALOGW("%s: sensor stays at %d fps", __func__, mGovernorFps);
+            return;
+        }
+    }
+    if (fps != mGovernorFps || decimation != mFrameDecimation) {
+        ALOGD("%s: preview at %d fps, keeping 1 of %d frames", __func__,
+             fps, decimation);
+        mGovernorChanges++;
+    }
+    mGovernorFps = fps;
+    mFrameDecimation = decimation;
+    mDecimationCount = 0;
+}
+
+/* called for every delivered preview frame.  once a second the load of
+ * the last second decides: two overloaded seconds in a row step the rate
+ * down, three idle ones step it back up.  the sensor only has a few
+ * fixed rates, below the lowest one allowed by preview-fps-range frames
+ * are dropped deliberately instead.
+ */
+void CameraHardwareSec::updateFpsGovernor(nsecs_t frame_time)
+{
+    static const int kSensorRates[] = { FRAME_RATE_30, FRAME_RATE_15, FRAME_RATE_7 };
+    static const int kMaxDecimation = 4;
+    const nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+    unsigned long long busy, total;
+
+    if (mGovernorWindowStart == 0) {
+        mGovernorWindowStart = now;
+        mGovernorFrames = 0;
+        mGovernorFrameTime = 0;
+        mGovernorDequeueTime = 0;
+        mGovernorBacklog = 0;
+        mGovernorDrops = android_atomic_acquire_load(&mCallbackDrops);
+        if (!readCpuTicks(&mGovernorCpuBusy, &mGovernorCpuTotal))
+            mGovernorCpuTotal = 0;
+        return;
+    }
+
+    mGovernorFrames++;
+    mGovernorFrameTime += frame_time;
+    mGovernorBacklog += mCallbackWrite - android_atomic_acquire_load(&mCallbackRead);
+    if (now - mGovernorWindowStart < seconds(1))
+        return;
+
+    /* a sensor in auto frame rate picks its own, and a recording
+     * keeps the rate the app asked for
+     */
+    if (mGovernorNominalFps == FRAME_RATE_AUTO ||
+        android_atomic_acquire_load(&mRecordRunning) || mGovernorFrames == 0) {
+        mGovernorWindowStart = 0;
+        return;
+    }
+
+    const nsecs_t interval = (now - mGovernorWindowStart) / mGovernorFrames;
+    const nsecs_t frame_avg = mGovernorFrameTime / mGovernorFrames;
+    const nsecs_t dequeue_avg = mGovernorDequeueTime / mGovernorFrames;
+    /* twice the average, so half a frame of backlog still counts */
+    const int backlog = mGovernorBacklog * 2 / mGovernorFrames;
+    const int32_t drops = android_atomic_acquire_load(&mCallbackDrops) - mGovernorDrops;
+    int cpu = 0;
+    if (mGovernorCpuTotal && readCpuTicks(&busy, &total) && total > mGovernorCpuTotal)
+        cpu = (busy - mGovernorCpuBusy) * 100 / (total - mGovernorCpuTotal);
+    mGovernorWindowStart = 0;
+
+    bool overloaded = drops > 0 || backlog >= mCallbackQueueDepth ||
+                      dequeue_avg > interval / 4 || frame_avg > interval * 3 / 4 ||
+                      cpu > 90;
+    bool idle = drops == 0 && backlog == 0 &&
+                dequeue_avg < interval / 8 && frame_avg < interval / 3 &&
+                cpu < 70;
+
+    mGovernorOverloaded = overloaded ? mGovernorOverloaded + 1 : 0;
+    mGovernorIdle = idle ? mGovernorIdle + 1 : 0;
+    if (mGovernorOverloaded < 2 && mGovernorIdle < 3)
+        return;
+
+    ALOGV("%s: frame %lld us dequeue %lld us backlog %d drops %d cpu %d%%", __func__,
+         ns2us(frame_avg), ns2us(dequeue_avg), backlog / 2, drops, cpu);
+
+    const int min_fps = mGovernorMinFps;
+    const int max_fps = mGovernorMaxFps;
+
+    int fps = mGovernorFps;
+    int decimation = mFrameDecimation;
+    if (mGovernorOverloaded >= 2) {
+        int lower = -1;
+        for (size_t i = 0; i < sizeof(kSensorRates) / sizeof(kSensorRates[0]); i++) {
+            if (kSensorRates[i] < fps && kSensorRates[i] * 1000 >= min_fps) {
+                lower = kSensorRates[i];
+                break;
+            }
+        }
+        if (lower > 0)
+            fps = lower;
+        else if (decimation < kMaxDecimation && fps * 1000 / (decimation + 1) >= min_fps)
+            decimation++;
+    } else {
+        if (decimation > 1) {
+            decimation--;
+        } else {
+            for (int i = sizeof(kSensorRates) / sizeof(kSensorRates[0]) - 1; i >= 0; i--) {
+                if (kSensorRates[i] > fps && kSensorRates[i] <= mGovernorNominalFps &&
+                    kSensorRates[i] * 1000 <= max_fps) {
+                    fps = kSensorRates[i];
+                    break;
+                }
+            }
+        }
+    }
+    mGovernorOverloaded = 0;
+    mGovernorIdle = 0;
+
+    if (fps == mGovernorFps && decimation == mFrameDecimation)
+        return;
+
+    Mutex::Autolock lock(mRecordLock);
+    if (!mRecordRunning)
+        setGovernorRate_l(fps, decimation);
+}
+
+/* whether the frame is due to the client at the callback rate, a frame
+ * up to a quarter period early counts as on time
+ */
+bool CameraHardwareSec::callbackDue(nsecs_t timestamp)
+{
+    const nsecs_t interval = mCallbackInterval;
+
+    if (interval == 0)
+        return true;
+    if (timestamp - mCallbackLast < interval - interval / 4)
+        return false;
+    mCallbackLast = timestamp;
+    return true;
+}
+
+/* the ring below has a single producer, the preview thread, and a single
+ * consumer, the callback thread.  both may advance mCallbackRead: the
+ * consumer to take a frame, the producer to drop the oldest one.  a slot
+ * stays busy from the time it's queued until it has been delivered or
+ * dropped, so a free slot always exists for the next frame.
+ */
+int CameraHardwareSec::reserveCallbackSlot()
+{
+    const int32_t w = mCallbackWrite;
+
+    while (w - android_atomic_acquire_load(&mCallbackRead) >= mCallbackQueueDepth) {
+        if (!mCallbackDropOldest) {
+            android_atomic_inc(&mCallbackDrops);
+            return -1;
+        }
+
+        int32_t r = android_atomic_acquire_load(&mCallbackRead);
+        int32_t slot = mCallbackRing[r & (kCallbackRingSize - 1)];
+        if (android_atomic_release_cas(r, r + 1, &mCallbackRead) == 0) {
+            android_atomic_release_store(0, &mCallbackSlotBusy[slot]);
+            android_atomic_inc(&mCallbackDrops);
+        }
+    }
+
+    for (int i = 0; i < kBufferCount; i++) {
+        if (!android_atomic_acquire_load(&mCallbackSlotBusy[i]))
+            return i;
+    }
+
+    ALOGE("ERR(%s):no free callback slot", __func__);
+    android_atomic_inc(&mCallbackDrops);
+    return -1;
+}
+
+void CameraHardwareSec::queueCallbackFrame(int slot)
+{
+    const int32_t w = mCallbackWrite;
+
+    android_atomic_release_store(1, &mCallbackSlotBusy[slot]);
+    mCallbackRing[w & (kCallbackRingSize - 1)] = slot;
+    android_atomic_release_store(w + 1, &mCallbackWrite);
+    sem_post(&mCallbackSem);
+}
+
+int CameraHardwareSec::dequeueCallbackFrame()
+{
+    while (1) {
+        int32_t r = android_atomic_acquire_load(&mCallbackRead);
+        if (r == android_atomic_acquire_load(&mCallbackWrite))
+            return -1;
+
+        int32_t slot = mCallbackRing[r & (kCallbackRingSize - 1)];
+        if (android_atomic_release_cas(r, r + 1, &mCallbackRead) == 0)
+            return slot;
+        /* the preview thread dropped it under us, try the next one */
+    }
+}
+
+/* drop everything queued and wait for a delivery in progress to finish */
+void CameraHardwareSec::flushCallbackFrames()
+{
+    int slot;
+
+    Mutex::Autolock lock(mCallbackLock);
+    while ((slot = dequeueCallbackFrame()) >= 0)
+        android_atomic_release_store(0, &mCallbackSlotBusy[slot]);
+    while (mCallbackDelivering)
+        mCallbackDeliveredCondition.wait(mCallbackLock);
+
+    if (mCallbackDrops)
+        ALOGD("%s: %d preview callback frames dropped", __func__, mCallbackDrops);
+}
+
+int CameraHardwareSec::callbackThread()
+{
+    int slot;
+
+    while (1) {
+        sem_wait(&mCallbackSem);
+        if (mExitCallbackThread) {
+            ALOGV("%s: exiting", __func__);
+            return 0;
+        }
+
+        mCallbackLock.lock();
+        while ((slot = dequeueCallbackFrame()) >= 0) {
+            if (mMsgEnabled & CAMERA_MSG_PREVIEW_FRAME) {
+                /* the client may call back into us, don't hold the lock
+                 * across it. flushCallbackFrames() waits for the delivery,
+                 * the heap stays until then */
+                camera_data_callback data_cb = mDataCb;
+                camera_memory_t *heap = mPreviewCbHeap;
+                void *cookie = mCallbackCookie;
+                mCallbackDelivering = true;
+                mCallbackLock.unlock();
+
+                nsecs_t start = systemTime();
+                data_cb(CAMERA_MSG_PREVIEW_FRAME, heap, slot, NULL, cookie);
+                mPreviewStats[STAGE_CALLBACK].add(systemTime() - start);
+
+                mCallbackLock.lock();
+                mCallbackDelivering = false;
+                mCallbackDeliveredCondition.broadcast();
+            }
+            android_atomic_release_store(0, &mCallbackSlotBusy[slot]);
+        }
+        mCallbackLock.unlock();
     }
-    return NO_ERROR;
 }
 
 status_t CameraHardwareSec::startPreview()
@@ -712,6 +1586,10 @@ status_t CameraHardwareSec::startPreview()
     }
 
     Mutex::Autolock previewLock(mPreviewLock);
+    if (mPreviewRunning && mZslEnabled) {
+        // a zero shutter lag capture leaves preview running
+        return NO_ERROR;
+    }
     if (mPreviewRunning) {
         ALOGE("%s : preview thread already running", __func__);
         return INVALID_OPERATION;
@@ -746,29 +1624,96 @@ status_t CameraHardwareSec::startPreview_l()
         return NO_ERROR;
     }
 
+    /* no window buffer is out while the preview is stopped */
+    setWindowBufferCount_l(true);
+
+    if (initPreviewBuffers_l() != NO_ERROR)
+        mSecCamera->setPreviewUserBufferCount(0);
+
     ret = mSecCamera->startPreview();
     if (ret < 0) {
         ALOGE("ERR(%s):Fail on mSecCamera->startPreview()", __func__);
+        freePreviewBuffers_l();
         return UNKNOWN_ERROR;
     }
 
+    if (mPreviewBufCount > 0 && !mSecCamera->isPreviewZeroCopy())
+        freePreviewBuffers_l();
+    mPreviewZeroCopy = mSecCamera->isPreviewZeroCopy();
+
+    mRecordLock.lock();
+    prepareRecording_l(true);
+    mRecordLock.unlock();
+
     setSkipFrame(INITIAL_SKIP_FRAME);
+    resetFpsGovernor();
+
+    for (int i = 0; i < STAGE_MAX; i++)
+        mPreviewStats[i].reset();
+    for (int i = 0; i < LATENCY_MAX; i++)
+        mLatencyStats[i].reset();
+    mSecCamera->resetPreviewStats();
 
     int width, height, frame_size;
     mSecCamera->getPreviewSize(&width, &height, &frame_size);
-    ALOGD("MemoryHeapBase(fd(%d), size(%d), width(%d), height(%d))",
-             mSecCamera->getCameraFd(), frame_size * kBufferCount, width, height);
+    ALOGD("MemoryHeapBase(fd(%d), size(%d), width(%d), height(%d), zero copy(%d))",
+             mSecCamera->getCameraFd(), frame_size * kBufferCount, width, height,
+             mPreviewZeroCopy);
+
+    /* the node stays open and lays its buffers out the same way for the
+     * same geometry, so a restart at the same size keeps the mapping.
+     * in zero copy mode the fimc buffers are the gralloc buffers, there
+     * is nothing of the camera node to map
+     */
+    bool geometry_changed = width != mPreviewHeapWidth ||
+                            height != mPreviewHeapHeight ||
+                            frame_size != mPreviewHeapFrameSize;
+    if (geometry_changed || mPreviewZeroCopy)
+        RELEASE_MEMORY_BUFFER(mPreviewMemory);
+    if (!mPreviewZeroCopy && !mPreviewMemory) {
+        mPreviewMemory = mGetMemoryCb(mSecCamera->getCameraFd(),
+                                      frame_size,
+                                      kBufferCount,
+                                      mCallbackCookie);
+        if (!mPreviewMemory) {
+            ALOGE("ERR(%s): Preview heap creation fail", __func__);
+            return NO_MEMORY;
+        }
+    }
 
-    RELEASE_MEMORY_BUFFER(mPreviewMemory);
-    mPreviewMemory = mGetMemoryCb(mSecCamera->getCameraFd(),
-                                  frame_size,
-                                  kBufferCount,
-                                  mCallbackCookie);
-    if (!mPreviewMemory) {
-        ALOGE("ERR(%s): Preview heap creation fail", __func__);
-        return NO_MEMORY;
+    /* frames handed to the client are copied here, so the conversion
+     * never touches a buffer the display or fimc is still using
+     */
+    int cb_width = width, cb_height = height;
+    const char *cb_size = mParameters.get(SecCameraParameters::KEY_PREVIEW_CALLBACK_SIZE);
+    if (cb_size != NULL &&
+        (sscanf(cb_size, "%dx%d", &cb_width, &cb_height) != 2 ||
+         cb_width > width || cb_height > height)) {
+        ALOGW("%s: preview callback size %s doesn't fit %dx%d, using that",
+             __func__, cb_size, width, height);
+        cb_width = width;
+        cb_height = height;
+    }
+
+    flushCallbackFrames();
+    releaseZslFrames();
+    if (cb_width != mCallbackWidth || cb_height != mCallbackHeight)
+        RELEASE_MEMORY_BUFFER(mPreviewCbHeap);
+    mCallbackWidth = cb_width;
+    mCallbackHeight = cb_height;
+    mCallbackLast = 0;
+    if (!mPreviewCbHeap) {
+        mPreviewCbHeap = mGetMemoryCb(-1, cb_width * cb_height * 3 / 2, kBufferCount, mCallbackCookie);
+        if (!mPreviewCbHeap) {
+            ALOGE("ERR(%s): Preview callback heap creation fail", __func__);
+            return NO_MEMORY;
+        }
     }
 
+    mPreviewHeapWidth = width;
+    mPreviewHeapHeight = height;
+    mPreviewHeapFrameSize = frame_size;
+
     mSecCamera->getPostViewConfig(&mPostViewWidth, &mPostViewHeight, &mPostViewSize);
     ALOGV("CameraHardwareSec: mPostViewWidth = %d mPostViewHeight = %d mPostViewSize = %d",
              mPostViewWidth,mPostViewHeight,mPostViewSize);
@@ -776,6 +1721,180 @@ status_t CameraHardwareSec::startPreview_l()
     return OK;
 }
 
+/* what the window keeps queued, three for fimc or the copy to work on,
+ * and the extra ones a slow consumer asked for, as far as the memory
+ * budget goes.  the preview needs two more than the window keeps, the
+ * budget gives way below that.
+ */
+int CameraHardwareSec::windowBufferCount(int min_bufs, int width, int height) const
+{
+    const int frame_size = width * height * 3 / 2;
+    int count = min_bufs + 3 + mWindowExtraBuffers;
+
+    if (frame_size > 0 && count > kWindowBufferBudget / frame_size)
+        count = kWindowBufferBudget / frame_size;
+    if (count > kMaxWindowBuffers)
+        count = kMaxWindowBuffers;
+    if (count < min_bufs + 2)
+        count = min_bufs + 2;
+
+    return count;
+}
+
+/* with adapt, the dequeue latency of the last preview run adds or takes
+ * back a buffer.  the window only takes a new count with none dequeued.
+ */
+status_t CameraHardwareSec::setWindowBufferCount_l(bool adapt)
+{
+    static const uint32_t kAdaptMinFrames = 30;
+    /* a quarter of a 30 fps frame is slow */
+    const nsecs_t kSlowDequeue = ms2ns(8);
+    const nsecs_t kFastDequeue = ms2ns(2);
+    const SecCameraHistogram& dequeue = mPreviewStats[STAGE_WINDOW_DEQUEUE];
+    int min_bufs;
+    int width, height;
+
+    if (!mWindow)
+        return INVALID_OPERATION;
+
+    if (mWindow->get_min_undequeued_buffer_count(mWindow, &min_bufs)) {
+        ALOGE("%s: could not retrieve min undequeued buffer count", __func__);
+        return INVALID_OPERATION;
+    }
+
+    if (adapt && dequeue.count() >= kAdaptMinFrames) {
+        if (dequeue.mean() > kSlowDequeue && mWindowExtraBuffers < kMaxWindowBuffers)
+            mWindowExtraBuffers++;
+        else if (dequeue.mean() < kFastDequeue && mWindowExtraBuffers > 0)
+            mWindowExtraBuffers--;
+    }
+
+    mParameters.getPreviewSize(&width, &height);
+    int count = windowBufferCount(min_bufs, width, height);
+    if (count > kMaxWindowBuffers)
+        ALOGW("%s: min undequeued buffer count %d is too high", __func__, min_bufs);
+    if (count == mWindowBufferCount)
+        return NO_ERROR;
+
+    ALOGV("%s: setting buffer count to %d (min undequeued %d, extra %d)", __func__,
+         count, min_bufs, mWindowExtraBuffers);
+    if (mWindow->set_buffer_count(mWindow, count)) {
+        ALOGE("%s: could not set buffer count", __func__);
+        return INVALID_OPERATION;
+    }
+    mWindowBufferCount = count;
+
+    return NO_ERROR;
+}
+
+status_t CameraHardwareSec::initPreviewBuffers_l()
+{
+    const IMG_gralloc_module_public_t *module =
+        (const IMG_gralloc_module_public_t *)mGrallocHal;
+    int width, height, frame_size;
+    int min_bufs;
+    int count;
+
+    freePreviewBuffers_l();
+
+    if (!mWindow || !module || !module->GetPhyAddrs)
+        return INVALID_OPERATION;
+
+    if (mWindow->get_min_undequeued_buffer_count(mWindow, &min_bufs))
+        return INVALID_OPERATION;
+
+    count = mWindowBufferCount - min_bufs;
+    if (count > kBufferCount)
+        count = kBufferCount;
+    if (count < 3) {
+        ALOGW("%s: only %d buffers can be dequeued, no zero copy", __func__, count);
+        return INVALID_OPERATION;
+    }
+
+    mSecCamera->getPreviewSize(&width, &height, &frame_size);
+
+    /* fimc writes the planes packed, so the YV12 strides chosen by gralloc
+     * (luma and chroma aligned to 16) must not add any padding
+     */
+    if (width % 32) {
+        ALOGV("%s: width %d doesn't fit YV12 strides, no zero copy", __func__, width);
+        return INVALID_OPERATION;
+    }
+
+    if (mSecCamera->setPreviewUserBufferCount(count) < 0)
+        return INVALID_OPERATION;
+
+    mPreviewBufWindow = mWindow;
+    mPreviewBufCount = count;
+
+    for (int i = 0; i < count; i++) {
+        if (queuePreviewBuffer(i) != NO_ERROR) {
+            freePreviewBuffers_l();
+            return INVALID_OPERATION;
+        }
+    }
+
+    return NO_ERROR;
+}
+
+void CameraHardwareSec::freePreviewBuffers_l()
+{
+    for (int i = 0; i < mPreviewBufCount; i++) {
+        if (mPreviewBufHandles[i]) {
+            mPreviewBufWindow->cancel_buffer(mPreviewBufWindow, mPreviewBufHandles[i]);
+            mPreviewBufHandles[i] = NULL;
+        }
+    }
+
+    if (mPreviewBufCount > 0)
+        mSecCamera->setPreviewUserBufferCount(0);
+
+    mPreviewBufCount = 0;
+    mPreviewBufWindow = NULL;
+    mPreviewZeroCopy = false;
+}
+
+/* dequeue a window buffer and hand it to fimc in the given slot */
+status_t CameraHardwareSec::queuePreviewBuffer(int index)
+{
+    const IMG_gralloc_module_public_t *module =
+        (const IMG_gralloc_module_public_t *)mGrallocHal;
+    buffer_handle_t *buf_handle;
+    unsigned int phys[MAX_SUB_ALLOCS];
+    int width, height, frame_size;
+    int stride;
+    int ret;
+
+    nsecs_t start = systemTime();
+    ret = mPreviewBufWindow->dequeue_buffer(mPreviewBufWindow, &buf_handle, &stride);
+    start = systemTime() - start;
+    mPreviewStats[STAGE_WINDOW_DEQUEUE].add(start);
+    mGovernorDequeueTime += start;
+    if (ret != 0) {
+        ALOGE("%s: Could not dequeue gralloc buffer: %i!", __func__, ret);
+        return UNKNOWN_ERROR;
+    }
+
+    mSecCamera->getPreviewSize(&width, &height, &frame_size);
+
+    const IMG_native_handle_t *handle = (const IMG_native_handle_t *)*buf_handle;
+    if (!(handle->usage & GRALLOC_USAGE_PHYS_CONTIG) || stride != width ||
+        module->GetPhyAddrs(module, *buf_handle, phys)) {
+        ALOGV("%s: buffer not usable by fimc (usage 0x%x stride %d)",
+             __func__, handle->usage, stride);
+        mPreviewBufWindow->cancel_buffer(mPreviewBufWindow, buf_handle);
+        return INVALID_OPERATION;
+    }
+
+    const unsigned int y_size = width * height;
+    mSecCamera->setPreviewUserBuffer(index, phys[0],
+                                     phys[0] + y_size + y_size / 4,
+                                     phys[0] + y_size);
+    mPreviewBufHandles[index] = buf_handle;
+
+    return mSecCamera->releasePreviewFrame(index) < 0 ? UNKNOWN_ERROR : NO_ERROR;
+}
+
 void CameraHardwareSec::stopPreview()
 {
     ALOGV("%s :", __func__);
@@ -791,10 +1910,52 @@ status_t CameraHardwareSec::startFaceDetection()
         return NO_ERROR;
     }
 
+    /* the metadata callback wants a heap even though it carries nothing */
+    if (mFaceMetadataHeap == NULL) {
+        mFaceMetadataHeap = mGetMemoryCb(-1, 1, 1, 0);
+        if (mFaceMetadataHeap == NULL) {
+            ALOGE("ERR(%s):Fail on mGetMemoryCb(face metadata)", __func__);
+            return NO_MEMORY;
+        }
+    }
+    mLastFaceCount = -1;
+
     mFaceDetectStarted = mSecCamera->setFaceDetect(FACE_DETECTION_ON) >= 0;
     return mFaceDetectStarted ? NO_ERROR : UNKNOWN_ERROR;
 }
 
+/* the faces SecCamera read with this frame, in the [-1000, 1000] space of
+ * the framework; a run of empty frames is reported once
+ */
+void CameraHardwareSec::sendFaceMetadata(int width, int height)
+{
+    struct v4l2_rect rects[MAX_DETECTED_FACES];
+    int count = mSecCamera->getFrameFaces(rects, MAX_DETECTED_FACES);
+
+    if (count == 0 && mLastFaceCount == 0)
+        return;
+    mLastFaceCount = count;
+
+    for (int i = 0; i < count; i++) {
+        camera_face_t *face = &mFaces[i];
+        face->rect[0] = rects[i].left * 2000 / width - 1000;
+        face->rect[1] = rects[i].top * 2000 / height - 1000;
+        face->rect[2] = (rects[i].left + (int)rects[i].width) * 2000 / width - 1000;
+        face->rect[3] = (rects[i].top + (int)rects[i].height) * 2000 / height - 1000;
+        face->score = 100;
+        face->id = i + 1;
+        /* the sensor doesn't locate features */
+        face->left_eye[0] = face->left_eye[1] = -2000;
+        face->right_eye[0] = face->right_eye[1] = -2000;
+        face->mouth[0] = face->mouth[1] = -2000;
+    }
+
+    mFaceMetadata.number_of_faces = count;
+    mFaceMetadata.faces = mFaces;
+    mDataCb(CAMERA_MSG_PREVIEW_METADATA, mFaceMetadataHeap, 0,
+            &mFaceMetadata, mCallbackCookie);
+}
+
 status_t CameraHardwareSec::stopFaceDetection()
 {
     if (!mFaceDetectStarted) {
@@ -806,6 +1967,97 @@ status_t CameraHardwareSec::stopFaceDetection()
     return !mFaceDetectStarted ? NO_ERROR : UNKNOWN_ERROR;
 }
 
+status_t CameraHardwareSec::startSmoothZoom(int level)
+{
+    if (level < 0 || level > mParameters.getInt(SecCameraParameters::KEY_MAX_ZOOM)) {
+        ALOGE("ERR(%s):Invalid zoom level (%d)", __func__, level);
+        return BAD_VALUE;
+    }
+
+    Mutex::Autolock lock(mZoomLock);
+    mZoomTarget = SecCamera::zoomLevelRatio(level);
+    mSmoothZoomStop = false;
+    mSmoothZoom = true;
+    return NO_ERROR;
+}
+
+status_t CameraHardwareSec::stopSmoothZoom()
+{
+    Mutex::Autolock lock(mZoomLock);
+    if (mSmoothZoom)
+        mSmoothZoomStop = true;
+    return NO_ERROR;
+}
+
+/* the crop follows the zoom at frame rate, CAMERA_MSG_ZOOM goes out each
+ * time it passes a level and with stopped set once it is there
+ */
+void CameraHardwareSec::stepSmoothZoom()
+{
+    int prev, ratio, level;
+    bool stopped;
+
+    {
+        Mutex::Autolock lock(mZoomLock);
+        if (!mSmoothZoom)
+            return;
+
+        prev = ratio = mSecCamera->getZoomRatio();
+        bool zoom_in = ratio < mZoomTarget;
+
+        // asked to stop, run on to the next level only
+        if (mSmoothZoomStop && ratio != mZoomTarget) {
+            level = (ratio - ZOOM_RATIO_MIN + (zoom_in ? ZOOM_RATIO_STEP - 1 : 0)) /
+                    ZOOM_RATIO_STEP;
+            mZoomTarget = SecCamera::zoomLevelRatio(level);
+            mSmoothZoomStop = false;
+        }
+
+        if (zoom_in)
+            ratio = MIN(ratio + kSmoothZoomStep, mZoomTarget);
+        else
+            ratio = (ratio - kSmoothZoomStep > mZoomTarget) ?
+                    ratio - kSmoothZoomStep : mZoomTarget;
+
+        if (mSecCamera->setZoomRatio(ratio) < 0) {
+            ALOGE("ERR(%s):Fail on mSecCamera->setZoomRatio(%d)", __func__, ratio);
+            mZoomTarget = mSecCamera->getZoomRatio();
+        } else if (mSecCamera->getZoomRatio() == prev && prev != mZoomTarget) {
+            // without a crop the sensor moves a whole level at a time
+            mSecCamera->setZoomRatio(zoom_in ? prev + ZOOM_RATIO_STEP :
+                                               prev - ZOOM_RATIO_STEP);
+        }
+        ratio = mSecCamera->getZoomRatio();
+
+        // the last level passed on the way
+        level = (ratio - ZOOM_RATIO_MIN + (zoom_in ? 0 : ZOOM_RATIO_STEP - 1)) /
+                ZOOM_RATIO_STEP;
+        stopped = ratio == mZoomTarget;
+        if (stopped) {
+            level = (ratio - ZOOM_RATIO_MIN) / ZOOM_RATIO_STEP;
+            mSmoothZoom = false;
+        }
+        if (level == mZoomLevel && !stopped)
+            return;
+        mZoomLevel = level;
+    }
+
+    if (mMsgEnabled & CAMERA_MSG_ZOOM)
+        mNotifyCb(CAMERA_MSG_ZOOM, level, stopped, mCallbackCookie);
+}
+
+/* stops a smooth zoom on the level last reported, true if one ran */
+bool CameraHardwareSec::endSmoothZoom_l()
+{
+    if (!mSmoothZoom)
+        return false;
+
+    mSmoothZoom = false;
+    mSmoothZoomStop = false;
+    mSecCamera->setZoomRatio(SecCamera::zoomLevelRatio(mZoomLevel));
+    return true;
+}
+
 void CameraHardwareSec::stopPreview_l()
 {
     ALOGV("%s - start", __func__);
@@ -823,6 +2075,13 @@ void CameraHardwareSec::stopPreview_l()
     }
 
     mPreviewRunning = false;
+    /* a smooth zoom ends with the preview, at the level it got to */
+    mZoomLock.lock();
+    bool zoom_stopped = endSmoothZoom_l();
+    int zoom_level = mZoomLevel;
+    mZoomLock.unlock();
+    if (zoom_stopped && (mMsgEnabled & CAMERA_MSG_ZOOM))
+        mNotifyCb(CAMERA_MSG_ZOOM, zoom_level, true, mCallbackCookie);
     if (!mPreviewStartDeferred) {
         mPreviewCondition.signal();
         /* wait until preview thread is stopped */
@@ -847,19 +2106,25 @@ status_t CameraHardwareSec::startRecording()
 
     Mutex::Autolock lock(mRecordLock);
 
-    RELEASE_MEMORY_BUFFER(mRecordHeap);
-    mRecordHeap = mGetMemoryCb(-1, sizeof(struct addrs), kBufferCount, NULL);
     if (!mRecordHeap) {
-        ALOGE("ERR(%s): Record heap creation fail", __func__);
-        return UNKNOWN_ERROR;
+        mRecordHeap = mGetMemoryCb(-1, sizeof(struct addrs), kBufferCount, NULL);
+        if (!mRecordHeap) {
+            ALOGE("ERR(%s): Record heap creation fail", __func__);
+            return UNKNOWN_ERROR;
+        }
     }
 
-    if (mRecordRunning == false) {
+    if (!mRecordRunning) {
+        /* the recording runs at the rate the app asked for */
+        if (mGovernorFps != mGovernorNominalFps || mFrameDecimation > 1)
+            setGovernorRate_l(mGovernorNominalFps, 1);
         if (mSecCamera->startRecord() < 0) {
             ALOGE("ERR(%s):Fail on mSecCamera->startRecord()", __func__);
             return UNKNOWN_ERROR;
         }
-        mRecordRunning = true;
+        for (int i = 0; i < kBufferCount; i++)
+            android_atomic_release_store(0, &mRecordFrameRefs[i]);
+        android_atomic_release_store(1, &mRecordRunning);
     }
     return NO_ERROR;
 }
@@ -870,12 +2135,31 @@ void CameraHardwareSec::stopRecording()
 
     Mutex::Autolock lock(mRecordLock);
 
-    if (mRecordRunning == true) {
+    if (mRecordRunning) {
         if (mSecCamera->stopRecord() < 0) {
             ALOGE("ERR(%s):Fail on mSecCamera->stopRecord()", __func__);
             return;
         }
-        mRecordRunning = false;
+        android_atomic_release_store(0, &mRecordRunning);
+        prepareRecording_l(mPreviewRunning && !mPreviewStartDeferred);
+        resetFpsGovernor();
+    }
+}
+
+/* with the recording hint set the record node is configured and streaming
+ * while previewing, so startRecording() doesn't restart any fimc node.
+ * mRecordLock must be held.
+ */
+void CameraHardwareSec::prepareRecording_l(bool previewing)
+{
+    if (mRecordRunning)
+        return;
+
+    if (mRecordingHint && previewing) {
+        if (mSecCamera->prepareRecord() < 0)
+            ALOGW("WARN(%s):Fail on mSecCamera->prepareRecord()", __func__);
+    } else if (mSecCamera->isRecordPrepared()) {
+        mSecCamera->stopRecord();
     }
 }
 
@@ -883,14 +2167,35 @@ bool CameraHardwareSec::recordingEnabled()
 {
     ALOGV("%s :", __func__);
 
-    Mutex::Autolock lock(mRecordLock);
-    return mRecordRunning;
+    return android_atomic_acquire_load(&mRecordRunning) != 0;
 }
 
 void CameraHardwareSec::releaseRecordingFrame(const void *opaque)
 {
     struct addrs *addrs = (struct addrs *)opaque;
-    mSecCamera->releaseRecordFrame(addrs->buf_index);
+    const int index = addrs->buf_index;
+    int32_t refs;
+
+    if (index < 0 || kBufferCount <= index) {
+        ALOGW("%s: no record frame %d", __func__, index);
+        return;
+    }
+
+    /* an encoder gives a frame back as soon as the MFC has read it,
+     * the last of them hands it back to fimc
+     */
+    do {
+        refs = android_atomic_acquire_load(&mRecordFrameRefs[index]);
+        if (refs <= 0) {
+            ALOGW("%s: record frame %d given back once too often", __func__, index);
+            return;
+        }
+    } while (android_atomic_release_cas(refs, refs - 1, &mRecordFrameRefs[index]));
+    if (refs > 1)
+        return;
+
+    mSecCamera->releaseRecordFrame(index);
+    SEC_TRACE_INT("camera:record_inflight", mSecCamera->getRecordFramesInFlight());
 }
 
 // ---------------------------------------------------------------------------
@@ -931,6 +2236,7 @@ int CameraHardwareSec::autoFocusThread()
     }
 
     af_status = mSecCamera->getAutoFocusResult();
+    mAutoFocusStats.add(systemTime() - mAutoFocusRequestTime);
 
     if (af_status == 0x01) {
         ALOGV("%s : AF Success!!", __func__);
@@ -952,66 +2258,283 @@ int CameraHardwareSec::autoFocusThread()
             mNotifyCb(CAMERA_MSG_FOCUS, false, 0, mCallbackCookie);
     }
 
-    ALOGV("%s : exiting with no error", __func__);
-    return NO_ERROR;
+    ALOGV("%s : exiting with no error", __func__);
+    return NO_ERROR;
+}
+
+status_t CameraHardwareSec::autoFocus()
+{
+    ALOGV("%s :", __func__);
+    mAutoFocusRequestTime = systemTime();
+    /* signal autoFocusThread to run once */
+    mFocusCondition.signal();
+    return NO_ERROR;
+}
+
+/* 2009.10.14 by icarus for added interface */
+status_t CameraHardwareSec::cancelAutoFocus()
+{
+    ALOGV("%s :", __func__);
+
+    if (mSecCamera->cancelAutofocus() < 0) {
+        ALOGE("ERR(%s):Fail on mSecCamera->cancelAutofocus()", __func__);
+        return UNKNOWN_ERROR;
+    }
+
+    return NO_ERROR;
+}
+
+camera_memory_t* CameraHardwareSec::getExifHeap()
+{
+    if (mExifHeap == NULL) {
+        mExifHeap = mGetMemoryCb(-1, EXIF_FILE_SIZE + JPG_STREAM_BUF_SIZE, 1, 0);
+        if (mExifHeap == NULL)
+            ALOGE("ERR(%s): Exif heap creation fail", __func__);
+    }
+    return mExifHeap;
+}
+
+CameraHardwareSec::CompressedImageSink::~CompressedImageSink()
+{
+    RELEASE_MEMORY_BUFFER(mMem);
+}
+
+unsigned char *CameraHardwareSec::CompressedImageSink::getBuffer(unsigned int size)
+{
+    camera_memory_t *exifHeap = mHardware->getExifHeap();
+    if (exifHeap == NULL)
+        return NULL;
+
+    mExifSize = mHardware->mSecCamera->getExif((unsigned char *)exifHeap->data,
+                                               mThumbnail, mWidth, mHeight);
+    if (mExifSize < 0 || size < 2)
+        return NULL;
+
+    RELEASE_MEMORY_BUFFER(mMem);
+    mMem = mHardware->mGetMemoryCb(-1, size + mExifSize, 1, 0);
+    if (mMem == NULL)
+        return NULL;
+
+    return (unsigned char *)mMem->data + mExifSize;
+}
+
+camera_memory_t *CameraHardwareSec::CompressedImageSink::finish()
+{
+    if (mMem == NULL)
+        return NULL;
+
+    /* SOI, then the exif over the gap and the stream's own SOI */
+    uint8_t *ptr = (uint8_t *)mMem->data;
+    ptr[0] = 0xFF;
+    ptr[1] = 0xD8;
+    memcpy(ptr + 2, mHardware->mExifHeap->data, mExifSize);
+
+    camera_memory_t *mem = mMem;
+    mMem = NULL;
+    return mem;
 }
 
-status_t CameraHardwareSec::autoFocus()
+/* prepend exif to a jpeg stream from the encoder and hand it to the client.
+ * width and height override the picture size in the exif when non zero.
+ */
+status_t CameraHardwareSec::sendCompressedImage(camera_memory_t *jpegHeap,
+                                                unsigned int jpegSize,
+                                                unsigned char *thumbnail,
+                                                int width, int height)
 {
-    ALOGV("%s :", __func__);
-    /* signal autoFocusThread to run once */
-    mFocusCondition.signal();
+    if (getExifHeap() == NULL)
+        return NO_MEMORY;
+    int jpegExifSize = mSecCamera->getExif((unsigned char *)mExifHeap->data,
+                                           thumbnail, width, height);
+    if (jpegExifSize < 0)
+        return UNKNOWN_ERROR;
+
+    /* the client keeps this one, so it is never reused */
+    camera_memory_t* jpegMem = mGetMemoryCb(-1, jpegSize + jpegExifSize, 1, 0);
+    uint8_t *ptr = (uint8_t *) jpegMem->data;
+    memcpy(ptr, jpegHeap->data, 2); ptr += 2;
+    memcpy(ptr, mExifHeap->data, jpegExifSize); ptr += jpegExifSize;
+    memcpy(ptr, (uint8_t *) jpegHeap->data + 2, jpegSize - 2);
+
+    mDataCb(CAMERA_MSG_COMPRESSED_IMAGE, jpegMem, 0, NULL, mCallbackCookie);
+    RELEASE_MEMORY_BUFFER(jpegMem);
     return NO_ERROR;
 }
 
-/* 2009.10.14 by icarus for added interface */
-status_t CameraHardwareSec::cancelAutoFocus()
+/* the jpeg encoder takes interleaved YCbYCr, the zero shutter lag ring
+ * keeps planar YUV420
+ */
+static void yuv420pToYuyv(char *dst, const char *y, const char *u, const char *v,
+                          int width, int height)
 {
-    ALOGV("%s :", __func__);
+    for (int h = 0; h < height; h++) {
+        const char *py = y + width * h;
+        const char *pu = u + (width / 2) * (h / 2);
+        const char *pv = v + (width / 2) * (h / 2);
+
+        for (int w = 0; w < width; w += 2) {
+            *dst++ = py[w];
+            *dst++ = *pu++;
+            *dst++ = py[w + 1];
+            *dst++ = *pv++;
+        }
+    }
+}
 
-    if (mSecCamera->cancelAutofocus() < 0) {
-        ALOGE("ERR(%s):Fail on mSecCamera->cancelAutofocus()", __func__);
-        return UNKNOWN_ERROR;
+/* encode the stored preview frame closest to the shutter.  the sensor
+ * can't stream full resolution while previewing, so the picture has the
+ * preview size and the snapshot pipeline is never started.
+ */
+int CameraHardwareSec::zslPictureThread()
+{
+    ALOGV("%s - start", __FUNCTION__);
+
+    int                 ret = NO_ERROR;
+    int                 width, height, y_size;
+    sp<MemoryHeapBase>  yuvHeap = NULL;
+    char*               frame;
+
+    int slot = pinZslFrame(mZslShutterTime);
+    if (slot < 0)
+        ret = UNKNOWN_ERROR;
+    CHECK_PICT(slot, "ERR(%s):no preview frame for zero shutter lag", __FUNCTION__);
+
+    if((mMsgEnabled & CAMERA_MSG_SHUTTER) && mNotifyCb) {
+        mNotifyCb(CAMERA_MSG_SHUTTER, 0, 0, mCallbackCookie);
     }
 
-    return NO_ERROR;
+    width = mZslWidth;
+    height = mZslHeight;
+    y_size = width * height;
+    frame = ((char *)mZslHeap->data) + (y_size * 3 / 2) * slot;
+
+    yuvHeap = new MemoryHeapBase(y_size * 2);
+
+    yuv420pToYuyv((char *)yuvHeap->base(), frame, frame + y_size,
+                  frame + y_size + y_size / 4, width, height);
+    unpinZslFrame();
+
+    ret = compressYuyvPicture(yuvHeap, width, height);
+
+out:
+    unpinZslFrame();
+    mCaptureLock.lock();
+    mCaptureInProgress = false;
+    mCaptureCondition.broadcast();
+    mCaptureLock.unlock();
+
+    ALOGV("%s - end", __FUNCTION__);
+
+    return ret;
 }
 
-bool CameraHardwareSec::scaleDownYuv422(char *srcBuf, uint32_t srcWidth, uint32_t srcHeight,
-                                        char *dstBuf, uint32_t dstWidth, uint32_t dstHeight)
+/* snapshot while recording.  the record node keeps streaming at the
+ * video size, so that is the picture size, and the sensor is never
+ * switched to capture mode.
+ */
+int CameraHardwareSec::videoSnapshotThread()
 {
-    int32_t step_x, step_y;
-    int32_t iXsrc, iXdst;
-    int32_t x, y, src_y_start_pos, dst_pos, src_pos;
+    ALOGV("%s - start", __FUNCTION__);
 
-    if (dstWidth % 2 != 0 || dstHeight % 2 != 0){
-        ALOGE("scale_down_yuv422: invalid width, height for scaling");
-        return false;
+    int                 ret = NO_ERROR;
+    int                 width = 0;
+    int                 height = 0;
+    int                 y_size;
+    sp<MemoryHeapBase>  yuvHeap = NULL;
+    char*               frame;
+
+    /* the preview thread converts the next record frame */
+    mCaptureLock.lock();
+    mVideoSnapshotStatus = TIMED_OUT;
+    mVideoSnapshotPending = true;
+    while (mVideoSnapshotPending) {
+        if (mVideoSnapshotCondition.waitRelative(mCaptureLock, ms2ns(1000)) != NO_ERROR)
+            break;
+    }
+    mVideoSnapshotPending = false;
+    ret = mVideoSnapshotStatus;
+    width = mVideoSnapshotWidth;
+    height = mVideoSnapshotHeight;
+    mCaptureLock.unlock();
+    CHECK_PICT(ret, "ERR(%s):no record frame for the snapshot[%i]", __FUNCTION__, ret);
+
+    if((mMsgEnabled & CAMERA_MSG_SHUTTER) && mNotifyCb) {
+        mNotifyCb(CAMERA_MSG_SHUTTER, 0, 0, mCallbackCookie);
     }
 
-    step_x = srcWidth / dstWidth;
-    step_y = srcHeight / dstHeight;
+    y_size = width * height;
+    frame = (char *)mVideoSnapshotHeap->data;
 
-    dst_pos = 0;
-    for (uint32_t y = 0; y < dstHeight; y++) {
-        src_y_start_pos = (y * step_y * (srcWidth * 2));
+    yuvHeap = new MemoryHeapBase(y_size * 2);
+    yuv420pToYuyv((char *)yuvHeap->base(), frame, frame + y_size,
+                  frame + y_size + y_size / 4, width, height);
 
-        for (uint32_t x = 0; x < dstWidth; x += 2) {
-            src_pos = src_y_start_pos + (x * (step_x * 2));
+    ret = compressYuyvPicture(yuvHeap, width, height);
 
-            dstBuf[dst_pos++] = srcBuf[src_pos    ];
-            dstBuf[dst_pos++] = srcBuf[src_pos + 1];
-            dstBuf[dst_pos++] = srcBuf[src_pos + 2];
-            dstBuf[dst_pos++] = srcBuf[src_pos + 3];
-        }
+out:
+    mCaptureLock.lock();
+    mCaptureInProgress = false;
+    mCaptureCondition.broadcast();
+    mCaptureLock.unlock();
+
+    ALOGV("%s - end", __FUNCTION__);
+
+    return ret;
+}
+
+/* encode a YCbYCr picture without the snapshot pipeline and deliver it */
+int CameraHardwareSec::compressYuyvPicture(const sp<MemoryHeapBase>& yuvHeap,
+                                           int width, int height)
+{
+    int                 ret = NO_ERROR;
+    int                 thumbWidth = 0;
+    int                 thumbHeight = 0;
+    int                 thumbSize = 0;
+    unsigned int        jpegSize = 0;
+    camera_memory_t*    jpegMem = NULL;
+    sp<MemoryHeapBase>  thumbnailHeap = NULL;
+
+    mSecCamera->getThumbnailConfig(&thumbWidth, &thumbHeight, &thumbSize);
+    thumbnailHeap = new MemoryHeapBase(thumbSize);
+
+    /* the exif is built before the stream is placed, so it needs the thumbnail */
+    if(!scaleYuyvBilinear((unsigned char *)yuvHeap->base(), width, height,
+                          (unsigned char *)thumbnailHeap->base(), thumbWidth, thumbHeight)) {
+        ret = UNKNOWN_ERROR;
+        CHECK_PICT(ret, "ERR(%s):Fail on scaleYuyvBilinear()", __FUNCTION__);
     }
 
-    return true;
+    {
+        CompressedImageSink sink(this, (unsigned char *)thumbnailHeap->base(),
+                                 width, height);
+        ret = mSecCamera->encodeJpeg((unsigned char *)yuvHeap->base(), width, height,
+                                     JPG_420, &sink, &jpegSize);
+        jpegMem = sink.finish();
+    }
+    CHECK_PICT(ret, "ERR(%s):Fail on SecCamera->encodeJpeg[%i]", __FUNCTION__, ret);
+
+    if ((mMsgEnabled & CAMERA_MSG_RAW_IMAGE_NOTIFY) && mNotifyCb) {
+        mNotifyCb(CAMERA_MSG_RAW_IMAGE_NOTIFY, 0, 0, mCallbackCookie);
+    }
+
+    if((mMsgEnabled & CAMERA_MSG_COMPRESSED_IMAGE) && mDataCb) {
+        mDataCb(CAMERA_MSG_COMPRESSED_IMAGE, jpegMem, 0, NULL, mCallbackCookie);
+    }
+
+out:
+    RELEASE_MEMORY_BUFFER(jpegMem);
+    return ret;
 }
 
 int CameraHardwareSec::pictureThread()
 {
     ALOGV("%s - start", __FUNCTION__);
+    SEC_TRACE_SCOPE("camera:picture");
+
+    if (mVideoSnapshot)
+        return videoSnapshotThread();
+    if (mZslCapture)
+        return zslPictureThread();
 
     int             ret = NO_ERROR;
     int             pictureWidth  = 0;
@@ -1023,14 +2546,7 @@ int CameraHardwareSec::pictureThread()
     int             thumbWidth = 0;
     int             thumbHeight = 0;
     int             thumbSize = 0;
-    unsigned int    picturePhyAddr = 0;
-
-    unsigned char*  jpegData = NULL;
-    unsigned int    jpegSize = 0;
-    /* * * * * * memory buffers * * * * * */
-    camera_memory_t*    jpegHeap = NULL;
-    sp<MemoryHeapBase>  postviewHeap = NULL;
-    sp<MemoryHeapBase>  thumbnailHeap = NULL;
+    bool            burst = mCaptureMode == BURST;
     struct addrs_cap*   addrs;
 
     mSecCamera->getSnapshotSize(&pictureWidth, &pictureHeight, &frameSize);
@@ -1041,10 +2557,26 @@ int CameraHardwareSec::pictureThread()
     addrs[0].width  = pictureWidth;
     addrs[0].height = pictureHeight;
 
-    ret = mSecCamera->beginSnapshot(mCaptureMode == BURST);
+    ret = mSecCamera->beginSnapshot(burst);
     CHECK_PICT(ret, "ERR(%s):Fail on SecCamera->beginSnapshot[%i]", __FUNCTION__, ret);
 
+    /* in a burst this thread only captures, the burst thread builds and
+     * delivers each shot while the sensor works on the next one
+     */
+    if (burst) {
+        mBurstHead = 0;
+        mBurstQueued = 0;
+        mBurstInFlight = 0;
+        mBurstDone = false;
+        if (mBurstThread->run("CameraBurstThread", PRIORITY_DEFAULT) != NO_ERROR) {
+            ret = INVALID_OPERATION;
+            CHECK_PICT(ret, "ERR(%s):couldn't run burst thread", __FUNCTION__);
+        }
+    }
+
     do {
+        CaptureFrame frame;
+
         if((mMsgEnabled & CAMERA_MSG_SHUTTER) && mNotifyCb) {
             mNotifyCb(CAMERA_MSG_SHUTTER, 0, 0, mCallbackCookie);
         }
@@ -1052,63 +2584,51 @@ int CameraHardwareSec::pictureThread()
         /* our back camera sensor has own jpeg encoder */
         if(mSecCamera->getCameraId() == SecCamera::CAMERA_ID_BACK &&
                     mSecCamera->getSnapshotPixelFormat() == V4L2_PIX_FMT_JPEG) {
-            ret = mSecCamera->getJpeg(&picturePhyAddr, &jpegData, &jpegSize);
+            ret = mSecCamera->getJpeg(&frame.phyAddr, &frame.jpegData, &frame.jpegSize,
+                                      &frame.index);
             CHECK_PICT(ret, "ERR(%s):Fail on SecCamera->getJpeg[%i]", __FUNCTION__, ret);
         } else {
-            jpegHeap = mGetMemoryCb(-1, frameSize, 1, 0);
-            postviewHeap = new MemoryHeapBase(postViewSize);
-            thumbnailHeap = new MemoryHeapBase(thumbSize);
-
-            ret = mSecCamera->getJpeg((unsigned char*)postviewHeap->base(),
-                                      (unsigned char*)jpegHeap->data, &jpegSize);
-            CHECK_PICT(ret, "ERR(%s):Fail on SecCamera->getSnapshotAndJpeg[%i]", __FUNCTION__, ret);
-
-            if(!scaleDownYuv422((char *)postviewHeap->base(), postViewWidth, postViewHeight,
-                                (char *)thumbnailHeap->base(), thumbWidth, thumbHeight)) {
-                CHECK_PICT(UNKNOWN_ERROR, "ERR(%s):Fail on scaleDownYuv422()", __FUNCTION__);
-            }
-        }
-
-        if((mMsgEnabled & CAMERA_MSG_RAW_IMAGE) && mDataCb) {
-            if(mSecCamera->getCameraId() == SecCamera::CAMERA_ID_BACK) {
-                if(picturePhyAddr != 0) {
-                    addrs[0].addr_y = picturePhyAddr;
-                }
+            frame.heapSlot = acquireCaptureHeaps(frameSize, postViewSize, thumbSize);
+            if (frame.heapSlot < 0)
+                ret = NO_MEMORY;
+            CHECK_PICT(ret, "ERR(%s):Fail on capture heap allocation", __FUNCTION__);
+            frame.jpegHeap = mCaptureHeaps[frame.heapSlot].jpegHeap;
+            frame.postviewHeap = mCaptureHeaps[frame.heapSlot].postviewHeap;
+            frame.thumbnailHeap = mCaptureHeaps[frame.heapSlot].thumbnailHeap;
+
+            // the postview is only copied out for a raw image callback
+            unsigned char *postview = NULL;
+            if (mMsgEnabled & CAMERA_MSG_RAW_IMAGE)
+                postview = (unsigned char*)frame.postviewHeap->base();
+
+            unsigned char *thumbnail = (unsigned char*)frame.thumbnailHeap->base();
+
+            /* a single shot is encoded straight into the memory the client
+             * gets, a burst keeps the heap so the next shot can start
+             */
+            if (!burst && (mMsgEnabled & CAMERA_MSG_COMPRESSED_IMAGE) && mDataCb) {
+                CompressedImageSink sink(this, thumbnail, 0, 0);
+                ret = mSecCamera->getJpeg(postview, &sink, &frame.jpegSize,
+                                          thumbnail, thumbWidth, thumbHeight);
+                frame.jpegMem = sink.finish();
             } else {
-                memcpy(mRawHeap->data, postviewHeap->base(), postViewSize);
+                ret = mSecCamera->getJpeg(postview,
+                                          (unsigned char*)frame.jpegHeap->data, &frame.jpegSize,
+                                          thumbnail, thumbWidth, thumbHeight);
             }
-
-            mDataCb(CAMERA_MSG_RAW_IMAGE, mRawHeap, 0, NULL, mCallbackCookie);
-        } else if ((mMsgEnabled & CAMERA_MSG_RAW_IMAGE_NOTIFY) && mNotifyCb) {
-            mNotifyCb(CAMERA_MSG_RAW_IMAGE_NOTIFY, 0, 0, mCallbackCookie);
-        }
-
-        if((mMsgEnabled & CAMERA_MSG_COMPRESSED_IMAGE) && mDataCb) {
-            camera_memory_t* jpegMem = NULL;
-            if(jpegData != NULL) {
-                jpegMem = mGetMemoryCb(-1, jpegSize, 1, 0);
-                memcpy(jpegMem->data, jpegData, jpegSize);
-            } else {
-                camera_memory_t* exifHeap =
-                        mGetMemoryCb(-1, EXIF_FILE_SIZE + JPG_STREAM_BUF_SIZE, 1, 0);
-                int jpegExifSize = mSecCamera->getExif((unsigned char *)exifHeap->data,
-                        (unsigned char *)thumbnailHeap->base());
-                if (jpegExifSize < 0) {
-                    ret = UNKNOWN_ERROR;
-                    RELEASE_MEMORY_BUFFER(exifHeap);
-                    goto out;
-                }
-
-                jpegMem = mGetMemoryCb(-1, jpegSize + jpegExifSize, 1, 0);
-                uint8_t *ptr = (uint8_t *) jpegMem->data;
-                memcpy(ptr, jpegHeap->data, 2); ptr += 2;
-                memcpy(ptr, exifHeap->data, jpegExifSize); ptr += jpegExifSize;
-                memcpy(ptr, (uint8_t *) jpegHeap->data + 2, jpegSize - 2);
-                RELEASE_MEMORY_BUFFER(exifHeap);
+            if (ret < 0) {
+                releaseCaptureFrame(frame);
+                CHECK_PICT(ret, "ERR(%s):Fail on SecCamera->getSnapshotAndJpeg[%i]",
+                           __FUNCTION__, ret);
             }
+        }
 
-            mDataCb(CAMERA_MSG_COMPRESSED_IMAGE, jpegMem, 0, NULL, mCallbackCookie);
-            RELEASE_MEMORY_BUFFER(jpegMem);
+        if (burst) {
+            queueBurstFrame(frame);
+        } else {
+            ret = deliverPicture(frame);
+            releaseCaptureFrame(frame);
+            CHECK_PICT(ret, "ERR(%s):Fail on deliverPicture[%i]", __FUNCTION__, ret);
         }
 
         mCaptureLock.lock();
@@ -1118,10 +2638,12 @@ int CameraHardwareSec::pictureThread()
         }
         mCaptureLock.unlock();
 
-    } while(mCaptureMode == BURST && ret == NO_ERROR);
+    } while(burst && ret == NO_ERROR);
 
 out:
-    RELEASE_MEMORY_BUFFER(jpegHeap);
+    /* the burst thread may still point into the capture buffers */
+    if (burst)
+        finishBurst();
     mSecCamera->endSnapshot();
     mCaptureLock.lock();
     mCaptureInProgress = false;
@@ -1133,6 +2655,206 @@ out:
     return ret;
 }
 
+/* send the raw and compressed image of one shot to the client */
+status_t CameraHardwareSec::deliverPicture(const CaptureFrame &frame)
+{
+    if((mMsgEnabled & CAMERA_MSG_RAW_IMAGE) && mDataCb) {
+        if(mSecCamera->getCameraId() == SecCamera::CAMERA_ID_BACK) {
+            if(frame.phyAddr != 0) {
+                struct addrs_cap *addrs = (struct addrs_cap *)mRawHeap->data;
+                addrs[0].addr_y = frame.phyAddr;
+            }
+        } else if (frame.postviewHeap != NULL) {
+            /* the postview heap is sized for the shot, the raw heap at setup */
+            size_t size = frame.postviewHeap->getSize();
+            if (size != mRawHeap->size)
+                ALOGW("%s: postview %d bytes, raw image %d bytes", __func__,
+                     size, mRawHeap->size);
+            memcpy(mRawHeap->data, frame.postviewHeap->base(),
+                   size < mRawHeap->size ? size : mRawHeap->size);
+        }
+
+        mDataCb(CAMERA_MSG_RAW_IMAGE, mRawHeap, 0, NULL, mCallbackCookie);
+    } else if ((mMsgEnabled & CAMERA_MSG_RAW_IMAGE_NOTIFY) && mNotifyCb) {
+        mNotifyCb(CAMERA_MSG_RAW_IMAGE_NOTIFY, 0, 0, mCallbackCookie);
+    }
+
+    if((mMsgEnabled & CAMERA_MSG_COMPRESSED_IMAGE) && mDataCb) {
+        if(frame.jpegMem != NULL) {
+            mDataCb(CAMERA_MSG_COMPRESSED_IMAGE, frame.jpegMem, 0, NULL, mCallbackCookie);
+        } else if(frame.jpegData != NULL) {
+            camera_memory_t* jpegMem = mGetMemoryCb(-1, frame.jpegSize, 1, 0);
+            memcpy(jpegMem->data, frame.jpegData, frame.jpegSize);
+            mDataCb(CAMERA_MSG_COMPRESSED_IMAGE, jpegMem, 0, NULL, mCallbackCookie);
+            RELEASE_MEMORY_BUFFER(jpegMem);
+        } else {
+            return sendCompressedImage(frame.jpegHeap, frame.jpegSize,
+                                       (unsigned char *)frame.thumbnailHeap->base(), 0, 0);
+        }
+    }
+
+    return NO_ERROR;
+}
+
+void CameraHardwareSec::releaseCaptureFrame(CaptureFrame &frame)
+{
+    if (frame.index >= 0) {
+        if (mSecCamera->releaseSnapshotFrame(frame.index) < 0)
+            ALOGE("ERR(%s):Fail on releaseSnapshotFrame(%d)", __func__, frame.index);
+        frame.index = -1;
+    }
+    if (frame.heapSlot >= 0) {
+        releaseCaptureHeaps(frame.heapSlot);
+        frame.heapSlot = -1;
+    }
+    RELEASE_MEMORY_BUFFER(frame.jpegMem);
+    frame.jpegHeap = NULL;
+    frame.jpegData = NULL;
+    frame.postviewHeap.clear();
+    frame.thumbnailHeap.clear();
+}
+
+/* hand out a set of capture heaps of the requested sizes.  idle sets of
+ * another size are dropped, so a geometry change frees the old heaps.
+ */
+int CameraHardwareSec::acquireCaptureHeaps(int jpegSize, int postviewSize,
+                                           int thumbnailSize)
+{
+    Mutex::Autolock lock(mCaptureHeapLock);
+    int slot = -1;
+
+    for (int i = 0; i < MAX_BURST_BUFFERS; i++) {
+        CaptureHeaps &heaps = mCaptureHeaps[i];
+
+        if (heaps.busy)
+            continue;
+        if (heaps.jpegSize != jpegSize ||
+            heaps.postviewSize != postviewSize ||
+            heaps.thumbnailSize != thumbnailSize) {
+            RELEASE_MEMORY_BUFFER(heaps.jpegHeap);
+            heaps.postviewHeap.clear();
+            heaps.thumbnailHeap.clear();
+            heaps.jpegSize = 0;
+            heaps.postviewSize = 0;
+            heaps.thumbnailSize = 0;
+        }
+        if (slot < 0 || (heaps.jpegHeap != NULL && mCaptureHeaps[slot].jpegHeap == NULL))
+            slot = i;
+    }
+    if (slot < 0) {
+        ALOGE("ERR(%s):all capture heaps are in use", __func__);
+        return -1;
+    }
+
+    CaptureHeaps &heaps = mCaptureHeaps[slot];
+    if (heaps.jpegHeap == NULL) {
+        heaps.jpegHeap = mGetMemoryCb(-1, jpegSize, 1, 0);
+        heaps.postviewHeap = new MemoryHeapBase(postviewSize);
+        heaps.thumbnailHeap = new MemoryHeapBase(thumbnailSize);
+        if (heaps.jpegHeap == NULL ||
+            heaps.postviewHeap->getHeapID() < 0 ||
+            heaps.thumbnailHeap->getHeapID() < 0) {
+            ALOGE("ERR(%s):Fail on capture heap allocation", __func__);
+            RELEASE_MEMORY_BUFFER(heaps.jpegHeap);
+            heaps.postviewHeap.clear();
+            heaps.thumbnailHeap.clear();
+            return -1;
+        }
+        heaps.jpegSize = jpegSize;
+        heaps.postviewSize = postviewSize;
+        heaps.thumbnailSize = thumbnailSize;
+    }
+    heaps.busy = true;
+    return slot;
+}
+
+void CameraHardwareSec::releaseCaptureHeaps(int slot)
+{
+    Mutex::Autolock lock(mCaptureHeapLock);
+    mCaptureHeaps[slot].busy = false;
+}
+
+void CameraHardwareSec::freeCaptureHeaps()
+{
+    Mutex::Autolock lock(mCaptureHeapLock);
+
+    for (int i = 0; i < MAX_BURST_BUFFERS; i++) {
+        CaptureHeaps &heaps = mCaptureHeaps[i];
+
+        RELEASE_MEMORY_BUFFER(heaps.jpegHeap);
+        heaps.postviewHeap.clear();
+        heaps.thumbnailHeap.clear();
+        heaps.jpegSize = 0;
+        heaps.postviewSize = 0;
+        heaps.thumbnailSize = 0;
+        heaps.busy = false;
+    }
+}
+
+/* blocks while every burst buffer but one is waiting for delivery */
+void CameraHardwareSec::queueBurstFrame(const CaptureFrame &frame)
+{
+    Mutex::Autolock lock(mBurstLock);
+
+    while (mBurstInFlight >= kBurstQueueSize)
+        mBurstCondition.wait(mBurstLock);
+
+    mBurstQueue[(mBurstHead + mBurstQueued) % kBurstQueueSize] = frame;
+    mBurstQueued++;
+    mBurstInFlight++;
+    mBurstCondition.broadcast();
+}
+
+/* let the burst thread drain the queue and wait for it */
+void CameraHardwareSec::finishBurst()
+{
+    mBurstLock.lock();
+    mBurstDone = true;
+    mBurstCondition.broadcast();
+    mBurstLock.unlock();
+
+    mBurstThread->requestExitAndWait();
+}
+
+int CameraHardwareSec::burstThread()
+{
+    ALOGV("%s - start", __FUNCTION__);
+
+    for (;;) {
+        CaptureFrame frame;
+
+        mBurstLock.lock();
+        while (mBurstQueued == 0 && !mBurstDone)
+            mBurstCondition.wait(mBurstLock);
+        if (mBurstQueued == 0) {
+            mBurstLock.unlock();
+            break;
+        }
+        frame = mBurstQueue[mBurstHead];
+        mBurstQueue[mBurstHead] = CaptureFrame();
+        mBurstHead = (mBurstHead + 1) % kBurstQueueSize;
+        mBurstQueued--;
+        mBurstLock.unlock();
+
+        // a cancelled burst only returns the buffers
+        mCaptureLock.lock();
+        bool cancel = mCaptureCancel;
+        mCaptureLock.unlock();
+        if (!cancel && deliverPicture(frame) != NO_ERROR)
+            ALOGE("ERR(%s):Fail on deliverPicture", __FUNCTION__);
+        releaseCaptureFrame(frame);
+
+        mBurstLock.lock();
+        mBurstInFlight--;
+        mBurstCondition.broadcast();
+        mBurstLock.unlock();
+    }
+
+    ALOGV("%s - end", __FUNCTION__);
+
+    return NO_ERROR;
+}
+
 status_t CameraHardwareSec::waitForCaptureCompletion(int msec) {
     nsecs_t endTime = (msec * 1000000LL) + systemTime(SYSTEM_TIME_MONOTONIC);
     Mutex::Autolock lock(mCaptureLock);
@@ -1165,7 +2887,16 @@ status_t CameraHardwareSec::takePicture()
     }
     mPreviewLock.unlock();
 #else
-    stopPreview();
+    /* while recording the picture comes from the record node, stopping
+     * the preview would end the recording
+     */
+    mVideoSnapshot = android_atomic_acquire_load(&mRecordRunning) != 0;
+    mZslCapture = !mVideoSnapshot && mZslEnabled && mPreviewRunning &&
+                  !mPreviewStartDeferred;
+    if (mZslCapture)
+        mZslShutterTime = systemTime(SYSTEM_TIME_MONOTONIC);
+    else if (!mVideoSnapshot)
+        stopPreview();
 #endif
 
     if (waitForCaptureCompletion() != NO_ERROR) {
@@ -1181,16 +2912,22 @@ status_t CameraHardwareSec::takePicture()
         }
     }
 
-    if (mPictureThread->run("CameraPictureThread", PRIORITY_DEFAULT) != NO_ERROR) {
-        ALOGE("%s : couldn't run picture thread", __func__);
-        return INVALID_OPERATION;
-    }
-
+    /* set before the thread runs, a burst checks for cancel from its
+     * first shot on
+     */
     mCaptureLock.lock();
     mCaptureCancel = false;
     mCaptureInProgress = true;
     mCaptureLock.unlock();
 
+    if (mPictureThread->run("CameraPictureThread", PRIORITY_DEFAULT) != NO_ERROR) {
+        ALOGE("%s : couldn't run picture thread", __func__);
+        mCaptureLock.lock();
+        mCaptureInProgress = false;
+        mCaptureLock.unlock();
+        return INVALID_OPERATION;
+    }
+
     return NO_ERROR;
 }
 
@@ -1201,7 +2938,6 @@ status_t CameraHardwareSec::cancelPicture()
     return NO_ERROR;
 }
 
-/*
 status_t CameraHardwareSec::dump(int fd, const Vector<String16>& args) const
 {
     const size_t SIZE = 256;
@@ -1209,18 +2945,49 @@ status_t CameraHardwareSec::dump(int fd, const Vector<String16>& args) const
     String8 result;
 
     if (mSecCamera != 0) {
-        mSecCamera->dump(fd, args);
         mParameters.dump(fd, args);
         mInternalParameters.dump(fd, args);
         snprintf(buffer, 255, " preview running(%s)\n", mPreviewRunning?"true": "false");
         result.append(buffer);
+        snprintf(buffer, 255, " preview zero copy(%s) callback drops(%d)\n",
+                 mPreviewZeroCopy ? "true" : "false", mCallbackDrops);
+        result.append(buffer);
+        snprintf(buffer, 255, " preview window buffers(%d) extra(%d)\n",
+                 mWindowBufferCount, mWindowExtraBuffers);
+        result.append(buffer);
+        gFirstFrameStatsLock.lock();
+        snprintf(buffer, 255, " first preview frame %lld ms after open\n",
+                 ns2ms(mFirstFrameLatency));
+        result.append(buffer);
+        gFirstFrameStats.dump(result);
+        gFirstFrameStatsLock.unlock();
+        mWatchdogLock.lock();
+        snprintf(buffer, 255, " sensor %s, recoveries(%u) failed(%u)\n",
+                 mWatchdogState == WATCHDOG_IDLE ? "running" : "recovering",
+                 mRecoveryCount, mRecoveryFailures);
+        result.append(buffer);
+        mRecoveryStats.dump(result);
+        mWatchdogLock.unlock();
+        mAutoFocusStats.dump(result);
+        snprintf(buffer, 255, " preview rate governor(%s) %d of %d fps, 1 of %d frames, changes(%u)\n",
+                 mGovernorEnabled ? "on" : "off", mGovernorFps, mGovernorNominalFps,
+                 mFrameDecimation, mGovernorChanges);
+        result.append(buffer);
+        result.append(" preview latency:\n");
+        mSecCamera->dumpPreviewStats(result);
+        for (int i = 0; i < STAGE_MAX; i++)
+            mPreviewStats[i].dump(result);
+        if (mLatencyStats[LATENCY_DEQUEUE].count()) {
+            result.append(" latency probe:\n");
+            for (int i = 0; i < LATENCY_MAX; i++)
+                mLatencyStats[i].dump(result);
+        }
     } else {
         result.append("No camera client yet.\n");
     }
     write(fd, result.string(), result.size());
     return NO_ERROR;
 }
-*/
 
 bool CameraHardwareSec::isSupportedPreviewSize(const int width,
                                                const int height) const
@@ -1245,6 +3012,17 @@ status_t CameraHardwareSec::setParameters(const char *parameters)
 {
     ALOGV("%s :", __func__);
 
+    /* most apps hand back what getParameters() gave them with one key
+     * changed, or with none
+     */
+    {
+        Mutex::Autolock lock(mZoomLock);
+        if (mParametersSynced && mCaptureMode == SNAPSHOT &&
+                mFlatParametersValid && mFlatZoomLevel == mZoomLevel &&
+                !strcmp(parameters, mFlatParameters.string()))
+            return NO_ERROR;
+    }
+
     CameraParameters params;
 
     String8 str_params(parameters);
@@ -1266,6 +3044,11 @@ status_t CameraHardwareSec::setParameters(const CameraParameters& params)
         return TIMED_OUT;
     }
 
+    /* keys equal to mParameters are skipped below, sensor controls that do
+     * change are queued and sent together at the end
+     */
+    mSecCamera->beginControlBatch();
+
     // preview size
     int new_preview_width  = 0;
     int new_preview_height = 0;
@@ -1326,6 +3109,78 @@ status_t CameraHardwareSec::setParameters(const CameraParameters& params)
         mCaptureMode = SNAPSHOT;
     }
 
+    // zero shutter lag
+    const char *zsl = params.get(SecCameraParameters::KEY_ZSL);
+    if (zsl != NULL) {
+        mZslEnabled = !strcmp(zsl, SecCameraParameters::TRUE);
+        mParameters.set(SecCameraParameters::KEY_ZSL, mZslEnabled ?
+                        SecCameraParameters::TRUE : SecCameraParameters::FALSE);
+    }
+
+    // preview callbacks, a new size is taken at the next startPreview()
+    const char *cb_size = params.get(SecCameraParameters::KEY_PREVIEW_CALLBACK_SIZE);
+    if (cb_size != NULL && cb_size[0]) {
+        int cb_width = 0, cb_height = 0;
+        if (sscanf(cb_size, "%dx%d", &cb_width, &cb_height) != 2 ||
+            cb_width < 2 || cb_height < 2 || ((cb_width | cb_height) & 1)) {
+            ALOGE("%s: Invalid preview callback size(%s)", __func__, cb_size);
+            ret = BAD_VALUE;
+        } else {
+            mParameters.set(SecCameraParameters::KEY_PREVIEW_CALLBACK_SIZE, cb_size);
+        }
+    } else {
+        mParameters.remove(SecCameraParameters::KEY_PREVIEW_CALLBACK_SIZE);
+    }
+
+    const char *cb_format = params.get(SecCameraParameters::KEY_PREVIEW_CALLBACK_FORMAT);
+    if (cb_format != NULL && cb_format[0]) {
+        if (!strcmp(cb_format, SecCameraParameters::PIXEL_FORMAT_YUV420SP) ||
+            !strcmp(cb_format, SecCameraParameters::PIXEL_FORMAT_YUV420P)) {
+            mParameters.set(SecCameraParameters::KEY_PREVIEW_CALLBACK_FORMAT, cb_format);
+        } else {
+            ALOGE("%s: Invalid preview callback format(%s)", __func__, cb_format);
+            ret = BAD_VALUE;
+        }
+    } else {
+        mParameters.remove(SecCameraParameters::KEY_PREVIEW_CALLBACK_FORMAT);
+    }
+    cb_format = mParameters.get(SecCameraParameters::KEY_PREVIEW_CALLBACK_FORMAT);
+    if (cb_format == NULL)
+        cb_format = mParameters.getPreviewFormat();
+    mCallbackNV21 = cb_format == NULL ||
+                    strcmp(cb_format, SecCameraParameters::PIXEL_FORMAT_YUV420P) != 0;
+
+    // 0 or unset delivers every frame
+    int cb_fps = params.getInt(SecCameraParameters::KEY_PREVIEW_CALLBACK_FPS);
+    if (cb_fps > 0) {
+        mCallbackInterval = 1000000000LL / cb_fps;
+        mParameters.set(SecCameraParameters::KEY_PREVIEW_CALLBACK_FPS, cb_fps);
+    } else {
+        mCallbackInterval = 0;
+        mParameters.remove(SecCameraParameters::KEY_PREVIEW_CALLBACK_FPS);
+    }
+
+    // encoders sharing the record frames, taken with the next frame
+    const char *video_consumers = params.get(SecCameraParameters::KEY_VIDEO_CONSUMERS);
+    if (video_consumers != NULL) {
+        int consumers = atoi(video_consumers);
+        if (consumers < 1 || kMaxVideoConsumers < consumers) {
+            ALOGE("%s: Invalid video consumers(%s)", __func__, video_consumers);
+            ret = BAD_VALUE;
+        } else {
+            mVideoConsumers = consumers;
+            mParameters.set(SecCameraParameters::KEY_VIDEO_CONSUMERS, consumers);
+        }
+    }
+
+    // recording hint
+    const char *recording_hint = params.get(SecCameraParameters::KEY_RECORDING_HINT);
+    if (recording_hint != NULL) {
+        mRecordingHint = !strcmp(recording_hint, SecCameraParameters::TRUE);
+        mParameters.set(SecCameraParameters::KEY_RECORDING_HINT, mRecordingHint ?
+                        SecCameraParameters::TRUE : SecCameraParameters::FALSE);
+    }
+
     // picture format
     const char *new_str_picture_format = params.getPictureFormat();
     ALOGV("%s : new_str_picture_format %s", __func__, new_str_picture_format);
@@ -1366,7 +3221,8 @@ status_t CameraHardwareSec::setParameters(const CameraParameters& params)
     int new_jpeg_quality = params.getInt(SecCameraParameters::KEY_JPEG_QUALITY);
     ALOGV("%s : new_jpeg_quality %d", __func__, new_jpeg_quality);
     /* we ignore bad values */
-    if (new_jpeg_quality >=1 && new_jpeg_quality <= 100) {
+    if (new_jpeg_quality >=1 && new_jpeg_quality <= 100 &&
+        isParameterChanged(params, SecCameraParameters::KEY_JPEG_QUALITY)) {
         if (mSecCamera->setJpegQuality(new_jpeg_quality) < 0) {
             ALOGE("ERR(%s):Fail on mSecCamera->setJpegQuality(quality(%d))", __func__, new_jpeg_quality);
             ret = UNKNOWN_ERROR;
@@ -1378,7 +3234,9 @@ status_t CameraHardwareSec::setParameters(const CameraParameters& params)
     // JPEG thumbnail size
     int new_jpeg_thumbnail_width = params.getInt(SecCameraParameters::KEY_JPEG_THUMBNAIL_WIDTH);
     int new_jpeg_thumbnail_height= params.getInt(SecCameraParameters::KEY_JPEG_THUMBNAIL_HEIGHT);
-    if (0 <= new_jpeg_thumbnail_width && 0 <= new_jpeg_thumbnail_height) {
+    if (0 <= new_jpeg_thumbnail_width && 0 <= new_jpeg_thumbnail_height &&
+        (isParameterChanged(params, SecCameraParameters::KEY_JPEG_THUMBNAIL_WIDTH) ||
+         isParameterChanged(params, SecCameraParameters::KEY_JPEG_THUMBNAIL_HEIGHT))) {
         if (mSecCamera->setJpegThumbnailSize(new_jpeg_thumbnail_width, new_jpeg_thumbnail_height) < 0) {
             ALOGE("ERR(%s):Fail on mSecCamera->setJpegThumbnailSize(width(%d), height(%d))", __func__, new_jpeg_thumbnail_width, new_jpeg_thumbnail_height);
             ret = UNKNOWN_ERROR;
@@ -1401,7 +3259,7 @@ status_t CameraHardwareSec::setParameters(const CameraParameters& params)
     // rotation
     int new_rotation = params.getInt(SecCameraParameters::KEY_ROTATION);
     ALOGV("%s : new_rotation %d", __func__, new_rotation);
-    if (0 <= new_rotation) {
+    if (0 <= new_rotation && isParameterChanged(params, SecCameraParameters::KEY_ROTATION)) {
         ALOGV("%s : set orientation:%d\n", __func__, new_rotation);
         if (mSecCamera->setExifOrientationInfo(new_rotation) < 0) {
             ALOGE("ERR(%s):Fail on mSecCamera->setExifOrientationInfo(%d)", __func__, new_rotation);
@@ -1415,15 +3273,31 @@ status_t CameraHardwareSec::setParameters(const CameraParameters& params)
     int new_zoom = params.getInt(SecCameraParameters::KEY_ZOOM);
     int max_zoom = params.getInt(SecCameraParameters::KEY_MAX_ZOOM);
     ALOGV("%s : new_zoom %d", __func__, new_zoom);
-    if (0 <= new_zoom && new_zoom <= max_zoom) {
+    mZoomLock.lock();
+    // a smooth zoom moves the level behind mParameters' back
+    mParameters.set(SecCameraParameters::KEY_ZOOM, mZoomLevel);
+    // the smooth zoom owns the level until it stops
+    if (0 <= new_zoom && new_zoom <= max_zoom && !mSmoothZoom &&
+        isParameterChanged(params, SecCameraParameters::KEY_ZOOM)) {
+        int step = new_zoom - mZoomLevel;
+        int zoom_ret;
+
         ALOGV("%s : set zoom:%d\n", __func__, new_zoom);
-        if (mSecCamera->setZoom(new_zoom) < 0) {
-            ALOGE("ERR(%s):Fail on mSecCamera->setZoom(%d)", __func__, new_zoom);
+        if (step > kZoomSensorJump || step < -kZoomSensorJump) {
+            // a jump is worth the sensor settle time for its quality
+            zoom_ret = mSecCamera->setZoom(new_zoom);
+        } else {
+            zoom_ret = mSecCamera->setZoomRatio(SecCamera::zoomLevelRatio(new_zoom));
+        }
+        if (zoom_ret < 0) {
+            ALOGE("ERR(%s):Fail on zoom to %d", __func__, new_zoom);
             ret = UNKNOWN_ERROR;
         } else {
+            mZoomLevel = new_zoom;
             mParameters.set(SecCameraParameters::KEY_ZOOM, new_zoom);
         }
     }
+    mZoomLock.unlock();
 
     // brightness
     int new_exposure_compensation = params.getInt(SecCameraParameters::KEY_EXPOSURE_COMPENSATION);
@@ -1431,7 +3305,8 @@ status_t CameraHardwareSec::setParameters(const CameraParameters& params)
     int min_exposure_compensation = params.getInt(SecCameraParameters::KEY_MIN_EXPOSURE_COMPENSATION);
     ALOGV("%s : new_exposure_compensation %d", __func__, new_exposure_compensation);
     if ((min_exposure_compensation <= new_exposure_compensation) &&
-        (max_exposure_compensation >= new_exposure_compensation)) {
+        (max_exposure_compensation >= new_exposure_compensation) &&
+        isParameterChanged(params, SecCameraParameters::KEY_EXPOSURE_COMPENSATION)) {
         if (mSecCamera->setBrightness(new_exposure_compensation) < 0) {
             ALOGE("ERR(%s):Fail on mSecCamera->setBrightness(brightness(%d))", __func__, new_exposure_compensation);
             ret = UNKNOWN_ERROR;
@@ -1446,7 +3321,8 @@ status_t CameraHardwareSec::setParameters(const CameraParameters& params)
     int min_contrast = params.getInt(SecCameraParameters::KEY_MIN_CONTRAST);
     ALOGV("%s : new_exposure_compensation %d", __func__, new_exposure_compensation);
     if ((min_contrast <= new_contrast) &&
-        (max_contrast >= new_contrast)) {
+        (max_contrast >= new_contrast) &&
+        isParameterChanged(params, SecCameraParameters::KEY_CONTRAST)) {
         if (mSecCamera->setContrast(new_contrast) < 0) {
             ALOGE("ERR(%s):Fail on mSecCamera->setContrast(brightness(%d))", __func__, new_exposure_compensation);
             ret = UNKNOWN_ERROR;
@@ -1458,7 +3334,8 @@ status_t CameraHardwareSec::setParameters(const CameraParameters& params)
     // whitebalance
     const char *new_white_str = params.get(SecCameraParameters::KEY_WHITE_BALANCE);
     ALOGV("%s : new_white_str %s", __func__, new_white_str);
-    if (new_white_str != NULL) {
+    if (new_white_str != NULL &&
+        isParameterChanged(params, SecCameraParameters::KEY_WHITE_BALANCE)) {
         int new_white = -1;
 
         if (!strcmp(new_white_str, SecCameraParameters::WHITE_BALANCE_AUTO))
@@ -1492,7 +3369,7 @@ status_t CameraHardwareSec::setParameters(const CameraParameters& params)
 
     // iso mode
     const char *new_iso_str = params.get(SecCameraParameters::KEY_ISO);
-    if (new_iso_str != NULL) {
+    if (new_iso_str != NULL && isParameterChanged(params, SecCameraParameters::KEY_ISO)) {
         int  new_iso = -1;
 
         if (!strcmp(new_iso_str, SecCameraParameters::ISO_AUTO)) {
@@ -1701,7 +3578,8 @@ status_t CameraHardwareSec::setParameters(const CameraParameters& params)
 
     // image effect
     const char *new_image_effect_str = params.get(SecCameraParameters::KEY_EFFECT);
-    if (new_image_effect_str != NULL) {
+    if (new_image_effect_str != NULL &&
+        isParameterChanged(params, SecCameraParameters::KEY_EFFECT)) {
         int  new_image_effect = -1;
 
         if (!strcmp(new_image_effect_str, SecCameraParameters::EFFECT_NONE))
@@ -1772,66 +3650,76 @@ status_t CameraHardwareSec::setParameters(const CameraParameters& params)
 
     // gps latitude
     const char *new_gps_latitude_str = params.get(SecCameraParameters::KEY_GPS_LATITUDE);
-    if (mSecCamera->setGPSLatitude(new_gps_latitude_str) < 0) {
-        ALOGE("%s::mSecCamera->setGPSLatitude(%s) fail", __func__, new_gps_latitude_str);
-        ret = UNKNOWN_ERROR;
-    } else {
-        if (new_gps_latitude_str) {
-            mParameters.set(SecCameraParameters::KEY_GPS_LATITUDE, new_gps_latitude_str);
+    if (isParameterChanged(params, SecCameraParameters::KEY_GPS_LATITUDE)) {
+        if (mSecCamera->setGPSLatitude(new_gps_latitude_str) < 0) {
+            ALOGE("%s::mSecCamera->setGPSLatitude(%s) fail", __func__, new_gps_latitude_str);
+            ret = UNKNOWN_ERROR;
         } else {
-            mParameters.remove(SecCameraParameters::KEY_GPS_LATITUDE);
+            if (new_gps_latitude_str) {
+                mParameters.set(SecCameraParameters::KEY_GPS_LATITUDE, new_gps_latitude_str);
+            } else {
+                mParameters.remove(SecCameraParameters::KEY_GPS_LATITUDE);
+            }
         }
     }
 
     // gps longitude
     const char *new_gps_longitude_str = params.get(SecCameraParameters::KEY_GPS_LONGITUDE);
-    if (mSecCamera->setGPSLongitude(new_gps_longitude_str) < 0) {
-        ALOGE("%s::mSecCamera->setGPSLongitude(%s) fail", __func__, new_gps_longitude_str);
-        ret = UNKNOWN_ERROR;
-    } else {
-        if (new_gps_longitude_str) {
-            mParameters.set(SecCameraParameters::KEY_GPS_LONGITUDE, new_gps_longitude_str);
+    if (isParameterChanged(params, SecCameraParameters::KEY_GPS_LONGITUDE)) {
+        if (mSecCamera->setGPSLongitude(new_gps_longitude_str) < 0) {
+            ALOGE("%s::mSecCamera->setGPSLongitude(%s) fail", __func__, new_gps_longitude_str);
+            ret = UNKNOWN_ERROR;
         } else {
-            mParameters.remove(SecCameraParameters::KEY_GPS_LONGITUDE);
+            if (new_gps_longitude_str) {
+                mParameters.set(SecCameraParameters::KEY_GPS_LONGITUDE, new_gps_longitude_str);
+            } else {
+                mParameters.remove(SecCameraParameters::KEY_GPS_LONGITUDE);
+            }
         }
     }
 
     // gps altitude
     const char *new_gps_altitude_str = params.get(SecCameraParameters::KEY_GPS_ALTITUDE);
-    if (mSecCamera->setGPSAltitude(new_gps_altitude_str) < 0) {
-        ALOGE("%s::mSecCamera->setGPSAltitude(%s) fail", __func__, new_gps_altitude_str);
-        ret = UNKNOWN_ERROR;
-    } else {
-        if (new_gps_altitude_str) {
-            mParameters.set(SecCameraParameters::KEY_GPS_ALTITUDE, new_gps_altitude_str);
+    if (isParameterChanged(params, SecCameraParameters::KEY_GPS_ALTITUDE)) {
+        if (mSecCamera->setGPSAltitude(new_gps_altitude_str) < 0) {
+            ALOGE("%s::mSecCamera->setGPSAltitude(%s) fail", __func__, new_gps_altitude_str);
+            ret = UNKNOWN_ERROR;
         } else {
-            mParameters.remove(SecCameraParameters::KEY_GPS_ALTITUDE);
+            if (new_gps_altitude_str) {
+                mParameters.set(SecCameraParameters::KEY_GPS_ALTITUDE, new_gps_altitude_str);
+            } else {
+                mParameters.remove(SecCameraParameters::KEY_GPS_ALTITUDE);
+            }
         }
     }
 
     // gps timestamp
     const char *new_gps_timestamp_str = params.get(SecCameraParameters::KEY_GPS_TIMESTAMP);
-    if (mSecCamera->setGPSTimeStamp(new_gps_timestamp_str) < 0) {
-        ALOGE("%s::mSecCamera->setGPSTimeStamp(%s) fail", __func__, new_gps_timestamp_str);
-        ret = UNKNOWN_ERROR;
-    } else {
-        if (new_gps_timestamp_str) {
-            mParameters.set(SecCameraParameters::KEY_GPS_TIMESTAMP, new_gps_timestamp_str);
+    if (isParameterChanged(params, SecCameraParameters::KEY_GPS_TIMESTAMP)) {
+        if (mSecCamera->setGPSTimeStamp(new_gps_timestamp_str) < 0) {
+            ALOGE("%s::mSecCamera->setGPSTimeStamp(%s) fail", __func__, new_gps_timestamp_str);
+            ret = UNKNOWN_ERROR;
         } else {
-            mParameters.remove(SecCameraParameters::KEY_GPS_TIMESTAMP);
+            if (new_gps_timestamp_str) {
+                mParameters.set(SecCameraParameters::KEY_GPS_TIMESTAMP, new_gps_timestamp_str);
+            } else {
+                mParameters.remove(SecCameraParameters::KEY_GPS_TIMESTAMP);
+            }
         }
     }
 
     // gps processing method
     const char *new_gps_processing_method_str = params.get(SecCameraParameters::KEY_GPS_PROCESSING_METHOD);
-    if (mSecCamera->setGPSProcessingMethod(new_gps_processing_method_str) < 0) {
-        ALOGE("%s::mSecCamera->setGPSProcessingMethod(%s) fail", __func__, new_gps_processing_method_str);
-        ret = UNKNOWN_ERROR;
-    } else {
-        if (new_gps_processing_method_str) {
-            mParameters.set(SecCameraParameters::KEY_GPS_PROCESSING_METHOD, new_gps_processing_method_str);
+    if (isParameterChanged(params, SecCameraParameters::KEY_GPS_PROCESSING_METHOD)) {
+        if (mSecCamera->setGPSProcessingMethod(new_gps_processing_method_str) < 0) {
+            ALOGE("%s::mSecCamera->setGPSProcessingMethod(%s) fail", __func__, new_gps_processing_method_str);
+            ret = UNKNOWN_ERROR;
         } else {
-            mParameters.remove(SecCameraParameters::KEY_GPS_PROCESSING_METHOD);
+            if (new_gps_processing_method_str) {
+                mParameters.set(SecCameraParameters::KEY_GPS_PROCESSING_METHOD, new_gps_processing_method_str);
+            } else {
+                mParameters.remove(SecCameraParameters::KEY_GPS_PROCESSING_METHOD);
+            }
         }
     }
 
@@ -1963,6 +3851,25 @@ status_t CameraHardwareSec::setParameters(const CameraParameters& params)
         }
     }
 
+    if (mSecCamera->commitControlBatch() < 0) {
+        ALOGE("ERR(%s):Fail on mSecCamera->commitControlBatch()", __func__);
+        ret = UNKNOWN_ERROR;
+    }
+    if (ret == NO_ERROR)
+        mParametersSynced = true;
+
+    mZoomLock.lock();
+    mFlatParametersValid = false;
+    mZoomLock.unlock();
+
+    // the governor must stay inside the new fps range
+    mParameters.getPreviewFpsRange(&mGovernorMinFps, &mGovernorMaxFps);
+
+    // recording size and hint are known now
+    mRecordLock.lock();
+    prepareRecording_l(mPreviewRunning && !mPreviewStartDeferred);
+    mRecordLock.unlock();
+
     // galaxys ce147 need this
     mPreviewLock.lock();
     if(ret == NO_ERROR && mPreviewRunning) {
@@ -1975,18 +3882,44 @@ status_t CameraHardwareSec::setParameters(const CameraParameters& params)
     return ret;
 }
 
+/* true if key was not applied with this value by an earlier setParameters() */
+bool CameraHardwareSec::isParameterChanged(const CameraParameters& params,
+                                           const char *key) const
+{
+    if (!mParametersSynced)
+        return true;
+
+    const char *new_value = params.get(key);
+    const char *cur_value = mParameters.get(key);
+    if (new_value == NULL || cur_value == NULL)
+        return new_value != cur_value;
+
+    return strcmp(new_value, cur_value) != 0;
+}
+
 char* CameraHardwareSec::getParameters() const
 {
-    String8     params_str8;
     char*       params_str;
 
     ALOGV("%s :", __func__);
 
-    params_str8 = mParameters.flatten();
-    
+    Mutex::Autolock lock(mZoomLock);
+    if (!mFlatParametersValid || mFlatZoomLevel != mZoomLevel) {
+        if (mParameters.getInt(SecCameraParameters::KEY_ZOOM) != mZoomLevel) {
+            CameraParameters params = mParameters;
+            params.set(SecCameraParameters::KEY_ZOOM, mZoomLevel);
+            mFlatParameters = params.flatten();
+        } else {
+            mFlatParameters = mParameters.flatten();
+        }
+        mFlatZoomLevel = mZoomLevel;
+        mFlatParametersValid = true;
+    }
+
     // camera service frees this string...
-    params_str = (char*) malloc(sizeof(char) * (params_str8.length() + 1));
-    strcpy(params_str, params_str8.string());
+    params_str = (char*) malloc(sizeof(char) * (mFlatParameters.length() + 1));
+    if (params_str != NULL)
+        memcpy(params_str, mFlatParameters.string(), mFlatParameters.length() + 1);
 
     return params_str;
 }
@@ -2010,6 +3943,12 @@ status_t CameraHardwareSec::sendCommand(int32_t command, int32_t arg1, int32_t a
         case CAMERA_CMD_STOP_FACE_DETECTION:
             return stopFaceDetection();
 
+        case CAMERA_CMD_START_SMOOTH_ZOOM:
+            return startSmoothZoom(arg1);
+
+        case CAMERA_CMD_STOP_SMOOTH_ZOOM:
+            return stopSmoothZoom();
+
         default:
             ALOGE("Command [%i] isn't supported", command);
             break;
@@ -2041,6 +3980,16 @@ void CameraHardwareSec::release()
         mPreviewThread.clear();
         mPreviewThread = NULL;
     }
+    if (mWatchdogThread != NULL) {
+        mWatchdogLock.lock();
+        mWatchdogThread->requestExit();
+        mExitWatchdogThread = true;
+        mWatchdogCondition.broadcast();
+        mWatchdogLock.unlock();
+        mWatchdogThread->requestExitAndWait();
+        mWatchdogThread.clear();
+        mWatchdogThread = NULL;
+    }
     if (mAutoFocusThread != NULL) {
         /* this thread is normally already in it's threadLoop but blocked
          * on the condition variable.  signal it so it wakes up and can exit.
@@ -2059,10 +4008,30 @@ void CameraHardwareSec::release()
         mPictureThread.clear();
         mPictureThread = NULL;
     }
+    if (mBurstThread != NULL) {
+        mBurstThread->requestExitAndWait();
+        mBurstThread.clear();
+        mBurstThread = NULL;
+    }
+    if (mCallbackThread != NULL) {
+        mCallbackThread->requestExit();
+        mExitCallbackThread = true;
+        sem_post(&mCallbackSem);
+        mCallbackThread->requestExitAndWait();
+        mCallbackThread.clear();
+        mCallbackThread = NULL;
+        sem_destroy(&mCallbackSem);
+    }
 
     RELEASE_MEMORY_BUFFER(mRawHeap);
     RELEASE_MEMORY_BUFFER(mPreviewMemory);
+    RELEASE_MEMORY_BUFFER(mPreviewCbHeap);
     RELEASE_MEMORY_BUFFER(mRecordHeap);
+    RELEASE_MEMORY_BUFFER(mVideoSnapshotHeap);
+    RELEASE_MEMORY_BUFFER(mFaceMetadataHeap);
+    releaseZslFrames();
+    freeCaptureHeaps();
+    RELEASE_MEMORY_BUFFER(mExifHeap);
 
     /* close after all the heaps are cleared since those
      * could have dup'd our file descriptor.
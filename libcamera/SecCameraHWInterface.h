@@ -23,6 +23,7 @@
 #include "SecCameraParameters.h"
 
 #include <utils/threads.h>
+#include <semaphore.h>
 #include <utils/RefBase.h>
 #include <binder/MemoryBase.h>
 #include <binder/MemoryHeapBase.h>
@@ -61,6 +62,9 @@ public:
     status_t    startFaceDetection();
     status_t    stopFaceDetection();
 
+    status_t    startSmoothZoom(int level);
+    status_t    stopSmoothZoom();
+
     status_t    init();
     status_t    autoFocus();
     status_t    cancelAutoFocus();
@@ -73,9 +77,45 @@ public:
     status_t    sendCommand(int32_t command, int32_t arg1,
                                     int32_t arg2);
     void        release();
+    status_t    dump(int fd, const Vector<String16>& args) const;
 
 private:
     static  const int   kBufferCount = MAX_BUFFERS;
+    /* one callback slot is being filled and one delivered */
+    static  const int   kCallbackQueueMax = kBufferCount - 2;
+    static  const int   kCallbackRingSize = 8;
+    /* window buffers at most and the memory they may take together */
+    static  const int   kMaxWindowBuffers = kBufferCount + 2;
+    static  const int   kWindowBufferBudget = 8 * 1024 * 1024;
+    /* smooth zoom moves the crop this much (ratio x100) a frame, a KEY_ZOOM
+     * change of more levels than kZoomSensorJump goes to the sensor
+     */
+    static  const int   kSmoothZoomStep = 5;
+    static  const int   kZoomSensorJump = 3;
+    /* encoders that may share a record frame, the MFC fits two at 720p */
+    static  const int   kMaxVideoConsumers = 2;
+
+    /* preview stages timed for dump(), poll and dqbuf are in SecCamera */
+    enum PreviewStage {
+        STAGE_WINDOW_DEQUEUE,
+        STAGE_GRALLOC_LOCK,
+        STAGE_COPY,
+        STAGE_CALLBACK_COPY,
+        STAGE_CALLBACK,
+        STAGE_WINDOW_ENQUEUE,
+        STAGE_FRAME,
+        STAGE_MAX
+    };
+    static const char   *kPreviewStageNames[STAGE_MAX];
+
+    /* capture to each stage for the latency probe, see sec_latency.h */
+    enum LatencyStage {
+        LATENCY_DEQUEUE,
+        LATENCY_PREVIEW,
+        LATENCY_RECORD,
+        LATENCY_MAX
+    };
+    static const char   *kLatencyStageNames[LATENCY_MAX];
 
     enum CaptureMode {
         INVALID,
@@ -110,6 +150,99 @@ private:
         }
     };
 
+    class BurstThread : public Thread {
+        CameraHardwareSec *mHardware;
+    public:
+        BurstThread(CameraHardwareSec *hw):
+        Thread(false),
+        mHardware(hw) { }
+        virtual bool threadLoop() {
+            mHardware->burstThread();
+            return false;
+        }
+    };
+
+    /* one captured shot on its way to the client */
+    struct CaptureFrame {
+        int                 index;
+        unsigned int        phyAddr;
+        unsigned char*      jpegData;
+        unsigned int        jpegSize;
+        int                 heapSlot;
+        camera_memory_t*    jpegHeap;
+        camera_memory_t*    jpegMem;
+        sp<MemoryHeapBase>  postviewHeap;
+        sp<MemoryHeapBase>  thumbnailHeap;
+
+        CaptureFrame() :
+            index(-1), phyAddr(0), jpegData(NULL), jpegSize(0), heapSlot(-1),
+            jpegHeap(NULL), jpegMem(NULL) { }
+    };
+
+    /* builds the client jpeg in place: the encoder output lands behind
+     * room for the exif, which then replaces the stream's SOI marker
+     */
+    class CompressedImageSink : public SecJpegSink {
+    public:
+        CompressedImageSink(CameraHardwareSec *hw, unsigned char *thumbnail,
+                            int width, int height) :
+            mHardware(hw), mThumbnail(thumbnail), mWidth(width), mHeight(height),
+            mMem(NULL), mExifSize(0) { }
+        virtual ~CompressedImageSink();
+        virtual unsigned char *getBuffer(unsigned int size);
+        /* the finished jpeg, owned by the caller from here on */
+        camera_memory_t *finish();
+    private:
+        CameraHardwareSec   *mHardware;
+        unsigned char       *mThumbnail;
+        int                 mWidth;
+        int                 mHeight;
+        camera_memory_t     *mMem;
+        int                 mExifSize;
+    };
+
+    /* software jpeg heaps kept between shots, one set per shot in flight */
+    struct CaptureHeaps {
+        camera_memory_t*    jpegHeap;
+        sp<MemoryHeapBase>  postviewHeap;
+        sp<MemoryHeapBase>  thumbnailHeap;
+        int                 jpegSize;
+        int                 postviewSize;
+        int                 thumbnailSize;
+        bool                busy;
+    };
+    /* keep one buffer queued so the sensor never stalls in a burst */
+    static  const int   kBurstQueueSize = MAX_BURST_BUFFERS - 1;
+
+    class CallbackThread : public Thread {
+        CameraHardwareSec *mHardware;
+    public:
+        CallbackThread(CameraHardwareSec *hw):
+        Thread(false),
+        mHardware(hw) { }
+        virtual void onFirstRef() {
+            run("CameraCallbackThread", PRIORITY_DEFAULT);
+        }
+        virtual bool threadLoop() {
+            mHardware->callbackThread();
+            return false;
+        }
+    };
+
+    /* restarts a hung sensor off the preview thread */
+    class WatchdogThread : public Thread {
+        CameraHardwareSec *mHardware;
+    public:
+        WatchdogThread(CameraHardwareSec *hw): Thread(false), mHardware(hw) { }
+        virtual void onFirstRef() {
+            run("CameraWatchdogThread", PRIORITY_DEFAULT);
+        }
+        virtual bool threadLoop() {
+            mHardware->watchdogThread();
+            return true;
+        }
+    };
+
     class AutoFocusThread : public Thread {
         CameraHardwareSec *mHardware;
     public:
@@ -124,14 +257,52 @@ private:
     };
 
     void                initDefaultParameters(int cameraId);
+    void                buildDefaultParameters(int cameraId, CameraParameters& p,
+                                               CameraParameters& ip);
 
     status_t            startPreview_l();
+    void                prepareRecording_l(bool previewing);
     void                stopPreview_l();
 
+            int         windowBufferCount(int min_bufs, int width, int height) const;
+            status_t    setWindowBufferCount_l(bool adapt);
+            status_t    initPreviewBuffers_l();
+            void        freePreviewBuffers_l();
+            status_t    queuePreviewBuffer(int index);
+            void        fillPreviewCallbackFrame(int index, char *y, char *u, char *v,
+                                                 int width, int height);
+
     sp<PreviewThread>   mPreviewThread;
             int         previewThread();
+            int         previewFrame();
+            int         recordFrame();
             int         previewThreadWrapper();
 
+    enum WatchdogState {
+        WATCHDOG_IDLE,
+        WATCHDOG_REQUESTED,
+        WATCHDOG_RECOVERING,
+    };
+    sp<WatchdogThread>  mWatchdogThread;
+            int         watchdogThread();
+            void        requestSensorRecovery();
+    mutable Mutex       mWatchdogLock;
+    Condition           mWatchdogCondition;
+    WatchdogState       mWatchdogState;
+    bool                mExitWatchdogThread;
+    /* held by whoever restarts or stops the sensor stream */
+    mutable Mutex       mSensorLock;
+    uint32_t            mRecoveryCount;
+    uint32_t            mRecoveryFailures;
+    SecCameraHistogram  mRecoveryStats;
+
+    sp<CallbackThread>  mCallbackThread;
+            int         callbackThread();
+            int         reserveCallbackSlot();
+            void        queueCallbackFrame(int slot);
+            int         dequeueCallbackFrame();
+            void        flushCallbackFrames();
+
     sp<AutoFocusThread> mAutoFocusThread;
             int         autoFocusThread();
 
@@ -140,19 +311,52 @@ private:
             CaptureMode mCaptureMode;
             bool        mCaptureInProgress;
             bool        mCaptureCancel;
-
-            bool        scaleDownYuv422(char *srcBuf, uint32_t srcWidth,
-                                        uint32_t srcHight, char *dstBuf,
-                                        uint32_t dstWidth, uint32_t dstHight);
+            bool        mZslCapture;
+            bool        mVideoSnapshot;
+
+    sp<BurstThread>     mBurstThread;
+            int         burstThread();
+            status_t    deliverPicture(const CaptureFrame &frame);
+            void        releaseCaptureFrame(CaptureFrame &frame);
+            void        queueBurstFrame(const CaptureFrame &frame);
+            void        finishBurst();
+            int         acquireCaptureHeaps(int jpegSize, int postviewSize,
+                                            int thumbnailSize);
+            void        releaseCaptureHeaps(int slot);
+            void        freeCaptureHeaps();
+
+            int         zslPictureThread();
+            int         videoSnapshotThread();
+            int         compressYuyvPicture(const sp<MemoryHeapBase>& yuvHeap,
+                                            int width, int height);
+            void        storeVideoSnapshotFrame(int index);
+            void        sendFaceMetadata(int width, int height);
+            camera_memory_t* getExifHeap();
+            status_t    sendCompressedImage(camera_memory_t *jpegHeap,
+                                            unsigned int jpegSize,
+                                            unsigned char *thumbnail,
+                                            int width, int height);
+            void        storeZslFrame(char *y, char *u, char *v,
+                                      int width, int height, nsecs_t timestamp);
+            int         pinZslFrame(nsecs_t shutter);
+            void        unpinZslFrame();
+            void        releaseZslFrames();
 
             void        setSkipFrame(int frame);
+            void        resetFpsGovernor();
+            void        updateFpsGovernor(nsecs_t frame_time);
+            void        setGovernorRate_l(int fps, int decimation);
             bool        isSupportedPreviewSize(const int width,
                                                const int height) const;
+            bool        isParameterChanged(const CameraParameters& params,
+                                           const char *key) const;
             status_t    waitForCaptureCompletion(int msec = 5000);
     /* used by auto focus thread to block until it's told to run */
     mutable Mutex       mFocusLock;
     mutable Condition   mFocusCondition;
     volatile bool       mExitAutoFocusThread;
+    nsecs_t             mAutoFocusRequestTime;
+    SecCameraHistogram  mAutoFocusStats;
 
     /* used by preview thread to block until it's told to run */
     mutable Mutex       mPreviewLock;
@@ -163,25 +367,119 @@ private:
     volatile bool       mPreviewStartDeferred;
     volatile bool       mExitPreviewThread;
     volatile bool       mFaceDetectStarted;
+    /* face results go out with every preview frame, nothing allocated then */
+    camera_memory_t*    mFaceMetadataHeap;
+    camera_frame_metadata_t mFaceMetadata;
+    camera_face_t       mFaces[MAX_DETECTED_FACES];
+    int                 mLastFaceCount;
+
+    /* smooth zoom, stepped by the preview thread once a frame. mZoomLevel
+     * is the level last reached, what KEY_ZOOM reads back
+     */
+    mutable Mutex       mZoomLock;
+    bool                mSmoothZoom;
+    bool                mSmoothZoomStop;
+    int                 mZoomTarget;
+    int                 mZoomLevel;
+            void        stepSmoothZoom();
+            bool        endSmoothZoom_l();
+
+    /* lock free ring of callback heap slots, see reserveCallbackSlot() */
+    volatile int32_t    mCallbackRing[kCallbackRingSize];
+    volatile int32_t    mCallbackRead;
+    volatile int32_t    mCallbackWrite;
+    volatile int32_t    mCallbackSlotBusy[kBufferCount];
+    volatile int32_t    mCallbackDrops;
+    int                 mCallbackQueueDepth;
+    bool                mCallbackDropOldest;
+    sem_t               mCallbackSem;
+    /* guards the callback pointers and mCallbackDelivering, the callback
+     * thread drops it around mDataCb */
+    mutable Mutex       mCallbackLock;
+    bool                mCallbackDelivering;
+    mutable Condition   mCallbackDeliveredCondition;
+    volatile bool       mExitCallbackThread;
+    /* callback frames at their own size, taken at startPreview(), their
+     * own format and at most one every mCallbackInterval
+     */
+    int                 mCallbackWidth;
+    int                 mCallbackHeight;
+    volatile bool       mCallbackNV21;
+    volatile nsecs_t    mCallbackInterval;
+    nsecs_t             mCallbackLast;
+            bool        callbackDue(nsecs_t timestamp);
 
     /* used to guard mCaptureInProgress */
     mutable Mutex       mCaptureLock;
     mutable Condition   mCaptureCondition;
 
+    /* snapshot while recording, a record frame converted to YUV420P.
+     * the picture thread sets mVideoSnapshotPending and the preview
+     * thread fills the heap from the next record frame, both under
+     * mCaptureLock.
+     */
+    volatile bool       mVideoSnapshotPending;
+    status_t            mVideoSnapshotStatus;
+    mutable Condition   mVideoSnapshotCondition;
+    camera_memory_t*    mVideoSnapshotHeap;
+    int                 mVideoSnapshotWidth;
+    int                 mVideoSnapshotHeight;
+
+    /* shots the picture thread captured for the burst thread to deliver,
+     * in flight counts the one being delivered too
+     */
+    CaptureFrame        mBurstQueue[kBurstQueueSize];
+    int                 mBurstHead;
+    int                 mBurstQueued;
+    int                 mBurstInFlight;
+    bool                mBurstDone;
+    mutable Mutex       mBurstLock;
+    mutable Condition   mBurstCondition;
+
+    CaptureHeaps        mCaptureHeaps[MAX_BURST_BUFFERS];
+    mutable Mutex       mCaptureHeapLock;
+    /* only the thread delivering a picture uses it */
+    camera_memory_t*    mExifHeap;
+
     CameraParameters    mParameters;
     CameraParameters    mInternalParameters;
+    /* set once mParameters matches what the sensor was told */
+    bool                mParametersSynced;
+    /* what getParameters() hands out, flattened again only after
+     * setParameters() or a zoom step. guarded by mZoomLock
+     */
+    mutable String8     mFlatParameters;
+    mutable int         mFlatZoomLevel;
+    mutable bool        mFlatParametersValid;
 
     camera_memory_t*    mPreviewMemory;
+    camera_memory_t*    mPreviewCbHeap;
+    /* geometry the two heaps above were made for, kept across restarts */
+    int                 mPreviewHeapWidth;
+    int                 mPreviewHeapHeight;
+    int                 mPreviewHeapFrameSize;
     camera_memory_t*    mRawHeap;
     camera_memory_t*    mRecordHeap;
+    /* record frames go to fimc once every consumer gave them back */
+    int                 mVideoConsumers;
+    volatile int32_t    mRecordFrameRefs[kBufferCount];
 
     SecCamera           *mSecCamera;
     const __u8          *mCameraSensorName;
 
-    mutable Mutex       mSkipFrameLock;
-    int                 mSkipFrame;
+    /* frames the preview thread still drops, updated with android_atomic */
+    volatile int32_t    mSkipFrame;
 
     preview_stream_ops* mWindow;
+    /* buffers set on mWindow, and those added for a slow consumer */
+    int                 mWindowBufferCount;
+    int                 mWindowExtraBuffers;
+
+    /* gralloc buffers fimc captures into when preview runs zero copy */
+    bool                mPreviewZeroCopy;
+    preview_stream_ops* mPreviewBufWindow;
+    buffer_handle_t*    mPreviewBufHandles[kBufferCount];
+    int                 mPreviewBufCount;
 
     camera_notify_callback mNotifyCb;
     camera_data_callback mDataCb;
@@ -191,14 +489,68 @@ private:
 
     int32_t             mMsgEnabled;
 
-    volatile bool       mRecordRunning;
+    /* read by the preview thread without locking, changed under
+     * mRecordLock.  mRecordLock only covers the record node and
+     * mRecordHeap, never a callback.
+     */
+    volatile int32_t    mRecordRunning;
     mutable Mutex       mRecordLock;
+    /* keep the record node streaming during preview, see prepareRecording_l() */
+    bool                mRecordingHint;
     int                 mPostViewWidth;
     int                 mPostViewHeight;
     int                 mPostViewSize;
 
     Vector<Size>        mSupportedPreviewSizes;
 
+    SecCameraHistogram  mPreviewStats[STAGE_MAX];
+    /* only the preview thread adds to them, like mPreviewStats */
+    SecCameraHistogram  mLatencyStats[LATENCY_MAX];
+
+    /* preview rate governor, only used by the preview thread.  it lowers
+     * the sensor rate or drops every n-th frame while the consumers or the
+     * cpu can't keep up, and goes back once they can.
+     */
+    bool                mGovernorEnabled;
+    /* the rate the app asked for and the one the sensor runs at */
+    int                 mGovernorNominalFps;
+    int                 mGovernorFps;
+    int                 mGovernorMinFps;
+    int                 mGovernorMaxFps;
+    int                 mFrameDecimation;
+    int                 mDecimationCount;
+    nsecs_t             mGovernorWindowStart;
+    int                 mGovernorFrames;
+    nsecs_t             mGovernorFrameTime;
+    nsecs_t             mGovernorDequeueTime;
+    int                 mGovernorBacklog;
+    int32_t             mGovernorDrops;
+    unsigned long long  mGovernorCpuBusy;
+    unsigned long long  mGovernorCpuTotal;
+    int                 mGovernorOverloaded;
+    int                 mGovernorIdle;
+    uint32_t            mGovernorChanges;
+
+    /* open to the first preview frame that is not skipped, 0 until then.
+     * set with gFirstFrameStatsLock held */
+    nsecs_t             mOpenTime;
+    nsecs_t             mFirstFrameLatency;
+
+    /* zero shutter lag, the last few preview frames kept as YUV420P.
+     * a slot with a zero timestamp is empty or being written, the
+     * pinned slot is being encoded and is never overwritten.
+     */
+    static const int    kZslFrameCount = 3;
+    volatile bool       mZslEnabled;
+    nsecs_t             mZslShutterTime;
+    mutable Mutex       mZslLock;
+    camera_memory_t*    mZslHeap;
+    int                 mZslWidth;
+    int                 mZslHeight;
+    nsecs_t             mZslTimestamp[kZslFrameCount];
+    int                 mZslNext;
+    int                 mZslPinned;
+
     static gralloc_module_t const* mGrallocHal;
 };
 
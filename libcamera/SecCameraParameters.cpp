@@ -25,6 +25,17 @@ const char SecCameraParameters::KEY_VIDEO_STABILIZATION_SUPPORTED[] = "video-sta
 const char SecCameraParameters::KEY_BURST[] = "burst-capture";
 const char SecCameraParameters::KEY_BURST_SUPPORTED[] = "burst-capture-supported";
 
+const char SecCameraParameters::KEY_ZSL[] = "zsl";
+const char SecCameraParameters::KEY_ZSL_SUPPORTED[] = "zsl-supported";
+
+const char SecCameraParameters::KEY_PREVIEW_CALLBACK_SIZE[] = "preview-callback-size";
+const char SecCameraParameters::KEY_SUPPORTED_PREVIEW_CALLBACK_SIZES[] = "preview-callback-size-values";
+const char SecCameraParameters::KEY_PREVIEW_CALLBACK_FORMAT[] = "preview-callback-format";
+const char SecCameraParameters::KEY_PREVIEW_CALLBACK_FPS[] = "preview-callback-fps";
+
+const char SecCameraParameters::KEY_VIDEO_CONSUMERS[] = "video-consumers";
+const char SecCameraParameters::KEY_MAX_VIDEO_CONSUMERS[] = "max-video-consumers";
+
 const char SecCameraParameters::KEY_ISO[] = "iso";
 const char SecCameraParameters::KEY_SUPPORTED_ISO_MODES[] = "iso-values";
 
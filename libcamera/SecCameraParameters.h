@@ -98,6 +98,19 @@ public:
     static const char KEY_BURST[];
     static const char KEY_BURST_SUPPORTED[];
 
+    static const char KEY_ZSL[];
+    static const char KEY_ZSL_SUPPORTED[];
+
+    // preview callbacks apart from the display, unset follows the preview
+    static const char KEY_PREVIEW_CALLBACK_SIZE[];
+    static const char KEY_SUPPORTED_PREVIEW_CALLBACK_SIZES[];
+    static const char KEY_PREVIEW_CALLBACK_FORMAT[];
+    static const char KEY_PREVIEW_CALLBACK_FPS[];
+
+    // encoders each giving every record frame back
+    static const char KEY_VIDEO_CONSUMERS[];
+    static const char KEY_MAX_VIDEO_CONSUMERS[];
+
     static const char KEY_ISO[];
     static const char KEY_SUPPORTED_ISO_MODES[];
 
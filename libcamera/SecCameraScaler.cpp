@@ -0,0 +1,170 @@
+/*
+**
+** Copyright 2011, Havlena Petr <havlenapetr@gmail.com>
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#include <stdlib.h>
+
+#if defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+#include "SecCameraScaler.h"
+
+namespace android {
+
+/* weights are 7 bit so they fit the neon 8 bit multiplies */
+#define WEIGHT_BITS     7
+#define WEIGHT_ONE      (1 << WEIGHT_BITS)
+
+/* map destination sample d of dn onto the n source samples, pixel
+ * centres aligned.  returns the left sample and the weight of the right.
+ */
+static inline void sourcePos(int d, int dn, int n, int *s, int *weight)
+{
+    int pos = (int)(((2LL * d + 1) * n << 15) / dn) - (1 << 15);
+
+    if (pos < 0)
+        pos = 0;
+    if (pos > (n - 1) << 16)
+        pos = (n - 1) << 16;
+
+    *s = pos >> 16;
+    *weight = (pos & 0xffff) >> (16 - WEIGHT_BITS);
+}
+
+static inline unsigned char lerp(int a, int b, int weight)
+{
+    return (a * (WEIGHT_ONE - weight) + b * weight + (WEIGHT_ONE >> 1)) >> WEIGHT_BITS;
+}
+
+static void blendRows(const unsigned char *a, const unsigned char *b,
+                      unsigned char *dst, int len, int weight)
+{
+    int i = 0;
+
+#if defined(__ARM_NEON__)
+    const uint8x8_t wa = vdup_n_u8(WEIGHT_ONE - weight);
+    const uint8x8_t wb = vdup_n_u8(weight);
+
+    for (; i + 16 <= len; i += 16) {
+        uint8x16_t va = vld1q_u8(a + i);
+        uint8x16_t vb = vld1q_u8(b + i);
+        uint16x8_t lo = vmull_u8(vget_low_u8(va), wa);
+        uint16x8_t hi = vmull_u8(vget_high_u8(va), wa);
+
+        lo = vmlal_u8(lo, vget_low_u8(vb), wb);
+        hi = vmlal_u8(hi, vget_high_u8(vb), wb);
+        vst1q_u8(dst + i, vcombine_u8(vrshrn_n_u16(lo, WEIGHT_BITS),
+                                      vrshrn_n_u16(hi, WEIGHT_BITS)));
+    }
+#endif
+
+    for (; i < len; i++)
+        dst[i] = lerp(a[i], b[i], weight);
+}
+
+bool scaleYuyvBilinear(const unsigned char *src, int srcWidth, int srcHeight,
+                       unsigned char *dst, int dstWidth, int dstHeight)
+{
+    if (srcWidth < 2 || srcHeight < 1 || dstWidth < 2 || dstHeight < 1 ||
+        (srcWidth & 1) || (dstWidth & 1))
+        return false;
+
+    const int srcStride = srcWidth * 2;
+    unsigned char *row = (unsigned char *)malloc(srcStride);
+    if (row == NULL)
+        return false;
+
+    for (int y = 0; y < dstHeight; y++) {
+        int sy, wy;
+        sourcePos(y, dstHeight, srcHeight, &sy, &wy);
+
+        // vertical pass over a whole source row, neon does most of the work
+        const unsigned char *r0 = src + sy * srcStride;
+        const unsigned char *r1 = sy + 1 < srcHeight ? r0 + srcStride : r0;
+        blendRows(r0, r1, row, srcStride, wy);
+
+        unsigned char *out = dst + y * dstWidth * 2;
+
+        // luma sits on even bytes
+        for (int x = 0; x < dstWidth; x++) {
+            int sx, wx;
+            sourcePos(x, dstWidth, srcWidth, &sx, &wx);
+            int sx1 = sx + 1 < srcWidth ? sx + 1 : sx;
+            out[x * 2] = lerp(row[sx * 2], row[sx1 * 2], wx);
+        }
+
+        // chroma is one Cb and one Cr per pixel pair
+        for (int x = 0; x < dstWidth / 2; x++) {
+            int sx, wx;
+            sourcePos(x, dstWidth / 2, srcWidth / 2, &sx, &wx);
+            int sx1 = sx + 1 < srcWidth / 2 ? sx + 1 : sx;
+            out[x * 4 + 1] = lerp(row[sx * 4 + 1], row[sx1 * 4 + 1], wx);
+            out[x * 4 + 3] = lerp(row[sx * 4 + 3], row[sx1 * 4 + 3], wx);
+        }
+    }
+
+    free(row);
+    return true;
+}
+
+static void scalePlane(const unsigned char *src, int srcWidth, int srcHeight,
+                       unsigned char *dst, int dstWidth, int dstHeight,
+                       int step, unsigned char *row)
+{
+    for (int y = 0; y < dstHeight; y++) {
+        int sy, wy;
+        sourcePos(y, dstHeight, srcHeight, &sy, &wy);
+
+        const unsigned char *r0 = src + sy * srcWidth;
+        const unsigned char *r1 = sy + 1 < srcHeight ? r0 + srcWidth : r0;
+        blendRows(r0, r1, row, srcWidth, wy);
+
+        unsigned char *out = dst + y * dstWidth * step;
+        for (int x = 0; x < dstWidth; x++) {
+            int sx, wx;
+            sourcePos(x, dstWidth, srcWidth, &sx, &wx);
+            int sx1 = sx + 1 < srcWidth ? sx + 1 : sx;
+            out[x * step] = lerp(row[sx], row[sx1], wx);
+        }
+    }
+}
+
+bool scaleYuv420Bilinear(const unsigned char *srcY, const unsigned char *srcCb,
+                         const unsigned char *srcCr, int srcWidth, int srcHeight,
+                         unsigned char *dstY, unsigned char *dstCb,
+                         unsigned char *dstCr, int dstWidth, int dstHeight,
+                         int uvStep)
+{
+    if (srcWidth < 2 || srcHeight < 2 || dstWidth < 2 || dstHeight < 2 ||
+        ((srcWidth | srcHeight | dstWidth | dstHeight) & 1))
+        return false;
+
+    unsigned char *row = (unsigned char *)malloc(srcWidth);
+    if (row == NULL)
+        return false;
+
+    scalePlane(srcY, srcWidth, srcHeight, dstY, dstWidth, dstHeight, 1, row);
+    scalePlane(srcCb, srcWidth / 2, srcHeight / 2,
+               dstCb, dstWidth / 2, dstHeight / 2, uvStep, row);
+    scalePlane(srcCr, srcWidth / 2, srcHeight / 2,
+               dstCr, dstWidth / 2, dstHeight / 2, uvStep, row);
+
+    free(row);
+    return true;
+}
+
+}; // namespace android
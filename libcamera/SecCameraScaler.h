@@ -0,0 +1,40 @@
+/*
+**
+** Copyright 2011, Havlena Petr <havlenapetr@gmail.com>
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**    http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#ifndef ANDROID_HARDWARE_CAMERA_SEC_SCALER_H
+#define ANDROID_HARDWARE_CAMERA_SEC_SCALER_H
+
+namespace android {
+
+/* Bilinear scale of an interleaved YCbYCr 4:2:2 image to any size.
+ * Widths must be even.  This is the fallback for when fimc can't scale.
+ */
+bool scaleYuyvBilinear(const unsigned char *src, int srcWidth, int srcHeight,
+                       unsigned char *dst, int dstWidth, int dstHeight);
+
+/* Bilinear scale of a planar YCbCr 4:2:0 image, sizes even.  The output
+ * chroma samples are uvStep bytes apart, 2 interleaves them for NV21.
+ */
+bool scaleYuv420Bilinear(const unsigned char *srcY, const unsigned char *srcCb,
+                         const unsigned char *srcCr, int srcWidth, int srcHeight,
+                         unsigned char *dstY, unsigned char *dstCb,
+                         unsigned char *dstCr, int dstWidth, int dstHeight,
+                         int uvStep);
+
+}; // namespace android
+
+#endif // ANDROID_HARDWARE_CAMERA_SEC_SCALER_H
@@ -0,0 +1,135 @@
+/*
+**
+** Copyright 2011, Havlena Petr <havlenapetr@gmail.com>
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#include <string.h>
+
+#include "SecCameraStats.h"
+
+namespace android {
+
+/* upper bound of each bucket in usec, the last one catches everything */
+const uint32_t SecCameraHistogram::kBucketLimitUs[NUM_BUCKETS] = {
+    50, 100, 200, 500, 1000, 2000, 3000, 5000, 7500, 10000,
+    15000, 20000, 33000, 50000, 67000, 100000, 200000, 500000, 1000000,
+    0xffffffff
+};
+
+SecCameraHistogram::SecCameraHistogram(const char *name)
+    : mName(name)
+{
+    reset();
+}
+
+void SecCameraHistogram::reset()
+{
+    memset(mBuckets, 0, sizeof(mBuckets));
+    mCount = 0;
+    mMin = 0;
+    mMax = 0;
+    mTotal = 0;
+}
+
+void SecCameraHistogram::add(nsecs_t duration)
+{
+    uint32_t us = (uint32_t)(duration / 1000);
+    int i = 0;
+
+    while (us > kBucketLimitUs[i])
+        i++;
+    mBuckets[i]++;
+
+    if (mCount == 0 || duration < mMin)
+        mMin = duration;
+    if (duration > mMax)
+        mMax = duration;
+    mTotal += duration;
+    mCount++;
+}
+
+void SecCameraHistogram::dump(String8& result) const
+{
+    const uint32_t count = mCount;
+    uint32_t p99 = 0;
+    uint32_t sum = 0;
+
+    if (count == 0) {
+        result.appendFormat("  %-16s no samples\n", mName);
+        return;
+    }
+
+    /* p99 is reported as the upper bound of the bucket it falls in */
+    for (int i = 0; i < NUM_BUCKETS; i++) {
+        sum += mBuckets[i];
+        if (sum * 100ULL >= count * 99ULL) {
+            p99 = kBucketLimitUs[i];
+            break;
+        }
+    }
+
+    result.appendFormat("  %-16s n=%u min=%lldus avg=%lldus max=%lldus p99<=%uus\n",
+                        mName, count, mMin / 1000, mTotal / count / 1000,
+                        mMax / 1000, p99);
+
+    result.append("   ");
+    for (int i = 0; i < NUM_BUCKETS; i++) {
+        if (mBuckets[i] == 0)
+            continue;
+        if (i == NUM_BUCKETS - 1)
+            result.appendFormat(" >%u:%u", kBucketLimitUs[i - 1], mBuckets[i]);
+        else
+            result.appendFormat(" <=%u:%u", kBucketLimitUs[i], mBuckets[i]);
+    }
+    result.append("\n");
+}
+
+void SecCameraTimestampFilter::reset()
+{
+    mLast = 0;
+    mLastInput = 0;
+    mInterval = 0;
+}
+
+nsecs_t SecCameraTimestampFilter::filter(nsecs_t timestamp)
+{
+    nsecs_t interval = timestamp - mLastInput;
+    nsecs_t out;
+
+    if (mLastInput == 0 || interval <= 0 || interval > seconds(1)) {
+        /* first frame or a discontinuity, start over */
+        mInterval = 0;
+        out = timestamp;
+    } else {
+        mInterval = mInterval ? (mInterval * 7 + interval) / 8 : interval;
+
+        nsecs_t predicted = mLast + mInterval;
+        nsecs_t error = timestamp - predicted;
+
+        if (error > mInterval / 2 || error < -mInterval / 2)
+            out = timestamp;
+        else
+            out = predicted + error / 8;
+    }
+
+    if (mLast && out <= mLast)
+        out = mLast + microseconds(1);
+
+    mLast = out;
+    mLastInput = timestamp;
+    return out;
+}
+
+}; // namespace android
@@ -0,0 +1,77 @@
+/*
+**
+** Copyright 2011, Havlena Petr <havlenapetr@gmail.com>
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**    http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#ifndef ANDROID_HARDWARE_CAMERA_SEC_STATS_H
+#define ANDROID_HARDWARE_CAMERA_SEC_STATS_H
+
+#include <stdint.h>
+
+#include <utils/String8.h>
+#include <utils/Timers.h>
+
+namespace android {
+
+/* Latency histogram with fixed buckets, cheap enough to be always on.
+ * Each instance must only be updated from a single thread, dump() may
+ * run concurrently and then sees slightly stale numbers.
+ */
+class SecCameraHistogram {
+public:
+    enum { NUM_BUCKETS = 20 };
+
+    SecCameraHistogram(const char *name = "");
+
+    void        setName(const char *name) { mName = name; }
+    void        reset();
+    void        add(nsecs_t duration);
+    void        dump(String8& result) const;
+
+    uint32_t    count() const { return mCount; }
+    nsecs_t     mean() const { return mCount ? mTotal / mCount : 0; }
+
+private:
+    static const uint32_t kBucketLimitUs[NUM_BUCKETS];
+
+    const char  *mName;
+    uint32_t    mBuckets[NUM_BUCKETS];
+    uint32_t    mCount;
+    nsecs_t     mMin;
+    nsecs_t     mMax;
+    nsecs_t     mTotal;
+};
+
+/* Smooths the timestamps of a frame stream.  The output is strictly
+ * increasing and follows the average frame interval, so an encoder sees
+ * even pacing, but it snaps back to the input on dropped frames or frame
+ * rate changes so it never drifts away from the capture time.
+ */
+class SecCameraTimestampFilter {
+public:
+    SecCameraTimestampFilter() { reset(); }
+
+    void        reset();
+    nsecs_t     filter(nsecs_t timestamp);
+
+private:
+    nsecs_t     mLast;
+    nsecs_t     mLastInput;
+    nsecs_t     mInterval;
+};
+
+}; // namespace android
+
+#endif // ANDROID_HARDWARE_CAMERA_SEC_STATS_H
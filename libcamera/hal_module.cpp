@@ -20,6 +20,8 @@
 #include <utils/threads.h>
 #include <hardware/camera.h>
 
+#include <sec_startup.h>
+
 #include "SecCameraHWInterface.h"
 
 using namespace android;
@@ -318,15 +320,13 @@ void camera_release(struct camera_device * device)
     hw->release();
 }
 
-/*
 int camera_dump(struct camera_device * device, int fd)
 {
     CameraHardwareSec* hw = sec_obtain_hw(device);
     RETURN_EINVAL_IF(hw);
 
-    return hw->dump(fd);
+    return hw->dump(fd, Vector<String16>());
 }
-*/
 
 extern "C" void heaptracker_free_leaked_memory(void);
 
@@ -385,11 +385,13 @@ int camera_device_open(const hw_module_t* module, const char* name,
     sec_camera_device_t*    camera_device = NULL;
     camera_device_ops_t*    camera_ops = NULL;
     CameraHardwareSec*      camera_hw = NULL;
+    struct sec_startup      startup;
 
     ALOGV("camera_device open");
 
     if (name != NULL) {
         cameraid = atoi(name);
+        sec_startup_begin(&startup, cameraid ? "camera1" : "camera0");
         num_cameras = sizeof(gCameraInfo);
 
         if(cameraid > num_cameras) {
@@ -451,14 +453,17 @@ int camera_device_open(const hw_module_t* module, const char* name,
         camera_ops->put_parameters = camera_put_parameters;
         camera_ops->send_command = camera_send_command;
         camera_ops->release = camera_release;
-        camera_ops->dump = NULL;
+        camera_ops->dump = camera_dump;
 
         *device = &camera_device->base.common;
 
         // -------- Sec specific stuff --------
 
+        // the sensor is opened and powered up here
         camera_hw = new CameraHardwareSec(cameraid);
+        sec_startup_phase(&startup, "sensor");
         rv = camera_hw->init();
+        sec_startup_phase(&startup, "init");
         if(rv != NO_ERROR) {
             goto fail;
         }
@@ -466,11 +471,15 @@ int camera_device_open(const hw_module_t* module, const char* name,
         camera_device->cam = camera_hw;
 
         gCamerasOpen++;
+        sec_startup_end(&startup, rv);
     }
 
     return rv;
 
 fail:
+    if (name != NULL) {
+        sec_startup_end(&startup, -1);
+    }
     if(camera_device) {
         free(camera_device);
         camera_device = NULL;
@@ -0,0 +1,818 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Drives the camera HAL the way the camera service does and measures it:
+ * open latency, time to first preview frame, steady preview fps and frame
+ * interval jitter, cpu load of the HAL threads, single shot and shot to
+ * shot latency, burst throughput and the preview to record switch.
+ *
+ * usage: camera-bench [-c camera id] [-t seconds of preview] [-n burst shots]
+ *
+ * the config of a result is the camera it ran on.
+ */
+
+#include <hardware/camera.h>
+#include <hardware/gralloc.h>
+#include <camera/CameraParameters.h>
+#include <utils/threads.h>
+#include <utils/Timers.h>
+#include <utils/Vector.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+
+#include <sec_bench.h>
+
+using namespace android;
+
+static const int kWindowBuffers = 8;
+static const int kMinUndequeued = 2;
+static const nsecs_t kFrameTimeout = seconds_to_nanoseconds(5);
+static const nsecs_t kPictureTimeout = seconds_to_nanoseconds(10);
+
+// ---------------------------------------------------------------------------
+// preview window, gralloc buffers that are "displayed" as soon as queued
+
+struct BenchWindow {
+    preview_stream_ops_t    ops;    /* must stay first */
+    alloc_device_t*         alloc;
+    buffer_handle_t         handles[kWindowBuffers];
+    bool                    held[kWindowBuffers];
+    int                     wanted;
+    int                     count;
+    int                     heldCount;
+    int                     stride;
+    int                     usage;
+
+    Mutex                   lock;
+    Condition               frameCondition;
+    Vector<nsecs_t>         frames;
+};
+
+static BenchWindow *toWindow(preview_stream_ops_t *w)
+{
+    return (BenchWindow *)w;
+}
+
+static void freeWindowBuffers(BenchWindow *win)
+{
+    for (int i = 0; i < win->count; i++) {
+        if (win->handles[i])
+            win->alloc->free(win->alloc, win->handles[i]);
+        win->handles[i] = NULL;
+        win->held[i] = false;
+    }
+    win->count = 0;
+    win->heldCount = 0;
+}
+
+static int windowIndex(BenchWindow *win, buffer_handle_t *buffer)
+{
+    int i = buffer - win->handles;
+    if (i < 0 || win->count <= i || !win->held[i])
+        return -1;
+    return i;
+}
+
+static int window_dequeue_buffer(preview_stream_ops_t *w,
+                                 buffer_handle_t **buffer, int *stride)
+{
+    BenchWindow *win = toWindow(w);
+    Mutex::Autolock lock(win->lock);
+
+    if (win->heldCount >= win->count - kMinUndequeued)
+        return -EBUSY;
+
+    for (int i = 0; i < win->count; i++) {
+        if (!win->held[i]) {
+            win->held[i] = true;
+            win->heldCount++;
+            *buffer = &win->handles[i];
+            *stride = win->stride;
+            return 0;
+        }
+    }
+    return -EBUSY;
+}
+
+static int window_enqueue_buffer(preview_stream_ops_t *w, buffer_handle_t *buffer)
+{
+    nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+    BenchWindow *win = toWindow(w);
+    Mutex::Autolock lock(win->lock);
+
+    int i = windowIndex(win, buffer);
+    if (i < 0)
+        return -EINVAL;
+    win->held[i] = false;
+    win->heldCount--;
+    win->frames.add(now);
+    win->frameCondition.broadcast();
+    return 0;
+}
+
+static int window_cancel_buffer(preview_stream_ops_t *w, buffer_handle_t *buffer)
+{
+    BenchWindow *win = toWindow(w);
+    Mutex::Autolock lock(win->lock);
+
+    int i = windowIndex(win, buffer);
+    if (i < 0)
+        return -EINVAL;
+    win->held[i] = false;
+    win->heldCount--;
+    return 0;
+}
+
+static int window_set_buffer_count(preview_stream_ops_t *w, int count)
+{
+    if (count <= kMinUndequeued || kWindowBuffers < count)
+        return -EINVAL;
+    toWindow(w)->wanted = count;
+    return 0;
+}
+
+static int window_set_buffers_geometry(preview_stream_ops_t *w,
+                                       int width, int height, int format)
+{
+    BenchWindow *win = toWindow(w);
+    Mutex::Autolock lock(win->lock);
+
+    freeWindowBuffers(win);
+    for (int i = 0; i < win->wanted; i++) {
+        int ret = win->alloc->alloc(win->alloc, width, height, format,
+                                    win->usage, &win->handles[i], &win->stride);
+        if (ret && i == 0) {
+            /* no contiguous memory left, the HAL copies into these then */
+            win->usage &= GRALLOC_USAGE_SW_READ_MASK | GRALLOC_USAGE_SW_WRITE_MASK;
+            ret = win->alloc->alloc(win->alloc, width, height, format,
+                                    win->usage, &win->handles[i], &win->stride);
+        }
+        if (ret) {
+            LOGE("%s:: Can't allocate %dx%d buffer: %d", __func__, width, height, ret);
+            freeWindowBuffers(win);
+            return ret;
+        }
+        win->count++;
+    }
+    return 0;
+}
+
+static int window_set_crop(preview_stream_ops_t *w,
+                           int left, int top, int right, int bottom)
+{
+    return 0;
+}
+
+static int window_set_usage(preview_stream_ops_t *w, int usage)
+{
+    toWindow(w)->usage = usage;
+    return 0;
+}
+
+static int window_set_swap_interval(preview_stream_ops_t *w, int interval)
+{
+    return 0;
+}
+
+static int window_get_min_undequeued_buffer_count(const preview_stream_ops_t *w,
+                                                  int *count)
+{
+    *count = kMinUndequeued;
+    return 0;
+}
+
+static int window_lock_buffer(preview_stream_ops_t *w, buffer_handle_t *buffer)
+{
+    return 0;
+}
+
+static int window_set_timestamp(preview_stream_ops_t *w, int64_t timestamp)
+{
+    return 0;
+}
+
+static int initWindow(BenchWindow *win)
+{
+    const hw_module_t *module;
+
+    memset(&win->ops, 0, sizeof(win->ops));
+    win->ops.dequeue_buffer = window_dequeue_buffer;
+    win->ops.enqueue_buffer = window_enqueue_buffer;
+    win->ops.cancel_buffer = window_cancel_buffer;
+    win->ops.set_buffer_count = window_set_buffer_count;
+    win->ops.set_buffers_geometry = window_set_buffers_geometry;
+    win->ops.set_crop = window_set_crop;
+    win->ops.set_usage = window_set_usage;
+    win->ops.set_swap_interval = window_set_swap_interval;
+    win->ops.get_min_undequeued_buffer_count = window_get_min_undequeued_buffer_count;
+    win->ops.lock_buffer = window_lock_buffer;
+    win->ops.set_timestamp = window_set_timestamp;
+
+    memset(win->handles, 0, sizeof(win->handles));
+    memset(win->held, 0, sizeof(win->held));
+    win->wanted = kWindowBuffers;
+    win->count = 0;
+    win->heldCount = 0;
+    win->stride = 0;
+    win->usage = GRALLOC_USAGE_SW_WRITE_OFTEN;
+
+    if (hw_get_module(GRALLOC_HARDWARE_MODULE_ID, &module)) {
+        LOGE("%s:: Gralloc module not presented", __func__);
+        return -1;
+    }
+    if (gralloc_open(module, &win->alloc)) {
+        LOGE("%s:: Can't open gralloc alloc device", __func__);
+        return -1;
+    }
+    return 0;
+}
+
+/* wait for frames enqueued after 'since', returns how many came */
+static int waitFrames(BenchWindow *win, nsecs_t since, int frames, nsecs_t timeout)
+{
+    nsecs_t end = systemTime(SYSTEM_TIME_MONOTONIC) + timeout;
+    Mutex::Autolock lock(win->lock);
+
+    for (;;) {
+        int n = 0;
+        for (size_t i = 0; i < win->frames.size(); i++) {
+            if (win->frames[i] >= since)
+                n++;
+        }
+        nsecs_t left = end - systemTime(SYSTEM_TIME_MONOTONIC);
+        if (n >= frames || left <= 0)
+            return n;
+        win->frameCondition.waitRelative(win->lock, left);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// camera memory, what the camera service hands out through get_memory
+
+struct BenchMemory {
+    camera_memory_t         mem;    /* must stay first */
+    size_t                  bufSize;
+    bool                    mapped;
+};
+
+static void memory_release(camera_memory_t *mem)
+{
+    BenchMemory *m = (BenchMemory *)mem;
+
+    if (m->mapped)
+        munmap(mem->data, mem->size);
+    else
+        free(mem->data);
+    delete m;
+}
+
+static camera_memory_t *get_memory(int fd, size_t buf_size,
+                                   unsigned int num_bufs, void *user)
+{
+    BenchMemory *m = new BenchMemory;
+
+    m->bufSize = buf_size;
+    m->mem.size = buf_size * num_bufs;
+    m->mem.handle = NULL;
+    m->mem.release = memory_release;
+    m->mapped = fd >= 0;
+    if (m->mapped) {
+        m->mem.data = mmap(0, m->mem.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (m->mem.data == MAP_FAILED)
+            m->mem.data = NULL;
+    } else {
+        m->mem.data = calloc(1, m->mem.size ? m->mem.size : 1);
+    }
+
+    if (m->mem.data == NULL) {
+        LOGE("%s:: Can't get %u bytes", __func__, (unsigned int)m->mem.size);
+        delete m;
+        return NULL;
+    }
+    return &m->mem;
+}
+
+// ---------------------------------------------------------------------------
+// callbacks
+
+struct Bench {
+    camera_device_t*        dev;
+    BenchWindow             window;
+
+    Mutex                   lock;
+    Condition               condition;
+    nsecs_t                 shutterTime;
+    int                     jpegCount;
+    nsecs_t                 firstJpegTime;
+    nsecs_t                 lastJpegTime;
+    int                     videoCount;
+    nsecs_t                 firstVideoTime;
+    nsecs_t                 lastVideoTime;
+};
+
+static void resetBench(Bench *bench)
+{
+    Mutex::Autolock lock(bench->lock);
+
+    bench->shutterTime = 0;
+    bench->jpegCount = 0;
+    bench->firstJpegTime = 0;
+    bench->lastJpegTime = 0;
+    bench->videoCount = 0;
+    bench->firstVideoTime = 0;
+    bench->lastVideoTime = 0;
+}
+
+static void notify_cb(int32_t msg_type, int32_t ext1, int32_t ext2, void *user)
+{
+    Bench *bench = (Bench *)user;
+    Mutex::Autolock lock(bench->lock);
+
+    if (msg_type == CAMERA_MSG_SHUTTER && bench->shutterTime == 0)
+        bench->shutterTime = systemTime(SYSTEM_TIME_MONOTONIC);
+}
+
+static void data_cb(int32_t msg_type, const camera_memory_t *data, unsigned int index,
+                    camera_frame_metadata_t *metadata, void *user)
+{
+    Bench *bench = (Bench *)user;
+    Mutex::Autolock lock(bench->lock);
+
+    if (msg_type == CAMERA_MSG_COMPRESSED_IMAGE) {
+        bench->lastJpegTime = systemTime(SYSTEM_TIME_MONOTONIC);
+        if (bench->jpegCount++ == 0)
+            bench->firstJpegTime = bench->lastJpegTime;
+        bench->condition.broadcast();
+    }
+}
+
+static void data_cb_timestamp(nsecs_t timestamp, int32_t msg_type,
+                              const camera_memory_t *data, unsigned index, void *user)
+{
+    Bench *bench = (Bench *)user;
+    const BenchMemory *m = (const BenchMemory *)data;
+
+    if (msg_type != CAMERA_MSG_VIDEO_FRAME)
+        return;
+
+    bench->lock.lock();
+    bench->lastVideoTime = systemTime(SYSTEM_TIME_MONOTONIC);
+    if (bench->videoCount++ == 0)
+        bench->firstVideoTime = bench->lastVideoTime;
+    bench->condition.broadcast();
+    bench->lock.unlock();
+
+    bench->dev->ops->release_recording_frame(bench->dev,
+            (char *)data->data + m->bufSize * index);
+}
+
+/* wait until *counter reaches count, false on timeout */
+static bool waitCount(Bench *bench, const int *counter, int count, nsecs_t timeout)
+{
+    nsecs_t end = systemTime(SYSTEM_TIME_MONOTONIC) + timeout;
+    Mutex::Autolock lock(bench->lock);
+
+    while (*counter < count) {
+        nsecs_t left = end - systemTime(SYSTEM_TIME_MONOTONIC);
+        if (left <= 0)
+            return false;
+        bench->condition.waitRelative(bench->lock, left);
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// cpu time of our threads from /proc
+
+struct ThreadCpu {
+    pid_t                   tid;
+    char                    name[32];
+    unsigned long           ticks;
+};
+
+static void sampleThreads(Vector<ThreadCpu> &threads)
+{
+    DIR *dir = opendir("/proc/self/task");
+    struct dirent *entry;
+
+    threads.clear();
+    if (dir == NULL)
+        return;
+
+    while ((entry = readdir(dir)) != NULL) {
+        char path[64];
+        char buf[512];
+        unsigned long utime, stime;
+        ThreadCpu thread;
+
+        thread.tid = atoi(entry->d_name);
+        if (thread.tid <= 0)
+            continue;
+
+        snprintf(path, sizeof(path), "/proc/self/task/%d/stat", thread.tid);
+        int fd = open(path, O_RDONLY);
+        if (fd < 0)
+            continue;
+        int len = read(fd, buf, sizeof(buf) - 1);
+        close(fd);
+        if (len <= 0)
+            continue;
+        buf[len] = '\0';
+
+        /* the name may hold spaces, the fields after it are fixed */
+        char *start = strchr(buf, '(');
+        char *end = strrchr(buf, ')');
+        if (start == NULL || end == NULL || end < start)
+            continue;
+        int name_len = end - start - 1;
+        if (name_len >= (int)sizeof(thread.name))
+            name_len = sizeof(thread.name) - 1;
+        memcpy(thread.name, start + 1, name_len);
+        thread.name[name_len] = '\0';
+
+        if (sscanf(end + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu",
+                   &utime, &stime) != 2)
+            continue;
+        thread.ticks = utime + stime;
+        threads.add(thread);
+    }
+    closedir(dir);
+}
+
+static void reportCpu(const char *camera, const Vector<ThreadCpu> &before,
+                      const Vector<ThreadCpu> &after, nsecs_t duration)
+{
+    const double ticks = sysconf(_SC_CLK_TCK) * (double)duration / seconds_to_nanoseconds(1);
+    unsigned long total = 0;
+    char metric[64];
+
+    for (size_t i = 0; i < after.size(); i++) {
+        unsigned long used = after[i].ticks;
+        for (size_t j = 0; j < before.size(); j++) {
+            if (before[j].tid == after[i].tid) {
+                used -= before[j].ticks;
+                break;
+            }
+        }
+        total += used;
+
+        /* the HAL names its threads Camera*, one per pipeline stage */
+        if (strncmp(after[i].name, "Camera", 6))
+            continue;
+        snprintf(metric, sizeof(metric), "cpu.%s", after[i].name);
+        RESULT(camera, metric, 100.0 * used / ticks, "%");
+    }
+    RESULT(camera, "cpu.total", 100.0 * total / ticks, "%");
+}
+
+// ---------------------------------------------------------------------------
+
+static double toMs(nsecs_t t)
+{
+    return t / 1000000.0;
+}
+
+static int compareNsecs(const void *a, const void *b)
+{
+    nsecs_t x = *(const nsecs_t *)a;
+    nsecs_t y = *(const nsecs_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void reportFrames(const char *camera, const char *prefix,
+                         const Vector<nsecs_t> &frames)
+{
+    char metric[64];
+    size_t n = frames.size();
+
+    if (n < 3) {
+        LOGE("%s:: only %d frames for %s", __func__, (int)n, prefix);
+        return;
+    }
+
+    nsecs_t *intervals = new nsecs_t[n - 1];
+    double mean = 0, var = 0;
+    for (size_t i = 1; i < n; i++) {
+        intervals[i - 1] = frames[i] - frames[i - 1];
+        mean += intervals[i - 1];
+    }
+    mean /= n - 1;
+    for (size_t i = 0; i < n - 1; i++)
+        var += (intervals[i] - mean) * (intervals[i] - mean);
+    var /= n - 1;
+    qsort(intervals, n - 1, sizeof(nsecs_t), compareNsecs);
+
+    snprintf(metric, sizeof(metric), "%s.fps", prefix);
+    RESULT(camera, metric, (n - 1) * 1000.0 / toMs(frames[n - 1] - frames[0]), "fps");
+    snprintf(metric, sizeof(metric), "%s.interval_mean", prefix);
+    RESULT(camera, metric, mean / 1000000.0, "ms");
+    snprintf(metric, sizeof(metric), "%s.jitter", prefix);
+    RESULT(camera, metric, sqrt(var) / 1000000.0, "ms");
+    snprintf(metric, sizeof(metric), "%s.interval_p99", prefix);
+    RESULT(camera, metric, toMs(intervals[(n - 1) * 99 / 100]), "ms");
+    snprintf(metric, sizeof(metric), "%s.interval_max", prefix);
+    RESULT(camera, metric, toMs(intervals[n - 2]), "ms");
+
+    delete [] intervals;
+}
+
+static int setParameter(camera_device_t *dev, const char *key, const char *value)
+{
+    char *str = dev->ops->get_parameters(dev);
+    if (str == NULL)
+        return -1;
+
+    CameraParameters params;
+    params.unflatten(String8(str));
+    if (dev->ops->put_parameters)
+        dev->ops->put_parameters(dev, str);
+    else
+        free(str);
+
+    params.set(key, value);
+    return dev->ops->set_parameters(dev, params.flatten().string());
+}
+
+static int startPreview(Bench *bench, const char *camera, const char *metric, nsecs_t since)
+{
+    nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+
+    if (bench->dev->ops->start_preview(bench->dev)) {
+        LOGE("%s:: Can't start preview", __func__);
+        return -1;
+    }
+    if (waitFrames(&bench->window, start, 1, kFrameTimeout) < 1) {
+        LOGE("%s:: No preview frame", __func__);
+        return -1;
+    }
+
+    Mutex::Autolock lock(bench->window.lock);
+    for (size_t i = 0; i < bench->window.frames.size(); i++) {
+        if (bench->window.frames[i] >= start) {
+            RESULT(camera, metric, toMs(bench->window.frames[i] - since), "ms");
+            break;
+        }
+    }
+    return 0;
+}
+
+static void measurePreview(Bench *bench, const char *camera, int seconds)
+{
+    Vector<ThreadCpu> before, after;
+    Vector<nsecs_t> frames;
+
+    /* the first frames come while the sensor still settles exposure */
+    usleep(1000000);
+
+    nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+    sampleThreads(before);
+    usleep(seconds * 1000000);
+    sampleThreads(after);
+    nsecs_t duration = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+
+    bench->window.lock.lock();
+    for (size_t i = 0; i < bench->window.frames.size(); i++) {
+        if (bench->window.frames[i] >= start)
+            frames.add(bench->window.frames[i]);
+    }
+    bench->window.frames.clear();
+    bench->window.lock.unlock();
+
+    reportFrames(camera, "preview", frames);
+    reportCpu(camera, before, after, duration);
+}
+
+static int measureShots(Bench *bench, const char *camera)
+{
+    camera_device_t *dev = bench->dev;
+
+    resetBench(bench);
+    nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+    if (dev->ops->take_picture(dev)) {
+        LOGE("%s:: Can't take picture", __func__);
+        return -1;
+    }
+    if (!waitCount(bench, &bench->jpegCount, 1, kPictureTimeout)) {
+        LOGE("%s:: No picture", __func__);
+        return -1;
+    }
+    if (bench->shutterTime)
+        RESULT(camera, "shot.shutter", toMs(bench->shutterTime - start), "ms");
+    RESULT(camera, "shot.latency", toMs(bench->firstJpegTime - start), "ms");
+
+    /* what the user waits for between two presses of the button */
+    nsecs_t first = bench->firstJpegTime;
+    if (startPreview(bench, camera, "shot.preview_restart", first) < 0)
+        return -1;
+    resetBench(bench);
+    if (dev->ops->take_picture(dev) ||
+        !waitCount(bench, &bench->jpegCount, 1, kPictureTimeout)) {
+        LOGE("%s:: No second picture", __func__);
+        return -1;
+    }
+    RESULT(camera, "shot.shot_to_shot", toMs(bench->firstJpegTime - first), "ms");
+
+    return startPreview(bench, camera, "shot.preview_restart", bench->firstJpegTime);
+}
+
+static int measureBurst(Bench *bench, const char *camera, int shots)
+{
+    camera_device_t *dev = bench->dev;
+    int ret = 0;
+
+    if (shots < 2)
+        return 0;
+
+    if (setParameter(dev, "burst-capture", "true")) {
+        LOGE("%s:: Can't enable burst capture", __func__);
+        return -1;
+    }
+
+    resetBench(bench);
+    if (dev->ops->take_picture(dev) ||
+        !waitCount(bench, &bench->jpegCount, shots, kPictureTimeout * shots)) {
+        LOGE("%s:: Got only %d burst pictures", __func__, bench->jpegCount);
+        ret = -1;
+    } else {
+        RESULT(camera, "burst.fps",
+               (bench->jpegCount - 1) * 1000.0 / toMs(bench->lastJpegTime - bench->firstJpegTime),
+               "fps");
+    }
+
+    /* starting the preview is what ends a burst */
+    setParameter(dev, "burst-capture", "false");
+    if (startPreview(bench, camera, "burst.preview_restart", systemTime(SYSTEM_TIME_MONOTONIC)) < 0)
+        ret = -1;
+    return ret;
+}
+
+static int measureRecord(Bench *bench, const char *camera, bool hint)
+{
+    camera_device_t *dev = bench->dev;
+    const char *metric = hint ? "record.switch_hint" : "record.switch";
+
+    setParameter(dev, CameraParameters::KEY_RECORDING_HINT, hint ? "true" : "false");
+    /* let a hinted record node come up before the clock starts */
+    usleep(500000);
+
+    resetBench(bench);
+    nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+    if (dev->ops->start_recording(dev)) {
+        LOGE("%s:: Can't start recording", __func__);
+        return -1;
+    }
+    if (!waitCount(bench, &bench->videoCount, 1, kFrameTimeout)) {
+        LOGE("%s:: No video frame", __func__);
+        dev->ops->stop_recording(dev);
+        return -1;
+    }
+    RESULT(camera, metric, toMs(bench->firstVideoTime - start), "ms");
+
+    usleep(2000000);
+    dev->ops->stop_recording(dev);
+
+    Mutex::Autolock lock(bench->lock);
+    if (bench->videoCount > 1) {
+        RESULT(camera, hint ? "record.fps_hint" : "record.fps",
+               (bench->videoCount - 1) * 1000.0 / toMs(bench->lastVideoTime - bench->firstVideoTime),
+               "fps");
+    }
+    return 0;
+}
+
+static int runCamera(camera_module_t *module, int id, int seconds, int shots)
+{
+    struct camera_info info;
+    char name[8];
+    Bench bench;
+    int ret;
+
+    if (module->get_camera_info(id, &info)) {
+        LOGE("%s:: No info for camera %d", __func__, id);
+        return -1;
+    }
+    const char *camera = info.facing == CAMERA_FACING_FRONT ? "front" : "back";
+
+    if (initWindow(&bench.window) < 0)
+        return -1;
+    resetBench(&bench);
+
+    snprintf(name, sizeof(name), "%d", id);
+    nsecs_t open_start = systemTime(SYSTEM_TIME_MONOTONIC);
+    ret = module->common.methods->open(&module->common, name,
+                                       (hw_device_t **)&bench.dev);
+    if (ret) {
+        LOGE("%s:: Can't open camera %d", __func__, id);
+        goto close_alloc;
+    }
+    RESULT(camera, "open", toMs(systemTime(SYSTEM_TIME_MONOTONIC) - open_start), "ms");
+
+    bench.dev->ops->set_callbacks(bench.dev, notify_cb, data_cb, data_cb_timestamp,
+                                  get_memory, &bench);
+    bench.dev->ops->enable_msg_type(bench.dev, CAMERA_MSG_SHUTTER |
+                                               CAMERA_MSG_COMPRESSED_IMAGE |
+                                               CAMERA_MSG_VIDEO_FRAME);
+    if (bench.dev->ops->set_preview_window(bench.dev, &bench.window.ops)) {
+        LOGE("%s:: Can't set preview window", __func__);
+        ret = -1;
+        goto close;
+    }
+
+    ret = startPreview(&bench, camera, "first_frame", open_start);
+    if (ret < 0)
+        goto close;
+
+    LOGI("camera %s: preview for %d s", camera, seconds);
+    measurePreview(&bench, camera, seconds);
+
+    LOGI("camera %s: single shots", camera);
+    if (measureShots(&bench, camera) < 0)
+        ret = -1;
+
+    LOGI("camera %s: burst of %d", camera, shots);
+    if (measureBurst(&bench, camera, shots) < 0)
+        ret = -1;
+
+    LOGI("camera %s: recording", camera);
+    if (measureRecord(&bench, camera, false) < 0 ||
+        measureRecord(&bench, camera, true) < 0)
+        ret = -1;
+
+    bench.dev->ops->stop_preview(bench.dev);
+    bench.dev->ops->set_preview_window(bench.dev, NULL);
+
+close:
+    if (bench.dev->common.close(&bench.dev->common) < 0)
+        LOGE("%s:: Can't close camera %d", __func__, id);
+
+close_alloc:
+    bench.window.lock.lock();
+    freeWindowBuffers(&bench.window);
+    bench.window.lock.unlock();
+    gralloc_close(bench.window.alloc);
+    return ret;
+}
+
+int main(int argc, char** argv) {
+    camera_module_t* module;
+    int              camera = -1;
+    int              seconds = 10;
+    int              shots = 5;
+    int              opt;
+    int              ret = 0;
+
+    while ((opt = getopt(argc, argv, "c:t:n:")) != -1) {
+        switch (opt) {
+        case 'c':
+            camera = atoi(optarg);
+            break;
+        case 't':
+            seconds = atoi(optarg);
+            break;
+        case 'n':
+            shots = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-c camera id] [-t seconds] [-n burst shots]\n",
+                    argv[0]);
+            return -EINVAL;
+        }
+    }
+
+    if (hw_get_module(CAMERA_HARDWARE_MODULE_ID, (const hw_module_t **)&module)) {
+        LOGE("%s:: Camera module not presented", __func__);
+        return -ENODEV;
+    }
+
+    int count = module->get_number_of_cameras();
+    for (int id = 0; id < count; id++) {
+        if (camera >= 0 && id != camera)
+            continue;
+        if (runCamera(module, id, seconds, shots) < 0)
+            ret = -1;
+    }
+
+    LOGI("Camera bench result: %d", ret);
+    return ret;
+}
@@ -22,32 +22,43 @@
 
 #include <hardware/hwcomposer.h>
 
+#define ATRACE_TAG ATRACE_TAG_GRAPHICS
 #include <cutils/log.h>
 
+#include <sec_trace.h>
+#include <sec_v4l2.h>
+
 #include "fimc.h"
 
 typedef struct sec_img  sec_img;
 typedef struct sec_rect sec_rect;
 
-int fimc_v4l2_set_src(int fd, unsigned int hw_ver, s5p_fimc_img_info *src)
+int fimc_v4l2_set_src(int fd, unsigned int hw_ver, s5p_fimc_img_info *src,
+                      int update_fmt)
 {
     struct v4l2_format  fmt;
     struct v4l2_cropcap cropcap;
     struct v4l2_crop    crop;
-    struct v4l2_requestbuffers req;
+    int ret;
+
+    if (!update_fmt)
+        goto reqbufs;
 
     /*
-     * To set size & format for source image (DMA-INPUT)
+     * To set size & format for source image (DMA-INPUT), the caller
+     * already knows whether the node has it
      */
+    memset(&fmt, 0, sizeof(fmt));
     fmt.type                = V4L2_BUF_TYPE_VIDEO_OUTPUT;
     fmt.fmt.pix.width       = src->full_width;
     fmt.fmt.pix.height      = src->full_height;
     fmt.fmt.pix.pixelformat = src->color_space;
     fmt.fmt.pix.field       = V4L2_FIELD_NONE;
 
-    if (ioctl (fd, VIDIOC_S_FMT, &fmt) < 0) {
-        ALOGE("VIDIOC_S_FMT failed : errno=%d (%s) : fd=%d", errno,
-                strerror(errno), fd);
+    ret = sec_v4l2_s_fmt(fd, NULL, &fmt);
+    if (ret < 0) {
+        ALOGE("VIDIOC_S_FMT failed : errno=%d (%s) : fd=%d", -ret,
+                strerror(-ret), fd);
         return -1;
     }
 
@@ -70,14 +81,11 @@ int fimc_v4l2_set_src(int fd, unsigned int hw_ver, s5p_fimc_img_info *src)
         return -1;
     }
 
+reqbufs:
     /*
-     * input buffer type
+     * input buffer type, released after every oneshot
      */
-    req.count       = 1;
-    req.type        = V4L2_BUF_TYPE_VIDEO_OUTPUT;
-    req.memory      = V4L2_MEMORY_USERPTR;
-
-    if (ioctl (fd, VIDIOC_REQBUFS, &req) < 0) {
+    if (sec_v4l2_reqbufs(fd, V4L2_BUF_TYPE_VIDEO_OUTPUT, V4L2_MEMORY_USERPTR, 1) < 0) {
         ALOGE("Error in VIDIOC_REQBUFS");
         return -1;
     }
@@ -90,12 +98,17 @@ int fimc_v4l2_set_dst(int fd,
                       int rotation,
                       int flag_h_flip,
                       int flag_v_flip,
-                      unsigned int addr)
+                      unsigned int addr,
+                      int update_ctrl,
+                      int update_win)
 {
     struct v4l2_format      sFormat;
     struct v4l2_control     vc;
     struct v4l2_framebuffer fbuf;
 
+    if (!update_ctrl)
+        goto fbuf;
+
     /*
      * set rotation configuration
      */
@@ -120,8 +133,10 @@ int fimc_v4l2_set_dst(int fd,
         return -1;
     }
 
+fbuf:
     /*
-     * set size, format & address for destination image (DMA-OUTPUT)
+     * set size, format & address for destination image (DMA-OUTPUT),
+     * the address moves to another window buffer every frame
      */
     if (ioctl (fd, VIDIOC_G_FBUF, &fbuf) < 0) {
         ALOGE("Error in video VIDIOC_G_FBUF");
@@ -139,6 +154,9 @@ int fimc_v4l2_set_dst(int fd,
         return -1;
     }
 
+    if (!update_win)
+        return 0;
+
     /*
      * set destination window
      */
@@ -158,7 +176,7 @@ int fimc_v4l2_set_dst(int fd,
 
 int fimc_v4l2_stream_on(int fd, enum v4l2_buf_type type)
 {
-    if (ioctl (fd, VIDIOC_STREAMON, &type) < 0) {
+    if (sec_v4l2_streamon(fd, type) < 0) {
         ALOGE("Error in VIDIOC_STREAMON");
         return -1;
     }
@@ -168,15 +186,8 @@ int fimc_v4l2_stream_on(int fd, enum v4l2_buf_type type)
 
 int fimc_v4l2_queue(int fd, struct fimc_buf *fimc_buf)
 {
-    struct v4l2_buffer buf;
-
-    buf.type        = V4L2_BUF_TYPE_VIDEO_OUTPUT;
-    buf.memory      = V4L2_MEMORY_USERPTR;
-    buf.m.userptr   = (unsigned long)fimc_buf;
-    buf.length      = 0;
-    buf.index       = 0;
-
-    if (ioctl (fd, VIDIOC_QBUF, &buf) < 0) {
+    if (sec_v4l2_qbuf(fd, V4L2_BUF_TYPE_VIDEO_OUTPUT, V4L2_MEMORY_USERPTR,
+                      0, (unsigned long)fimc_buf) < 0) {
         ALOGE("Error in VIDIOC_QBUF");
         return -1;
     }
@@ -186,25 +197,20 @@ int fimc_v4l2_queue(int fd, struct fimc_buf *fimc_buf)
 
 int fimc_v4l2_dequeue(int fd)
 {
-    struct v4l2_buffer buf;
+    int index;
 
-    buf.type        = V4L2_BUF_TYPE_VIDEO_OUTPUT;
-    buf.memory      = V4L2_MEMORY_USERPTR;
-
-    if (ioctl (fd, VIDIOC_DQBUF, &buf) < 0) {
+    index = sec_v4l2_dqbuf(fd, V4L2_BUF_TYPE_VIDEO_OUTPUT, V4L2_MEMORY_USERPTR, NULL);
+    if (index < 0) {
         ALOGE("Error in VIDIOC_DQBUF");
         return -1;
     }
 
-    return buf.index;
+    return index;
 }
 
 int fimc_v4l2_stream_off(int fd)
 {
-    enum v4l2_buf_type type;
-    type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
-
-    if (ioctl (fd, VIDIOC_STREAMOFF, &type) < 0) {
+    if (sec_v4l2_streamoff(fd, V4L2_BUF_TYPE_VIDEO_OUTPUT) < 0) {
         ALOGE("Error in VIDIOC_STREAMOFF");
         return -1;
     }
@@ -214,13 +220,7 @@ int fimc_v4l2_stream_off(int fd)
 
 int fimc_v4l2_clr_buf(int fd)
 {
-    struct v4l2_requestbuffers req;
-
-    req.count   = 0;
-    req.type    = V4L2_BUF_TYPE_VIDEO_OUTPUT;
-    req.memory  = V4L2_MEMORY_USERPTR;
-
-    if (ioctl (fd, VIDIOC_REQBUFS, &req) < 0) {
+    if (sec_v4l2_reqbufs(fd, V4L2_BUF_TYPE_VIDEO_OUTPUT, V4L2_MEMORY_USERPTR, 0) < 0) {
         ALOGE("Error in VIDIOC_REQBUFS");
     }
 
@@ -262,15 +262,46 @@ stream_off:
     return ret;
 }
 
+int fimc_src_planes(uint32_t format)
+{
+    switch (format) {
+    case HAL_PIXEL_FORMAT_RGBA_8888:
+    case HAL_PIXEL_FORMAT_RGBX_8888:
+    case HAL_PIXEL_FORMAT_BGRA_8888:
+    case HAL_PIXEL_FORMAT_RGB_565:
+    case HAL_PIXEL_FORMAT_YCbCr_422_I:
+    case HAL_PIXEL_FORMAT_CUSTOM_YCbCr_422_I:
+    case HAL_PIXEL_FORMAT_CbYCrY_422_I:
+    case HAL_PIXEL_FORMAT_CUSTOM_CbYCrY_422_I:
+        return 1;
+    case HAL_PIXEL_FORMAT_YCbCr_420_SP:
+    case HAL_PIXEL_FORMAT_CUSTOM_YCbCr_420_SP:
+    case HAL_PIXEL_FORMAT_YCbCr_422_SP:
+    case HAL_PIXEL_FORMAT_CUSTOM_YCbCr_422_SP:
+    case HAL_PIXEL_FORMAT_CUSTOM_YCbCr_420_SP_TILED:
+        return 2;
+    case HAL_PIXEL_FORMAT_YCbCr_420_P:
+    case HAL_PIXEL_FORMAT_YCbCr_422_P:
+        return 3;
+    default:
+        return 0;
+    }
+}
+
 static int get_src_phys_addr(s5p_fimc_t *fimc,
                              sec_img *src_img,
                              unsigned int *phyAddr)
 {
    if(src_img->mem_type == FIMC_MEM_TYPE_PHYS) {
-        switch(src_img->format) {
-        case HAL_PIXEL_FORMAT_YCbCr_420_SP:
-            fimc->params.src.buf_addr_phy_rgb_y = phyAddr[0];
+        switch(fimc_src_planes(src_img->format)) {
+        case 3:
+            fimc->params.src.buf_addr_phy_cr    = phyAddr[2];
+            /* fall through */
+        case 2:
             fimc->params.src.buf_addr_phy_cb    = phyAddr[1];
+            /* fall through */
+        case 1:
+            fimc->params.src.buf_addr_phy_rgb_y = phyAddr[0];
             break;
         default:
             ALOGE("%s format error (format=0x%x)", __func__,
@@ -553,6 +584,42 @@ static int fimc_core(s5p_fimc_t *fimc,
     }
 
 
+    /*
+     * steady video gives the same configuration frame after frame, only
+     * rewrite what changed. the addresses are not part of it. whoever
+     * else had the node since leaves it set up their way.
+     */
+    if (sec_v4l2_gen_changed(&fimc->gen))
+        fimc->applied_valid = 0;
+
+    s5p_fimc_img_info *old_src = &fimc->applied.src;
+    s5p_fimc_img_info *old_dst = &fimc->applied.dst;
+    int update_ctrl = !fimc->applied_valid ||
+                      fimc->applied_rotation != rotate_value ||
+                      fimc->applied_h_flip != flag_h_flip ||
+                      fimc->applied_v_flip != flag_v_flip;
+    int update_win  = !fimc->applied_valid ||
+                      old_dst->full_width  != params->dst.full_width ||
+                      old_dst->full_height != params->dst.full_height ||
+                      old_dst->color_space != params->dst.color_space ||
+                      old_dst->start_x != params->dst.start_x ||
+                      old_dst->start_y != params->dst.start_y ||
+                      old_dst->width   != params->dst.width ||
+                      old_dst->height  != params->dst.height;
+    int update_src  = !fimc->applied_valid ||
+                      old_src->full_width  != params->src.full_width ||
+                      old_src->full_height != params->src.full_height ||
+                      old_src->start_x     != params->src.start_x ||
+                      old_src->start_y     != params->src.start_y ||
+                      old_src->width       != params->src.width ||
+                      old_src->height      != params->src.height ||
+                      old_src->color_space != params->src.color_space;
+
+    /* anything failing below leaves the driver state unknown */
+    fimc->applied_valid = 0;
+    if (update_ctrl || update_win || update_src)
+        sec_v4l2_gen_bump(&fimc->gen);
+
     /* set configuration related to destination (DMA-OUT)
      *   - set input format & size
      *   - crop input size
@@ -564,7 +631,9 @@ static int fimc_core(s5p_fimc_t *fimc,
                           rotate_value,
                           flag_h_flip,
                           flag_v_flip,
-                          dst_phys_addr) < 0) {
+                          dst_phys_addr,
+                          update_ctrl,
+                          update_win) < 0) {
         return -1;
     }
 
@@ -574,12 +643,25 @@ static int fimc_core(s5p_fimc_t *fimc,
      *   - set input buffer
      *   - set buffer type (V4L2_MEMORY_USERPTR)
      */
-    if (fimc_v4l2_set_src(fimc->dev_fd, fimc->hw_ver, &params->src) < 0)
+    if (fimc_v4l2_set_src(fimc->dev_fd, fimc->hw_ver, &params->src,
+                          update_src) < 0)
         return -1;
 
+    fimc->applied = *params;
+    fimc->applied_rotation = rotate_value;
+    fimc->applied_h_flip = flag_h_flip;
+    fimc->applied_v_flip = flag_v_flip;
+    fimc->applied_valid = 1;
+
     /* set input dma address (Y/RGB, Cb, Cr) */
-    switch (src_img->format) {
-    case HAL_PIXEL_FORMAT_YCbCr_420_SP:
+    switch (fimc_src_planes(src_img->format)) {
+    case 3:
+        fimc_src_buf.base[0] = params->src.buf_addr_phy_rgb_y;
+        fimc_src_buf.base[1] = params->src.buf_addr_phy_cb;
+        fimc_src_buf.base[2] = params->src.buf_addr_phy_cr;
+        break;
+
+    case 2:
         /* for video display zero copy case */
         fimc_src_buf.base[0] = params->src.buf_addr_phy_rgb_y;
         fimc_src_buf.base[1] = params->src.buf_addr_phy_cb;
@@ -593,6 +675,7 @@ static int fimc_core(s5p_fimc_t *fimc,
 
     if (fimc_handle_oneshot(fimc->dev_fd, &fimc_src_buf) < 0) {
         fimc_v4l2_clr_buf(fimc->dev_fd);
+        fimc->applied_valid = 0;
         return -1;
     }
 
@@ -630,6 +713,8 @@ int fimc_open(s5p_fimc_t *fimc, const char* dev)
             goto err;
         }
     }
+    fimc->applied_valid = 0;
+    sec_v4l2_gen_open(&fimc->gen, fimc->dev_fd);
 
     /* check capability */
     if (ioctl(fimc->dev_fd, VIDIOC_QUERYCAP, &cap) < 0) {
@@ -665,11 +750,16 @@ int fimc_open(s5p_fimc_t *fimc, const char* dev)
     }
     fimc->hw_ver = vc.value;
 
+    /* users scaling into the reserved memory of the node find it here */
+    fimc->out_buf.phys_addr = fimc_get_reserved_mem_addr(fimc);
+
     return 0;
 
 err:
-    if (0 <= fimc->dev_fd)
+    if (0 <= fimc->dev_fd) {
+        sec_v4l2_gen_close(&fimc->gen);
         close(fimc->dev_fd);
+    }
     fimc->dev_fd = -1;
 
     return -1;
@@ -677,9 +767,12 @@ err:
 
 void fimc_close(s5p_fimc_t *fimc)
 {
+    fimc->applied_valid = 0;
     /* close */
-    if (0 <= fimc->dev_fd)
+    if (0 <= fimc->dev_fd) {
+        sec_v4l2_gen_close(&fimc->gen);
         close(fimc->dev_fd);
+    }
     fimc->dev_fd = -1;
 }
 
@@ -694,6 +787,7 @@ int fimc_flush(s5p_fimc_t *fimc,
     unsigned int dst_phys_addr = 0;
     int32_t      src_color_space;
     int32_t      dst_color_space;
+    int          ret;
 
     /* 1 : source address and size */
 
@@ -711,8 +805,11 @@ int fimc_flush(s5p_fimc_t *fimc,
     if (0 > (dst_color_space = HAL_PIXEL_FORMAT_2_V4L2_PIX(dst_img->format)))
         return -4;
 
-    if(fimc_core(fimc, src_img, src_rect, (uint32_t)src_color_space,
-            dst_phys_addr, dst_img, dst_rect, (uint32_t)dst_color_space, transform) < 0)
+    SEC_TRACE_BEGIN("fimc:flush");
+    ret = fimc_core(fimc, src_img, src_rect, (uint32_t)src_color_space,
+            dst_phys_addr, dst_img, dst_rect, (uint32_t)dst_color_space, transform);
+    SEC_TRACE_END();
+    if (ret < 0)
         return -5;
 
     return 0;
@@ -71,6 +71,9 @@ int     fimc_flush(s5p_fimc_t *fimc,
 
 void*   fimc_get_reserved_mem_addr(s5p_fimc_t *fimc);
 
+/* physical planes of a source format the fimc takes, 0 if it doesn't */
+int     fimc_src_planes(uint32_t format);
+
 #ifdef __cplusplus
 }
 #endif
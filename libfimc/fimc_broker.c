@@ -0,0 +1,296 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+#include <sys/file.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+#include <hardware/hwcomposer.h>
+
+#define ATRACE_TAG ATRACE_TAG_GRAPHICS
+#include <cutils/log.h>
+
+#include <sec_thread.h>
+#include <sec_trace.h>
+
+#include "fimc_broker.h"
+
+/* the s5pc110 has three fimc, one more for a board that names them twice */
+#define FIMC_BROKER_MAX_NODES   (4)
+
+/* one per fimc node, it lives as long as the process */
+struct fimc_lane {
+    dev_t                    rdev;
+    int                      used;
+    pthread_t                thread;
+    pthread_mutex_t          lock;
+    pthread_cond_t           cond;
+    struct fimc_job         *queue;     /* in submit order */
+    struct fimc_broker_stats stats;
+};
+
+static struct fimc_lane g_lanes[FIMC_BROKER_MAX_NODES];
+static pthread_mutex_t  g_lanes_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int64_t fimc_broker_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int64_t job_due(struct fimc_job *job)
+{
+    return job->deadline ? job->deadline : job->queued;
+}
+
+/* display jobs earliest deadline first, the rest in submit order */
+static struct fimc_job *lane_pick(struct fimc_lane *lane)
+{
+    struct fimc_job **best = &lane->queue;
+    struct fimc_job **pp;
+    struct fimc_job  *job;
+
+    for (pp = &(*best)->next; *pp; pp = &(*pp)->next) {
+        if ((*pp)->priority < (*best)->priority ||
+            ((*pp)->priority == FIMC_JOB_DISPLAY &&
+             (*best)->priority == FIMC_JOB_DISPLAY &&
+             job_due(*pp) < job_due(*best)))
+            best = pp;
+    }
+
+    job = *best;
+    *best = job->next;
+    job->next = NULL;
+    return job;
+}
+
+static int lane_run(struct fimc_lane *lane, struct fimc_job *job)
+{
+    s5p_fimc_t *fimc = job->fimc;
+    int locked = 1;
+    int ret;
+
+    if (flock(fimc->dev_fd, LOCK_EX | LOCK_NB) < 0) {
+        if (errno != EWOULDBLOCK) {
+            locked = 0;
+        } else {
+            lane->stats.contended++;
+            if (job->priority != FIMC_JOB_DISPLAY) {
+                lane->stats.busy++;
+                return -EBUSY;
+            }
+            if (flock(fimc->dev_fd, LOCK_EX) < 0)
+                locked = 0;
+        }
+    }
+
+    /*
+     * with the lock held fimc_flush() checks the generation of the node,
+     * any user here or in another process since its last job shows. an
+     * unlocked job can't trust its cache at all.
+     */
+    if (!locked)
+        fimc->applied_valid = 0;
+
+    ret = fimc_flush(fimc, &job->src_img, &job->src_rect,
+            &job->dst_img, &job->dst_rect, job->phyAddr, job->transform);
+
+    if (locked)
+        flock(fimc->dev_fd, LOCK_UN);
+
+    return ret;
+}
+
+static void *fimc_lane_thread(void *data)
+{
+    struct fimc_lane *lane = (struct fimc_lane *)data;
+    struct fimc_job  *job;
+    int64_t start;
+    int ret;
+
+    /* it mostly waits on the hardware, but display jobs can't wait on it */
+    sec_thread_set_role(SEC_THREAD_ROLE_DISPLAY);
+
+    pthread_mutex_lock(&lane->lock);
+    while (1) {
+        while (!lane->queue)
+            pthread_cond_wait(&lane->cond, &lane->lock);
+        job = lane_pick(lane);
+        pthread_mutex_unlock(&lane->lock);
+
+        SEC_TRACE_BEGIN("fimc:job");
+        start = fimc_broker_now();
+        ret = lane_run(lane, job);
+        job->run_ns = fimc_broker_now() - start;
+        SEC_TRACE_END();
+
+        pthread_mutex_lock(&lane->lock);
+        lane->stats.jobs[job->priority]++;
+        if (job->priority == FIMC_JOB_DISPLAY) {
+            if (start - job->queued > lane->stats.wait_max_ns)
+                lane->stats.wait_max_ns = start - job->queued;
+            if (job->deadline && start + job->run_ns > job->deadline)
+                lane->stats.missed++;
+        }
+        pthread_mutex_unlock(&lane->lock);
+
+        /* the job may be gone once done returns */
+        job->done(job, ret);
+
+        pthread_mutex_lock(&lane->lock);
+    }
+
+    return NULL;
+}
+
+/* the lane of the node behind the fd, started on first use */
+static struct fimc_lane *fimc_lane_get(s5p_fimc_t *fimc)
+{
+    struct fimc_lane *lane = NULL;
+    struct stat st;
+    int err;
+    int i;
+
+    if (fimc->dev_fd < 0 || fstat(fimc->dev_fd, &st) < 0)
+        return NULL;
+
+    pthread_mutex_lock(&g_lanes_lock);
+    for (i = 0; i < FIMC_BROKER_MAX_NODES; i++) {
+        if (g_lanes[i].used && g_lanes[i].rdev == st.st_rdev) {
+            lane = &g_lanes[i];
+            goto done;
+        }
+    }
+
+    for (i = 0; i < FIMC_BROKER_MAX_NODES; i++) {
+        if (!g_lanes[i].used)
+            break;
+    }
+    if (i == FIMC_BROKER_MAX_NODES) {
+        ALOGE("%s::no lane left for node %x", __func__, (unsigned int)st.st_rdev);
+        goto done;
+    }
+
+    lane = &g_lanes[i];
+    memset(lane, 0, sizeof(*lane));
+    pthread_mutex_init(&lane->lock, NULL);
+    pthread_cond_init(&lane->cond, NULL);
+    err = pthread_create(&lane->thread, NULL, fimc_lane_thread, lane);
+    if (err) {
+        ALOGE("%s::pthread_create() failed : %s", __func__, strerror(err));
+        pthread_cond_destroy(&lane->cond);
+        pthread_mutex_destroy(&lane->lock);
+        lane = NULL;
+        goto done;
+    }
+    lane->rdev = st.st_rdev;
+    lane->used = 1;
+
+done:
+    pthread_mutex_unlock(&g_lanes_lock);
+    return lane;
+}
+
+int fimc_broker_submit(struct fimc_job *job)
+{
+    struct fimc_lane *lane;
+    struct fimc_job **pp;
+
+    if (!job->done || job->priority < 0 || job->priority >= FIMC_JOB_PRIORITY_CNT)
+        return -EINVAL;
+
+    lane = fimc_lane_get(job->fimc);
+    if (!lane)
+        return -ENODEV;
+
+    job->queued = fimc_broker_now();
+    job->run_ns = 0;
+    job->next = NULL;
+
+    pthread_mutex_lock(&lane->lock);
+    for (pp = &lane->queue; *pp; pp = &(*pp)->next)
+        ;
+    *pp = job;
+    pthread_cond_signal(&lane->cond);
+    pthread_mutex_unlock(&lane->lock);
+
+    return 0;
+}
+
+struct fimc_broker_sync {
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+    int             done;
+    int             ret;
+};
+
+static void fimc_broker_sync_done(struct fimc_job *job, int ret)
+{
+    struct fimc_broker_sync *sync = (struct fimc_broker_sync *)job->data;
+
+    pthread_mutex_lock(&sync->lock);
+    sync->ret = ret;
+    sync->done = 1;
+    pthread_cond_signal(&sync->cond);
+    pthread_mutex_unlock(&sync->lock);
+}
+
+int fimc_broker_run(struct fimc_job *job)
+{
+    struct fimc_broker_sync sync;
+    int ret;
+
+    pthread_mutex_init(&sync.lock, NULL);
+    pthread_cond_init(&sync.cond, NULL);
+    sync.done = 0;
+    sync.ret = 0;
+
+    job->done = fimc_broker_sync_done;
+    job->data = &sync;
+
+    ret = fimc_broker_submit(job);
+    if (ret == 0) {
+        pthread_mutex_lock(&sync.lock);
+        while (!sync.done)
+            pthread_cond_wait(&sync.cond, &sync.lock);
+        pthread_mutex_unlock(&sync.lock);
+        ret = sync.ret;
+    }
+
+    pthread_cond_destroy(&sync.cond);
+    pthread_mutex_destroy(&sync.lock);
+
+    return ret;
+}
+
+int fimc_broker_get_stats(s5p_fimc_t *fimc, struct fimc_broker_stats *stats)
+{
+    struct fimc_lane *lane = fimc_lane_get(fimc);
+
+    if (!lane)
+        return -ENODEV;
+
+    pthread_mutex_lock(&lane->lock);
+    *stats = lane->stats;
+    pthread_mutex_unlock(&lane->lock);
+
+    return 0;
+}
@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _FIMC_BROKER_
+#define _FIMC_BROKER_
+
+#include <stdint.h>
+
+#include "fimc.h"
+
+/*
+ * Every fimc node gets one thread per process that runs the fimc_flush()
+ * jobs of all its users. Display jobs go first, earliest deadline first,
+ * background jobs only get the node while no display job waits. A job
+ * holds a flock on the node while it runs, so users in other processes
+ * programming the same node never interleave with it.
+ */
+
+enum {
+    FIMC_JOB_DISPLAY = 0,   /* scanned out at a vsync */
+    FIMC_JOB_BACKGROUND,    /* nobody waits on a vsync for it */
+    FIMC_JOB_PRIORITY_CNT,
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct fimc_job;
+
+/* called on the thread of the node once the job ran, ret as fimc_flush()
+ * returns it or -EBUSY if a background job found the node taken */
+typedef void (*fimc_job_done_t)(struct fimc_job *job, int ret);
+
+struct fimc_job {
+    s5p_fimc_t      *fimc;
+    struct sec_img   src_img;
+    struct sec_rect  src_rect;
+    struct sec_img   dst_img;
+    struct sec_rect  dst_rect;
+    unsigned int     phyAddr[3];
+    uint32_t         transform;
+
+    int              priority;
+    /* CLOCK_MONOTONIC ns the result is due, 0 for as soon as possible */
+    int64_t          deadline;
+    fimc_job_done_t  done;
+    void            *data;
+
+    /* filled in by the broker */
+    int64_t          queued;
+    int64_t          run_ns;
+    struct fimc_job *next;
+};
+
+struct fimc_broker_stats {
+    unsigned int     jobs[FIMC_JOB_PRIORITY_CNT];
+    unsigned int     missed;        /* display jobs done after their deadline */
+    unsigned int     contended;     /* runs that found another process on the node */
+    unsigned int     busy;          /* background jobs given up for it */
+    int64_t          wait_max_ns;   /* longest a display job sat in the queue */
+};
+
+/* queue a job, it and its buffers stay the caller's business until done */
+int     fimc_broker_submit(struct fimc_job *job);
+
+/* run a job and wait for it, done and data are not used */
+int     fimc_broker_run(struct fimc_job *job);
+
+int     fimc_broker_get_stats(s5p_fimc_t *fimc, struct fimc_broker_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // end of _FIMC_BROKER_
@@ -21,10 +21,11 @@ LOCAL_CFLAGS := -fno-short-enums
 LOCAL_CFLAGS += -DLOG_TAG=\"hdmi.$(TARGET_BOARD_PLATFORM)\"
 
 LOCAL_C_INCLUDES := \
-    $(LOCAL_PATH)/../include
+    $(LOCAL_PATH)/../include \
+    $(LOCAL_PATH)/../libfimc \
+    $(LOCAL_PATH)/../libsecmem
 
 LOCAL_SRC_FILES := \
-    fimc.c \
     fimd.c \
     SecHDMI.cpp \
     hal_module.cpp
@@ -33,7 +34,7 @@ LOCAL_MODULE := hdmi.s5pc110
 LOCAL_MODULE_PATH := $(TARGET_OUT_SHARED_LIBRARIES)/hw
 LOCAL_MODULE_TAGS := optional
 
-LOCAL_SHARED_LIBRARIES := liblog libutils
+LOCAL_SHARED_LIBRARIES := liblog libutils libcutils libfimc libsecmem
  
 include $(BUILD_SHARED_LIBRARY)
 
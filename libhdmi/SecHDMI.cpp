@@ -15,13 +15,20 @@
  */
 
 #define LOG_NDEBUG 0
+#define ATRACE_TAG ATRACE_TAG_GRAPHICS
 #include <utils/Log.h>
 
 #include <string.h>
 #include <stdlib.h>
+#include <time.h>
 #include <sys/poll.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
 
+#include <cutils/properties.h>
 #include <sec_lcd.h>
+#include <sec_trace.h>
+#include <sec_tvout.h>
 
 #include "SecHDMI.h"
 #include "fimd.h"
@@ -48,49 +55,36 @@ using namespace android;
 struct s5p_tv_standart_internal {
     int index;
     unsigned long value;
+    int width;
+    int height;
+    int hz;
+    bool wide;
 } s5p_tv_standards[] = {
-    {
-        S5P_TV_STD_NTSC_M,
-        V4L2_STD_NTSC_M,
-    }, {
-        S5P_TV_STD_PAL_BDGHI,
-        V4L2_STD_PAL_BDGHI,
-    }, {
-        S5P_TV_STD_PAL_M,
-        V4L2_STD_PAL_M,
-    }, {
-        S5P_TV_STD_PAL_N,
-        V4L2_STD_PAL_N,
-    }, {
-        S5P_TV_STD_PAL_Nc,
-        V4L2_STD_PAL_Nc,
-    }, {
-        S5P_TV_STD_PAL_60,
-        V4L2_STD_PAL_60,
-    }, {
-        S5P_TV_STD_NTSC_443,
-        V4L2_STD_NTSC_443,
-    }, {
-        S5P_TV_STD_480P_60_16_9,
-        V4L2_STD_480P_60_16_9,
-    }, {
-        S5P_TV_STD_480P_60_4_3,
-        V4L2_STD_480P_60_4_3,
-    }, {
-        S5P_TV_STD_576P_50_16_9,
-        V4L2_STD_576P_50_16_9,
-    }, {
-        S5P_TV_STD_576P_50_4_3,
-        V4L2_STD_576P_50_4_3,
-    }, {
-        S5P_TV_STD_720P_60,
-        V4L2_STD_720P_60,
-    }, {
-        S5P_TV_STD_720P_50,
-        V4L2_STD_720P_50,
-    },
+    { S5P_TV_STD_NTSC_M,        V4L2_STD_NTSC_M,         720, 480, 60, false },
+    { S5P_TV_STD_PAL_BDGHI,     V4L2_STD_PAL_BDGHI,      720, 576, 50, false },
+    { S5P_TV_STD_PAL_M,         V4L2_STD_PAL_M,          720, 480, 60, false },
+    { S5P_TV_STD_PAL_N,         V4L2_STD_PAL_N,          720, 576, 50, false },
+    { S5P_TV_STD_PAL_Nc,        V4L2_STD_PAL_Nc,         720, 576, 50, false },
+    { S5P_TV_STD_PAL_60,        V4L2_STD_PAL_60,         720, 480, 60, false },
+    { S5P_TV_STD_NTSC_443,      V4L2_STD_NTSC_443,       720, 480, 60, false },
+    { S5P_TV_STD_480P_60_16_9,  V4L2_STD_480P_60_16_9,   720, 480, 60, true  },
+    { S5P_TV_STD_480P_60_4_3,   V4L2_STD_480P_60_4_3,    720, 480, 60, false },
+    { S5P_TV_STD_576P_50_16_9,  V4L2_STD_576P_50_16_9,   720, 576, 50, true  },
+    { S5P_TV_STD_576P_50_4_3,   V4L2_STD_576P_50_4_3,    720, 576, 50, false },
+    { S5P_TV_STD_720P_60,       V4L2_STD_720P_60,       1280, 720, 60, true  },
+    { S5P_TV_STD_720P_50,       V4L2_STD_720P_50,       1280, 720, 50, true  },
 };
 
+#define NUM_TV_STANDARDS \
+    (int)(sizeof(s5p_tv_standards) / sizeof(s5p_tv_standards[0]))
+
+static int64_t systemTimeNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
 static inline int calcFrameSize(int format, int width, int height)
 {
     int size = 0;
@@ -272,6 +266,7 @@ static int tv20_v4l2_s_fmt(int fp, int width, int height,
     struct v4l2_pix_format_s5p_tvout pixfmt;
     int ret;
 
+    memset(&v4l2_fmt, 0, sizeof(v4l2_fmt));
     v4l2_fmt.type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
 #if 0
     ret = ioctl(fp, VIDIOC_G_FMT, &v4l2_fmt);
@@ -296,8 +291,8 @@ static int tv20_v4l2_s_fmt(int fp, int width, int height,
     memcpy(v4l2_fmt.fmt.raw_data, &pixfmt,
            sizeof(struct v4l2_pix_format_s5p_tvout));
 
-    /* Set up for capture */
-    ret = ioctl(fp, VIDIOC_S_FMT, &v4l2_fmt);
+    /* the node is opened fresh for every connection, nothing to cache */
+    ret = sec_v4l2_s_fmt(fp, NULL, &v4l2_fmt);
     if (ret < 0) {
         ALOGE("ERR(%s):VIDIOC_S_FMT failed\n", __func__);
         return -1;
@@ -307,10 +302,9 @@ static int tv20_v4l2_s_fmt(int fp, int width, int height,
 
 static int tv20_v4l2_streamon(int fp)
 {
-    enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
     int ret;
     
-    ret = ioctl(fp, VIDIOC_STREAMON, &type);
+    ret = sec_v4l2_streamon(fp, V4L2_BUF_TYPE_VIDEO_OUTPUT);
     if (ret < 0) {
         ALOGE("ERR(%s):VIDIOC_STREAMON failed\n", __func__);
         return ret;
@@ -321,11 +315,10 @@ static int tv20_v4l2_streamon(int fp)
 
 static int tv20_v4l2_streamoff(int fp)
 {
-    enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
     int ret;
     
     ALOGV("%s :", __func__);
-    ret = ioctl(fp, VIDIOC_STREAMOFF, &type);
+    ret = sec_v4l2_streamoff(fp, V4L2_BUF_TYPE_VIDEO_OUTPUT);
     if (ret < 0) {
         ALOGE("ERR(%s):VIDIOC_STREAMOFF failed\n", __func__);
         return ret;
@@ -411,11 +404,14 @@ static int tv20_v4l2_stop_overlay(int fp)
     return ret;
 }
 
-static int tv20_v4l2_s_baseaddr(int fp, void *base_addr)
+static int tv20_v4l2_s_baseaddr(int fp, unsigned int yAddr, unsigned int cAddr)
 {
     int ret;
+    struct s5p_tv_buf_src base;
 
-    ret = ioctl(fp, S5PTVFB_WIN_SET_ADDR, base_addr);
+    base.base_y = (void *)yAddr;
+    base.base_c = (void *)cAddr;
+    ret = ioctl(fp, VIDIOC_S_BASEADDR, &base);
     if (ret < 0) {
         ALOGE("ERR(%s): VIDIOC_S_BASEADDR failed %d", __func__, ret);
         return ret;
@@ -478,12 +474,36 @@ SecHDMI::SecHDMI()
       mTvOutVFd(-1),
       mLcdFd(-1),
       mHdcpEnabled(0),
-      mFlagConnected(false)
+      mFlagConnected(false),
+      mGeometryValid(false),
+      mSrcW(0),
+      mSrcH(0),
+      mSrcFormat(0),
+      mOutCOffset(0),
+      mOutFront(0),
+      mFlipTime(0),
+      mFramePeriodNs(0),
+      mMirrorValid(false),
+      mMirrorAddr(0),
+      mMirrorYOffset(0),
+      mMirrorTime(0),
+      mMirrorPollTime(0),
+      mMirrorPeriodNs(0),
+      mWidth(0),
+      mHeight(0),
+      mStandard(S5P_TV_STD_PAL_BDGHI),
+      mOutput(S5P_TV_OUTPUT_TYPE_COMPOSITE),
+      mHotplugRunning(false),
+      mHotplugFd(-1)
 {
     ALOGV("%s", __func__);
 
     memset(&mParams, 0, sizeof(struct v4l2_streamparm));
     memset(&mFlagLayerEnable, 0, sizeof(bool) * S5P_TV_LAYER_MAX);
+    memset(&mOutAddr, 0, sizeof(mOutAddr));
+    memset(&mOutMem, 0, sizeof(mOutMem));
+    mOutMem.fd = -1;
+    mHotplugPipe[0] = mHotplugPipe[1] = -1;
 
     int ret = ioctl(mTvOutFd, VIDIOC_HDCP_ENABLE, &mHdcpEnabled);
     ALOG_IF(ret);
@@ -497,23 +517,17 @@ SecHDMI::~SecHDMI()
 /* static */
 int SecHDMI::getCableStatus()
 {
-    int  fd = 0;
-    char value[8] = {0};
+    int fd;
+    int cable;
 
     ALOGV("%s", __func__);
 
-    fd = open("/sys/class/switch/h2w/state", O_RDWR);
-    if(fd < 0) {
-        goto close;
-    }
-
-    if(read(fd, &value, 8) <= 0) {
-        goto close;
-    }
-
-close:
-    close(fd);
-    return strtol(value, NULL, 10);
+    /* the switch is the headset jack's, only the tv out bit counts */
+    fd = open(SEC_TVOUT_SWITCH_STATE, O_RDONLY);
+    cable = sec_tvout_read_cable(fd);
+    if (fd >= 0)
+        close(fd);
+    return cable < 0 ? 0 : cable;
 }
 
 const __u8* SecHDMI::getName(int index)
@@ -526,6 +540,7 @@ int SecHDMI::destroy()
 {
     ALOGV("%s", __func__);
 
+    stopHotplug();
     if(mFlagConnected) {
         disconnect();
     }
@@ -537,6 +552,8 @@ int SecHDMI::destroy()
         fimc_close(&mFimc);
         mFimc.dev_fd = -1;
     }
+    sec_mem_free(&mOutMem);
+    mGeometryValid = false;
     if (mLcdFd > 0) {
         fb_close(mLcdFd);
         mLcdFd = -1;
@@ -613,7 +630,7 @@ int SecHDMI::stopLayer(s5p_tv_layer layer)
 
 int SecHDMI::create(int width, int height)
 {
-    int ret, y_size;
+    int ret, y_size, c_size;
     unsigned int addr;
 
     ALOGV("%s", __func__);
@@ -623,6 +640,7 @@ int SecHDMI::create(int width, int height)
 
     memset(&mFimc, 0, sizeof(s5p_fimc_t));
     mFimc.dev_fd = -1;
+    mGeometryValid = false;
     ret = fimc_open(&mFimc, "/dev/video2");
     RETURN_IF(ret);
 
@@ -630,22 +648,10 @@ int SecHDMI::create(int width, int height)
     ret = tv20_v4l2_querycap(mTvOutFd);
     RETURN_IF(ret);
 
-    struct s5p_tv_standart_internal std =
-            s5p_tv_standards[(int) S5P_TV_STD_PAL_BDGHI];
-
-    ALOGV("searching for standart: %i", std.index);
-    if(!tv20_v4l2_enum_standarts(mTvOutFd, std.index))
-        return -1;
-
-    ret = tv20_v4l2_s_std(mTvOutFd, std.value);
-    RETURN_IF(ret);
-
-    ALOGV("searching for output: %i", S5P_TV_OUTPUT_TYPE_COMPOSITE);
-    if (!tv20_v4l2_enum_output(mTvOutFd, S5P_TV_OUTPUT_TYPE_COMPOSITE))
-        return -1;
-
-    ret = tv20_v4l2_s_output(mTvOutFd, S5P_TV_OUTPUT_TYPE_COMPOSITE);
-    RETURN_IF(ret);
+    mWidth = width;
+    mHeight = height;
+    /* the tv out of this board is the composite signal on the headset jack */
+    mOutput = S5P_TV_OUTPUT_TYPE_COMPOSITE;
 
     struct v4l2_window_s5p_tvout* p =
             (struct v4l2_window_s5p_tvout*)&mParams.parm.raw_data;
@@ -658,17 +664,104 @@ int SecHDMI::create(int width, int height)
     ret = tv20_v4l2_enum_fmt(mTvOutFd, V4L2_PIX_FMT_NV12);
     RETURN_IF(ret);
 
+    /* the output buffers follow each other in the fimc reserved memory,
+     * or in one s3c-mem allocation while the tv is on if it has none */
     addr = (unsigned int) mFimc.out_buf.phys_addr;
     y_size = ALIGN_TO_8KB(ALIGN_TO_128B(width) * ALIGN_TO_32B(height));
-    ret = tv20_v4l2_s_fmt(mTvOutFd, width, height, V4L2_PIX_FMT_NV12, 
-                          (unsigned int) addr,
-                          (unsigned int) addr + y_size);
+    c_size = ALIGN_TO_8KB(ALIGN_TO_128B(width) * ALIGN_TO_32B(height / 2));
+    if (!addr) {
+        sec_mem_free(&mOutMem);
+        ret = sec_mem_alloc(HDMI_OUT_BUFS * (y_size + c_size), 0, &mOutMem);
+        RETURN_IF(ret);
+        addr = mOutMem.phys;
+    }
+    for (int i = 0; i < HDMI_OUT_BUFS; i++) {
+        mOutAddr[i] = addr + i * (y_size + c_size);
+    }
+    mOutCOffset = y_size;
+
+    char value[PROPERTY_VALUE_MAX];
+    property_get("persist.hdmi.mirror_fps", value, "");
+    int fps = atoi(value);
+    mMirrorPeriodNs = 1000000000LL / (fps > 0 ? fps : HDMI_MIRROR_FPS);
+
+    return setStandard();
+}
+
+/*
+ * picks the cheapest standard of the output the driver offers, preferring
+ * one with the aspect of the source, and programs it with the front
+ * buffer. the search starts at PAL so that it wins between equals, it
+ * was the fixed standard before.
+ */
+int SecHDMI::setStandard()
+{
+    bool analog = mOutput <= S5P_TV_OUTPUT_TYPE_SVIDEO;
+    /* wider than halfway between 4:3 and 16:9 */
+    bool wide = mWidth * 9 > mHeight * 14;
+    bool bestMatch = false;
+    int64_t bestCost = 0;
+    int best = -1;
+    int ret;
+
+    for (int n = 0; n < NUM_TV_STANDARDS; n++) {
+        int i = (S5P_TV_STD_PAL_BDGHI + n) % NUM_TV_STANDARDS;
+        struct s5p_tv_standart_internal *std = &s5p_tv_standards[i];
+
+        if (analog != (std->index <= S5P_TV_STD_NTSC_443))
+            continue;
+        if (!tv20_v4l2_enum_standarts(mTvOutFd, std->index))
+            continue;
+
+        bool match = std->wide == wide;
+        int64_t cost = (int64_t)std->width * std->height * std->hz;
+        if (best < 0 || (match && !bestMatch) ||
+                (match == bestMatch && cost < bestCost)) {
+            best = i;
+            bestMatch = match;
+            bestCost = cost;
+        }
+    }
+
+    if (best < 0) {
+        ALOGE("%s::no standard for output %d", __func__, mOutput);
+        return -1;
+    }
+
+    struct s5p_tv_standart_internal *std = &s5p_tv_standards[best];
+    ALOGV("%s::standard %d, %dx%d@%d", __func__, std->index,
+          std->width, std->height, std->hz);
+
+    ret = tv20_v4l2_s_std(mTvOutFd, std->value);
+    RETURN_IF(ret);
+    mStandard = std->index;
+    mFramePeriodNs = 1000000000LL / std->hz;
+
+    ALOGV("searching for output: %i", mOutput);
+    if (!tv20_v4l2_enum_output(mTvOutFd, mOutput))
+        return -1;
+
+    ret = tv20_v4l2_s_output(mTvOutFd, mOutput);
+    RETURN_IF(ret);
+
+    mOutFront = 0;
+    mFlipTime = 0;
+    mMirrorValid = false;
+    ret = tv20_v4l2_s_fmt(mTvOutFd, mWidth, mHeight, V4L2_PIX_FMT_NV12,
+                          mOutAddr[mOutFront],
+                          mOutAddr[mOutFront] + mOutCOffset);
     RETURN_IF(ret);
 
     return 0;
 }
 
 int SecHDMI::connect()
+{
+    Mutex::Autolock lock(mLock);
+    return connectLocked();
+}
+
+int SecHDMI::connectLocked()
 {
     int ret;
 
@@ -691,6 +784,13 @@ int SecHDMI::connect()
     ret = tv20_v4l2_streamon(mTvOutFd);
     RETURN_IF(ret);
 
+    // the link takes its audio off the I2S, what the audio HAL's HDMI output
+    // plays. A sink without audio still gets the picture
+    if (tv20_v4l2_audio_enable(mTvOutFd) < 0 ||
+        tv20_v4l2_audio_unmute(mTvOutFd) < 0) {
+        ALOGW("%s::no HDMI audio: %s", __func__, strerror(errno));
+    }
+
 #if 0
     ret = startLayer(S5P_TV_LAYER_VIDEO);
     RETURN_IF(ret);
@@ -702,6 +802,12 @@ int SecHDMI::connect()
 }
 
 int SecHDMI::disconnect()
+{
+    Mutex::Autolock lock(mLock);
+    return disconnectLocked();
+}
+
+int SecHDMI::disconnectLocked()
 {
     int ret;
 
@@ -713,6 +819,10 @@ int SecHDMI::disconnect()
         return 0;
     }
 
+    // muted first so the sink doesn't pop when the stream stops
+    tv20_v4l2_audio_mute(mTvOutFd);
+    tv20_v4l2_audio_disable(mTvOutFd);
+
     ret = tv20_v4l2_streamoff(mTvOutFd);
     RETURN_IF(ret);
 
@@ -726,21 +836,81 @@ int SecHDMI::disconnect()
     return 0;
 }
 
+void SecHDMI::setGeometry(int srcW, int srcH, int srcColorFormat)
+{
+    memset(&mSrcImg, 0, sizeof(mSrcImg));
+    memset(&mDstImg, 0, sizeof(mDstImg));
+    memset(&mSrcRect, 0, sizeof(mSrcRect));
+    memset(&mDstRect, 0, sizeof(mDstRect));
+
+    mSrcImg.w       = srcW;
+    mSrcImg.h       = srcH;
+    /* only planar YUV420 has its own path, everything else comes as SP */
+    if (srcColorFormat == HAL_PIXEL_FORMAT_YCbCr_420_P)
+        mSrcImg.format = HAL_PIXEL_FORMAT_YCbCr_420_P;
+    else
+        mSrcImg.format = HAL_PIXEL_FORMAT_YCbCr_420_SP/*srcColorFormat*/;
+    mSrcImg.mem_type = FIMC_MEM_TYPE_PHYS;
+    mSrcImg.w       = (mSrcImg.w + 15) & (~15);
+    mSrcImg.h       = (mSrcImg.h + 1)  & (~1) ;
+
+    mSrcRect.w = mSrcImg.w;
+    mSrcRect.h = mSrcImg.h;
+
+    struct v4l2_window_s5p_tvout* p =
+        (struct v4l2_window_s5p_tvout*)&mParams.parm.raw_data;
+
+    mDstImg.w       = p->win.w.width;
+    mDstImg.h       = p->win.w.height;
+    mDstImg.format  = HAL_PIXEL_FORMAT_YCbCr_420_SP;
+    mDstImg.mem_type = FIMC_MEM_TYPE_PHYS;
+
+    mDstRect.x = p->win.w.left;
+    mDstRect.y = p->win.w.top;
+    mDstRect.w = mDstImg.w;
+    mDstRect.h = mDstImg.h;
+
+    mSrcW = srcW;
+    mSrcH = srcH;
+    mSrcFormat = srcColorFormat;
+    mGeometryValid = true;
+
+    ALOGV("%s::sr_x %d sr_y %d sr_w %d sr_h %d dr_x %d dr_y %d dr_w %d dr_h %d ",
+          __func__, mSrcRect.x, mSrcRect.y, mSrcRect.w, mSrcRect.h,
+          mDstRect.x, mDstRect.y, mDstRect.w, mDstRect.h);
+}
+
+/*
+ * the video layer latches a new base address at the tv vsync, so the
+ * buffer shown before the last flip is free once a scanout period went by
+ */
+void SecHDMI::waitFlipDone()
+{
+    int64_t wait = mFlipTime + mFramePeriodNs - systemTimeNs();
+
+    if (wait > 0) {
+        SEC_TRACE_SCOPE("hdmi:wait_flip");
+        usleep(wait / 1000);
+    }
+}
+
 int SecHDMI::flush(int srcW, int srcH, int srcColorFormat,
                    unsigned int srcYAddr, unsigned int srcCbAddr, unsigned int srcCrAddr,
                    int dstX, int dstY,
                    int layer,
                    int num_of_hwc_layer)
 {
+    SEC_TRACE_SCOPE("hdmi:flush");
+    Mutex::Autolock lock(mLock);
     int ret;
 
+    /* nothing to scale for while the cable is out */
+    if (!mFlagConnected)
+        return 0;
+
 #if 0
     usleep(1000 * 10);
 #else
-    sec_img         src_img;
-    sec_img         dst_img;
-    sec_rect        src_rect;
-    sec_rect        dst_rect;
     unsigned int    phyAddr[3/*MAX_NUM_PLANES*/];
 
     if(!srcYAddr) {
@@ -752,64 +922,74 @@ int SecHDMI::flush(int srcW, int srcH, int srcColorFormat,
 
         RETURN_IF(mLcdFd);
 
+        /* callers post every frame, the tv only takes the mirror rate.
+         * a frame early on the last one is dropped, not waited for */
+        int64_t now = systemTimeNs();
+        if (mMirrorPollTime && now - mMirrorPollTime < mMirrorPeriodNs) {
+            return 0;
+        }
+        mMirrorPollTime = now;
+
+        /* the lcd pans between its buffers, the address has to be asked for */
         ret = ioctl(mLcdFd, S3CFB_GET_CURR_FB_INFO, &fb_info);
         RETURN_IF(ret);
 
+        /* nothing was posted since the last mirror, the tv has it already */
+        if (mMirrorValid && mGeometryValid &&
+                srcW == mSrcW && srcH == mSrcH && srcColorFormat == mSrcFormat &&
+                fb_info.phy_start_addr == mMirrorAddr &&
+                fb_info.yoffset == mMirrorYOffset &&
+                mMirrorPollTime - mMirrorTime < HDMI_MIRROR_REFRESH_NS) {
+            return 0;
+        }
+
         srcYAddr = fb_info.phy_start_addr;
         srcCbAddr = srcYAddr;
+        mMirrorAddr = fb_info.phy_start_addr;
+        mMirrorYOffset = fb_info.yoffset;
+        mMirrorTime = mMirrorPollTime;
+        mMirrorValid = true;
+    } else {
+        mMirrorValid = false;
     }
 
-    memset(&src_img, 0, sizeof(src_img));
-    memset(&dst_img, 0, sizeof(src_img));
-    memset(&src_rect, 0, sizeof(src_rect));
-    memset(&dst_rect, 0, sizeof(src_rect));
-    memset(&phyAddr, 0, sizeof(int) * sizeof(phyAddr));
+    if (!mGeometryValid || srcW != mSrcW || srcH != mSrcH ||
+            srcColorFormat != mSrcFormat) {
+        setGeometry(srcW, srcH, srcColorFormat);
+    }
 
     phyAddr[0] = srcYAddr;
     phyAddr[1] = srcCbAddr;
     phyAddr[2] = srcCrAddr;
 
-    src_img.w       = srcW;
-    src_img.h       = srcH;
-    src_img.format  = HAL_PIXEL_FORMAT_YCbCr_420_SP/*srcColorFormat*/;
-    src_img.base    = 0;
-    src_img.offset  = 0;
-    src_img.mem_id  = 0;
-    src_img.mem_type = FIMC_MEM_TYPE_PHYS;
-    src_img.w       = (src_img.w + 15) & (~15);
-    src_img.h       = (src_img.h + 1)  & (~1) ;
-
-    src_rect.x = 0;
-    src_rect.y = 0;
-    src_rect.w = src_img.w;
-    src_rect.h = src_img.h;
-
-    struct v4l2_window_s5p_tvout* p =
-        (struct v4l2_window_s5p_tvout*)&mParams.parm.raw_data;
-    if (!p) {
-        return -1;
+    int back = (mOutFront + 1) % HDMI_OUT_BUFS;
+
+    waitFlipDone();
+
+    mDstImg.base = mOutAddr[back];
+
+    /* the node is shared with the video decoder's color conversion */
+    struct fimc_job job;
+    memset(&job, 0, sizeof(job));
+    job.fimc     = &mFimc;
+    job.src_img  = mSrcImg;
+    job.src_rect = mSrcRect;
+    job.dst_img  = mDstImg;
+    job.dst_rect = mDstRect;
+    memcpy(job.phyAddr, phyAddr, sizeof(job.phyAddr));
+    job.priority = FIMC_JOB_DISPLAY;
+    ret = fimc_broker_run(&job);
+    if (ret >= 0) {
+        ret = tv20_v4l2_s_baseaddr(mTvOutFd, mOutAddr[back],
+                                   mOutAddr[back] + mOutCOffset);
+    }
+    if (ret < 0) {
+        mMirrorValid = false;
     }
-
-    dst_img.w       = p->win.w.width;
-    dst_img.h       = p->win.w.height;
-    dst_img.format  = HAL_PIXEL_FORMAT_YCbCr_420_SP;
-    dst_img.base    = (unsigned int) mFimc.out_buf.phys_addr;
-    dst_img.offset  = 0;
-    dst_img.mem_id  = 0;
-    dst_img.mem_type = FIMC_MEM_TYPE_PHYS;
-
-    dst_rect.x = p->win.w.top;
-    dst_rect.y = p->win.w.left;
-    dst_rect.w = dst_img.w;
-    dst_rect.h = dst_img.h;
-
-    ALOGV("%s::sr_x %d sr_y %d sr_w %d sr_h %d dr_x %d dr_y %d dr_w %d dr_h %d ",
-          __func__, src_rect.x, src_rect.y, src_rect.w, src_rect.h,
-          dst_rect.x, dst_rect.y, dst_rect.w, dst_rect.h);
-
-    ret = fimc_flush(&mFimc, &src_img, &src_rect, &dst_img, &dst_rect,
-                     phyAddr, 0);
     RETURN_IF(ret);
+    mOutFront = back;
+    mFlipTime = systemTimeNs();
+    SEC_TRACE_INT("hdmi:out_front", mOutFront);
 
 /*
     struct fb_var_screeninfo var;
@@ -831,7 +1011,7 @@ int SecHDMI::flush(int srcW, int srcH, int srcColorFormat,
         var.transp.length = 8;
     }
 
-    ret = tv20_v4l2_s_baseaddr(mTvOutFd, (void *)srcYAddr);
+    ret = tv20_v4l2_s_baseaddr(mTvOutFd, srcYAddr, srcCbAddr);
     RETURN_IF(ret);
 
     ret = fb_put_vscreeninfo(mLcdFd, &var);
@@ -844,3 +1024,128 @@ int SecHDMI::flush(int srcW, int srcH, int srcColorFormat,
 
     return 0;
 }
+
+// ======================================================================
+// Cable hotplug
+
+/*
+ * the switch uevent of the headset jack, 1 if SWITCH_STATE has the tv
+ * out cable in, as getCableStatus() reads it. -1 for any other uevent.
+ */
+static int parseCableUevent(const char *buf, int len)
+{
+    bool cable = false;
+    int state = -1;
+
+    for (const char *s = buf; s < buf + len; s += strlen(s) + 1) {
+        if (s == buf) {
+            cable = strstr(s, SEC_TVOUT_SWITCH_UEVENT) != NULL;
+        } else if (!strncmp(s, "SWITCH_STATE=", 13)) {
+            state = strtol(s + 13, NULL, 10);
+        }
+    }
+
+    return (cable && state >= 0) ? sec_tvout_cable(state) : -1;
+}
+
+void SecHDMI::hotplugLoop()
+{
+    char buf[1024];
+    struct pollfd fds[2];
+    int cable = getCableStatus();
+
+    do {
+        /* a plugged cable waits for the TV Out setting, which has no uevent */
+        if (cable && sec_tvout_enabled()) {
+            Mutex::Autolock lock(mLock);
+            if (!mFlagConnected && setStandard() == 0)
+                connectLocked();
+        } else {
+            disconnect();
+        }
+
+        fds[0].fd = mHotplugFd;
+        fds[0].events = POLLIN;
+        fds[1].fd = mHotplugPipe[0];
+        fds[1].events = POLLIN;
+        if (poll(fds, 2, cable ? HDMI_TVOUT_POLL_MS : -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            ALOGE("%s::poll failed: %s", __func__, strerror(errno));
+            break;
+        }
+        if (fds[1].revents)
+            break;
+
+        if (fds[0].revents & POLLIN) {
+            int len = recv(mHotplugFd, buf, sizeof(buf) - 1, 0);
+            if (len > 0) {
+                buf[len] = '\0';
+                int state = parseCableUevent(buf, len);
+                if (state >= 0)
+                    cable = state;
+            }
+        }
+    } while (true);
+}
+
+void* SecHDMI::hotplugThread(void *data)
+{
+    ((SecHDMI *)data)->hotplugLoop();
+    return NULL;
+}
+
+int SecHDMI::startHotplug()
+{
+    struct sockaddr_nl addr;
+
+    if (mHotplugRunning)
+        return 0;
+
+    /*
+     * a socket of our own, the hardware_legacy uevent one is per process
+     * and the hwcomposer reads it. bound to an explicit port for the same
+     * reason, autobind would take the process id uevent_init() wants.
+     */
+    mHotplugFd = socket(PF_NETLINK, SOCK_DGRAM, NETLINK_KOBJECT_UEVENT);
+    RETURN_IF(mHotplugFd);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+    addr.nl_pid = ((uint32_t)pthread_self() << 16) | getpid();
+    addr.nl_groups = 0xffffffff;
+    if (bind(mHotplugFd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+            pipe(mHotplugPipe) < 0) {
+        ALOGE("%s::can't listen to uevents: %s", __func__, strerror(errno));
+        stopHotplug();
+        return -1;
+    }
+
+    if (pthread_create(&mHotplugThread, NULL, hotplugThread, this)) {
+        ALOGE("%s::can't start hotplug thread", __func__);
+        stopHotplug();
+        return -1;
+    }
+    mHotplugRunning = true;
+
+    return 0;
+}
+
+void SecHDMI::stopHotplug()
+{
+    if (mHotplugRunning) {
+        write(mHotplugPipe[1], "x", 1);
+        pthread_join(mHotplugThread, NULL);
+        mHotplugRunning = false;
+    }
+    if (mHotplugFd >= 0) {
+        close(mHotplugFd);
+        mHotplugFd = -1;
+    }
+    for (int i = 0; i < 2; i++) {
+        if (mHotplugPipe[i] >= 0) {
+            close(mHotplugPipe[i]);
+            mHotplugPipe[i] = -1;
+        }
+    }
+}
@@ -30,14 +30,29 @@
 #include <sys/ioctl.h>
 #include <sys/poll.h>
 #include <sys/stat.h>
+#include <pthread.h>
+
+#include <utils/threads.h>
 
 #include <linux/videodev2.h>
 #include <s5p_tvout.h>
+#include <sec_v4l2.h>
 
-#include "fimc.h"
+#include "fimc_broker.h"
+#include "sec_mem.h"
 
 namespace android {
 
+// tvout output buffers the FIMC scales into, one scanned out at a time
+#define HDMI_OUT_BUFS   2
+// framebuffer mirror rate unless persist.hdmi.mirror_fps says otherwise
+#define HDMI_MIRROR_FPS 30
+// an unchanged framebuffer is still mirrored this often, two posts
+// between checks bring the pan back where it was
+#define HDMI_MIRROR_REFRESH_NS  1000000000LL
+// how often a plugged cable looks at the TV Out setting
+#define HDMI_TVOUT_POLL_MS      1000
+
 enum s5p_tv_standart {
     S5P_TV_STD_NTSC_M = 0,
     S5P_TV_STD_PAL_BDGHI,
@@ -84,6 +99,10 @@ public:
                           int num_of_hwc_layer);
 
     const __u8*     getName(int index);
+
+    // connects and disconnects on the cable uevents from now on
+    int             startHotplug();
+    void            stopHotplug();
         
 private:
     enum s5p_tv_layer {
@@ -94,6 +113,8 @@ private:
         S5P_TV_LAYER_MAX,
     };
 
+    Mutex           mLock;
+
     int             mTvOutFd;
     int             mTvOutVFd;
     int             mLcdFd;
@@ -104,8 +125,53 @@ private:
     s5p_fimc_t      mFimc;
     v4l2_streamparm mParams;
 
+    // fimc setup of the last flush, rebuilt only when the source or
+    // the tv window changes
+    bool            mGeometryValid;
+    int             mSrcW;
+    int             mSrcH;
+    int             mSrcFormat;
+    sec_img         mSrcImg;
+    sec_img         mDstImg;
+    sec_rect        mSrcRect;
+    sec_rect        mDstRect;
+
+    // the tv shows mOutAddr[mOutFront], the FIMC writes the other one
+    unsigned int    mOutAddr[HDMI_OUT_BUFS];
+    unsigned int    mOutCOffset;
+    // where they come from on a kernel without fimc reserved memory
+    sec_mem_buf     mOutMem;
+    int             mOutFront;
+    int64_t         mFlipTime;
+    int64_t         mFramePeriodNs;
+
+    // the framebuffer pan of the last mirrored frame
+    bool            mMirrorValid;
+    unsigned int    mMirrorAddr;
+    unsigned int    mMirrorYOffset;
+    int64_t         mMirrorTime;
+    int64_t         mMirrorPollTime;
+    int64_t         mMirrorPeriodNs;
+
+    int             mWidth;
+    int             mHeight;
+    int             mStandard;
+    int             mOutput;
+
+    pthread_t       mHotplugThread;
+    bool            mHotplugRunning;
+    int             mHotplugFd;
+    int             mHotplugPipe[2];
+
     int             startLayer(s5p_tv_layer layer);
     int             stopLayer(s5p_tv_layer layer);
+    void            setGeometry(int srcW, int srcH, int srcColorFormat);
+    void            waitFlipDone();
+    int             setStandard();
+    int             connectLocked();
+    int             disconnectLocked();
+    void            hotplugLoop();
+    static void*    hotplugThread(void *data);
 };
     
 }; // namespace android
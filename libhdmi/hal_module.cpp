@@ -200,6 +200,11 @@ static int hdmi_open(const struct hw_module_t *module, char const *name,
         return -EINVAL;
     }
 
+    /* the hwcomposer owns the tv, the others drive connect themselves */
+    if (!strcmp("hdmi-composer", name) && hdmi_dev->hw->startHotplug() < 0) {
+        ALOGE("open: no hotplug, waiting for connect calls");
+    }
+
     ALOGI("initzialized for lcd size: %dx%d", lcdWidth, lcdHeight);
 
     return 0;
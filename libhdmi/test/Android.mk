@@ -46,16 +46,38 @@ LOCAL_CFLAGS := -fno-short-enums
 LOCAL_CFLAGS += -DLOG_TAG=\"test2-hdmi\" -DLOG_TYPE=1
 
 LOCAL_C_INCLUDES := \
-    $(LOCAL_PATH)/../ \
+    $(LOCAL_PATH)/../../libfimc \
     $(LOCAL_PATH)/../../include
 
 LOCAL_SRC_FILES := \
-    ../fimc.c \
     test2.cpp
 
 LOCAL_MODULE := test2-hdmi
 LOCAL_MODULE_TAGS := optional
 
-LOCAL_SHARED_LIBRARIES := liblog libutils
+LOCAL_SHARED_LIBRARIES := liblog libutils libfimc
+
+include $(BUILD_EXECUTABLE)
+
+# --------------------------------------------- #
+#              hdmi-bench binary
+# --------------------------------------------- #
+
+include $(CLEAR_VARS)
+
+LOCAL_CFLAGS := -fno-short-enums
+LOCAL_CFLAGS += -DLOG_TAG=\"hdmi-bench\"
+
+LOCAL_C_INCLUDES := \
+    $(LOCAL_PATH)/../../libsecmem \
+    $(LOCAL_PATH)/../../include
+
+LOCAL_SRC_FILES := \
+    hdmi_bench.cpp
+
+LOCAL_MODULE := hdmi-bench
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_SHARED_LIBRARIES := liblog libutils libhardware libsecmem
 
 include $(BUILD_EXECUTABLE)
@@ -0,0 +1,423 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Drives hdmi->blit the way the hwcomposer and the camera do and measures
+ * it: per blit latency, sustained fps, how much of a blit is cpu (setup
+ * and ioctls) and how much is waiting (fimc, flip), and the cpu load of
+ * the run. Video mode blits synthetic frames from physically contiguous
+ * s3c-mem buffers at several sizes, ui mode mirrors the framebuffer, once
+ * with the screen static and once with the pan moving.
+ *
+ * usage: hdmi-bench [-n blits per run] [-m video|ui]
+ *
+ * the config of a result is the mode, with the format and size of video runs.
+ */
+
+#include <hardware/hdmi.h>
+#include <utils/Timers.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/types.h>
+#include <linux/fb.h>
+
+#include "sec_format.h"
+#include "sec_mem.h"
+
+#include <sec_bench.h>
+
+using namespace android;
+
+#define LCD_DEV         "/dev/graphics/fb0"
+
+// frames of each source, the content moves so no two blits are alike
+#define BENCH_FRAMES    2
+
+struct BenchSize {
+    int width;
+    int height;
+};
+
+static const BenchSize kSizes[] = {
+    { 320, 240 },
+    { 640, 480 },
+    { 800, 480 },
+    { 1280, 720 },
+};
+
+// the source formats SecHDMI converts, anything else goes in as NV12
+struct BenchFormat {
+    int         format;
+    const char* name;
+};
+
+static const BenchFormat kFormats[] = {
+    { HAL_PIXEL_FORMAT_YCbCr_420_SP, "nv12" },
+    { HAL_PIXEL_FORMAT_YCbCr_420_P,  "yuv420p" },
+};
+
+// ---------------------------------------------------------------------------
+// physically contiguous frames
+
+struct BenchFrame {
+    struct sec_mem_buf   mem;
+    unsigned int         y;
+    unsigned int         cb;
+    unsigned int         cr;
+};
+
+static int allocFrame(BenchFrame *frame, int size)
+{
+    memset(frame, 0, sizeof(*frame));
+    int ret = sec_mem_alloc(size, 0, &frame->mem);
+    if (ret < 0) {
+        LOGE("%s:: sec_mem_alloc of %d bytes failed: %s", __func__, size,
+             strerror(-ret));
+        return -1;
+    }
+    return 0;
+}
+
+static void freeFrame(BenchFrame *frame)
+{
+    sec_mem_free(&frame->mem);
+}
+
+// ramp in y, flat chroma, shifted by index
+static void fillFrame(BenchFrame *frame, int format, int w, int h, int index)
+{
+    uint8_t *y = (uint8_t *)frame->mem.virt;
+    int ySize = w * h;
+
+    for (int row = 0; row < h; row++) {
+        for (int col = 0; col < w; col++)
+            y[row * w + col] = (uint8_t)(col + row + index * 64);
+    }
+    memset(y + ySize, 128 + index * 16, ySize / 2);
+
+    frame->y = frame->mem.phys;
+    frame->cb = frame->y + ySize;
+    frame->cr = format == HAL_PIXEL_FORMAT_YCbCr_420_P ?
+            frame->cb + ySize / 4 : 0;
+}
+
+// ---------------------------------------------------------------------------
+// measurements
+
+static nsecs_t threadCpuTime()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (nsecs_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// busy and total jiffies of the whole system
+static void systemTicks(long long *busy, long long *total)
+{
+    long long user = 0, nice = 0, sys = 0, idle = 0, iowait = 0, irq = 0, sirq = 0;
+    FILE *f = fopen("/proc/stat", "r");
+
+    *busy = *total = 0;
+    if (!f)
+        return;
+    if (fscanf(f, "cpu %lld %lld %lld %lld %lld %lld %lld",
+               &user, &nice, &sys, &idle, &iowait, &irq, &sirq) == 7) {
+        *busy = user + nice + sys + irq + sirq;
+        *total = *busy + idle + iowait;
+    }
+    fclose(f);
+}
+
+static int compareNsecs(const void *a, const void *b)
+{
+    nsecs_t x = *(const nsecs_t *)a;
+    nsecs_t y = *(const nsecs_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+struct BenchRun {
+    nsecs_t*    latency;
+    nsecs_t*    cpu;
+    int         count;
+    int         failed;
+    nsecs_t     duration;
+    long long   busyTicks;
+    long long   totalTicks;
+};
+
+typedef int (*blit_fn)(hdmi_device_t *hdmi, void *data, int index);
+
+static int runBlits(hdmi_device_t *hdmi, blit_fn blit, void *data,
+                    int count, BenchRun *run)
+{
+    long long busy0, total0, busy1, total1;
+
+    run->latency = new nsecs_t[count];
+    run->cpu = new nsecs_t[count];
+    run->count = 0;
+    run->failed = 0;
+
+    systemTicks(&busy0, &total0);
+    nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+    for (int i = 0; i < count; i++) {
+        nsecs_t t0 = systemTime(SYSTEM_TIME_MONOTONIC);
+        nsecs_t c0 = threadCpuTime();
+        if (blit(hdmi, data, i) < 0) {
+            run->failed++;
+            continue;
+        }
+        run->cpu[run->count] = threadCpuTime() - c0;
+        run->latency[run->count] = systemTime(SYSTEM_TIME_MONOTONIC) - t0;
+        run->count++;
+    }
+    run->duration = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+    systemTicks(&busy1, &total1);
+    run->busyTicks = busy1 - busy0;
+    run->totalTicks = total1 - total0;
+
+    return run->count ? 0 : -1;
+}
+
+static void report(const char *config, BenchRun *run)
+{
+    int n = run->count;
+
+    if (run->failed)
+        RESULT(config, "failed", run->failed, "blits");
+    if (n == 0) {
+        LOGE("%s:: no blit of %s went through", __func__, config);
+        goto free;
+    }
+
+    {
+        double latency = 0, cpu = 0;
+        for (int i = 0; i < n; i++) {
+            latency += run->latency[i];
+            cpu += run->cpu[i];
+        }
+        latency /= n;
+        cpu /= n;
+        qsort(run->latency, n, sizeof(nsecs_t), compareNsecs);
+
+        RESULT(config, "fps", n * 1000.0 / toMillisecondTime(run->duration), "fps");
+        RESULT(config, "latency_mean", latency / 1000000.0, "ms");
+        RESULT(config, "latency_p90", run->latency[n * 9 / 10] / 1000000.0, "ms");
+        RESULT(config, "latency_max", run->latency[n - 1] / 1000000.0, "ms");
+        /* what the calling thread spent itself, setup and ioctls */
+        RESULT(config, "cpu_per_blit", cpu / 1000000.0, "ms");
+        /* the rest was spent waiting, on the fimc or the tv flip */
+        RESULT(config, "wait_per_blit", (latency - cpu) / 1000000.0, "ms");
+        if (run->totalTicks > 0)
+            RESULT(config, "cpu.system", 100.0 * run->busyTicks / run->totalTicks, "%");
+    }
+
+free:
+    delete [] run->latency;
+    delete [] run->cpu;
+}
+
+// ---------------------------------------------------------------------------
+// video mode
+
+struct VideoSource {
+    BenchFrame  frames[BENCH_FRAMES];
+    int         format;
+    int         width;
+    int         height;
+};
+
+static int blitVideo(hdmi_device_t *hdmi, void *data, int index)
+{
+    VideoSource *src = (VideoSource *)data;
+    BenchFrame *frame = &src->frames[index % BENCH_FRAMES];
+
+    return hdmi->blit(hdmi, src->width, src->height, src->format,
+                      frame->y, frame->cb, frame->cr,
+                      0, 0, HDMI_MODE_VIDEO, 0);
+}
+
+static int benchVideo(hdmi_device_t *hdmi, int count)
+{
+    int ret = 0;
+
+    for (size_t s = 0; s < sizeof(kSizes) / sizeof(kSizes[0]); s++) {
+        for (size_t f = 0; f < sizeof(kFormats) / sizeof(kFormats[0]); f++) {
+            VideoSource src;
+            BenchRun run;
+            char config[64];
+            int size = kSizes[s].width * kSizes[s].height * 3 / 2;
+            int i;
+
+            src.format = kFormats[f].format;
+            src.width = kSizes[s].width;
+            src.height = kSizes[s].height;
+            snprintf(config, sizeof(config), "video.%s.%dx%d",
+                     kFormats[f].name, src.width, src.height);
+
+            for (i = 0; i < BENCH_FRAMES; i++) {
+                if (allocFrame(&src.frames[i], size) < 0)
+                    break;
+                fillFrame(&src.frames[i], src.format, src.width, src.height, i);
+            }
+            if (i == BENCH_FRAMES) {
+                LOGI("%s:: %s, %d blits", __func__, config, count);
+                if (runBlits(hdmi, blitVideo, &src, count, &run) < 0)
+                    ret = -1;
+                report(config, &run);
+            } else {
+                ret = -1;
+            }
+            while (--i >= 0)
+                freeFrame(&src.frames[i]);
+        }
+    }
+
+    /* the sizes don't come back, don't keep them from the system */
+    sec_mem_trim();
+    return ret;
+}
+
+// ---------------------------------------------------------------------------
+// ui mode
+
+struct UiSource {
+    int                         fd;
+    struct fb_var_screeninfo    var;
+    bool                        pan;
+};
+
+static int blitUi(hdmi_device_t *hdmi, void *data, int index)
+{
+    UiSource *src = (UiSource *)data;
+
+    /* what a post of the other buffer looks like to the mirror */
+    if (src->pan && src->var.yres_virtual >= 2 * src->var.yres) {
+        src->var.yoffset = (index & 1) ? src->var.yres : 0;
+        if (ioctl(src->fd, FBIOPAN_DISPLAY, &src->var) < 0)
+            return -1;
+    }
+
+    return hdmi->blit(hdmi, src->var.xres, src->var.yres,
+                      HAL_PIXEL_FORMAT_BGRA_8888,
+                      0, 0, 0,                          /* the framebuffer */
+                      0, 0, HDMI_MODE_UI, 0);
+}
+
+static int benchUi(hdmi_device_t *hdmi, int count)
+{
+    UiSource src;
+    BenchRun run;
+    int ret = 0;
+
+    src.fd = open(LCD_DEV, O_RDWR);
+    if (src.fd < 0) {
+        LOGE("%s:: Can't open %s", __func__, LCD_DEV);
+        return -1;
+    }
+    if (ioctl(src.fd, FBIOGET_VSCREENINFO, &src.var) < 0) {
+        LOGE("%s:: FBIOGET_VSCREENINFO failed", __func__);
+        close(src.fd);
+        return -1;
+    }
+
+    src.pan = false;
+    LOGI("%s:: static screen, %d blits", __func__, count);
+    if (runBlits(hdmi, blitUi, &src, count, &run) < 0)
+        ret = -1;
+    report("ui.static", &run);
+
+    src.pan = true;
+    LOGI("%s:: panning screen, %d blits", __func__, count);
+    if (runBlits(hdmi, blitUi, &src, count, &run) < 0)
+        ret = -1;
+    report("ui.pan", &run);
+
+    src.var.yoffset = 0;
+    ioctl(src.fd, FBIOPAN_DISPLAY, &src.var);
+    close(src.fd);
+    return ret;
+}
+
+int main(int argc, char** argv) {
+    hw_module_t*   module;
+    hdmi_device_t* hdmi;
+    const char*    mode = NULL;
+    int            count = 300;
+    int            opt;
+    int            ret;
+
+    while ((opt = getopt(argc, argv, "n:m:")) != -1) {
+        switch (opt) {
+        case 'n':
+            count = atoi(optarg);
+            break;
+        case 'm':
+            mode = optarg;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-n blits per run] [-m video|ui]\n", argv[0]);
+            return -EINVAL;
+        }
+    }
+
+    ret = hw_get_module(HDMI_HARDWARE_MODULE_ID,
+                (const hw_module_t**)&module);
+    if(ret) {
+        LOGE("%s:: Hdmi device not presented", __func__);
+        return -ENODEV;
+    }
+
+    ret = module->methods->open(module, "hdmi-test",
+                (hw_device_t **)&hdmi);
+    if(ret < 0) {
+        LOGE("%s:: Can't open hdmi device", __func__);
+        return ret;
+    }
+
+    ret = hdmi->connect(hdmi);
+    if(ret < 0) {
+        LOGE("%s:: Can't connect hdmi device", __func__);
+        goto close;
+    }
+
+    if (!mode || !strcmp(mode, "video")) {
+        if (benchVideo(hdmi, count) < 0)
+            ret = -1;
+    }
+    if (!mode || !strcmp(mode, "ui")) {
+        if (benchUi(hdmi, count) < 0)
+            ret = -1;
+    }
+
+    if(hdmi->disconnect(hdmi) < 0) {
+        LOGE("%s:: Can't disconnect hdmi device", __func__);
+    }
+
+close:
+    if(hdmi->common.close(&hdmi->common) < 0) {
+        LOGE("%s:: Can't close hdmi device", __func__);
+    }
+
+    LOGI("Hdmi bench result: %d", ret);
+    return ret;
+}
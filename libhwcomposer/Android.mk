@@ -21,7 +21,7 @@ LOCAL_PATH:= $(call my-dir)
 include $(CLEAR_VARS)
 LOCAL_PRELINK_MODULE := false
 LOCAL_MODULE_PATH := $(TARGET_OUT_SHARED_LIBRARIES)/hw
-LOCAL_SHARED_LIBRARIES := liblog libcutils libEGL libGLESv1_CM libhardware libhardware_legacy
+LOCAL_SHARED_LIBRARIES := liblog libcutils libEGL libhardware libhardware_legacy libfimc
 
 LOCAL_CFLAGS := -DLOG_TAG=\"hwcomposer\"
 ifeq ($(BOARD_HAVE_HDMI),true)
@@ -32,9 +32,10 @@ ifeq ($(BOARD_CUSTOM_VSYNC_IOCTL),true)
 endif
 
 LOCAL_C_INCLUDES := \
-    $(LOCAL_PATH)/../include
+    $(LOCAL_PATH)/../include \
+    $(LOCAL_PATH)/../libfimc
 
-LOCAL_SRC_FILES := SecHWCUtils.cpp SecHWC.cpp fimc.c
+LOCAL_SRC_FILES := SecHWCUtils.cpp SecHWC.cpp
 
 LOCAL_MODULE := hwcomposer.$(TARGET_BOARD_PLATFORM)
 LOCAL_MODULE_TAGS := optional
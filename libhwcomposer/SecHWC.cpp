@@ -24,12 +24,23 @@
  */
 
 #include <sys/resource.h>
+#include <poll.h>
+#include <time.h>
+#include <stdarg.h>
+#include <unistd.h>
+#define ATRACE_TAG ATRACE_TAG_GRAPHICS
 #include <cutils/log.h>
 #include <cutils/atomic.h>
+#include <cutils/native_handle.h>
+#include <cutils/properties.h>
 #include <EGL/egl.h>
-#include <GLES/gl.h>
 #include <hardware_legacy/uevent.h>
 #include "SecHWCUtils.h"
+#include <sec_latency.h>
+#include <sec_startup.h>
+#include <sec_thread.h>
+#include <sec_trace.h>
+#include <sec_tvout.h>
 
 static IMG_gralloc_module_public_t *gpsGrallocModule;
 
@@ -52,6 +63,26 @@ hwc_module_t HAL_MODULE_INFO_SYM = {
     }
 };
 
+static int64_t hwc_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void add_time_stats(struct hwc_time_stats *t, int64_t ns)
+{
+    int i = 0;
+
+    while (i < HWC_TIME_HIST_CNT - 1 && ns >= (1000000LL << i))
+        i++;
+    t->hist[i]++;
+    t->count++;
+    t->total_ns += ns;
+    if (ns > t->max_ns)
+        t->max_ns = ns;
+}
+
 static void dump_layer(hwc_layer_t const* l) {
     ALOGD("\ttype=%d, flags=%08x, handle=%p, tr=%02x, blend=%04x, {%d,%d,%d,%d}, {%d,%d,%d,%d}",
             l->compositionType, l->flags, l->handle, l->transform, l->blending,
@@ -86,6 +117,11 @@ static int set_src_dst_info(hwc_layer_t *cur,
     src_img->mem_type = FIMC_MEM_TYPE_PHYS;
     src_img->w = (src_img->w + 15) & (~15);
     src_img->h = (src_img->h + 1) & (~1) ;
+    /* the MFC decodes into 128 byte wide, 32 line high rows of tiles */
+    if (src_img->format == HAL_PIXEL_FORMAT_CUSTOM_YCbCr_420_SP_TILED) {
+        src_img->w = (src_img->w + 127) & (~127);
+        src_img->h = (src_img->h + 31) & (~31);
+    }
 
     //set src rect
     src_rect->x = SEC_MAX(cur->sourceCrop.left, 0);
@@ -99,15 +135,7 @@ static int set_src_dst_info(hwc_layer_t *cur,
     dst_img->w = win->lcd_info.xres;
     dst_img->h = win->lcd_info.yres;
 
-    switch (win->lcd_info.bits_per_pixel) {
-    case 32:
-        dst_img->format = HAL_PIXEL_FORMAT_RGBX_8888;
-        break;
-    default:
-        dst_img->format = HAL_PIXEL_FORMAT_RGB_565;
-        break;
-    }
-
+    dst_img->format = win->format;
     dst_img->base     = win->addr[win->buf_index];
     dst_img->offset   = 0;
     dst_img->mem_id   = 0;
@@ -127,11 +155,189 @@ static int set_src_dst_info(hwc_layer_t *cur,
     return 0;
 }
 
-static int get_hwc_compos_decision(hwc_layer_t* cur)
+static inline bool rect_equal(const hwc_rect_t *a, const hwc_rect_t *b)
+{
+    return a->left == b->left && a->top == b->top &&
+           a->right == b->right && a->bottom == b->bottom;
+}
+
+static bool win_layer_changed(struct hwc_win_info_t *win, hwc_layer_t *cur)
+{
+    return win->layer_prev_buf != (uint32_t)cur->handle ||
+           win->layer_prev_transform != cur->transform ||
+           !rect_equal(&win->layer_prev_crop, &cur->sourceCrop) ||
+           !rect_equal(&win->layer_prev_frame, &cur->displayFrame);
+}
+
+static void win_layer_save(struct hwc_win_info_t *win, hwc_layer_t *cur)
+{
+    win->layer_prev_buf = (uint32_t)cur->handle;
+    win->layer_prev_transform = cur->transform;
+    win->layer_prev_crop = cur->sourceCrop;
+    win->layer_prev_frame = cur->displayFrame;
+}
+
+static inline int rect_area(const hwc_rect_t *r)
+{
+    return SEC_MAX(r->right - r->left, 0) * SEC_MAX(r->bottom - r->top, 0);
+}
+
+static inline bool rect_intersect(const hwc_rect_t *a, const hwc_rect_t *b)
+{
+    return a->left < b->right && b->left < a->right &&
+           a->top < b->bottom && b->top < a->bottom;
+}
+
+/* a blended layer can go to a window when it only blends with black */
+static bool is_over_black(hwc_layer_list_t *list, int idx)
+{
+    for (int i = 0; i < idx; i++) {
+        if (rect_intersect(&list->hwLayers[i].displayFrame,
+                           &list->hwLayers[idx].displayFrame))
+            return false;
+    }
+    return true;
+}
+
+static inline bool is_yuv_format(int format)
+{
+    switch (format) {
+    case HAL_PIXEL_FORMAT_YV12:
+    case HAL_PIXEL_FORMAT_YCbCr_422_SP:
+    case HAL_PIXEL_FORMAT_YCrCb_420_SP:
+    case HAL_PIXEL_FORMAT_YCbCr_422_I:
+        return true;
+    default:
+        return format >= HAL_PIXEL_FORMAT_YCbCr_420_SP;
+    }
+}
+
+/*
+ * What the GPU spends on a layer, in pixels: the area it draws, twice for
+ * yuv since the shader does the colour conversion as well.
+ */
+static int get_gpu_cost(hwc_layer_t *cur)
+{
+    int cost = rect_area(&cur->displayFrame);
+
+    /* the decoder keeps the tiled pictures out of the gpu's reach */
+    if (cur->handle &&
+        ((IMG_native_handle_t *)cur->handle)->iFormat == HAL_PIXEL_FORMAT_CUSTOM_YCbCr_420_SP_TILED)
+        return HWC_GPU_COST_NO_GPU;
+    if (cur->handle &&
+        is_yuv_format(((IMG_native_handle_t *)cur->handle)->iFormat))
+        cost *= 2;
+    return cost;
+}
+
+/* what the fimc spends on an overlay: reading the crop, writing the frame */
+static int get_fimc_cost(hwc_layer_t *cur)
+{
+    return rect_area(&cur->sourceCrop) + rect_area(&cur->displayFrame);
+}
+
+/*
+ * A tiled buffer only holds where the MFC decoded the picture, see
+ * MFC_DEC_ANB_ADDRS in the OMX decoders. The record changes every frame.
+ */
+static int get_tiled_addrs(buffer_handle_t handle, unsigned int *phyAddr)
+{
+    IMG_native_handle_t *img = (IMG_native_handle_t *)handle;
+    ADDRS *addr = NULL;
+    int ret;
+
+    ret = gpsGrallocModule->base.lock(&gpsGrallocModule->base, handle,
+                                      GRALLOC_USAGE_SW_READ_RARELY, 0, 0,
+                                      img->iWidth, img->iHeight, (void **)&addr);
+    if (ret)
+        return ret;
+
+    phyAddr[0] = addr->addr_y;
+    phyAddr[1] = addr->addr_cbcr;
+    phyAddr[2] = 0;
+    gpsGrallocModule->base.unlock(&gpsGrallocModule->base, handle);
+
+    /* queued before the decoder filled it in */
+    return phyAddr[0] ? 0 : -EINVAL;
+}
+
+/*
+ * The capture time of the camera frame in a layer, 0 when it has none. A
+ * tiled buffer has the stamp behind its addresses, anything else over its
+ * first pixels.
+ */
+static int64_t get_capture_ns(buffer_handle_t handle)
+{
+    IMG_native_handle_t *img = (IMG_native_handle_t *)handle;
+    struct sec_latency_stamp stamp;
+    char *vaddr = NULL;
+    int ret;
+
+    ret = gpsGrallocModule->base.lock(&gpsGrallocModule->base, handle,
+                                      GRALLOC_USAGE_SW_READ_RARELY, 0, 0,
+                                      img->iWidth, img->iHeight, (void **)&vaddr);
+    if (ret)
+        return 0;
+
+    if (img->iFormat == HAL_PIXEL_FORMAT_CUSTOM_YCbCr_420_SP_TILED)
+        vaddr += sizeof(struct ADDRS);
+    ret = sec_latency_stamp_read(vaddr, &stamp);
+    gpsGrallocModule->base.unlock(&gpsGrallocModule->base, handle);
+
+    return ret ? 0 : stamp.capture_ns;
+}
+
+/*
+ * GetPhyAddrs goes to the kernel, and the same few buffers come back every
+ * frame. A handle whose stamp changed is a new buffer at a recycled
+ * address.
+ */
+static int get_phy_addrs(struct hwc_context_t *ctx, buffer_handle_t handle,
+                         unsigned int *phyAddr)
+{
+    IMG_native_handle_t *img = (IMG_native_handle_t *)handle;
+    struct hwc_phy_cache_entry *entry;
+    struct hwc_phy_cache_entry *victim = &ctx->phy_cache[0];
+    int ret;
+
+    if (img->iFormat == HAL_PIXEL_FORMAT_CUSTOM_YCbCr_420_SP_TILED)
+        return get_tiled_addrs(handle, phyAddr);
+
+    ctx->phy_cache_clock++;
+    for (int i = 0; i < HWC_PHY_CACHE_SIZE; i++) {
+        entry = &ctx->phy_cache[i];
+        if (entry->handle == handle && entry->stamp == img->ui64Stamp) {
+            entry->last_use = ctx->phy_cache_clock;
+            memcpy(phyAddr, entry->phy, sizeof(entry->phy));
+            return 0;
+        }
+        if (!entry->handle ||
+            (victim->handle && entry->last_use < victim->last_use))
+            victim = entry;
+    }
+
+    ret = gpsGrallocModule->GetPhyAddrs(gpsGrallocModule, handle, phyAddr);
+    if (ret)
+        return ret;
+
+    victim->handle = handle;
+    victim->stamp = img->ui64Stamp;
+    victim->last_use = ctx->phy_cache_clock;
+    memcpy(victim->phy, phyAddr, sizeof(victim->phy));
+    return 0;
+}
+
+static void flush_phy_cache(struct hwc_context_t *ctx)
+{
+    memset(ctx->phy_cache, 0, sizeof(ctx->phy_cache));
+}
+
+static int get_hwc_compos_decision(hwc_layer_t* cur, int *reason)
 {
     if(cur->flags & HWC_SKIP_LAYER || !cur->handle) {
         ALOGV("%s::is_skip_layer %d cur->handle %x",
                 __func__, cur->flags & HWC_SKIP_LAYER, (uint32_t)cur->handle);
+        *reason = cur->handle ? HWC_FB_SKIP : HWC_FB_NO_HANDLE;
         return HWC_FRAMEBUFFER;
     }
 
@@ -139,6 +345,7 @@ static int get_hwc_compos_decision(hwc_layer_t* cur)
     int compositionType = HWC_FRAMEBUFFER;
 
     /* check here....if we have any resolution constraints */
+    *reason = HWC_FB_SIZE;
     if (((cur->sourceCrop.right - cur->sourceCrop.left) < 16) ||
         ((cur->sourceCrop.bottom - cur->sourceCrop.top) < 8))
         return compositionType;
@@ -152,11 +359,32 @@ static int get_hwc_compos_decision(hwc_layer_t* cur)
                    ((cur->displayFrame.bottom - cur->displayFrame.top) < 4))
          return compositionType;
 
-    if((prev_handle->usage & GRALLOC_USAGE_PHYS_CONTIG) &&
-       (cur->blending == HWC_BLENDING_NONE))
-        compositionType = HWC_OVERLAY;
+    /* fimc_core refuses these, the window would just stay hidden */
+    int src_w = cur->sourceCrop.right - cur->sourceCrop.left;
+    int dst_w = cur->displayFrame.right - cur->displayFrame.left;
+    *reason = HWC_FB_SCALE;
+    if ((src_w > dst_w && src_w / dst_w > MAX_RESIZING_RATIO_LIMIT) ||
+        (dst_w > src_w && dst_w / src_w > MAX_RESIZING_RATIO_LIMIT))
+        return compositionType;
+
+    *reason = HWC_FB_FORMAT;
+    if (HAL_PIXEL_FORMAT_2_V4L2_PIX(prev_handle->iFormat) < 0 ||
+        !fimc_src_planes(prev_handle->iFormat))
+        return compositionType;
+
+    /*
+     * The fimc writes no per-pixel alpha, so a window can only show a
+     * layer opaque. That is right for a premultiplied layer over the black
+     * background, the planner checks nothing is under it. Coverage
+     * blending needs the alpha even over black.
+     */
+    if (!(prev_handle->usage & GRALLOC_USAGE_PHYS_CONTIG) &&
+        prev_handle->iFormat != HAL_PIXEL_FORMAT_CUSTOM_YCbCr_420_SP_TILED)
+        *reason = HWC_FB_NOT_CONTIG;
+    else if (cur->blending == HWC_BLENDING_COVERAGE)
+        *reason = HWC_FB_BLENDING;
     else
-        compositionType = HWC_FRAMEBUFFER;
+        compositionType = HWC_OVERLAY;
 
     ALOGV("%s::compositionType %d bpp %d format %x usage %x",
             __func__,compositionType, prev_handle->uiBpp, prev_handle->iFormat,
@@ -174,7 +402,7 @@ static int assign_overlay_window(struct hwc_context_t *ctx,
     sec_rect rect;
     int ret = 0;
 
-    if(NUM_OF_WIN <= win_idx)
+    if((int)ctx->num_of_win <= win_idx)
         return -1;
 
     win = &ctx->win[win_idx];
@@ -196,11 +424,12 @@ static int assign_overlay_window(struct hwc_context_t *ctx,
     }
 
     win->layer_index = layer_idx;
+    win->blending = cur->blending;
     win->status = HWC_WIN_RESERVED;
 
-    ALOGV("%s:: win_x %d win_y %d win_w %d win_h %d lay_idx %d win_idx %d",
+    ALOGV("%s:: win_x %d win_y %d win_w %d win_h %d lay_idx %d win_idx %d z %d",
             __func__, win->rect_info.x, win->rect_info.y, win->rect_info.w,
-            win->rect_info.h, win->layer_index, win_idx );
+            win->rect_info.h, win->layer_index, win_idx, win->zorder);
 
     return 0;
 }
@@ -214,34 +443,351 @@ static void reset_win_rect_info(hwc_win_info_t *win)
     return;
 }
 
+/*
+ * The fimc runs a oneshot per job: the driver only takes a new destination
+ * address with the stream off, and every frame lands in another window
+ * buffer. The broker runs the jobs on the thread of the node, which keeps
+ * the composition thread from waiting on the fimc. The jobs scale into a
+ * back buffer and flip the window when they are done. hwc_set advances
+ * buf_index when it queues a job, so with NUM_OF_WIN_BUF buffers the fimc
+ * never writes the one being scanned out. A job holds a dup of its source
+ * handle, the buffer may be gone from surfaceflinger before the job runs.
+ */
+static void finish_fimc_job(struct hwc_fimc_job *job, int ret)
+{
+    struct hwc_win_info_t *win = job->win;
+    SEC_TRACE_SCOPE("hwc:fimc_pan");
+
+    if (ret < 0) {
+        ALOGE("%s::fimc_flush fail", __func__);
+        goto fail;
+    }
+
+    if (job->set_pos) {
+        /* turnoff the window and set the window position with new conf... */
+        if (window_set_pos(win) < 0) {
+            ALOGE("%s::window_set_pos is failed : %s", __func__,
+                    strerror(errno));
+            goto fail;
+        }
+    }
+
+    window_pan_display(win, job->buf_index);
+    window_show(win);
+    return;
+
+fail:
+    /* redo the whole job on the next frame */
+    win->layer_prev_buf = 0;
+    win->set_win_flag = job->set_pos;
+    window_hide(win);
+}
+
+static void fimc_job_done(struct fimc_job *base, int ret)
+{
+    struct hwc_fimc_job *job = (struct hwc_fimc_job *)base->data;
+    struct hwc_context_t *ctx = job->ctx;
+
+    pthread_mutex_lock(&ctx->fimc_lock);
+    add_time_stats(&ctx->stats.fimc, base->run_ns);
+    if (ret < 0)
+        ctx->stats.fimc_errors++;
+    else
+        ctx->stats.pans++;
+    pthread_mutex_unlock(&ctx->fimc_lock);
+
+    /* hwc_set doesn't touch the jobs or their windows while busy */
+    finish_fimc_job(job, ret);
+
+    /* the fimc is done reading the source */
+    if (job->src_ref) {
+        native_handle_close(job->src_ref);
+        native_handle_delete(job->src_ref);
+        job->src_ref = NULL;
+    }
+
+    pthread_mutex_lock(&ctx->fimc_lock);
+    if (ret >= 0 && job->capture_ns)
+        add_time_stats(&ctx->stats.latency, hwc_now() - job->capture_ns);
+    if (--ctx->fimc_busy == 0)
+        pthread_cond_broadcast(&ctx->fimc_done_cond);
+    pthread_mutex_unlock(&ctx->fimc_lock);
+}
+
+/* wait for the jobs of the previous frame, their source buffers go back to
+ * the producer once surfaceflinger latches the next ones */
+static void hwc_fimc_wait(struct hwc_context_t *ctx)
+{
+    SEC_TRACE_SCOPE("hwc:fimc_wait");
+    pthread_mutex_lock(&ctx->fimc_lock);
+    while (ctx->fimc_busy)
+        pthread_cond_wait(&ctx->fimc_done_cond, &ctx->fimc_lock);
+    ctx->num_of_fimc_job = 0;
+    pthread_mutex_unlock(&ctx->fimc_lock);
+}
+
+static int64_t vsync_model_next(struct hwc_vsync_model *m);
+
+/* the windows pan at the next edge, a job done later shows a frame late */
+static void hwc_fimc_kick(struct hwc_context_t *ctx)
+{
+    /* racing the vsync thread, a stale edge only reorders the queue */
+    int64_t deadline = vsync_model_next(&ctx->vsync);
+    unsigned int i;
+    int ret;
+
+    if (ctx->num_of_fimc_job == 0)
+        return;
+
+    pthread_mutex_lock(&ctx->fimc_lock);
+    ctx->fimc_busy = ctx->num_of_fimc_job;
+    pthread_mutex_unlock(&ctx->fimc_lock);
+
+    for (i = 0; i < ctx->num_of_fimc_job; i++) {
+        struct hwc_fimc_job *job = &ctx->fimc_job[i];
+
+        job->ctx = ctx;
+        job->base.fimc = &ctx->fimc;
+        job->base.priority = FIMC_JOB_DISPLAY;
+        job->base.deadline = deadline;
+        job->base.done = fimc_job_done;
+        job->base.data = job;
+        ret = fimc_broker_submit(&job->base);
+        if (ret < 0) {
+            ALOGE("%s::fimc_broker_submit fail : %d", __func__, ret);
+            fimc_job_done(&job->base, ret);
+        }
+    }
+}
+
+/*
+ * Pick the overlay layers that leave the GPU the least to do. Every subset
+ * of at most num_of_win candidates within the fimc budget is tried, there
+ * are few enough of them. Keeping any layer in the framebuffer also costs
+ * a full screen composition and swap, so going all-overlay wins a bonus.
+ * Returns a mask of layer indices.
+ */
+static uint32_t plan_overlays(struct hwc_context_t *ctx, hwc_layer_list_t *list)
+{
+    int cand[HWC_MAX_CANDIDATES];
+    int cand_gpu[HWC_MAX_CANDIDATES];
+    int cand_fimc[HWC_MAX_CANDIDATES];
+    int num_of_cand = 0;
+    int screen = ctx->lcd_info.xres * ctx->lcd_info.yres;
+    int gpu_total = 0;
+    int best_cost = -1;
+    uint32_t best = 0;
+    int reason;
+
+    memset(ctx->stats.frame_reason, 0, sizeof(ctx->stats.frame_reason));
+
+    for (int i = 0; i < (int)list->numHwLayers; i++) {
+        hwc_layer_t *cur = &list->hwLayers[i];
+        int gpu = get_gpu_cost(cur);
+
+        gpu_total += gpu;
+        if (get_hwc_compos_decision(cur, &reason) != HWC_OVERLAY) {
+            ctx->stats.frame_reason[reason]++;
+        } else if (cur->blending != HWC_BLENDING_NONE && !is_over_black(list, i)) {
+            ctx->stats.frame_reason[HWC_FB_BLENDING]++;
+        } else if (num_of_cand < HWC_MAX_CANDIDATES) {
+            cand[num_of_cand] = i;
+            cand_gpu[num_of_cand] = gpu;
+            cand_fimc[num_of_cand] = get_fimc_cost(cur);
+            num_of_cand++;
+        }
+    }
+
+    for (uint32_t set = 0; set < (1u << num_of_cand); set++) {
+        int n = __builtin_popcount(set);
+        int cost = gpu_total;
+        int fimc = 0;
+
+        if (n > (int)ctx->num_of_win)
+            continue;
+
+        for (int j = 0; j < num_of_cand; j++) {
+            if (set & (1 << j)) {
+                cost -= cand_gpu[j];
+                fimc += cand_fimc[j];
+            }
+        }
+        if (fimc > HWC_FIMC_BUDGET * screen)
+            continue;
+        if (n < (int)list->numHwLayers)
+            cost += screen;
+
+        /* same cost, fewer windows */
+        if (best_cost < 0 || cost < best_cost ||
+            (cost == best_cost && n < __builtin_popcount(best))) {
+            best_cost = cost;
+            best = set;
+        }
+    }
+
+    uint32_t layers = 0;
+    for (int j = 0; j < num_of_cand; j++) {
+        if (best & (1 << j))
+            layers |= 1 << cand[j];
+    }
+
+    /* eligible layers left out, past the candidates or not worth it */
+    int eligible = list->numHwLayers;
+    for (int k = 0; k < HWC_FB_PLANNER; k++)
+        eligible -= ctx->stats.frame_reason[k];
+    ctx->stats.frame_reason[HWC_FB_PLANNER] = eligible - __builtin_popcount(best);
+
+    ALOGV("%s:: %d candidates, overlays %x gpu cost %d of %d",
+            __func__, num_of_cand, layers, best_cost, gpu_total + screen);
+
+    return layers;
+}
+
+#if defined(BOARD_HAVE_HDMI)
+/*
+ * hdmi->blit runs another fimc job in SecHDMI, it must not hold up the
+ * local display. The tv only ever gets the latest frame: when the blit
+ * can't keep up, the frames in between are dropped.
+ */
+static void *hwc_hdmi_thread(void *data)
+{
+    struct hwc_context_t *ctx = (struct hwc_context_t *)data;
+    struct hwc_hdmi_blit blit;
+
+    sec_thread_set_role(SEC_THREAD_ROLE_DISPLAY);
+
+    pthread_mutex_lock(&ctx->hdmi_lock);
+    while (true) {
+        while (!ctx->hdmi_mail_full && !ctx->hdmi_exit)
+            pthread_cond_wait(&ctx->hdmi_cond, &ctx->hdmi_lock);
+        if (ctx->hdmi_exit)
+            break;
+        blit = ctx->hdmi_mail;
+        ctx->hdmi_mail_full = 0;
+        pthread_mutex_unlock(&ctx->hdmi_lock);
+
+        ctx->hdmi->blit(ctx->hdmi,
+                        blit.w,
+                        blit.h,
+                        blit.format,
+                        blit.y,
+                        blit.cb,
+                        blit.cr,
+                        0, 0,
+                        HDMI_MODE_VIDEO,
+                        blit.num_of_hwc_layer);
+
+        pthread_mutex_lock(&ctx->hdmi_lock);
+    }
+    pthread_mutex_unlock(&ctx->hdmi_lock);
+
+    return NULL;
+}
+
+static void hwc_hdmi_post(struct hwc_context_t *ctx, struct hwc_hdmi_blit *blit)
+{
+    pthread_mutex_lock(&ctx->hdmi_lock);
+    if (ctx->hdmi_mail_full) {
+        ctx->hdmi_dropped++;
+        ALOGV("%s:: tv behind, %u frames dropped", __func__, ctx->hdmi_dropped);
+    }
+    ctx->hdmi_mail = *blit;
+    ctx->hdmi_mail_full = 1;
+    pthread_cond_signal(&ctx->hdmi_cond);
+    pthread_mutex_unlock(&ctx->hdmi_lock);
+}
+
+/* 1 sends a full screen video to the tv only, the panel goes dark */
+#define HWC_HDMI_ONLY_PROPERTY  "persist.hdmi.video_only"
+#define HWC_HDMI_POLL_NS        (500 * 1000000LL)
+
+/*
+ * Presentation mode: with the tv out cable in and switched on in the
+ * settings, and the property set, a single video overlay skips its
+ * local fimc pass and window, and the panel windows are blanked. The fimc node is left to the hdmi blit, which
+ * then keeps up with a 720p mirror. The property, cable and setting are
+ * looked at twice a second, any one going away brings the panel back
+ * on the next frame.
+ */
+static bool hwc_hdmi_only(struct hwc_context_t *ctx, hwc_layer_list_t *list)
+{
+    int64_t now = hwc_now();
+    hwc_layer_t *cur;
+
+    if (now - ctx->hdmi_poll_time >= HWC_HDMI_POLL_NS) {
+        char value[PROPERTY_VALUE_MAX];
+
+        property_get(HWC_HDMI_ONLY_PROPERTY, value, "0");
+        ctx->hdmi_only_wanted = atoi(value) != 0;
+
+        ctx->hdmi_cable = ctx->hdmi_only_wanted &&
+                sec_tvout_read_cable(ctx->hdmi_cable_fd) > 0 &&
+                sec_tvout_enabled();
+        ctx->hdmi_poll_time = now;
+    }
+
+    if (!ctx->hdmi_only_wanted || !ctx->hdmi_cable ||
+        !ctx->hdmi_thread_running || ctx->num_of_hwc_layer != 1 ||
+        ctx->win[0].status != HWC_WIN_RESERVED)
+        return false;
+
+    cur = &list->hwLayers[ctx->win[0].layer_index];
+    return cur->compositionType == HWC_OVERLAY && cur->handle &&
+           is_yuv_format(((IMG_native_handle_t *)cur->handle)->iFormat);
+}
+
+static void hwc_hdmi_stop(struct hwc_context_t *ctx)
+{
+    if (!ctx->hdmi_thread_running)
+        return;
+    pthread_mutex_lock(&ctx->hdmi_lock);
+    ctx->hdmi_exit = 1;
+    pthread_cond_signal(&ctx->hdmi_cond);
+    pthread_mutex_unlock(&ctx->hdmi_lock);
+    pthread_join(ctx->hdmi_thread, NULL);
+    ctx->hdmi_thread_running = 0;
+}
+#endif
+
 static int hwc_prepare(hwc_composer_device_t *dev, hwc_layer_list_t* list)
 {
 
     struct hwc_context_t* ctx = (struct hwc_context_t*)dev;
     int overlay_win_cnt = 0;
-    int compositionType = 0;
+    uint32_t overlays;
     int ret;
+    SEC_TRACE_SCOPE("hwc:prepare");
 
     //if geometry is not changed, there is no need to do any work here
     if( !list || (!(list->flags & HWC_GEOMETRY_CHANGED)))
         return 0;
 
+    /* the windows are about to be reassigned */
+    hwc_fimc_wait(ctx);
+
+    /* new layers come with new buffer queues, the old ones may be gone */
+    flush_phy_cache(ctx);
+
     //all the windows are free here....
-    for (int i = 0; i < NUM_OF_WIN; i++) {
+    for (unsigned int i = 0; i < ctx->num_of_win; i++)
         ctx->win[i].status = HWC_WIN_FREE;
-        ctx->win[i].buf_index = 0;
-    }
+
     ctx->num_of_hwc_layer = 0;
     ctx->num_of_fb_layer = 0;
     ALOGV("%s:: hwc_prepare list->numHwLayers %d", __func__, list->numHwLayers);
 
+    overlays = plan_overlays(ctx, list);
+
+    /*
+     * layers come bottom to top and windows are handed out in the same
+     * order, so the window z-order follows the layer z-order. all of them
+     * sit under the framebuffer, which gets a hole punched above each one.
+     */
     for (int i = 0; i < list->numHwLayers ; i++) {
         hwc_layer_t* cur = &list->hwLayers[i];
 
-        if (overlay_win_cnt < NUM_OF_WIN) {
-            compositionType = get_hwc_compos_decision(cur);
-
-            if (compositionType == HWC_FRAMEBUFFER) {
+        if (overlay_win_cnt < (int)ctx->num_of_win) {
+            if (i >= 32 || !(overlays & (1 << i))) {
                 cur->compositionType = HWC_FRAMEBUFFER;
                 ctx->num_of_fb_layer++;
             } else {
@@ -268,9 +814,9 @@ static int hwc_prepare(hwc_composer_device_t *dev, hwc_layer_list_t* list)
                 __func__, list->numHwLayers, ctx->num_of_fb_layer,
                 ctx->num_of_hwc_layer);
 
-    if (overlay_win_cnt < NUM_OF_WIN) {
+    if (overlay_win_cnt < (int)ctx->num_of_win) {
         //turn off the free windows
-        for (int i = overlay_win_cnt; i < NUM_OF_WIN; i++) {
+        for (unsigned int i = overlay_win_cnt; i < ctx->num_of_win; i++) {
             window_hide(&ctx->win[i]);
             reset_win_rect_info(&ctx->win[i]);
         }
@@ -278,6 +824,66 @@ static int hwc_prepare(hwc_composer_device_t *dev, hwc_layer_list_t* list)
     return 0;
 }
 
+static void add_damage(hwc_rect_t *damage, const hwc_rect_t *r)
+{
+    if (r->left >= r->right || r->top >= r->bottom)
+        return;
+    if (damage->left >= damage->right || damage->top >= damage->bottom) {
+        *damage = *r;
+        return;
+    }
+    damage->left   = SEC_MIN(damage->left, r->left);
+    damage->top    = SEC_MIN(damage->top, r->top);
+    damage->right  = SEC_MAX(damage->right, r->right);
+    damage->bottom = SEC_MAX(damage->bottom, r->bottom);
+}
+
+/*
+ * What surfaceflinger's GLES pass changed in the framebuffer, bounded by
+ * one rectangle. A new geometry or a skip layer, whose content we can't
+ * follow, repaints all of it; otherwise only the visible part of the
+ * framebuffer layers that got a new buffer. Returns false if nothing
+ * changed.
+ */
+static bool get_fb_damage(struct hwc_context_t *ctx, hwc_layer_list_t *list,
+                          hwc_rect_t *damage)
+{
+    bool all = (list->flags & HWC_GEOMETRY_CHANGED) ||
+               list->numHwLayers > HWC_MAX_DAMAGE_LAYERS;
+
+    memset(damage, 0, sizeof(*damage));
+
+    for (int i = 0; i < (int)list->numHwLayers; i++) {
+        hwc_layer_t *cur = &list->hwLayers[i];
+        buffer_handle_t handle = cur->compositionType == HWC_FRAMEBUFFER ?
+                cur->handle : NULL;
+
+        if (all || (cur->flags & HWC_SKIP_LAYER)) {
+            all = true;
+        } else if (handle != ctx->fb_prev_handle[i]) {
+            const hwc_region_t *vis = &cur->visibleRegionScreen;
+            for (size_t j = 0; j < vis->numRects; j++)
+                add_damage(damage, &vis->rects[j]);
+            /* a layer that went away doesn't report where it was */
+            if (!handle)
+                all = true;
+        }
+        if (i < HWC_MAX_DAMAGE_LAYERS)
+            ctx->fb_prev_handle[i] = handle;
+    }
+    for (int i = list->numHwLayers; i < HWC_MAX_DAMAGE_LAYERS; i++)
+        ctx->fb_prev_handle[i] = NULL;
+
+    if (all) {
+        damage->left = 0;
+        damage->top = 0;
+        damage->right = ctx->lcd_info.xres;
+        damage->bottom = ctx->lcd_info.yres;
+    }
+
+    return damage->left < damage->right && damage->top < damage->bottom;
+}
+
 static int hwc_set(hwc_composer_device_t *dev,
                    hwc_display_t dpy,
                    hwc_surface_t sur,
@@ -293,16 +899,66 @@ static int hwc_set(hwc_composer_device_t *dev,
     struct sec_img dst_img;
     struct sec_rect src_rect;
     struct sec_rect dst_rect;
+    struct hwc_fimc_job *job;
+    bool wait_fimc = false;
+    SEC_TRACE_SCOPE("hwc:set");
+
+    hwc_fimc_wait(ctx);
 
     if (dpy == NULL && sur == NULL && list == NULL) {
         // release our resources, the screen is turning off
-        // in our case, there is nothing to do.
-        ctx->num_of_fb_layer_prev = 0;
+        // leave the framebuffer window on, so it comes back as it went.
+        window_show(&ctx->global_lcd_win);
+        flush_phy_cache(ctx);
         return 0;
     }
 
+    bool hdmi_only = false;
+#if defined(BOARD_HAVE_HDMI)
+    hdmi_only = list && hwc_hdmi_only(ctx, list);
+    if (hdmi_only) {
+        ctx->stats.hdmi_only_frames++;
+    } else if (ctx->hdmi_only) {
+        /* back on the panel, the windows hold stale frames */
+        for (unsigned int i = 0; i < ctx->num_of_win; i++)
+            ctx->win[i].layer_prev_buf = 0;
+    }
+    ctx->hdmi_only = hdmi_only;
+#endif
+
     bool need_swap_buffers = ctx->num_of_fb_layer > 0;
 
+    /*
+     * The GLES pass already ran, we can't scissor it from here. What we
+     * can do is not post a frame that is the same as the one on screen,
+     * and tell an egl with partial updates how much really changed.
+     */
+    if (need_swap_buffers && list) {
+        hwc_rect_t damage;
+
+        if (!ctx->swap_rect_checked) {
+            const char *exts = eglQueryString((EGLDisplay)dpy, EGL_EXTENSIONS);
+            if (exts && strstr(exts, "EGL_ANDROID_swap_rectangle"))
+                *(void **)&ctx->set_swap_rect =
+                    (void *)eglGetProcAddress("eglSetSwapRectangleANDROID");
+            ctx->swap_rect_checked = 1;
+        }
+
+        if (!get_fb_damage(ctx, list, &damage) &&
+            ctx->global_lcd_win.power_state) {
+            need_swap_buffers = false;
+            ctx->stats.swaps_skipped++;
+        } else {
+            ctx->stats.damage_pixels += rect_area(&damage);
+            if (ctx->set_swap_rect)
+                ctx->set_swap_rect((EGLDisplay)dpy, (EGLSurface)sur,
+                        damage.left, damage.top,
+                        damage.right - damage.left, damage.bottom - damage.top);
+        }
+    } else {
+        memset(ctx->fb_prev_handle, 0, sizeof(ctx->fb_prev_handle));
+    }
+
     /*
      * H/W composer documentation states:
      * There is an implicit layer containing opaque black
@@ -310,33 +966,31 @@ static int hwc_set(hwc_composer_device_t *dev,
      * It is the responsibility of the hwcomposer module to make
      * sure black pixels are output (or blended from).
      *
-     * Since we're using a blitter, we need to erase the frame-buffer when
-     * switching to all-overlay mode.
+     * The overlays sit under the framebuffer window, and the fimd shows
+     * its black background wherever no window is on. In all-overlay mode
+     * the framebuffer has nothing to show, so we turn its window off
+     * instead of clearing it with GLES and swapping once more.
      *
      */
-    if (ctx->num_of_hwc_layer &&
-        ctx->num_of_fb_layer==0 && ctx->num_of_fb_layer_prev) {
-        /* we're clearing the screen using GLES here, this is very
-         * hack-ish, ideal we would use the fimc (if it can do it) */
-        glDisable(GL_SCISSOR_TEST);
-        glClearColor(0, 0, 0, 0);
-        glClear(GL_COLOR_BUFFER_BIT);
-        glEnable(GL_SCISSOR_TEST);
-        need_swap_buffers = true;
-    }
-
-    ctx->num_of_fb_layer_prev = ctx->num_of_fb_layer;
+    if ((ctx->num_of_hwc_layer && ctx->num_of_fb_layer == 0 && list) || hdmi_only)
+        window_hide(&ctx->global_lcd_win);
 
     if (need_swap_buffers || !list) {
+        int64_t start = hwc_now();
         EGLBoolean sucess = eglSwapBuffers((EGLDisplay)dpy, (EGLSurface)sur);
+        add_time_stats(&ctx->stats.swap, hwc_now() - start);
         if (!sucess) {
             return HWC_EGL_ERROR;
         }
     }
 
+    /* back from all-overlay mode, the swap above has the new frame */
+    if ((ctx->num_of_fb_layer || !ctx->num_of_hwc_layer || !list) && !hdmi_only)
+        window_show(&ctx->global_lcd_win);
+
     if (!list) {
         /* turn off the all windows */
-        for (int i = 0; i < NUM_OF_WIN; i++) {
+        for (unsigned int i = 0; i < ctx->num_of_win; i++) {
             window_hide(&ctx->win[i]);
             reset_win_rect_info(&ctx->win[i]);
             ctx->win[i].status = HWC_WIN_FREE;
@@ -345,8 +999,14 @@ static int hwc_set(hwc_composer_device_t *dev,
         return 0;
     }
 
-    if(ctx->num_of_hwc_layer > NUM_OF_WIN)
-        ctx->num_of_hwc_layer = NUM_OF_WIN;
+    if(ctx->num_of_hwc_layer > ctx->num_of_win)
+        ctx->num_of_hwc_layer = ctx->num_of_win;
+
+    ctx->stats.frames++;
+    ctx->stats.layers += list->numHwLayers;
+    ctx->stats.overlay_layers += ctx->num_of_hwc_layer;
+    for (int k = 0; k < HWC_FB_REASON_CNT; k++)
+        ctx->stats.fb_reason[k] += ctx->stats.frame_reason[k];
 
     /* compose hardware layers here */
     for (uint32_t i = 0; i < ctx->num_of_hwc_layer; i++) {
@@ -356,50 +1016,79 @@ static int hwc_set(hwc_composer_device_t *dev,
 
             if (cur->compositionType == HWC_OVERLAY) {
 
-                ret = gpsGrallocModule->GetPhyAddrs(gpsGrallocModule,
-                        cur->handle, phyAddr);
-                if (ret) {
-                    ALOGE("%s::GetPhyAddrs fail : ret=%d\n", __func__, ret);
-                    skipped_window_mask |= (1 << i);
-                    continue;
-                }
-
                 /* initialize the src & dist context for fimc */
                 set_src_dst_info (cur, win, &src_img, &dst_img, &src_rect,
                         &dst_rect, i);
 
-                ret = fimc_flush(&ctx->fimc, &src_img, &src_rect, &dst_img, &dst_rect,
-                        phyAddr, cur->transform);
-                if (ret < 0){
-                   ALOGE("%s::fimc_flush fail : ret=%d\n", __func__, ret);
-                   skipped_window_mask |= (1 << i);
-                   continue;
+                /*
+                 * a paused video or a static overlay is already in the
+                 * window, only run the fimc when the buffer or its
+                 * placement changed. a moved window has layer_prev_buf
+                 * cleared by assign_overlay_window.
+                 */
+                bool changed = win_layer_changed(win, cur);
+
+                /* the tv takes the buffer as it is, the window stays off */
+                if (hdmi_only) {
+                    window_hide(win);
+                    if (changed) {
+                        ret = get_phy_addrs(ctx, cur->handle, phyAddr);
+                        if (ret) {
+                            ALOGE("%s::GetPhyAddrs fail : ret=%d\n", __func__, ret);
+                            win->layer_prev_buf = 0;
+                            continue;
+                        }
+                        win_layer_save(win, cur);
+                        memcpy(win->layer_prev_phy, phyAddr, sizeof(win->layer_prev_phy));
+                    }
+                    continue;
                 }
 
-                if (win->set_win_flag == 1) {
-                    /* turnoff the window and set the window position with new conf... */
-                    if (window_set_pos(win) < 0) {
-                        ALOGE("%s::window_set_pos is failed : %s", __func__,
-                                strerror(errno));
+                if (changed) {
+                    ret = get_phy_addrs(ctx, cur->handle, phyAddr);
+                    if (ret) {
+                        ALOGE("%s::GetPhyAddrs fail : ret=%d\n", __func__, ret);
+                        win->layer_prev_buf = 0;
                         skipped_window_mask |= (1 << i);
                         continue;
                     }
-                    win->set_win_flag = 0;
-                }
 
-                /* is the frame didn't change, it needs to be composited
-                 * because something else below it could have changed, however
-                 * it doesn't need to be swapped.
-                 */
-                if (win->layer_prev_buf != (uint32_t)cur->handle) {
-                    win->layer_prev_buf = (uint32_t)cur->handle;
-                    window_pan_display(win);
+                    /* the fimc broker scales into the back buffer and
+                     * flips the window to it. a crop or transform change
+                     * on the same handle needs the flip as much as a new
+                     * handle does. a moved window always changed, so the
+                     * job repositions it too.
+                     */
+                    job = &ctx->fimc_job[ctx->num_of_fimc_job++];
+                    job->win       = win;
+                    job->base.src_img   = src_img;
+                    job->base.dst_img   = dst_img;
+                    job->base.src_rect  = src_rect;
+                    job->base.dst_rect  = dst_rect;
+                    memcpy(job->base.phyAddr, phyAddr, sizeof(job->base.phyAddr));
+                    job->base.transform = cur->transform;
+                    job->buf_index = win->buf_index;
+                    job->set_pos   = win->set_win_flag;
+                    job->capture_ns = ctx->latency_probe ?
+                            get_capture_ns(cur->handle) : 0;
+                    job->src_ref = native_handle_clone(cur->handle);
+                    if (!job->src_ref) {
+                        /* no reference, the job can't outlive this call */
+                        ALOGW("%s::native_handle_clone fail : %s", __func__,
+                                strerror(errno));
+                        wait_fimc = true;
+                    }
+
+                    win->set_win_flag = 0;
+                    win_layer_save(win, cur);
+                    memcpy(win->layer_prev_phy, phyAddr, sizeof(win->layer_prev_phy));
                     win->buf_index = (win->buf_index + 1) % NUM_OF_WIN_BUF;
+                } else {
+                    ctx->stats.fimc_skipped++;
+                    if(win->power_state == 0)
+                        window_show(win);
                 }
 
-                if(win->power_state == 0)
-                    window_show(win);
-
             } else {
                 ALOGE("%s:: error : layer %d compositionType should have been \
                         HWC_OVERLAY", __func__, win->layer_index);
@@ -416,42 +1105,52 @@ static int hwc_set(hwc_composer_device_t *dev,
 
     if (skipped_window_mask) {
         //turn off the free windows
-        for (int i = 0; i < NUM_OF_WIN; i++) {
+        for (unsigned int i = 0; i < ctx->num_of_win; i++) {
             if (skipped_window_mask & (1 << i))
                 window_hide(&ctx->win[i]);
         }
     }
 
+    hwc_fimc_kick(ctx);
+    if (wait_fimc)
+        hwc_fimc_wait(ctx);
+
 #if defined(BOARD_HAVE_HDMI)
-    hdmi_device_t* hdmi = ctx->hdmi;
-    if (ctx->num_of_hwc_layer == 1 && hdmi) {
-        if ((src_img.format == HAL_PIXEL_FORMAT_CUSTOM_YCbCr_420_SP_TILED)||
-                (src_img.format == HAL_PIXEL_FORMAT_CUSTOM_YCrCb_420_SP)) {
+    if (ctx->num_of_hwc_layer == 1 && ctx->hdmi_thread_running) {
+        struct hwc_hdmi_blit blit;
+
+        blit.w = src_img.w;
+        blit.h = src_img.h;
+        blit.format = src_img.format;
+        blit.num_of_hwc_layer = ctx->num_of_hwc_layer;
+
+        if (src_img.format == HAL_PIXEL_FORMAT_CUSTOM_YCbCr_420_SP_TILED) {
+            blit.y  = ctx->win[0].layer_prev_phy[0];
+            blit.cb = ctx->win[0].layer_prev_phy[1];
+            blit.cr = ctx->win[0].layer_prev_phy[1];
+            hwc_hdmi_post(ctx, &blit);
+        } else if (src_img.format == HAL_PIXEL_FORMAT_CUSTOM_YCrCb_420_SP) {
             ADDRS * addr = (ADDRS *)(src_img.base);
-            hdmi->blit(hdmi,
-                       src_img.w,
-                       src_img.h,
-                       src_img.format,
-                       (unsigned int)addr->addr_y,
-                       (unsigned int)addr->addr_cbcr,
-                       (unsigned int)addr->addr_cbcr,
-                       0, 0,
-                       HDMI_MODE_VIDEO,
-                       ctx->num_of_hwc_layer);
+            blit.y  = (unsigned int)addr->addr_y;
+            blit.cb = (unsigned int)addr->addr_cbcr;
+            blit.cr = (unsigned int)addr->addr_cbcr;
+            hwc_hdmi_post(ctx, &blit);
+        } else if (src_img.format == HAL_PIXEL_FORMAT_YV12) {
+            /* the camera viewfinder: gralloc gives the planes in memory
+             * order, V ahead of U, the tv fimc only takes them as I420
+             */
+            blit.format = HAL_PIXEL_FORMAT_YCbCr_420_P;
+            blit.y  = ctx->win[0].layer_prev_phy[0];
+            blit.cb = ctx->win[0].layer_prev_phy[2];
+            blit.cr = ctx->win[0].layer_prev_phy[1];
+            hwc_hdmi_post(ctx, &blit);
         } else if ((src_img.format == HAL_PIXEL_FORMAT_YCbCr_420_SP) ||
                     (src_img.format == HAL_PIXEL_FORMAT_YCrCb_420_SP) ||
-                    (src_img.format == HAL_PIXEL_FORMAT_YCbCr_420_P) ||
-                    (src_img.format == HAL_PIXEL_FORMAT_YV12)) {
-            hdmi->blit(hdmi,
-                       src_img.w,
-                       src_img.h,
-                       src_img.format,
-                       (unsigned int)ctx->fimc.params.src.buf_addr_phy_rgb_y,
-                       (unsigned int)ctx->fimc.params.src.buf_addr_phy_cb,
-                       (unsigned int)ctx->fimc.params.src.buf_addr_phy_cr,
-                       0, 0,
-                       HDMI_MODE_VIDEO,
-                       ctx->num_of_hwc_layer);
+                    (src_img.format == HAL_PIXEL_FORMAT_YCbCr_420_P)) {
+            blit.y  = ctx->win[0].layer_prev_phy[0];
+            blit.cb = ctx->win[0].layer_prev_phy[1];
+            blit.cr = ctx->win[0].layer_prev_phy[2];
+            hwc_hdmi_post(ctx, &blit);
         } else {
             ALOGE("%s: Unsupported format = %d for hdmi", __func__, src_img.format);
         }
@@ -489,7 +1188,6 @@ static int hwc_query(struct hwc_composer_device* dev,
     return 0;
 }
 
-#ifdef VSYNC_IOCTL
 // Linux version of a manual reset event to control when
 // and when not to ask the video card for a VSYNC.  This
 // stops the worker thread from asking for a VSYNC when
@@ -498,7 +1196,6 @@ static int hwc_query(struct hwc_composer_device* dev,
 int vsync_enable = 0;
 pthread_mutex_t vsync_mutex = PTHREAD_MUTEX_INITIALIZER;
 pthread_cond_t vsync_condition = PTHREAD_COND_INITIALIZER;
-#endif
 
 static int hwc_eventControl(struct hwc_composer_device* dev,
         int event, int enabled)
@@ -512,7 +1209,6 @@ static int hwc_eventControl(struct hwc_composer_device* dev,
         if (err < 0)
             return -errno;
 
-#if VSYNC_IOCTL
         // Enable or disable the ability for the worker thread
         // to ask for VSYNC events from the video driver
         pthread_mutex_lock(&vsync_mutex);
@@ -522,7 +1218,6 @@ static int hwc_eventControl(struct hwc_composer_device* dev,
         }
         else vsync_enable = 0;
         pthread_mutex_unlock(&vsync_mutex);
-#endif
 
         return 0;
     }
@@ -530,13 +1225,77 @@ static int hwc_eventControl(struct hwc_composer_device* dev,
     return -EINVAL;
 }
 
-void handle_vsync_uevent(hwc_context_t *ctx, const char *buff, int len)
+/*
+ * Feed a hardware timestamp to the model. Missed interrupts show up as a
+ * multiple of the period, the estimate only moves by 1/HWC_VSYNC_FILTER of
+ * each sample so one late interrupt doesn't drag the phase along.
+ */
+static void vsync_model_update(struct hwc_vsync_model *m, int64_t ts)
 {
-    uint64_t timestamp = 0;
-    const char *s = buff;
+    if (m->valid && ts > m->last_hw) {
+        int64_t delta = ts - m->last_hw;
+        int64_t n = (delta + m->period / 2) / m->period;
+
+        if (n >= 1 && n <= 4) {
+            int64_t err = ts - (m->last_hw + n * m->period);
+            if (err < 0)
+                err = -err;
+            m->err_sum += err;
+            if (err > m->err_max)
+                m->err_max = err;
+
+            m->period += (delta / n - m->period) / HWC_VSYNC_FILTER;
+            if (m->period < m->nominal / 2 || m->period > m->nominal * 2)
+                m->period = m->nominal;
+        }
+    }
+    m->last_hw = ts;
+    m->valid = 1;
+    m->hw_count++;
+}
+
+/* the next edge after what was last sent, 0 while we know nothing */
+static int64_t vsync_model_next(struct hwc_vsync_model *m)
+{
+    if (!m->valid)
+        return 0;
+    return (m->last_hw > m->last_sent ? m->last_hw : m->last_sent) + m->period;
+}
+
+static void vsync_model_reset(struct hwc_vsync_model *m)
+{
+    if (m->hw_count)
+        ALOGI("vsync: %u hw %u predicted, period %lld ns, jitter avg %lld max %lld ns",
+                m->hw_count, m->synth_count, m->period,
+                m->err_sum / m->hw_count, m->err_max);
+    m->valid = 0;
+    m->last_sent = 0;
+    m->hw_count = 0;
+    m->synth_count = 0;
+    m->err_sum = 0;
+    m->err_max = 0;
+}
+
+/* hand an edge to surfaceflinger, once per edge whoever saw it first */
+static void vsync_deliver(hwc_context_t *ctx, int64_t ts, bool synth)
+{
+    struct hwc_vsync_model *m = &ctx->vsync;
+
+    if (m->last_sent && ts - m->last_sent < m->period / 2)
+        return;
+    m->last_sent = ts;
+    if (synth)
+        m->synth_count++;
 
     if(!ctx->procs || !ctx->procs->vsync)
        return;
+    ctx->procs->vsync(ctx->procs, 0, ts);
+}
+
+static int64_t parse_vsync_uevent(const char *buff, int len)
+{
+    uint64_t timestamp = 0;
+    const char *s = buff;
 
     s += strlen(s) + 1;
 
@@ -549,34 +1308,43 @@ void handle_vsync_uevent(hwc_context_t *ctx, const char *buff, int len)
             break;
     }
 
-    ctx->procs->vsync(ctx->procs, 0, timestamp);
+    return timestamp;
 }
 
 static void *hwc_vsync_thread(void *data)
 {
     hwc_context_t *ctx = (hwc_context_t *)(data);
+    struct hwc_vsync_model *m = &ctx->vsync;
 #ifdef VSYNC_IOCTL
     uint64_t timestamp = 0;
 #else
+    static const char vsync_dev[] = "change@/devices/platform/s3cfb";
     char uevent_desc[4096];
+    struct pollfd fds;
     memset(uevent_desc, 0, sizeof(uevent_desc));
 #endif
 
-    setpriority(PRIO_PROCESS, 0, HAL_PRIORITY_URGENT_DISPLAY);
+    sec_thread_set_role(SEC_THREAD_ROLE_DISPLAY);
 
 #ifndef VSYNC_IOCTL
     uevent_init();
+    fds.fd = uevent_get_fd();
+    fds.events = POLLIN;
 #endif
     while(true) {
-#ifdef VSYNC_IOCTL
         // Only continue if hwc_eventControl is enabled, otherwise
         // just sit here and wait until it is.  This stops the code
         // from constantly looking for the VSYNC event with the screen
         // turned off.
         pthread_mutex_lock(&vsync_mutex);
-        if(!vsync_enable) pthread_cond_wait(&vsync_condition, &vsync_mutex);
+        if(!vsync_enable) {
+            vsync_model_reset(m);
+            while(!vsync_enable)
+                pthread_cond_wait(&vsync_condition, &vsync_mutex);
+        }
         pthread_mutex_unlock(&vsync_mutex);
 
+#ifdef VSYNC_IOCTL
         timestamp = 0;          // Reset the timestamp value
 
         // S3CFB_WAIT_FOR_VSYNC is a custom IOCTL I added to wait for
@@ -584,17 +1352,44 @@ static void *hwc_vsync_thread(void *data)
         // originally being communicated via a uevent.  The uevent was
         // spamming the UEventObserver and events/0 process with more
         // information than this device could really deal with every 18ms
+        // The ioctl can't time out, so the model only keeps statistics.
         int res = ioctl(ctx->global_lcd_win.fd, S3CFB_WAIT_FOR_VSYNC, &timestamp);
         if(res > 0) {
-            if(!ctx->procs || !ctx->procs->vsync) continue;
-            ctx->procs->vsync(ctx->procs, 0, timestamp);
+            vsync_model_update(m, timestamp);
+            vsync_deliver(ctx, timestamp, false);
         }
 #else
+        // Wait for the uevent until a little after the predicted edge,
+        // then stand in for it. Surfaceflinger gets the edge whichever
+        // comes first.
+        int timeout = -1;
+        int64_t next = vsync_model_next(m);
+        if (next) {
+            int64_t wait = next + HWC_VSYNC_LATE_NS - hwc_now();
+            timeout = wait > 0 ? (int)((wait + 999999) / 1000000) : 0;
+        }
+
+        int ret = poll(&fds, 1, timeout);
+        if (ret == 0) {
+            vsync_deliver(ctx, next, true);
+            continue;
+        }
+        if (ret < 0 || !(fds.revents & POLLIN))
+            continue;
+
         int len = uevent_next_event(uevent_desc, sizeof(uevent_desc) - 2);
 
-        bool vsync = !strcmp(uevent_desc, "change@/devices/platform/s3cfb");
-        if(vsync)
-            handle_vsync_uevent(ctx, uevent_desc, len);
+        // only the first string names the device, skip the rest fast
+        if (len < (int)sizeof(vsync_dev) ||
+            memcmp(uevent_desc, vsync_dev, sizeof(vsync_dev)))
+            continue;
+
+        // events queued while disabled are stale
+        int64_t ts = parse_vsync_uevent(uevent_desc, len);
+        if (ts && ts > hwc_now() - 2 * m->nominal) {
+            vsync_model_update(m, ts);
+            vsync_deliver(ctx, ts, false);
+        }
 #endif
     }
 
@@ -608,6 +1403,12 @@ static int hwc_device_close(struct hw_device_t *dev)
     int i;
 
     if (ctx) {
+#if defined(BOARD_HAVE_HDMI)
+        hwc_hdmi_stop(ctx);
+        if (ctx->hdmi_cable_fd >= 0)
+            close(ctx->hdmi_cable_fd);
+#endif
+        hwc_fimc_wait(ctx);
         fimc_close(&ctx->fimc);
 
         if (window_close(&ctx->global_lcd_win) < 0) {
@@ -615,7 +1416,7 @@ static int hwc_device_close(struct hw_device_t *dev)
             ret = -1;
         }
 
-        for (i = 0; i < NUM_OF_WIN; i++) {
+        for (i = 0; i < (int)ctx->num_of_win; i++) {
             if (window_close(&ctx->win[i]) < 0) {
                 ALOGE("%s::window_close() fail", __func__);
                 ret = -1;
@@ -629,6 +1430,90 @@ static int hwc_device_close(struct hw_device_t *dev)
     return ret;
 }
 
+static void dump_append(char *buff, int buff_len, int *pos, const char *fmt, ...)
+{
+    va_list args;
+
+    if (*pos >= buff_len - 1)
+        return;
+    va_start(args, fmt);
+    int n = vsnprintf(buff + *pos, buff_len - *pos, fmt, args);
+    va_end(args);
+    if (n > 0)
+        *pos = SEC_MIN(*pos + n, buff_len - 1);
+}
+
+static void dump_time_stats(char *buff, int buff_len, int *pos,
+                            const char *name, const struct hwc_time_stats *t)
+{
+    dump_append(buff, buff_len, pos, "  %-5s %u calls, avg %lld us, max %lld us, "
+            "ms <1 %u <2 %u <4 %u <8 %u <16 %u <32 %u <64 %u >=64 %u\n",
+            name, t->count,
+            t->count ? t->total_ns / t->count / 1000 : 0LL, t->max_ns / 1000,
+            t->hist[0], t->hist[1], t->hist[2], t->hist[3], t->hist[4],
+            t->hist[5], t->hist[6], t->hist[7]);
+}
+
+static void hwc_dump(struct hwc_composer_device* dev, char *buff, int buff_len)
+{
+    struct hwc_context_t* ctx = (struct hwc_context_t*)dev;
+    static const char * const reason_names[HWC_FB_REASON_CNT] = {
+        "skip", "no handle", "size", "scale", "format", "not contig",
+        "blending", "planner",
+    };
+    struct hwc_stats stats;
+    int pos = 0;
+
+    if (buff_len <= 0)
+        return;
+    buff[0] = '\0';
+
+    /* the fimc jobs update their part under the lock */
+    pthread_mutex_lock(&ctx->fimc_lock);
+    stats = ctx->stats;
+    pthread_mutex_unlock(&ctx->fimc_lock);
+
+    dump_append(buff, buff_len, &pos,
+            "  %u windows, %u frames, %u overlay of %u layers (%u%%)\n",
+            ctx->num_of_win, stats.frames, stats.overlay_layers, stats.layers,
+            stats.layers ? stats.overlay_layers * 100 / stats.layers : 0);
+    dump_append(buff, buff_len, &pos, "  framebuffer fallbacks:");
+    for (int k = 0; k < HWC_FB_REASON_CNT; k++)
+        dump_append(buff, buff_len, &pos, " %s %u", reason_names[k],
+                stats.fb_reason[k]);
+    dump_append(buff, buff_len, &pos, "\n");
+    dump_append(buff, buff_len, &pos,
+            "  fimc jobs %u, unchanged %u, errors %u, pans %u\n",
+            stats.fimc.count, stats.fimc_skipped, stats.fimc_errors, stats.pans);
+    dump_time_stats(buff, buff_len, &pos, "fimc", &stats.fimc);
+    struct fimc_broker_stats node;
+    if (fimc_broker_get_stats(&ctx->fimc, &node) == 0)
+        dump_append(buff, buff_len, &pos,
+                "  fimc node: display %u, background %u, late %u, "
+                "contended %u, queued max %lld ns\n",
+                node.jobs[FIMC_JOB_DISPLAY], node.jobs[FIMC_JOB_BACKGROUND],
+                node.missed, node.contended, node.wait_max_ns);
+    dump_time_stats(buff, buff_len, &pos, "swap", &stats.swap);
+    /* capture to pan, the frame shows at the vsync after */
+    if (stats.latency.count)
+        dump_time_stats(buff, buff_len, &pos, "lat", &stats.latency);
+    dump_append(buff, buff_len, &pos,
+            "  swaps skipped %u, damage %llu%% of the screen per swap%s\n",
+            stats.swaps_skipped,
+            stats.swap.count && ctx->lcd_info.xres && ctx->lcd_info.yres ?
+                stats.damage_pixels * 100 / stats.swap.count /
+                (ctx->lcd_info.xres * ctx->lcd_info.yres) : 0ULL,
+            ctx->set_swap_rect ? ", partial updates" : "");
+    dump_append(buff, buff_len, &pos, "  vsync period %lld ns\n",
+            ctx->vsync.period);
+#if defined(BOARD_HAVE_HDMI)
+    dump_append(buff, buff_len, &pos,
+            "  hdmi only frames %u%s, tv frames dropped %u\n",
+            stats.hdmi_only_frames, ctx->hdmi_only ? " (now)" : "",
+            ctx->hdmi_dropped);
+#endif
+}
+
 static const struct hwc_methods hwc_methods = {
     eventControl: hwc_eventControl
 };
@@ -639,10 +1524,13 @@ static int hwc_device_open(const struct hw_module_t* module, const char* name,
     int status = 0;
     int err;
     struct hwc_win_info_t *win;
+    struct sec_startup startup;
 #if defined(BOARD_HAVE_HDMI)
     struct hw_module_t    *hdmi_module;
 #endif
 
+    sec_startup_begin(&startup, "hwcomposer");
+
     if(hw_get_module(GRALLOC_HARDWARE_MODULE_ID,
                 (const hw_module_t**)&gpsGrallocModule))
         return -EINVAL;
@@ -652,12 +1540,16 @@ static int hwc_device_open(const struct hw_module_t* module, const char* name,
 
     if (strcmp(name, HWC_HARDWARE_COMPOSER))
         return -EINVAL;
+    sec_startup_phase(&startup, "gralloc");
 
     struct hwc_context_t *dev;
     dev = (hwc_context_t*)malloc(sizeof(*dev));
 
     /* initialize our state here */
     memset(dev, 0, sizeof(*dev));
+    pthread_mutex_init(&dev->fimc_lock, NULL);
+    pthread_cond_init(&dev->fimc_done_cond, NULL);
+    dev->latency_probe = sec_latency_enabled();
 
     /* initialize the procs */
     dev->device.common.tag = HARDWARE_DEVICE_TAG;
@@ -669,6 +1561,7 @@ static int hwc_device_open(const struct hw_module_t* module, const char* name,
     dev->device.set = hwc_set;
     dev->device.registerProcs = hwc_registerProcs;
     dev->device.query = hwc_query;
+    dev->device.dump = hwc_dump;
     dev->device.methods = &hwc_methods;
 
     *device = &dev->device.common;
@@ -683,29 +1576,59 @@ static int hwc_device_open(const struct hw_module_t* module, const char* name,
                 (hw_device_t **)&dev->hdmi);
         if(ret < 0) {
             ALOGE("%s:: Can't open hdmi device : %s", __func__, strerror(ret));
+            dev->hdmi = NULL;
         }
     }
+
+    dev->hdmi_cable_fd = -1;
+    if (dev->hdmi) {
+        /* the state SecHDMI connects on, see hwc_hdmi_only() */
+        dev->hdmi_cable_fd = open(SEC_TVOUT_SWITCH_STATE, O_RDONLY);
+        pthread_mutex_init(&dev->hdmi_lock, NULL);
+        pthread_cond_init(&dev->hdmi_cond, NULL);
+        err = pthread_create(&dev->hdmi_thread, NULL, hwc_hdmi_thread, dev);
+        if (err)
+            ALOGE("%s::pthread_create() failed : %s, no hdmi", __func__,
+                    strerror(err));
+        else
+            dev->hdmi_thread_running = 1;
+    }
+    sec_startup_phase(&startup, "hdmi");
 #endif
 
     /* initializing */
     memset(&(dev->fimc), 0, sizeof(s5p_fimc_t));
     dev->fimc.dev_fd = -1;
 
-    /* open WIN0 & WIN1 here */
+    /* open WIN0 & WIN1 here, only the first one is mandatory */
+    for (int i = 0; i < NUM_OF_WIN; i++)
+        dev->win[i].fd = -1;
+    dev->global_lcd_win.fd = -1;
+
     for (int i = 0; i < NUM_OF_WIN; i++) {
         if (window_open(&(dev->win[i]), i) < 0) {
-             ALOGE("%s:: Failed to open window %d device ", __func__, i);
-             status = -EINVAL;
-             goto err;
+            if (i == 0) {
+                ALOGE("%s:: Failed to open window %d device ", __func__, i);
+                status = -EINVAL;
+                goto err;
+            }
+            ALOGW("%s:: window %d not available, using %d overlays",
+                    __func__, i, i);
+            break;
         }
+        dev->num_of_win++;
     }
 
+    sec_startup_phase(&startup, "windows");
+
     /* open window 2, used to query global LCD info */
     if (window_open(&dev->global_lcd_win, 2) < 0) {
         ALOGE("%s:: Failed to open window 2 device ", __func__);
         status = -EINVAL;
         goto err;
     }
+    /* it is the framebuffer, on from boot */
+    dev->global_lcd_win.power_state = 1;
 
     /* get default window config */
     if (window_get_global_lcd_info(dev) < 0) {
@@ -718,11 +1641,21 @@ static int hwc_device_open(const struct hw_module_t* module, const char* name,
     dev->lcd_info.yres_virtual = dev->lcd_info.yres * NUM_OF_WIN_BUF;
 
     /* initialize the window context */
-    for (int i = 0; i < NUM_OF_WIN; i++) {
+    for (unsigned int i = 0; i < dev->num_of_win; i++) {
         win = &dev->win[i];
         memcpy(&win->lcd_info, &dev->lcd_info, sizeof(struct fb_var_screeninfo));
         memcpy(&win->var_info, &dev->lcd_info, sizeof(struct fb_var_screeninfo));
 
+        win->zorder = i;
+        switch (win->lcd_info.bits_per_pixel) {
+        case 32:
+            win->format = HAL_PIXEL_FORMAT_RGBX_8888;
+            break;
+        default:
+            win->format = HAL_PIXEL_FORMAT_RGB_565;
+            break;
+        }
+
         win->rect_info.x = 0;
         win->rect_info.y = 0;
         win->rect_info.w = win->var_info.xres;
@@ -746,8 +1679,15 @@ static int hwc_device_open(const struct hw_module_t* module, const char* name,
 
         if (!win->fix_info.smem_start){
             ALOGE("%s:: win-%d failed to get the reserved memory", __func__, i);
-            status = -EINVAL;
-            goto err;
+            if (i == 0) {
+                status = -EINVAL;
+                goto err;
+            }
+            /* the windows above this one can't be used either */
+            for (unsigned int j = i; j < dev->num_of_win; j++)
+                window_close(&dev->win[j]);
+            dev->num_of_win = i;
+            break;
         }
 
         for (int j = 0; j < NUM_OF_WIN_BUF; j++) {
@@ -755,6 +1695,7 @@ static int hwc_device_open(const struct hw_module_t* module, const char* name,
             ALOGI("%s::win-%d add[%d] %x ", __func__, i, j, win->addr[j]);
         }
     }
+    sec_startup_phase(&startup, "lcd");
 
     /* open pp */
     if (fimc_open(&dev->fimc, "/dev/video1") < 0) {
@@ -762,6 +1703,14 @@ static int hwc_device_open(const struct hw_module_t* module, const char* name,
         status = -EINVAL;
         goto err;
     }
+    sec_startup_phase(&startup, "fimc");
+
+    dev->vsync.nominal = 1000000000LL / 60;
+    if (gpsGrallocModule->psFrameBufferDevice &&
+        gpsGrallocModule->psFrameBufferDevice->base.fps > 0)
+        dev->vsync.nominal = (int64_t)(1000000000.0 /
+                gpsGrallocModule->psFrameBufferDevice->base.fps);
+    dev->vsync.period = dev->vsync.nominal;
 
     err = pthread_create(&dev->vsync_thread, NULL, hwc_vsync_thread, dev);
     if (err) {
@@ -770,20 +1719,28 @@ static int hwc_device_open(const struct hw_module_t* module, const char* name,
         goto err;
     }
 
+    sec_startup_phase(&startup, "vsync");
+
     ALOGD("%s:: success\n", __func__);
+    sec_startup_end(&startup, 0);
 
     return 0;
 
 err:
+#if defined(BOARD_HAVE_HDMI)
+    hwc_hdmi_stop(dev);
+#endif
+    hwc_fimc_wait(dev);
     fimc_close(&dev->fimc);
 
     if (window_close(&dev->global_lcd_win) < 0)
         ALOGE("%s::window_close() fail", __func__);
 
-    for (int i = 0; i < NUM_OF_WIN; i++) {
+    for (unsigned int i = 0; i < dev->num_of_win; i++) {
         if (window_close(&dev->win[i]) < 0)
             ALOGE("%s::window_close() fail", __func__);
     }
 
+    sec_startup_end(&startup, status);
     return status;
 }
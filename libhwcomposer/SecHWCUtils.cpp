@@ -89,6 +89,11 @@ int window_set_pos(struct hwc_win_info_t *win)
     win->var_info.xres = win->rect_info.w;
     win->var_info.yres = win->rect_info.h;
 
+    /* no transp bits puts the window in plane blending, fully opaque: what
+     * the fimc writes has no usable alpha, whatever the layer blending */
+    win->var_info.transp.offset = 0;
+    win->var_info.transp.length = 0;
+
     win->var_info.activate &= ~FB_ACTIVATE_MASK;
     win->var_info.activate |= FB_ACTIVATE_FORCE;
 
@@ -125,15 +130,15 @@ error:
     return -1;
 }
 
-int window_pan_display(struct hwc_win_info_t *win)
+int window_pan_display(struct hwc_win_info_t *win, int buf_index)
 {
     struct fb_var_screeninfo *lcd_info = &(win->lcd_info);
 
-    lcd_info->yoffset = lcd_info->yres * win->buf_index;
+    lcd_info->yoffset = lcd_info->yres * buf_index;
 
     if (ioctl(win->fd, FBIOPAN_DISPLAY, lcd_info) < 0) {
         ALOGE("%s::FBIOPAN_DISPLAY(%d / %d / %d) fail(%s)",
-            	__func__, lcd_info->yres, win->buf_index, lcd_info->yres_virtual,
+            	__func__, lcd_info->yres, buf_index, lcd_info->yres_virtual,
             strerror(errno));
         return -1;
     }
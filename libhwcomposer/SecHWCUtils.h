@@ -29,11 +29,14 @@
 #include <errno.h>
 #include <cutils/log.h>
 #include <stdlib.h>
+#include <pthread.h>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
 #include "linux/fb.h"
 #include <linux/videodev.h>
 
+#include <EGL/egl.h>
+
 #include <hardware/gralloc.h>
 #include <hardware/hardware.h>
 #include <hardware/hwcomposer.h>
@@ -41,17 +44,33 @@
 #include <hardware/hdmi.h>
 #endif
 
-#include "fimc.h"
+#include "fimc_broker.h"
 #include "sec_lcd.h"
 #include "hal_public.h"
 
 #define GRALLOC_USAGE_PHYS_CONTIG GRALLOC_USAGE_PRIVATE_1
 
-#define NUM_OF_WIN          (1)
+/* fimd windows 0 and 1, both under the framebuffer in window 2 */
+#define NUM_OF_WIN          (2)
 #define NUM_OF_WIN_BUF      (3)
 #define NUM_OF_MEM_OBJ      (1)
 #define MAX_NUM_PLANES      (3)
 
+/* composition planner: overlay candidates looked at per frame */
+#define HWC_MAX_CANDIDATES  (8)
+/* pixels the fimc may read plus write per frame, in screens */
+#define HWC_FIMC_BUDGET     (3)
+/* gpu cost of a layer only a window can show, any plan with a window wins */
+#define HWC_GPU_COST_NO_GPU (1 << 24)
+/* software vsync: how late the hardware event may be before we stand in */
+#define HWC_VSYNC_LATE_NS   (2000000LL)
+/* weight 1/n of a new period sample in the estimate */
+#define HWC_VSYNC_FILTER    (16)
+/* framebuffer layers whose buffers are followed for damage */
+#define HWC_MAX_DAMAGE_LAYERS (32)
+/* gralloc handles whose physical addresses are kept, a few queues' worth */
+#define HWC_PHY_CACHE_SIZE  (8)
+
 struct hwc_win_info_t {
     int        fd;
     int        size;
@@ -62,9 +81,17 @@ struct hwc_win_info_t {
     int        blending;
     int        layer_index;
     uint32_t   layer_prev_buf;
+    /* what the window shows, to skip fimc when the layer didn't change */
+    hwc_rect_t layer_prev_crop;
+    hwc_rect_t layer_prev_frame;
+    uint32_t   layer_prev_transform;
+    unsigned int layer_prev_phy[MAX_NUM_PLANES];
     int        set_win_flag;
     int        status;
     int        vsync;
+    /* fimd blends higher windows over lower ones */
+    int        zorder;
+    int        format;
 
     struct fb_fix_screeninfo fix_info;
     struct fb_var_screeninfo var_info;
@@ -76,21 +103,154 @@ enum {
     HWC_WIN_RESERVED,
 };
 
+/* one fimc pass into a window back buffer, run by the fimc broker */
+struct hwc_fimc_job {
+    struct fimc_job        base;
+    struct hwc_context_t  *ctx;
+    struct hwc_win_info_t *win;
+    int             buf_index;
+    int             set_pos;
+    /* of the layer's latency stamp, 0 without one */
+    int64_t         capture_ns;
+    /* dup of the source handle, keeps the buffer alive until the job is
+     * done even if surfaceflinger frees it after hwc_set returns */
+    native_handle_t *src_ref;
+};
+
+/* why a layer stayed in the framebuffer */
+enum {
+    HWC_FB_SKIP = 0,
+    HWC_FB_NO_HANDLE,
+    HWC_FB_SIZE,
+    HWC_FB_SCALE,
+    HWC_FB_FORMAT,
+    HWC_FB_NOT_CONTIG,
+    HWC_FB_BLENDING,
+    HWC_FB_PLANNER,
+    HWC_FB_REASON_CNT,
+};
+
+/* time histogram buckets: < 1, 2, 4, 8, 16, 32, 64 ms and the rest */
+#define HWC_TIME_HIST_CNT   (8)
+
+struct hwc_time_stats {
+    unsigned int    count;
+    unsigned int    hist[HWC_TIME_HIST_CNT];
+    int64_t         total_ns;
+    int64_t         max_ns;
+};
+
+struct hwc_stats {
+    unsigned int    frames;
+    unsigned int    layers;
+    unsigned int    overlay_layers;
+    unsigned int    fb_reason[HWC_FB_REASON_CNT];
+    /* reasons of the current geometry, added to fb_reason every frame */
+    unsigned int    frame_reason[HWC_FB_REASON_CNT];
+    unsigned int    fimc_skipped;
+    unsigned int    fimc_errors;
+    unsigned int    pans;
+    struct hwc_time_stats fimc;
+    struct hwc_time_stats swap;
+    /* camera capture to the pan of the overlay, with debug.sec.latency */
+    struct hwc_time_stats latency;
+    unsigned int    swaps_skipped;
+    /* framebuffer pixels damaged over all swaps */
+    unsigned long long damage_pixels;
+    /* frames the video only went to the tv */
+    unsigned int    hdmi_only_frames;
+};
+
+/* physical planes of a gralloc buffer, the stamp tells a recycled handle */
+struct hwc_phy_cache_entry {
+    buffer_handle_t     handle;
+    unsigned long long  stamp;
+    unsigned int        phy[MAX_NUM_PLANES];
+    unsigned int        last_use;
+};
+
+/* vsync period and phase estimated from the hardware timestamps */
+struct hwc_vsync_model {
+    int64_t         nominal;
+    int64_t         period;
+    int64_t         last_hw;
+    int64_t         last_sent;
+    int             valid;
+
+    /* since the last enable */
+    unsigned int    hw_count;
+    unsigned int    synth_count;
+    int64_t         err_sum;
+    int64_t         err_max;
+};
+
+#if defined(BOARD_HAVE_HDMI)
+/* arguments of one hdmi->blit */
+struct hwc_hdmi_blit {
+    uint32_t        w;
+    uint32_t        h;
+    uint32_t        format;
+    unsigned int    y;
+    unsigned int    cb;
+    unsigned int    cr;
+    int             num_of_hwc_layer;
+};
+#endif
+
 struct hwc_context_t {
     hwc_composer_device_t     device;
 
     /* our private state goes below here */
     struct hwc_win_info_t     win[NUM_OF_WIN];
+    unsigned int              num_of_win;
     struct hwc_win_info_t     global_lcd_win;
     struct fb_var_screeninfo  lcd_info;
     s5p_fimc_t                fimc;
     hwc_procs_t               *procs;
     pthread_t                 vsync_thread;
+    struct hwc_vsync_model    vsync;
+
+    /* jobs of the last hwc_set, the windows belong to the fimc broker
+     * until fimc_busy, the jobs not done yet, drops to 0 */
+    pthread_mutex_t           fimc_lock;
+    pthread_cond_t            fimc_done_cond;
+    struct hwc_fimc_job       fimc_job[NUM_OF_WIN];
+    unsigned int              num_of_fimc_job;
+    unsigned int              fimc_busy;
     unsigned int              num_of_fb_layer;
+    struct hwc_phy_cache_entry phy_cache[HWC_PHY_CACHE_SIZE];
+    unsigned int              phy_cache_clock;
+    struct hwc_stats          stats;
+    int                       latency_probe;
+
+    /* buffers the framebuffer layers showed in the last swap */
+    buffer_handle_t           fb_prev_handle[HWC_MAX_DAMAGE_LAYERS];
+    int                       swap_rect_checked;
+    EGLBoolean                (*set_swap_rect)(EGLDisplay dpy, EGLSurface draw,
+                                               EGLint left, EGLint top,
+                                               EGLint width, EGLint height);
     unsigned int              num_of_hwc_layer;
-    unsigned int              num_of_fb_layer_prev;
 #if defined(BOARD_HAVE_HDMI)
     hdmi_device_t*            hdmi;
+
+    /* depth one mailbox for the hdmi thread, a newer frame replaces the
+     * one not taken yet */
+    pthread_t                 hdmi_thread;
+    pthread_mutex_t           hdmi_lock;
+    pthread_cond_t            hdmi_cond;
+    struct hwc_hdmi_blit      hdmi_mail;
+    int                       hdmi_mail_full;
+    int                       hdmi_exit;
+    int                       hdmi_thread_running;
+    unsigned int              hdmi_dropped;
+
+    /* presentation mode, polled by hwc_hdmi_only() */
+    int                       hdmi_cable_fd;
+    int64_t                   hdmi_poll_time;
+    int                       hdmi_only_wanted;
+    int                       hdmi_cable;
+    /* the last frame skipped the local windows */
+    int                       hdmi_only;
 #endif
 };
 
@@ -98,7 +258,7 @@ int window_open(struct hwc_win_info_t *win, int id);
 int window_close(struct hwc_win_info_t *win);
 int window_set_pos(struct hwc_win_info_t *win);
 int window_get_info(struct hwc_win_info_t *win);
-int window_pan_display(struct hwc_win_info_t *win);
+int window_pan_display(struct hwc_win_info_t *win, int buf_index);
 int window_show(struct hwc_win_info_t *win);
 int window_hide(struct hwc_win_info_t *win);
 int window_get_global_lcd_info(struct hwc_context_t *ctx);
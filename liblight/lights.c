@@ -23,38 +23,77 @@
 #include <fcntl.h>
 #include <pthread.h>
 #include <sys/ioctl.h>
+#include <unistd.h>
 #include <sys/types.h>
 #include <hardware/lights.h>
 
 static pthread_once_t g_init = PTHREAD_ONCE_INIT;
 static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
 
-char const *const LCD_FILE = "/sys/class/backlight/s5p_bl/brightness";
-char const *const LED_FILE = "/sys/class/misc/notification/led";
+/* A sysfs file kept open, along with the last value written to it. */
+struct light_file {
+	char const *path;
+	int fd;
+	int value;
+	int warned;
+};
+
+static struct light_file g_lcd = {
+	"/sys/class/backlight/s5p_bl/brightness", -1, -1, 0
+};
+static struct light_file g_led = {
+	"/sys/class/misc/notification/led", -1, -1, 0
+};
 
-static int write_int(char const *path, int value)
+static void init_g_lock(void)
 {
-	int fd;
-	static int already_warned;
-
-	already_warned = 0;
-
-	ALOGV("write_int: path %s, value %d", path, value);
-	fd = open(path, O_RDWR);
-
-	if (fd >= 0) {
-		char buffer[20];
-		int bytes = sprintf(buffer, "%d\n", value);
-		int amt = write(fd, buffer, bytes);
-		close(fd);
-		return amt == -1 ? -errno : 0;
-	} else {
-		if (already_warned == 0) {
-			ALOGE("write_int failed to open %s\n", path);
-			already_warned = 1;
+	pthread_mutex_init(&g_lock, NULL);
+}
+
+/* Called with g_lock held. */
+static int open_light_file(struct light_file *file)
+{
+	if (file->fd >= 0)
+		return 0;
+
+	file->fd = open(file->path, O_RDWR);
+	if (file->fd < 0) {
+		if (!file->warned) {
+			ALOGE("write_int failed to open %s\n", file->path);
+			file->warned = 1;
 		}
 		return -errno;
 	}
+
+	return 0;
+}
+
+/*
+ * Called with g_lock held. The brightness animations of the power manager
+ * send the same value several times in a row, only changes reach sysfs.
+ */
+static int write_int(struct light_file *file, int value)
+{
+	char buffer[20];
+	int bytes;
+	int amt;
+	int err;
+
+	if (value == file->value)
+		return 0;
+
+	err = open_light_file(file);
+	if (err < 0)
+		return err;
+
+	ALOGV("write_int: path %s, value %d", file->path, value);
+	bytes = sprintf(buffer, "%d\n", value);
+	amt = pwrite(file->fd, buffer, bytes, 0);
+	if (amt == -1)
+		return -errno;
+
+	file->value = value;
+	return 0;
 }
 
 static int rgb_to_brightness(struct light_state_t const *state)
@@ -80,7 +119,7 @@ static int set_light_notifications(struct light_device_t* dev,
 		v = 0;
 
 	ALOGI("color %u fm %u status %u is lit %u brightness", state->color, state->flashMode, v, (state->color & 0x00ffffff), brightness);
-	ret = write_int(LED_FILE, v);
+	ret = write_int(&g_led, v);
 	pthread_mutex_unlock(&g_lock);
 	return ret;
 }
@@ -92,7 +131,7 @@ static int set_light_backlight(struct light_device_t *dev,
 	int brightness = rgb_to_brightness(state);
 
 	pthread_mutex_lock(&g_lock);
-	err = write_int(LCD_FILE, brightness);
+	err = write_int(&g_lcd, brightness);
 
 	pthread_mutex_unlock(&g_lock);
 	return err;
@@ -122,7 +161,11 @@ static int open_lights(const struct hw_module_t *module, char const *name,
 	else
 		return -EINVAL;
 
-	pthread_mutex_init(&g_lock, NULL);
+	pthread_once(&g_init, init_g_lock);
+
+	pthread_mutex_lock(&g_lock);
+	open_light_file(set_light == set_light_backlight ? &g_lcd : &g_led);
+	pthread_mutex_unlock(&g_lock);
 
 	struct light_device_t *dev = malloc(sizeof(struct light_device_t));
 	memset(dev, 0, sizeof(*dev));
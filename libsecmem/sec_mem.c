@@ -0,0 +1,207 @@
+/*
+ * Copyright@ Samsung Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+
+#include <cutils/log.h>
+
+#include "s3c_mem.h"
+#include "sec_mem.h"
+
+#define SEC_MEM_PAGE_SIZE   (4096)
+
+/* what the pool keeps for the next session, a 720p record set fits */
+#define SEC_MEM_POOL_CNT    (8)
+#define SEC_MEM_POOL_BYTES  (8 * 1024 * 1024)
+
+static pthread_mutex_t    g_lock = PTHREAD_MUTEX_INITIALIZER;
+static int                g_fd = -1;
+static struct sec_mem_buf g_pool[SEC_MEM_POOL_CNT];
+static int                g_pool_cnt;
+static int                g_pool_bytes;
+
+static int sec_mem_fd_locked(void)
+{
+    if (g_fd < 0) {
+        g_fd = open(SEC_MEM_DEV, O_RDWR);
+        if (g_fd < 0)
+            ALOGE("%s::open(%s) fail : %s", __func__, SEC_MEM_DEV, strerror(errno));
+    }
+    return g_fd;
+}
+
+static void sec_mem_release_locked(struct sec_mem_buf *buf)
+{
+    struct s3c_mem_alloc mem;
+
+    mem.size = buf->size;
+    mem.vir_addr = (unsigned int)buf->virt;
+    mem.phy_addr = buf->phys;
+    if (ioctl(buf->fd, buf->imported ? S3C_MEM_SHARE_FREE : S3C_MEM_FREE, &mem) < 0)
+        ALOGE("%s::free of %d bytes at 0x%x fail : %s", __func__,
+                buf->size, buf->phys, strerror(errno));
+}
+
+/* the smallest pooled buffer that fits without wasting half of it */
+static int sec_mem_pool_take_locked(int size, int flags, struct sec_mem_buf *buf)
+{
+    int best = -1;
+    int i;
+
+    for (i = 0; i < g_pool_cnt; i++) {
+        if (g_pool[i].flags != flags ||
+            g_pool[i].size < size || g_pool[i].size > size * 2)
+            continue;
+        if (best < 0 || g_pool[i].size < g_pool[best].size)
+            best = i;
+    }
+    if (best < 0)
+        return -1;
+
+    *buf = g_pool[best];
+    g_pool_bytes -= buf->size;
+    g_pool[best] = g_pool[--g_pool_cnt];
+    return 0;
+}
+
+int sec_mem_alloc(int size, int flags, struct sec_mem_buf *buf)
+{
+    struct s3c_mem_alloc mem;
+    int ret = 0;
+
+    memset(buf, 0, sizeof(*buf));
+    buf->fd = -1;
+    if (size <= 0)
+        return -EINVAL;
+    size = (size + SEC_MEM_PAGE_SIZE - 1) & ~(SEC_MEM_PAGE_SIZE - 1);
+
+    pthread_mutex_lock(&g_lock);
+    if (sec_mem_pool_take_locked(size, flags, buf) == 0)
+        goto done;
+
+    if (sec_mem_fd_locked() < 0) {
+        ret = -ENODEV;
+        goto done;
+    }
+
+    memset(&mem, 0, sizeof(mem));
+    mem.size = size;
+    if (ioctl(g_fd, (flags & SEC_MEM_CACHED) ? S3C_MEM_CACHEABLE_ALLOC : S3C_MEM_ALLOC,
+              &mem) < 0) {
+        ret = -errno;
+        ALOGE("%s::alloc of %d bytes fail : %s", __func__, size, strerror(errno));
+        goto done;
+    }
+
+    buf->fd = g_fd;
+    buf->phys = mem.phy_addr;
+    buf->virt = (void *)mem.vir_addr;
+    buf->size = size;
+    buf->flags = flags;
+
+done:
+    pthread_mutex_unlock(&g_lock);
+    return ret;
+}
+
+int sec_mem_import(unsigned int phys, int size, struct sec_mem_buf *buf)
+{
+    struct s3c_mem_alloc mem;
+    int ret = 0;
+
+    memset(buf, 0, sizeof(*buf));
+    buf->fd = -1;
+    if (!phys || size <= 0)
+        return -EINVAL;
+    size = (size + SEC_MEM_PAGE_SIZE - 1) & ~(SEC_MEM_PAGE_SIZE - 1);
+
+    pthread_mutex_lock(&g_lock);
+    if (sec_mem_fd_locked() < 0) {
+        ret = -ENODEV;
+        goto done;
+    }
+
+    memset(&mem, 0, sizeof(mem));
+    mem.size = size;
+    mem.phy_addr = phys;
+    if (ioctl(g_fd, S3C_MEM_SHARE_ALLOC, &mem) < 0) {
+        ret = -errno;
+        ALOGE("%s::import of %d bytes at 0x%x fail : %s", __func__,
+                size, phys, strerror(errno));
+        goto done;
+    }
+
+    buf->fd = g_fd;
+    buf->phys = phys;
+    buf->virt = (void *)mem.vir_addr;
+    buf->size = size;
+    buf->imported = 1;
+
+done:
+    pthread_mutex_unlock(&g_lock);
+    return ret;
+}
+
+void sec_mem_free(struct sec_mem_buf *buf)
+{
+    if (buf->fd < 0)
+        return;
+
+    pthread_mutex_lock(&g_lock);
+    if (!buf->imported && g_pool_cnt < SEC_MEM_POOL_CNT &&
+        g_pool_bytes + buf->size <= SEC_MEM_POOL_BYTES) {
+        g_pool[g_pool_cnt++] = *buf;
+        g_pool_bytes += buf->size;
+    } else {
+        sec_mem_release_locked(buf);
+    }
+    pthread_mutex_unlock(&g_lock);
+
+    memset(buf, 0, sizeof(*buf));
+    buf->fd = -1;
+}
+
+int sec_mem_invalidate(struct sec_mem_buf *buf)
+{
+    struct s3c_mem_dma_param param;
+
+    if (buf->fd < 0)
+        return -EINVAL;
+    if (!(buf->flags & SEC_MEM_CACHED))
+        return 0;
+
+    memset(&param, 0, sizeof(param));
+    param.size = buf->size;
+    param.src_addr = (unsigned int)buf->virt;
+    param.dst_addr = buf->phys;
+    if (ioctl(buf->fd, S3C_MEM_CACHE_INV, &param) < 0)
+        return -errno;
+    return 0;
+}
+
+void sec_mem_trim(void)
+{
+    pthread_mutex_lock(&g_lock);
+    while (g_pool_cnt > 0)
+        sec_mem_release_locked(&g_pool[--g_pool_cnt]);
+    g_pool_bytes = 0;
+    pthread_mutex_unlock(&g_lock);
+}
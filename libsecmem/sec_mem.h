@@ -0,0 +1,67 @@
+/*
+ * Copyright@ Samsung Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _SEC_MEM_H_
+#define _SEC_MEM_H_
+
+/*
+ * Physically contiguous buffers from /dev/s3c-mem, allocated when they
+ * are needed instead of out of a reserved region. A buffer travels
+ * between HALs and processes as its phys address and size. The owner
+ * allocates it, users elsewhere import it to get their own mapping, and
+ * the owner frees it only after every import is released.
+ *
+ * Freed buffers stay in a small per process pool, so a session that
+ * allocates the same sizes again doesn't go back to the kernel.
+ */
+
+#define SEC_MEM_DEV         "/dev/s3c-mem"
+
+/* flags of sec_mem_alloc() */
+#define SEC_MEM_CACHED      (1 << 0)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct sec_mem_buf {
+    int           fd;       /* the s3c-mem node of this process */
+    unsigned int  phys;
+    void         *virt;
+    int           size;
+    int           flags;
+    int           imported;
+};
+
+int     sec_mem_alloc(int size, int flags, struct sec_mem_buf *buf);
+
+/* maps a buffer another HAL or process allocated */
+int     sec_mem_import(unsigned int phys, int size, struct sec_mem_buf *buf);
+
+/* gives an allocated buffer back to the pool, or drops an import */
+void    sec_mem_free(struct sec_mem_buf *buf);
+
+/* before the cpu reads what a device wrote into a cached buffer */
+int     sec_mem_invalidate(struct sec_mem_buf *buf);
+
+/* hands the pooled buffers back to the kernel */
+void    sec_mem_trim(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _SEC_MEM_H_
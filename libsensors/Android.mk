@@ -40,11 +40,16 @@ LOCAL_SRC_FILES := 			\
     Smb380Sensor.cpp                    \
     CompassSensor.cpp	                \
     OrientationSensor.cpp	        \
+    SensorFusion.cpp			\
     InputEventReader.cpp
 
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/../include
+
 LOCAL_SHARED_LIBRARIES := liblog libcutils libdl
 LOCAL_PRELINK_MODULE := false
 
 include $(BUILD_SHARED_LIBRARY)
 
+include $(call all-makefiles-under,$(LOCAL_PATH))
+
 endif
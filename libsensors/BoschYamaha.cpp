@@ -45,11 +45,18 @@ BoschYamaha::BoschYamaha()
 : SensorBase(NULL, NULL),
       //mEnabled(0),
       mPendingMask(0),
-      mInputReaderMagnetic(4),
-      mInputReaderAccel(4)
+      mInputReaderMagnetic(32),
+      mInputReaderAccel(32)
 {
 
     counterAccel = 0;
+    compassEnabled = 0;
+    mCompassEnableFd = -1;
+    accelEnabled = 0;
+    compassDataReady = 0;
+    accelDataReady = 0;
+    mSampleReady[Accelerometer] = false;
+    mSampleReady[MagneticField] = false;
 
     /* FIXME set input device name for magnetic sensor */
     data_name = "input0";
@@ -57,7 +64,7 @@ BoschYamaha::BoschYamaha()
 
 	
 	//Open Compass
-	if (data_compass_fd) {
+	if (data_compass_fd >= 0) {
         strcpy(input_sysfs_path, "/sys/class/input/");
         strcat(input_sysfs_path, input_name);
         strcat(input_sysfs_path, "/device/");
@@ -71,7 +78,7 @@ BoschYamaha::BoschYamaha()
     data_fd = openInput("SMB380-Sensor");
     
 		//Open Compass
-	if (data_fd) {
+	if (data_fd >= 0) {
         strcpy(input_accel_sysfs_path, "/sys/class/input/");
         strcat(input_accel_sysfs_path, data_accel_name);
         strcat(input_accel_sysfs_path, "/device/");
@@ -115,7 +122,27 @@ BoschYamaha::~BoschYamaha()
 	if(accelEnabled){
 		enable(Accelerometer, 0);
 	}
-	
+	if (mCompassEnableFd >= 0) {
+		close(mCompassEnableFd);
+	}
+	if (data_compass_fd >= 0) {
+		close(data_compass_fd);
+	}
+}
+
+int BoschYamaha::getFdCount() const
+{
+    return 2;
+}
+
+/* the accelerometer first, the compass second */
+int BoschYamaha::getPollFd(int index) const
+{
+    switch (index) {
+        case 0: return data_fd;
+        case 1: return data_compass_fd;
+    }
+    return -1;
 }
 
 int BoschYamaha::enable(int32_t handle, int en)
@@ -145,7 +172,7 @@ int BoschYamaha::enable(int32_t handle, int en)
 			int fd;
 			strcpy(&input_sysfs_path[input_sysfs_path_len], "enable");
 			LOGD("BoschYamaha::~enable Compass(0, %d) open %s",en,  input_sysfs_path);
-			fd = open(input_sysfs_path, O_RDWR);
+			fd = openControl(&mCompassEnableFd, input_sysfs_path);
 			if (fd >= 0) {
 				 LOGD("CompassSensor::~enable(0, %d) opened %s",en,  input_sysfs_path);
 				char buf[2];
@@ -156,8 +183,7 @@ int BoschYamaha::enable(int32_t handle, int en)
 				} else {
 					buf[0] = '0';
 				}
-				err = write(fd, buf, sizeof(buf));
-				close(fd);
+				err = pwrite(fd, buf, sizeof(buf), 0);
 				//mEnabled = flags;
 				compassEnabled = flags;
 				return 0;
@@ -174,7 +200,7 @@ int BoschYamaha::enable(int32_t handle, int en)
 			int fd;
 			strcpy(&input_accel_sysfs_path[input_accel_sysfs_path_len], "enable");
 			LOGD("BoschYamaha::~enable Accel(0, %d) open %s",en,  input_accel_sysfs_path);
-			fd = open(input_accel_sysfs_path, O_RDWR);
+			fd = openControl(&mEnableFd, input_accel_sysfs_path);
 			if (fd >= 0) {
 				 LOGD("CompassSensor::~enable(0, %d) opened %s",en,  input_accel_sysfs_path);
 				char buf[2];
@@ -188,9 +214,8 @@ int BoschYamaha::enable(int32_t handle, int en)
 					buf[0] = '0';
 				}
 				//if(counterAccel <= 1){
-					err = write(fd, buf, sizeof(buf));
+					err = pwrite(fd, buf, sizeof(buf), 0);
 				//}
-				close(fd);
 				//mEnabled = flags;
 				accelEnabled = flags;
 				return 0;
@@ -227,133 +252,129 @@ int BoschYamaha::update_delay()
 }
 
 
-bool BoschYamaha::hasPendingEvents() {
-
-    //LOGD("hasPendingEvents was called");
-	if(accelEnabled || compassEnabled){
-	    //LOGD("hasPendingEvents will return true");
-		return true;
-	}
-	else {
-		//LOGD("hasPendingEvents will return false");
-		return false;
-	}
+bool BoschYamaha::hasPendingEvents() const {
+    return mSampleReady[Accelerometer] || mSampleReady[MagneticField];
 }
 
+/*
+ * Parses the next whole sample of a chip from what its reader holds.
+ * Samples of a disabled chip are dropped, a sample cut short waits in
+ * the reader for the rest.
+ */
+bool BoschYamaha::nextSample(int what)
+{
+    InputEventCircularReader& reader =
+        (what == Accelerometer) ? mInputReaderAccel : mInputReaderMagnetic;
+    input_event const* event;
+
+    while (reader.readEvent(&event)) {
+        int type = event->type;
+        //Everything is ABS!
+        if (type == EV_ABS) {
+            float value = event->value;
+            if (what == Accelerometer) {
+                if (event->code == EVENT_TYPE_ACCEL_X) {
+                    mPendingEvents[Accelerometer].acceleration.x = value * CONVERT_A_X;
+                } else if (event->code == EVENT_TYPE_ACCEL_Y) {
+                    mPendingEvents[Accelerometer].acceleration.y = value * CONVERT_A_Y;
+                } else if (event->code == EVENT_TYPE_ACCEL_Z) {
+                    mPendingEvents[Accelerometer].acceleration.z = value * CONVERT_A_Z;
+                }
+            } else {
+                if (event->code == EVENT_TYPE_MAGV_X) {
+                    mPendingEvents[MagneticField].magnetic.x = value * CONVERT_M_X;
+                } else if (event->code == EVENT_TYPE_MAGV_Y) {
+                    mPendingEvents[MagneticField].magnetic.y = value * CONVERT_M_Y;
+                } else if (event->code == EVENT_TYPE_MAGV_Z) {
+                    mPendingEvents[MagneticField].magnetic.z = value * CONVERT_M_Z;
+                }
+            }
+        } else if (type == EV_SYN) {
+            mPendingEvents[what].timestamp = timevalToNano(event->time);
+            reader.next();
+            if ((what == Accelerometer) ? accelEnabled : compassEnabled)
+                return true;
+            continue;
+        } else {
+            LOGE("BoschYamaha: unknown event (type=%d, code=%d)", type, event->code);
+        }
+        reader.next();
+    }
+    return false;
+}
 
+void BoschYamaha::fetchSamples()
+{
+    if (!mSampleReady[Accelerometer])
+        mSampleReady[Accelerometer] = nextSample(Accelerometer);
+    if (!mSampleReady[MagneticField])
+        mSampleReady[MagneticField] = nextSample(MagneticField);
+}
 
 int BoschYamaha::readEvents(sensors_event_t* data, int count)
 {
     if (count < 1)
         return -EINVAL;
-		
 
-	int numEventReceived = 0;
-	
-	//LOGD("Sensor: Read events was called with count: %d", count);
-	
-	if(compassEnabled)
-	{
-		//LOGD("Sensor: Compass is enabled, going to take care of it, count: %d", count);
-		ssize_t n = mInputReaderMagnetic.fill(data_compass_fd);
-		if (n < 0)
-			return n;
-
-		input_event const* event;
-
-		while ( count  && mInputReaderMagnetic.readEvent(&event)) {
-			int type = event->type;       
-			//Everything is ABS!
-			if (type == EV_ABS) {
-				float value = event->value;
-					if (event->code == EVENT_TYPE_MAGV_X) {
-						mPendingEvents[MagneticField].magnetic.x = (value * CONVERT_M_X);
-					} else if (event->code == EVENT_TYPE_MAGV_Y) {
-						mPendingEvents[MagneticField].magnetic.y = (value * CONVERT_M_Y);
-					} else if (event->code == EVENT_TYPE_MAGV_Z) {
-						mPendingEvents[MagneticField].magnetic.z = (value * CONVERT_M_Z);
-					}
-			}
-			else if (type == EV_SYN) {
-				mPendingEvents[MagneticField].timestamp = timevalToNano(event->time);
-				if (compassEnabled) {
-					//LOGD("Sensor: Compass was enabled, made a read and received a Sync");
-					compassDataReady = 1;
-					compassLastRead[0] = mPendingEvents[MagneticField].magnetic.x;
-					compassLastRead[1] = mPendingEvents[MagneticField].magnetic.y;
-					compassLastRead[2] = mPendingEvents[MagneticField].magnetic.z;	
-					
-					*data++ = mPendingEvents[MagneticField];
-					count--;
-					numEventReceived++;
-				}
-			} else {
-				LOGE("BoschYamaha: unknown event (type=%d, code=%d)", type, event->code);
-				
-			}
-			mInputReaderMagnetic.next();
-		}
-	}
-	
-	//LOGD("Sensor: Compass read quited, count: %d", count);
-    
-	
-	if(accelEnabled)
-	{
-		//LOGD("Sensor: Accel is enabled, going to take care of it, count: %d", count);
-		
-		ssize_t n = mInputReaderAccel.fill(data_fd);
-		//LOGD("Sensor: Accel Input Reader was filled up: %d", count);
-		if (n < 0)
-			return n;
-			
-		input_event const* event;		
-		
-		while (count && mInputReaderAccel.readEvent(&event)) {
-			int type = event->type;
-			if (type == EV_ABS) {
-				//LOGD("Sensor: Received one EV_ABS Event");
-				float value = event->value;
-				if (event->code == EVENT_TYPE_ACCEL_X) {
-					mPendingEvents[Accelerometer].acceleration.x = value * CONVERT_A_X;
-				} else if (event->code == EVENT_TYPE_ACCEL_Y) {
-					mPendingEvents[Accelerometer].acceleration.y = value * CONVERT_A_Y;
-				} else if (event->code == EVENT_TYPE_ACCEL_Z) {
-					mPendingEvents[Accelerometer].acceleration.z = value * CONVERT_A_Z;
-				}
-			} else if (type == EV_SYN) {
-				mPendingEvents[Accelerometer].timestamp = timevalToNano(event->time);
-				if (accelEnabled) {
-					//LOGD("Sensor: Accel was enabled, made a read and received a Sync");
-					accelDataReady = 1;
-					accelLastRead[0] = mPendingEvents[Accelerometer].acceleration.x;
-					accelLastRead[1] = mPendingEvents[Accelerometer].acceleration.y;
-					accelLastRead[2] = mPendingEvents[Accelerometer].acceleration.z;
-					*data++ = mPendingEvents[Accelerometer];
-					count--;
-					numEventReceived++;
-				}
-			}
-			 else {
-				LOGE("BoschYamaha: unknown event (type=%d, code=%d)", type, event->code);
-				
-			}
-			mInputReaderAccel.next();
-		}
-	}
-	
-	//LOGD("Sensor: Accel read quited, count: %d, acceldata Ready: %d, compassData Ready = %d", count, accelDataReady, compassDataReady);
-		
-	if( (accelDataReady == 1) && (compassDataReady == 1)){
-		//LOGD("BoschYamaha: Going to Process Orientation Data");
-		accelDataReady = 0;
-		compassDataReady = 0;
-		processOrientation();
-		*data++ = mPendingEvents[Orientation];
-		numEventReceived++;
-	}
+    // only the chips poll() woke for are read
+    if (mReadyFds & (1 << 0)) {
+        ssize_t n = mInputReaderAccel.fill(data_fd);
+        if (n < 0)
+            return n;
+    }
+    if (mReadyFds & (1 << 1)) {
+        ssize_t n = mInputReaderMagnetic.fill(data_compass_fd);
+        if (n < 0)
+            return n;
+    }
+    mReadyFds = 0;
+
+    int numEventReceived = 0;
+
+    fetchSamples();
+    while (count) {
+        int what;
+
+        // the older of the two chips' samples goes first
+        if (mSampleReady[Accelerometer] && mSampleReady[MagneticField]) {
+            what = (mPendingEvents[Accelerometer].timestamp <=
+                    mPendingEvents[MagneticField].timestamp) ? Accelerometer : MagneticField;
+        } else if (mSampleReady[Accelerometer]) {
+            what = Accelerometer;
+        } else if (mSampleReady[MagneticField]) {
+            what = MagneticField;
+        } else {
+            break;
+        }
+        mSampleReady[what] = false;
+
+        if (what == Accelerometer) {
+            accelDataReady = 1;
+            accelLastRead[0] = mPendingEvents[Accelerometer].acceleration.x;
+            accelLastRead[1] = mPendingEvents[Accelerometer].acceleration.y;
+            accelLastRead[2] = mPendingEvents[Accelerometer].acceleration.z;
+        } else {
+            compassDataReady = 1;
+            compassLastRead[0] = mPendingEvents[MagneticField].magnetic.x;
+            compassLastRead[1] = mPendingEvents[MagneticField].magnetic.y;
+            compassLastRead[2] = mPendingEvents[MagneticField].magnetic.z;
+        }
+        *data++ = mPendingEvents[what];
+        count--;
+        numEventReceived++;
+
+        if (count && (accelDataReady == 1) && (compassDataReady == 1)) {
+            accelDataReady = 0;
+            compassDataReady = 0;
+            processOrientation();
+            mPendingEvents[Orientation].timestamp = mPendingEvents[what].timestamp;
+            *data++ = mPendingEvents[Orientation];
+            count--;
+            numEventReceived++;
+        }
+        fetchSamples();
+    }
 
-	
     return numEventReceived;
 }
 
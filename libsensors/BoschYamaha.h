@@ -48,7 +48,9 @@ public:
     virtual int setDelay(int32_t handle, int64_t ns);
     virtual int enable(int32_t handle, int enabled);
     virtual int readEvents(sensors_event_t* data, int count);
-	virtual bool hasPendingEvents();
+    virtual bool hasPendingEvents() const;
+    virtual int getFdCount() const;
+    virtual int getPollFd(int index) const;
 	int processOrientation();
 	float calc_intensity(float x, float y, float z);
 	int get_rotation_matrix(const float *gsdata, const float *msdata, float *matrix);
@@ -57,7 +59,11 @@ public:
 private:
     const char* data_accel_name;
     int         data_compass_fd;
+    /* the compass enable attribute, mEnableFd is the accelerometer's */
+    int         mCompassEnableFd;
     int update_delay();
+    bool nextSample(int what);
+    void fetchSamples();
     //uint32_t mEnabled;
 	int compassEnabled;
 	int accelEnabled;
@@ -69,6 +75,8 @@ private:
     uint32_t mPendingMask;
     InputEventCircularReader mInputReaderMagnetic;
     InputEventCircularReader mInputReaderAccel;
+    /* a whole sample parsed from either chip, not delivered yet */
+    bool mSampleReady[MagneticField + 1];
     sensors_event_t mPendingEvents[numSensors];
     uint64_t mDelays[numSensors];
 	char input_sysfs_path[PATH_MAX];
@@ -32,7 +32,7 @@
 CompassSensor::CompassSensor()
     : SensorBase(NULL, "magnetic_sensor"),
       //mEnabled(0),
-      mInputReader(4),
+      mInputReader(32),
       mHasPendingEvent(false)
 {
     ALOGD("CompassSensor::CompassSensor()");
@@ -75,7 +75,7 @@ int CompassSensor::enable(int32_t, int en) {
         int fd;
         strcpy(&input_sysfs_path[input_sysfs_path_len], "enable");
         ALOGD("CompassSensor::~enable(0, %d) open %s",en,  input_sysfs_path);
-        fd = open(input_sysfs_path, O_RDWR);
+        fd = openControl(&mEnableFd, input_sysfs_path);
         if (fd >= 0) {
              ALOGD("CompassSensor::~enable(0, %d) opened %s",en,  input_sysfs_path);
             char buf[2];
@@ -86,8 +86,7 @@ int CompassSensor::enable(int32_t, int en) {
             } else {
                 buf[0] = '0';
             }
-            err = write(fd, buf, sizeof(buf));
-            close(fd);
+            err = pwrite(fd, buf, sizeof(buf), 0);
             mEnabled = flags;
 
             /* Since the migration to 3.0 kernel, orientationd doesn't poll
@@ -130,14 +129,16 @@ int CompassSensor::setDelay(int32_t handle, int64_t ns)
     }
 
     ALOGD("CompassSensor::~setDelay(%d, %lld) val = %d", handle, ns, val);
+    if (val == mDelayValue)
+        return 0;
 
     strcpy(&input_sysfs_path[input_sysfs_path_len], "delay");
-    fd = open(input_sysfs_path, O_RDWR);
+    fd = openControl(&mDelayFd, input_sysfs_path);
     if (fd >= 0) {
         char buf[80];
         sprintf(buf, "%d", val);
-        write(fd, buf, strlen(buf)+1);
-        close(fd);
+        pwrite(fd, buf, strlen(buf)+1, 0);
+        mDelayValue = val;
         return 0;
     }
     return -1;
@@ -25,14 +25,12 @@
 
 #include "GyroSensor.h"
 
-#define FETCH_FULL_EVENT_BEFORE_RETURN 1
-
 /*****************************************************************************/
 
 GyroSensor::GyroSensor()
     : SensorBase(NULL, "gyro"),
       mEnabled(0),
-      mInputReader(4),
+      mInputReader(EVDEV_BUFFERED_SAMPLES * 4),
       mHasPendingEvent(false)
 {
     mPendingEvent.version = sizeof(sensors_event_t);
@@ -79,7 +77,7 @@ int GyroSensor::enable(int32_t, int en) {
     if (flags != mEnabled) {
         int fd;
         strcpy(&input_sysfs_path[input_sysfs_path_len], "enable");
-        fd = open(input_sysfs_path, O_RDWR);
+        fd = openControl(&mEnableFd, input_sysfs_path);
         if (fd >= 0) {
             char buf[2];
             int err;
@@ -89,8 +87,7 @@ int GyroSensor::enable(int32_t, int en) {
             } else {
                 buf[0] = '0';
             }
-            err = write(fd, buf, sizeof(buf));
-            close(fd);
+            err = pwrite(fd, buf, sizeof(buf), 0);
             mEnabled = flags;
             setInitialState();
             return 0;
@@ -107,13 +104,15 @@ bool GyroSensor::hasPendingEvents() const {
 int GyroSensor::setDelay(int32_t handle, int64_t delay_ns)
 {
     int fd;
+    if (delay_ns == mDelayValue)
+        return 0;
     strcpy(&input_sysfs_path[input_sysfs_path_len], "poll_delay");
-    fd = open(input_sysfs_path, O_RDWR);
+    fd = openControl(&mDelayFd, input_sysfs_path);
     if (fd >= 0) {
         char buf[80];
         sprintf(buf, "%lld", delay_ns);
-        write(fd, buf, strlen(buf)+1);
-        close(fd);
+        pwrite(fd, buf, strlen(buf)+1, 0);
+        mDelayValue = delay_ns;
         return 0;
     }
     return -1;
@@ -138,9 +137,7 @@ int GyroSensor::readEvents(sensors_event_t* data, int count)
     int numEventReceived = 0;
     input_event const* event;
 
-#if FETCH_FULL_EVENT_BEFORE_RETURN
 again:
-#endif
     while (count && mInputReader.readEvent(&event)) {
         int type = event->type;
         if (type == EV_REL) {
@@ -166,15 +163,16 @@ again:
         mInputReader.next();
     }
 
-#if FETCH_FULL_EVENT_BEFORE_RETURN
-    /* if we didn't read a complete event, see if we can fill and
-       try again instead of returning with nothing and redoing poll. */
-    if (numEventReceived == 0 && mEnabled == 1) {
-        n = mInputReader.fill(data_fd);
-        if (n)
-            goto again;
+    /* at game rates the evdev buffer holds several samples by now, take
+       them all in this wakeup. the fd blocks, only read what is there. */
+    if (count && mEnabled == 1) {
+        struct pollfd pfd = { data_fd, POLLIN, 0 };
+        if (poll(&pfd, 1, 0) > 0 && (pfd.revents & POLLIN)) {
+            n = mInputReader.fill(data_fd);
+            if (n > 0)
+                goto again;
+        }
     }
-#endif
 
     return numEventReceived;
 }
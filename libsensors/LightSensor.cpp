@@ -27,12 +27,38 @@
 
 /*****************************************************************************/
 
+/*
+ * The framework only hears of the light level when it leaves its bucket by
+ * more than the hysteresis, a flickering source stays in one. The driver is
+ * read at most once per LIGHT_MIN_REPORT_NS, the samples wait in the evdev
+ * buffer meanwhile as for a batch and only the last one counts.
+ */
+#define LIGHT_MIN_REPORT_NS     250000000LL
+#define LIGHT_HYSTERESIS        0.1f
+
+/* lower edges of the buckets after the first, in lux */
+static const float kLuxBuckets[] = {
+    10, 40, 90, 160, 225, 320, 640, 1280, 2600, 5800, 8000
+};
+
+static int luxToBucket(float lux)
+{
+    int i = 0;
+    while (i < int(ARRAY_SIZE(kLuxBuckets)) && lux >= kLuxBuckets[i])
+        i++;
+    return i;
+}
+
 LightSensor::LightSensor()
     : SensorBase(NULL, "lightsensor-level"),
       mEnabled(0),
-      mInputReader(4),
-      mHasPendingEvent(false)
+      // the whole evdev client buffer, what waited out the interval
+      mInputReader(64),
+      mHasPendingEvent(false),
+      mBucket(-1)
 {
+    mMaxLatency = LIGHT_MIN_REPORT_NS;
+
     mPendingEvent.version = sizeof(sensors_event_t);
     mPendingEvent.sensor = ID_L;
     mPendingEvent.type = SENSOR_TYPE_LIGHT;
@@ -56,13 +82,15 @@ LightSensor::~LightSensor() {
 int LightSensor::setDelay(int32_t handle, int64_t ns)
 {
     int fd;
+    if (ns == mDelayValue)
+        return 0;
     strcpy(&input_sysfs_path[input_sysfs_path_len], "poll_delay");
-    fd = open(input_sysfs_path, O_RDWR);
+    fd = openControl(&mDelayFd, input_sysfs_path);
     if (fd >= 0) {
         char buf[80];
         sprintf(buf, "%lld", ns);
-        write(fd, buf, strlen(buf)+1);
-        close(fd);
+        pwrite(fd, buf, strlen(buf)+1, 0);
+        mDelayValue = ns;
         return 0;
     }
     return -1;
@@ -74,7 +102,7 @@ int LightSensor::enable(int32_t handle, int en)
     if (flags != mEnabled) {
         int fd;
         strcpy(&input_sysfs_path[input_sysfs_path_len], "enable");
-        fd = open(input_sysfs_path, O_RDWR);
+        fd = openControl(&mEnableFd, input_sysfs_path);
         if (fd >= 0) {
             char buf[2];
             int err;
@@ -84,9 +112,11 @@ int LightSensor::enable(int32_t handle, int en)
             } else {
                 buf[0] = '0';
             }
-            err = write(fd, buf, sizeof(buf));
-            close(fd);
+            err = pwrite(fd, buf, sizeof(buf), 0);
             mEnabled = flags;
+            // the first value after enable goes out as soon as it comes
+            mBucket = -1;
+            mBatchDeadline = 0;
             return 0;
         }
         return -1;
@@ -98,6 +128,32 @@ bool LightSensor::hasPendingEvents() const {
     return mHasPendingEvent;
 }
 
+int LightSensor::batch(int32_t handle, int64_t period_ns, int64_t timeout_ns)
+{
+    SensorBase::batch(handle, period_ns, timeout_ns);
+    if (mMaxLatency < LIGHT_MIN_REPORT_NS) {
+        mMaxLatency = LIGHT_MIN_REPORT_NS;
+        mBatchDeadline = getTimestamp() + mMaxLatency;
+    }
+    return 0;
+}
+
+// the bucket lux moves to, mBucket unless it went past an edge by more
+// than the hysteresis
+int LightSensor::nextBucket(float lux) const
+{
+    if (mBucket < 0)
+        return luxToBucket(lux);
+
+    int up = luxToBucket(lux / (1.0f + LIGHT_HYSTERESIS));
+    if (up > mBucket)
+        return up;
+    int down = luxToBucket(lux * (1.0f + LIGHT_HYSTERESIS));
+    if (down < mBucket)
+        return down;
+    return mBucket;
+}
+
 int LightSensor::readEvents(sensors_event_t* data, int count)
 {
     if (count < 1)
@@ -115,9 +171,11 @@ int LightSensor::readEvents(sensors_event_t* data, int count)
         return n;
 
     int numEventReceived = 0;
+    int reported = mBucket;
+    sensors_event_t last = mPendingEvent;
     input_event const* event;
 
-    while (count && mInputReader.readEvent(&event)) {
+    while (mInputReader.readEvent(&event)) {
         int type = event->type;
         if (type == EV_ABS) {
             if (event->code == EVENT_TYPE_LIGHT) {
@@ -130,11 +188,8 @@ int LightSensor::readEvents(sensors_event_t* data, int count)
             }
         } else if (type == EV_SYN) {
             mPendingEvent.timestamp = timevalToNano(event->time);
-            if (mEnabled) {
-                *data++ = mPendingEvent;
-                count--;
-                numEventReceived++;
-            }
+            mBucket = nextBucket(mPendingEvent.light);
+            last = mPendingEvent;
         } else {
             ALOGE("LightSensor: unknown event (type=%d, code=%d)",
                     type, event->code);
@@ -142,5 +197,11 @@ int LightSensor::readEvents(sensors_event_t* data, int count)
         mInputReader.next();
     }
 
+    // a source flickering across an edge and back is not heard of
+    if (mEnabled && mBucket != reported) {
+        *data = last;
+        numEventReceived++;
+    }
+
     return numEventReceived;
 }
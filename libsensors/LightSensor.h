@@ -37,8 +37,11 @@ class LightSensor : public SensorBase {
     bool mHasPendingEvent;
     char input_sysfs_path[PATH_MAX];
     int input_sysfs_path_len;
+    /* bucket of the last value reported, -1 until the first after enable */
+    int mBucket;
 
     int setInitialState();
+    int nextBucket(float lux) const;
 
 public:
             LightSensor();
@@ -47,6 +50,7 @@ public:
     virtual bool hasPendingEvents() const;
     virtual int setDelay(int32_t handle, int64_t ns);
     virtual int enable(int32_t handle, int enabled);
+    virtual int batch(int32_t handle, int64_t period_ns, int64_t timeout_ns);
 };
 
 /*****************************************************************************/
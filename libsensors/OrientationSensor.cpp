@@ -31,7 +31,7 @@
 OrientationSensor::OrientationSensor()
     : SensorBase(NULL, "orientation_sensor"),
       mEnabled(0),
-      mInputReader(4),
+      mInputReader(32),
       mHasPendingEvent(false)
 {
     ALOGD("OrientationSensor::OrientationSensor()");
@@ -70,7 +70,7 @@ int OrientationSensor::enable(int32_t, int en) {
         int fd;
         strcpy(&input_sysfs_path[input_sysfs_path_len], "enable");
         ALOGD("OrientationSensor::~enable(0, %d) open %s",en,  input_sysfs_path);
-        fd = open(input_sysfs_path, O_RDWR);
+        fd = openControl(&mEnableFd, input_sysfs_path);
         if (fd >= 0) {
              ALOGD("OrientationSensor::~enable(0, %d) opened %s",en,  input_sysfs_path);
             char buf[2];
@@ -81,8 +81,7 @@ int OrientationSensor::enable(int32_t, int en) {
             } else {
                 buf[0] = '0';
             }
-            err = write(fd, buf, sizeof(buf));
-            close(fd);
+            err = pwrite(fd, buf, sizeof(buf), 0);
             mEnabled = flags;
             //setInitialState();
             return 0;
@@ -111,13 +110,17 @@ int OrientationSensor::setDelay(int32_t handle, int64_t ns)
         ns = 10000000; // Minimum on stock
     }
 
+    int64_t val = ns / 10000000 * 10; // Some flooring to match stock value
+    if (val == mDelayValue)
+        return 0;
+
     strcpy(&input_sysfs_path[input_sysfs_path_len], "delay");
-    fd = open(input_sysfs_path, O_RDWR);
+    fd = openControl(&mDelayFd, input_sysfs_path);
     if (fd >= 0) {
         char buf[80];
-        sprintf(buf, "%lld", ns / 10000000 * 10); // Some flooring to match stock value
-        write(fd, buf, strlen(buf)+1);
-        close(fd);
+        sprintf(buf, "%lld", val);
+        pwrite(fd, buf, strlen(buf)+1, 0);
+        mDelayValue = val;
         return 0;
     }
     return -1;
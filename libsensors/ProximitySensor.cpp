@@ -32,7 +32,8 @@ ProximitySensor::ProximitySensor()
     : SensorBase(NULL, "proximity"),
       mEnabled(0),
       mInputReader(4),
-      mHasPendingEvent(false)
+      mHasPendingEvent(false),
+      mLastDistance(-1)
 {
     mPendingEvent.version = sizeof(sensors_event_t);
     mPendingEvent.sensor = ID_P;
@@ -61,6 +62,7 @@ int ProximitySensor::setInitialState() {
         mHasPendingEvent = true;
         mPendingEvent.distance = indexToValue(absinfo.value);
     }
+    mLastDistance = -1;
     return 0;
 }
 
@@ -69,7 +71,7 @@ int ProximitySensor::enable(int32_t, int en) {
     if (flags != mEnabled) {
         int fd;
         strcpy(&input_sysfs_path[input_sysfs_path_len], "enable");
-        fd = open(input_sysfs_path, O_RDWR);
+        fd = openControl(&mEnableFd, input_sysfs_path);
         if (fd >= 0) {
             char buf[2];
             buf[1] = 0;
@@ -78,8 +80,7 @@ int ProximitySensor::enable(int32_t, int en) {
             } else {
                 buf[0] = '0';
             }
-            write(fd, buf, sizeof(buf));
-            close(fd);
+            pwrite(fd, buf, sizeof(buf), 0);
             mEnabled = flags;
             setInitialState();
             return 0;
@@ -102,7 +103,10 @@ int ProximitySensor::readEvents(sensors_event_t* data, int count)
         mHasPendingEvent = false;
         mPendingEvent.timestamp = getTimestamp();
         *data = mPendingEvent;
-        return mEnabled ? 1 : 0;
+        if (!mEnabled)
+            return 0;
+        mLastDistance = mPendingEvent.distance;
+        return 1;
     }
 
     ssize_t n = mInputReader.fill(data_fd);
@@ -123,7 +127,11 @@ int ProximitySensor::readEvents(sensors_event_t* data, int count)
             }
         } else if (type == EV_SYN) {
             mPendingEvent.timestamp = timevalToNano(event->time);
-            if (mEnabled) {
+            // on change only, the -1 samples above repeat the last distance.
+            // No interval nor hysteresis here: the GP2A switches with its
+            // own and the screen has to go off without delay in a call
+            if (mEnabled && mPendingEvent.distance != mLastDistance) {
+                mLastDistance = mPendingEvent.distance;
                 *data++ = mPendingEvent;
                 count--;
                 numEventReceived++;
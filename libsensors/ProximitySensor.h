@@ -37,6 +37,8 @@ class ProximitySensor : public SensorBase {
     bool mHasPendingEvent;
     char input_sysfs_path[PATH_MAX];
     int input_sysfs_path_len;
+    /* distance last reported, -1 until the first after enable */
+    float mLastDistance;
 
     int setInitialState();
     float indexToValue(size_t index) const;
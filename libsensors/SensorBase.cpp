@@ -20,6 +20,9 @@
 #include <poll.h>
 #include <unistd.h>
 #include <dirent.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
 #include <sys/select.h>
 
 #include <cutils/log.h>
@@ -30,11 +33,55 @@
 
 /*****************************************************************************/
 
+/* the input devices found under /dev/input, by name, scanned once */
+#define INPUT_DIR           "/dev/input"
+#define INPUT_MAX_DEVICES   32
+
+struct input_device {
+    char name[80];
+    char node[NAME_MAX + 1];
+};
+
+static struct input_device sInputDevices[INPUT_MAX_DEVICES];
+static int sInputDeviceCount;
+static pthread_once_t sInputScanOnce = PTHREAD_ONCE_INIT;
+
+static void scanInputDevices() {
+    DIR *dir;
+    struct dirent *de;
+    char devname[PATH_MAX];
+
+    dir = opendir(INPUT_DIR);
+    if (dir == NULL) {
+        ALOGE("couldn't open %s (%s)", INPUT_DIR, strerror(errno));
+        return;
+    }
+    while ((de = readdir(dir)) && sInputDeviceCount < INPUT_MAX_DEVICES) {
+        struct input_device *dev = &sInputDevices[sInputDeviceCount];
+        if (de->d_name[0] == '.')
+            continue;
+        snprintf(devname, sizeof(devname), INPUT_DIR "/%s", de->d_name);
+        int fd = open(devname, O_RDONLY);
+        if (fd < 0)
+            continue;
+        if (ioctl(fd, EVIOCGNAME(sizeof(dev->name) - 1), dev->name) < 1)
+            dev->name[0] = '\0';
+        close(fd);
+        if (!dev->name[0])
+            continue;
+        strlcpy(dev->node, de->d_name, sizeof(dev->node));
+        sInputDeviceCount++;
+    }
+    closedir(dir);
+}
+
 SensorBase::SensorBase(
         const char* dev_name,
         const char* data_name)
     : dev_name(dev_name), data_name(data_name),
-      dev_fd(-1), data_fd(-1)
+      dev_fd(-1), data_fd(-1),
+      mMaxLatency(0), mBatchDeadline(0), mReadyFds(0),
+      mEnableFd(-1), mDelayFd(-1), mDelayValue(-1)
 {
     if (data_name) {
         data_fd = openInput(data_name);
@@ -48,6 +95,12 @@ SensorBase::~SensorBase() {
     if (dev_fd >= 0) {
         close(dev_fd);
     }
+    if (mEnableFd >= 0) {
+        close(mEnableFd);
+    }
+    if (mDelayFd >= 0) {
+        close(mDelayFd);
+    }
 }
 
 int SensorBase::open_device() {
@@ -66,6 +119,19 @@ int SensorBase::close_device() {
     return 0;
 }
 
+/*
+ * Returns the fd of a sysfs attribute, opening it the first time. Writes
+ * go through pwrite() at offset 0, sysfs hands each one to the driver
+ * whole.
+ */
+int SensorBase::openControl(int* fd, const char* path) {
+    if (*fd < 0) {
+        *fd = open(path, O_RDWR);
+        ALOGE_IF(*fd<0, "Couldn't open %s (%s)", path, strerror(errno));
+    }
+    return *fd;
+}
+
 int SensorBase::getFd() const {
     if (!data_name) {
         return dev_fd;
@@ -73,10 +139,28 @@ int SensorBase::getFd() const {
     return data_fd;
 }
 
+int SensorBase::getFdCount() const {
+    return 1;
+}
+
+int SensorBase::getPollFd(int index) const {
+    return index ? -1 : getFd();
+}
+
 int SensorBase::setDelay(int32_t handle, int64_t ns) {
     return 0;
 }
 
+int SensorBase::batch(int32_t handle, int64_t period_ns, int64_t timeout_ns) {
+    // the caller sets the rate, combined with the other handles'
+    // the kernel drops what does not fit in the evdev buffer
+    if (timeout_ns > period_ns * EVDEV_BUFFERED_SAMPLES)
+        timeout_ns = period_ns * EVDEV_BUFFERED_SAMPLES;
+    mMaxLatency = (timeout_ns > 0) ? timeout_ns : 0;
+    mBatchDeadline = getTimestamp() + mMaxLatency;
+    return 0;
+}
+
 bool SensorBase::hasPendingEvents() const {
     return false;
 }
@@ -88,41 +172,35 @@ int64_t SensorBase::getTimestamp() {
     return int64_t(t.tv_sec)*1000000000LL + t.tv_nsec;
 }
 
+/*
+ * The first call names every node under /dev/input, all the drivers look
+ * their device up in that list, so the HAL opens each node once to name
+ * it and once more for the driver that reads it.
+ */
 int SensorBase::openInput(const char* inputName) {
     int fd = -1;
-    const char *dirname = "/dev/input";
     char devname[PATH_MAX];
-    char *filename;
-    DIR *dir;
-    struct dirent *de;
-    dir = opendir(dirname);
-    if(dir == NULL)
-        return -1;
-    strcpy(devname, dirname);
-    filename = devname + strlen(devname);
-    *filename++ = '/';
-    while((de = readdir(dir))) {
-        if(de->d_name[0] == '.' &&
-                (de->d_name[1] == '\0' ||
-                        (de->d_name[1] == '.' && de->d_name[2] == '\0')))
+
+    pthread_once(&sInputScanOnce, scanInputDevices);
+
+    for (int i = 0; i < sInputDeviceCount; i++) {
+        if (strcmp(sInputDevices[i].name, inputName))
             continue;
-        strcpy(filename, de->d_name);
+        snprintf(devname, sizeof(devname), INPUT_DIR "/%s", sInputDevices[i].node);
         fd = open(devname, O_RDONLY);
-        if (fd>=0) {
-            char name[80];
-            if (ioctl(fd, EVIOCGNAME(sizeof(name) - 1), &name) < 1) {
-                name[0] = '\0';
-            }
-            if (!strcmp(name, inputName)) {
-                strcpy(input_name, filename);
-                break;
-            } else {
-                close(fd);
-                fd = -1;
-            }
+        if (fd < 0) {
+            ALOGE("couldn't open %s (%s)", devname, strerror(errno));
+            break;
         }
+        strcpy(input_name, sInputDevices[i].node);
+#ifdef EVIOCSCLOCKID
+        // stamp events on the clock of getTimestamp(), not wall time
+        int clockId = CLOCK_MONOTONIC;
+        if (ioctl(fd, EVIOCSCLOCKID, &clockId) < 0)
+            ALOGW("couldn't set monotonic clock for '%s' (%s)", inputName, strerror(errno));
+#endif
+        break;
     }
-    closedir(dir);
     ALOGE_IF(fd<0, "couldn't find '%s' input device", inputName);
     return fd;
 }
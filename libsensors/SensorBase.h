@@ -25,6 +25,11 @@
 
 /*****************************************************************************/
 
+/* samples of 4 input events that fit in the 64 event evdev client buffer */
+#define EVDEV_BUFFERED_SAMPLES  16
+/* input devices a single driver may read, e.g. two chips behind one driver */
+#define SENSOR_MAX_FDS          2
+
 struct sensors_event_t;
 
 class SensorBase {
@@ -34,9 +39,19 @@ protected:
     char        input_name[PATH_MAX];
     int         dev_fd;
     int         data_fd;
+    /* batching: events wait in the evdev buffer until mBatchDeadline */
+    int64_t     mMaxLatency;
+    int64_t     mBatchDeadline;
+    /* bit i set when poll() found getPollFd(i) readable */
+    uint32_t    mReadyFds;
+    /* sysfs control attributes, opened on first use and kept open */
+    int         mEnableFd;
+    int         mDelayFd;
+    /* last value written to the delay attribute, -1 before the first */
+    int64_t     mDelayValue;
 
     int openInput(const char* inputName);
-    static int64_t getTimestamp();
+    int openControl(int* fd, const char* path);
 
 
     static int64_t timevalToNano(timeval const& t) {
@@ -56,8 +71,18 @@ public:
     virtual int readEvents(sensors_event_t* data, int count) = 0;
     virtual bool hasPendingEvents() const;
     virtual int getFd() const;
+    virtual int getFdCount() const;
+    virtual int getPollFd(int index) const;
     virtual int setDelay(int32_t handle, int64_t ns);
     virtual int enable(int32_t handle, int enabled) = 0;
+    virtual int batch(int32_t handle, int64_t period_ns, int64_t timeout_ns);
+
+    /* when the batch is due, 0 when the sensor reports as it samples */
+    int64_t batchDeadline() const { return mMaxLatency ? mBatchDeadline : 0; }
+    void batchDelivered(int64_t now) { mBatchDeadline = now + mMaxLatency; }
+    void setReadyFds(uint32_t mask) { mReadyFds = mask; }
+
+    static int64_t getTimestamp();
 };
 
 /*****************************************************************************/
@@ -0,0 +1,317 @@
+/*
+ * Copyright (C) 2008 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <fcntl.h>
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <cutils/log.h>
+
+#include "SensorFusion.h"
+
+/*****************************************************************************/
+
+// time constants of the low pass filters when there is no gyroscope, in s
+#define GRAVITY_TIME_CONSTANT       0.2f
+#define ATTITUDE_TIME_CONSTANT      0.2f
+// pull of the accelerometer and magnetic field per sample on gyro rates
+#define GYRO_CORRECTION             0.02f
+// gyro rates older than this do not count as a gyroscope, in ns
+#define GYRO_TIMEOUT                200000000LL
+// gaps between samples after which the filters start over, in ns
+#define SAMPLE_TIMEOUT              1000000000LL
+
+static void cross(float const* a, float const* b, float* out)
+{
+    out[0] = a[1] * b[2] - a[2] * b[1];
+    out[1] = a[2] * b[0] - a[0] * b[2];
+    out[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+static float norm(float const* v)
+{
+    return sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+}
+
+static void normalizeQuat(float* q)
+{
+    float n = sqrtf(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+    if (n > 0) {
+        for (int i = 0; i < 4; i++)
+            q[i] /= n;
+    }
+}
+
+/*****************************************************************************/
+
+SensorFusion::SensorFusion()
+    : SensorBase(NULL, NULL),
+      mEnabled(0),
+      mHasGravity(false),
+      mHasMagnetic(false),
+      mHasQuat(false),
+      mAccelTime(0),
+      mGyroTime(0),
+      mQueueHead(0),
+      mQueueCount(0)
+{
+    memset(mGravity, 0, sizeof(mGravity));
+    memset(mMagnetic, 0, sizeof(mMagnetic));
+    memset(mGyro, 0, sizeof(mGyro));
+    memset(mQuat, 0, sizeof(mQuat));
+}
+
+SensorFusion::~SensorFusion() {
+}
+
+int SensorFusion::enable(int32_t handle, int en) {
+    int what = -1;
+
+    switch (handle) {
+        case ID_RV: what = RotationVector;     break;
+        case ID_GR: what = Gravity;            break;
+        case ID_LA: what = LinearAcceleration; break;
+    }
+
+    if (uint32_t(what) >= numSensors)
+        return -EINVAL;
+
+    uint32_t mask = mEnabled & ~(1 << what);
+    if (en)
+        mask |= 1 << what;
+    if (!mEnabled && mask) {
+        // what the filters held is stale by now
+        mHasGravity = mHasMagnetic = mHasQuat = false;
+        mAccelTime = mGyroTime = 0;
+        mQueueCount = 0;
+    }
+    mEnabled = mask;
+    return 0;
+}
+
+bool SensorFusion::hasPendingEvents() const {
+    return mQueueCount > 0;
+}
+
+int SensorFusion::readEvents(sensors_event_t* data, int count)
+{
+    if (count < 1)
+        return -EINVAL;
+
+    int numEventReceived = 0;
+    while (count && mQueueCount) {
+        *data++ = mQueue[mQueueHead];
+        mQueueHead = (mQueueHead + 1) % FUSION_QUEUE_SIZE;
+        mQueueCount--;
+        count--;
+        numEventReceived++;
+    }
+    return numEventReceived;
+}
+
+void SensorFusion::process(sensors_event_t const* data, int count)
+{
+    if (!mEnabled)
+        return;
+
+    for (int i = 0; i < count; i++) {
+        switch (data[i].type) {
+            case SENSOR_TYPE_ACCELEROMETER:
+                processAccelerometer(data[i]);
+                break;
+            case SENSOR_TYPE_MAGNETIC_FIELD:
+                processMagneticField(data[i]);
+                break;
+            case SENSOR_TYPE_GYROSCOPE:
+                processGyroscope(data[i]);
+                break;
+        }
+    }
+}
+
+void SensorFusion::processAccelerometer(sensors_event_t const& event)
+{
+    float const* accel = event.acceleration.v;
+    int64_t delta = event.timestamp - mAccelTime;
+    bool gyro = mGyroTime && (event.timestamp - mGyroTime) < GYRO_TIMEOUT;
+    float linear[3];
+
+    if (!mHasGravity || delta <= 0 || delta > SAMPLE_TIMEOUT) {
+        memcpy(mGravity, accel, sizeof(mGravity));
+        mHasGravity = true;
+        mHasQuat = false;
+    } else {
+        float dt = delta * 1e-9f;
+        float k = gyro ? GYRO_CORRECTION : dt / (GRAVITY_TIME_CONSTANT + dt);
+        for (int i = 0; i < 3; i++)
+            mGravity[i] += k * (accel[i] - mGravity[i]);
+    }
+    mAccelTime = event.timestamp;
+
+    for (int i = 0; i < 3; i++)
+        linear[i] = accel[i] - mGravity[i];
+
+    if (wantsMagneticField() && mHasMagnetic) {
+        float quat[4];
+        if (attitudeFromGravity(quat)) {
+            if (!mHasQuat) {
+                memcpy(mQuat, quat, sizeof(mQuat));
+                mHasQuat = true;
+            } else {
+                float dt = delta * 1e-9f;
+                float k = gyro ? GYRO_CORRECTION : dt / (ATTITUDE_TIME_CONSTANT + dt);
+                float dot = 0;
+                for (int i = 0; i < 4; i++)
+                    dot += mQuat[i] * quat[i];
+                // q and -q are the same attitude, blend towards the nearer one
+                float sign = (dot < 0) ? -1.0f : 1.0f;
+                for (int i = 0; i < 4; i++)
+                    mQuat[i] += k * (sign * quat[i] - mQuat[i]);
+                normalizeQuat(mQuat);
+            }
+        }
+    }
+
+    if (mEnabled & (1 << Gravity))
+        queueEvent(Gravity, event.timestamp, mGravity, 3);
+    if (mEnabled & (1 << LinearAcceleration))
+        queueEvent(LinearAcceleration, event.timestamp, linear, 3);
+    if ((mEnabled & (1 << RotationVector)) && mHasQuat) {
+        // x, y, z and the optional cos(theta/2), kept positive
+        float sign = (mQuat[0] < 0) ? -1.0f : 1.0f;
+        float values[4] = { sign * mQuat[1], sign * mQuat[2], sign * mQuat[3], sign * mQuat[0] };
+        queueEvent(RotationVector, event.timestamp, values, 4);
+    }
+}
+
+void SensorFusion::processMagneticField(sensors_event_t const& event)
+{
+    memcpy(mMagnetic, event.magnetic.v, sizeof(mMagnetic));
+    mHasMagnetic = true;
+}
+
+void SensorFusion::processGyroscope(sensors_event_t const& event)
+{
+    float const* rate = event.gyro.v;
+    int64_t delta = event.timestamp - mGyroTime;
+
+    if (mGyroTime && delta > 0 && delta < SAMPLE_TIMEOUT) {
+        float dt = delta * 1e-9f;
+        float turn[3];
+
+        // a vector fixed in the world turns the other way in device coordinates
+        cross(mGravity, mGyro, turn);
+        for (int i = 0; i < 3; i++)
+            mGravity[i] += turn[i] * dt;
+
+        if (mHasQuat) {
+            float angle = norm(mGyro) * dt;
+            if (angle > 0) {
+                float s = sinf(angle * 0.5f) / (norm(mGyro) * dt);
+                float d[4] = { cosf(angle * 0.5f), mGyro[0] * dt * s, mGyro[1] * dt * s, mGyro[2] * dt * s };
+                float q[4];
+                // q = q * d, the rate is in device coordinates
+                q[0] = mQuat[0] * d[0] - mQuat[1] * d[1] - mQuat[2] * d[2] - mQuat[3] * d[3];
+                q[1] = mQuat[0] * d[1] + mQuat[1] * d[0] + mQuat[2] * d[3] - mQuat[3] * d[2];
+                q[2] = mQuat[0] * d[2] - mQuat[1] * d[3] + mQuat[2] * d[0] + mQuat[3] * d[1];
+                q[3] = mQuat[0] * d[3] + mQuat[1] * d[2] - mQuat[2] * d[1] + mQuat[3] * d[0];
+                memcpy(mQuat, q, sizeof(mQuat));
+                normalizeQuat(mQuat);
+            }
+        }
+    }
+    memcpy(mGyro, rate, sizeof(mGyro));
+    mGyroTime = event.timestamp;
+}
+
+/*
+ * The attitude the gravity and magnetic field give on their own, as the
+ * framework's getRotationMatrix() builds it: rows east, north and up in
+ * device coordinates, then turned into a quaternion w, x, y, z.
+ */
+bool SensorFusion::attitudeFromGravity(float* quat) const
+{
+    float east[3], north[3], up[3];
+    float normUp = norm(mGravity);
+
+    cross(mMagnetic, mGravity, east);
+    float normEast = norm(east);
+    // free fall, or the device close to magnetic north
+    if (normUp < 0.1f * GRAVITY_EARTH || normEast < 0.1f)
+        return false;
+
+    for (int i = 0; i < 3; i++) {
+        east[i] /= normEast;
+        up[i] = mGravity[i] / normUp;
+    }
+    cross(up, east, north);
+
+    float const* r[3] = { east, north, up };
+    float trace = r[0][0] + r[1][1] + r[2][2];
+    if (trace > 0) {
+        float s = sqrtf(trace + 1.0f) * 2.0f;
+        quat[0] = 0.25f * s;
+        quat[1] = (r[2][1] - r[1][2]) / s;
+        quat[2] = (r[0][2] - r[2][0]) / s;
+        quat[3] = (r[1][0] - r[0][1]) / s;
+    } else if (r[0][0] > r[1][1] && r[0][0] > r[2][2]) {
+        float s = sqrtf(1.0f + r[0][0] - r[1][1] - r[2][2]) * 2.0f;
+        quat[0] = (r[2][1] - r[1][2]) / s;
+        quat[1] = 0.25f * s;
+        quat[2] = (r[0][1] + r[1][0]) / s;
+        quat[3] = (r[0][2] + r[2][0]) / s;
+    } else if (r[1][1] > r[2][2]) {
+        float s = sqrtf(1.0f + r[1][1] - r[0][0] - r[2][2]) * 2.0f;
+        quat[0] = (r[0][2] - r[2][0]) / s;
+        quat[1] = (r[0][1] + r[1][0]) / s;
+        quat[2] = 0.25f * s;
+        quat[3] = (r[1][2] + r[2][1]) / s;
+    } else {
+        float s = sqrtf(1.0f + r[2][2] - r[0][0] - r[1][1]) * 2.0f;
+        quat[0] = (r[1][0] - r[0][1]) / s;
+        quat[1] = (r[0][2] + r[2][0]) / s;
+        quat[2] = (r[1][2] + r[2][1]) / s;
+        quat[3] = 0.25f * s;
+    }
+    normalizeQuat(quat);
+    return true;
+}
+
+void SensorFusion::queueEvent(int what, int64_t timestamp, float const* values, int num)
+{
+    static const int32_t ids[numSensors] = { ID_RV, ID_GR, ID_LA };
+    static const int32_t types[numSensors] = {
+        SENSOR_TYPE_ROTATION_VECTOR, SENSOR_TYPE_GRAVITY, SENSOR_TYPE_LINEAR_ACCELERATION
+    };
+
+    if (mQueueCount == FUSION_QUEUE_SIZE) {
+        // the oldest goes when nobody reads
+        mQueueHead = (mQueueHead + 1) % FUSION_QUEUE_SIZE;
+        mQueueCount--;
+    }
+
+    sensors_event_t* event = &mQueue[(mQueueHead + mQueueCount) % FUSION_QUEUE_SIZE];
+    memset(event, 0, sizeof(*event));
+    event->version = sizeof(sensors_event_t);
+    event->sensor = ids[what];
+    event->type = types[what];
+    event->timestamp = timestamp;
+    for (int i = 0; i < num; i++)
+        event->data[i] = values[i];
+    mQueueCount++;
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2008 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_SENSOR_FUSION_H
+#define ANDROID_SENSOR_FUSION_H
+
+#include <stdint.h>
+#include <errno.h>
+#include <sys/cdefs.h>
+#include <sys/types.h>
+
+#include "sensors.h"
+#include "SensorBase.h"
+
+/*****************************************************************************/
+
+// virtual events queued between two readEvents(), 3 per accelerometer sample
+#define FUSION_QUEUE_SIZE           64
+
+/*
+ * Rotation vector, gravity and linear acceleration computed once in the
+ * HAL from the events the other drivers report. A complementary filter:
+ * the gyroscope, when one reports, carries the attitude between samples
+ * and the accelerometer and magnetic field pull it back slowly, without
+ * one the accelerometer and magnetic field are low pass filtered. The
+ * driver has no fd, its events come from process().
+ */
+class SensorFusion : public SensorBase {
+public:
+            SensorFusion();
+    virtual ~SensorFusion();
+
+    enum {
+        RotationVector      = 0,
+        Gravity             = 1,
+        LinearAcceleration  = 2,
+        numSensors
+    };
+
+    virtual int readEvents(sensors_event_t* data, int count);
+    virtual bool hasPendingEvents() const;
+    virtual int enable(int32_t handle, int enabled);
+
+    /* feeds the events another driver just reported */
+    void process(sensors_event_t const* data, int count);
+
+    bool wantsAccelerometer() const { return mEnabled != 0; }
+    bool wantsMagneticField() const { return (mEnabled & (1 << RotationVector)) != 0; }
+
+private:
+    uint32_t mEnabled;
+    float mGravity[3];
+    float mMagnetic[3];
+    float mGyro[3];
+    float mQuat[4];
+    bool mHasGravity;
+    bool mHasMagnetic;
+    bool mHasQuat;
+    int64_t mAccelTime;
+    int64_t mGyroTime;
+    sensors_event_t mQueue[FUSION_QUEUE_SIZE];
+    int mQueueHead;
+    int mQueueCount;
+
+    void processAccelerometer(sensors_event_t const& event);
+    void processMagneticField(sensors_event_t const& event);
+    void processGyroscope(sensors_event_t const& event);
+    bool attitudeFromGravity(float* quat) const;
+    void queueEvent(int what, int64_t timestamp, float const* values, int num);
+};
+
+/*****************************************************************************/
+
+#endif  // ANDROID_SENSOR_FUSION_H
@@ -32,7 +32,7 @@ Smb380Sensor::Smb380Sensor()
     : SensorBase(NULL, "accelerometer_sensor"),
       mEnabled(0),
 
-      mInputReader(4),
+      mInputReader(32),
       mHasPendingEvent(false)
 {
     ALOGD("Smb380Sensor::Smb380Sensor()");
@@ -72,7 +72,7 @@ int Smb380Sensor::enable(int32_t, int en) {
         int fd;
         strcpy(&input_sysfs_path[input_sysfs_path_len], "enable");
         ALOGD("Smb380Sensor::~enable(0, %d) open %s",en,  input_sysfs_path);
-        fd = open(input_sysfs_path, O_RDWR);
+        fd = openControl(&mEnableFd, input_sysfs_path);
         if (fd >= 0) {
              ALOGD("Smb380Sensor::~enable(0, %d) opened %s",en,  input_sysfs_path);
             char buf[2];
@@ -83,8 +83,7 @@ int Smb380Sensor::enable(int32_t, int en) {
             } else {
                 buf[0] = '0';
             }
-            err = write(fd, buf, sizeof(buf));
-            close(fd);
+            err = pwrite(fd, buf, sizeof(buf), 0);
             mEnabled = flags;
             //setInitialState();
             return 0;
@@ -113,13 +112,17 @@ int Smb380Sensor::setDelay(int32_t handle, int64_t ns)
         ns = 10000000; // Minimum on stock
     }
 
+    int64_t val = ns / 10000000 * 10; // Some flooring to match stock value
+    if (val == mDelayValue)
+        return 0;
+
     strcpy(&input_sysfs_path[input_sysfs_path_len], "delay");
-    fd = open(input_sysfs_path, O_RDWR);
+    fd = openControl(&mDelayFd, input_sysfs_path);
     if (fd >= 0) {
         char buf[80];
-        sprintf(buf, "%lld", ns / 10000000 * 10); // Some flooring to match stock value
-        write(fd, buf, strlen(buf)+1);
-        close(fd);
+        sprintf(buf, "%lld", val);
+        pwrite(fd, buf, strlen(buf)+1, 0);
+        mDelayValue = val;
         return 0;
     }
     return -1;
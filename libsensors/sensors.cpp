@@ -24,6 +24,7 @@
 #include <poll.h>
 #include <pthread.h>
 #include <stdlib.h>
+#include <sys/eventfd.h>
 
 #include <linux/input.h>
 
@@ -31,6 +32,8 @@
 #include <utils/Atomic.h>
 #include <utils/Log.h>
 
+#include <sec_startup.h>
+
 #include "sensors.h"
 
 #include "LightSensor.h"
@@ -39,6 +42,7 @@
 #include "Smb380Sensor.h"
 #include "CompassSensor.h"
 #include "OrientationSensor.h"
+#include "SensorFusion.h"
 
 /*****************************************************************************/
 
@@ -53,6 +57,9 @@
 #define SENSORS_LIGHT            (1<<ID_L)
 #define SENSORS_PROXIMITY        (1<<ID_P)
 #define SENSORS_GYROSCOPE        (1<<ID_GY)
+#define SENSORS_ROTATION_VECTOR  (1<<ID_RV)
+#define SENSORS_GRAVITY          (1<<ID_GR)
+#define SENSORS_LINEAR_ACCEL     (1<<ID_LA)
 
 #define SENSORS_ACCELERATION_HANDLE     0
 #define SENSORS_MAGNETIC_FIELD_HANDLE   1
@@ -60,6 +67,9 @@
 #define SENSORS_LIGHT_HANDLE            3
 #define SENSORS_PROXIMITY_HANDLE        4
 #define SENSORS_GYROSCOPE_HANDLE        5
+#define SENSORS_ROTATION_VECTOR_HANDLE  6
+#define SENSORS_GRAVITY_HANDLE          7
+#define SENSORS_LINEAR_ACCEL_HANDLE     8
 
 #define AKM_FTRACE 0
 #define AKM_DEBUG 0
@@ -90,6 +100,18 @@ static const struct sensor_t sSensorList[] = {
           "Sharp",
           1, SENSORS_PROXIMITY_HANDLE,
           SENSOR_TYPE_PROXIMITY, 5.0f, 5.0f, 0.75f, 0, { } },        
+        { "Rotation Vector Sensor",
+          "Samsung Electronic Company",
+          1, SENSORS_ROTATION_VECTOR_HANDLE,
+          SENSOR_TYPE_ROTATION_VECTOR, 1.0f, 1.0f / (1<<24), 7.0f, 40000, { } },
+        { "Gravity Sensor",
+          "Samsung Electronic Company",
+          1, SENSORS_GRAVITY_HANDLE,
+          SENSOR_TYPE_GRAVITY, RANGE_A, RESOLUTION_A, 0.20f, 40000, { } },
+        { "Linear Acceleration Sensor",
+          "Samsung Electronic Company",
+          1, SENSORS_LINEAR_ACCEL_HANDLE,
+          SENSOR_TYPE_LINEAR_ACCELERATION, RANGE_A, RESOLUTION_A, 0.20f, 40000, { } },
 };
 
 
@@ -122,12 +144,17 @@ struct sensors_module_t HAL_MODULE_INFO_SYM = {
 };
 
 struct sensors_poll_context_t {
+#ifdef SENSORS_DEVICE_API_VERSION_1_0
+    struct sensors_poll_device_1 device; // must be first
+#else
     struct sensors_poll_device_t device; // must be first
+#endif
 
         sensors_poll_context_t();
         ~sensors_poll_context_t();
     int activate(int handle, int enabled);
     int setDelay(int handle, int64_t ns);
+    int batch(int handle, int flags, int64_t period_ns, int64_t timeout);
     int pollEvents(sensors_event_t* data, int count);
 
 private:
@@ -137,22 +164,64 @@ private:
         bosch           = 2,
         yamaha          = 3,
 	orientation 	= 4,        
+	fusion          = 5,    // reads what the drivers before it reported
 	numSensorDrivers,
-        numFds,
     };
 
-    static const size_t wake = numFds - 1;
-    static const char WAKE_MESSAGE = 'W';
-    struct pollfd mPollFds[numFds];
-    int mWritePipeFd;
+    static const int numHandles = ID_LA + 1;
+    static const size_t maxFds = numSensorDrivers * SENSOR_MAX_FDS + 1;
+    // the fds of driver i from mFirstFd[i], the wake eventfd last
+    struct pollfd mPollFds[maxFds];
+    int mFirstFd[numSensorDrivers];
+    int mNumFds;
+    int mWake;
+    // drivers activate() turned on, and those the poll set was built for,
+    // nothing else is read or polled
+    volatile int32_t mEnabledDrivers;
+    int32_t mPolledDrivers;
+    // batching drivers kept out of the poll set until their batch is due
+    int32_t mHeldDrivers;
     SensorBase* mSensors[numSensorDrivers];
+    SensorFusion* mFusion;
 
     // For keeping track of usage (only count from system)
     bool mAccelActive;
     bool mMagnetActive;
     bool mOrientationActive;
 
+    // Delays asked for each handle, -1 before the first, the handles the
+    // system enabled, and the delay each driver was last set to
+    int64_t mDelays[numHandles];
+    uint32_t mActiveHandles;
+    int64_t mDriverDelay[numSensorDrivers];
+
     int real_activate(int handle, int enabled);
+    void setDriverEnabled(int driver, bool enabled);
+    void wake();
+    int updateDelay(int driver);
+    void addPollFds(int driver);
+    int endFd(int driver) const {
+        return (driver + 1 < numSensorDrivers) ? mFirstFd[driver + 1] : mWake;
+    }
+    int armBatchedFds(int timeout);
+
+    // The handle a driver takes the delay of a sensor it feeds with, -1
+    // when the sensor does not run off that driver
+    int delayHandle(int handle, int driver) const {
+        if (handleToDriver(handle) == driver)
+            return handle;
+        switch (handle) {
+            case ID_RV:
+                if (driver == yamaha)
+                    return ID_M;
+                // fall through
+            case ID_GR:
+            case ID_LA:
+                if (driver == bosch)
+                    return ID_A;
+        }
+        return -1;
+    }
 
     int handleToDriver(int handle) const {
         switch (handle) {
@@ -167,6 +236,10 @@ private:
                 return proximity;
             case ID_L:
                 return light;
+            case ID_RV:
+            case ID_GR:
+            case ID_LA:
+                return fusion;
                  
         }
         return -EINVAL;
@@ -177,102 +250,261 @@ private:
 
 sensors_poll_context_t::sensors_poll_context_t()
 {
-    mSensors[light] = new LightSensor();
-    mPollFds[light].fd = mSensors[light]->getFd();
-    mPollFds[light].events = POLLIN;
-    mPollFds[light].revents = 0;
+    struct sec_startup startup;
+    sec_startup_begin(&startup, "sensors");
 
+    // the first openInput() names every /dev/input node for all of them
+    mSensors[light] = new LightSensor();
+    sec_startup_phase(&startup, "light");
     mSensors[proximity] = new ProximitySensor();
-    mPollFds[proximity].fd = mSensors[proximity]->getFd();
-    mPollFds[proximity].events = POLLIN;
-    mPollFds[proximity].revents = 0;
-
+    sec_startup_phase(&startup, "proximity");
     mSensors[bosch] = new Smb380Sensor();
-    mPollFds[bosch].fd = mSensors[bosch]->getFd();
-    mPollFds[bosch].events = POLLIN;
-    mPollFds[bosch].revents = 0;
-
+    sec_startup_phase(&startup, "accel");
     mSensors[yamaha] = new CompassSensor();
-    mPollFds[yamaha].fd = mSensors[yamaha]->getFd();
-    mPollFds[yamaha].events = POLLIN;
-    mPollFds[yamaha].revents = 0;
-
+    sec_startup_phase(&startup, "compass");
     mSensors[orientation] = new OrientationSensor();
-    mPollFds[orientation].fd = mSensors[orientation]->getFd();
-    mPollFds[orientation].events = POLLIN;
-    mPollFds[orientation].revents = 0;
+    sec_startup_phase(&startup, "orientation");
+    mFusion = new SensorFusion();
+    mSensors[fusion] = mFusion;
+    sec_startup_phase(&startup, "fusion");
 
-    int wakeFds[2];
-    int result = pipe(wakeFds);
-    ALOGE_IF(result<0, "error creating wake pipe (%s)", strerror(errno));
-    fcntl(wakeFds[0], F_SETFL, O_NONBLOCK);
-    fcntl(wakeFds[1], F_SETFL, O_NONBLOCK);
-    mWritePipeFd = wakeFds[1];
+    mNumFds = 0;
+    for (int i=0 ; i<numSensorDrivers ; i++) {
+        addPollFds(i);
+    }
 
-    mPollFds[wake].fd = wakeFds[0];
-    mPollFds[wake].events = POLLIN;
-    mPollFds[wake].revents = 0;
+    int wakeFd = eventfd(0, EFD_NONBLOCK);
+    ALOGE_IF(wakeFd<0, "error creating wake eventfd (%s)", strerror(errno));
+
+    mWake = mNumFds++;
+    mPollFds[mWake].fd = wakeFd;
+    mPollFds[mWake].events = POLLIN;
+    mPollFds[mWake].revents = 0;
+
+    mEnabledDrivers = 0;
+    mPolledDrivers = 0;
+    mHeldDrivers = 0;
 
     mAccelActive = false;
     mMagnetActive = false;
     mOrientationActive = false;
+
+    for (int i=0 ; i<numHandles ; i++) {
+        mDelays[i] = -1;
+    }
+    mActiveHandles = 0;
+    for (int i=0 ; i<numSensorDrivers ; i++) {
+        mDriverDelay[i] = -1;
+    }
+    sec_startup_phase(&startup, "pollset");
+    sec_startup_end(&startup, 0);
 }
 
 sensors_poll_context_t::~sensors_poll_context_t() {
     for (int i=0 ; i<numSensorDrivers ; i++) {
         delete mSensors[i];
     }
-    close(mPollFds[wake].fd);
-    close(mWritePipeFd);
+    close(mPollFds[mWake].fd);
+}
+
+void sensors_poll_context_t::addPollFds(int driver) {
+    int n = mSensors[driver]->getFdCount();
+    if (n > SENSOR_MAX_FDS)
+        n = SENSOR_MAX_FDS;
+
+    // polled once activate() enables the driver
+    mFirstFd[driver] = mNumFds;
+    for (int j=0 ; j<n ; j++) {
+        mPollFds[mNumFds].fd = -1;
+        mPollFds[mNumFds].events = POLLIN;
+        mPollFds[mNumFds].revents = 0;
+        mNumFds++;
+    }
 }
 
 int sensors_poll_context_t::activate(int handle, int enabled) {
     int err;
 
-    // Orientation requires accelerometer and magnetic sensor
-    if (handle == ID_O) {
-        mOrientationActive = enabled ? true : false;
-        if (!mAccelActive) {
-            err = real_activate(ID_A, enabled);
-            if (err) return err;
-        }
-        if (!mMagnetActive) {
-            err = real_activate(ID_M, enabled);
-            if (err) return err;
-        }
-    }
-    // Keep track of magnetic and accelerometer use from system
-    else if (handle == ID_A) {
-        mAccelActive = enabled ? true : false;
-        // No need to enable or disable if orientation sensor is active as that will handle it
-        if (mOrientationActive) return 0;
+    if (handleToDriver(handle) < 0) return -EINVAL;
+    if (enabled)
+        mActiveHandles |= 1 << handle;
+    else
+        mActiveHandles &= ~(1 << handle);
+    // the rates follow what is left enabled before anything starts
+    for (int i=0 ; i<numSensorDrivers ; i++) {
+        updateDelay(i);
     }
-    else if (handle == ID_M) {
-        mMagnetActive = enabled ? true : false;
-        // No need to enable or disable if orientation sensor is active as that will handle it
-        if (mOrientationActive) return 0;
+
+    switch (handle) {
+        // Keep track of magnetic and accelerometer use from system
+        case ID_A:
+            mAccelActive = enabled ? true : false;
+            break;
+        case ID_M:
+            mMagnetActive = enabled ? true : false;
+            break;
+        case ID_O:
+            mOrientationActive = enabled ? true : false;
+            break;
+        case ID_RV:
+        case ID_GR:
+        case ID_LA:
+            err = mFusion->enable(handle, enabled);
+            if (err) return err;
+            setDriverEnabled(fusion, mFusion->wantsAccelerometer());
+            break;
+        default:
+            return real_activate(handle, enabled);
     }
 
-    return real_activate(handle, enabled);
+    // Orientation and the fused sensors require accelerometer and
+    // magnetic sensor, they stay on while anything uses them
+    err = real_activate(ID_A, mAccelActive || mOrientationActive ||
+                              mFusion->wantsAccelerometer());
+    if (err) return err;
+    err = real_activate(ID_M, mMagnetActive || mOrientationActive ||
+                              mFusion->wantsMagneticField());
+    if (err) return err;
+
+    if (handle == ID_O)
+        return real_activate(handle, enabled);
+    return 0;
 }
 
 int sensors_poll_context_t::real_activate(int handle, int enabled) {
     int index = handleToDriver(handle);
     if (index < 0) return index;
     int err =  mSensors[index]->enable(handle, enabled);
-    if (enabled && !err) {
-        const char wakeMessage(WAKE_MESSAGE);
-        int result = write(mWritePipeFd, &wakeMessage, 1);
-        ALOGE_IF(result<0, "error sending wake message (%s)", strerror(errno));
-    }
+    if (!err)
+        setDriverEnabled(index, enabled);
     return err;
 }
 
+void sensors_poll_context_t::setDriverEnabled(int driver, bool enabled) {
+    int32_t bit = 1 << driver;
+    if (bool(mEnabledDrivers & bit) == enabled)
+        return;
+    if (enabled)
+        android_atomic_or(bit, &mEnabledDrivers);
+    else
+        android_atomic_and(~bit, &mEnabledDrivers);
+    // the poll() in progress waits on the old poll set
+    wake();
+}
+
+void sensors_poll_context_t::wake() {
+    uint64_t one = 1;
+    int result = write(mPollFds[mWake].fd, &one, sizeof(one));
+    ALOGE_IF(result<0, "error sending wake event (%s)", strerror(errno));
+}
+
 int sensors_poll_context_t::setDelay(int handle, int64_t ns) {
 
     int index = handleToDriver(handle);
     if (index < 0) return index;
-    return mSensors[index]->setDelay(handle, ns);
+    if (ns < 0) return -EINVAL;
+    mDelays[handle] = ns;
+    if (index == fusion) {
+        // the fused sensors run at the rate of what feeds them
+        updateDelay(bosch);
+        updateDelay(yamaha);
+    }
+    return updateDelay(index);
+}
+
+/*
+ * Sets a driver to the shortest delay asked for the enabled sensors that
+ * run off it. The driver is only called when that delay changes, so
+ * clients coming and going at the same rate cost no sysfs writes.
+ */
+int sensors_poll_context_t::updateDelay(int driver) {
+    int64_t ns = -1;
+    int setHandle = -1;
+
+    for (int h=0 ; h<numHandles ; h++) {
+        if (!(mActiveHandles & (1 << h)) || mDelays[h] < 0)
+            continue;
+        if (delayHandle(h, driver) < 0)
+            continue;
+        if (setHandle < 0 || mDelays[h] < ns) {
+            ns = mDelays[h];
+            setHandle = h;
+        }
+    }
+    if (setHandle < 0 || ns == mDriverDelay[driver])
+        return 0;
+
+    int err = mSensors[driver]->setDelay(delayHandle(setHandle, driver), ns);
+    if (!err)
+        mDriverDelay[driver] = ns;
+    return err;
+}
+
+int sensors_poll_context_t::batch(int handle, int flags, int64_t period_ns, int64_t timeout) {
+
+    int index = handleToDriver(handle);
+    if (index < 0) return index;
+#ifdef SENSORS_BATCH_DRY_RUN
+    if (flags & SENSORS_BATCH_DRY_RUN)
+        return 0;
+#endif
+    int err = setDelay(handle, period_ns);
+    if (err) return err;
+    err = mSensors[index]->batch(handle, period_ns, timeout);
+    if (!err) {
+        // the poll() in progress waits on the old deadlines
+        wake();
+    }
+    return err;
+}
+
+/*
+ * Builds the poll set from the enabled drivers. A batching sensor stays
+ * out of poll() until its batch is due, its events wait with their
+ * input_event time in the evdev buffer meanwhile. Returns the poll()
+ * timeout in ms that wakes for the first batch due. Without a batching
+ * sensor this makes no syscall.
+ */
+int sensors_poll_context_t::armBatchedFds(int timeout) {
+    int32_t enabled = mEnabledDrivers;
+    int64_t now = 0;
+
+    if (enabled != mPolledDrivers) {
+        // activation changed, the disabled drivers leave the poll set
+        for (int i=0 ; i<numSensorDrivers ; i++) {
+            bool on = enabled & (1 << i);
+            for (int j=mFirstFd[i] ; j<endFd(i) ; j++) {
+                mPollFds[j].fd = on ? mSensors[i]->getPollFd(j - mFirstFd[i]) : -1;
+                mPollFds[j].revents = 0;
+            }
+        }
+        mPolledDrivers = enabled;
+        mHeldDrivers = 0;
+    }
+
+    for (int i=0 ; i<numSensorDrivers ; i++) {
+        if (!(enabled & (1 << i)))
+            continue;
+        int64_t deadline = mSensors[i]->batchDeadline();
+        if (!deadline && !(mHeldDrivers & (1 << i)))
+            continue;
+        if (deadline && !now)
+            now = SensorBase::getTimestamp();
+        int last = endFd(i);
+        bool due = (deadline <= now);
+        for (int j=mFirstFd[i] ; j<last ; j++) {
+            mPollFds[j].fd = due ? mSensors[i]->getPollFd(j - mFirstFd[i]) : -1;
+        }
+        if (due) {
+            mHeldDrivers &= ~(1 << i);
+        } else {
+            mHeldDrivers |= 1 << i;
+            int ms = int((deadline - now + 999999) / 1000000);
+            if (timeout < 0 || ms < timeout)
+                timeout = ms;
+        }
+    }
+    return timeout;
 }
 
 int sensors_poll_context_t::pollEvents(sensors_event_t* data, int count)
@@ -283,12 +515,27 @@ int sensors_poll_context_t::pollEvents(sensors_event_t* data, int count)
     do {
         // see if we have some leftover from the last poll()
         for (int i=0 ; count && i<numSensorDrivers ; i++) {
+            if (!(mPolledDrivers & (1 << i)))
+                continue;
             SensorBase* const sensor(mSensors[i]);
-            if ((mPollFds[i].revents & POLLIN) || (sensor->hasPendingEvents())) {
+            int last = endFd(i);
+            uint32_t ready = 0;
+            for (int j=mFirstFd[i] ; j<last ; j++) {
+                if (mPollFds[j].revents & POLLIN)
+                    ready |= 1 << (j - mFirstFd[i]);
+            }
+            if (ready || (sensor->hasPendingEvents())) {
+                // a driver only fills from the fds poll() found readable
+                sensor->setReadyFds(ready);
                 int nb = sensor->readEvents(data, count);
+                if (nb > 0 && i != fusion)
+                    mFusion->process(data, nb);
                 if (nb < count) {
                     // no more data for this sensor
-                    mPollFds[i].revents = 0;
+                    for (int j=mFirstFd[i] ; j<last ; j++)
+                        mPollFds[j].revents = 0;
+                    if (sensor->batchDeadline())
+                        sensor->batchDelivered(SensorBase::getTimestamp());
                 }
                 count -= nb;
                 nbEvents += nb;
@@ -300,24 +547,25 @@ int sensors_poll_context_t::pollEvents(sensors_event_t* data, int count)
             // we still have some room, so try to see if we can get
             // some events immediately or just wait if we don't have
             // anything to return
+            int timeout = armBatchedFds(nbEvents ? 0 : -1);
             do {
-            n = poll(mPollFds, numFds, nbEvents ? 0 : -1);
+            n = poll(mPollFds, mNumFds, timeout);
             } while (n < 0 && errno == EINTR);
             if (n<0) {
                 ALOGE("poll() failed (%s)", strerror(errno));
                 return -errno;
             }
-            if (mPollFds[wake].revents & POLLIN) {
-                char msg;
-                int result = read(mPollFds[wake].fd, &msg, 1);
-                ALOGE_IF(result<0, "error reading from wake pipe (%s)", strerror(errno));
-                ALOGE_IF(msg != WAKE_MESSAGE, "unknown message on wake queue (0x%02x)", int(msg));
+            if (mPollFds[mWake].revents & POLLIN) {
+                uint64_t wakes;
+                int result = read(mPollFds[mWake].fd, &wakes, sizeof(wakes));
+                ALOGE_IF(result<0, "error reading from wake eventfd (%s)", strerror(errno));
 
-                mPollFds[wake].revents = 0;
+                mPollFds[mWake].revents = 0;
             }
         }
-        // if we have events and space, go read them
-    } while (n && count);
+        // if we have events and space, go read them, a batch coming due
+        // times the poll() out with nothing read yet
+    } while ((n || !nbEvents) && count);
 
     return nbEvents;
 }
@@ -351,6 +599,14 @@ static int poll__poll(struct sensors_poll_device_t *dev,
     return ctx->pollEvents(data, count);
 }
 
+#ifdef SENSORS_DEVICE_API_VERSION_1_0
+static int poll__batch(struct sensors_poll_device_1 *dev,
+        int handle, int flags, int64_t period_ns, int64_t timeout) {
+    sensors_poll_context_t *ctx = (sensors_poll_context_t *)dev;
+    return ctx->batch(handle, flags, period_ns, timeout);
+}
+#endif
+
 /*****************************************************************************/
 
 /** Open a new instance of a sensor device using name */
@@ -360,10 +616,15 @@ static int open_sensors(const struct hw_module_t* module, const char* id,
         int status = -EINVAL;
         sensors_poll_context_t *dev = new sensors_poll_context_t();
 
-        memset(&dev->device, 0, sizeof(sensors_poll_device_t));
+        memset(&dev->device, 0, sizeof(dev->device));
 
         dev->device.common.tag = HARDWARE_DEVICE_TAG;
+#ifdef SENSORS_DEVICE_API_VERSION_1_0
+        dev->device.common.version  = SENSORS_DEVICE_API_VERSION_1_0;
+        dev->device.batch           = poll__batch;
+#else
         dev->device.common.version  = 0;
+#endif
         dev->device.common.module   = const_cast<hw_module_t*>(module);
         dev->device.common.close    = poll__close;
         dev->device.activate        = poll__activate;
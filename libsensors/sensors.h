@@ -39,6 +39,10 @@ __BEGIN_DECLS
 #define ID_L  (3)
 #define ID_P  (4)
 #define ID_GY (5)
+/* computed in the HAL by SensorFusion */
+#define ID_RV (6)
+#define ID_GR (7)
+#define ID_LA (8)
 
 /*****************************************************************************/
 
@@ -0,0 +1,374 @@
+/*
+ * Copyright (C) 2008 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Opens the sensors HAL the way the SensorService does, enables sets of
+ * sensors at given rates and measures what comes out of poll(): the rate
+ * reached against the one asked, the latency from the event timestamp to
+ * its delivery, the jitter of the intervals between events, the wakeups
+ * and read()s per event and the cpu the run cost. With -b the sensors
+ * batch, which needs a 1.0 HAL.
+ *
+ * usage: sensors-bench [-t seconds per run] [-c config] [-b max latency ms]
+ *
+ * read()s come from /proc/self/io, the HAL's event reads and the bench's
+ * own few /proc reads, and wakeups are the thread's voluntary context
+ * switches. An exact syscall count needs strace.
+ *
+ * the config of a result is the set of sensors and rates of the run.
+ */
+
+#include <hardware/sensors.h>
+#include <utils/Timers.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include <sec_bench.h>
+
+using namespace android;
+
+// events kept per sensor and run, the rest only count
+#define BENCH_MAX_EVENTS    4096
+// a timestamp further off than this is not on the monotonic clock
+#define BENCH_CLOCK_SLACK   10000000000LL
+
+struct BenchSensor {
+    int         type;
+    int64_t     delay;      // ns
+};
+
+struct BenchConfig {
+    const char*  name;
+    BenchSensor  sensors[4];
+};
+
+static const BenchConfig kConfigs[] = {
+    { "accel.normal",   { { SENSOR_TYPE_ACCELEROMETER,  200000000 } } },
+    { "accel.game",     { { SENSOR_TYPE_ACCELEROMETER,   20000000 } } },
+    { "accel.fastest",  { { SENSOR_TYPE_ACCELEROMETER,          0 } } },
+    { "mag.game",       { { SENSOR_TYPE_MAGNETIC_FIELD,  20000000 } } },
+    { "orient.game",    { { SENSOR_TYPE_ORIENTATION,     20000000 } } },
+    { "light",          { { SENSOR_TYPE_LIGHT,          200000000 } } },
+    { "proximity",      { { SENSOR_TYPE_PROXIMITY,      200000000 } } },
+    { "gyro.game",      { { SENSOR_TYPE_GYROSCOPE,       20000000 } } },
+    { "accel+mag",      { { SENSOR_TYPE_ACCELEROMETER,   20000000 },
+                          { SENSOR_TYPE_MAGNETIC_FIELD,  60000000 } } },
+    { "accel+mag+orient", { { SENSOR_TYPE_ACCELEROMETER, 20000000 },
+                            { SENSOR_TYPE_MAGNETIC_FIELD, 20000000 },
+                            { SENSOR_TYPE_ORIENTATION,   20000000 } } },
+    { "accel+light+prox", { { SENSOR_TYPE_ACCELEROMETER, 20000000 },
+                            { SENSOR_TYPE_LIGHT,        200000000 },
+                            { SENSOR_TYPE_PROXIMITY,    200000000 } } },
+    { "fused.game",     { { SENSOR_TYPE_ROTATION_VECTOR, 20000000 },
+                          { SENSOR_TYPE_GRAVITY,         20000000 },
+                          { SENSOR_TYPE_LINEAR_ACCELERATION, 20000000 } } },
+};
+
+#define NUM_CONFIGS (sizeof(kConfigs) / sizeof(kConfigs[0]))
+#define MAX_SENSORS (sizeof(kConfigs[0].sensors) / sizeof(kConfigs[0].sensors[0]))
+
+// ---------------------------------------------------------------------------
+// measurements
+
+struct SensorRun {
+    const sensor_t* sensor;
+    int64_t         delay;
+    int             count;
+    int             kept;
+    nsecs_t*        latency;
+    nsecs_t*        timestamp;
+};
+
+struct ProcessCounters {
+    nsecs_t     cpu;
+    long        wakeups;
+    long long   reads;
+};
+
+static nsecs_t timevalToNsecs(const struct timeval &tv)
+{
+    return (nsecs_t)tv.tv_sec * 1000000000LL + tv.tv_usec * 1000LL;
+}
+
+// the HAL runs in the calling thread, the process is all of it
+static void readCounters(ProcessCounters *c)
+{
+    struct rusage ru;
+    FILE *f;
+
+    memset(c, 0, sizeof(*c));
+    if (!getrusage(RUSAGE_SELF, &ru)) {
+        c->cpu = timevalToNsecs(ru.ru_utime) + timevalToNsecs(ru.ru_stime);
+        c->wakeups = ru.ru_nvcsw;
+    }
+    f = fopen("/proc/self/io", "r");
+    if (f) {
+        char line[64];
+        while (fgets(line, sizeof(line), f)) {
+            if (sscanf(line, "syscr: %lld", &c->reads) == 1)
+                break;
+        }
+        fclose(f);
+    }
+}
+
+static int compareNsecs(const void *a, const void *b)
+{
+    nsecs_t x = *(const nsecs_t *)a;
+    nsecs_t y = *(const nsecs_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static const sensor_t* findSensor(const sensor_t *list, int n, int type)
+{
+    for (int i = 0; i < n; i++) {
+        if (list[i].type == type)
+            return &list[i];
+    }
+    return NULL;
+}
+
+static void report(const char *config, SensorRun *run, nsecs_t duration)
+{
+    char name[64];
+    int n = run->kept;
+
+    snprintf(name, sizeof(name), "%s/%s", config, run->sensor->name);
+    for (char *p = name; *p; p++) {
+        if (*p == ' ')
+            *p = '_';
+    }
+
+    RESULT(name, "events", run->count, "events");
+    if (n < 2 || run->timestamp[n - 1] <= run->timestamp[0]) {
+        LOGE("%s:: %s reported %d events", __func__, name, run->count);
+        return;
+    }
+
+    {
+        nsecs_t span = run->timestamp[n - 1] - run->timestamp[0];
+        double rate = (n - 1) * 1000000000.0 / span;
+        double mean = span / (double)(n - 1), var = 0;
+        nsecs_t *interval = new nsecs_t[n - 1];
+
+        if (run->delay > 0)
+            RESULT(name, "rate_asked", 1000000000.0 / run->delay, "Hz");
+        RESULT(name, "rate", rate, "Hz");
+        RESULT(name, "rate_delivered", run->count * 1000000000.0 / duration, "Hz");
+
+        for (int i = 1; i < n; i++) {
+            interval[i - 1] = run->timestamp[i] - run->timestamp[i - 1];
+            var += (interval[i - 1] - mean) * (interval[i - 1] - mean);
+        }
+        qsort(interval, n - 1, sizeof(nsecs_t), compareNsecs);
+        RESULT(name, "interval_mean", mean / 1000000.0, "ms");
+        RESULT(name, "jitter_stddev", sqrt(var / (n - 1)) / 1000000.0, "ms");
+        RESULT(name, "interval_p10", interval[(n - 1) / 10] / 1000000.0, "ms");
+        RESULT(name, "interval_p90", interval[(n - 1) * 9 / 10] / 1000000.0, "ms");
+        delete [] interval;
+
+        qsort(run->latency, n, sizeof(nsecs_t), compareNsecs);
+        if (run->latency[0] < -BENCH_CLOCK_SLACK || run->latency[n - 1] > BENCH_CLOCK_SLACK) {
+            // the input device stamps with the wall clock
+            LOGE("%s:: %s timestamps are not monotonic, no latency", __func__, name);
+            return;
+        }
+        RESULT(name, "latency_p50", run->latency[n / 2] / 1000000.0, "ms");
+        RESULT(name, "latency_p90", run->latency[n * 9 / 10] / 1000000.0, "ms");
+        RESULT(name, "latency_max", run->latency[n - 1] / 1000000.0, "ms");
+    }
+}
+
+static int runConfig(sensors_poll_device_t *dev, const sensor_t *list, int numSensors,
+                     const BenchConfig *config, int seconds, int64_t maxLatency)
+{
+    SensorRun runs[MAX_SENSORS];
+    int numRuns = 0;
+    ProcessCounters c0, c1;
+    sensors_event_t events[16];
+    int polls = 0, total = 0;
+    int ret = 0;
+
+    for (size_t i = 0; i < MAX_SENSORS && config->sensors[i].type; i++) {
+        const sensor_t *s = findSensor(list, numSensors, config->sensors[i].type);
+        if (!s) {
+            LOGI("%s:: %s: no sensor of type %d, skipped", __func__,
+                  config->name, config->sensors[i].type);
+            return 0;
+        }
+        runs[numRuns].sensor = s;
+        runs[numRuns].delay = config->sensors[i].delay;
+        if (runs[numRuns].delay < s->minDelay * 1000LL)
+            runs[numRuns].delay = s->minDelay * 1000LL;
+        runs[numRuns].count = 0;
+        runs[numRuns].kept = 0;
+        runs[numRuns].latency = new nsecs_t[BENCH_MAX_EVENTS];
+        runs[numRuns].timestamp = new nsecs_t[BENCH_MAX_EVENTS];
+        numRuns++;
+    }
+
+    for (int i = 0; i < numRuns; i++) {
+        int handle = runs[i].sensor->handle;
+        int err;
+#ifdef SENSORS_DEVICE_API_VERSION_1_0
+        if (maxLatency && dev->common.version >= SENSORS_DEVICE_API_VERSION_1_0) {
+            sensors_poll_device_1_t *dev1 = (sensors_poll_device_1_t *)dev;
+            err = dev1->batch(dev1, handle, 0, runs[i].delay, maxLatency);
+        } else
+#endif
+            err = dev->setDelay(dev, handle, runs[i].delay);
+        if (!err)
+            err = dev->activate(dev, handle, 1);
+        if (err) {
+            LOGE("%s:: %s: can't enable %s (%d)", __func__, config->name,
+                  runs[i].sensor->name, err);
+            ret = -1;
+        }
+    }
+
+    LOGI("%s:: %s for %d s", __func__, config->name, seconds);
+    // what was queued before the rates were set does not count
+    nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC) + 500000000LL;
+    nsecs_t end = start + seconds * 1000000000LL;
+    bool counting = false;
+
+    while (systemTime(SYSTEM_TIME_MONOTONIC) < end) {
+        int n = dev->poll(dev, events, sizeof(events) / sizeof(events[0]));
+        nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+        if (n < 0) {
+            LOGE("%s:: poll failed (%d)", __func__, n);
+            ret = -1;
+            break;
+        }
+        if (!counting) {
+            if (now < start)
+                continue;
+            counting = true;
+            start = now;
+            readCounters(&c0);
+            continue;
+        }
+        polls++;
+        for (int e = 0; e < n; e++) {
+            for (int i = 0; i < numRuns; i++) {
+                if (events[e].sensor != runs[i].sensor->handle)
+                    continue;
+                SensorRun *run = &runs[i];
+                if (run->kept < BENCH_MAX_EVENTS) {
+                    run->latency[run->kept] = now - events[e].timestamp;
+                    run->timestamp[run->kept] = events[e].timestamp;
+                    run->kept++;
+                }
+                run->count++;
+                total++;
+            }
+        }
+    }
+    nsecs_t duration = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+    readCounters(&c1);
+
+    for (int i = 0; i < numRuns; i++)
+        dev->activate(dev, runs[i].sensor->handle, 0);
+
+    if (counting) {
+        for (int i = 0; i < numRuns; i++)
+            report(config->name, &runs[i], duration);
+        RESULT(config->name, "events_total", total, "events");
+        if (total) {
+            RESULT(config->name, "polls_per_event", (double)polls / total, "calls");
+            RESULT(config->name, "wakeups_per_event", (double)(c1.wakeups - c0.wakeups) / total, "switches");
+            RESULT(config->name, "reads_per_event", (double)(c1.reads - c0.reads) / total, "syscalls");
+            RESULT(config->name, "cpu_per_event", (double)(c1.cpu - c0.cpu) / total / 1000.0, "us");
+        }
+        RESULT(config->name, "cpu", 100.0 * (c1.cpu - c0.cpu) / duration, "%");
+    }
+
+    for (int i = 0; i < numRuns; i++) {
+        delete [] runs[i].latency;
+        delete [] runs[i].timestamp;
+    }
+    return ret;
+}
+
+int main(int argc, char** argv) {
+    sensors_module_t*      module;
+    sensors_poll_device_t* dev;
+    const sensor_t*        list;
+    const char*            only = NULL;
+    int                    seconds = 10;
+    int64_t                maxLatency = 0;
+    int                    numSensors;
+    int                    opt;
+    int                    ret;
+
+    while ((opt = getopt(argc, argv, "t:c:b:")) != -1) {
+        switch (opt) {
+        case 't':
+            seconds = atoi(optarg);
+            break;
+        case 'c':
+            only = optarg;
+            break;
+        case 'b':
+            maxLatency = atoll(optarg) * 1000000LL;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-t seconds per run] [-c config] [-b max latency ms]\n", argv[0]);
+            return -EINVAL;
+        }
+    }
+
+    ret = hw_get_module(SENSORS_HARDWARE_MODULE_ID, (const hw_module_t**)&module);
+    if (ret) {
+        LOGE("%s:: no sensors module (%d)", __func__, ret);
+        return -ENODEV;
+    }
+
+    ret = module->common.methods->open(&module->common, SENSORS_HARDWARE_POLL,
+                                       (hw_device_t**)&dev);
+    if (ret < 0) {
+        LOGE("%s:: can't open the sensors device (%d)", __func__, ret);
+        return ret;
+    }
+
+    numSensors = module->get_sensors_list(module, &list);
+#ifdef SENSORS_DEVICE_API_VERSION_1_0
+    if (maxLatency && dev->common.version < SENSORS_DEVICE_API_VERSION_1_0)
+#else
+    if (maxLatency)
+#endif
+        LOGE("%s:: the HAL can't batch, -b ignored", __func__);
+
+    for (size_t i = 0; i < NUM_CONFIGS; i++) {
+        if (only && strcmp(only, kConfigs[i].name))
+            continue;
+        if (runConfig(dev, list, numSensors, &kConfigs[i], seconds, maxLatency) < 0)
+            ret = -1;
+    }
+
+    dev->common.close(&dev->common);
+
+    LOGI("Sensors bench result: %d", ret);
+    return ret;
+}
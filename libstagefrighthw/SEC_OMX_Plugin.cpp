@@ -17,6 +17,7 @@
 #include "SEC_OMX_Plugin.h"
 
 #include <dlfcn.h>
+#include <string.h>
 
 #include <HardwareAPI.h>
 
@@ -50,6 +51,7 @@ SECOMXPlugin::SECOMXPlugin()
 
         (*mInit)();
 
+        buildComponentTable();
     }
 }
 
@@ -94,7 +96,16 @@ OMX_ERRORTYPE SECOMXPlugin::enumerateComponents(
         return OMX_ErrorUndefined;
     }
 
-    return (*mComponentNameEnum)(name, size, index);
+    if (index >= mComponents.size()) {
+        return OMX_ErrorNoMore;
+    }
+
+    strncpy(name, mComponents[index].mName.string(), size);
+    if (size > 0) {
+        name[size - 1] = '\0';
+    }
+
+    return OMX_ErrorNone;
 }
 
 OMX_ERRORTYPE SECOMXPlugin::getRolesOfComponent(
@@ -106,6 +117,42 @@ OMX_ERRORTYPE SECOMXPlugin::getRolesOfComponent(
         return OMX_ErrorUndefined;
     }
 
+    for (size_t i = 0; i < mComponents.size(); ++i) {
+        if (!strcmp(mComponents[i].mName.string(), name)) {
+            *roles = mComponents[i].mRoles;
+            return OMX_ErrorNone;
+        }
+    }
+
+    return OMX_ErrorComponentNotFound;
+}
+
+void SECOMXPlugin::buildComponentTable() {
+    char name[OMX_MAX_STRINGNAME_SIZE];
+
+    for (OMX_U32 index = 0;
+         (*mComponentNameEnum)(name, sizeof(name), index) == OMX_ErrorNone;
+         ++index) {
+        ComponentInfo info;
+        info.mName.setTo(name);
+
+        if (queryRolesOfComponent(name, &info.mRoles) != OMX_ErrorNone) {
+            continue;
+        }
+
+        mComponents.push(info);
+    }
+}
+
+OMX_ERRORTYPE SECOMXPlugin::queryRolesOfComponent(
+        const char *name,
+        Vector<String8> *roles) {
+    roles->clear();
+
+    if (mLibHandle == NULL) {
+        return OMX_ErrorUndefined;
+    }
+
     OMX_U32 numRoles;
     OMX_ERRORTYPE err = (*mGetRolesOfComponentHandle)(
             const_cast<OMX_STRING>(name), &numRoles, NULL);
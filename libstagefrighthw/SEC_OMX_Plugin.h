@@ -45,8 +45,17 @@ struct SECOMXPlugin : public OMXPluginBase {
             Vector<String8> *roles);
 
 private:
+    struct ComponentInfo {
+        String8 mName;
+        Vector<String8> mRoles;
+    };
+
     void *mLibHandle;
 
+    // filled once at construction and read only after that, so that
+    // the enumeration queries of every player creation stay out of the core
+    Vector<ComponentInfo> mComponents;
+
     typedef OMX_ERRORTYPE (*InitFunc)();
     typedef OMX_ERRORTYPE (*DeinitFunc)();
     typedef OMX_ERRORTYPE (*ComponentNameEnumFunc)(
@@ -67,6 +76,10 @@ private:
     FreeHandleFunc mFreeHandle;
     GetRolesOfComponentFunc mGetRolesOfComponentHandle;
 
+    void buildComponentTable();
+    OMX_ERRORTYPE queryRolesOfComponent(
+            const char *name, Vector<String8> *roles);
+
     SECOMXPlugin(const SECOMXPlugin &);
     SECOMXPlugin &operator=(const SECOMXPlugin &);
 };
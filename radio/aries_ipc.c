@@ -28,12 +28,16 @@
 #include <termios.h>
 #include <fcntl.h>
 #include <string.h>
+#include <time.h>
+#include <poll.h>
+#include <pthread.h>
 #include <sys/mman.h>
 #include <sys/ioctl.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/ioctl.h>
+#include <sys/uio.h>
 #include <linux/netlink.h>
 #include <net/if.h>
 #include <asm/types.h>
@@ -130,6 +134,65 @@ phonet_iface_ifup()
     return 0;
 }
 
+static long long
+aries_boot_time_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+/* Logs how long the bootstrap phase that just ended took. */
+#define BOOT_PHASE(name) \
+    IPC_LOG("%s: %s took %lld ms", __func__, name, aries_boot_time_ms() - phase_start); \
+    phase_start = aries_boot_time_ms();
+
+/*
+ * Maps the radio image instead of reading it. The readahead runs in the
+ * background while the modem is power cycled and handshaken on the serial
+ * line, the copy to onedram then mostly finds it in the page cache. Falls
+ * back to reading it in one block when the device can't be mapped.
+ */
+static uint8_t *
+aries_radio_img_map(struct ipc_client *client, int *mapped)
+{
+    uint8_t *radio_img_p;
+    int fd;
+
+    *mapped = 0;
+
+    fd = open(RADIO_IMG_DEV, O_RDONLY);
+    if(fd >= 0) {
+        radio_img_p = mmap(NULL, RADIO_IMG_READ_SIZE, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+
+        if(radio_img_p != MAP_FAILED) {
+            madvise(radio_img_p, RADIO_IMG_READ_SIZE, MADV_SEQUENTIAL);
+            madvise(radio_img_p, RADIO_IMG_READ_SIZE, MADV_WILLNEED);
+            *mapped = 1;
+            return radio_img_p;
+        }
+    }
+
+    IPC_LOG("%s: can't map %s[%s], reading it", __func__, RADIO_IMG_DEV, strerror(errno));
+
+    return ipc_mtd_read(client, RADIO_IMG_DEV, RADIO_IMG_READ_SIZE, RADIO_IMG_READ_SIZE);
+}
+
+static void
+aries_radio_img_release(uint8_t *radio_img_p, int mapped)
+{
+    if(radio_img_p == NULL)
+        return;
+
+    if(mapped)
+        munmap(radio_img_p, RADIO_IMG_READ_SIZE);
+    else
+        free(radio_img_p);
+}
+
 static int
 aries_modem_bootstrap(struct ipc_client *client)
 {
@@ -142,6 +205,7 @@ aries_modem_bootstrap(struct ipc_client *client)
 
     /* Boot variables */
     uint8_t *radio_img_p = NULL;
+    int radio_img_mapped = 0;
     uint32_t onedram_data = 0;
     uint8_t bootcore_version = 0;
     uint8_t info_size = 0;
@@ -160,6 +224,10 @@ aries_modem_bootstrap(struct ipc_client *client)
     void *nv_data_p;
     void *onedram_p;
 
+    /* Phase timing variables. */
+    long long boot_start;
+    long long phase_start;
+
     /* General purpose variables. */
     uint8_t data;
     uint16_t data_16;
@@ -168,16 +236,30 @@ aries_modem_bootstrap(struct ipc_client *client)
 
     IPC_LOG("%s: enter", __func__);
 
+    boot_start = phase_start = aries_boot_time_ms();
+
 boot_loop_start:
     if(boot_tries_count > 5) {
         IPC_LOG("%s: boot has failed too many times.", __func__);
         goto error;
     }
 
-    /* Read the radio.img image. */
-    IPC_LOG("%s: reading radio image", __func__);
-    radio_img_p = ipc_mtd_read(client, "/dev/block/bml12", RADIO_IMG_READ_SIZE, RADIO_IMG_READ_SIZE);
-    IPC_LOG("%s: radio image read", __func__);
+    /* Map the radio.img image, a retry keeps the one already there. */
+    if(radio_img_p == NULL) {
+        IPC_LOG("%s: mapping radio image", __func__);
+        radio_img_p = aries_radio_img_map(client, &radio_img_mapped);
+        if(radio_img_p == NULL) {
+            IPC_LOG("%s: can't get the radio image", __func__);
+            goto error;
+        }
+
+        /* The PSI crc only needs its first pages, the rest reads ahead meanwhile. */
+        crc_byte = 0;
+        for(i=0 ; i < PSI_DATA_LEN ; i++)
+            crc_byte = crc_byte ^ radio_img_p[i];
+
+        BOOT_PHASE("radio image setup");
+    }
 
     IPC_LOG("%s: open onedram", __func__);
     onedram_fd = open("/dev/onedram", O_RDWR);
@@ -196,6 +278,8 @@ boot_loop_start:
     IPC_LOG("%s: sent PHONE \"on\" command", __func__);
     usleep(200000);
 
+    BOOT_PHASE("modem power cycle");
+
     IPC_LOG("%s: open s3c2410_serial3", __func__);
     s3c2410_serial3_fd = open("/dev/s3c2410_serial3", O_RDWR);
     CHECK(s3c2410_serial3_fd,
@@ -238,6 +322,8 @@ boot_loop_start:
     read(s3c2410_serial3_fd, &info_size, sizeof(info_size));
     IPC_LOG("%s: got info_size: 0x%x", __func__, info_size);
 
+    BOOT_PHASE("bootcore handshake");
+
     /* Send PSI magic. */
     data = PSI_MAGIC;
     SELECT_WRITE_FDS(fds, timeout);
@@ -258,12 +344,17 @@ boot_loop_start:
 
     IPC_LOG("%s: sending the first part of radio.img", __func__);
 
-    for(i=0 ; i < PSI_DATA_LEN ; i++) {
+    /* The tty paces the line, hand it as much as it takes at once. */
+    for(i=0 ; i < PSI_DATA_LEN ; i += rc) {
         SELECT_WRITE_FDS(fds, timeout);
-        write(s3c2410_serial3_fd, data_p, 1);
-
-        crc_byte = crc_byte ^ *data_p;
-        data_p++;
+        rc = write(s3c2410_serial3_fd, data_p + i, PSI_DATA_LEN - i);
+        if(rc < 0) {
+            if(errno != EINTR && errno != EAGAIN) {
+                IPC_LOG("%s: can't write radio.img to serial[%s]", __func__, strerror(errno));
+                goto error_loop;
+            }
+            rc = 0;
+        }
     }
 
     IPC_LOG("%s: first part of radio.img sent; crc_byte is 0x%x", __func__, crc_byte);
@@ -286,6 +377,9 @@ boot_loop_start:
 
     IPC_LOG("%s: close s3c2410_serial3", __func__);
     close(s3c2410_serial3_fd);
+    s3c2410_serial3_fd = -1;
+
+    BOOT_PHASE("PSI transfer");
 
     FD_ZERO(&fds);
     FD_SET(onedram_fd, &fds);
@@ -299,6 +393,9 @@ boot_loop_start:
     }
 
     IPC_LOG("%s: got 0x%04x", __func__, onedram_data);
+
+    BOOT_PHASE("onedram init");
+
     IPC_LOG("%s: writing the rest of modem.img to onedram.", __func__);
 
     /* Pointer to the remaining part of radio.img. */
@@ -313,7 +410,10 @@ boot_loop_start:
     // it sometimes hangs here
     memcpy(onedram_p, data_p, RADIO_IMG_READ_SIZE - PSI_DATA_LEN);
 
-    free(radio_img_p);
+    aries_radio_img_release(radio_img_p, radio_img_mapped);
+    radio_img_p = NULL;
+
+    BOOT_PHASE("radio image copy");
 
     /* nv_data part. */
 
@@ -337,6 +437,8 @@ boot_loop_start:
 
     munmap(onedram_p, ONENAND_MAP_SIZE);
 
+    BOOT_PHASE("nv_data");
+
     if(ioctl(onedram_fd, ONEDRAM_REL_SEM) < 0) {
         IPC_LOG("%s: ONEDRAM_REL_SEM ioctl on onedram failed", __func__);
         goto error_loop;
@@ -358,29 +460,191 @@ boot_loop_start:
 
     close(onedram_fd);
 
+    BOOT_PHASE("onedram deinit");
+
     rc = 0;
     goto exit;
 
 error_loop:
     IPC_LOG("%s: something went wrong", __func__);
     boot_tries_count++;
+
+    if(s3c2410_serial3_fd >= 0) {
+        close(s3c2410_serial3_fd);
+        s3c2410_serial3_fd = -1;
+    }
+    if(onedram_fd >= 0) {
+        close(onedram_fd);
+        onedram_fd = -1;
+    }
+
     sleep(2);
 
+    phase_start = aries_boot_time_ms();
     goto boot_loop_start;
 
 error:
     IPC_LOG("%s: something went wrong", __func__);
     rc = -1;
 exit:
-    IPC_LOG("%s: exit", __func__);
+    aries_radio_img_release(radio_img_p, radio_img_mapped);
+    IPC_LOG("%s: exit after %lld ms", __func__, aries_boot_time_ms() - boot_start);
     return rc;
 }
 
+/*
+ * Trace of the messages the channels sent and received, cheap enough to stay
+ * on: a timestamp and a few stores per message, no formatting. Entries are
+ * written without a lock, one of those being overwritten while read can come
+ * out torn, which a trace can live with.
+ */
+struct aries_ipc_trace_start
+{
+    uint64_t time_us;
+    uint16_t command;
+};
+
+static struct aries_ipc_trace_entry aries_ipc_trace_ring[ARIES_IPC_TRACE_SIZE];
+static unsigned int aries_ipc_trace_count = 0;
+/* When the message that opened each sequence number of a channel was traced. */
+static struct aries_ipc_trace_start aries_ipc_trace_starts[2][256];
+
+static uint64_t
+aries_ipc_time_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+/*
+ * The RIL opens FMT transactions and the modem answers with the request's
+ * mseq as aseq. RFS goes the other way, the modem asks with an id the RIL
+ * sends back.
+ */
+static void
+aries_ipc_trace(struct ipc_client *client, int dir, struct ipc_message_info *info)
+{
+    struct aries_ipc_trace_entry *entry;
+    struct aries_ipc_trace_start *start;
+    uint64_t now = aries_ipc_time_us();
+    int channel = client->type == IPC_CLIENT_TYPE_RFS ? IPC_CLIENT_TYPE_RFS : IPC_CLIENT_TYPE_FMT;
+    uint16_t command = IPC_COMMAND(info);
+    unsigned int n;
+
+    start = &aries_ipc_trace_starts[channel == IPC_CLIENT_TYPE_RFS]
+                                   [dir == ARIES_IPC_TRACE_SEND ? info->mseq : info->aseq];
+
+    n = __sync_fetch_and_add(&aries_ipc_trace_count, 1);
+    entry = &aries_ipc_trace_ring[n % ARIES_IPC_TRACE_SIZE];
+
+    entry->time_us = now;
+    entry->latency_us = 0;
+    entry->length = info->length;
+    entry->channel = channel;
+    entry->dir = dir;
+    entry->group = info->group;
+    entry->index = info->index;
+    entry->type = info->type;
+    entry->mseq = info->mseq;
+    entry->aseq = info->aseq;
+
+    if((channel == IPC_CLIENT_TYPE_FMT) == (dir == ARIES_IPC_TRACE_SEND)) {
+        start->time_us = now;
+        start->command = command;
+    } else if(start->time_us != 0 && start->command == command) {
+        entry->latency_us = (uint32_t) (now - start->time_us);
+        start->time_us = 0;
+    }
+}
+
+int
+aries_ipc_trace_read(struct aries_ipc_trace_entry *entries, int count)
+{
+    unsigned int end = aries_ipc_trace_count;
+    unsigned int n;
+    int i;
+
+    if(entries == NULL || count <= 0)
+        return 0;
+
+    n = end < ARIES_IPC_TRACE_SIZE ? end : ARIES_IPC_TRACE_SIZE;
+    if((unsigned int) count < n)
+        n = count;
+
+    for(i=0 ; i < (int) n ; i++)
+        entries[i] = aries_ipc_trace_ring[(end - n + i) % ARIES_IPC_TRACE_SIZE];
+
+    return n;
+}
+
+void
+aries_ipc_trace_dump(struct ipc_client *client)
+{
+    struct aries_ipc_trace_entry entries[ARIES_IPC_TRACE_SIZE];
+    int count;
+    int i;
+
+    count = aries_ipc_trace_read(entries, ARIES_IPC_TRACE_SIZE);
+
+    IPC_LOG("%s: last %d messages", __func__, count);
+
+    for(i=0 ; i < count ; i++) {
+        IPC_LOG("%s: %llu.%06llu %s %s command=0x%04x type=0x%02x mseq=0x%02x aseq=0x%02x len=%d latency=%uus",
+                __func__, entries[i].time_us / 1000000, entries[i].time_us % 1000000,
+                entries[i].channel == IPC_CLIENT_TYPE_RFS ? "RFS" : "FMT",
+                entries[i].dir == ARIES_IPC_TRACE_SEND ? "send" : "recv",
+                (entries[i].group << 8) | entries[i].index, entries[i].type,
+                entries[i].mseq, entries[i].aseq, entries[i].length, entries[i].latency_us);
+    }
+}
+
+static int
+aries_ipc_read(void *data, unsigned int size, void *io_data);
+static int
+aries_ipc_write(void *data, unsigned int size, void *io_data);
+static int
+aries_ipc_writev(struct iovec *iov, int iovcnt, void *io_data);
+
+/*
+ * Sends a header and its payload as one message. Our own write handler takes
+ * them as they are, anything else gets them framed in a stack buffer.
+ */
+static int
+aries_ipc_client_send_framed(struct ipc_client *client, void *hdr, int hdr_len,
+                             void *data, int data_len)
+{
+    struct iovec iov[2];
+    uint8_t buf[MAX_MODEM_DATA_SIZE];
+
+    assert(client->handlers->write != NULL);
+
+    iov[0].iov_base = hdr;
+    iov[0].iov_len = hdr_len;
+    iov[1].iov_base = data;
+    iov[1].iov_len = data_len;
+
+    if(client->handlers->write == aries_ipc_write)
+        return aries_ipc_writev(iov, data_len > 0 ? 2 : 1, client->handlers->write_data);
+
+    if(hdr_len + data_len > MAX_MODEM_DATA_SIZE) {
+        IPC_LOG("%s: message of %d bytes is too big", __func__, hdr_len + data_len);
+        return -1;
+    }
+
+    memcpy(buf, hdr, hdr_len);
+    if(data_len > 0)
+        memcpy(buf + hdr_len, data, data_len);
+
+    return client->handlers->write(buf, hdr_len + data_len, client->handlers->write_data);
+}
+
 static int
 aries_ipc_fmt_client_send(struct ipc_client *client, struct ipc_message_info *request)
 {
     struct ipc_header reqhdr;
-    void *data;
     int rc = 0;
 
     reqhdr.mseq = request->mseq;
@@ -390,13 +654,6 @@ aries_ipc_fmt_client_send(struct ipc_client *client, struct ipc_message_info *re
     reqhdr.type = request->type;
     reqhdr.length = (uint16_t) (request->length + sizeof(struct ipc_header));
 
-    data = malloc(reqhdr.length);
-
-    memcpy(data, &reqhdr, sizeof(struct ipc_header));
-    memcpy((unsigned char *) (data + sizeof(struct ipc_header)), request->data, request->length);
-
-    assert(client->handlers->write != NULL);
-
 #ifdef DEBUG_SEND
     IPC_LOG("aries_ipc_fmt_client_send: SEND FMT!");
     IPC_LOG("aries_ipc_fmt_client_send: IPC request (mseq=0x%02x command=%s (0x%04x) type=%s)", 
@@ -411,30 +668,25 @@ aries_ipc_fmt_client_send(struct ipc_client *client, struct ipc_message_info *re
     }
 #endif
 
-    rc = client->handlers->write(data, reqhdr.length, client->handlers->write_data);
+    rc = aries_ipc_client_send_framed(client, &reqhdr, sizeof(struct ipc_header),
+                                      request->data, request->length);
+    if(rc >= 0)
+        aries_ipc_trace(client, ARIES_IPC_TRACE_SEND, request);
+
     return rc;
 }
 
 static int
 aries_ipc_rfs_client_send(struct ipc_client *client, struct ipc_message_info *request)
 {
-    struct rfs_hdr *rfs_hdr;
-    void *data;
-    int rc = 0;
-
-    data = malloc(request->length + sizeof(struct rfs_hdr));
-    memset(data, 0, request->length + sizeof(struct rfs_hdr));
-
-    rfs_hdr = (struct rfs_hdr *) data;
+    struct rfs_hdr hdr;
+    struct rfs_hdr *rfs_hdr = &hdr;
+    int rc;
 
     rfs_hdr->id = request->mseq;
     rfs_hdr->cmd = request->index;
     rfs_hdr->len = request->length + sizeof(struct rfs_hdr);
 
-    memcpy((void *) (data + sizeof(struct rfs_hdr)), request->data, request->length);
-
-    assert(client->handlers->write != NULL);
-
 #ifdef DEBUG_SEND
     IPC_LOG("aries_ipc_rfs_client_send: SEND RFS (id=%d cmd=%d len=%d)!",
             rfs_hdr->id, rfs_hdr->cmd, rfs_hdr->len);
@@ -445,37 +697,184 @@ aries_ipc_rfs_client_send(struct ipc_client *client, struct ipc_message_info *re
 #ifdef DEBUG
     if(request->length > 0) {
         IPC_LOG("==== RFS DATA DUMP ====");
-        ipc_hex_dump(client, (void *) (data + sizeof(struct rfs_hdr)), request->length);
+        ipc_hex_dump(client, (void *) request->data, request->length);
     }
 #endif
 
-    return client->handlers->write((uint8_t*) data, rfs_hdr->len, client->handlers->write_data);
+    rc = aries_ipc_client_send_framed(client, rfs_hdr, sizeof(struct rfs_hdr),
+                                      request->data, request->length);
+    if(rc >= 0)
+        aries_ipc_trace(client, ARIES_IPC_TRACE_SEND, request);
+
+    return rc;
 }
 
 static int
-aries_ipc_fmt_client_recv(struct ipc_client *client, struct ipc_message_info *response)
+aries_ipc_client_frame_hdr_len(struct ipc_client *client)
 {
-    struct ipc_header *resphdr;
-    void *data;
-    int bread = 0;
+    if(client->type == IPC_CLIENT_TYPE_RFS)
+        return sizeof(struct rfs_hdr);
 
-    data = malloc(MAX_MODEM_DATA_SIZE);
-    memset(data, 0, MAX_MODEM_DATA_SIZE);
+    return sizeof(struct ipc_header);
+}
 
-    memset(response, 0, sizeof(struct ipc_message_info));
+static int
+aries_ipc_client_frame_len(struct ipc_client *client, uint8_t *data)
+{
+    if(client->type == IPC_CLIENT_TYPE_RFS)
+        return ((struct rfs_hdr *) data)->len;
 
-    assert(client->handlers->read != NULL);
-    bread = client->handlers->read((uint8_t*) data, MAX_MODEM_DATA_SIZE, client->handlers->read_data);
+    return ((struct ipc_header *) data)->length;
+}
 
-    CHECK(bread, "%s: can't receive enough bytes from modem to process " \
-                 "incoming response[%s]!", __func__, strerror(errno));
+/*
+ * Refills the receive buffer of the channel once it is drained: waits for a
+ * message, then takes every other one already queued on the socket without
+ * blocking, as long as a whole message still fits. Each message keeps the
+ * size it was received with.
+ */
+static int
+aries_ipc_read_batch(struct ipc_client *client, struct aries_ipc_handlers_common_data *common_data)
+{
+    int spn_len;
+    int flags = 0;
+    int count = 0;
+    int rc;
 
-    if(data == NULL) {
-        IPC_LOG("aries_ipc_fmt_client_recv: we retrieve less (or fairly too much) " \
-				"bytes from the modem than we exepected!");
+    if(common_data->fd < 0)
         return -1;
+
+    common_data->rx_head = 0;
+    common_data->rx_tail = 0;
+    common_data->rx_msg = 0;
+    common_data->rx_msgs = 0;
+
+    while(ARIES_IPC_RX_BUF_SIZE - common_data->rx_tail >= MAX_MODEM_DATA_SIZE) {
+        spn_len = sizeof(struct sockaddr_pn);
+        rc = recvfrom(common_data->fd, common_data->rx_buf + common_data->rx_tail,
+                      MAX_MODEM_DATA_SIZE, flags, common_data->spn, &spn_len);
+        if(rc < 0) {
+            if(count > 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                break;
+            if(errno == EINTR)
+                continue;
+            return count > 0 ? count : -1;
+        }
+
+        common_data->rx_len[count] = rc;
+        common_data->rx_tail += rc;
+        count++;
+        common_data->rx_msgs = count;
+        flags = MSG_DONTWAIT;
+    }
+
+#ifdef DEBUG_RECV
+    IPC_LOG("%s: read %d messages, %d bytes", __func__, count, common_data->rx_tail);
+#endif
+
+    return count;
+}
+
+/*
+ * Points frame at the next message of the channel and returns its length.
+ * With our read handler the messages come out of the receive buffer, one
+ * read for all of those the modem queued. Anything else gets one read per
+ * message into buf, which the caller frees.
+ */
+static int
+aries_ipc_client_recv_frame(struct ipc_client *client, uint8_t **frame, uint8_t **buf)
+{
+    struct aries_ipc_handlers_common_data *common_data;
+    int hdr_len = aries_ipc_client_frame_hdr_len(client);
+    uint8_t *data;
+    int size;
+    int len;
+
+    *buf = NULL;
+
+    if(client->handlers->read != aries_ipc_read || client->handlers->read_data == NULL) {
+        data = *buf = malloc(MAX_MODEM_DATA_SIZE);
+        if(data == NULL)
+            return -1;
+
+        assert(client->handlers->read != NULL);
+        if(client->handlers->read(data, MAX_MODEM_DATA_SIZE, client->handlers->read_data) < 0)
+            goto error_read;
+
+        len = aries_ipc_client_frame_len(client, data);
+        if(len < hdr_len || len > MAX_MODEM_DATA_SIZE)
+            goto error_len;
+
+        *frame = data;
+        return len;
+    }
+
+    common_data = (struct aries_ipc_handlers_common_data *) client->handlers->read_data;
+
+    if(common_data->rx_msg == common_data->rx_msgs &&
+       aries_ipc_read_batch(client, common_data) < 0)
+        goto error_read;
+
+    data = common_data->rx_buf + common_data->rx_head;
+    size = common_data->rx_len[common_data->rx_msg];
+
+    common_data->rx_head += size;
+    common_data->rx_msg++;
+
+    /* One message per datagram, one that does not match its header is
+     * dropped alone and the next ones still start where they were read. */
+    len = size >= hdr_len ? aries_ipc_client_frame_len(client, data) : 0;
+    if(len != size) {
+        IPC_LOG("%s: frame of %d bytes in a %d bytes message", __func__, len, size);
+        goto error_len;
     }
 
+    *frame = data;
+    return len;
+
+error_read:
+    IPC_LOG("%s: can't receive enough bytes from modem to process " \
+            "incoming response[%s]!", __func__, strerror(errno));
+    return -1;
+
+error_len:
+    IPC_LOG("%s: we retrieve less (or fairly too much) " \
+            "bytes from the modem than we exepected!", __func__);
+    return -1;
+}
+
+/*
+ * Whether a message read along with the previous ones is waiting in the
+ * receive buffer. The socket does not poll readable for those, so the RIL
+ * keeps calling recv until this is 0 before it waits on the fd again.
+ */
+int
+aries_ipc_client_recv_pending(struct ipc_client *client)
+{
+    struct aries_ipc_handlers_common_data *common_data;
+
+    if(client == NULL || client->handlers == NULL ||
+       client->handlers->read != aries_ipc_read || client->handlers->read_data == NULL)
+        return 0;
+
+    common_data = (struct aries_ipc_handlers_common_data *) client->handlers->read_data;
+
+    return common_data->rx_msg < common_data->rx_msgs;
+}
+
+static int
+aries_ipc_fmt_client_recv(struct ipc_client *client, struct ipc_message_info *response)
+{
+    struct ipc_header *resphdr;
+    uint8_t *data;
+    uint8_t *buf = NULL;
+    int rc = -1;
+
+    memset(response, 0, sizeof(struct ipc_message_info));
+
+    if(aries_ipc_client_recv_frame(client, &data, &buf) < 0)
+        goto exit;
+
     resphdr = (struct ipc_header *) data;
 
     response->mseq = resphdr->mseq;
@@ -486,6 +885,8 @@ aries_ipc_fmt_client_recv(struct ipc_client *client, struct ipc_message_info *re
     response->length = resphdr->length - sizeof(struct ipc_header);
     response->data = NULL;
 
+    aries_ipc_trace(client, ARIES_IPC_TRACE_RECV, response);
+
 #ifdef DEBUG_RECV
     IPC_LOG("aries_ipc_fmt_client_recv: RECV FMT!");
     IPC_LOG("aries_ipc_fmt_client_recv: IPC response (aseq=0x%02x command=%s (0x%04x) type=%s)", 
@@ -498,39 +899,35 @@ aries_ipc_fmt_client_recv(struct ipc_client *client, struct ipc_message_info *re
         IPC_LOG("==== FMT DATA DUMP ====");
         ipc_hex_dump(client, (void *) (data + sizeof(struct ipc_header)), response->length);
 #endif
+        /* The caller owns and frees the payload. */
         response->data = malloc(response->length);
-        memcpy(response->data, (uint8_t *) data + sizeof(struct ipc_header), response->length);
+        if(response->data == NULL)
+            goto exit;
+        memcpy(response->data, data + sizeof(struct ipc_header), response->length);
     }
 
-    free(data);
+    rc = 0;
 
-    return 0;
+exit:
+    free(buf);
+
+    return rc;
 }
 
 static int
 aries_ipc_rfs_client_recv(struct ipc_client *client, struct ipc_message_info *response)
 {
-    void *data;
-    int bread = 0;
+    uint8_t *data;
+    uint8_t *buf = NULL;
+    int rc = -1;
     struct rfs_hdr *rfs_hdr;
 
-    data = malloc(MAX_MODEM_DATA_SIZE);
-    memset(data, 0, MAX_MODEM_DATA_SIZE);
-
     memset(response, 0, sizeof(struct ipc_message_info));
 
-    assert(client->handlers->read != NULL);
-    bread = client->handlers->read((uint8_t*) data, MAX_MODEM_DATA_SIZE,
-								   client->handlers->read_data);
-    CHECK(bread, "%s: can't receive enough bytes from modem to process " \
-                 "incoming response[%s]!", __func__, strerror(errno));
+    if(aries_ipc_client_recv_frame(client, &data, &buf) < 0)
+        goto exit;
 
     rfs_hdr = (struct rfs_hdr *) data;
-    if(rfs_hdr->len <= 0 || rfs_hdr->len >= MAX_MODEM_DATA_SIZE || data == NULL) {
-        IPC_LOG("aries_ipc_rfs_client_recv: we retrieve less (or fairly too much) " \
-				"bytes from the modem than we exepected!");
-        return -1;
-    }
 
     response->mseq = 0;
     response->aseq = rfs_hdr->id;
@@ -540,6 +937,8 @@ aries_ipc_rfs_client_recv(struct ipc_client *client, struct ipc_message_info *re
     response->length = rfs_hdr->len - sizeof(struct rfs_hdr);
     response->data = NULL;
 
+    aries_ipc_trace(client, ARIES_IPC_TRACE_RECV, response);
+
 #ifdef DEBUG_RECV
     IPC_LOG("aries_ipc_rfs_client_recv: RECV RFS (id=%d cmd=%d len=%d)!",
             rfs_hdr->id, rfs_hdr->cmd, rfs_hdr->len - sizeof(struct rfs_hdr));
@@ -552,13 +951,279 @@ aries_ipc_rfs_client_recv(struct ipc_client *client, struct ipc_message_info *re
         IPC_LOG("==== RFS DATA DUMP ====");
         ipc_hex_dump(client, (void *) (data + sizeof(struct rfs_hdr)), response->length);
 #endif
+        /* The caller owns and frees the payload. */
         response->data = malloc(response->length);
-        memcpy(response->data, (uint8_t *) (data + sizeof(struct rfs_hdr)), response->length);
+        if(response->data == NULL)
+            goto exit;
+        memcpy(response->data, data + sizeof(struct rfs_hdr), response->length);
     }
 
-    free(data);
+    rc = 0;
 
-    return 0;
+exit:
+    free(buf);
+
+    return rc;
+}
+
+struct aries_ipc_rfs_request
+{
+    struct ipc_message_info info;
+    uint64_t queued_us;
+    struct aries_ipc_rfs_request *next;
+};
+
+struct aries_ipc_rfs_worker
+{
+    struct ipc_client *client;
+    aries_ipc_rfs_handler_t handler;
+    void *data;
+
+    pthread_t reader;
+    pthread_t io;
+    pthread_mutex_t lock;
+    /* A request was queued or the worker stops. */
+    pthread_cond_t queued;
+    /* The queue has room again. */
+    pthread_cond_t room;
+    struct aries_ipc_rfs_request *head;
+    struct aries_ipc_rfs_request *tail;
+    int depth;
+    int stop;
+    /* Wakes the reader out of its poll. */
+    int stop_pipe[2];
+
+    unsigned int served;
+    int depth_max;
+    uint32_t wait_max_us;
+    uint32_t serve_max_us;
+};
+
+static void *
+aries_ipc_rfs_reader(void *arg)
+{
+    struct aries_ipc_rfs_worker *worker = (struct aries_ipc_rfs_worker *) arg;
+    struct ipc_client *client = worker->client;
+    struct aries_ipc_rfs_request *request;
+    struct pollfd fds[2];
+
+    fds[0].fd = client->handlers->common_data_get_fd(client->handlers->read_data);
+    fds[0].events = POLLIN;
+    fds[1].fd = worker->stop_pipe[0];
+    fds[1].events = POLLIN;
+
+    while(1) {
+        /* What the last batch read does not make the socket readable. */
+        if(!aries_ipc_client_recv_pending(client)) {
+            fds[0].revents = 0;
+            fds[1].revents = 0;
+            if(poll(fds, 2, -1) < 0) {
+                if(errno == EINTR)
+                    continue;
+                IPC_LOG("%s: poll failed: %s", __func__, strerror(errno));
+                break;
+            }
+            if(fds[1].revents != 0)
+                break;
+            if(fds[0].revents & (POLLERR | POLLHUP | POLLNVAL)) {
+                IPC_LOG("%s: the RFS channel went away", __func__);
+                break;
+            }
+        }
+
+        request = calloc(1, sizeof(struct aries_ipc_rfs_request));
+        if(request == NULL)
+            break;
+
+        if(aries_ipc_rfs_client_recv(client, &request->info) < 0) {
+            free(request);
+            continue;
+        }
+        request->queued_us = aries_ipc_time_us();
+
+        pthread_mutex_lock(&worker->lock);
+        while(worker->depth >= ARIES_IPC_RFS_QUEUE_MAX && !worker->stop)
+            pthread_cond_wait(&worker->room, &worker->lock);
+
+        if(worker->stop) {
+            pthread_mutex_unlock(&worker->lock);
+            free(request->info.data);
+            free(request);
+            break;
+        }
+
+        if(worker->tail != NULL)
+            worker->tail->next = request;
+        else
+            worker->head = request;
+        worker->tail = request;
+        if(++worker->depth > worker->depth_max)
+            worker->depth_max = worker->depth;
+
+        pthread_cond_signal(&worker->queued);
+        pthread_mutex_unlock(&worker->lock);
+    }
+
+    return NULL;
+}
+
+static void *
+aries_ipc_rfs_io(void *arg)
+{
+    struct aries_ipc_rfs_worker *worker = (struct aries_ipc_rfs_worker *) arg;
+    struct ipc_client *client = worker->client;
+    struct aries_ipc_rfs_request *request;
+    struct ipc_message_info response;
+    uint64_t start;
+    uint64_t end;
+
+    pthread_mutex_lock(&worker->lock);
+    while(1) {
+        while(worker->head == NULL && !worker->stop)
+            pthread_cond_wait(&worker->queued, &worker->lock);
+        if(worker->stop)
+            break;
+
+        request = worker->head;
+        worker->head = request->next;
+        if(worker->head == NULL)
+            worker->tail = NULL;
+        worker->depth--;
+        pthread_cond_signal(&worker->room);
+        pthread_mutex_unlock(&worker->lock);
+
+        memset(&response, 0, sizeof(response));
+        response.mseq = request->info.aseq;
+        response.group = request->info.group;
+        response.index = request->info.index;
+
+        start = aries_ipc_time_us();
+        if(worker->handler(client, &request->info, &response, worker->data) >= 0 &&
+           aries_ipc_rfs_client_send(client, &response) < 0)
+            IPC_LOG("%s: can't send the response to RFS id=%d cmd=%d", __func__,
+                    request->info.aseq, request->info.index);
+        end = aries_ipc_time_us();
+
+        free(response.data);
+        free(request->info.data);
+
+        pthread_mutex_lock(&worker->lock);
+        worker->served++;
+        if(start - request->queued_us > worker->wait_max_us)
+            worker->wait_max_us = (uint32_t) (start - request->queued_us);
+        if(end - start > worker->serve_max_us)
+            worker->serve_max_us = (uint32_t) (end - start);
+        free(request);
+    }
+    pthread_mutex_unlock(&worker->lock);
+
+    return NULL;
+}
+
+static void
+aries_ipc_rfs_worker_halt(struct aries_ipc_rfs_worker *worker, int reader)
+{
+    char c = 0;
+
+    pthread_mutex_lock(&worker->lock);
+    worker->stop = 1;
+    pthread_cond_broadcast(&worker->queued);
+    pthread_cond_broadcast(&worker->room);
+    pthread_mutex_unlock(&worker->lock);
+
+    if(reader) {
+        while(write(worker->stop_pipe[1], &c, 1) < 0 && errno == EINTR);
+        pthread_join(worker->reader, NULL);
+    }
+    pthread_join(worker->io, NULL);
+}
+
+static void
+aries_ipc_rfs_worker_free(struct aries_ipc_rfs_worker *worker)
+{
+    struct aries_ipc_rfs_request *request;
+
+    while(worker->head != NULL) {
+        request = worker->head;
+        worker->head = request->next;
+        free(request->info.data);
+        free(request);
+    }
+
+    pthread_cond_destroy(&worker->room);
+    pthread_cond_destroy(&worker->queued);
+    pthread_mutex_destroy(&worker->lock);
+    close(worker->stop_pipe[0]);
+    close(worker->stop_pipe[1]);
+    free(worker);
+}
+
+struct aries_ipc_rfs_worker *
+aries_ipc_rfs_worker_start(struct ipc_client *client, aries_ipc_rfs_handler_t handler, void *data)
+{
+    struct aries_ipc_rfs_worker *worker;
+    int rc;
+
+    if(client == NULL || handler == NULL || client->type != IPC_CLIENT_TYPE_RFS)
+        return NULL;
+
+    if(client->handlers == NULL || client->handlers->common_data_get_fd == NULL ||
+       client->handlers->common_data_get_fd(client->handlers->read_data) < 0) {
+        IPC_LOG("%s: the RFS channel is not open", __func__);
+        return NULL;
+    }
+
+    worker = calloc(1, sizeof(struct aries_ipc_rfs_worker));
+    if(worker == NULL)
+        return NULL;
+
+    if(pipe(worker->stop_pipe) < 0) {
+        free(worker);
+        return NULL;
+    }
+
+    worker->client = client;
+    worker->handler = handler;
+    worker->data = data;
+    pthread_mutex_init(&worker->lock, NULL);
+    pthread_cond_init(&worker->queued, NULL);
+    pthread_cond_init(&worker->room, NULL);
+
+    rc = pthread_create(&worker->io, NULL, aries_ipc_rfs_io, worker);
+    if(rc != 0)
+        goto error;
+
+    rc = pthread_create(&worker->reader, NULL, aries_ipc_rfs_reader, worker);
+    if(rc != 0) {
+        aries_ipc_rfs_worker_halt(worker, 0);
+        goto error;
+    }
+
+    return worker;
+
+error:
+    IPC_LOG("%s: can't start a thread: %s", __func__, strerror(rc));
+    aries_ipc_rfs_worker_free(worker);
+    return NULL;
+}
+
+void
+aries_ipc_rfs_worker_stop(struct aries_ipc_rfs_worker *worker)
+{
+    struct ipc_client *client;
+
+    if(worker == NULL)
+        return;
+
+    client = worker->client;
+
+    aries_ipc_rfs_worker_halt(worker, 1);
+
+    IPC_LOG("%s: served %u requests, queue up to %d, wait up to %uus, serve up to %uus",
+            __func__, worker->served, worker->depth_max, worker->wait_max_us,
+            worker->serve_max_us);
+
+    aries_ipc_rfs_worker_free(worker);
 }
 
 static int
@@ -625,6 +1290,10 @@ aries_ipc_open(void *data, unsigned int size, void *io_data)
         goto error;
 
     common_data->fd = fd;
+    common_data->rx_head = 0;
+    common_data->rx_tail = 0;
+    common_data->rx_msg = 0;
+    common_data->rx_msgs = 0;
 
     if(type == IPC_CLIENT_TYPE_RFS)
     {
@@ -691,7 +1360,8 @@ aries_ipc_read(void *data, unsigned int size, void *io_data)
     if(rc < 0)
         return -1;
 
-    return 0;
+    /* The size of the message, the recv functions check their header on it. */
+    return rc;
 }
 
 static int
@@ -723,6 +1393,37 @@ aries_ipc_write(void *data, unsigned int size, void *io_data)
     return 0;
 }
 
+/* Like aries_ipc_write(), the header and payload go out as one datagram. */
+static int
+aries_ipc_writev(struct iovec *iov, int iovcnt, void *io_data)
+{
+    struct aries_ipc_handlers_common_data *common_data;
+    struct msghdr msg;
+    int fd = -1;
+    int rc;
+
+    if(io_data == NULL)
+        return -1;
+
+    common_data = (struct aries_ipc_handlers_common_data *) io_data;
+    fd = common_data->fd;
+    if(fd < 0)
+        return -1;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name = common_data->spn;
+    msg.msg_namelen = sizeof(struct sockaddr_pn);
+    msg.msg_iov = iov;
+    msg.msg_iovlen = iovcnt;
+
+    rc = sendmsg(fd, &msg, 0);
+
+    if(rc < 0)
+        return -1;
+
+    return 0;
+}
+
 
 static int
 aries_ipc_is_modem_enabled() {
@@ -814,6 +1515,13 @@ aries_ipc_common_data_create(void)
 
     memset(common_data->spn, 0, spn_len);
 
+    common_data->rx_buf = malloc(ARIES_IPC_RX_BUF_SIZE);
+    if(common_data->rx_buf == NULL) {
+        free(common_data->spn);
+        free(io_data);
+        return NULL;
+    }
+
     return io_data;
 }
 
@@ -831,6 +1539,9 @@ aries_ipc_common_data_destroy(void *io_data)
     if(common_data->spn != NULL)
         free(common_data->spn);
 
+    if(common_data->rx_buf != NULL)
+        free(common_data->rx_buf);
+
     free(io_data);
 
     return 0;
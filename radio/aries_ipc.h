@@ -29,6 +29,7 @@
 #define PSI_DATA_LEN            0x5000
 #define RADIO_IMG_MAX_SIZE      0xd80000
 #define RADIO_IMG_READ_SIZE     0xa00000
+#define RADIO_IMG_DEV           "/dev/block/bml12"
 #define ONENAND_MAP_SIZE        0xFFF000
 #define ONEDRAM_INIT_READ       0x12341234
 #define ONEDRAM_DEINIT_CMD      0x45674567
@@ -40,13 +41,80 @@
 #define PHONET_SPN_RES_RFS      0x41
 
 #define MAX_MODEM_DATA_SIZE     0x1000
+#define ARIES_IPC_RX_BUF_SIZE   (16 * MAX_MODEM_DATA_SIZE)
+#define ARIES_IPC_RX_MSGS       (ARIES_IPC_RX_BUF_SIZE / MAX_MODEM_DATA_SIZE)
+
+struct ipc_client;
 
 struct aries_ipc_handlers_common_data
 {
     int fd;
     struct sockaddr_pn *spn;
+    /* Receive buffer of the channel, the messages of one batch of reads. */
+    uint8_t *rx_buf;
+    /* Next message to hand out and end of what was read. */
+    int rx_head;
+    int rx_tail;
+    /* Size of each message as recvfrom returned it, the frames are split on
+     * those and not on their headers. */
+    int rx_len[ARIES_IPC_RX_MSGS];
+    int rx_msg;
+    int rx_msgs;
 };
 
+int aries_ipc_client_recv_pending(struct ipc_client *client);
+
+/* Messages kept by the trace, a power of two. */
+#define ARIES_IPC_TRACE_SIZE    256
+#define ARIES_IPC_TRACE_SEND    0
+#define ARIES_IPC_TRACE_RECV    1
+
+struct aries_ipc_trace_entry
+{
+    uint64_t time_us;
+    /* On the message closing a transaction, time since the one opening it. */
+    uint32_t latency_us;
+    uint16_t length;
+    uint8_t channel;
+    uint8_t dir;
+    uint8_t group;
+    uint8_t index;
+    uint8_t type;
+    uint8_t mseq;
+    uint8_t aseq;
+};
+
+/*
+ * RFS requests of the modem are NV item reads and writes, a flash write
+ * can take a while. The worker serves them off the threads of the RIL: a
+ * reader takes them off the RFS channel into a queue, an I/O thread runs
+ * the handler on each in order and sends its response. Once started, the
+ * RIL does not call recv on the RFS client itself.
+ */
+struct ipc_message_info;
+struct aries_ipc_rfs_worker;
+
+/* Requests queued before the reader waits for the I/O thread. */
+#define ARIES_IPC_RFS_QUEUE_MAX 16
+
+/*
+ * Serves one request. The response comes with the id, group and command of
+ * the request filled in, the handler sets its data, malloc'd, and length.
+ * Returns < 0 to send no response.
+ */
+typedef int (*aries_ipc_rfs_handler_t)(struct ipc_client *client,
+        struct ipc_message_info *request, struct ipc_message_info *response, void *data);
+
+struct aries_ipc_rfs_worker *aries_ipc_rfs_worker_start(struct ipc_client *client,
+        aries_ipc_rfs_handler_t handler, void *data);
+/* Requests still queued are dropped, the modem asks again. */
+void aries_ipc_rfs_worker_stop(struct aries_ipc_rfs_worker *worker);
+
+/* Copies the last count traced messages at most, oldest first. */
+int aries_ipc_trace_read(struct aries_ipc_trace_entry *entries, int count);
+/* Logs the whole trace through the client. */
+void aries_ipc_trace_dump(struct ipc_client *client);
+
 #endif
 
 // vim:ts=4:sw=4:expandtab
@@ -18,6 +18,11 @@ LOCAL_MODULE_TAGS := eng
 LOCAL_C_INCLUDES += bootable/recovery/minui
 LOCAL_SRC_FILES := graphics.c
 
+ifeq ($(ARCH_ARM_HAVE_NEON),true)
+LOCAL_SRC_FILES += graphics_neon.s
+LOCAL_CFLAGS += -DUSE_NEON_ROTATE
+endif
+
 # should match TARGET_RECOVERY_GRAPHICS_LIB set in BoardConfig.mk
 LOCAL_MODULE := librecovery_graphics_aries
 
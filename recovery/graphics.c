@@ -51,6 +51,21 @@ static GGLSurface gr_framebuffer[2];
 static GGLSurface gr_mem_surface;
 static unsigned gr_active_fb = 0;
 
+typedef struct {
+    int x0, y0;
+    int x1, y1;
+} GRRect;
+
+/*
+ * Union of what the drawing calls touched since the last flip, and what
+ * the flip before that one pushed. Drawing goes straight to the page that
+ * is not displayed, or to the memory surface of a flipped screen. Either
+ * way a flip only moves those rectangles, the rest of both pages is the
+ * same already.
+ */
+static GRRect gr_dirty;
+static GRRect gr_prev_dirty;
+
 static int gr_fb_fd = -1;
 static int gr_vt_fd = -1;
 
@@ -126,41 +141,130 @@ static void get_memory_surface(GGLSurface* ms) {
     ms->format = GGL_PIXEL_FORMAT_RGB_565;
 }
 
+#ifdef BOARD_HAS_FLIPPED_SCREEN
+#ifdef USE_NEON_ROTATE
+extern void gr_reverse_rgb565(unsigned short *dst, unsigned short *src, int pixels);
+#endif
+
+/* turns the r rectangle of src by 180 degrees into dst in one pass, a line at a time */
+static void gr_rotate_copy(GGLSurface *dst, GGLSurface *src, GRRect *r)
+{
+    int y;
+
+    for (y = r->y0; y < r->y1; y++) {
+        unsigned short *d = (unsigned short *) dst->data +
+                (src->height - 1 - y) * dst->stride + src->width - r->x1;
+        unsigned short *s = (unsigned short *) src->data + y * src->stride + r->x0;
+        int n = r->x1 - r->x0;
+#ifdef USE_NEON_ROTATE
+        int n16 = n & ~15;
+
+        gr_reverse_rgb565(d, s + n - n16, n16);
+        d += n16;
+        n -= n16;
+#endif
+        while (n > 0)
+            *d++ = s[--n];
+    }
+}
+#endif
+
 static void set_active_framebuffer(unsigned n)
 {
     if (n > 1) return;
-    vi.yres_virtual = vi.yres * 2;
     vi.yoffset = n * vi.yres;
-    vi.bits_per_pixel = 16;
-    if (ioctl(gr_fb_fd, FBIOPUT_VSCREENINFO, &vi) < 0) {
+    /* panning only moves the scanout, the mode is set up once in gr_init() */
+    if (ioctl(gr_fb_fd, FBIOPAN_DISPLAY, &vi) < 0 &&
+        ioctl(gr_fb_fd, FBIOPUT_VSCREENINFO, &vi) < 0) {
         perror("active fb swap failed");
     }
 }
 
+static int gr_rect_empty(GRRect *r)
+{
+    return r->x0 >= r->x1 || r->y0 >= r->y1;
+}
+
+static void gr_rect_union(GRRect *r, int x0, int y0, int x1, int y1)
+{
+    if (x0 >= x1 || y0 >= y1) return;
+
+    if (gr_rect_empty(r)) {
+        r->x0 = x0;
+        r->y0 = y0;
+        r->x1 = x1;
+        r->y1 = y1;
+        return;
+    }
+
+    if (x0 < r->x0) r->x0 = x0;
+    if (y0 < r->y0) r->y0 = y0;
+    if (x1 > r->x1) r->x1 = x1;
+    if (y1 > r->y1) r->y1 = y1;
+}
+
+static void gr_mark_dirty(int x0, int y0, int x1, int y1)
+{
+    if (x0 < 0) x0 = 0;
+    if (y0 < 0) y0 = 0;
+    if (x1 > (int) vi.xres) x1 = vi.xres;
+    if (y1 > (int) vi.yres) y1 = vi.yres;
+
+    gr_rect_union(&gr_dirty, x0, y0, x1, y1);
+}
+
+#ifndef BOARD_HAS_FLIPPED_SCREEN
+/* copies the r rectangle of src over to dst */
+static void gr_copy_rect(GGLSurface *dst, GGLSurface *src, GRRect *r)
+{
+    unsigned stride = src->stride * 2;
+    unsigned offset = r->y0 * stride + r->x0 * 2;
+    unsigned len = (r->x1 - r->x0) * 2;
+    int y;
+
+    if (len == stride) {
+        memcpy(dst->data + offset, src->data + offset, (r->y1 - r->y0) * stride);
+    } else {
+        for (y = r->y0; y < r->y1; y++, offset += stride)
+            memcpy(dst->data + offset, src->data + offset, len);
+    }
+}
+#endif
+
 void gr_flip(void)
 {
     GGLContext *gl = gr_context;
     
+    /* nothing was drawn, the screen already shows it all */
+    if (gr_rect_empty(&gr_dirty))
+        return;
+
     /* swap front and back buffers */
     gr_active_fb = (gr_active_fb + 1) & 1;
     
-#ifdef BOARD_HAS_FLIPPED_SCREEN
-    /* flip buffer 180 degrees for devices with physicaly inverted screens */
-    unsigned int i;
-    for (i = 1; i < (vi.xres * vi.yres); i++) {
-        unsigned short tmp = gr_mem_surface.data[i];
-        gr_mem_surface.data[i] = gr_mem_surface.data[(vi.xres * vi.yres * 2) - i];
-        gr_mem_surface.data[(vi.xres * vi.yres * 2) - i] = tmp;
-    }
-#endif
-    
-    /* copy data from the in-memory surface to the buffer we're about
-     * to make active. */
-    memcpy(gr_framebuffer[gr_active_fb].data, gr_mem_surface.data,
-           vi.xres * vi.yres * 2);
+#ifndef BOARD_HAS_FLIPPED_SCREEN
+    /* what was drawn is already in place, show it and bring the page that
+     * was displayed up to date before drawing on it */
+    set_active_framebuffer(gr_active_fb);
+    gr_copy_rect(&gr_framebuffer[gr_active_fb ^ 1], &gr_framebuffer[gr_active_fb], &gr_dirty);
+    gl->colorBuffer(gl, &gr_framebuffer[gr_active_fb ^ 1]);
+#else
+    /* flip buffer 180 degrees for devices with physicaly inverted screens,
+     * straight from the in-memory surface into the buffer we're about
+     * to make active. That page last got the frame before the previous
+     * one, it misses what both of them changed. */
+    GRRect r = gr_dirty;
+    if (!gr_rect_empty(&gr_prev_dirty))
+        gr_rect_union(&r, gr_prev_dirty.x0, gr_prev_dirty.y0,
+                      gr_prev_dirty.x1, gr_prev_dirty.y1);
+    gr_rotate_copy(&gr_framebuffer[gr_active_fb], &gr_mem_surface, &r);
+    gr_prev_dirty = gr_dirty;
     
     /* inform the display driver */
     set_active_framebuffer(gr_active_fb);
+#endif
+
+    memset(&gr_dirty, 0, sizeof(gr_dirty));
 }
 
 void gr_color(unsigned char r, unsigned char g, unsigned char b, unsigned char a)
@@ -199,6 +303,8 @@ int gr_text(int x, int y, const char *s)
     gl->texGeni(gl, GGL_T, GGL_TEXTURE_GEN_MODE, GGL_ONE_TO_ONE);
     gl->enable(gl, GGL_TEXTURE_2D);
     
+    gr_mark_dirty(x, y, x + font->cwidth * strlen(s), y + font->cheight);
+
     while((off = *s++)) {
         off -= 32;
         if (off < 96) {
@@ -216,6 +322,8 @@ void gr_fill(int x, int y, int w, int h)
     GGLContext *gl = gr_context;
     gl->disable(gl, GGL_TEXTURE_2D);
     gl->recti(gl, x, y, w, h);
+    /* w and h are the right and bottom edges */
+    gr_mark_dirty(x, y, w, h);
 }
 
 void gr_blit(gr_surface source, int sx, int sy, int w, int h, int dx, int dy) {
@@ -231,6 +339,7 @@ void gr_blit(gr_surface source, int sx, int sy, int w, int h, int dx, int dy) {
     gl->enable(gl, GGL_TEXTURE_2D);
     gl->texCoord2i(gl, sx - dx, sy - dy);
     gl->recti(gl, dx, dy, dx + w, dy + h);
+    gr_mark_dirty(dx, dy, dx + w, dy + h);
 }
 
 unsigned int gr_get_width(gr_surface surface) {
@@ -299,15 +408,27 @@ int gr_init(void)
         return -1;
     }
     
+#ifdef BOARD_HAS_FLIPPED_SCREEN
+    /* the flip turns the whole picture, it is drawn off screen first */
     get_memory_surface(&gr_mem_surface);
+#endif
     
     fprintf(stderr, "aries framebuffer: fd %d (%d x %d)\n",
             gr_fb_fd, gr_framebuffer[0].width, gr_framebuffer[0].height);
     
     /* start with 0 as front (displayed) and 1 as back (drawing) */
     gr_active_fb = 0;
-    set_active_framebuffer(0);
+    vi.yres_virtual = vi.yres * 2;
+    vi.yoffset = 0;
+    vi.bits_per_pixel = 16;
+    if (ioctl(gr_fb_fd, FBIOPUT_VSCREENINFO, &vi) < 0) {
+        perror("active fb setup failed");
+    }
+#ifdef BOARD_HAS_FLIPPED_SCREEN
     gl->colorBuffer(gl, &gr_mem_surface);
+#else
+    gl->colorBuffer(gl, &gr_framebuffer[1]);
+#endif
     
     gl->activeTexture(gl, 0);
     gl->enable(gl, GGL_BLEND);
@@ -340,7 +461,13 @@ int gr_fb_height(void)
 
 gr_pixel *gr_fb_data(void)
 {
+    /* the caller may write anywhere in it */
+    gr_mark_dirty(0, 0, vi.xres, vi.yres);
+#ifdef BOARD_HAS_FLIPPED_SCREEN
     return (unsigned short *) gr_mem_surface.data;
+#else
+    return (unsigned short *) gr_framebuffer[gr_active_fb ^ 1].data;
+#endif
 }
 
 void gr_fb_blank(bool blank)
@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Line kernel of the 180 degree turn of BOARD_HAS_FLIPPED_SCREEN, driven
+ * by gr_rotate_copy() in graphics.c. The source line is read backwards 16
+ * RGB565 pixels at a time, reversed in registers and stored forwards.
+ */
+    .arch armv7-a
+    .text
+
+/*
+ * void gr_reverse_rgb565(unsigned short *dst, unsigned short *src, int pixels)
+ *
+ * dst[i] = src[pixels - 1 - i], pixels a multiple of 16.
+ */
+    .global gr_reverse_rgb565
+    .type   gr_reverse_rgb565, %function
+gr_reverse_rgb565:
+    .fnstart
+
+    @r0     dst
+    @r1     src, from its last 16 pixels down
+    @r2     pixels
+    @r3     -32
+
+    cmp         r2, #0
+    bxle        lr
+
+    add         r1, r1, r2, lsl #1
+    sub         r1, r1, #32
+    mvn         r3, #31
+
+REVERSE_LOOP:
+    pld         [r1, #-64]
+    vld1.16     {d0, d1, d2, d3}, [r1], r3
+    vrev64.16   q0, q0                  @ reverse within each d register
+    vrev64.16   q1, q1
+    vswp        d0, d3                  @ and the d registers themselves
+    vswp        d1, d2
+    vst1.16     {d0, d1, d2, d3}, [r0]!
+
+    subs        r2, r2, #16
+    bgt         REVERSE_LOOP
+
+    bx          lr
+    .fnend
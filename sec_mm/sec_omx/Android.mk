@@ -9,6 +9,23 @@ SEC_CODECS := $(SEC_OMX_TOP)/sec_codecs/
 SEC_OMX_INC := $(SEC_OMX_TOP)/sec_omx_include/
 SEC_OMX_COMPONENT := $(SEC_OMX_TOP)/sec_omx_component
 
+# trace level SEC_OSAL_Log() and FunctionIn/Out are compiled out unless asked for
+SEC_OMX_LOG_CFLAGS :=
+ifeq ($(BOARD_SEC_OMX_TRACE_LOG),true)
+SEC_OMX_LOG_CFLAGS += -DSEC_LOG_TRACE_ON
+endif
+
+SEC_OMX_VDEC_CFLAGS :=
+ifneq ($(BOARD_MFC_INPUT_BUFFER_NUM),)
+SEC_OMX_VDEC_CFLAGS += -DMFC_INPUT_BUFFER_NUM_MAX=$(BOARD_MFC_INPUT_BUFFER_NUM)
+endif
+ifeq ($(BOARD_USE_OMX_FIMC_CSC),true)
+SEC_OMX_VDEC_CFLAGS += -DUSE_FIMC_CSC
+endif
+ifeq ($(BOARD_USE_OMX_ANB_ZERO_COPY),true)
+SEC_OMX_VDEC_CFLAGS += -DUSE_ANB_ZERO_COPY
+endif
+
 include $(SEC_OMX_TOP)/sec_osal/Android.mk
 include $(SEC_OMX_TOP)/sec_omx_core/Android.mk
 
@@ -17,6 +34,7 @@ include $(SEC_OMX_COMPONENT)/common/Android.mk
 include $(SEC_OMX_COMPONENT)/video/dec/Android.mk
 include $(SEC_OMX_COMPONENT)/video/dec/h264dec/Android.mk
 include $(SEC_OMX_COMPONENT)/video/dec/mpeg4dec/Android.mk
+include $(SEC_OMX_COMPONENT)/video/dec/test/Android.mk
 include $(SEC_OMX_COMPONENT)/video/enc/Android.mk
 include $(SEC_OMX_COMPONENT)/video/enc/h264enc/Android.mk
 include $(SEC_OMX_COMPONENT)/video/enc/mpeg4enc/Android.mk
@@ -4,4 +4,5 @@ include $(CLEAR_VARS)
 
 include   $(SEC_CODECS)/video/mfc_c110/dec/Android.mk
 include   $(SEC_CODECS)/video/mfc_c110/enc/Android.mk
-include   $(SEC_CODECS)/video/mfc_c110/csc/Android.mk
\ No newline at end of file
+include   $(SEC_CODECS)/video/mfc_c110/csc/Android.mk
+include   $(SEC_CODECS)/video/mfc_c110/test/Android.mk
\ No newline at end of file
@@ -4,25 +4,26 @@ include $(CLEAR_VARS)
 
 LOCAL_MODULE_TAGS := optional
 
-ifeq ($(ARCH_ARM_HAVE_NEON),true)
 LOCAL_SRC_FILES := \
+	color_space_convertor.c
+
+ifeq ($(ARCH_ARM_HAVE_NEON),true)
+LOCAL_SRC_FILES += \
 	csc_yuv420_nv12t_y_neon.s \
 	csc_yuv420_nv12t_uv_neon.s \
 	csc_nv12t_yuv420_y_neon.s \
 	csc_nv12t_yuv420_uv_neon.s \
 	csc_interleave_memcpy.s \
-	csc_deinterleave_memcpy.s
-
-else
-LOCAL_SRC_FILES := \
-	color_space_convertor.c
+	csc_deinterleave_memcpy.s \
+	csc_yuv420p_strided_neon.s \
+	csc_tile_line_neon.s \
+	csc_tile_rgb_neon.s
 
+LOCAL_CFLAGS += -DUSE_NEON_CSC
 endif
 
 LOCAL_MODULE := libseccsc.aries
 
-LOCAL_CFLAGS :=
-
 LOCAL_ARM_MODE := arm
 
 LOCAL_STATIC_LIBRARIES :=
@@ -25,10 +25,14 @@
  */
 
 #include "stdlib.h"
+#include "string.h"
 #include "color_space_convertor.h"
 
 #define TILED_SIZE  64*32
 
+/* the NEON build takes these from the csc_*.s files */
+#ifndef USE_NEON_CSC
+
 /*
  * De-interleaves src to dest1, dest2
  *
@@ -1090,3 +1094,592 @@ void csc_linear_to_tiled_interleave(char *nv12t_uv_dest, char *yuv420p_u_src, ch
     }
 }
 
+/*
+ * Copies YUV420P to strided Y, U and V planes
+ *
+ * @param y_dest
+ *   Y plane address of destination[out]
+ *
+ * @param u_dest
+ *   U plane address of destination[out]
+ *
+ * @param v_dest
+ *   V plane address of destination[out]
+ *
+ * @param yuv420p_src
+ *   Address of packed YUV420P, Y then U then V[in]
+ *
+ * @param yuv420p_width
+ *   Width of YUV420P[in]
+ *
+ * @param yuv420p_height
+ *   Height of YUV420P[in]
+ *
+ * @param y_stride
+ *   Line length of destination Y plane[in]
+ *
+ * @param uv_stride
+ *   Line length of destination U and V planes[in]
+ */
+void csc_linear_to_strided(char *y_dest, char *u_dest, char *v_dest, char *yuv420p_src,
+                           int yuv420p_width, int yuv420p_height, int y_stride, int uv_stride)
+{
+    int i;
+
+    for (i = 0; i < yuv420p_height; i++) {
+        memcpy(y_dest + y_stride * i, yuv420p_src, yuv420p_width);
+        yuv420p_src += yuv420p_width;
+    }
+
+    for (i = 0; i < yuv420p_height / 2; i++) {
+        memcpy(u_dest + uv_stride * i, yuv420p_src, yuv420p_width / 2);
+        yuv420p_src += yuv420p_width / 2;
+    }
+
+    for (i = 0; i < yuv420p_height / 2; i++) {
+        memcpy(v_dest + uv_stride * i, yuv420p_src, yuv420p_width / 2);
+        yuv420p_src += yuv420p_width / 2;
+    }
+}
+
+/*
+ * Copies lines of one tile to a strided destination
+ *
+ * @param dest
+ *   Address of the first destination line[out]
+ *
+ * @param dest_stride
+ *   Line length of destination[in]
+ *
+ * @param tile_src
+ *   Address of the first line in the tile, lines are 64 bytes apart[in]
+ *
+ * @param line_size
+ *   Bytes per line, 64 or less at the right edge[in]
+ *
+ * @param lines
+ *   Number of lines, 32 or less at the bottom edge[in]
+ */
+void csc_tile_copy(char *dest, int dest_stride, char *tile_src, int line_size, int lines)
+{
+    int i;
+
+    /* a constant length lets the compiler inline the copy of a full line */
+    if (line_size == 64) {
+        for (i = 0; i < lines; i++)
+            memcpy(dest + dest_stride * i, tile_src + 64 * i, 64);
+        return;
+    }
+    for (i = 0; i < lines; i++)
+        memcpy(dest + dest_stride * i, tile_src + 64 * i, line_size);
+}
+
+/*
+ * Copies lines of one UV tile to a strided destination as VU
+ *
+ * @param dest
+ *   Address of the first destination line[out]
+ *
+ * @param dest_stride
+ *   Line length of destination[in]
+ *
+ * @param tile_src
+ *   Address of the first line in the tile, lines are 64 bytes apart[in]
+ *
+ * @param line_size
+ *   Bytes per line, even, 64 or less at the right edge[in]
+ *
+ * @param lines
+ *   Number of lines, 32 or less at the bottom edge[in]
+ */
+void csc_tile_swap_uv(char *dest, int dest_stride, char *tile_src, int line_size, int lines)
+{
+    int i, j;
+
+    for (i = 0; i < lines; i++) {
+        char *d = dest + dest_stride * i;
+        char *s = tile_src + 64 * i;
+        for (j = 0; j < line_size; j += 2) {
+            d[j]     = s[j + 1];
+            d[j + 1] = s[j];
+        }
+    }
+}
+
+/*
+ * De-interleaves lines of one UV tile to strided U and V destinations
+ *
+ * @param u_dest
+ *   Address of the first U line[out]
+ *
+ * @param v_dest
+ *   Address of the first V line[out]
+ *
+ * @param uv_stride
+ *   Line length of U and V destinations[in]
+ *
+ * @param tile_src
+ *   Address of the first line in the tile, lines are 64 bytes apart[in]
+ *
+ * @param line_size
+ *   Interleaved bytes per line, even, 64 or less at the right edge[in]
+ *
+ * @param lines
+ *   Number of lines, 32 or less at the bottom edge[in]
+ */
+void csc_tile_deinterleave_uv(char *u_dest, char *v_dest, int uv_stride, char *tile_src, int line_size, int lines)
+{
+    int i, j;
+
+    for (i = 0; i < lines; i++) {
+        char *u = u_dest + uv_stride * i;
+        char *v = v_dest + uv_stride * i;
+        char *s = tile_src + 64 * i;
+        for (j = 0; j < line_size / 2; j++) {
+            u[j] = s[j * 2];
+            v[j] = s[j * 2 + 1];
+        }
+    }
+}
+
+/* BT.601 video range, 6 fractional bits, as the NEON kernels have it */
+static unsigned char csc_clip(int value)
+{
+    value = (value + 32) >> 6;
+    if (value < 0)
+        return 0;
+    if (value > 255)
+        return 255;
+    return (unsigned char)value;
+}
+
+static void csc_yuv_to_rgb(unsigned char *rgb, unsigned char y, unsigned char u, unsigned char v)
+{
+    int yy = 74 * ((int)y - 16);
+    int uu = (int)u - 128;
+    int vv = (int)v - 128;
+
+    rgb[0] = csc_clip(yy + 102 * vv);
+    rgb[1] = csc_clip(yy - 25 * uu - 52 * vv);
+    rgb[2] = csc_clip(yy + 129 * uu);
+}
+
+/*
+ * Converts one line of a NV12T tile pair to RGB565
+ *
+ * @param rgb_dest
+ *   Address of the first RGB565 pixel[out]
+ *
+ * @param y_src
+ *   Address of the Y line[in]
+ *
+ * @param uv_src
+ *   Address of the UV line, one UV pair for two pixels[in]
+ *
+ * @param pixels
+ *   Number of pixels, a multiple of 16, 64 or less[in]
+ */
+void csc_tile_line_to_rgb565(char *rgb_dest, char *y_src, char *uv_src, int pixels)
+{
+    unsigned short *d = (unsigned short *)rgb_dest;
+    unsigned char *y = (unsigned char *)y_src;
+    unsigned char *uv = (unsigned char *)uv_src;
+    unsigned char rgb[3];
+    int i;
+
+    for (i = 0; i < pixels; i++) {
+        csc_yuv_to_rgb(rgb, y[i], uv[i & ~1], uv[i | 1]);
+        d[i] = ((rgb[0] >> 3) << 11) | ((rgb[1] >> 2) << 5) | (rgb[2] >> 3);
+    }
+}
+
+/*
+ * Converts one line of a NV12T tile pair to RGBA8888, alpha opaque
+ *
+ * @param rgb_dest
+ *   Address of the first RGBA8888 pixel[out]
+ *
+ * @param y_src
+ *   Address of the Y line[in]
+ *
+ * @param uv_src
+ *   Address of the UV line, one UV pair for two pixels[in]
+ *
+ * @param pixels
+ *   Number of pixels, a multiple of 16, 64 or less[in]
+ */
+void csc_tile_line_to_rgba8888(char *rgb_dest, char *y_src, char *uv_src, int pixels)
+{
+    unsigned char *d = (unsigned char *)rgb_dest;
+    unsigned char *y = (unsigned char *)y_src;
+    unsigned char *uv = (unsigned char *)uv_src;
+    int i;
+
+    for (i = 0; i < pixels; i++) {
+        csc_yuv_to_rgb(d + i * 4, y[i], uv[i & ~1], uv[i | 1]);
+        d[i * 4 + 3] = 0xFF;
+    }
+}
+
+#endif /* USE_NEON_CSC */
+
+/*
+ * Offset of a 64x32 tile in a NV12T plane. A pair of tile rows is laid
+ * out in Z order, groups of four tiles going right, down, right, up. A
+ * last even row without a pair is linear.
+ *
+ * @param x
+ *   Tile column[in]
+ *
+ * @param y
+ *   Tile row[in]
+ *
+ * @param x_block_num
+ *   Tiles per row, the width aligned to 128[in]
+ *
+ * @param y_block_num
+ *   Tile rows of the plane[in]
+ */
+static unsigned int csc_tile_offset(unsigned int x, unsigned int y, unsigned int x_block_num, unsigned int y_block_num)
+{
+    unsigned int offset;
+
+    if (y & 0x1) {
+        /* odd fomula: 2+x+(x>>2)<<2+x_block_num*(y-1) */
+        offset = x_block_num * (y - 1) + 2 + x + ((x >> 2) << 2);
+    } else if ((y + 1) < y_block_num) {
+        /* even1 fomula: x+((x+2)>>2)<<2+x_block_num*y */
+        offset = x_block_num * y + x + (((x + 2) >> 2) << 2);
+    } else {
+        /* even2 fomula: x+x_block_num*y */
+        offset = x_block_num * y + x;
+    }
+
+    return offset << 11;
+}
+
+typedef enum {
+    TILE_COPY,
+    TILE_SWAP_UV,
+    TILE_DEINTERLEAVE_UV
+} TILE_OPERATION;
+
+/*
+ * Walks a NV12T plane tile by tile, each tile goes out in one call of its
+ * line kernel, so the source is read once and in order.
+ */
+static void csc_tiled_walk(TILE_OPERATION operation, char *dest1, char *dest2, int dest_stride,
+                           char *nv12t_src, int width, int height)
+{
+    unsigned int x_block_num = ((width + 127) >> 7) << 1;
+    unsigned int y_block_num = (height + 31) >> 5;
+    unsigned int x, y;
+
+    for (y = 0; y < y_block_num; y++) {
+        int lines = ((height - (int)(y << 5)) < 32) ? (height - (int)(y << 5)) : 32;
+        int dest_offset = dest_stride * (int)(y << 5);
+
+        for (x = 0; (int)(x << 6) < width; x++) {
+            int line_size = ((width - (int)(x << 6)) < 64) ? (width - (int)(x << 6)) : 64;
+            char *tile = nv12t_src + csc_tile_offset(x, y, x_block_num, y_block_num);
+
+            switch (operation) {
+            case TILE_COPY:
+                csc_tile_copy(dest1 + dest_offset + (x << 6), dest_stride, tile, line_size, lines);
+                break;
+            case TILE_SWAP_UV:
+                csc_tile_swap_uv(dest1 + dest_offset + (x << 6), dest_stride, tile, line_size, lines);
+                break;
+            case TILE_DEINTERLEAVE_UV:
+                csc_tile_deinterleave_uv(dest1 + dest_offset + (x << 5), dest2 + dest_offset + (x << 5),
+                                         dest_stride, tile, line_size, lines);
+                break;
+            }
+        }
+    }
+}
+
+/*
+ * Converts tiled data to linear a band of two tile rows at a time, 64
+ * lines of output that stay in L2 (120KB at 1080p). The tiles of a band
+ * are read in the order they are in memory: the pair of even tiles that
+ * opens the band, then four odd and four even ones in turn. The source
+ * is one sequential stream, so the pld of the line kernel runs on into
+ * the next tile, and every line goes out as one 64 byte store.
+ * 1. Y of NV12T to Y of YUV420P
+ * 2. Y of NV12T to Y of YUV420S
+ * 3. UV of NV12T to UV of YUV420S
+ *
+ * @param yuv420_dest
+ *   Y or UV plane address of YUV420[out]
+ *
+ * @param nv12t_src
+ *   Y or UV plane address of NV12T[in]
+ *
+ * @param yuv420_width
+ *   Width of YUV420[in]
+ *
+ * @param yuv420_height
+ *   Y: Height of YUV420, UV: Height/2 of YUV420[in]
+ */
+void csc_tiled_to_linear_blocked(char *yuv420_dest, char *nv12t_src, int yuv420_width, int yuv420_height)
+{
+    unsigned int x_block_num = ((yuv420_width + 127) >> 7) << 1;
+    unsigned int y_block_num = (yuv420_height + 31) >> 5;
+    unsigned int x, y, i;
+
+    for (y = 0; y < y_block_num; y += 2) {
+        /* the last even row without a pair is linear, and so in memory order already */
+        unsigned int rows = ((y + 1) < y_block_num) ? 2 : 1;
+
+        for (i = 0; i < x_block_num * rows; i++) {
+            unsigned int row, lines, line_size;
+
+            if (rows == 1) {
+                x = i;
+                row = y;
+            } else if (i < 2) {
+                x = i;
+                row = y;
+            } else if (((i - 2) >> 2) & 0x1) {
+                x = (((i - 2) >> 3) << 2) + 2 + ((i - 2) & 0x3);
+                row = y;
+            } else {
+                x = (((i - 2) >> 3) << 2) + ((i - 2) & 0x3);
+                row = y + 1;
+            }
+            if ((x >= x_block_num) || ((int)(x << 6) >= yuv420_width))
+                continue;
+
+            lines = ((yuv420_height - (int)(row << 5)) < 32) ? (yuv420_height - (int)(row << 5)) : 32;
+            line_size = ((yuv420_width - (int)(x << 6)) < 64) ? (yuv420_width - (int)(x << 6)) : 64;
+            csc_tile_copy(yuv420_dest + yuv420_width * (int)(row << 5) + (x << 6), yuv420_width,
+                          nv12t_src + csc_tile_offset(x, row, x_block_num, y_block_num), line_size, lines);
+        }
+    }
+}
+
+/*
+ * Converts NV12T to NV21 in one pass over the tiles
+ *
+ * @param y_dest
+ *   Y plane address of NV21[out]
+ *
+ * @param vu_dest
+ *   VU plane address of NV21[out]
+ *
+ * @param nv12t_y_src
+ *   Y plane address of NV12T[in]
+ *
+ * @param nv12t_uv_src
+ *   UV plane address of NV12T[in]
+ *
+ * @param width
+ *   Width of NV21, even[in]
+ *
+ * @param height
+ *   Height of NV21, even[in]
+ */
+void csc_tiled_to_nv21(char *y_dest, char *vu_dest, char *nv12t_y_src, char *nv12t_uv_src, int width, int height)
+{
+    csc_tiled_walk(TILE_COPY, y_dest, NULL, width, nv12t_y_src, width, height);
+    csc_tiled_walk(TILE_SWAP_UV, vu_dest, NULL, width, nv12t_uv_src, width, height >> 1);
+}
+
+/*
+ * Converts NV12T to YV12 with strided planes in one pass over the tiles
+ *
+ * @param y_dest
+ *   Y plane address of YV12[out]
+ *
+ * @param v_dest
+ *   V plane address of YV12[out]
+ *
+ * @param u_dest
+ *   U plane address of YV12[out]
+ *
+ * @param nv12t_y_src
+ *   Y plane address of NV12T[in]
+ *
+ * @param nv12t_uv_src
+ *   UV plane address of NV12T[in]
+ *
+ * @param width
+ *   Width of YV12, even[in]
+ *
+ * @param height
+ *   Height of YV12, even[in]
+ *
+ * @param y_stride
+ *   Line length of Y plane[in]
+ *
+ * @param uv_stride
+ *   Line length of V and U planes[in]
+ */
+void csc_tiled_to_yv12(char *y_dest, char *v_dest, char *u_dest, char *nv12t_y_src, char *nv12t_uv_src,
+                       int width, int height, int y_stride, int uv_stride)
+{
+    csc_tiled_walk(TILE_COPY, y_dest, NULL, y_stride, nv12t_y_src, width, height);
+    csc_tiled_walk(TILE_DEINTERLEAVE_UV, u_dest, v_dest, uv_stride, nv12t_uv_src, width, height >> 1);
+}
+
+/*
+ * Box filters one 64 pixel line of a tile column by 1 << scale into
+ * 64 >> scale pixels, Y over scale x scale and UV over scale x scale/2.
+ * The source lines of a box are in the same tile, a UV box running past
+ * line_size repeats the last pair.
+ */
+static void csc_tile_line_shrink(char *y_dest, char *uv_dest, char *y_tile_line, char *uv_tile_line,
+                                 int line_size, int scale)
+{
+    unsigned char *y = (unsigned char *)y_tile_line;
+    unsigned char *uv = (unsigned char *)uv_tile_line;
+    int step = 1 << scale;
+    int pixels = 64 >> scale;
+    int last_pair = (line_size >> 1) - 1;
+    int i, r, c;
+
+    for (i = 0; i < pixels; i++) {
+        unsigned int sum = 0;
+        for (r = 0; r < step; r++) {
+            for (c = 0; c < step; c++)
+                sum += y[64 * r + i * step + c];
+        }
+        y_dest[i] = (char)((sum + (1 << (2 * scale - 1))) >> (2 * scale));
+    }
+
+    for (i = 0; i < pixels; i += 2) {
+        unsigned int sum_u = 0, sum_v = 0;
+        for (r = 0; r < (step >> 1); r++) {
+            for (c = 0; c < step; c++) {
+                int pair = (i / 2 * step + c < last_pair) ? (i / 2 * step + c) : last_pair;
+                sum_u += uv[64 * r + pair * 2];
+                sum_v += uv[64 * r + pair * 2 + 1];
+            }
+        }
+        uv_dest[i]     = (char)((sum_u + (1 << (2 * scale - 2))) >> (2 * scale - 1));
+        uv_dest[i + 1] = (char)((sum_v + (1 << (2 * scale - 2))) >> (2 * scale - 1));
+    }
+}
+
+typedef enum {
+    RGB_565,
+    RGBA_8888
+} RGB_FORMAT;
+
+/*
+ * Walks the output line by line, each tile column a segment. A segment
+ * not a multiple of 16 pixels wide goes through a line buffer, as the
+ * line kernels do 16 pixels at a time.
+ */
+static void csc_tiled_to_rgb(RGB_FORMAT format, char *rgb_dest, char *nv12t_y_src, char *nv12t_uv_src,
+                             int width, int height, int rgb_stride, int scale)
+{
+    unsigned int x_block_num = ((width + 127) >> 7) << 1;
+    unsigned int y_block_num = (height + 31) >> 5;
+    unsigned int uv_y_block_num = ((height >> 1) + 31) >> 5;
+    int bpp = (format == RGB_565) ? 2 : 4;
+    int rgb_height = height >> scale;
+    int full = 64 >> scale;
+    char y_line[64], uv_line[64];
+    char rgb_line[64 * 4];
+    int i, x;
+
+    for (i = 0; i < rgb_height; i++) {
+        int y = i << scale;
+        int uv = y >> 1;
+        char *dest = rgb_dest + rgb_stride * i;
+
+        for (x = 0; (x << 6) < width; x++) {
+            char *y_tile_line = nv12t_y_src + csc_tile_offset(x, y >> 5, x_block_num, y_block_num) + ((y & 31) << 6);
+            char *uv_tile_line = nv12t_uv_src + csc_tile_offset(x, uv >> 5, x_block_num, uv_y_block_num) + ((uv & 31) << 6);
+            int line_size = ((width - (x << 6)) < 64) ? (width - (x << 6)) : 64;
+            int pixels = line_size >> scale;
+            char *pixel_dest = dest + x * full * bpp;
+
+            if (pixels <= 0)
+                break;
+            if (scale > 0) {
+                csc_tile_line_shrink(y_line, uv_line, y_tile_line, uv_tile_line, line_size, scale);
+                y_tile_line = y_line;
+                uv_tile_line = uv_line;
+            }
+            if ((pixels & 15) == 0) {
+                if (format == RGB_565)
+                    csc_tile_line_to_rgb565(pixel_dest, y_tile_line, uv_tile_line, pixels);
+                else
+                    csc_tile_line_to_rgba8888(pixel_dest, y_tile_line, uv_tile_line, pixels);
+            } else {
+                if (format == RGB_565)
+                    csc_tile_line_to_rgb565(rgb_line, y_tile_line, uv_tile_line, (pixels + 15) & ~15);
+                else
+                    csc_tile_line_to_rgba8888(rgb_line, y_tile_line, uv_tile_line, (pixels + 15) & ~15);
+                memcpy(pixel_dest, rgb_line, pixels * bpp);
+            }
+        }
+    }
+}
+
+/*
+ * Converts NV12T to RGB565 in one pass over the tiles, optionally
+ * shrinking by 2 or 4 with a box filter
+ *
+ * @param rgb_dest
+ *   RGB565 address[out]
+ *
+ * @param nv12t_y_src
+ *   Y plane address of NV12T[in]
+ *
+ * @param nv12t_uv_src
+ *   UV plane address of NV12T[in]
+ *
+ * @param width
+ *   Width of NV12T, even[in]
+ *
+ * @param height
+ *   Height of NV12T, even[in]
+ *
+ * @param rgb_stride
+ *   Line length of RGB565 in bytes[in]
+ *
+ * @param scale
+ *   0 full size, 1 half, 2 quarter: RGB565 is width >> scale by
+ *   height >> scale[in]
+ */
+void csc_tiled_to_rgb565(char *rgb_dest, char *nv12t_y_src, char *nv12t_uv_src,
+                         int width, int height, int rgb_stride, int scale)
+{
+    csc_tiled_to_rgb(RGB_565, rgb_dest, nv12t_y_src, nv12t_uv_src, width, height, rgb_stride, scale);
+}
+
+/*
+ * Converts NV12T to RGBA8888 in one pass over the tiles, optionally
+ * shrinking by 2 or 4 with a box filter
+ *
+ * @param rgb_dest
+ *   RGBA8888 address[out]
+ *
+ * @param nv12t_y_src
+ *   Y plane address of NV12T[in]
+ *
+ * @param nv12t_uv_src
+ *   UV plane address of NV12T[in]
+ *
+ * @param width
+ *   Width of NV12T, even[in]
+ *
+ * @param height
+ *   Height of NV12T, even[in]
+ *
+ * @param rgb_stride
+ *   Line length of RGBA8888 in bytes[in]
+ *
+ * @param scale
+ *   0 full size, 1 half, 2 quarter: RGBA8888 is width >> scale by
+ *   height >> scale[in]
+ */
+void csc_tiled_to_rgba8888(char *rgb_dest, char *nv12t_y_src, char *nv12t_uv_src,
+                           int width, int height, int rgb_stride, int scale)
+{
+    csc_tiled_to_rgb(RGBA_8888, rgb_dest, nv12t_y_src, nv12t_uv_src, width, height, rgb_stride, scale);
+}
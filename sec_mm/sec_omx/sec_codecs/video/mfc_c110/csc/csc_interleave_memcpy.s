@@ -47,7 +47,7 @@ csc_interleave_memcpy:
     cmp         r3, #128
     blt         LINEAR_SIZE_64
 
-    bic         r5, r3, #0x2F
+    bic         r5, r3, #0x7F
 LINEAR_SIZE_128_LOOP:
     pld         [r1, #64]
     vld1.8      {q0}, [r1]!
@@ -105,8 +105,9 @@ LINEAR_SIZE_64_LOOP:
     vst2.8      {q6, q7}, [r0]!
 
     add         r4, #64
-    cmp         r4, r3
-    blt         LINEAR_SIZE_64_LOOP
+    sub         r5, r3, r4
+    cmp         r5, #64
+    bge         LINEAR_SIZE_64_LOOP
 
 LINEAR_SIZE_2:
     sub         r5, r3, r4
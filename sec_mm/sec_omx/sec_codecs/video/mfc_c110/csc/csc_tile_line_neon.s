@@ -0,0 +1,251 @@
+/*
+ *
+ * Copyright 2011 Samsung Electronics S.LSI Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * @file    csc_tile_line_neon.s
+ * @brief   SEC_OMX specific define
+ * @history
+ *   Line kernels for one 64x32 NV12T tile, driven by csc_tiled_walk()
+ *   in color_space_convertor.c. Tile lines are 64 bytes apart, a full
+ *   line is done in registers, a short one at the right edge 16 bytes
+ *   and then 2 bytes at a time.
+ */
+    .arch armv7-a
+    .text
+
+/*
+ * void csc_tile_copy(char *dest, int dest_stride, char *tile_src, int line_size, int lines)
+ */
+    .global csc_tile_copy
+    .type   csc_tile_copy, %function
+csc_tile_copy:
+    .fnstart
+
+    @r0     dest
+    @r1     dest_stride
+    @r2     tile_src
+    @r3     line_size
+    @r4     lines
+    @r5     dest_stride - 32
+    @r6     line src
+    @r7     line dest
+    @r8     bytes left in line
+    @r9     temp
+
+    stmfd       sp!, {r4-r12,r14}       @ backup registers
+    ldr         r4, [sp, #40]
+
+    cmp         r4, #0
+    ble         COPY_RESTORE_REG
+    cmp         r3, #64
+    blt         COPY_SHORT_LOOP
+
+    sub         r5, r1, #32
+COPY_FULL_LOOP:
+    pld         [r2, #128]
+    vld1.8      {q0, q1}, [r2]!
+    vld1.8      {q2, q3}, [r2]!
+    vst1.8      {q0, q1}, [r0]!
+    vst1.8      {q2, q3}, [r0], r5
+    subs        r4, r4, #1
+    bgt         COPY_FULL_LOOP
+    b           COPY_RESTORE_REG
+
+COPY_SHORT_LOOP:
+    mov         r6, r2
+    mov         r7, r0
+    mov         r8, r3
+    cmp         r8, #16
+    blt         COPY_SHORT_2
+COPY_SHORT_16_LOOP:
+    vld1.8      {q0}, [r6]!
+    vst1.8      {q0}, [r7]!
+    sub         r8, r8, #16
+    cmp         r8, #16
+    bge         COPY_SHORT_16_LOOP
+COPY_SHORT_2:
+    cmp         r8, #0
+    ble         COPY_SHORT_END
+COPY_SHORT_2_LOOP:
+    ldrh        r9, [r6], #2
+    strh        r9, [r7], #2
+    subs        r8, r8, #2
+    bgt         COPY_SHORT_2_LOOP
+COPY_SHORT_END:
+    add         r2, r2, #64
+    add         r0, r0, r1
+    subs        r4, r4, #1
+    bgt         COPY_SHORT_LOOP
+
+COPY_RESTORE_REG:
+    ldmfd       sp!, {r4-r12,r15}       @ restore registers
+    .fnend
+
+/*
+ * void csc_tile_swap_uv(char *dest, int dest_stride, char *tile_src, int line_size, int lines)
+ */
+    .global csc_tile_swap_uv
+    .type   csc_tile_swap_uv, %function
+csc_tile_swap_uv:
+    .fnstart
+
+    @r0     dest
+    @r1     dest_stride
+    @r2     tile_src
+    @r3     line_size
+    @r4     lines
+    @r5     dest_stride - 32
+    @r6     line src
+    @r7     line dest
+    @r8     bytes left in line
+    @r9     temp1
+    @r10    temp2
+
+    stmfd       sp!, {r4-r12,r14}       @ backup registers
+    ldr         r4, [sp, #40]
+
+    cmp         r4, #0
+    ble         SWAP_RESTORE_REG
+    cmp         r3, #64
+    blt         SWAP_SHORT_LOOP
+
+    sub         r5, r1, #32
+SWAP_FULL_LOOP:
+    pld         [r2, #128]
+    vld1.8      {q0, q1}, [r2]!
+    vld1.8      {q2, q3}, [r2]!
+    vrev16.8    q0, q0                  @ u v to v u
+    vrev16.8    q1, q1
+    vrev16.8    q2, q2
+    vrev16.8    q3, q3
+    vst1.8      {q0, q1}, [r0]!
+    vst1.8      {q2, q3}, [r0], r5
+    subs        r4, r4, #1
+    bgt         SWAP_FULL_LOOP
+    b           SWAP_RESTORE_REG
+
+SWAP_SHORT_LOOP:
+    mov         r6, r2
+    mov         r7, r0
+    mov         r8, r3
+    cmp         r8, #16
+    blt         SWAP_SHORT_2
+SWAP_SHORT_16_LOOP:
+    vld1.8      {q0}, [r6]!
+    vrev16.8    q0, q0
+    vst1.8      {q0}, [r7]!
+    sub         r8, r8, #16
+    cmp         r8, #16
+    bge         SWAP_SHORT_16_LOOP
+SWAP_SHORT_2:
+    cmp         r8, #0
+    ble         SWAP_SHORT_END
+SWAP_SHORT_2_LOOP:
+    ldrb        r9, [r6], #1
+    ldrb        r10, [r6], #1
+    strb        r10, [r7], #1
+    strb        r9, [r7], #1
+    subs        r8, r8, #2
+    bgt         SWAP_SHORT_2_LOOP
+SWAP_SHORT_END:
+    add         r2, r2, #64
+    add         r0, r0, r1
+    subs        r4, r4, #1
+    bgt         SWAP_SHORT_LOOP
+
+SWAP_RESTORE_REG:
+    ldmfd       sp!, {r4-r12,r15}       @ restore registers
+    .fnend
+
+/*
+ * void csc_tile_deinterleave_uv(char *u_dest, char *v_dest, int uv_stride, char *tile_src, int line_size, int lines)
+ */
+    .global csc_tile_deinterleave_uv
+    .type   csc_tile_deinterleave_uv, %function
+csc_tile_deinterleave_uv:
+    .fnstart
+
+    @r0     u_dest
+    @r1     v_dest
+    @r2     uv_stride
+    @r3     tile_src
+    @r4     line_size
+    @r5     lines
+    @r6     uv_stride - 16
+    @r7     line src
+    @r8     line u dest
+    @r9     line v dest
+    @r10    bytes left in line
+    @r11    temp1
+    @r12    temp2
+
+    stmfd       sp!, {r4-r12,r14}       @ backup registers
+    ldr         r4, [sp, #40]
+    ldr         r5, [sp, #44]
+
+    cmp         r5, #0
+    ble         DEINTER_RESTORE_REG
+    cmp         r4, #64
+    blt         DEINTER_SHORT_LOOP
+
+    sub         r6, r2, #16
+DEINTER_FULL_LOOP:
+    pld         [r3, #128]
+    vld2.8      {q0, q1}, [r3]!
+    vld2.8      {q2, q3}, [r3]!
+    vst1.8      {q0}, [r0]!
+    vst1.8      {q2}, [r0], r6
+    vst1.8      {q1}, [r1]!
+    vst1.8      {q3}, [r1], r6
+    subs        r5, r5, #1
+    bgt         DEINTER_FULL_LOOP
+    b           DEINTER_RESTORE_REG
+
+DEINTER_SHORT_LOOP:
+    mov         r7, r3
+    mov         r8, r0
+    mov         r9, r1
+    mov         r10, r4
+    cmp         r10, #32
+    blt         DEINTER_SHORT_2
+DEINTER_SHORT_32_LOOP:
+    vld2.8      {q0, q1}, [r7]!
+    vst1.8      {q0}, [r8]!
+    vst1.8      {q1}, [r9]!
+    sub         r10, r10, #32
+    cmp         r10, #32
+    bge         DEINTER_SHORT_32_LOOP
+DEINTER_SHORT_2:
+    cmp         r10, #0
+    ble         DEINTER_SHORT_END
+DEINTER_SHORT_2_LOOP:
+    ldrb        r11, [r7], #1
+    ldrb        r12, [r7], #1
+    strb        r11, [r8], #1
+    strb        r12, [r9], #1
+    subs        r10, r10, #2
+    bgt         DEINTER_SHORT_2_LOOP
+DEINTER_SHORT_END:
+    add         r3, r3, #64
+    add         r0, r0, r2
+    add         r1, r1, r2
+    subs        r5, r5, #1
+    bgt         DEINTER_SHORT_LOOP
+
+DEINTER_RESTORE_REG:
+    ldmfd       sp!, {r4-r12,r15}       @ restore registers
+    .fnend
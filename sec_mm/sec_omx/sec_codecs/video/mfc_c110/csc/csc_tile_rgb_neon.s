@@ -0,0 +1,182 @@
+/*
+ *
+ * Copyright 2011 Samsung Electronics S.LSI Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * @file    csc_tile_rgb_neon.s
+ * @brief   SEC_OMX specific define
+ * @history
+ *   RGB line kernels driven by csc_tiled_to_rgb() in
+ *   color_space_convertor.c, 16 pixels at a time. BT.601 video range
+ *   with 6 fractional bits, the same arithmetic as the C kernels:
+ *   R = 74(Y-16) + 102(V-128), G = 74(Y-16) - 25(U-128) - 52(V-128),
+ *   B = 74(Y-16) + 129(U-128), rounded, shifted by 6 and saturated.
+ */
+    .arch armv7-a
+    .text
+
+/*
+ * void csc_tile_line_to_rgb565(char *rgb_dest, char *y_src, char *uv_src, int pixels)
+ */
+    .global csc_tile_line_to_rgb565
+    .type   csc_tile_line_to_rgb565, %function
+csc_tile_line_to_rgb565:
+    .fnstart
+
+    @r0     rgb_dest
+    @r1     y_src
+    @r2     uv_src
+    @r3     pixels
+    @q8-q12 74, 102, 25, 52, 129
+    @d30    16
+    @d31    128
+
+    stmfd       sp!, {r4-r12,r14}       @ backup registers
+    vpush       {d8-d15}
+
+    cmp         r3, #0
+    ble         RGB565_RESTORE_REG
+
+    vmov.i16    q8, #74
+    vmov.i16    q9, #102
+    vmov.i16    q10, #25
+    vmov.i16    q11, #52
+    vmov.i16    q12, #129
+    vmov.i8     d30, #16
+    vmov.i8     d31, #128
+
+RGB565_LOOP:
+    vld2.8      {d0, d1}, [r1]!         @ even and odd Y
+    vld2.8      {d2, d3}, [r2]!         @ U and V
+    vsubl.u8    q2, d2, d31             @ U-128
+    vsubl.u8    q3, d3, d31             @ V-128
+    vmul.s16    q4, q3, q9              @ R chroma
+    vmul.s16    q5, q2, q10
+    vmla.s16    q5, q3, q11             @ G chroma, subtracted
+    vmul.s16    q6, q2, q12             @ B chroma
+    vsubl.u8    q7, d0, d30
+    vmul.s16    q7, q7, q8              @ even Y
+    vsubl.u8    q13, d1, d30
+    vmul.s16    q13, q13, q8            @ odd Y
+
+    vqadd.s16   q0, q7, q4
+    vqrshrun.s16 d2, q0, #6             @ even R
+    vqadd.s16   q0, q13, q4
+    vqrshrun.s16 d3, q0, #6             @ odd R
+    vqsub.s16   q0, q7, q5
+    vqrshrun.s16 d4, q0, #6             @ even G
+    vqsub.s16   q0, q13, q5
+    vqrshrun.s16 d5, q0, #6             @ odd G
+    vqadd.s16   q0, q7, q6
+    vqrshrun.s16 d6, q0, #6             @ even B
+    vqadd.s16   q0, q13, q6
+    vqrshrun.s16 d7, q0, #6             @ odd B
+    vzip.8      d2, d3                  @ R in pixel order
+    vzip.8      d4, d5                  @ G in pixel order
+    vzip.8      d6, d7                  @ B in pixel order
+
+    vshll.u8    q7, d2, #8
+    vshll.u8    q13, d4, #8
+    vsri.16     q7, q13, #5
+    vshll.u8    q13, d6, #8
+    vsri.16     q7, q13, #11            @ pixels 0 to 7
+    vshll.u8    q0, d3, #8
+    vshll.u8    q13, d5, #8
+    vsri.16     q0, q13, #5
+    vshll.u8    q13, d7, #8
+    vsri.16     q0, q13, #11            @ pixels 8 to 15
+    vst1.16     {q7}, [r0]!
+    vst1.16     {q0}, [r0]!
+
+    subs        r3, r3, #16
+    bgt         RGB565_LOOP
+
+RGB565_RESTORE_REG:
+    vpop        {d8-d15}
+    ldmfd       sp!, {r4-r12,r15}       @ restore registers
+    .fnend
+
+/*
+ * void csc_tile_line_to_rgba8888(char *rgb_dest, char *y_src, char *uv_src, int pixels)
+ */
+    .global csc_tile_line_to_rgba8888
+    .type   csc_tile_line_to_rgba8888, %function
+csc_tile_line_to_rgba8888:
+    .fnstart
+
+    @r0     rgb_dest
+    @r1     y_src
+    @r2     uv_src
+    @r3     pixels
+    @q8-q12 74, 102, 25, 52, 129
+    @d30    16
+    @d31    128
+
+    stmfd       sp!, {r4-r12,r14}       @ backup registers
+    vpush       {d8-d15}
+
+    cmp         r3, #0
+    ble         RGBA8888_RESTORE_REG
+
+    vmov.i16    q8, #74
+    vmov.i16    q9, #102
+    vmov.i16    q10, #25
+    vmov.i16    q11, #52
+    vmov.i16    q12, #129
+    vmov.i8     d30, #16
+    vmov.i8     d31, #128
+
+RGBA8888_LOOP:
+    vld2.8      {d0, d1}, [r1]!         @ even and odd Y
+    vld2.8      {d2, d3}, [r2]!         @ U and V
+    vsubl.u8    q2, d2, d31             @ U-128
+    vsubl.u8    q3, d3, d31             @ V-128
+    vmul.s16    q4, q3, q9              @ R chroma
+    vmul.s16    q5, q2, q10
+    vmla.s16    q5, q3, q11             @ G chroma, subtracted
+    vmul.s16    q6, q2, q12             @ B chroma
+    vsubl.u8    q7, d0, d30
+    vmul.s16    q7, q7, q8              @ even Y
+    vsubl.u8    q13, d1, d30
+    vmul.s16    q13, q13, q8            @ odd Y
+
+    vqadd.s16   q0, q7, q4
+    vqrshrun.s16 d2, q0, #6             @ even R
+    vqadd.s16   q0, q13, q4
+    vqrshrun.s16 d3, q0, #6             @ odd R
+    vqsub.s16   q0, q7, q5
+    vqrshrun.s16 d4, q0, #6             @ even G
+    vqsub.s16   q0, q13, q5
+    vqrshrun.s16 d5, q0, #6             @ odd G
+    vqadd.s16   q0, q7, q6
+    vqrshrun.s16 d6, q0, #6             @ even B
+    vqadd.s16   q0, q13, q6
+    vqrshrun.s16 d7, q0, #6             @ odd B
+    vzip.8      d2, d3                  @ R in pixel order
+    vzip.8      d4, d5                  @ G in pixel order
+    vzip.8      d6, d7                  @ B in pixel order
+    vmov.i8     q4, #255                @ alpha
+
+    vst4.8      {d2, d4, d6, d8}, [r0]! @ pixels 0 to 7
+    vst4.8      {d3, d5, d7, d9}, [r0]! @ pixels 8 to 15
+
+    subs        r3, r3, #16
+    bgt         RGBA8888_LOOP
+
+RGBA8888_RESTORE_REG:
+    vpop        {d8-d15}
+    ldmfd       sp!, {r4-r12,r15}       @ restore registers
+    .fnend
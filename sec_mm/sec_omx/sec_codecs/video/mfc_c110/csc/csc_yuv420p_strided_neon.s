@@ -0,0 +1,116 @@
+/*
+ *
+ * Copyright 2011 Samsung Electronics S.LSI Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * @file    csc_yuv420p_strided_neon.s
+ * @brief   SEC_OMX specific define
+ * @history
+ *   Copies a packed YUV420P frame into strided Y, U and V planes
+ */
+    .arch armv7-a
+    .text
+    .global csc_linear_to_strided
+    .type   csc_linear_to_strided, %function
+csc_linear_to_strided:
+    .fnstart
+
+    @r0     y_dest
+    @r1     u_dest
+    @r2     v_dest
+    @r3     yuv420p_src
+    @r4     width of current plane
+    @r5     height
+    @r6     y_stride, then temp
+    @r7     uv_stride
+    @r8     bytes left in row
+    @r9     row dest
+    @r10    plane dest
+    @r11    rows left in plane
+    @r12    stride of current plane
+    @r14    plane index
+
+    stmfd       sp!, {r4-r12,r14}       @ backup registers
+    ldr         r4, [sp, #40]
+    ldr         r5, [sp, #44]
+    ldr         r6, [sp, #48]
+    ldr         r7, [sp, #52]
+
+    mov         r10, r0
+    mov         r11, r5
+    mov         r12, r6
+    mov         r14, #0
+
+    cmp         r11, #0
+    ble         RESTORE_REG
+
+ROW_LOOP:
+    mov         r9, r10
+    mov         r8, r4
+    cmp         r8, #64
+    blt         ROW_SIZE_16
+
+ROW_SIZE_64_LOOP:
+    pld         [r3, #128]
+    vld1.8      {q0, q1}, [r3]!
+    vld1.8      {q2, q3}, [r3]!
+    pld         [r3, #128]
+    vst1.8      {q0, q1}, [r9]!
+    vst1.8      {q2, q3}, [r9]!
+    sub         r8, r8, #64
+    cmp         r8, #64
+    bge         ROW_SIZE_64_LOOP
+
+ROW_SIZE_16:
+    cmp         r8, #16
+    blt         ROW_SIZE_1
+ROW_SIZE_16_LOOP:
+    vld1.8      {q0}, [r3]!
+    vst1.8      {q0}, [r9]!
+    sub         r8, r8, #16
+    cmp         r8, #16
+    bge         ROW_SIZE_16_LOOP
+
+ROW_SIZE_1:
+    cmp         r8, #0
+    ble         ROW_END
+ROW_SIZE_1_LOOP:
+    ldrb        r6, [r3], #1
+    strb        r6, [r9], #1
+    subs        r8, r8, #1
+    bgt         ROW_SIZE_1_LOOP
+
+ROW_END:
+    add         r10, r10, r12
+    subs        r11, r11, #1
+    bgt         ROW_LOOP
+
+    @ chroma planes are half width and half height
+    add         r14, r14, #1
+    cmp         r14, #3
+    beq         RESTORE_REG
+    cmp         r14, #1
+    moveq       r10, r1
+    moveq       r4, r4, lsr #1
+    movne       r10, r2
+    mov         r11, r5, lsr #1
+    mov         r12, r7
+    cmp         r11, #0
+    bgt         ROW_LOOP
+
+RESTORE_REG:
+    ldmfd       sp!, {r4-r12,r15}       @ restore registers
+    .fnend
@@ -30,58 +30,67 @@
 
 #define _MFCLIB_MAGIC_NUMBER    0x92241000
 
-#define USR_DATA_START_CODE     (0x000001B2)
-#define VOP_START_CODE          (0x000001B6)
-#define MP4_START_CODE          (0x000001)
-
-static void getAByte(char *buff, int *code)
+/* the last byte of a 0x000001xx start code */
+#define USR_DATA_START_CODE     (0xB2)
+#define VOP_START_CODE          (0xB6)
+#define VOL_START_CODE_MIN      (0x20)
+#define VOL_START_CODE_MAX      (0x2F)
+
+/* the next 00 00 01 in [p, end), memchr looks for the 01 a word at a time */
+static const unsigned char *findStartCode(const unsigned char *p, const unsigned char *end)
 {
-    int byte;
+    const unsigned char *one;
+
+    while (end - p >= 3) {
+        one = memchr(p + 2, 0x01, end - (p + 2));
+        if (one == NULL)
+            return NULL;
+        if ((one[-1] == 0) && (one[-2] == 0))
+            return one - 2;
+        p = one - 1;
+    }
 
-    *code = (*code << 8);
-    byte = (int)*buff;
-    byte &= 0xFF;
-    *code |= byte;
+    return NULL;
 }
 
-static mfc_packed_mode isPBPacked(_MFCLIB *pCtx, int length)
+/*
+ * a DivX stream packs a B frame behind each P frame when the user data
+ * ahead of the first VOP carries a 'p' (DivX503b1393p). only the headers
+ * of a VOL say so, so the mode is kept for the stream until the next VOL.
+ */
+static mfc_packed_mode updatePackedPB(_MFCLIB *pCtx, int length)
 {
-    char *strmBuffer = NULL;
-    char *strmBufferEnd = NULL;
-    int startCode = 0xFFFFFFFF;
-
-    strmBuffer = (char *)pCtx->virStrmBuf;
-    strmBufferEnd = (char *)pCtx->virStrmBuf + length;
-
-    while (1) {
-        while (startCode != USR_DATA_START_CODE) {
-            if (startCode == VOP_START_CODE) {
-                ALOGV("isPBPacked: VOP START Found !!.....return\n");
-                ALOGV("isPBPacked: Non Packed PB\n");
-                return MFC_UNPACKED_PB;
-            }
-            getAByte(strmBuffer, &startCode);
-            strmBuffer++;
-            if (strmBuffer >= strmBufferEnd)
-                goto out;
+    const unsigned char *p = (const unsigned char *)pCtx->virStrmBuf;
+    const unsigned char *end = p + length;
+    const unsigned char *next;
+    mfc_packed_mode mode = MFC_UNPACKED_PB;
+    unsigned char code;
+    int vol = 0;
+
+    while (((p = findStartCode(p, end)) != NULL) && (p + 3 < end)) {
+        code = p[3];
+        if (code == VOP_START_CODE)
+            break;
+        p += 4;
+
+        if ((code >= VOL_START_CODE_MIN) && (code <= VOL_START_CODE_MAX)) {
+            vol = 1;
+        } else if (code == USR_DATA_START_CODE) {
+            next = findStartCode(p, end);
+            if (memchr(p, 'p', (next != NULL ? next : end) - p) != NULL)
+                mode = MFC_PACKED_PB;
         }
-        ALOGV("isPBPacked: User Data Found !!\n");
-
-        do {
-            if (*strmBuffer == 'p') {
-                ALOGI("isPBPacked: Packed PB\n");
-                return MFC_PACKED_PB;
-            }
-            getAByte(strmBuffer, &startCode);
-            strmBuffer++;
-            if (strmBuffer >= strmBufferEnd)
-                goto out;
-        } while ((startCode >> 8) != MP4_START_CODE);
     }
 
-out:
-    ALOGV("isPBPacked: Non Packed PB\n");
-    return MFC_UNPACKED_PB;
+    if (vol || !pCtx->packedPBValid) {
+        if (pCtx->packedPBValid && (pCtx->packedPB != mode))
+            ALOGI("updatePackedPB: new VOL is %spacked PB\n", (mode == MFC_PACKED_PB) ? "" : "not ");
+        pCtx->packedPB = mode;
+        pCtx->packedPBValid = 1;
+    }
+
+    ALOGV("updatePackedPB: %s\n", (pCtx->packedPB == MFC_PACKED_PB) ? "Packed PB" : "Non Packed PB");
+    return pCtx->packedPB;
 }
 
 void *SsbSipMfcDecOpen(void *value)
@@ -169,7 +178,7 @@ SSBSIP_MFC_ERROR_CODE SsbSipMfcDecInit(void *openHandle, SSBSIP_MFC_CODEC_TYPE c
         (pCTX->codec_type == FIMV3_DEC) ||
         (pCTX->codec_type == FIMV4_DEC) ||
         (pCTX->codec_type == XVID_DEC))
-        packedPB = isPBPacked(pCTX, Frameleng);
+        packedPB = updatePackedPB(pCTX, Frameleng);
 
     /* init args */
     DecArg.args.dec_init.in_codec_type = pCTX->codec_type;
@@ -267,6 +276,42 @@ SSBSIP_MFC_ERROR_CODE SsbSipMfcDecExe(void *openHandle, int lengthBufFill)
     return MFC_RET_OK;
 }
 
+/*
+ * SetInBuf, SetConfig(FRAME_TAG), Exe, GetOutBuf and GetConfig(FRAME_TAG)
+ * in one call. the stream, the tag and the output all travel with the one
+ * IOCTL_MFC_DEC_EXE the run takes, the driver has nothing else to batch.
+ * the output is filled in even when the run failed, as GetOutBuf would.
+ */
+SSBSIP_MFC_ERROR_CODE SsbSipMfcDecExeFrame(void *openHandle, SSBSIP_MFC_DEC_FRAME *frame)
+{
+    SSBSIP_MFC_ERROR_CODE ret;
+    _MFCLIB *pCTX;
+
+    if (openHandle == NULL) {
+        ALOGE("SsbSipMfcDecExeFrame: openHandle is NULL\n");
+        return MFC_RET_INVALID_PARAM;
+    }
+
+    if (frame == NULL) {
+        ALOGE("SsbSipMfcDecExeFrame: frame is NULL\n");
+        return MFC_RET_INVALID_PARAM;
+    }
+
+    pCTX = (_MFCLIB *)openHandle;
+
+    pCTX->phyStrmBuf = (int)frame->phyInBuf;
+    pCTX->virStrmBuf = (int)frame->virInBuf;
+    pCTX->sizeStrmBuf = frame->inputBufferSize;
+    pCTX->in_frametag = frame->in_frametag;
+
+    ret = SsbSipMfcDecExe(openHandle, frame->lengthBufFill);
+
+    frame->status = SsbSipMfcDecGetOutBuf(openHandle, &frame->output);
+    frame->out_frametag = pCTX->out_frametag_top;
+
+    return ret;
+}
+
 SSBSIP_MFC_ERROR_CODE SsbSipMfcDecClose(void *openHandle)
 {
     int ret_code;
@@ -394,6 +394,12 @@ SSBSIP_MFC_ERROR_CODE SsbSipMfcEncExe(void *openHandle)
         EncArg.args.enc_exe.in_strm_st = (unsigned int)pCTX->phyStrmBuf + (MAX_ENCODER_OUTPUT_BUFFER_SIZE/2);
         EncArg.args.enc_exe.in_strm_end = (unsigned int)pCTX->phyStrmBuf  + (MAX_ENCODER_OUTPUT_BUFFER_SIZE/2) + pCTX->sizeStrmBuf;
     }
+    if (pCTX->phyUsrStrmBuf != 0) {
+        EncArg.args.enc_exe.in_strm_st = pCTX->phyUsrStrmBuf;
+        EncArg.args.enc_exe.in_strm_end = pCTX->phyUsrStrmBuf + pCTX->sizeUsrStrmBuf;
+    }
+    pCTX->phyEncodedStrm = pCTX->phyUsrStrmBuf;
+    pCTX->virEncodedStrm = pCTX->virUsrStrmBuf;
 
     ret_code = ioctl(pCTX->hMFC, IOCTL_MFC_ENC_EXE, &EncArg);
     if (EncArg.ret_code != MFC_RET_OK) {
@@ -562,6 +568,10 @@ SSBSIP_MFC_ERROR_CODE SsbSipMfcEncGetOutBuf(void *openHandle, SSBSIP_MFC_ENC_OUT
         output_info->StrmPhyAddr = (unsigned char *)pCTX->phyStrmBuf + (MAX_ENCODER_OUTPUT_BUFFER_SIZE/2);
         output_info->StrmVirAddr = (unsigned char *)pCTX->virStrmBuf + (MAX_ENCODER_OUTPUT_BUFFER_SIZE/2);
     }
+    if (pCTX->phyEncodedStrm != 0) {
+        output_info->StrmPhyAddr = (void *)pCTX->phyEncodedStrm;
+        output_info->StrmVirAddr = (void *)pCTX->virEncodedStrm;
+    }
 
     pCTX->encode_cnt ++;
     pCTX->encode_cnt %= 2;
@@ -598,9 +608,14 @@ SSBSIP_MFC_ERROR_CODE SsbSipMfcEncSetOutBuf(void *openHandle, void *phyOutbuf, v
 
     pCTX = (_MFCLIB *)openHandle;
 
-    pCTX->phyStrmBuf = (int)phyOutbuf;
-    pCTX->virStrmBuf = (int)virOutbuf;
-    pCTX->sizeStrmBuf = outputBufferSize;
+    /*
+     * the frames after this go to the given buffer, or back to the own
+     * stream buffer when phyOutbuf is NULL. the own one is kept, it is
+     * freed on close and still holds the header.
+     */
+    pCTX->phyUsrStrmBuf = (unsigned int)phyOutbuf;
+    pCTX->virUsrStrmBuf = (unsigned int)virOutbuf;
+    pCTX->sizeUsrStrmBuf = outputBufferSize;
 
     return MFC_RET_OK;
 }
@@ -154,6 +154,18 @@ typedef struct {
     int crop_right_offset;              // [OUT] crop information, right_offset
 } SSBSIP_MFC_DEC_OUTPUT_INFO;
 
+typedef struct {
+    void *phyInBuf;                     // [IN] physical address of the stream buffer
+    void *virInBuf;                     // [IN] virtual address of the stream buffer
+    int inputBufferSize;                // [IN] size of the stream buffer
+    int lengthBufFill;                  // [IN] bytes of the stream to decode
+    int in_frametag;                    // [IN] tag of the frame, handed back when it is displayed
+
+    SSBSIP_MFC_DEC_OUTBUF_STATUS status;    // [OUT] what the run displayed and decoded
+    int out_frametag;                   // [OUT] tag of the frame displayed
+    SSBSIP_MFC_DEC_OUTPUT_INFO output;  // [OUT] the frame displayed
+} SSBSIP_MFC_DEC_FRAME;
+
 typedef struct {
     void *YPhyAddr;                     // [IN/OUT] physical address of Y
     void *CPhyAddr;                     // [IN/OUT] physical address of CbCr
@@ -297,6 +309,7 @@ extern "C" {
 void *SsbSipMfcDecOpen(void *value);
 SSBSIP_MFC_ERROR_CODE SsbSipMfcDecInit(void *openHandle, SSBSIP_MFC_CODEC_TYPE codec_type, int Frameleng);
 SSBSIP_MFC_ERROR_CODE SsbSipMfcDecExe(void *openHandle, int lengthBufFill);
+SSBSIP_MFC_ERROR_CODE SsbSipMfcDecExeFrame(void *openHandle, SSBSIP_MFC_DEC_FRAME *frame);
 SSBSIP_MFC_ERROR_CODE SsbSipMfcDecClose(void *openHandle);
 
 void *SsbSipMfcDecGetInBuf(void *openHandle, void **phyInBuf, int inputBufferSize);
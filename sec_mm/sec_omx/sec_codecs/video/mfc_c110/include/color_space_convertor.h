@@ -53,6 +53,10 @@
 #ifndef COLOR_SPACE_CONVERTOR_H_
 #define COLOR_SPACE_CONVERTOR_H_
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 /*--------------------------------------------------------------------------------*/
 /* Format Conversion API                                                          */
 /*--------------------------------------------------------------------------------*/
@@ -111,6 +115,25 @@ void csc_interleave_memcpy(char *dest, char *src1, char *src2, int src_size);
  */
 void csc_tiled_to_linear(char *yuv420p_y_dest, char *nv12t_y_src, int yuv420p_width, int yuv420p_y_height);
 
+/*
+ * Converts tiled data to linear like csc_tiled_to_linear(), a band of two
+ * tile rows at a time with the source read in memory order, so that the
+ * output band stays in L2 and the source streams through the prefetch.
+ *
+ * @param yuv420_dest
+ *   Y or UV plane address of YUV420[out]
+ *
+ * @param nv12t_src
+ *   Y or UV plane address of NV12T[in]
+ *
+ * @param yuv420_width
+ *   Width of YUV420[in]
+ *
+ * @param yuv420_height
+ *   Y: Height of YUV420, UV: Height/2 of YUV420[in]
+ */
+void csc_tiled_to_linear_blocked(char *yuv420_dest, char *nv12t_src, int yuv420_width, int yuv420_height);
+
 /*
  * Converts and Deinterleaves tiled data to linear
  * 1. UV of NV12T to UV of YUV420P
@@ -173,4 +196,167 @@ void csc_linear_to_tiled(char *nv12t_dest, char *yuv420p_src, int yuv420p_width,
  */
 void csc_linear_to_tiled_interleave(char *nv12t_uv_dest, char *yuv420p_u_src, char *yuv420p_v_src, int yuv420p_width, int yuv420p_uv_height);
 
+/*
+ * Copies YUV420P to strided Y, U and V planes
+ *
+ * @param y_dest
+ *   Y plane address of destination[out]
+ *
+ * @param u_dest
+ *   U plane address of destination[out]
+ *
+ * @param v_dest
+ *   V plane address of destination[out]
+ *
+ * @param yuv420p_src
+ *   Address of packed YUV420P, Y then U then V[in]
+ *
+ * @param yuv420p_width
+ *   Width of YUV420P[in]
+ *
+ * @param yuv420p_height
+ *   Height of YUV420P[in]
+ *
+ * @param y_stride
+ *   Line length of destination Y plane[in]
+ *
+ * @param uv_stride
+ *   Line length of destination U and V planes[in]
+ */
+void csc_linear_to_strided(char *y_dest, char *u_dest, char *v_dest, char *yuv420p_src, int yuv420p_width, int yuv420p_height, int y_stride, int uv_stride);
+
+/*
+ * Converts NV12T to NV21 in one pass over the tiles
+ *
+ * @param y_dest
+ *   Y plane address of NV21[out]
+ *
+ * @param vu_dest
+ *   VU plane address of NV21[out]
+ *
+ * @param nv12t_y_src
+ *   Y plane address of NV12T[in]
+ *
+ * @param nv12t_uv_src
+ *   UV plane address of NV12T[in]
+ *
+ * @param width
+ *   Width of NV21, even[in]
+ *
+ * @param height
+ *   Height of NV21, even[in]
+ */
+void csc_tiled_to_nv21(char *y_dest, char *vu_dest, char *nv12t_y_src, char *nv12t_uv_src, int width, int height);
+
+/*
+ * Converts NV12T to YV12 with strided planes in one pass over the tiles
+ *
+ * @param y_dest
+ *   Y plane address of YV12[out]
+ *
+ * @param v_dest
+ *   V plane address of YV12[out]
+ *
+ * @param u_dest
+ *   U plane address of YV12[out]
+ *
+ * @param nv12t_y_src
+ *   Y plane address of NV12T[in]
+ *
+ * @param nv12t_uv_src
+ *   UV plane address of NV12T[in]
+ *
+ * @param width
+ *   Width of YV12, even[in]
+ *
+ * @param height
+ *   Height of YV12, even[in]
+ *
+ * @param y_stride
+ *   Line length of Y plane[in]
+ *
+ * @param uv_stride
+ *   Line length of V and U planes[in]
+ */
+void csc_tiled_to_yv12(char *y_dest, char *v_dest, char *u_dest, char *nv12t_y_src, char *nv12t_uv_src,
+                       int width, int height, int y_stride, int uv_stride);
+
+/*
+ * Converts NV12T to RGB565 in one pass over the tiles, optionally
+ * shrinking by 2 or 4 with a box filter
+ *
+ * @param rgb_dest
+ *   RGB565 address[out]
+ *
+ * @param nv12t_y_src
+ *   Y plane address of NV12T[in]
+ *
+ * @param nv12t_uv_src
+ *   UV plane address of NV12T[in]
+ *
+ * @param width
+ *   Width of NV12T, even[in]
+ *
+ * @param height
+ *   Height of NV12T, even[in]
+ *
+ * @param rgb_stride
+ *   Line length of RGB565 in bytes[in]
+ *
+ * @param scale
+ *   0 full size, 1 half, 2 quarter: RGB565 is width >> scale by
+ *   height >> scale[in]
+ */
+void csc_tiled_to_rgb565(char *rgb_dest, char *nv12t_y_src, char *nv12t_uv_src,
+                         int width, int height, int rgb_stride, int scale);
+
+/*
+ * Converts NV12T to RGBA8888 in one pass over the tiles, optionally
+ * shrinking by 2 or 4 with a box filter
+ *
+ * @param rgb_dest
+ *   RGBA8888 address[out]
+ *
+ * @param nv12t_y_src
+ *   Y plane address of NV12T[in]
+ *
+ * @param nv12t_uv_src
+ *   UV plane address of NV12T[in]
+ *
+ * @param width
+ *   Width of NV12T, even[in]
+ *
+ * @param height
+ *   Height of NV12T, even[in]
+ *
+ * @param rgb_stride
+ *   Line length of RGBA8888 in bytes[in]
+ *
+ * @param scale
+ *   0 full size, 1 half, 2 quarter: RGBA8888 is width >> scale by
+ *   height >> scale[in]
+ */
+void csc_tiled_to_rgba8888(char *rgb_dest, char *nv12t_y_src, char *nv12t_uv_src,
+                           int width, int height, int rgb_stride, int scale);
+
+/*
+ * Line kernels for one 64x32 tile, lines of the tile are 64 bytes apart.
+ * line_size is 64 or less at the right edge, lines 32 or less at the
+ * bottom edge.
+ */
+void csc_tile_copy(char *dest, int dest_stride, char *tile_src, int line_size, int lines);
+void csc_tile_swap_uv(char *dest, int dest_stride, char *tile_src, int line_size, int lines);
+void csc_tile_deinterleave_uv(char *u_dest, char *v_dest, int uv_stride, char *tile_src, int line_size, int lines);
+
+/*
+ * Line kernels converting one Y line and its UV line to RGB, a UV pair
+ * for two pixels, 16 pixels at a time.
+ */
+void csc_tile_line_to_rgb565(char *rgb_dest, char *y_src, char *uv_src, int pixels);
+void csc_tile_line_to_rgba8888(char *rgb_dest, char *y_src, char *uv_src, int pixels);
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif /*COLOR_SPACE_CONVERTOR_H_*/
@@ -342,6 +342,16 @@ typedef struct {
     unsigned int encoded_Y_paddr;
     unsigned int encoded_C_paddr;
     unsigned int encode_cnt;
+    /* client stream buffer set for the next frames, the own one is used when 0 */
+    unsigned int phyUsrStrmBuf;
+    unsigned int virUsrStrmBuf;
+    int sizeUsrStrmBuf;
+    /* client stream buffer the last frame went to, 0 for the own one */
+    unsigned int phyEncodedStrm;
+    unsigned int virEncodedStrm;
+    /* mpeg4 packed PB mode of the stream, found at the last VOL header */
+    mfc_packed_mode packedPB;
+    int packedPBValid;
 } _MFCLIB;
 
 #endif /* _MFC_INTERFACE_H_ */
@@ -0,0 +1,41 @@
+LOCAL_PATH := $(call my-dir)
+include $(CLEAR_VARS)
+
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_SRC_FILES := \
+	mfc_bench.c
+
+LOCAL_MODULE := mfc-bench
+
+LOCAL_ARM_MODE := arm
+
+LOCAL_STATIC_LIBRARIES := libsecmfcdecapi.aries libsecmfcencapi.aries libseccsc.aries
+
+LOCAL_SHARED_LIBRARIES := liblog
+
+LOCAL_C_INCLUDES := \
+	$(SEC_OMX_TOP)/../../include \
+	$(SEC_CODECS)/video/mfc_c110/include
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_SRC_FILES := \
+	csc_test.c \
+	csc_reference.c
+
+LOCAL_MODULE := csc-test
+
+LOCAL_ARM_MODE := arm
+
+LOCAL_STATIC_LIBRARIES := libseccsc.aries
+
+LOCAL_C_INCLUDES := \
+	$(SEC_OMX_TOP)/../../include \
+	$(SEC_CODECS)/video/mfc_c110/include
+
+include $(BUILD_EXECUTABLE)
@@ -0,0 +1,43 @@
+/*
+ *
+ * Copyright 2011 Samsung Electronics S.LSI Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * The C paths of color_space_convertor.c under a ref_ prefix, so that
+ * csc-test can link them next to the NEON kernels of libseccsc.aries.
+ */
+
+#undef USE_NEON_CSC
+
+#define csc_deinterleave_memcpy             ref_csc_deinterleave_memcpy
+#define csc_interleave_memcpy               ref_csc_interleave_memcpy
+#define csc_tiled_to_linear                 ref_csc_tiled_to_linear
+#define csc_tiled_to_linear_deinterleave    ref_csc_tiled_to_linear_deinterleave
+#define csc_tiled_to_linear_blocked         ref_csc_tiled_to_linear_blocked
+#define csc_linear_to_tiled                 ref_csc_linear_to_tiled
+#define csc_linear_to_tiled_interleave      ref_csc_linear_to_tiled_interleave
+#define csc_linear_to_strided               ref_csc_linear_to_strided
+#define csc_tiled_to_nv21                   ref_csc_tiled_to_nv21
+#define csc_tiled_to_yv12                   ref_csc_tiled_to_yv12
+#define csc_tile_copy                       ref_csc_tile_copy
+#define csc_tile_swap_uv                    ref_csc_tile_swap_uv
+#define csc_tile_deinterleave_uv            ref_csc_tile_deinterleave_uv
+#define csc_tiled_to_rgb565                 ref_csc_tiled_to_rgb565
+#define csc_tiled_to_rgba8888               ref_csc_tiled_to_rgba8888
+#define csc_tile_line_to_rgb565             ref_csc_tile_line_to_rgb565
+#define csc_tile_line_to_rgba8888           ref_csc_tile_line_to_rgba8888
+
+#include "../csc/color_space_convertor.c"
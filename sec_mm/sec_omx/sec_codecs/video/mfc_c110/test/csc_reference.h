@@ -0,0 +1,41 @@
+/*
+ *
+ * Copyright 2011 Samsung Electronics S.LSI Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * The C reference of every kernel in color_space_convertor.h, built from
+ * the same source by csc_reference.c.
+ */
+
+#ifndef CSC_REFERENCE_H_
+#define CSC_REFERENCE_H_
+
+void ref_csc_deinterleave_memcpy(char *dest1, char *dest2, char *src, int src_size);
+void ref_csc_interleave_memcpy(char *dest, char *src1, char *src2, int src_size);
+void ref_csc_tiled_to_linear(char *yuv420p_y_dest, char *nv12t_y_src, int yuv420p_width, int yuv420p_y_height);
+void ref_csc_tiled_to_linear_deinterleave(char *yuv420p_u_dest, char *yuv420p_v_dest, char *nv12t_uv_src, int yuv420p_width, int yuv420p_uv_height);
+void ref_csc_linear_to_tiled(char *nv12t_dest, char *yuv420p_src, int yuv420p_width, int yuv420p_y_height);
+void ref_csc_linear_to_tiled_interleave(char *nv12t_uv_dest, char *yuv420p_u_src, char *yuv420p_v_src, int yuv420p_width, int yuv420p_uv_height);
+void ref_csc_linear_to_strided(char *y_dest, char *u_dest, char *v_dest, char *yuv420p_src, int yuv420p_width, int yuv420p_height, int y_stride, int uv_stride);
+void ref_csc_tiled_to_nv21(char *y_dest, char *vu_dest, char *nv12t_y_src, char *nv12t_uv_src, int width, int height);
+void ref_csc_tiled_to_yv12(char *y_dest, char *v_dest, char *u_dest, char *nv12t_y_src, char *nv12t_uv_src,
+                           int width, int height, int y_stride, int uv_stride);
+void ref_csc_tiled_to_rgb565(char *rgb_dest, char *nv12t_y_src, char *nv12t_uv_src,
+                             int width, int height, int rgb_stride, int scale);
+void ref_csc_tiled_to_rgba8888(char *rgb_dest, char *nv12t_y_src, char *nv12t_uv_src,
+                               int width, int height, int rgb_stride, int scale);
+
+#endif
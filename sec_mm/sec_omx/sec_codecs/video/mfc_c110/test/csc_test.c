@@ -0,0 +1,535 @@
+/*
+ *
+ * Copyright 2010 Samsung Electronics S.LSI Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Checks every kernel of libseccsc.aries bit exactly against its C
+ * reference, over sizes that end inside a tile, on a tile and on a tile
+ * pair, and fails when a kernel writes past the end of its destination
+ * where the reference does not.
+ * Then measures each kernel at the common video sizes.
+ *
+ * usage: csc-test [-t] [-b] [-n runs]
+ *
+ *   -t  correctness only
+ *   -b  benchmark only
+ *   -n  runs of each kernel per size, 20 by default
+ *
+ * results go to stdout as "RESULT <config> <metric> <value> <unit>"
+ * lines, failures as "FAIL <kernel> <width>x<height> ..." lines. The
+ * exit code is the number of failed checks, at most 255.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sec_bench.h>
+
+#include "color_space_convertor.h"
+#include "csc_reference.h"
+
+#define ALIGN(x, a)     (((x) + (a) - 1) & ~((a) - 1))
+
+/* bytes after every destination watched for stray writes */
+#define GUARD_SIZE      4096
+#define GUARD_BYTE      0xA5
+
+/* a NV12T plane, the width aligned to a tile pair and the height to a tile */
+#define TILED_SIZE(w, h)    (ALIGN(w, 128) * ALIGN(h, 32))
+
+typedef struct {
+    int width;
+    int height;
+} SIZE;
+
+/* odd line lengths, short tiles, single tiles, tile pairs and their neighbours */
+static const int kWidths[]  = { 2, 16, 30, 62, 64, 66, 126, 128, 130, 176, 192, 254, 320,
+                                352, 480, 640, 720, 800, 854, 1024, 1280, 1920 };
+static const int kHeights[] = { 2, 4, 16, 30, 32, 34, 62, 64, 66, 96, 144, 240, 288, 480,
+                                576, 720, 1080 };
+
+static const char *kRgbNames[3][2] = {
+    { "tiled_to_rgb565", "tiled_to_rgba8888" },
+    { "tiled_to_rgb565_half", "tiled_to_rgba8888_half" },
+    { "tiled_to_rgb565_quarter", "tiled_to_rgba8888_quarter" },
+};
+
+static const SIZE kBenchSizes[] = {
+    { 176, 144 },
+    { 320, 240 },
+    { 640, 480 },
+    { 720, 480 },
+    { 1280, 720 },
+    { 1920, 1080 },
+};
+
+static int gFailures = 0;
+
+static double now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000.0 + ts.tv_nsec / 1000.0;
+}
+
+/* the clock the cycles per pixel are worked out with, 0 when it is unknown */
+static double cpu_mhz(void)
+{
+    FILE *fp = fopen("/sys/devices/system/cpu/cpu0/cpufreq/scaling_cur_freq", "r");
+    long  khz = 0;
+
+    if (fp == NULL)
+        return 0;
+    if (fscanf(fp, "%ld", &khz) != 1)
+        khz = 0;
+    fclose(fp);
+
+    return khz / 1000.0;
+}
+
+static void fill(char *pBuf, int size, unsigned int seed)
+{
+    int i;
+
+    for (i = 0; i < size; i++) {
+        seed = seed * 1103515245 + 12345;
+        pBuf[i] = (char)(seed >> 16);
+    }
+}
+
+static char *alloc_dest(int size)
+{
+    return malloc(size + GUARD_SIZE);
+}
+
+/* clears a destination of size bytes and puts the guard behind it */
+static void reset_dest(char *pBuf, int size)
+{
+    memset(pBuf, 0, size);
+    memset(pBuf + size, GUARD_BYTE, GUARD_SIZE);
+}
+
+/*
+ * The C kernels themselves run past the plane for sizes off their block
+ * sizes, so only a write behind size the reference did not make counts.
+ */
+static int guard_intact(char *pOut, char *pRef, int size)
+{
+    int i;
+
+    for (i = 0; i < GUARD_SIZE; i++) {
+        if ((unsigned char)pOut[size + i] != GUARD_BYTE &&
+            (unsigned char)pRef[size + i] == GUARD_BYTE)
+            return 0;
+    }
+    return 1;
+}
+
+/* compares lines of length bytes, stride apart */
+static void check(const char *kernel, int width, int height, const char *plane,
+                  char *pOut, char *pRef, int length, int lines, int stride, int size)
+{
+    int i, j;
+
+    for (i = 0; i < lines; i++) {
+        if (memcmp(pOut + i * stride, pRef + i * stride, length) == 0)
+            continue;
+        for (j = 0; j < length; j++) {
+            if (pOut[i * stride + j] != pRef[i * stride + j])
+                break;
+        }
+        printf("FAIL %s %dx%d %s mismatch at line %d byte %d\n", kernel, width, height, plane, i, j);
+        gFailures++;
+        return;
+    }
+
+    if (!guard_intact(pOut, pRef, size)) {
+        printf("FAIL %s %dx%d %s writes past the end\n", kernel, width, height, plane);
+        gFailures++;
+    }
+}
+
+static void test_memcpy(int size)
+{
+    char *pSrc1 = malloc(size * 2);
+    char *pSrc2 = malloc(size);
+    char *pOut1 = alloc_dest(size * 2);
+    char *pOut2 = alloc_dest(size);
+    char *pRef1 = alloc_dest(size * 2);
+    char *pRef2 = alloc_dest(size);
+
+    fill(pSrc1, size * 2, size);
+    fill(pSrc2, size, size + 1);
+
+    reset_dest(pOut1, size * 2);
+    reset_dest(pRef1, size * 2);
+    csc_interleave_memcpy(pOut1, pSrc1, pSrc2, size);
+    ref_csc_interleave_memcpy(pRef1, pSrc1, pSrc2, size);
+    check("interleave_memcpy", size, 1, "dest", pOut1, pRef1, size * 2, 1, 0, size * 2);
+
+    /* de-interleaving takes the interleaved size, one half goes to each destination */
+    reset_dest(pOut1, size);
+    reset_dest(pOut2, size);
+    reset_dest(pRef1, size);
+    reset_dest(pRef2, size);
+    csc_deinterleave_memcpy(pOut1, pOut2, pSrc1, size * 2);
+    ref_csc_deinterleave_memcpy(pRef1, pRef2, pSrc1, size * 2);
+    check("deinterleave_memcpy", size * 2, 1, "dest1", pOut1, pRef1, size, 1, 0, size);
+    check("deinterleave_memcpy", size * 2, 1, "dest2", pOut2, pRef2, size, 1, 0, size);
+
+    free(pSrc1);
+    free(pSrc2);
+    free(pOut1);
+    free(pOut2);
+    free(pRef1);
+    free(pRef2);
+}
+
+static void test_tiled(int width, int height)
+{
+    int   uvHeight = height >> 1;
+    int   ySize = width * height;
+    int   uvSize = width * uvHeight;
+    int   yStride = ALIGN(width, 16);
+    int   uvStride = ALIGN(yStride >> 1, 16);
+    int   tiledYSize = TILED_SIZE(width, height);
+    int   tiledCSize = TILED_SIZE(width, uvHeight);
+    char *pTiledY = malloc(tiledYSize);
+    char *pTiledC = malloc(tiledCSize);
+    char *pLinear = malloc(ySize + uvSize);
+    char *pOutTiled = alloc_dest(tiledYSize);
+    char *pRefTiled = alloc_dest(tiledYSize);
+    char *pOut[3], *pRef[3];
+    int   i;
+
+    fill(pTiledY, tiledYSize, width * 31 + height);
+    fill(pTiledC, tiledCSize, width * 17 + height);
+    fill(pLinear, ySize + uvSize, width + height * 13);
+    for (i = 0; i < 3; i++) {
+        pOut[i] = alloc_dest(yStride * height);
+        pRef[i] = alloc_dest(yStride * height);
+    }
+
+    reset_dest(pOut[0], ySize);
+    reset_dest(pRef[0], ySize);
+    csc_tiled_to_linear(pOut[0], pTiledY, width, height);
+    ref_csc_tiled_to_linear(pRef[0], pTiledY, width, height);
+    check("tiled_to_linear", width, height, "y", pOut[0], pRef[0], width, height, width, ySize);
+
+    reset_dest(pOut[0], uvSize);
+    reset_dest(pRef[0], uvSize);
+    csc_tiled_to_linear(pOut[0], pTiledC, width, uvHeight);
+    ref_csc_tiled_to_linear(pRef[0], pTiledC, width, uvHeight);
+    check("tiled_to_linear", width, height, "uv", pOut[0], pRef[0], width, uvHeight, width, uvSize);
+
+    /* the last 4 byte copy of csc_tiled_to_linear() runs into the next line at other widths */
+    if ((width & 0x3) == 0) {
+        reset_dest(pOut[0], ySize);
+        reset_dest(pRef[0], ySize);
+        csc_tiled_to_linear_blocked(pOut[0], pTiledY, width, height);
+        ref_csc_tiled_to_linear(pRef[0], pTiledY, width, height);
+        check("tiled_to_linear_blocked", width, height, "y", pOut[0], pRef[0], width, height, width, ySize);
+
+        reset_dest(pOut[0], uvSize);
+        reset_dest(pRef[0], uvSize);
+        csc_tiled_to_linear_blocked(pOut[0], pTiledC, width, uvHeight);
+        ref_csc_tiled_to_linear(pRef[0], pTiledC, width, uvHeight);
+        check("tiled_to_linear_blocked", width, height, "uv", pOut[0], pRef[0], width, uvHeight, width, uvSize);
+    }
+
+    for (i = 1; i < 3; i++) {
+        reset_dest(pOut[i], uvSize >> 1);
+        reset_dest(pRef[i], uvSize >> 1);
+    }
+    csc_tiled_to_linear_deinterleave(pOut[1], pOut[2], pTiledC, width, uvHeight);
+    ref_csc_tiled_to_linear_deinterleave(pRef[1], pRef[2], pTiledC, width, uvHeight);
+    check("tiled_to_linear_deinterleave", width, height, "u", pOut[1], pRef[1], width >> 1, uvHeight, width >> 1, uvSize >> 1);
+    check("tiled_to_linear_deinterleave", width, height, "v", pOut[2], pRef[2], width >> 1, uvHeight, width >> 1, uvSize >> 1);
+
+    /* the padding of a tiled plane is undefined, the result is read back through the reference */
+    reset_dest(pOutTiled, tiledYSize);
+    reset_dest(pRefTiled, tiledYSize);
+    csc_linear_to_tiled(pOutTiled, pLinear, width, height);
+    ref_csc_linear_to_tiled(pRefTiled, pLinear, width, height);
+    if (!guard_intact(pOutTiled, pRefTiled, tiledYSize)) {
+        printf("FAIL linear_to_tiled %dx%d y writes past the end\n", width, height);
+        gFailures++;
+    }
+    ref_csc_tiled_to_linear(pOut[0], pOutTiled, width, height);
+    ref_csc_tiled_to_linear(pRef[0], pRefTiled, width, height);
+    check("linear_to_tiled", width, height, "y", pOut[0], pRef[0], width, height, width, ySize);
+
+    reset_dest(pOutTiled, tiledCSize);
+    reset_dest(pRefTiled, tiledCSize);
+    csc_linear_to_tiled_interleave(pOutTiled, pLinear, pLinear + (uvSize >> 1), width, uvHeight);
+    ref_csc_linear_to_tiled_interleave(pRefTiled, pLinear, pLinear + (uvSize >> 1), width, uvHeight);
+    if (!guard_intact(pOutTiled, pRefTiled, tiledCSize)) {
+        printf("FAIL linear_to_tiled_interleave %dx%d uv writes past the end\n", width, height);
+        gFailures++;
+    }
+    ref_csc_tiled_to_linear(pOut[0], pOutTiled, width, uvHeight);
+    ref_csc_tiled_to_linear(pRef[0], pRefTiled, width, uvHeight);
+    check("linear_to_tiled_interleave", width, height, "uv", pOut[0], pRef[0], width, uvHeight, width, uvSize);
+
+    reset_dest(pOut[0], ySize);
+    reset_dest(pOut[1], uvSize);
+    reset_dest(pRef[0], ySize);
+    reset_dest(pRef[1], uvSize);
+    csc_tiled_to_nv21(pOut[0], pOut[1], pTiledY, pTiledC, width, height);
+    ref_csc_tiled_to_nv21(pRef[0], pRef[1], pTiledY, pTiledC, width, height);
+    check("tiled_to_nv21", width, height, "y", pOut[0], pRef[0], width, height, width, ySize);
+    check("tiled_to_nv21", width, height, "vu", pOut[1], pRef[1], width, uvHeight, width, uvSize);
+
+    reset_dest(pOut[0], yStride * height);
+    reset_dest(pRef[0], yStride * height);
+    for (i = 1; i < 3; i++) {
+        reset_dest(pOut[i], uvStride * uvHeight);
+        reset_dest(pRef[i], uvStride * uvHeight);
+    }
+    csc_tiled_to_yv12(pOut[0], pOut[1], pOut[2], pTiledY, pTiledC, width, height, yStride, uvStride);
+    ref_csc_tiled_to_yv12(pRef[0], pRef[1], pRef[2], pTiledY, pTiledC, width, height, yStride, uvStride);
+    check("tiled_to_yv12", width, height, "y", pOut[0], pRef[0], width, height, yStride, yStride * height);
+    check("tiled_to_yv12", width, height, "v", pOut[1], pRef[1], width >> 1, uvHeight, uvStride, uvStride * uvHeight);
+    check("tiled_to_yv12", width, height, "u", pOut[2], pRef[2], width >> 1, uvHeight, uvStride, uvStride * uvHeight);
+
+    reset_dest(pOut[0], yStride * height);
+    reset_dest(pRef[0], yStride * height);
+    for (i = 1; i < 3; i++) {
+        reset_dest(pOut[i], uvStride * uvHeight);
+        reset_dest(pRef[i], uvStride * uvHeight);
+    }
+    csc_linear_to_strided(pOut[0], pOut[1], pOut[2], pLinear, width, height, yStride, uvStride);
+    ref_csc_linear_to_strided(pRef[0], pRef[1], pRef[2], pLinear, width, height, yStride, uvStride);
+    check("linear_to_strided", width, height, "y", pOut[0], pRef[0], width, height, yStride, yStride * height);
+    check("linear_to_strided", width, height, "u", pOut[1], pRef[1], width >> 1, uvHeight, uvStride, uvStride * uvHeight);
+    check("linear_to_strided", width, height, "v", pOut[2], pRef[2], width >> 1, uvHeight, uvStride, uvStride * uvHeight);
+
+    free(pTiledY);
+    free(pTiledC);
+    free(pLinear);
+    free(pOutTiled);
+    free(pRefTiled);
+    for (i = 0; i < 3; i++) {
+        free(pOut[i]);
+        free(pRef[i]);
+    }
+}
+
+/* full size, half and quarter, a line of RGB is packed */
+static void test_rgb(int width, int height)
+{
+    int   tiledYSize = TILED_SIZE(width, height);
+    int   tiledCSize = TILED_SIZE(width, height >> 1);
+    char *pTiledY = malloc(tiledYSize);
+    char *pTiledC = malloc(tiledCSize);
+    char *pOut = alloc_dest(width * height * 4);
+    char *pRef = alloc_dest(width * height * 4);
+    int   scale;
+
+    fill(pTiledY, tiledYSize, width * 7 + height);
+    fill(pTiledC, tiledCSize, width + height * 5);
+
+    for (scale = 0; scale <= 2; scale++) {
+        int rgbWidth = width >> scale;
+        int rgbHeight = height >> scale;
+
+        if (rgbWidth == 0 || rgbHeight == 0)
+            break;
+
+        reset_dest(pOut, rgbWidth * 2 * rgbHeight);
+        reset_dest(pRef, rgbWidth * 2 * rgbHeight);
+        csc_tiled_to_rgb565(pOut, pTiledY, pTiledC, width, height, rgbWidth * 2, scale);
+        ref_csc_tiled_to_rgb565(pRef, pTiledY, pTiledC, width, height, rgbWidth * 2, scale);
+        check(kRgbNames[scale][0], width, height, "rgb", pOut, pRef,
+              rgbWidth * 2, rgbHeight, rgbWidth * 2, rgbWidth * 2 * rgbHeight);
+
+        reset_dest(pOut, rgbWidth * 4 * rgbHeight);
+        reset_dest(pRef, rgbWidth * 4 * rgbHeight);
+        csc_tiled_to_rgba8888(pOut, pTiledY, pTiledC, width, height, rgbWidth * 4, scale);
+        ref_csc_tiled_to_rgba8888(pRef, pTiledY, pTiledC, width, height, rgbWidth * 4, scale);
+        check(kRgbNames[scale][1], width, height, "rgba", pOut, pRef,
+              rgbWidth * 4, rgbHeight, rgbWidth * 4, rgbWidth * 4 * rgbHeight);
+    }
+
+    free(pTiledY);
+    free(pTiledC);
+    free(pOut);
+    free(pRef);
+}
+
+typedef enum {
+    BENCH_TILED_TO_LINEAR,
+    BENCH_TILED_TO_LINEAR_BLOCKED,
+    BENCH_TILED_TO_LINEAR_DEINTERLEAVE,
+    BENCH_LINEAR_TO_TILED,
+    BENCH_LINEAR_TO_TILED_INTERLEAVE,
+    BENCH_TILED_TO_NV21,
+    BENCH_TILED_TO_YV12,
+    BENCH_TILED_TO_RGB565,
+    BENCH_TILED_TO_RGBA8888,
+    BENCH_TILED_TO_RGB565_QUARTER,
+    BENCH_NUM
+} BENCH_KERNEL;
+
+static const char *kBenchNames[BENCH_NUM] = {
+    "tiled_to_linear",
+    "tiled_to_linear_blocked",
+    "tiled_to_linear_deinterleave",
+    "linear_to_tiled",
+    "linear_to_tiled_interleave",
+    "tiled_to_nv21",
+    "tiled_to_yv12",
+    "tiled_to_rgb565",
+    "tiled_to_rgba8888",
+    "tiled_to_rgb565_quarter",
+};
+
+/* one frame of the kernel, a Y plane and a UV plane where the kernel has both */
+static int bench_run(BENCH_KERNEL kernel, int width, int height,
+                     char *pTiledY, char *pTiledC, char *pLinear)
+{
+    int uvHeight = height >> 1;
+    int yStride = ALIGN(width, 16);
+    int uvStride = ALIGN(yStride >> 1, 16);
+
+    switch (kernel) {
+    case BENCH_TILED_TO_LINEAR:
+        csc_tiled_to_linear(pLinear, pTiledY, width, height);
+        csc_tiled_to_linear(pLinear + width * height, pTiledC, width, uvHeight);
+        return width * height * 3 / 2;
+    case BENCH_TILED_TO_LINEAR_BLOCKED:
+        csc_tiled_to_linear_blocked(pLinear, pTiledY, width, height);
+        csc_tiled_to_linear_blocked(pLinear + width * height, pTiledC, width, uvHeight);
+        return width * height * 3 / 2;
+    case BENCH_TILED_TO_LINEAR_DEINTERLEAVE:
+        csc_tiled_to_linear_deinterleave(pLinear, pLinear + width * uvHeight / 2, pTiledC, width, uvHeight);
+        return width * uvHeight;
+    case BENCH_LINEAR_TO_TILED:
+        csc_linear_to_tiled(pTiledY, pLinear, width, height);
+        return width * height;
+    case BENCH_LINEAR_TO_TILED_INTERLEAVE:
+        csc_linear_to_tiled_interleave(pTiledC, pLinear, pLinear + width * uvHeight / 2, width, uvHeight);
+        return width * uvHeight;
+    case BENCH_TILED_TO_NV21:
+        csc_tiled_to_nv21(pLinear, pLinear + width * height, pTiledY, pTiledC, width, height);
+        return width * height * 3 / 2;
+    case BENCH_TILED_TO_YV12:
+        csc_tiled_to_yv12(pLinear, pLinear + yStride * height, pLinear + yStride * height + uvStride * uvHeight,
+                          pTiledY, pTiledC, width, height, yStride, uvStride);
+        return width * height * 3 / 2;
+    case BENCH_TILED_TO_RGB565:
+        csc_tiled_to_rgb565(pLinear, pTiledY, pTiledC, width, height, width * 2, 0);
+        return width * height * 3 / 2;
+    case BENCH_TILED_TO_RGBA8888:
+        csc_tiled_to_rgba8888(pLinear, pTiledY, pTiledC, width, height, width * 4, 0);
+        return width * height * 3 / 2;
+    case BENCH_TILED_TO_RGB565_QUARTER:
+        csc_tiled_to_rgb565(pLinear, pTiledY, pTiledC, width, height, (width >> 2) * 2, 2);
+        return width * height * 3 / 2;
+    default:
+        return 0;
+    }
+}
+
+static void bench(int width, int height, int runs, double mhz)
+{
+    char    config[64];
+    int     dstSize = ALIGN(width, 16) * height * 4;
+    char   *pTiledY = malloc(TILED_SIZE(width, height));
+    char   *pTiledC = malloc(TILED_SIZE(width, height >> 1));
+    char   *pLinear = malloc(dstSize);
+    int     kernel, i, bytes = 0;
+    double  start, us;
+
+    fill(pTiledY, TILED_SIZE(width, height), 1);
+    fill(pTiledC, TILED_SIZE(width, height >> 1), 2);
+    fill(pLinear, dstSize, 3);
+
+    for (kernel = 0; kernel < BENCH_NUM; kernel++) {
+        /* a warm up run, then the caches see what a frame of video leaves them */
+        bench_run(kernel, width, height, pTiledY, pTiledC, pLinear);
+
+        start = now_us();
+        for (i = 0; i < runs; i++)
+            bytes = bench_run(kernel, width, height, pTiledY, pTiledC, pLinear);
+        us = (now_us() - start) / runs;
+
+        snprintf(config, sizeof(config), "%s_%dx%d", kBenchNames[kernel], width, height);
+        RESULT(config, "time", us, "us");
+        RESULT(config, "throughput", bytes / us, "MB/s");
+        if (mhz > 0)
+            RESULT(config, "cycles_per_pixel", (us * mhz) / bytes, "cycles");
+    }
+
+    free(pTiledY);
+    free(pTiledC);
+    free(pLinear);
+}
+
+int main(int argc, char **argv)
+{
+    int    bTest = 1;
+    int    bBench = 1;
+    int    runs = 20;
+    int    opt;
+    int    i, j;
+    double mhz;
+
+    while ((opt = getopt(argc, argv, "tbn:")) != -1) {
+        switch (opt) {
+        case 't':
+            bBench = 0;
+            break;
+        case 'b':
+            bTest = 0;
+            break;
+        case 'n':
+            runs = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-t] [-b] [-n runs]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (runs <= 0)
+        runs = 1;
+
+    if (bTest) {
+        for (i = 0; i < (int)(sizeof(kWidths) / sizeof(kWidths[0])); i++) {
+            test_memcpy(kWidths[i]);
+            test_memcpy(kWidths[i] + 1);
+            for (j = 0; j < (int)(sizeof(kHeights) / sizeof(kHeights[0])); j++) {
+                test_tiled(kWidths[i], kHeights[j]);
+                test_rgb(kWidths[i], kHeights[j]);
+            }
+        }
+        RESULT("test", "failures", gFailures, "count");
+    }
+
+    if (bBench) {
+        mhz = cpu_mhz();
+        if (mhz > 0)
+            RESULT("bench", "cpu_clock", mhz, "MHz");
+        for (i = 0; i < (int)(sizeof(kBenchSizes) / sizeof(kBenchSizes[0])); i++)
+            bench(kBenchSizes[i].width, kBenchSizes[i].height, runs, mhz);
+    }
+
+    return (gFailures > 255) ? 255 : gFailures;
+}
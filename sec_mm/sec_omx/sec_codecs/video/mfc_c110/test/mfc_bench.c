@@ -0,0 +1,664 @@
+/*
+ *
+ * Copyright 2010 Samsung Electronics S.LSI Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Drives the MFC decode and encode APIs directly, without the OMX layer,
+ * so that driver and library changes can be measured on their own.
+ *
+ * usage: mfc-bench -d h264|mpeg4 [-c] [-o out.yuv] [-n frames] stream
+ *        mfc-bench -e h264|mpeg4 -s WxH [-t] [-r fps] [-b bps] [-o out] [-n frames] in.yuv
+ *
+ *   -d  decode an elementary stream, Annex B H.264 or MPEG-4 part 2
+ *   -e  encode a raw I420 file
+ *   -c  decode: converts every picture from NV12T to I420 on the CPU
+ *   -t  encode: feeds NV12T made on the CPU instead of linear NV12
+ *
+ * results go to stdout as "RESULT <config> <metric> <value> <unit>" lines.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include <sec_bench.h>
+
+#include "SsbSipMfcApi.h"
+#include "color_space_convertor.h"
+
+#define ALIGN(x, a)     (((x) + (a) - 1) & ~((a) - 1))
+
+typedef struct {
+    int offset;
+    int size;
+} FRAME;
+
+typedef struct {
+    double *pUs;
+    int     num;
+} LATENCY;
+
+static double now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000.0 + ts.tv_nsec / 1000.0;
+}
+
+static double cpu_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1000000.0 + ts.tv_nsec / 1000.0;
+}
+
+static long max_rss_kb(void)
+{
+    struct rusage usage;
+
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+static int compare_double(const void *a, const void *b)
+{
+    double da = *(const double *)a;
+    double db = *(const double *)b;
+
+    return (da > db) - (da < db);
+}
+
+static void report_latency(const char *config, const char *stage, LATENCY *pLatency)
+{
+    char   metric[64];
+    double total = 0;
+    int    i;
+
+    if (pLatency->num == 0)
+        return;
+
+    for (i = 0; i < pLatency->num; i++)
+        total += pLatency->pUs[i];
+    qsort(pLatency->pUs, pLatency->num, sizeof(double), compare_double);
+
+    snprintf(metric, sizeof(metric), "%s_avg", stage);
+    RESULT(config, metric, total / pLatency->num, "us");
+    snprintf(metric, sizeof(metric), "%s_p50", stage);
+    RESULT(config, metric, pLatency->pUs[pLatency->num / 2], "us");
+    snprintf(metric, sizeof(metric), "%s_p95", stage);
+    RESULT(config, metric, pLatency->pUs[(pLatency->num * 95) / 100], "us");
+    snprintf(metric, sizeof(metric), "%s_max", stage);
+    RESULT(config, metric, pLatency->pUs[pLatency->num - 1], "us");
+}
+
+static unsigned char *read_file(const char *path, int *pSize)
+{
+    FILE          *fp = fopen(path, "rb");
+    unsigned char *pData = NULL;
+    long           size;
+
+    if (fp == NULL) {
+        fprintf(stderr, "can't open %s\n", path);
+        return NULL;
+    }
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    pData = (unsigned char *)malloc(size + 4);
+    if ((pData == NULL) || (fread(pData, 1, size, fp) != (size_t)size)) {
+        fprintf(stderr, "can't read %s\n", path);
+        free(pData);
+        pData = NULL;
+    } else {
+        /* no start code runs off the end */
+        memset(pData + size, 0xFF, 4);
+        *pSize = (int)size;
+    }
+    fclose(fp);
+
+    return pData;
+}
+
+static int find_start_code(unsigned char *pStream, int offset, int size)
+{
+    int i;
+
+    for (i = offset; i + 3 <= size; i++) {
+        if ((pStream[i] == 0x00) && (pStream[i + 1] == 0x00) && (pStream[i + 2] == 0x01))
+            return i;
+    }
+
+    return -1;
+}
+
+/*
+ * 1 for a unit that starts a picture, 2 for one that continues it,
+ * 0 for the headers that go in front of the next picture.
+ */
+static int unit_type(SSBSIP_MFC_CODEC_TYPE codecType, unsigned char *pUnit)
+{
+    if (codecType == H264_DEC) {
+        int nalType = pUnit[3] & 0x1F;
+
+        if ((nalType != 1) && (nalType != 5))
+            return 0;
+        /* first_mb_in_slice is ue(v), 0 codes as a single 1 bit */
+        return (pUnit[4] & 0x80) ? 1 : 2;
+    }
+
+    /* MPEG-4 part 2: a VOP start code */
+    return (pUnit[3] == 0xB6) ? 1 : 0;
+}
+
+/*
+ * Splits the stream into the header that goes to SsbSipMfcDecInit and one
+ * chunk per picture after it. Multi slice H.264 pictures stay together.
+ */
+static int split_frames(SSBSIP_MFC_CODEC_TYPE codecType, unsigned char *pStream, int size, FRAME **ppFrames)
+{
+    FRAME *pFrames = NULL;
+    int    maxFrames = 1024;
+    int    numFrames = 0;
+    int    frameStart = 0;
+    int    inPicture = 0;
+    int    offset = 0;
+
+    pFrames = (FRAME *)malloc(maxFrames * sizeof(FRAME));
+    if (pFrames == NULL)
+        return -1;
+
+    offset = find_start_code(pStream, 0, size);
+    while (offset >= 0) {
+        int type = unit_type(codecType, pStream + offset);
+
+        /* a header after a picture, or a new picture, ends the chunk */
+        if ((numFrames == 0 && type == 1 && offset > frameStart) ||
+            (inPicture && (type != 2))) {
+            if (numFrames == maxFrames) {
+                maxFrames *= 2;
+                pFrames = (FRAME *)realloc(pFrames, maxFrames * sizeof(FRAME));
+                if (pFrames == NULL)
+                    return -1;
+            }
+            pFrames[numFrames].offset = frameStart;
+            pFrames[numFrames].size = offset - frameStart;
+            numFrames++;
+            frameStart = offset;
+        }
+        if (type != 0)
+            inPicture = 1;
+        else if (inPicture)
+            inPicture = 0;
+
+        offset = find_start_code(pStream, offset + 3, size);
+    }
+    if (size > frameStart) {
+        pFrames = (FRAME *)realloc(pFrames, (numFrames + 1) * sizeof(FRAME));
+        if (pFrames == NULL)
+            return -1;
+        pFrames[numFrames].offset = frameStart;
+        pFrames[numFrames].size = size - frameStart;
+        numFrames++;
+    }
+
+    *ppFrames = pFrames;
+    return numFrames;
+}
+
+static int decode(SSBSIP_MFC_CODEC_TYPE codecType, const char *config, const char *inPath,
+                  const char *outPath, int maxFrames, int bConvert)
+{
+    SSBIP_MFC_BUFFER_TYPE      buf_type = CACHE;
+    SSBSIP_MFC_DEC_OUTPUT_INFO outputInfo;
+    SSBSIP_MFC_IMG_RESOLUTION  imgResol;
+    LATENCY        decLatency = { NULL, 0 };
+    LATENCY        cscLatency = { NULL, 0 };
+    unsigned char *pStream = NULL;
+    unsigned char *pYuv = NULL;
+    FRAME         *pFrames = NULL;
+    FILE          *fpOut = NULL;
+    void          *hMFCHandle = NULL;
+    void          *pStrmBuf = NULL;
+    void          *pStrmPhyBuf = NULL;
+    double         startUs, startCpuUs, openUs, t;
+    int            streamSize = 0;
+    int            numFrames = 0;
+    int            strmBufSize = 0;
+    int            displayed = 0;
+    int            ret = 1;
+    int            i;
+
+    pStream = read_file(inPath, &streamSize);
+    if (pStream == NULL)
+        goto EXIT;
+    numFrames = split_frames(codecType, pStream, streamSize, &pFrames);
+    if (numFrames < 2) {
+        fprintf(stderr, "no pictures found in %s\n", inPath);
+        goto EXIT;
+    }
+    if ((maxFrames > 0) && (numFrames > maxFrames + 1))
+        numFrames = maxFrames + 1;
+
+    strmBufSize = 0;
+    for (i = 0; i < numFrames; i++) {
+        if (pFrames[i].size > strmBufSize)
+            strmBufSize = pFrames[i].size;
+    }
+    strmBufSize = ALIGN(strmBufSize, 4096);
+    if (strmBufSize > MAX_DECODER_INPUT_BUFFER_SIZE) {
+        fprintf(stderr, "a frame of %d bytes does not fit the stream buffer\n", strmBufSize);
+        goto EXIT;
+    }
+
+    decLatency.pUs = (double *)malloc(numFrames * sizeof(double));
+    cscLatency.pUs = (double *)malloc(numFrames * sizeof(double));
+    if ((decLatency.pUs == NULL) || (cscLatency.pUs == NULL))
+        goto EXIT;
+
+    t = now_us();
+    hMFCHandle = SsbSipMfcDecOpen(&buf_type);
+    if (hMFCHandle == NULL) {
+        fprintf(stderr, "SsbSipMfcDecOpen failed\n");
+        goto EXIT;
+    }
+    pStrmBuf = SsbSipMfcDecGetInBuf(hMFCHandle, &pStrmPhyBuf, strmBufSize);
+    if (pStrmBuf == NULL) {
+        fprintf(stderr, "SsbSipMfcDecGetInBuf failed\n");
+        goto EXIT;
+    }
+
+    memcpy(pStrmBuf, pStream + pFrames[0].offset, pFrames[0].size);
+    SsbSipMfcDecSetInBuf(hMFCHandle, pStrmPhyBuf, pStrmBuf, strmBufSize);
+    if (SsbSipMfcDecInit(hMFCHandle, codecType, pFrames[0].size) != MFC_RET_OK) {
+        fprintf(stderr, "SsbSipMfcDecInit failed\n");
+        goto EXIT;
+    }
+    openUs = now_us() - t;
+    SsbSipMfcDecGetConfig(hMFCHandle, MFC_DEC_GETCONF_BUF_WIDTH_HEIGHT, &imgResol);
+
+    if (bConvert) {
+        pYuv = (unsigned char *)malloc((imgResol.buf_width * imgResol.buf_height * 3) / 2);
+        if (pYuv == NULL)
+            goto EXIT;
+    }
+    if (outPath != NULL) {
+        fpOut = fopen(outPath, "wb");
+        if (fpOut == NULL) {
+            fprintf(stderr, "can't open %s\n", outPath);
+            goto EXIT;
+        }
+    }
+
+    startUs = now_us();
+    startCpuUs = cpu_us();
+    for (i = 1; i < numFrames; i++) {
+        SSBSIP_MFC_DEC_FRAME  frame;
+        SSBSIP_MFC_ERROR_CODE returnCodec;
+
+        memcpy(pStrmBuf, pStream + pFrames[i].offset, pFrames[i].size);
+        frame.phyInBuf = pStrmPhyBuf;
+        frame.virInBuf = pStrmBuf;
+        frame.inputBufferSize = strmBufSize;
+        frame.lengthBufFill = pFrames[i].size;
+        frame.in_frametag = i;
+
+        t = now_us();
+        returnCodec = SsbSipMfcDecExeFrame(hMFCHandle, &frame);
+        decLatency.pUs[decLatency.num++] = now_us() - t;
+        if (returnCodec != MFC_RET_OK) {
+            fprintf(stderr, "SsbSipMfcDecExeFrame failed on frame %d (%d)\n", i, returnCodec);
+            continue;
+        }
+
+        if ((frame.status != MFC_GETOUTBUF_DISPLAY_DECODING) && (frame.status != MFC_GETOUTBUF_DISPLAY_ONLY))
+            continue;
+        outputInfo = frame.output;
+        displayed++;
+
+        if (pYuv != NULL) {
+            int ySize = outputInfo.buf_width * outputInfo.buf_height;
+
+            t = now_us();
+            csc_tiled_to_linear((char *)pYuv, (char *)outputInfo.YVirAddr,
+                                outputInfo.buf_width, outputInfo.buf_height);
+            csc_tiled_to_linear_deinterleave((char *)pYuv + ySize, (char *)pYuv + ySize + (ySize / 4),
+                                             (char *)outputInfo.CVirAddr,
+                                             outputInfo.buf_width, outputInfo.buf_height / 2);
+            cscLatency.pUs[cscLatency.num++] = now_us() - t;
+
+            if (fpOut != NULL)
+                fwrite(pYuv, 1, (ySize * 3) / 2, fpOut);
+        }
+    }
+
+    t = now_us() - startUs;
+    RESULT(config, "width", imgResol.width, "px");
+    RESULT(config, "height", imgResol.height, "px");
+    RESULT(config, "frames", decLatency.num, "count");
+    RESULT(config, "displayed", displayed, "count");
+    RESULT(config, "open_init", openUs, "us");
+    RESULT(config, "fps", decLatency.num * 1000000.0 / t, "fps");
+    RESULT(config, "cpu", (cpu_us() - startCpuUs) * 100.0 / t, "%");
+    RESULT(config, "stream_buffer", strmBufSize / 1024, "KB");
+    RESULT(config, "max_rss", max_rss_kb(), "KB");
+    report_latency(config, "decode", &decLatency);
+    report_latency(config, "csc", &cscLatency);
+    ret = 0;
+
+EXIT:
+    if (fpOut != NULL)
+        fclose(fpOut);
+    if (hMFCHandle != NULL)
+        SsbSipMfcDecClose(hMFCHandle);
+    free(decLatency.pUs);
+    free(cscLatency.pUs);
+    free(pYuv);
+    free(pFrames);
+    free(pStream);
+
+    return ret;
+}
+
+static void set_enc_param(SSBSIP_MFC_CODEC_TYPE codecType, void *pParam, int width, int height,
+                          int frameRate, int bitrate, int bTiled)
+{
+    if (codecType == H264_ENC) {
+        SSBSIP_MFC_ENC_H264_PARAM *pH264Arg = (SSBSIP_MFC_ENC_H264_PARAM *)pParam;
+
+        /* what the OMX H.264 encoder sets up for a Baseline stream */
+        memset(pH264Arg, 0, sizeof(SSBSIP_MFC_ENC_H264_PARAM));
+        pH264Arg->codecType    = H264_ENC;
+        pH264Arg->SourceWidth  = width;
+        pH264Arg->SourceHeight = height;
+        pH264Arg->IDRPeriod    = frameRate;
+        pH264Arg->EnableFRMRateControl = 1;
+        pH264Arg->Bitrate      = bitrate;
+        pH264Arg->FrameQp      = 20;
+        pH264Arg->FrameQp_P    = 20;
+        pH264Arg->QSCodeMax    = 30;
+        pH264Arg->QSCodeMin    = 10;
+        pH264Arg->CBRPeriodRf  = 100;
+        pH264Arg->FrameMap     = bTiled ? NV12_TILE : NV12_LINEAR;
+        pH264Arg->ProfileIDC   = 66;
+        pH264Arg->LevelIDC     = 40;
+        pH264Arg->FrameQp_B    = 20;
+        pH264Arg->FrameRate    = frameRate;
+        pH264Arg->NumberReferenceFrames = 1;
+        pH264Arg->NumberRefForPframes   = 1;
+        pH264Arg->LoopFilterDisable     = 1;
+        pH264Arg->DarkDisable     = 1;
+        pH264Arg->SmoothDisable   = 1;
+        pH264Arg->StaticDisable   = 1;
+        pH264Arg->ActivityDisable = 1;
+    } else {
+        SSBSIP_MFC_ENC_MPEG4_PARAM *pMpeg4Arg = (SSBSIP_MFC_ENC_MPEG4_PARAM *)pParam;
+
+        /* what the OMX MPEG-4 encoder sets up for a Simple profile stream */
+        memset(pMpeg4Arg, 0, sizeof(SSBSIP_MFC_ENC_MPEG4_PARAM));
+        pMpeg4Arg->codecType    = MPEG4_ENC;
+        pMpeg4Arg->SourceWidth  = width;
+        pMpeg4Arg->SourceHeight = height;
+        pMpeg4Arg->IDRPeriod    = frameRate;
+        pMpeg4Arg->EnableFRMRateControl = 1;
+        pMpeg4Arg->Bitrate      = bitrate;
+        pMpeg4Arg->FrameQp      = 5;
+        pMpeg4Arg->FrameQp_P    = 5;
+        pMpeg4Arg->QSCodeMax    = 30;
+        pMpeg4Arg->QSCodeMin    = 10;
+        pMpeg4Arg->CBRPeriodRf  = 10;
+        pMpeg4Arg->FrameMap     = bTiled ? NV12_TILE : NV12_LINEAR;
+        pMpeg4Arg->ProfileIDC   = 0;
+        pMpeg4Arg->LevelIDC     = 3;
+        pMpeg4Arg->FrameQp_B    = 5;
+        pMpeg4Arg->TimeIncreamentRes = frameRate;
+        pMpeg4Arg->VopTimeIncreament = 1;
+        pMpeg4Arg->DisableQpelME = 1;
+    }
+}
+
+static int encode(SSBSIP_MFC_CODEC_TYPE codecType, const char *config, const char *inPath,
+                  const char *outPath, int maxFrames, int width, int height,
+                  int frameRate, int bitrate, int bTiled)
+{
+    SSBIP_MFC_BUFFER_TYPE      buf_type = CACHE;
+    SSBSIP_MFC_ENC_INPUT_INFO  inputInfo;
+    SSBSIP_MFC_ENC_OUTPUT_INFO outputInfo;
+    union {
+        SSBSIP_MFC_ENC_H264_PARAM  h264;
+        SSBSIP_MFC_ENC_MPEG4_PARAM mpeg4;
+    } param;
+    LATENCY        encLatency = { NULL, 0 };
+    LATENCY        cscLatency = { NULL, 0 };
+    unsigned char *pYuv = NULL;
+    FILE          *fpIn = NULL;
+    FILE          *fpOut = NULL;
+    void          *hMFCHandle = NULL;
+    double         startUs, startCpuUs, openUs, t;
+    double         streamBytes = 0;
+    int            ySize = width * height;
+    int            frameSize = (ySize * 3) / 2;
+    int            numFrames = 0;
+    int            ret = 1;
+
+    fpIn = fopen(inPath, "rb");
+    if (fpIn == NULL) {
+        fprintf(stderr, "can't open %s\n", inPath);
+        goto EXIT;
+    }
+    fseek(fpIn, 0, SEEK_END);
+    numFrames = ftell(fpIn) / frameSize;
+    fseek(fpIn, 0, SEEK_SET);
+    if (numFrames == 0) {
+        fprintf(stderr, "%s holds no %dx%d frame\n", inPath, width, height);
+        goto EXIT;
+    }
+    if ((maxFrames > 0) && (numFrames > maxFrames))
+        numFrames = maxFrames;
+
+    /* the whole clip is read up front, the file system stays out of the timing */
+    pYuv = (unsigned char *)malloc((size_t)frameSize * numFrames);
+    encLatency.pUs = (double *)malloc(numFrames * sizeof(double));
+    cscLatency.pUs = (double *)malloc(numFrames * sizeof(double));
+    if ((pYuv == NULL) || (encLatency.pUs == NULL) || (cscLatency.pUs == NULL)) {
+        fprintf(stderr, "out of memory\n");
+        goto EXIT;
+    }
+    if (fread(pYuv, frameSize, numFrames, fpIn) != (size_t)numFrames) {
+        fprintf(stderr, "can't read %s\n", inPath);
+        goto EXIT;
+    }
+
+    if (outPath != NULL) {
+        fpOut = fopen(outPath, "wb");
+        if (fpOut == NULL) {
+            fprintf(stderr, "can't open %s\n", outPath);
+            goto EXIT;
+        }
+    }
+
+    t = now_us();
+    hMFCHandle = SsbSipMfcEncOpen(&buf_type);
+    if (hMFCHandle == NULL) {
+        fprintf(stderr, "SsbSipMfcEncOpen failed\n");
+        goto EXIT;
+    }
+    SsbSipMfcEncSetSize(hMFCHandle, codecType, width, height);
+    if (SsbSipMfcEncGetInBuf(hMFCHandle, &inputInfo) != MFC_RET_OK) {
+        fprintf(stderr, "SsbSipMfcEncGetInBuf failed\n");
+        goto EXIT;
+    }
+    set_enc_param(codecType, &param, width, height, frameRate, bitrate, bTiled);
+    if (SsbSipMfcEncInit(hMFCHandle, &param) != MFC_RET_OK) {
+        fprintf(stderr, "SsbSipMfcEncInit failed\n");
+        goto EXIT;
+    }
+    openUs = now_us() - t;
+
+    /* the stream header comes out of the init */
+    if (SsbSipMfcEncGetOutBuf(hMFCHandle, &outputInfo) == MFC_RET_OK) {
+        streamBytes += outputInfo.headerSize;
+        if (fpOut != NULL)
+            fwrite(outputInfo.StrmVirAddr, 1, outputInfo.headerSize, fpOut);
+    }
+
+    startUs = now_us();
+    startCpuUs = cpu_us();
+    for (encLatency.num = 0; encLatency.num < numFrames;) {
+        unsigned char *pFrame = pYuv + (size_t)frameSize * encLatency.num;
+        SSBSIP_MFC_ERROR_CODE returnCodec;
+
+        t = now_us();
+        if (bTiled) {
+            csc_linear_to_tiled((char *)inputInfo.YVirAddr, (char *)pFrame, width, height);
+            csc_linear_to_tiled_interleave((char *)inputInfo.CVirAddr,
+                                           (char *)pFrame + ySize, (char *)pFrame + ySize + (ySize / 4),
+                                           width, height / 2);
+        } else {
+            memcpy(inputInfo.YVirAddr, pFrame, ySize);
+            csc_interleave_memcpy((char *)inputInfo.CVirAddr,
+                                  (char *)pFrame + ySize, (char *)pFrame + ySize + (ySize / 4),
+                                  ySize / 4);
+        }
+        cscLatency.pUs[cscLatency.num++] = now_us() - t;
+
+        SsbSipMfcEncSetInBuf(hMFCHandle, &inputInfo);
+        t = now_us();
+        returnCodec = SsbSipMfcEncExe(hMFCHandle);
+        encLatency.pUs[encLatency.num++] = now_us() - t;
+        if (returnCodec != MFC_RET_OK) {
+            fprintf(stderr, "SsbSipMfcEncExe failed on frame %d (%d)\n", encLatency.num, returnCodec);
+            goto EXIT;
+        }
+
+        if (SsbSipMfcEncGetOutBuf(hMFCHandle, &outputInfo) != MFC_RET_OK)
+            continue;
+        streamBytes += outputInfo.dataSize;
+        if (fpOut != NULL)
+            fwrite(outputInfo.StrmVirAddr, 1, outputInfo.dataSize, fpOut);
+    }
+
+    t = now_us() - startUs;
+    RESULT(config, "frames", encLatency.num, "count");
+    RESULT(config, "open_init", openUs, "us");
+    RESULT(config, "fps", encLatency.num * 1000000.0 / t, "fps");
+    RESULT(config, "cpu", (cpu_us() - startCpuUs) * 100.0 / t, "%");
+    RESULT(config, "bitrate", streamBytes * 8 * frameRate / encLatency.num / 1000, "kbps");
+    RESULT(config, "input_buffer", (inputInfo.YSize + inputInfo.CSize) / 1024, "KB");
+    RESULT(config, "max_rss", max_rss_kb(), "KB");
+    report_latency(config, "encode", &encLatency);
+    report_latency(config, "csc", &cscLatency);
+    ret = 0;
+
+EXIT:
+    if (hMFCHandle != NULL)
+        SsbSipMfcEncClose(hMFCHandle);
+    if (fpOut != NULL)
+        fclose(fpOut);
+    if (fpIn != NULL)
+        fclose(fpIn);
+    free(encLatency.pUs);
+    free(cscLatency.pUs);
+    free(pYuv);
+
+    return ret;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+            "usage: %s -d h264|mpeg4 [-c] [-o out.yuv] [-n frames] stream\n"
+            "       %s -e h264|mpeg4 -s WxH [-t] [-r fps] [-b bps] [-o out] [-n frames] in.yuv\n",
+            name, name);
+}
+
+int main(int argc, char **argv)
+{
+    const char *codec = NULL;
+    const char *outPath = NULL;
+    char        config[64];
+    int         bEncode = 0;
+    int         bConvert = 0;
+    int         bTiled = 0;
+    int         maxFrames = 0;
+    int         width = 0;
+    int         height = 0;
+    int         frameRate = 30;
+    int         bitrate = 2000000;
+    int         opt;
+
+    while ((opt = getopt(argc, argv, "d:e:co:n:s:tr:b:")) != -1) {
+        switch (opt) {
+        case 'd':
+            codec = optarg;
+            bEncode = 0;
+            break;
+        case 'e':
+            codec = optarg;
+            bEncode = 1;
+            break;
+        case 'c':
+            bConvert = 1;
+            break;
+        case 'o':
+            outPath = optarg;
+            break;
+        case 'n':
+            maxFrames = atoi(optarg);
+            break;
+        case 's':
+            if (sscanf(optarg, "%dx%d", &width, &height) != 2)
+                width = height = 0;
+            break;
+        case 't':
+            bTiled = 1;
+            break;
+        case 'r':
+            frameRate = atoi(optarg);
+            break;
+        case 'b':
+            bitrate = atoi(optarg);
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if ((codec == NULL) || (optind != argc - 1) ||
+        (strcmp(codec, "h264") && strcmp(codec, "mpeg4"))) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (bEncode == 0) {
+        snprintf(config, sizeof(config), "dec_%s%s", codec, bConvert ? "_csc" : "");
+        return decode(strcmp(codec, "h264") ? MPEG4_DEC : H264_DEC, config, argv[optind],
+                      outPath, maxFrames, bConvert);
+    }
+
+    if ((width <= 0) || (height <= 0) || (width & 15) || (height & 15) || (frameRate <= 0)) {
+        fprintf(stderr, "the encoder needs -s with a multiple of 16 in each dimension\n");
+        return 1;
+    }
+    snprintf(config, sizeof(config), "enc_%s_%dx%d%s", codec, width, height, bTiled ? "_tiled" : "");
+    return encode(strcmp(codec, "h264") ? MPEG4_ENC : H264_ENC, config, argv[optind],
+                  outPath, maxFrames, width, height, frameRate, bitrate, bTiled);
+}
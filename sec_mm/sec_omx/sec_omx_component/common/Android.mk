@@ -6,19 +6,23 @@ LOCAL_MODULE_TAGS := optional
 LOCAL_SRC_FILES := \
 	SEC_OMX_Basecomponent.c \
 	SEC_OMX_Baseport.c \
-	SEC_OMX_Resourcemanager.c
+	SEC_OMX_Resourcemanager.c \
+	SEC_OMX_Trace.c \
+	SEC_OMX_Timestamp.c
 
 
 LOCAL_MODULE := libsecbasecomponent.aries
 
 LOCAL_CFLAGS :=
+LOCAL_CFLAGS += $(SEC_OMX_LOG_CFLAGS)
 
 LOCAL_STATIC_LIBRARIES := libsecosal.aries
 LOCAL_SHARED_LIBRARIES := libcutils libutils
 
 LOCAL_C_INCLUDES := $(SEC_OMX_INC)/khronos \
 	$(SEC_OMX_INC)/sec \
-	$(SEC_OMX_TOP)/sec_osal
+	$(SEC_OMX_TOP)/sec_osal \
+	$(SEC_OMX_TOP)/../../include
 
 include $(BUILD_STATIC_LIBRARY)
 
@@ -31,6 +31,7 @@
 
 #include "SEC_OSAL_Event.h"
 #include "SEC_OSAL_Thread.h"
+#include "SEC_OSAL_ETC.h"
 #include "SEC_OMX_Baseport.h"
 #include "SEC_OMX_Basecomponent.h"
 #include "SEC_OMX_Macros.h"
@@ -295,10 +296,10 @@ OMX_ERRORTYPE SEC_OMX_ComponentStateSet(OMX_COMPONENTTYPE *pOMXComponent, OMX_U3
             for (i = 0; i < (pSECComponent->portParam.nPorts); i++) {
                 pSECPort = (pSECComponent->pSECPort + i);
                 if (CHECK_PORT_TUNNELED(pSECPort) && CHECK_PORT_BUFFER_SUPPLIER(pSECPort)) {
-                    while (SEC_OSAL_GetElemNum(&pSECPort->bufferQ) > 0) {
-                        message = (SEC_OMX_MESSAGE*)SEC_OSAL_Dequeue(&pSECPort->bufferQ);
+                    while (SEC_OSAL_RingGetElemNum(&pSECPort->bufferQ) > 0) {
+                        message = (SEC_OMX_MESSAGE*)SEC_OSAL_RingGet(&pSECPort->bufferQ);
                         if (message != NULL)
-                            SEC_OSAL_Free(message);
+                            SEC_OSAL_PoolFree(&pSECComponent->messagePool, message);
                     }
                     ret = pSECComponent->sec_FreeTunnelBuffer(pSECComponent, i);
                     if (OMX_ErrorNone != ret) {
@@ -361,9 +362,9 @@ OMX_ERRORTYPE SEC_OMX_ComponentStateSet(OMX_COMPONENTTYPE *pOMXComponent, OMX_U3
             for (i = 0; i < ALL_PORT_NUM; i++) {
                 SEC_OSAL_MutexCreate(&pSECComponent->secDataBuffer[i].bufferMutex);
             }
-            ret = SEC_OSAL_ThreadCreate(&pSECComponent->hBufferProcess,
+            ret = SEC_OSAL_ThreadCreateRole(&pSECComponent->hBufferProcess,
                              SEC_OMX_BufferProcessThread,
-                             pOMXComponent);
+                             pOMXComponent, SEC_OSAL_THREAD_ROLE_VIDEO);
             if (ret != OMX_ErrorNone) {
                 /*
                  * if (CHECK_PORT_TUNNELED == OMX_TRUE) thenTunnel Buffer Free
@@ -386,7 +387,15 @@ OMX_ERRORTYPE SEC_OMX_ComponentStateSet(OMX_COMPONENTTYPE *pOMXComponent, OMX_U3
             break;
         case OMX_StateExecuting:
         case OMX_StatePause:
-            SEC_OMX_BufferFlushProcessNoEvent(pOMXComponent, ALL_PORT_INDEX);
+            /* a flush(all) right before the state change already returned everything */
+            for (i = 0; i < ALL_PORT_NUM; i++) {
+                if (pSECComponent->pSECPort[i].bFlushClean != OMX_TRUE)
+                    SEC_OMX_BufferFlushProcessNoEvent(pOMXComponent, i);
+                else
+                    SEC_OSAL_Log(SEC_LOG_TRACE, "port %d clean since its flush, not flushed again", i);
+                pSECComponent->pSECPort[i].bFlushClean = OMX_FALSE;
+            }
+            SEC_OMX_TraceDump(&pSECComponent->trace, pSECComponent->componentName);
             pSECComponent->currentState = OMX_StateIdle;
             break;
         case OMX_StateWaitForResources:
@@ -419,8 +428,8 @@ OMX_ERRORTYPE SEC_OMX_ComponentStateSet(OMX_COMPONENTTYPE *pOMXComponent, OMX_U3
                 if (CHECK_PORT_TUNNELED(pSECPort) && CHECK_PORT_BUFFER_SUPPLIER(pSECPort) && CHECK_PORT_ENABLED(pSECPort)) {
                     OMX_U32 semaValue = 0, cnt = 0;
                     SEC_OSAL_Get_SemaphoreCount(pSECComponent->pSECPort[i].bufferSemID, &semaValue);
-                    if (SEC_OSAL_GetElemNum(&pSECPort->bufferQ) > semaValue) {
-                        cnt = SEC_OSAL_GetElemNum(&pSECPort->bufferQ) - semaValue;
+                    if (SEC_OSAL_RingGetElemNum(&pSECPort->bufferQ) > semaValue) {
+                        cnt = SEC_OSAL_RingGetElemNum(&pSECPort->bufferQ) - semaValue;
                         for (j = 0; j < cnt; j++) {
                             SEC_OSAL_SemaphorePost(pSECComponent->pSECPort[i].bufferSemID);
                         }
@@ -487,6 +496,37 @@ EXIT:
     return ret;
 }
 
+/*
+ * a flush of one port with the flush of the other port queued right behind
+ * it is done as one flush of all ports, each port still gets its
+ * EventCmdComplete. stagefright sends them back to back on a seek.
+ */
+static OMX_U32 SEC_OMX_CoalesceFlush(SEC_OMX_BASECOMPONENT *pSECComponent, OMX_U32 nPortIndex)
+{
+    SEC_OMX_MESSAGE *next = NULL;
+
+    if (nPortIndex == ALL_PORT_INDEX)
+        goto EXIT;
+
+    next = (SEC_OMX_MESSAGE *)SEC_OSAL_QueuePeek(&pSECComponent->messageQ);
+    if ((next == NULL) ||
+        (next->messageType != OMX_CommandFlush) ||
+        (next->messageParam == ALL_PORT_INDEX) ||
+        (next->messageParam == nPortIndex) ||
+        (next->messageParam >= ALL_PORT_NUM))
+        goto EXIT;
+
+    /* the handler thread is the only consumer, the peeked message is still first */
+    next = (SEC_OMX_MESSAGE *)SEC_OSAL_Dequeue(&pSECComponent->messageQ);
+    SEC_OSAL_SemaphoreWait(pSECComponent->msgSemaphoreHandle);
+    SEC_OSAL_PoolFree(&pSECComponent->messagePool, next);
+    SEC_OSAL_Log(SEC_LOG_TRACE, "flush of port %d and %d coalesced", nPortIndex, !nPortIndex);
+    nPortIndex = ALL_PORT_INDEX;
+
+EXIT:
+    return nPortIndex;
+}
+
 static OMX_ERRORTYPE SEC_OMX_MessageHandlerThread(OMX_PTR threadData)
 {
     OMX_ERRORTYPE          ret = OMX_ErrorNone;
@@ -520,7 +560,8 @@ static OMX_ERRORTYPE SEC_OMX_MessageHandlerThread(OMX_PTR threadData)
                 ret = SEC_OMX_ComponentStateSet(pOMXComponent, message->messageParam);
                 break;
             case OMX_CommandFlush:
-                ret = SEC_OMX_BufferFlushProcess(pOMXComponent, message->messageParam);
+                ret = SEC_OMX_BufferFlushProcess(pOMXComponent,
+                          SEC_OMX_CoalesceFlush(pSECComponent, message->messageParam));
                 break;
             case OMX_CommandPortDisable:
                 ret = SEC_OMX_PortDisableProcess(pOMXComponent, message->messageParam);
@@ -539,7 +580,7 @@ static OMX_ERRORTYPE SEC_OMX_MessageHandlerThread(OMX_PTR threadData)
             default:
                 break;
             }
-            SEC_OSAL_Free(message);
+            SEC_OSAL_PoolFree(&pSECComponent->messagePool, message);
             message = NULL;
         }
     }
@@ -733,7 +774,7 @@ static OMX_ERRORTYPE SEC_OMX_CommandQueue(
     OMX_PTR                pCmdData)
 {
     OMX_ERRORTYPE    ret = OMX_ErrorNone;
-    SEC_OMX_MESSAGE *command = (SEC_OMX_MESSAGE *)SEC_OSAL_Malloc(sizeof(SEC_OMX_MESSAGE));
+    SEC_OMX_MESSAGE *command = (SEC_OMX_MESSAGE *)SEC_OSAL_PoolAlloc(&pSECComponent->messagePool);
 
     if (command == NULL) {
         ret = OMX_ErrorInsufficientResources;
@@ -745,6 +786,7 @@ static OMX_ERRORTYPE SEC_OMX_CommandQueue(
 
     ret = SEC_OSAL_Queue(&pSECComponent->messageQ, (void *)command);
     if (ret != 0) {
+        SEC_OSAL_PoolFree(&pSECComponent->messagePool, command);
         ret = OMX_ErrorUndefined;
         goto EXIT;
     }
@@ -1218,7 +1260,18 @@ OMX_ERRORTYPE SEC_OMX_GetConfig(
         ret = OMX_ErrorInvalidState;
         goto EXIT;
     }
-    ret = OMX_ErrorUnsupportedIndex;
+
+    switch (nIndex) {
+    case OMX_IndexVendorMFCCapacity:
+        ret = SEC_OMX_Check_SizeVersion(pComponentConfigStructure, sizeof(SEC_OMX_CONFIG_MFC_CAPACITY));
+        if (ret != OMX_ErrorNone)
+            break;
+        ret = SEC_OMX_Get_ResourceCapacity((SEC_OMX_CONFIG_MFC_CAPACITY *)pComponentConfigStructure);
+        break;
+    default:
+        ret = OMX_ErrorUnsupportedIndex;
+        break;
+    }
 
 EXIT:
     FunctionOut();
@@ -1261,7 +1314,16 @@ OMX_ERRORTYPE SEC_OMX_SetConfig(
         ret = OMX_ErrorInvalidState;
         goto EXIT;
     }
-    ret = OMX_ErrorUnsupportedIndex;
+
+    switch (nIndex) {
+    case OMX_IndexVendorDumpLatency:
+        SEC_OMX_TraceDump(&pSECComponent->trace, pSECComponent->componentName);
+        ret = OMX_ErrorNone;
+        break;
+    default:
+        ret = OMX_ErrorUnsupportedIndex;
+        break;
+    }
 
 EXIT:
     FunctionOut();
@@ -1305,6 +1367,16 @@ OMX_ERRORTYPE SEC_OMX_GetExtensionIndex(
         goto EXIT;
     }
 
+    if (SEC_OSAL_Strcmp(cParameterName, SEC_INDEX_CONFIG_DUMP_LATENCY) == 0) {
+        *pIndexType = OMX_IndexVendorDumpLatency;
+        ret = OMX_ErrorNone;
+        goto EXIT;
+    }
+    if (SEC_OSAL_Strcmp(cParameterName, SEC_INDEX_CONFIG_MFC_CAPACITY) == 0) {
+        *pIndexType = OMX_IndexVendorMFCCapacity;
+        ret = OMX_ErrorNone;
+        goto EXIT;
+    }
     ret = OMX_ErrorBadParameter;
 
 EXIT:
@@ -1397,7 +1469,14 @@ OMX_ERRORTYPE SEC_OMX_BaseComponent_Constructor(
     }
     SEC_OSAL_Memset(pSECComponent, 0, sizeof(SEC_OMX_BASECOMPONENT));
     pOMXComponent->pComponentPrivate = (OMX_PTR)pSECComponent;
+    SEC_OMX_TraceInit(&pSECComponent->trace);
 
+    ret = SEC_OMX_MFC_SessionCreate(&pSECComponent->mfcSession);
+    if (ret != OMX_ErrorNone) {
+        ret = OMX_ErrorInsufficientResources;
+        SEC_OSAL_Log(SEC_LOG_ERROR, "OMX_ErrorInsufficientResources, Line:%d", __LINE__);
+        goto EXIT;
+    }
     ret = SEC_OSAL_SemaphoreCreate(&pSECComponent->msgSemaphoreHandle);
     if (ret != OMX_ErrorNone) {
         ret = OMX_ErrorInsufficientResources;
@@ -1411,6 +1490,21 @@ OMX_ERRORTYPE SEC_OMX_BaseComponent_Constructor(
         goto EXIT;
     }
 
+    ret = SEC_OSAL_PoolCreate(&pSECComponent->messagePool, sizeof(SEC_OMX_MESSAGE),
+                              (ALL_PORT_NUM * MAX_BUFFER_NUM) + MAX_QUEUE_ELEMENTS);
+    if (ret != OMX_ErrorNone) {
+        ret = OMX_ErrorInsufficientResources;
+        SEC_OSAL_Log(SEC_LOG_ERROR, "OMX_ErrorInsufficientResources, Line:%d", __LINE__);
+        goto EXIT;
+    }
+    ret = SEC_OSAL_PoolCreate(&pSECComponent->bufferHeaderPool, sizeof(OMX_BUFFERHEADERTYPE),
+                              ALL_PORT_NUM * MAX_BUFFER_NUM);
+    if (ret != OMX_ErrorNone) {
+        ret = OMX_ErrorInsufficientResources;
+        SEC_OSAL_Log(SEC_LOG_ERROR, "OMX_ErrorInsufficientResources, Line:%d", __LINE__);
+        goto EXIT;
+    }
+
     pSECComponent->bExitMessageHandlerThread = OMX_FALSE;
     SEC_OSAL_QueueCreate(&pSECComponent->messageQ);
     ret = SEC_OSAL_ThreadCreate(&pSECComponent->hMessageHandler, SEC_OMX_MessageHandlerThread, pOMXComponent);
@@ -1473,7 +1567,10 @@ OMX_ERRORTYPE SEC_OMX_BaseComponent_Destructor(
     pSECComponent->compMutex = NULL;
     SEC_OSAL_SemaphoreTerminate(pSECComponent->msgSemaphoreHandle);
     pSECComponent->msgSemaphoreHandle = NULL;
+    SEC_OMX_MFC_SessionTerminate(&pSECComponent->mfcSession);
     SEC_OSAL_QueueTerminate(&pSECComponent->messageQ);
+    SEC_OSAL_PoolTerminate(&pSECComponent->bufferHeaderPool);
+    SEC_OSAL_PoolTerminate(&pSECComponent->messagePool);
 
     SEC_OSAL_Free(pSECComponent);
     pSECComponent = NULL;
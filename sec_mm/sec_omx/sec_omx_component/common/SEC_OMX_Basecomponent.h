@@ -31,7 +31,11 @@
 #include "SEC_OMX_Def.h"
 #include "OMX_Component.h"
 #include "SEC_OSAL_Queue.h"
+#include "SEC_OSAL_Memory.h"
 #include "SEC_OMX_Baseport.h"
+#include "SEC_OMX_Trace.h"
+#include "SEC_OMX_Resourcemanager.h"
+#include "SEC_OMX_Timestamp.h"
 
 
 typedef struct _SEC_OMX_MESSAGE
@@ -74,6 +78,8 @@ typedef struct _SEC_OMX_DATA
     OMX_U32   nFlags;
     OMX_TICKS timeStamp;
     SEC_BUFFER_HEADER specificBufferHeader;
+    /* client buffer the data was produced in, it goes back as it is */
+    OMX_BUFFERHEADERTYPE *bufferHeader;
 } SEC_OMX_DATA;
 
 /* for Check TimeStamp after Seek */
@@ -107,6 +113,10 @@ typedef struct _SEC_OMX_BASECOMPONENT
     OMX_HANDLETYPE           msgSemaphoreHandle;
     SEC_QUEUE                messageQ;
 
+    /* the commands and buffer messages, the buffer headers of the ports */
+    SEC_OSAL_POOL            messagePool;
+    SEC_OSAL_POOL            bufferHeaderPool;
+
     /* Buffer Process */
     OMX_BOOL                 bExitBufferProcessThread;
     OMX_HANDLETYPE           hBufferProcess;
@@ -127,27 +137,43 @@ typedef struct _SEC_OMX_BASECOMPONENT
     OMX_CALLBACKTYPE        *pCallbacks;
     OMX_PTR                  callbackData;
 
-    /* Save Timestamp */
-    OMX_TICKS                timeStamp[MAX_TIMESTAMP];
+    /* Save Timestamp and Flags of the frames in the MFC */
+    SEC_OMX_TIMESTAMP_MAP    timestampMap;
     SEC_OMX_TIMESTAMP        checkTimeStamp;
 
-    /* Save Flags */
-    OMX_U32                  nFlags[MAX_FLAGS];
-
     OMX_BOOL                 getAllDelayBuffer;
     OMX_BOOL                 remainOutputData;
     OMX_BOOL                 reInputData;
 
+    /* buffer latencies, see SEC_OMX_TRACE_PROPERTY */
+    SEC_OMX_TRACE            trace;
+
+    /* MFC turns of a HW_VIDEO_CODEC, see SEC_OMX_MFC_RunBegin */
+    SEC_OMX_RM_MFC_SESSION   mfcSession;
+
     /* Android CapabilityFlags */
     OMXComponentCapabilityFlagsType capabilityFlags;
 
     OMX_BOOL bUseFlagEOF;
     OMX_BOOL bSaveFlagEOS;
+    /* encoders: every NAL unit of a frame is a buffer of its own, the last one has ENDOFFRAME */
+    OMX_BOOL bSliceOutput;
 
     OMX_ERRORTYPE (*sec_mfc_componentInit)(OMX_COMPONENTTYPE *pOMXComponent);
     OMX_ERRORTYPE (*sec_mfc_componentTerminate)(OMX_COMPONENTTYPE *pOMXComponent);
     OMX_ERRORTYPE (*sec_mfc_bufferProcess) (OMX_COMPONENTTYPE *pOMXComponent, SEC_OMX_DATA *pInputData, SEC_OMX_DATA *pOutputData);
 
+    /* optional, input buffers in MFC stream memory that are decoded in place */
+    OMX_PTR       (*sec_mfc_allocInputBuffer)(OMX_COMPONENTTYPE *pOMXComponent, OMX_U32 nSizeBytes);
+    void          (*sec_mfc_freeInputBuffer)(OMX_COMPONENTTYPE *pOMXComponent, OMX_PTR pBuffer);
+    OMX_ERRORTYPE (*sec_mfc_setInputBuffer)(OMX_COMPONENTTYPE *pOMXComponent, OMX_BUFFERHEADERTYPE *pBufferHeader);
+    OMX_ERRORTYPE (*sec_mfc_releaseInputBuffer)(OMX_COMPONENTTYPE *pOMXComponent);
+
+    /* optional, output buffers in MFC stream memory that are encoded into in place */
+    OMX_PTR       (*sec_mfc_allocOutputBuffer)(OMX_COMPONENTTYPE *pOMXComponent, OMX_U32 nSizeBytes);
+    void          (*sec_mfc_freeOutputBuffer)(OMX_COMPONENTTYPE *pOMXComponent, OMX_PTR pBuffer);
+    OMX_ERRORTYPE (*sec_mfc_releaseOutputBuffer)(OMX_COMPONENTTYPE *pOMXComponent);
+
     OMX_ERRORTYPE (*sec_AllocateTunnelBuffer)(SEC_OMX_BASEPORT *pOMXBasePort, OMX_U32 nPortIndex);
     OMX_ERRORTYPE (*sec_FreeTunnelBuffer)(SEC_OMX_BASEPORT *pOMXBasePort, OMX_U32 nPortIndex);
     OMX_ERRORTYPE (*sec_BufferProcess)(OMX_HANDLETYPE hComponent);
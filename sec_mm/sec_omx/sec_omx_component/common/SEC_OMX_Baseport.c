@@ -43,6 +43,19 @@
 #include "SEC_OSAL_Log.h"
 
 
+OMX_ERRORTYPE SEC_OMX_Port_Destructor(OMX_HANDLETYPE hComponent);
+
+static int SEC_OMX_PortRingPut(SEC_OMX_BASEPORT *pSECPort, SEC_OMX_MESSAGE *message)
+{
+    int ret;
+
+    SEC_OSAL_MutexLock(pSECPort->bufferQMutex);
+    ret = SEC_OSAL_RingPut(&pSECPort->bufferQ, (void *)message);
+    SEC_OSAL_MutexUnlock(pSECPort->bufferQMutex);
+
+    return ret;
+}
+
 OMX_ERRORTYPE SEC_OMX_FlushPort(OMX_COMPONENTTYPE *pOMXComponent, OMX_S32 portIndex)
 {
     OMX_ERRORTYPE          ret = OMX_ErrorNone;
@@ -51,19 +64,19 @@ OMX_ERRORTYPE SEC_OMX_FlushPort(OMX_COMPONENTTYPE *pOMXComponent, OMX_S32 portIn
     OMX_BUFFERHEADERTYPE  *bufferHeader = NULL;
     SEC_OMX_MESSAGE       *message = NULL;
     OMX_U32                flushNum = 0;
-    OMX_S32                semValue = 0;
 
     FunctionIn();
 
     pSECPort = &pSECComponent->pSECPort[portIndex];
-    while (SEC_OSAL_GetElemNum(&pSECPort->bufferQ) > 0) {
-        SEC_OSAL_Get_SemaphoreCount(pSECComponent->pSECPort[portIndex].bufferSemID, &semValue);
-        if (semValue == 0)
-            SEC_OSAL_SemaphorePost(pSECComponent->pSECPort[portIndex].bufferSemID);
-        SEC_OSAL_SemaphoreWait(pSECComponent->pSECPort[portIndex].bufferSemID);
-
-        message = (SEC_OMX_MESSAGE *)SEC_OSAL_Dequeue(&pSECPort->bufferQ);
+    /*
+     * the queued buffers go back in one pass, the buffer process thread is
+     * kept off the ring by the data buffer mutex. the semaphore counts
+     * they leave behind are taken down at the end.
+     */
+    while (SEC_OSAL_RingGetElemNum(&pSECPort->bufferQ) > 0) {
+        message = (SEC_OMX_MESSAGE *)SEC_OSAL_RingGet(&pSECPort->bufferQ);
         if (message != NULL) {
+            flushNum++;
             bufferHeader = (OMX_BUFFERHEADERTYPE *)message->pCmdData;
             bufferHeader->nFilledLen = 0;
 
@@ -73,33 +86,41 @@ OMX_ERRORTYPE SEC_OMX_FlushPort(OMX_COMPONENTTYPE *pOMXComponent, OMX_S32 portIn
                 } else {
                     OMX_FillThisBuffer(pSECPort->tunneledComponent, bufferHeader);
                 }
-                SEC_OSAL_Free(message);
+                SEC_OSAL_PoolFree(&pSECComponent->messagePool, message);
                 message = NULL;
             } else if (CHECK_PORT_TUNNELED(pSECPort) && CHECK_PORT_BUFFER_SUPPLIER(pSECPort)) {
                 SEC_OSAL_Log(SEC_LOG_ERROR, "Tunneled mode is not working, Line:%d", __LINE__);
                 ret = OMX_ErrorNotImplemented;
-                SEC_OSAL_Queue(&pSECPort->bufferQ, pSECPort);
+                SEC_OMX_PortRingPut(pSECPort, message);
                 goto EXIT;
             } else {
+                SEC_OMX_TraceBufferDone(&pSECComponent->trace, pSECPort, portIndex, bufferHeader);
                 if (portIndex == OUTPUT_PORT_INDEX) {
                     pSECComponent->pCallbacks->FillBufferDone(pOMXComponent, pSECComponent->callbackData, bufferHeader);
                 } else {
                     pSECComponent->pCallbacks->EmptyBufferDone(pOMXComponent, pSECComponent->callbackData, bufferHeader);
                 }
 
-                SEC_OSAL_Free(message);
+                SEC_OSAL_PoolFree(&pSECComponent->messagePool, message);
                 message = NULL;
             }
         }
     }
 
+    /* input buffers the decoder still holds for in place decoding */
+    if ((portIndex == INPUT_PORT_INDEX) && (pSECComponent->sec_mfc_releaseInputBuffer != NULL))
+        pSECComponent->sec_mfc_releaseInputBuffer(pOMXComponent);
+    /* output buffers the encoder still holds for in place encoding */
+    if ((portIndex == OUTPUT_PORT_INDEX) && (pSECComponent->sec_mfc_releaseOutputBuffer != NULL))
+        pSECComponent->sec_mfc_releaseOutputBuffer(pOMXComponent);
+
     if (pSECComponent->secDataBuffer[portIndex].dataValid == OMX_TRUE) {
         if (CHECK_PORT_TUNNELED(pSECPort) && CHECK_PORT_BUFFER_SUPPLIER(pSECPort)) {
-            message = SEC_OSAL_Malloc(sizeof(SEC_OMX_MESSAGE));
+            message = SEC_OSAL_PoolAlloc(&pSECComponent->messagePool);
             message->pCmdData = pSECComponent->secDataBuffer[portIndex].bufferHeader;
             message->messageType = 0;
             message->messageParam = -1;
-            SEC_OSAL_Queue(&pSECPort->bufferQ, message);
+            SEC_OMX_PortRingPut(pSECPort, message);
             pSECComponent->sec_BufferReset(pOMXComponent, portIndex);
         } else {
             if (portIndex == INPUT_PORT_INDEX)
@@ -110,11 +131,9 @@ OMX_ERRORTYPE SEC_OMX_FlushPort(OMX_COMPONENTTYPE *pOMXComponent, OMX_S32 portIn
     }
 
     if (CHECK_PORT_TUNNELED(pSECPort) && CHECK_PORT_BUFFER_SUPPLIER(pSECPort)) {
-        while (SEC_OSAL_GetElemNum(&pSECPort->bufferQ) < pSECPort->assignedBufferNum) {
+        while (SEC_OSAL_RingGetElemNum(&pSECPort->bufferQ) < pSECPort->assignedBufferNum) {
             SEC_OSAL_SemaphoreWait(pSECComponent->pSECPort[portIndex].bufferSemID);
         }
-        if (SEC_OSAL_GetElemNum(&pSECPort->bufferQ) != pSECPort->assignedBufferNum)
-            SEC_OSAL_SetElemNum(&pSECPort->bufferQ, pSECPort->assignedBufferNum);
     } else {
         while(1) {
             int cnt;
@@ -123,7 +142,6 @@ OMX_ERRORTYPE SEC_OMX_FlushPort(OMX_COMPONENTTYPE *pOMXComponent, OMX_S32 portIn
                 break;
             SEC_OSAL_SemaphoreWait(pSECComponent->pSECPort[portIndex].bufferSemID);
         }
-        SEC_OSAL_SetElemNum(&pSECPort->bufferQ, 0);
     }
 
     pSECComponent->processData[portIndex].dataLen       = 0;
@@ -131,6 +149,7 @@ OMX_ERRORTYPE SEC_OMX_FlushPort(OMX_COMPONENTTYPE *pOMXComponent, OMX_S32 portIn
     pSECComponent->processData[portIndex].remainDataLen = 0;
     pSECComponent->processData[portIndex].timeStamp     = 0;
     pSECComponent->processData[portIndex].usedDataLen   = 0;
+    SEC_OSAL_Log(SEC_LOG_TRACE, "port %d flushed, %d queued buffers returned", portIndex, flushNum);
 
 EXIT:
     FunctionOut();
@@ -174,6 +193,12 @@ OMX_ERRORTYPE SEC_OMX_BufferFlushProcess(OMX_COMPONENTTYPE *pOMXComponent, OMX_S
 
         SEC_OSAL_SignalSet(pSECComponent->pauseEvent);
 
+        /* an input flush while running is a seek */
+        if ((portIndex == INPUT_PORT_INDEX) &&
+            ((pSECComponent->currentState == OMX_StateExecuting) ||
+             (pSECComponent->currentState == OMX_StatePause)))
+            SEC_OMX_TraceSeekStart(&pSECComponent->trace);
+
         flushBuffer = &pSECComponent->secDataBuffer[portIndex];
 
         SEC_OSAL_MutexLock(flushBuffer->bufferMutex);
@@ -181,6 +206,7 @@ OMX_ERRORTYPE SEC_OMX_BufferFlushProcess(OMX_COMPONENTTYPE *pOMXComponent, OMX_S
         SEC_OSAL_MutexUnlock(flushBuffer->bufferMutex);
 
         pSECComponent->pSECPort[portIndex].bIsPortFlushed = OMX_FALSE;
+        pSECComponent->pSECPort[portIndex].bFlushClean = (ret == OMX_ErrorNone) ? OMX_TRUE : OMX_FALSE;
 
         if (ret == OMX_ErrorNone) {
             SEC_OSAL_Log(SEC_LOG_TRACE,"OMX_CommandFlush EventCmdComplete");
@@ -193,8 +219,7 @@ OMX_ERRORTYPE SEC_OMX_BufferFlushProcess(OMX_COMPONENTTYPE *pOMXComponent, OMX_S
         if (portIndex == INPUT_PORT_INDEX) {
             pSECComponent->checkTimeStamp.needSetStartTimeStamp = OMX_TRUE;
             pSECComponent->checkTimeStamp.needCheckStartTimeStamp = OMX_FALSE;
-            SEC_OSAL_Memset(pSECComponent->timeStamp, -19771003, sizeof(OMX_TICKS) * MAX_TIMESTAMP);
-            SEC_OSAL_Memset(pSECComponent->nFlags, 0, sizeof(OMX_U32) * MAX_FLAGS);
+            SEC_OMX_TimestampMapReset(&pSECComponent->timestampMap);
             pSECComponent->getAllDelayBuffer = OMX_FALSE;
             pSECComponent->bSaveFlagEOS = OMX_FALSE;
             pSECComponent->reInputData = OMX_FALSE;
@@ -265,8 +290,7 @@ OMX_ERRORTYPE SEC_OMX_BufferFlushProcessNoEvent(OMX_COMPONENTTYPE *pOMXComponent
         if (portIndex == INPUT_PORT_INDEX) {
             pSECComponent->checkTimeStamp.needSetStartTimeStamp = OMX_TRUE;
             pSECComponent->checkTimeStamp.needCheckStartTimeStamp = OMX_FALSE;
-            SEC_OSAL_Memset(pSECComponent->timeStamp, -19771003, sizeof(OMX_TICKS) * MAX_TIMESTAMP);
-            SEC_OSAL_Memset(pSECComponent->nFlags, 0, sizeof(OMX_U32) * MAX_FLAGS);
+            SEC_OMX_TimestampMapReset(&pSECComponent->timestampMap);
             pSECComponent->getAllDelayBuffer = OMX_FALSE;
             pSECComponent->bSaveFlagEOS = OMX_FALSE;
             pSECComponent->remainOutputData = OMX_FALSE;
@@ -364,6 +388,9 @@ OMX_ERRORTYPE SEC_OMX_PortEnableProcess(OMX_COMPONENTTYPE *pOMXComponent, OMX_S3
 
         ret = SEC_OMX_EnablePort(pOMXComponent, portIndex);
         if (ret == OMX_ErrorNone) {
+            /* the buffer process thread sleeps while a port is disabled */
+            if (pSECComponent->hBufferProcess != NULL)
+                SEC_OSAL_SignalSet(pSECComponent->pauseEvent);
             pSECComponent->pCallbacks->EventHandler(pOMXComponent,
                             pSECComponent->callbackData,
                             OMX_EventCmdComplete,
@@ -403,9 +430,9 @@ OMX_ERRORTYPE SEC_OMX_DisablePort(OMX_COMPONENTTYPE *pOMXComponent, OMX_S32 port
 
     if (pSECComponent->currentState!=OMX_StateLoaded) {
         if (CHECK_PORT_TUNNELED(pSECPort) && CHECK_PORT_BUFFER_SUPPLIER(pSECPort)) {
-            while (SEC_OSAL_GetElemNum(&pSECPort->bufferQ) >0 ) {
-                message = (SEC_OMX_MESSAGE*)SEC_OSAL_Dequeue(&pSECPort->bufferQ);
-                SEC_OSAL_Free(message);
+            while (SEC_OSAL_RingGetElemNum(&pSECPort->bufferQ) >0 ) {
+                message = (SEC_OMX_MESSAGE*)SEC_OSAL_RingGet(&pSECPort->bufferQ);
+                SEC_OSAL_PoolFree(&pSECComponent->messagePool, message);
             }
             ret = pSECComponent->sec_FreeTunnelBuffer(pSECPort, portIndex);
             if (OMX_ErrorNone != ret) {
@@ -417,9 +444,9 @@ OMX_ERRORTYPE SEC_OMX_DisablePort(OMX_COMPONENTTYPE *pOMXComponent, OMX_S32 port
             SEC_OSAL_SemaphoreWait(pSECPort->unloadedResource);
         } else {
             if (CHECK_PORT_BUFFER_SUPPLIER(pSECPort)) {
-                while (SEC_OSAL_GetElemNum(&pSECPort->bufferQ) >0 ) {
-                    message = (SEC_OMX_MESSAGE*)SEC_OSAL_Dequeue(&pSECPort->bufferQ);
-                    SEC_OSAL_Free(message);
+                while (SEC_OSAL_RingGetElemNum(&pSECPort->bufferQ) >0 ) {
+                    message = (SEC_OMX_MESSAGE*)SEC_OSAL_RingGet(&pSECPort->bufferQ);
+                    SEC_OSAL_PoolFree(&pSECComponent->messagePool, message);
                 }
             }
             pSECPort->portDefinition.bPopulated = OMX_FALSE;
@@ -482,8 +509,7 @@ OMX_ERRORTYPE SEC_OMX_PortDisableProcess(OMX_COMPONENTTYPE *pOMXComponent, OMX_S
         if (portIndex == INPUT_PORT_INDEX) {
             pSECComponent->checkTimeStamp.needSetStartTimeStamp = OMX_TRUE;
             pSECComponent->checkTimeStamp.needCheckStartTimeStamp = OMX_FALSE;
-            SEC_OSAL_Memset(pSECComponent->timeStamp, -19771003, sizeof(OMX_TICKS) * MAX_TIMESTAMP);
-            SEC_OSAL_Memset(pSECComponent->nFlags, 0, sizeof(OMX_U32) * MAX_FLAGS);
+            SEC_OMX_TimestampMapReset(&pSECComponent->timestampMap);
             pSECComponent->getAllDelayBuffer = OMX_FALSE;
             pSECComponent->bSaveFlagEOS = OMX_FALSE;
             pSECComponent->reInputData = OMX_FALSE;
@@ -600,7 +626,7 @@ OMX_ERRORTYPE SEC_OMX_EmptyThisBuffer(
         ret = OMX_ErrorNone;
     }
 
-    message = SEC_OSAL_Malloc(sizeof(SEC_OMX_MESSAGE));
+    message = SEC_OSAL_PoolAlloc(&pSECComponent->messagePool);
     if (message == NULL) {
         ret = OMX_ErrorInsufficientResources;
         goto EXIT;
@@ -609,7 +635,14 @@ OMX_ERRORTYPE SEC_OMX_EmptyThisBuffer(
     message->messageParam = (OMX_U32) i;
     message->pCmdData = (OMX_PTR)pBuffer;
 
-    SEC_OSAL_Queue(&pSECPort->bufferQ, (void *)message);
+    SEC_OMX_TraceBufferStart(&pSECComponent->trace, INPUT_PORT_INDEX, i);
+
+    pSECPort->bFlushClean = OMX_FALSE;
+    if (SEC_OMX_PortRingPut(pSECPort, message) != 0) {
+        SEC_OSAL_PoolFree(&pSECComponent->messagePool, message);
+        ret = OMX_ErrorInsufficientResources;
+        goto EXIT;
+    }
     SEC_OSAL_SemaphorePost(pSECPort->bufferSemID);
 
 EXIT:
@@ -697,7 +730,7 @@ OMX_ERRORTYPE SEC_OMX_FillThisBuffer(
         ret = OMX_ErrorNone;
     }
 
-    message = SEC_OSAL_Malloc(sizeof(SEC_OMX_MESSAGE));
+    message = SEC_OSAL_PoolAlloc(&pSECComponent->messagePool);
     if (message == NULL) {
         ret = OMX_ErrorInsufficientResources;
         goto EXIT;
@@ -706,7 +739,14 @@ OMX_ERRORTYPE SEC_OMX_FillThisBuffer(
     message->messageParam = (OMX_U32) i;
     message->pCmdData = (OMX_PTR)pBuffer;
 
-    SEC_OSAL_Queue(&pSECPort->bufferQ, (void *)message);
+    SEC_OMX_TraceBufferStart(&pSECComponent->trace, OUTPUT_PORT_INDEX, i);
+
+    pSECPort->bFlushClean = OMX_FALSE;
+    if (SEC_OMX_PortRingPut(pSECPort, message) != 0) {
+        SEC_OSAL_PoolFree(&pSECComponent->messagePool, message);
+        ret = OMX_ErrorInsufficientResources;
+        goto EXIT;
+    }
     SEC_OSAL_SemaphorePost(pSECPort->bufferSemID);
 
 EXIT:
@@ -761,7 +801,7 @@ OMX_ERRORTYPE SEC_OMX_Port_Constructor(OMX_HANDLETYPE hComponent)
     /* Input Port */
     pSECInputPort = &pSECPort[INPUT_PORT_INDEX];
 
-    SEC_OSAL_QueueCreate(&pSECInputPort->bufferQ);
+    SEC_OSAL_RingCreate(&pSECInputPort->bufferQ);
 
     pSECInputPort->bufferHeader = SEC_OSAL_Malloc(sizeof(OMX_BUFFERHEADERTYPE*) * MAX_BUFFER_NUM);
     if (pSECInputPort->bufferHeader == NULL) {
@@ -789,6 +829,7 @@ OMX_ERRORTYPE SEC_OMX_Port_Constructor(OMX_HANDLETYPE hComponent)
     pSECInputPort->assignedBufferNum = 0;
     pSECInputPort->portState = OMX_StateMax;
     pSECInputPort->bIsPortFlushed = OMX_FALSE;
+    pSECInputPort->bFlushClean = OMX_FALSE;
     pSECInputPort->bIsPortDisabled = OMX_FALSE;
     pSECInputPort->tunneledComponent = NULL;
     pSECInputPort->tunneledPort = 0;
@@ -838,7 +879,7 @@ OMX_ERRORTYPE SEC_OMX_Port_Constructor(OMX_HANDLETYPE hComponent)
     /* Output Port */
     pSECOutputPort = &pSECPort[OUTPUT_PORT_INDEX];
 
-    SEC_OSAL_QueueCreate(&pSECOutputPort->bufferQ);
+    SEC_OSAL_RingCreate(&pSECOutputPort->bufferQ);
 
     pSECOutputPort->bufferHeader = SEC_OSAL_Malloc(sizeof(OMX_BUFFERHEADERTYPE*) * MAX_BUFFER_NUM);
     if (pSECOutputPort->bufferHeader == NULL) {
@@ -881,6 +922,7 @@ OMX_ERRORTYPE SEC_OMX_Port_Constructor(OMX_HANDLETYPE hComponent)
     pSECOutputPort->assignedBufferNum = 0;
     pSECOutputPort->portState = OMX_StateMax;
     pSECOutputPort->bIsPortFlushed = OMX_FALSE;
+    pSECOutputPort->bFlushClean = OMX_FALSE;
     pSECOutputPort->bIsPortDisabled = OMX_FALSE;
     pSECOutputPort->tunneledComponent = NULL;
     pSECOutputPort->tunneledPort = 0;
@@ -944,11 +986,24 @@ OMX_ERRORTYPE SEC_OMX_Port_Constructor(OMX_HANDLETYPE hComponent)
     pSECOutputPort->markType.pMarkData = NULL;
     pSECOutputPort->bUseAndroidNativeBuffer = OMX_FALSE;
     pSECOutputPort->bStoreMetaDataInBuffer = OMX_FALSE;
+    pSECOutputPort->bAdaptivePlayback = OMX_FALSE;
+    pSECOutputPort->nMaxFrameWidth = 0;
+    pSECOutputPort->nMaxFrameHeight = 0;
+
+    for (i = 0; i < ALL_PORT_NUM; i++) {
+        ret = SEC_OSAL_MutexCreate(&pSECPort[i].bufferQMutex);
+        if (ret != OMX_ErrorNone) {
+            SEC_OMX_Port_Destructor(hComponent);
+            ret = OMX_ErrorInsufficientResources;
+            goto EXIT;
+        }
+    }
 
     pSECComponent->checkTimeStamp.needSetStartTimeStamp = OMX_FALSE;
     pSECComponent->checkTimeStamp.needCheckStartTimeStamp = OMX_FALSE;
     pSECComponent->checkTimeStamp.startTimeStamp = 0;
     pSECComponent->checkTimeStamp.nStartFlags = 0x0;
+    SEC_OMX_TimestampMapReset(&pSECComponent->timestampMap);
 
     pOMXComponent->EmptyThisBuffer = &SEC_OMX_EmptyThisBuffer;
     pOMXComponent->FillThisBuffer  = &SEC_OMX_FillThisBuffer;
@@ -997,7 +1052,11 @@ OMX_ERRORTYPE SEC_OMX_Port_Destructor(OMX_HANDLETYPE hComponent)
         SEC_OSAL_Free(pSECPort->bufferHeader);
         pSECPort->bufferHeader = NULL;
 
-        SEC_OSAL_QueueTerminate(&pSECPort->bufferQ);
+        SEC_OSAL_RingTerminate(&pSECPort->bufferQ);
+        if (pSECPort->bufferQMutex != NULL) {
+            SEC_OSAL_MutexTerminate(pSECPort->bufferQMutex);
+            pSECPort->bufferQMutex = NULL;
+        }
     }
     SEC_OSAL_Free(pSECComponent->pSECPort);
     pSECComponent->pSECPort = NULL;
@@ -37,6 +37,7 @@
 #define BUFFER_STATE_ALLOCATED  (1 << 0)
 #define BUFFER_STATE_ASSIGNED   (1 << 1)
 #define HEADER_STATE_ALLOCATED  (1 << 2)
+#define BUFFER_STATE_MFC        (1 << 3)
 #define BUFFER_STATE_FREE        0
 
 #define MAX_BUFFER_NUM          20
@@ -52,13 +53,17 @@ typedef struct _SEC_OMX_BASEPORT
     OMX_U32                       *bufferStateAllocate;
     OMX_PARAM_PORTDEFINITIONTYPE   portDefinition;
     OMX_HANDLETYPE                 bufferSemID;
-    SEC_QUEUE                      bufferQ;
+    SEC_RING                       bufferQ;
+    /* the ring takes one producer, the client and the flush both put */
+    OMX_HANDLETYPE                 bufferQMutex;
     OMX_U32                        assignedBufferNum;
     OMX_STATETYPE                  portState;
     OMX_HANDLETYPE                 loadedResource;
     OMX_HANDLETYPE                 unloadedResource;
 
     OMX_BOOL                       bIsPortFlushed;
+    /* flushed and no buffer queued since, going to idle has nothing to return */
+    OMX_BOOL                       bFlushClean;
     OMX_BOOL                       bIsPortDisabled;
     OMX_MARKTYPE                   markType;
 
@@ -78,6 +83,10 @@ typedef struct _SEC_OMX_BASEPORT
     /* For Android Store Meta Data inBuffer */
     OMX_BOOL                       bStoreMetaDataInBuffer;
     OMX_PTR                        pIMGGrallocModule;
+    /* Adaptive playback: resolution changes up to the max only move the crop */
+    OMX_BOOL                       bAdaptivePlayback;
+    OMX_U32                        nMaxFrameWidth;
+    OMX_U32                        nMaxFrameHeight;
 } SEC_OMX_BASEPORT;
 
 
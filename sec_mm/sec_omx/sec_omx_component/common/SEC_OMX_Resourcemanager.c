@@ -27,7 +27,11 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
+#include "SEC_OSAL_Memory.h"
+#include "SEC_OSAL_Mutex.h"
+#include "SEC_OSAL_Semaphore.h"
 #include "SEC_OMX_Resourcemanager.h"
 #include "SEC_OMX_Basecomponent.h"
 
@@ -38,51 +42,143 @@
 
 
 #define MAX_RESOURCE_VIDEO 4
+/* frame macroblocks the MFC memory holds for all the open sessions, two 720p ones by default */
+#ifndef MAX_RESOURCE_VIDEO_MB
+#define MAX_RESOURCE_VIDEO_MB (2 * (1280 / 16) * (720 / 16))
+#endif
 
-/* Max allowable video scheduler component instance */
+/*
+ * Max allowable video scheduler component instance.
+ * The component list keeps the lowest priority session at its head, so the
+ * preemption victims are taken from the front. The waiting list keeps the
+ * highest priority waiter at its head, waiters of one priority in arrival order.
+ */
 static SEC_OMX_RM_COMPONENT_LIST *gpVideoRMComponentList = NULL;
 static SEC_OMX_RM_COMPONENT_LIST *gpVideoRMWaitingList = NULL;
+static OMX_U32 gnVideoRMComponentNum = 0;
+static OMX_U32 gnVideoRMUsedMB = 0;
 static OMX_HANDLETYPE ghVideoRMComponentListMutex = NULL;
+/* list entries of both lists, a waiting list longer than that goes to the heap */
+static SEC_OSAL_POOL gVideoRMListPool;
+
+/* frame interval of a session whose ports don't say */
+#define MFC_SESSION_PERIOD_US   (1000000 / 30)
+/* the MFC load is the share of such a window it was running */
+#define MFC_LOAD_WINDOW_US      (1000000)
+
+/*
+ * The MFC runs of all the sessions of the process, one at a time. The
+ * driver would serialize them anyway, in whatever order the ioctls come
+ * in, here the waiting run with the earliest deadline gets the hardware.
+ */
+static OMX_HANDLETYPE ghVideoRMRunMutex = NULL;
+static OMX_BOOL gbVideoRMRunning = OMX_FALSE;
+static SEC_OMX_RM_MFC_SESSION *gpVideoRMRunWaiting = NULL;
+static OMX_S64 gVideoRMLoadStartUs = 0;
+static OMX_S64 gVideoRMBusyUs = 0;
+static OMX_U32 gnVideoRMLoad = 0;
+
+
+static OMX_S64 getTimeUs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (OMX_S64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* closes the load window once it is over, with ghVideoRMRunMutex held */
+static void updateLoad(OMX_S64 nowUs)
+{
+    OMX_S64 windowUs = nowUs - gVideoRMLoadStartUs;
+
+    if (windowUs < MFC_LOAD_WINDOW_US)
+        return;
+
+    if (gVideoRMLoadStartUs == 0)
+        gnVideoRMLoad = 0;
+    else
+        gnVideoRMLoad = (OMX_U32)((gVideoRMBusyUs * 100) / windowUs);
+    if (gnVideoRMLoad > 100)
+        gnVideoRMLoad = 100;
+    gVideoRMLoadStartUs = nowUs;
+    gVideoRMBusyUs = 0;
+}
+
+static OMX_S64 getFramePeriodUs(SEC_OMX_BASECOMPONENT *pSECComponent)
+{
+    OMX_U32 xFramerate = 0;
+    int i;
+
+    for (i = 0; i < ALL_PORT_NUM; i++) {
+        OMX_PARAM_PORTDEFINITIONTYPE *pPortDef = &pSECComponent->pSECPort[i].portDefinition;
+
+        if ((pPortDef->eDomain == OMX_PortDomainVideo) &&
+            (pPortDef->format.video.xFramerate > xFramerate))
+            xFramerate = pPortDef->format.video.xFramerate;
+    }
+
+    /* Q16 frames per second */
+    if ((xFramerate >> 16) == 0)
+        return MFC_SESSION_PERIOD_US;
 
+    return ((OMX_S64)1000000 << 16) / xFramerate;
+}
+
+
+static OMX_U32 getFrameMB(SEC_OMX_BASECOMPONENT *pSECComponent)
+{
+    OMX_U32 nMB = 0;
+    OMX_U32 nPortMB = 0;
+    int i;
+
+    for (i = 0; i < ALL_PORT_NUM; i++) {
+        OMX_PARAM_PORTDEFINITIONTYPE *pPortDef = &pSECComponent->pSECPort[i].portDefinition;
+
+        if (pPortDef->eDomain != OMX_PortDomainVideo)
+            continue;
+        nPortMB = ((pPortDef->format.video.nFrameWidth + 15) / 16) *
+                  ((pPortDef->format.video.nFrameHeight + 15) / 16);
+        if (nPortMB > nMB)
+            nMB = nPortMB;
+    }
+
+    return nMB;
+}
 
-OMX_ERRORTYPE addElementList(SEC_OMX_RM_COMPONENT_LIST **ppList, OMX_COMPONENTTYPE *pOMXComponent)
+OMX_ERRORTYPE addElementList(SEC_OMX_RM_COMPONENT_LIST **ppList, OMX_COMPONENTTYPE *pOMXComponent, OMX_BOOL bLowPriorityFirst)
 {
     OMX_ERRORTYPE              ret = OMX_ErrorNone;
-    SEC_OMX_RM_COMPONENT_LIST *pTempComp = NULL;
+    SEC_OMX_RM_COMPONENT_LIST *pNewComp = NULL;
+    SEC_OMX_RM_COMPONENT_LIST **ppInsert = ppList;
     SEC_OMX_BASECOMPONENT     *pSECComponent = NULL;
 
     pSECComponent = (SEC_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
-    if (*ppList != NULL) {
-        pTempComp = *ppList;
-        while (pTempComp->pNext != NULL) {
-            pTempComp = pTempComp->pNext;
-        }
-        pTempComp->pNext = (SEC_OMX_RM_COMPONENT_LIST *)SEC_OSAL_Malloc(sizeof(SEC_OMX_RM_COMPONENT_LIST));
-        if (pTempComp->pNext == NULL) {
-            ret = OMX_ErrorInsufficientResources;
-            goto EXIT;
-        }
-        ((SEC_OMX_RM_COMPONENT_LIST *)(pTempComp->pNext))->pNext = NULL;
-        ((SEC_OMX_RM_COMPONENT_LIST *)(pTempComp->pNext))->pOMXStandComp = pOMXComponent;
-        ((SEC_OMX_RM_COMPONENT_LIST *)(pTempComp->pNext))->groupPriority = pSECComponent->compPriority.nGroupPriority;
+    pNewComp = (SEC_OMX_RM_COMPONENT_LIST *)SEC_OSAL_PoolAlloc(&gVideoRMListPool);
+    if (pNewComp == NULL) {
+        ret = OMX_ErrorInsufficientResources;
         goto EXIT;
+    }
+    pNewComp->pOMXStandComp = pOMXComponent;
+    pNewComp->groupPriority = pSECComponent->compPriority.nGroupPriority;
+    pNewComp->nFrameMB = getFrameMB(pSECComponent);
+
+    /* a higher nGroupPriority value is a lower priority */
+    if (bLowPriorityFirst == OMX_TRUE) {
+        while ((*ppInsert != NULL) && ((*ppInsert)->groupPriority > pNewComp->groupPriority))
+            ppInsert = &(*ppInsert)->pNext;
     } else {
-        *ppList = (SEC_OMX_RM_COMPONENT_LIST *)SEC_OSAL_Malloc(sizeof(SEC_OMX_RM_COMPONENT_LIST));
-        if (*ppList == NULL) {
-            ret = OMX_ErrorInsufficientResources;
-            goto EXIT;
-        }
-        pTempComp = *ppList;
-        pTempComp->pNext = NULL;
-        pTempComp->pOMXStandComp = pOMXComponent;
-        pTempComp->groupPriority = pSECComponent->compPriority.nGroupPriority;
+        while ((*ppInsert != NULL) && ((*ppInsert)->groupPriority <= pNewComp->groupPriority))
+            ppInsert = &(*ppInsert)->pNext;
     }
+    pNewComp->pNext = *ppInsert;
+    *ppInsert = pNewComp;
 
 EXIT:
     return ret;
 }
 
-OMX_ERRORTYPE removeElementList(SEC_OMX_RM_COMPONENT_LIST **ppList, OMX_COMPONENTTYPE *pOMXComponent)
+OMX_ERRORTYPE removeElementList(SEC_OMX_RM_COMPONENT_LIST **ppList, OMX_COMPONENTTYPE *pOMXComponent, OMX_U32 *pFrameMB)
 {
     OMX_ERRORTYPE              ret = OMX_ErrorNone;
     SEC_OMX_RM_COMPONENT_LIST *pCurrComp = NULL;
@@ -97,13 +193,13 @@ OMX_ERRORTYPE removeElementList(SEC_OMX_RM_COMPONENT_LIST **ppList, OMX_COMPONEN
     pCurrComp = *ppList;
     while (pCurrComp != NULL) {
         if (pCurrComp->pOMXStandComp == pOMXComponent) {
-            if (*ppList == pCurrComp) {
+            if (*ppList == pCurrComp)
                 *ppList = pCurrComp->pNext;
-                SEC_OSAL_Free(pCurrComp);
-            } else {
+            else
                 pPrevComp->pNext = pCurrComp->pNext;
-                SEC_OSAL_Free(pCurrComp);
-            }
+            if (pFrameMB != NULL)
+                *pFrameMB = pCurrComp->nFrameMB;
+            SEC_OSAL_PoolFree(&gVideoRMListPool, pCurrComp);
             bDetectComp = OMX_TRUE;
             break;
         } else {
@@ -121,39 +217,28 @@ EXIT:
     return ret;
 }
 
-int searchLowPriority(SEC_OMX_RM_COMPONENT_LIST *RMComp_list, int inComp_priority, SEC_OMX_RM_COMPONENT_LIST **outLowComp)
+/*
+ * Counts the sessions at the head of the component list, all of a lower
+ * priority than inComp_priority, that have to go for nFrameMB more to fit.
+ * Returns 0 when preempting all of them would still not be enough.
+ */
+int searchLowPriority(SEC_OMX_RM_COMPONENT_LIST *RMComp_list, OMX_U32 inComp_priority, OMX_U32 nFrameMB)
 {
-    int ret = 0;
-    SEC_OMX_RM_COMPONENT_LIST *pTempComp = NULL;
-    SEC_OMX_RM_COMPONENT_LIST *pCandidateComp = NULL;
-
-    if (RMComp_list == NULL)
-        ret = -1;
-
-    pTempComp = RMComp_list;
-    *outLowComp = 0;
-
-    while (pTempComp != NULL) {
-        if (pTempComp->groupPriority > inComp_priority) {
-            if (pCandidateComp != NULL) {
-                if (pCandidateComp->groupPriority < pTempComp->groupPriority)
-                    pCandidateComp = pTempComp;
-            } else {
-                pCandidateComp = pTempComp;
-            }
-        }
-
+    SEC_OMX_RM_COMPONENT_LIST *pTempComp = RMComp_list;
+    OMX_U32 nComponentNum = gnVideoRMComponentNum;
+    OMX_U32 nUsedMB = gnVideoRMUsedMB;
+    int numVictim = 0;
+
+    while ((nComponentNum >= MAX_RESOURCE_VIDEO) || (nUsedMB + nFrameMB > MAX_RESOURCE_VIDEO_MB)) {
+        if ((pTempComp == NULL) || (pTempComp->groupPriority <= inComp_priority))
+            return 0;
+        nComponentNum--;
+        nUsedMB -= pTempComp->nFrameMB;
+        numVictim++;
         pTempComp = pTempComp->pNext;
     }
 
-    *outLowComp = pCandidateComp;
-    if (pCandidateComp == NULL)
-        ret = 0;
-    else
-        ret = 1;
-
-EXIT:
-    return ret;
+    return numVictim;
 }
 
 OMX_ERRORTYPE removeComponent(OMX_COMPONENTTYPE *pOMXComponent)
@@ -172,7 +257,15 @@ OMX_ERRORTYPE removeComponent(OMX_COMPONENTTYPE *pOMXComponent)
             goto EXIT;
         }
     } else if ((pSECComponent->currentState == OMX_StateExecuting) || (pSECComponent->currentState == OMX_StatePause)) {
-        /* Todo */
+        /* the client takes a preempted component on from Idle to Loaded */
+        (*(pSECComponent->pCallbacks->EventHandler))
+            (pOMXComponent, pSECComponent->callbackData,
+            OMX_EventError, OMX_ErrorResourcesPreempted, 0, NULL);
+        ret = OMX_SendCommand(pOMXComponent, OMX_CommandStateSet, OMX_StateIdle, NULL);
+        if (ret != OMX_ErrorNone) {
+            ret = OMX_ErrorUndefined;
+            goto EXIT;
+        }
     }
 
     ret = OMX_ErrorNone;
@@ -186,6 +279,8 @@ OMX_ERRORTYPE SEC_OMX_ResourceManager_Init()
 {
     FunctionIn();
     SEC_OSAL_MutexCreate(&ghVideoRMComponentListMutex);
+    SEC_OSAL_MutexCreate(&ghVideoRMRunMutex);
+    SEC_OSAL_PoolCreate(&gVideoRMListPool, sizeof(SEC_OMX_RM_COMPONENT_LIST), MAX_RESOURCE_VIDEO * 2);
     FunctionOut();
     return OMX_ErrorNone;
 }
@@ -204,17 +299,19 @@ OMX_ERRORTYPE SEC_OMX_ResourceManager_Deinit()
         pCurrComponent = gpVideoRMComponentList;
         while (pCurrComponent != NULL) {
             pNextComponent = pCurrComponent->pNext;
-            SEC_OSAL_Free(pCurrComponent);
+            SEC_OSAL_PoolFree(&gVideoRMListPool, pCurrComponent);
             pCurrComponent = pNextComponent;
         }
         gpVideoRMComponentList = NULL;
     }
+    gnVideoRMComponentNum = 0;
+    gnVideoRMUsedMB = 0;
 
     if (gpVideoRMWaitingList) {
         pCurrComponent = gpVideoRMWaitingList;
         while (pCurrComponent != NULL) {
             pNextComponent = pCurrComponent->pNext;
-            SEC_OSAL_Free(pCurrComponent);
+            SEC_OSAL_PoolFree(&gVideoRMListPool, pCurrComponent);
             pCurrComponent = pNextComponent;
         }
         gpVideoRMWaitingList = NULL;
@@ -224,6 +321,13 @@ OMX_ERRORTYPE SEC_OMX_ResourceManager_Deinit()
     SEC_OSAL_MutexTerminate(ghVideoRMComponentListMutex);
     ghVideoRMComponentListMutex = NULL;
 
+    /* no component is left to run */
+    SEC_OSAL_MutexTerminate(ghVideoRMRunMutex);
+    ghVideoRMRunMutex = NULL;
+    gbVideoRMRunning = OMX_FALSE;
+    gpVideoRMRunWaiting = NULL;
+    SEC_OSAL_PoolTerminate(&gVideoRMListPool);
+
     ret = OMX_ErrorNone;
 EXIT:
     FunctionOut();
@@ -235,52 +339,56 @@ OMX_ERRORTYPE SEC_OMX_Get_Resource(OMX_COMPONENTTYPE *pOMXComponent)
 {
     OMX_ERRORTYPE              ret = OMX_ErrorNone;
     SEC_OMX_BASECOMPONENT     *pSECComponent = NULL;
-    SEC_OMX_RM_COMPONENT_LIST *pComponentTemp = NULL;
     SEC_OMX_RM_COMPONENT_LIST *pComponentCandidate = NULL;
-    int numElem = 0;
-    int lowCompDetect = 0;
+    OMX_U32 nFrameMB = 0;
+    int numVictim = 0;
 
     FunctionIn();
 
     SEC_OSAL_MutexLock(ghVideoRMComponentListMutex);
 
     pSECComponent = (SEC_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
-    pComponentTemp = gpVideoRMComponentList;
     if (pSECComponent->codecType == HW_VIDEO_CODEC) {
-        if (pComponentTemp != NULL) {
-            while (pComponentTemp) {
-                numElem++;
-                pComponentTemp = pComponentTemp->pNext;
-            }
-        } else {
-            numElem = 0;
+        nFrameMB = getFrameMB(pSECComponent);
+        numVictim = searchLowPriority(gpVideoRMComponentList, pSECComponent->compPriority.nGroupPriority, nFrameMB);
+        if ((numVictim <= 0) &&
+            ((gnVideoRMComponentNum >= MAX_RESOURCE_VIDEO) || (gnVideoRMUsedMB + nFrameMB > MAX_RESOURCE_VIDEO_MB))) {
+            SEC_OSAL_Log(SEC_LOG_ERROR, "no MFC resource for %d MBs, %d sessions with %d MBs open",
+                         nFrameMB, gnVideoRMComponentNum, gnVideoRMUsedMB);
+            ret = OMX_ErrorInsufficientResources;
+            goto EXIT;
         }
-        if (numElem >= MAX_RESOURCE_VIDEO) {
-            lowCompDetect = searchLowPriority(gpVideoRMComponentList, pSECComponent->compPriority.nGroupPriority, &pComponentCandidate);
-            if (lowCompDetect <= 0) {
-                ret = OMX_ErrorInsufficientResources;
-                goto EXIT;
-            } else {
-                ret = removeComponent(pComponentCandidate->pOMXStandComp);
-                if (ret != OMX_ErrorNone) {
-                    ret = OMX_ErrorInsufficientResources;
-                    goto EXIT;
-                } else {
-                    ret = removeElementList(&gpVideoRMComponentList, pComponentCandidate->pOMXStandComp);
-                    ret = addElementList(&gpVideoRMComponentList, pOMXComponent);
-                    if (ret != OMX_ErrorNone) {
-                        ret = OMX_ErrorInsufficientResources;
-                        goto EXIT;
-                    }
-                }
-            }
-        } else {
-            ret = addElementList(&gpVideoRMComponentList, pOMXComponent);
+
+        while (numVictim-- > 0) {
+            pComponentCandidate = gpVideoRMComponentList;
+            ret = removeComponent(pComponentCandidate->pOMXStandComp);
             if (ret != OMX_ErrorNone) {
                 ret = OMX_ErrorInsufficientResources;
                 goto EXIT;
             }
+            SEC_OSAL_Log(SEC_LOG_TRACE, "preempted priority %d for priority %d",
+                         pComponentCandidate->groupPriority, pSECComponent->compPriority.nGroupPriority);
+            gpVideoRMComponentList = pComponentCandidate->pNext;
+            gnVideoRMComponentNum--;
+            gnVideoRMUsedMB -= pComponentCandidate->nFrameMB;
+            SEC_OSAL_PoolFree(&gVideoRMListPool, pComponentCandidate);
         }
+
+        ret = addElementList(&gpVideoRMComponentList, pOMXComponent, OMX_TRUE);
+        if (ret != OMX_ErrorNone) {
+            ret = OMX_ErrorInsufficientResources;
+            goto EXIT;
+        }
+        gnVideoRMComponentNum++;
+        gnVideoRMUsedMB += nFrameMB;
+
+        /* the run loop isn't going yet, the session is the caller's alone */
+        pSECComponent->mfcSession.periodUs = getFramePeriodUs(pSECComponent);
+        pSECComponent->mfcSession.deadlineUs = 0;
+        pSECComponent->mfcSession.nRuns = 0;
+        pSECComponent->mfcSession.nLate = 0;
+        pSECComponent->mfcSession.runUs = 0;
+        pSECComponent->mfcSession.waitUs = 0;
     }
     ret = OMX_ErrorNone;
 
@@ -299,32 +407,47 @@ OMX_ERRORTYPE SEC_OMX_Release_Resource(OMX_COMPONENTTYPE *pOMXComponent)
     SEC_OMX_BASECOMPONENT     *pSECComponent = NULL;
     SEC_OMX_RM_COMPONENT_LIST *pComponentTemp = NULL;
     OMX_COMPONENTTYPE         *pOMXWaitComponent = NULL;
-    int numElem = 0;
+    OMX_U32 nFrameMB = 0;
 
     FunctionIn();
 
     SEC_OSAL_MutexLock(ghVideoRMComponentListMutex);
 
     pSECComponent = (SEC_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
-    pComponentTemp = gpVideoRMWaitingList;
     if (pSECComponent->codecType == HW_VIDEO_CODEC) {
         if (gpVideoRMComponentList == NULL) {
             ret = OMX_ErrorUndefined;
             goto EXIT;
         }
 
-        ret = removeElementList(&gpVideoRMComponentList, pOMXComponent);
+        /* a preempted component handed its resource over already */
+        ret = removeElementList(&gpVideoRMComponentList, pOMXComponent, &nFrameMB);
         if (ret != OMX_ErrorNone) {
             ret = OMX_ErrorUndefined;
             goto EXIT;
         }
-        while (pComponentTemp) {
-            numElem++;
-            pComponentTemp = pComponentTemp->pNext;
-        }
-        if (numElem > 0) {
-            pOMXWaitComponent = gpVideoRMWaitingList->pOMXStandComp;
-            removeElementList(&gpVideoRMWaitingList, pOMXWaitComponent);
+        gnVideoRMComponentNum--;
+        gnVideoRMUsedMB -= nFrameMB;
+
+        SEC_OSAL_Log(SEC_LOG_TRACE, "MFC session: %d runs, %d late, run %lld us, wait %lld us",
+                     pSECComponent->mfcSession.nRuns, pSECComponent->mfcSession.nLate,
+                     (long long)pSECComponent->mfcSession.runUs, (long long)pSECComponent->mfcSession.waitUs);
+
+        /* the resource goes to the highest priority waiter when it fits */
+        pComponentTemp = gpVideoRMWaitingList;
+        if ((pComponentTemp != NULL) &&
+            (gnVideoRMUsedMB + pComponentTemp->nFrameMB <= MAX_RESOURCE_VIDEO_MB)) {
+            gpVideoRMWaitingList = pComponentTemp->pNext;
+            pOMXWaitComponent = pComponentTemp->pOMXStandComp;
+            pComponentTemp->pNext = NULL;
+            SEC_OSAL_PoolFree(&gVideoRMListPool, pComponentTemp);
+
+            ret = addElementList(&gpVideoRMComponentList, pOMXWaitComponent, OMX_TRUE);
+            if (ret != OMX_ErrorNone)
+                goto EXIT;
+            gnVideoRMComponentNum++;
+            gnVideoRMUsedMB += getFrameMB((SEC_OMX_BASECOMPONENT *)pOMXWaitComponent->pComponentPrivate);
+
             ret = OMX_SendCommand(pOMXWaitComponent, OMX_CommandStateSet, OMX_StateIdle, NULL);
             if (ret != OMX_ErrorNone) {
                 goto EXIT;
@@ -352,7 +475,7 @@ OMX_ERRORTYPE SEC_OMX_In_WaitForResource(OMX_COMPONENTTYPE *pOMXComponent)
 
     pSECComponent = (SEC_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
     if (pSECComponent->codecType == HW_VIDEO_CODEC)
-        ret = addElementList(&gpVideoRMWaitingList, pOMXComponent);
+        ret = addElementList(&gpVideoRMWaitingList, pOMXComponent, OMX_FALSE);
 
     SEC_OSAL_MutexUnlock(ghVideoRMComponentListMutex);
 
@@ -372,12 +495,121 @@ OMX_ERRORTYPE SEC_OMX_Out_WaitForResource(OMX_COMPONENTTYPE *pOMXComponent)
 
     pSECComponent = (SEC_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
     if (pSECComponent->codecType == HW_VIDEO_CODEC)
-        ret = removeElementList(&gpVideoRMWaitingList, pOMXComponent);
+        ret = removeElementList(&gpVideoRMWaitingList, pOMXComponent, NULL);
+
+    SEC_OSAL_MutexUnlock(ghVideoRMComponentListMutex);
 
+    FunctionOut();
+
+    return ret;
+}
+
+OMX_ERRORTYPE SEC_OMX_Get_ResourceCapacity(SEC_OMX_CONFIG_MFC_CAPACITY *pCapacity)
+{
+    OMX_ERRORTYPE ret = OMX_ErrorNone;
+
+    FunctionIn();
+
+    if (pCapacity == NULL) {
+        ret = OMX_ErrorBadParameter;
+        goto EXIT;
+    }
+
+    SEC_OSAL_MutexLock(ghVideoRMComponentListMutex);
+    pCapacity->nFreeSessions = MAX_RESOURCE_VIDEO - gnVideoRMComponentNum;
+    pCapacity->nFreeMB = MAX_RESOURCE_VIDEO_MB - gnVideoRMUsedMB;
     SEC_OSAL_MutexUnlock(ghVideoRMComponentListMutex);
 
+    SEC_OSAL_MutexLock(ghVideoRMRunMutex);
+    updateLoad(getTimeUs());
+    pCapacity->nLoad = gnVideoRMLoad;
+    SEC_OSAL_MutexUnlock(ghVideoRMRunMutex);
+
+EXIT:
     FunctionOut();
 
     return ret;
 }
 
+OMX_ERRORTYPE SEC_OMX_MFC_SessionCreate(SEC_OMX_RM_MFC_SESSION *pSession)
+{
+    SEC_OSAL_Memset(pSession, 0, sizeof(SEC_OMX_RM_MFC_SESSION));
+    pSession->bWaiting = OMX_FALSE;
+    pSession->periodUs = MFC_SESSION_PERIOD_US;
+
+    return SEC_OSAL_SemaphoreCreate(&pSession->hTurn);
+}
+
+void SEC_OMX_MFC_SessionTerminate(SEC_OMX_RM_MFC_SESSION *pSession)
+{
+    if (pSession->hTurn != NULL)
+        SEC_OSAL_SemaphoreTerminate(pSession->hTurn);
+    pSession->hTurn = NULL;
+}
+
+void SEC_OMX_MFC_RunBegin(SEC_OMX_RM_MFC_SESSION *pSession)
+{
+    OMX_S64  nowUs = getTimeUs();
+    OMX_BOOL bWait = OMX_FALSE;
+
+    SEC_OSAL_MutexLock(ghVideoRMRunMutex);
+
+    pSession->askUs = nowUs;
+    if (pSession->deadlineUs < nowUs)
+        pSession->deadlineUs = nowUs;
+    pSession->deadlineUs += pSession->periodUs;
+
+    if (gbVideoRMRunning == OMX_TRUE) {
+        pSession->bWaiting = OMX_TRUE;
+        pSession->pNext = gpVideoRMRunWaiting;
+        gpVideoRMRunWaiting = pSession;
+        bWait = OMX_TRUE;
+    } else {
+        gbVideoRMRunning = OMX_TRUE;
+    }
+
+    SEC_OSAL_MutexUnlock(ghVideoRMRunMutex);
+
+    /* the run before hands the hardware over */
+    if (bWait == OMX_TRUE)
+        SEC_OSAL_SemaphoreWait(pSession->hTurn);
+
+    pSession->startUs = getTimeUs();
+    pSession->waitUs += pSession->startUs - pSession->askUs;
+}
+
+void SEC_OMX_MFC_RunEnd(SEC_OMX_RM_MFC_SESSION *pSession)
+{
+    SEC_OMX_RM_MFC_SESSION **ppNext = NULL;
+    SEC_OMX_RM_MFC_SESSION **ppCurr = NULL;
+    SEC_OMX_RM_MFC_SESSION  *pNext = NULL;
+    OMX_S64 nowUs = getTimeUs();
+
+    SEC_OSAL_MutexLock(ghVideoRMRunMutex);
+
+    pSession->nRuns++;
+    pSession->runUs += nowUs - pSession->startUs;
+    if (nowUs > pSession->deadlineUs)
+        pSession->nLate++;
+
+    updateLoad(nowUs);
+    gVideoRMBusyUs += nowUs - pSession->startUs;
+
+    for (ppCurr = &gpVideoRMRunWaiting; *ppCurr != NULL; ppCurr = &(*ppCurr)->pNext) {
+        if ((ppNext == NULL) || ((*ppCurr)->deadlineUs < (*ppNext)->deadlineUs))
+            ppNext = ppCurr;
+    }
+
+    if (ppNext != NULL) {
+        pNext = *ppNext;
+        *ppNext = pNext->pNext;
+        pNext->pNext = NULL;
+        pNext->bWaiting = OMX_FALSE;
+        /* the hardware stays taken, it goes to pNext */
+        SEC_OSAL_SemaphorePost(pNext->hTurn);
+    } else {
+        gbVideoRMRunning = OMX_FALSE;
+    }
+
+    SEC_OSAL_MutexUnlock(ghVideoRMRunMutex);
+}
@@ -32,14 +32,38 @@
 #include "OMX_Component.h"
 
 
-struct SEC_OMX_RM_COMPONENT_LIST;
 typedef struct _SEC_OMX_RM_COMPONENT_LIST
 {
     OMX_COMPONENTTYPE         *pOMXStandComp;
     OMX_U32                    groupPriority;
-    struct SEC_OMX_RM_COMPONENT_LIST *pNext;
+    OMX_U32                    nFrameMB;
+    struct _SEC_OMX_RM_COMPONENT_LIST *pNext;
 } SEC_OMX_RM_COMPONENT_LIST;
 
+/*
+ * The turns of one MFC context on the hardware. The open sessions run one
+ * frame at a time, the waiting run with the earliest deadline goes next.
+ * A run is due one frame interval after it was asked for, or after the
+ * deadline of the session's run before when that is later, so a session
+ * pushing frames faster than its rate falls behind the others instead of
+ * starving them.
+ */
+typedef struct _SEC_OMX_RM_MFC_SESSION
+{
+    OMX_HANDLETYPE  hTurn;          /* posted when a waiting run may start */
+    OMX_BOOL        bWaiting;
+    OMX_S64         periodUs;       /* frame interval of the session */
+    OMX_S64         deadlineUs;     /* of the current or the last run */
+    OMX_S64         askUs;          /* when the current run was asked for */
+    OMX_S64         startUs;
+    /* since the session got its resource */
+    OMX_U32         nRuns;
+    OMX_U32         nLate;          /* runs done after their deadline */
+    OMX_U64         runUs;
+    OMX_U64         waitUs;
+    struct _SEC_OMX_RM_MFC_SESSION *pNext;
+} SEC_OMX_RM_MFC_SESSION;
+
 
 #ifdef __cplusplus
 extern "C" {
@@ -51,6 +75,13 @@ OMX_ERRORTYPE SEC_OMX_Get_Resource(OMX_COMPONENTTYPE *pOMXComponent);
 OMX_ERRORTYPE SEC_OMX_Release_Resource(OMX_COMPONENTTYPE *pOMXComponent);
 OMX_ERRORTYPE SEC_OMX_In_WaitForResource(OMX_COMPONENTTYPE *pOMXComponent);
 OMX_ERRORTYPE SEC_OMX_Out_WaitForResource(OMX_COMPONENTTYPE *pOMXComponent);
+OMX_ERRORTYPE SEC_OMX_Get_ResourceCapacity(SEC_OMX_CONFIG_MFC_CAPACITY *pCapacity);
+
+OMX_ERRORTYPE SEC_OMX_MFC_SessionCreate(SEC_OMX_RM_MFC_SESSION *pSession);
+void          SEC_OMX_MFC_SessionTerminate(SEC_OMX_RM_MFC_SESSION *pSession);
+/* around every SsbSipMfc*Exe of the session, from one thread at a time */
+void          SEC_OMX_MFC_RunBegin(SEC_OMX_RM_MFC_SESSION *pSession);
+void          SEC_OMX_MFC_RunEnd(SEC_OMX_RM_MFC_SESSION *pSession);
 
 #ifdef __cplusplus
 };
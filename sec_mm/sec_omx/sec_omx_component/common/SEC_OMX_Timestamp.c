@@ -0,0 +1,159 @@
+/*
+ *
+ * Copyright 2010 Samsung Electronics S.LSI Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * @file       SEC_OMX_Timestamp.c
+ * @brief      timestamps and flags of the frames inside the MFC, by frame tag
+ * @version    1.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "SEC_OSAL_Memory.h"
+#include "SEC_OMX_Timestamp.h"
+
+#undef  SEC_LOG_TAG
+#define SEC_LOG_TAG    "SEC_TIMESTAMP"
+#define SEC_LOG_OFF
+#include "SEC_OSAL_Log.h"
+
+
+void SEC_OMX_TimestampMapReset(SEC_OMX_TIMESTAMP_MAP *pMap)
+{
+    OMX_U32 i;
+
+    for (i = 0; i < SEC_TIMESTAMP_MAP_MAX; i++) {
+        pMap->entry[i].tag       = -1;
+        pMap->entry[i].timeStamp = 0;
+        pMap->entry[i].nFlags    = 0;
+    }
+    if ((pMap->nDepth == 0) || (pMap->nDepth > SEC_TIMESTAMP_MAP_MAX))
+        pMap->nDepth = SEC_TIMESTAMP_MAP_DEFAULT_DEPTH;
+    pMap->nextTag       = 0;
+    pMap->bLastValid    = OMX_FALSE;
+    pMap->lastTimeStamp = 0;
+    pMap->frameDuration = 0;
+}
+
+void SEC_OMX_TimestampMapSetDepth(SEC_OMX_TIMESTAMP_MAP *pMap, OMX_U32 nDepth)
+{
+    SEC_OMX_TIMESTAMP_ENTRY old[SEC_TIMESTAMP_MAP_MAX];
+    OMX_U32 i;
+
+    if (nDepth > SEC_TIMESTAMP_MAP_MAX) {
+        SEC_OSAL_Log(SEC_LOG_WARNING, "%d frames in flight, only %d tracked", nDepth, SEC_TIMESTAMP_MAP_MAX);
+        nDepth = SEC_TIMESTAMP_MAP_MAX;
+    }
+    if ((nDepth == 0) || (nDepth == pMap->nDepth))
+        return;
+
+    /* a handful of frames at most, moved to their slots for the new depth */
+    SEC_OSAL_Memcpy(old, pMap->entry, sizeof(old));
+    for (i = 0; i < SEC_TIMESTAMP_MAP_MAX; i++)
+        pMap->entry[i].tag = -1;
+    pMap->nDepth = nDepth;
+    for (i = 0; i < SEC_TIMESTAMP_MAP_MAX; i++) {
+        if (old[i].tag >= 0)
+            pMap->entry[old[i].tag % nDepth] = old[i];
+    }
+    SEC_OSAL_Log(SEC_LOG_TRACE, "timestamp map depth %d", nDepth);
+}
+
+OMX_S32 SEC_OMX_TimestampMapPut(SEC_OMX_TIMESTAMP_MAP *pMap, OMX_TICKS timeStamp, OMX_U32 nFlags)
+{
+    OMX_S32                  tag = pMap->nextTag;
+    SEC_OMX_TIMESTAMP_ENTRY *pEntry = &pMap->entry[tag % pMap->nDepth];
+
+    if (pEntry->tag >= 0) {
+        /* the frame before never came out, or the pipeline is deeper than the map */
+        pMap->nOverwritten++;
+        SEC_OSAL_Log(SEC_LOG_TRACE, "tag %d written over by %d (%d so far)", pEntry->tag, tag, pMap->nOverwritten);
+    }
+
+    pEntry->tag       = tag;
+    pEntry->timeStamp = timeStamp;
+    pEntry->nFlags    = nFlags;
+
+    pMap->nextTag = (tag == 0x7FFFFFFF) ? 0 : (tag + 1);
+
+    return tag;
+}
+
+OMX_BOOL SEC_OMX_TimestampMapGet(SEC_OMX_TIMESTAMP_MAP *pMap, OMX_S32 tag, OMX_TICKS *pTimeStamp, OMX_U32 *pFlags)
+{
+    SEC_OMX_TIMESTAMP_ENTRY *pEntry = NULL;
+    OMX_TICKS                timeStamp = 0;
+    OMX_TICKS                delta = 0;
+    OMX_BOOL                 bFound = OMX_FALSE;
+
+    if (tag >= 0) {
+        pEntry = &pMap->entry[tag % pMap->nDepth];
+        if (pEntry->tag == tag) {
+            timeStamp = pEntry->timeStamp;
+            *pFlags   = pEntry->nFlags;
+            pEntry->tag = -1;
+            bFound = OMX_TRUE;
+        }
+    }
+
+    if (pMap->bLastValid == OMX_FALSE) {
+        if (bFound == OMX_FALSE)
+            return OMX_FALSE;
+        goto EXIT;
+    }
+
+    if (bFound == OMX_FALSE) {
+        if (pMap->frameDuration == 0)
+            return OMX_FALSE;
+        /* the MFC lost the tag, the picture still comes a frame after the last */
+        timeStamp = pMap->lastTimeStamp + pMap->frameDuration;
+        *pFlags   = 0;
+        pMap->nRepaired++;
+        SEC_OSAL_Log(SEC_LOG_TRACE, "tag %d not found, %lld us made up", tag, timeStamp);
+        goto EXIT;
+    }
+
+    delta = timeStamp - pMap->lastTimeStamp;
+    if (delta <= 0) {
+        /* out of order, a mismatched entry rather than a real step back */
+        if (pMap->frameDuration != 0) {
+            SEC_OSAL_Log(SEC_LOG_TRACE, "%lld us after %lld us, %lld us used", timeStamp, pMap->lastTimeStamp,
+                         pMap->lastTimeStamp + pMap->frameDuration);
+            timeStamp = pMap->lastTimeStamp + pMap->frameDuration;
+            pMap->nRepaired++;
+        }
+    } else if ((pMap->frameDuration != 0) &&
+               (delta > pMap->frameDuration * SEC_TIMESTAMP_JUMP_FRAMES) &&
+               (delta > SEC_TIMESTAMP_JUMP_MIN)) {
+        /* a new segment of the stream, taken as it is */
+        SEC_OSAL_Log(SEC_LOG_TRACE, "discontinuity, %lld us to %lld us", pMap->lastTimeStamp, timeStamp);
+    } else if (pMap->frameDuration == 0) {
+        pMap->frameDuration = delta;
+    } else {
+        /* follows frame rate changes slowly, single odd gaps hardly move it */
+        pMap->frameDuration = (pMap->frameDuration * 7 + delta) / 8;
+    }
+
+EXIT:
+    pMap->bLastValid    = OMX_TRUE;
+    pMap->lastTimeStamp = timeStamp;
+    *pTimeStamp = timeStamp;
+
+    return OMX_TRUE;
+}
@@ -0,0 +1,83 @@
+/*
+ *
+ * Copyright 2010 Samsung Electronics S.LSI Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * @file       SEC_OMX_Timestamp.h
+ * @brief      timestamps and flags of the frames inside the MFC, by frame tag
+ * @version    1.0
+ */
+
+#ifndef SEC_OMX_TIMESTAMP_H
+#define SEC_OMX_TIMESTAMP_H
+
+#include "OMX_Types.h"
+#include "OMX_Core.h"
+
+
+/* the deepest pipeline: a 16 frame H.264 DPB, the extra MFC buffers and the queued jobs */
+#define SEC_TIMESTAMP_MAP_MAX           32
+/* until a codec knows better, the depth of the array this replaced */
+#define SEC_TIMESTAMP_MAP_DEFAULT_DEPTH 17
+/* a jump forward of more than this many frames, and a second at least, is a new segment */
+#define SEC_TIMESTAMP_JUMP_FRAMES       8
+#define SEC_TIMESTAMP_JUMP_MIN          1000000
+
+typedef struct _SEC_OMX_TIMESTAMP_ENTRY
+{
+    OMX_S32   tag;                  /* -1 when free */
+    OMX_TICKS timeStamp;
+    OMX_U32   nFlags;
+} SEC_OMX_TIMESTAMP_ENTRY;
+
+typedef struct _SEC_OMX_TIMESTAMP_MAP
+{
+    /* a tag lives at tag % nDepth until it comes out or is written over */
+    SEC_OMX_TIMESTAMP_ENTRY entry[SEC_TIMESTAMP_MAP_MAX];
+    OMX_U32                 nDepth;
+    OMX_S32                 nextTag;
+
+    /* the pictures out so far, for the discontinuity checks */
+    OMX_BOOL                bLastValid;
+    OMX_TICKS               lastTimeStamp;
+    OMX_TICKS               frameDuration;
+    OMX_U32                 nOverwritten;
+    OMX_U32                 nRepaired;
+} SEC_OMX_TIMESTAMP_MAP;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* empties the map, on every flush of the input port */
+void SEC_OMX_TimestampMapReset(SEC_OMX_TIMESTAMP_MAP *pMap);
+/* room for nDepth frames in flight, the tags already in the map are kept */
+void SEC_OMX_TimestampMapSetDepth(SEC_OMX_TIMESTAMP_MAP *pMap, OMX_U32 nDepth);
+/* the tag to hand the MFC with the frame */
+OMX_S32 SEC_OMX_TimestampMapPut(SEC_OMX_TIMESTAMP_MAP *pMap, OMX_TICKS timeStamp, OMX_U32 nFlags);
+/*
+ * Takes the entry of a tag the MFC gave back. Pictures are expected in
+ * presentation order: a lost entry or one going backwards is replaced by
+ * the last timestamp plus a frame. OMX_FALSE when there is nothing to go
+ * by and the caller has to pick a timestamp itself.
+ */
+OMX_BOOL SEC_OMX_TimestampMapGet(SEC_OMX_TIMESTAMP_MAP *pMap, OMX_S32 tag, OMX_TICKS *pTimeStamp, OMX_U32 *pFlags);
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif
@@ -0,0 +1,267 @@
+/*
+ *
+ * Copyright 2010 Samsung Electronics S.LSI Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * @file       SEC_OMX_Trace.c
+ * @brief      per buffer latency tracing of the components
+ * @version    1.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define ATRACE_TAG ATRACE_TAG_VIDEO
+#include <cutils/atomic.h>
+#include <cutils/properties.h>
+#include <sec_trace.h>
+#include <sec_latency.h>
+
+#include "SEC_OSAL_Memory.h"
+#include "SEC_OMX_Trace.h"
+
+#undef  SEC_LOG_TAG
+#define SEC_LOG_TAG    "SEC_TRACE"
+#include "SEC_OSAL_Log.h"
+
+
+static const char *gTraceEventName[SEC_OMX_TRACE_EVENT_NUM] = {
+    "omx:etb-ebd",
+    "omx:ftb-fbd",
+    "omx:mfc_run",
+    "omx:seek-frame",
+    "omx:capture-in",
+    "omx:capture-out",
+};
+
+/* the OMX timestamps of a recording move by more than that when it restarts */
+#define CAPTURE_BASE_REPUBLISH_US   (1000)
+
+static OMX_S64 getTimeUs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((OMX_S64)ts.tv_sec * 1000000) + (ts.tv_nsec / 1000);
+}
+
+static void addRecord(SEC_OMX_TRACE *pTrace, OMX_U32 event, OMX_U32 nIndex, OMX_S64 startUs, OMX_S64 endUs)
+{
+    SEC_OMX_TRACE_RECORD *pRecord = NULL;
+    OMX_U32 latencyUs = (OMX_U32)(endUs - startUs);
+    OMX_U32 latencyMs = latencyUs / 1000;
+    int     bucket = 0;
+
+    pRecord = &pTrace->record[(OMX_U32)android_atomic_inc(&pTrace->nRecord) % SEC_OMX_TRACE_RECORD_NUM];
+    pRecord->event = event;
+    pRecord->nIndex = nIndex;
+    pRecord->startUs = startUs;
+    pRecord->latencyUs = latencyUs;
+
+    while ((bucket < SEC_OMX_TRACE_HIST_NUM - 1) && (latencyMs >= (1U << bucket)))
+        bucket++;
+    pTrace->histogram[event][bucket]++;
+    pTrace->totalUs[event] += latencyUs;
+    if (latencyUs > pTrace->maxUs[event])
+        pTrace->maxUs[event] = latencyUs;
+}
+
+void SEC_OMX_TraceInit(SEC_OMX_TRACE *pTrace)
+{
+    char value[PROPERTY_VALUE_MAX];
+
+    SEC_OSAL_Memset(pTrace, 0, sizeof(SEC_OMX_TRACE));
+    property_get(SEC_OMX_TRACE_PROPERTY, value, "0");
+    pTrace->bEnabled = (atoi(value) != 0) ? OMX_TRUE : OMX_FALSE;
+    pTrace->bLatency = sec_latency_enabled() ? OMX_TRUE : OMX_FALSE;
+}
+
+/* the capture time of a buffer timestamp, 0 when not known */
+static OMX_S64 getCaptureUs(SEC_OMX_TRACE *pTrace, OMX_TICKS timeStamp)
+{
+    /* a decoder takes the base of the encoder that made the stream */
+    if (pTrace->publishedBaseUs == 0)
+        pTrace->captureBaseUs = sec_latency_base_get();
+    if (pTrace->captureBaseUs == 0)
+        return 0;
+
+    return pTrace->captureBaseUs + timeStamp;
+}
+
+void SEC_OMX_TraceBufferStart(SEC_OMX_TRACE *pTrace, OMX_U32 nPortIndex, OMX_U32 nIndex)
+{
+    if ((pTrace->bEnabled == OMX_FALSE) || (nIndex >= MAX_BUFFER_NUM))
+        return;
+
+    pTrace->startUs[nPortIndex][nIndex] = getTimeUs();
+    SEC_TRACE_ASYNC_BEGIN(gTraceEventName[nPortIndex], (nPortIndex << 16) | nIndex);
+}
+
+void SEC_OMX_TraceBufferDone(SEC_OMX_TRACE *pTrace, SEC_OMX_BASEPORT *pSECPort, OMX_U32 nPortIndex, OMX_BUFFERHEADERTYPE *pBuffer)
+{
+    OMX_S64 captureUs = 0;
+    OMX_S64 nowUs = 0;
+    OMX_U32 i = 0;
+
+    if ((pTrace->bLatency == OMX_TRUE) && (nPortIndex == OUTPUT_PORT_INDEX) && (pBuffer->nFilledLen > 0) &&
+        !(pBuffer->nFlags & OMX_BUFFERFLAG_CODECCONFIG)) {
+        captureUs = getCaptureUs(pTrace, pBuffer->nTimeStamp);
+        nowUs = getTimeUs();
+        if ((captureUs > 0) && (captureUs <= nowUs))
+            addRecord(pTrace, SEC_OMX_TRACE_CAPTURE_OUT, SEC_LATENCY_FRAME_UNKNOWN, captureUs, nowUs);
+    }
+
+    if (pTrace->bEnabled == OMX_FALSE)
+        return;
+
+    for (i = 0; (i < pSECPort->portDefinition.nBufferCountActual) && (i < MAX_BUFFER_NUM); i++) {
+        if (pSECPort->bufferHeader[i] == pBuffer)
+            break;
+    }
+    if ((i >= pSECPort->portDefinition.nBufferCountActual) || (i >= MAX_BUFFER_NUM) ||
+        (pTrace->startUs[nPortIndex][i] == 0))
+        return;
+
+    SEC_TRACE_ASYNC_END(gTraceEventName[nPortIndex], (nPortIndex << 16) | i);
+    addRecord(pTrace, nPortIndex, i, pTrace->startUs[nPortIndex][i], getTimeUs());
+    pTrace->startUs[nPortIndex][i] = 0;
+
+    if ((nPortIndex == OUTPUT_PORT_INDEX) && (pBuffer->nFilledLen > 0) && (pTrace->seekStartUs != 0)) {
+        SEC_TRACE_ASYNC_END(gTraceEventName[SEC_OMX_TRACE_SEEK], 0);
+        addRecord(pTrace, SEC_OMX_TRACE_SEEK, i, pTrace->seekStartUs, getTimeUs());
+        pTrace->seekStartUs = 0;
+    }
+}
+
+OMX_S64 SEC_OMX_TraceCodecStart(SEC_OMX_TRACE *pTrace)
+{
+    if ((pTrace == NULL) || (pTrace->bEnabled == OMX_FALSE))
+        return 0;
+
+    /* the decode thread marks the run itself, traced or not */
+    return getTimeUs();
+}
+
+void SEC_OMX_TraceCodecDone(SEC_OMX_TRACE *pTrace, OMX_S64 startUs)
+{
+    if ((pTrace == NULL) || (pTrace->bEnabled == OMX_FALSE) || (startUs == 0))
+        return;
+
+    addRecord(pTrace, SEC_OMX_TRACE_CODEC, 0, startUs, getTimeUs());
+}
+
+/* a flush of the input port, the time to the first picture after it is traced */
+void SEC_OMX_TraceSeekStart(SEC_OMX_TRACE *pTrace)
+{
+    if (pTrace->bEnabled == OMX_FALSE)
+        return;
+
+    if (pTrace->seekStartUs != 0)
+        SEC_TRACE_ASYNC_END(gTraceEventName[SEC_OMX_TRACE_SEEK], 0);
+    pTrace->seekStartUs = getTimeUs();
+    SEC_TRACE_ASYNC_BEGIN(gTraceEventName[SEC_OMX_TRACE_SEEK], 0);
+}
+
+/*
+ * the stamp says when the camera captured the frame, the buffer timestamp
+ * the encoder got with it is that minus the start of the recording. the
+ * difference goes to the decoders through SEC_LATENCY_BASE_ENV, it
+ * only moves with the camera's timestamp smoothing unless a new recording
+ * started.
+ */
+void SEC_OMX_TraceCaptureIn(SEC_OMX_TRACE *pTrace, OMX_PTR pStamp, OMX_TICKS timeStamp)
+{
+    struct sec_latency_stamp stamp;
+    OMX_S64 captureUs = 0;
+    OMX_S64 nowUs = 0;
+    OMX_S64 moveUs = 0;
+
+    if ((pTrace->bLatency == OMX_FALSE) || (sec_latency_stamp_read(pStamp, &stamp) != 0))
+        return;
+
+    captureUs = stamp.capture_ns / 1000;
+    nowUs = getTimeUs();
+    if (captureUs <= nowUs)
+        addRecord(pTrace, SEC_OMX_TRACE_CAPTURE_IN, stamp.frame, captureUs, nowUs);
+
+    pTrace->captureBaseUs = captureUs - timeStamp;
+    moveUs = pTrace->captureBaseUs - pTrace->publishedBaseUs;
+    if ((pTrace->publishedBaseUs == 0) || (moveUs > CAPTURE_BASE_REPUBLISH_US) || (moveUs < -CAPTURE_BASE_REPUBLISH_US)) {
+        sec_latency_base_publish(pTrace->captureBaseUs);
+        pTrace->publishedBaseUs = pTrace->captureBaseUs;
+    }
+}
+
+/* a picture of unknown capture time clears its stamp, the buffer may hold the last one */
+void SEC_OMX_TraceCaptureStamp(SEC_OMX_TRACE *pTrace, OMX_TICKS timeStamp, OMX_PTR pStamp)
+{
+    struct sec_latency_stamp stamp;
+    OMX_S64 captureUs = 0;
+
+    if (pTrace->bLatency == OMX_FALSE)
+        return;
+
+    SEC_OSAL_Memset(&stamp, 0, sizeof(stamp));
+    captureUs = getCaptureUs(pTrace, timeStamp);
+    if (captureUs > 0)
+        sec_latency_stamp_set(&stamp, SEC_LATENCY_FRAME_UNKNOWN, captureUs * 1000);
+    sec_latency_stamp_write(pStamp, &stamp);
+}
+
+void SEC_OMX_TraceDump(SEC_OMX_TRACE *pTrace, OMX_STRING componentName)
+{
+    char    line[256];
+    OMX_U32 count = 0;
+    OMX_U32 nRecord = 0;
+    int     event = 0;
+    int     bucket = 0;
+    int     len = 0;
+    OMX_U32 i = 0;
+
+    if ((pTrace->bEnabled == OMX_FALSE) && (pTrace->bLatency == OMX_FALSE))
+        return;
+
+    for (event = 0; event < SEC_OMX_TRACE_EVENT_NUM; event++) {
+        count = 0;
+        len = 0;
+        for (bucket = 0; bucket < SEC_OMX_TRACE_HIST_NUM; bucket++) {
+            count += pTrace->histogram[event][bucket];
+            if (bucket < SEC_OMX_TRACE_HIST_NUM - 1)
+                len += snprintf(line + len, sizeof(line) - len, " <%dms:%d",
+                                1 << bucket, pTrace->histogram[event][bucket]);
+            else
+                len += snprintf(line + len, sizeof(line) - len, " more:%d",
+                                pTrace->histogram[event][bucket]);
+        }
+        if (count == 0)
+            continue;
+        SEC_OSAL_Log(SEC_LOG_TRACE, "%s %s: %d, avg %lldus, max %dus,%s",
+                     componentName, gTraceEventName[event], count,
+                     pTrace->totalUs[event] / count, pTrace->maxUs[event], line);
+    }
+
+    nRecord = (OMX_U32)android_atomic_acquire_load(&pTrace->nRecord);
+    i = (nRecord > SEC_OMX_TRACE_RECORD_NUM) ? (nRecord - SEC_OMX_TRACE_RECORD_NUM) : 0;
+    for (; i < nRecord; i++) {
+        SEC_OMX_TRACE_RECORD *pRecord = &pTrace->record[i % SEC_OMX_TRACE_RECORD_NUM];
+
+        SEC_OSAL_Log(SEC_LOG_TRACE, "%s %s[%d] at %lldus took %dus",
+                     componentName, gTraceEventName[pRecord->event], pRecord->nIndex,
+                     pRecord->startUs, pRecord->latencyUs);
+    }
+}
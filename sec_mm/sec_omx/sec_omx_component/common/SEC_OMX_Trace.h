@@ -0,0 +1,109 @@
+/*
+ *
+ * Copyright 2010 Samsung Electronics S.LSI Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * @file       SEC_OMX_Trace.h
+ * @brief      per buffer latency tracing of the components
+ * @version    1.0
+ */
+
+#ifndef SEC_OMX_TRACE_H
+#define SEC_OMX_TRACE_H
+
+#include <stdint.h>
+
+#include "OMX_Types.h"
+#include "OMX_Core.h"
+#include "SEC_OMX_Baseport.h"
+
+
+/* set to 1 to trace, read when the component is created */
+#define SEC_OMX_TRACE_PROPERTY   "debug.sec.omx.trace"
+
+#define SEC_OMX_TRACE_RECORD_NUM 128
+/* bucket i counts latencies under 2^i ms, the last one everything above */
+#define SEC_OMX_TRACE_HIST_NUM   8
+
+typedef enum _SEC_OMX_TRACE_EVENT
+{
+    SEC_OMX_TRACE_EMPTY_BUFFER = 0,   /* EmptyThisBuffer to EmptyBufferDone */
+    SEC_OMX_TRACE_FILL_BUFFER,        /* FillThisBuffer to FillBufferDone */
+    SEC_OMX_TRACE_CODEC,              /* one MFC run on the decode thread */
+    SEC_OMX_TRACE_SEEK,               /* input flush to the next filled output buffer */
+    SEC_OMX_TRACE_CAPTURE_IN,         /* camera capture to the frame coming in, see SEC_LATENCY_PROPERTY */
+    SEC_OMX_TRACE_CAPTURE_OUT,        /* camera capture to the frame going out */
+    SEC_OMX_TRACE_EVENT_NUM
+} SEC_OMX_TRACE_EVENT;
+
+typedef struct _SEC_OMX_TRACE_RECORD
+{
+    OMX_U32 event;
+    OMX_U32 nIndex;                   /* buffer index in its port, 0 for the codec, the camera frame for a capture */
+    OMX_S64 startUs;
+    OMX_U32 latencyUs;
+} SEC_OMX_TRACE_RECORD;
+
+typedef struct _SEC_OMX_TRACE
+{
+    OMX_BOOL             bEnabled;
+    /* when each buffer of a port was handed to the component, 0 when it is not */
+    OMX_S64              startUs[ALL_PORT_NUM][MAX_BUFFER_NUM];
+    /* when the input port was last flushed, 0 once a picture came out */
+    OMX_S64              seekStartUs;
+
+    /* the capture latency probe of include/sec_latency.h, on without bEnabled */
+    OMX_BOOL             bLatency;
+    /* capture time minus buffer timestamp, 0 while not known */
+    OMX_S64              captureBaseUs;
+    /* of an encoder, what it last published in SEC_LATENCY_BASE_ENV */
+    OMX_S64              publishedBaseUs;
+
+    /*
+     * the last records, written by the buffer process and decode threads,
+     * everything else of an event by one thread only
+     */
+    volatile int32_t     nRecord;
+    SEC_OMX_TRACE_RECORD record[SEC_OMX_TRACE_RECORD_NUM];
+
+    OMX_U32              histogram[SEC_OMX_TRACE_EVENT_NUM][SEC_OMX_TRACE_HIST_NUM];
+    OMX_U32              maxUs[SEC_OMX_TRACE_EVENT_NUM];
+    OMX_U64              totalUs[SEC_OMX_TRACE_EVENT_NUM];
+} SEC_OMX_TRACE;
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void    SEC_OMX_TraceInit(SEC_OMX_TRACE *pTrace);
+void    SEC_OMX_TraceBufferStart(SEC_OMX_TRACE *pTrace, OMX_U32 nPortIndex, OMX_U32 nIndex);
+void    SEC_OMX_TraceBufferDone(SEC_OMX_TRACE *pTrace, SEC_OMX_BASEPORT *pSECPort, OMX_U32 nPortIndex, OMX_BUFFERHEADERTYPE *pBuffer);
+OMX_S64 SEC_OMX_TraceCodecStart(SEC_OMX_TRACE *pTrace);
+void    SEC_OMX_TraceCodecDone(SEC_OMX_TRACE *pTrace, OMX_S64 startUs);
+void    SEC_OMX_TraceSeekStart(SEC_OMX_TRACE *pTrace);
+/* an encoder got a camera frame with a latency stamp at pStamp */
+void    SEC_OMX_TraceCaptureIn(SEC_OMX_TRACE *pTrace, OMX_PTR pStamp, OMX_TICKS timeStamp);
+/* a decoder hands a picture to the display, the 16 bytes at pStamp get its stamp */
+void    SEC_OMX_TraceCaptureStamp(SEC_OMX_TRACE *pTrace, OMX_TICKS timeStamp, OMX_PTR pStamp);
+/* logs the histograms and the last records */
+void    SEC_OMX_TraceDump(SEC_OMX_TRACE *pTrace, OMX_STRING componentName);
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif
@@ -2,12 +2,16 @@ LOCAL_PATH := $(call my-dir)
 include $(CLEAR_VARS)
 
 LOCAL_SRC_FILES := \
-	SEC_OMX_Vdec.c
+	SEC_OMX_Vdec.c \
+	SEC_OMX_StartCode.c
 
 LOCAL_MODULE := libSEC_OMX_Vdec.aries
 LOCAL_ARM_MODE := arm
 LOCAL_MODULE_TAGS := optional
 
+LOCAL_CFLAGS := $(SEC_OMX_VDEC_CFLAGS)
+LOCAL_CFLAGS += $(SEC_OMX_LOG_CFLAGS)
+
 LOCAL_C_INCLUDES := $(SEC_OMX_INC)/khronos \
 	$(SEC_OMX_INC)/sec \
 	$(SEC_OMX_TOP)/sec_osal \
@@ -15,6 +19,7 @@ LOCAL_C_INCLUDES := $(SEC_OMX_INC)/khronos \
 	$(SEC_OMX_COMPONENT)/common \
 	$(SEC_OMX_COMPONENT)/video/dec
 
-LOCAL_C_INCLUDES += $(SEC_OMX_TOP)/sec_codecs/video/mfc_c110/include
+LOCAL_C_INCLUDES += $(SEC_OMX_TOP)/sec_codecs/video/mfc_c110/include \
+	$(SEC_OMX_TOP)/../../include
 
 include $(BUILD_STATIC_LIBRARY)
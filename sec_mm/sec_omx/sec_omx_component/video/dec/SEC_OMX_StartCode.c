@@ -0,0 +1,78 @@
+/*
+ *
+ * Copyright 2010 Samsung Electronics S.LSI Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * @file        SEC_OMX_StartCode.c
+ * @brief       start code search shared by the video decoder frame parsers
+ * @version     1.0
+ */
+
+#include "SEC_OMX_StartCode.h"
+
+#define IS_PREFIX(p)        ((p)[0] == 0x00 && (p)[1] == 0x00 && (p)[2] == 0x01)
+
+/*
+ * Non zero when byte 1 or byte 3 (little endian) of x is 0x00. The two
+ * zeros of a prefix are neighbours so one of them always sits at an odd
+ * offset, a word where neither odd byte is zero cannot hold the start of
+ * a prefix. The borrow only ever flags too much, never too little.
+ */
+#define HAS_ODD_ZERO_BYTE(x)    (((x) - 0x01000100) & ~(x) & 0x80008000)
+
+int SEC_OMX_FindStartCode(OMX_U8 *pStream, int offset, int streamSize)
+{
+    int last = streamSize - 4;
+    int i = offset;
+
+    if (i < 0)
+        i = 0;
+
+    while ((i <= last) && (((unsigned long)(pStream + i)) & 3)) {
+        if (IS_PREFIX(pStream + i))
+            return i;
+        i++;
+    }
+
+    /* a prefix at i + 3 reads up to i + 5, which is still within last + 2 */
+    while (i + 3 <= last) {
+        OMX_U8 *p = pStream + i;
+        unsigned int word = *(unsigned int *)p;
+
+        if (HAS_ODD_ZERO_BYTE(word)) {
+            if (p[1] == 0x00) {
+                if (p[0] == 0x00 && p[2] == 0x01)
+                    return i;
+                if (p[2] == 0x00 && p[3] == 0x01)
+                    return i + 1;
+            }
+            if (p[3] == 0x00) {
+                if (p[2] == 0x00 && p[4] == 0x01)
+                    return i + 2;
+                if (p[4] == 0x00 && p[5] == 0x01)
+                    return i + 3;
+            }
+        }
+        i += 4;
+    }
+
+    for (; i <= last; i++) {
+        if (IS_PREFIX(pStream + i))
+            return i;
+    }
+
+    return -1;
+}
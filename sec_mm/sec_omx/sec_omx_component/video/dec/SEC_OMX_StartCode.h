@@ -0,0 +1,44 @@
+/*
+ *
+ * Copyright 2010 Samsung Electronics S.LSI Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * @file        SEC_OMX_StartCode.h
+ * @brief       start code search shared by the video decoder frame parsers
+ * @version     1.0
+ */
+
+#ifndef SEC_OMX_START_CODE
+#define SEC_OMX_START_CODE
+
+#include "OMX_Types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Offset of the first 00 00 01 prefix at or after offset that is followed
+ * by at least one more byte of the stream (the NAL header or the MPEG-4
+ * start code value), -1 if there is none.
+ */
+int SEC_OMX_FindStartCode(OMX_U8 *pStream, int offset, int streamSize);
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif
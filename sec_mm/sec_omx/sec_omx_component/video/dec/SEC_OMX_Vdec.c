@@ -29,12 +29,16 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#define ATRACE_TAG ATRACE_TAG_VIDEO
+#include <sec_trace.h>
 #include "SEC_OMX_Macros.h"
 #include "SEC_OSAL_Event.h"
 #include "SEC_OMX_Vdec.h"
 #include "SEC_OMX_Basecomponent.h"
 #include "SEC_OSAL_Thread.h"
+#include "SEC_OSAL_Semaphore.h"
 #include "color_space_convertor.h"
+#include "SsbSipMfcApi.h"
 
 #undef  SEC_LOG_TAG
 #define SEC_LOG_TAG    "SEC_VIDEO_DEC"
@@ -42,6 +46,31 @@
 #include "SEC_OSAL_Log.h"
 
 
+/* a YUV 4:2:0 buffer size raised to hold the adaptive playback maximum */
+OMX_U32 SEC_AdaptiveOutputBufferSize(SEC_OMX_BASEPORT *pSECOutputPort, OMX_U32 nBufferSize)
+{
+    OMX_U32 maxSize = 0;
+
+    if (pSECOutputPort->bAdaptivePlayback != OMX_TRUE)
+        return nBufferSize;
+
+    maxSize = (((pSECOutputPort->nMaxFrameWidth + 15) & (~15)) *
+               ((pSECOutputPort->nMaxFrameHeight + 15) & (~15)) * 3) / 2;
+
+    return (maxSize > nBufferSize) ? maxSize : nBufferSize;
+}
+
+/* OMX_TRUE when a width x height picture fits the output buffers already allocated */
+OMX_BOOL SEC_AdaptiveResolutionFits(SEC_OMX_BASEPORT *pSECOutputPort, OMX_U32 width, OMX_U32 height)
+{
+    if ((pSECOutputPort->bAdaptivePlayback == OMX_TRUE) &&
+        (width <= pSECOutputPort->nMaxFrameWidth) &&
+        (height <= pSECOutputPort->nMaxFrameHeight))
+        return OMX_TRUE;
+
+    return OMX_FALSE;
+}
+
 inline void SEC_UpdateFrameSize(OMX_COMPONENTTYPE *pOMXComponent)
 {
     SEC_OMX_BASECOMPONENT *pSECComponent = (SEC_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
@@ -66,9 +95,22 @@ inline void SEC_UpdateFrameSize(OMX_COMPONENTTYPE *pOMXComponent)
         switch(secOutputPort->portDefinition.format.video.eColorFormat) {
         case OMX_COLOR_FormatYUV420Planar:
         case OMX_COLOR_FormatYUV420SemiPlanar:
+        case OMX_SEC_COLOR_FormatNV21Linear:
         case OMX_SEC_COLOR_FormatANBYUV420SemiPlanar:
+        case OMX_SEC_COLOR_FormatANBNV12TPhysicalAddress:
+            if (width && height)
+                secOutputPort->portDefinition.nBufferSize =
+                    SEC_AdaptiveOutputBufferSize(secOutputPort, (width * height * 3) / 2);
+            break;
+        case OMX_SEC_COLOR_FormatYVU420Planar:
+            if (width && height)
+                secOutputPort->portDefinition.nBufferSize =
+                    SEC_AdaptiveOutputBufferSize(secOutputPort, YV12_FRAME_SIZE(width, height));
+            break;
+        case OMX_COLOR_Format16bitRGB565:
             if (width && height)
-                secOutputPort->portDefinition.nBufferSize = (width * height * 3) / 2;
+                secOutputPort->portDefinition.nBufferSize =
+                    SEC_AdaptiveOutputBufferSize(secOutputPort, width * height * 2);
             break;
         default:
             if (width && height)
@@ -128,7 +170,7 @@ OMX_ERRORTYPE SEC_OMX_UseBuffer(
         goto EXIT;
     }
 
-    temp_bufferHeader = (OMX_BUFFERHEADERTYPE *)SEC_OSAL_Malloc(sizeof(OMX_BUFFERHEADERTYPE));
+    temp_bufferHeader = (OMX_BUFFERHEADERTYPE *)SEC_OSAL_PoolAlloc(&pSECComponent->bufferHeaderPool);
     if (temp_bufferHeader == NULL) {
         ret = OMX_ErrorInsufficientResources;
         goto EXIT;
@@ -161,7 +203,7 @@ OMX_ERRORTYPE SEC_OMX_UseBuffer(
         }
     }
 
-    SEC_OSAL_Free(temp_bufferHeader);
+    SEC_OSAL_PoolFree(&pSECComponent->bufferHeaderPool, temp_bufferHeader);
     ret = OMX_ErrorInsufficientResources;
 
 EXIT:
@@ -183,6 +225,7 @@ OMX_ERRORTYPE SEC_OMX_AllocateBuffer(
     SEC_OMX_BASEPORT      *pSECPort = NULL;
     OMX_BUFFERHEADERTYPE  *temp_bufferHeader = NULL;
     OMX_U8                *temp_buffer = NULL;
+    OMX_U32                bufferState = BUFFER_STATE_ALLOCATED | HEADER_STATE_ALLOCATED;
     int                    i = 0;
 
     FunctionIn();
@@ -219,25 +262,32 @@ OMX_ERRORTYPE SEC_OMX_AllocateBuffer(
         goto EXIT;
     }
 
-    temp_buffer = SEC_OSAL_Malloc(sizeof(OMX_U8) * nSizeBytes);
-    if (temp_buffer == NULL) {
-        ret = OMX_ErrorInsufficientResources;
-        goto EXIT;
-    }
-
-    temp_bufferHeader = (OMX_BUFFERHEADERTYPE *)SEC_OSAL_Malloc(sizeof(OMX_BUFFERHEADERTYPE));
+    temp_bufferHeader = (OMX_BUFFERHEADERTYPE *)SEC_OSAL_PoolAlloc(&pSECComponent->bufferHeaderPool);
     if (temp_bufferHeader == NULL) {
-        SEC_OSAL_Free(temp_buffer);
-        temp_buffer = NULL;
         ret = OMX_ErrorInsufficientResources;
         goto EXIT;
     }
     SEC_OSAL_Memset(temp_bufferHeader, 0, sizeof(OMX_BUFFERHEADERTYPE));
 
+    /* input in MFC stream memory is decoded in place instead of being copied */
+    if ((nPortIndex == INPUT_PORT_INDEX) && (pSECComponent->sec_mfc_allocInputBuffer != NULL)) {
+        temp_buffer = pSECComponent->sec_mfc_allocInputBuffer(pOMXComponent, nSizeBytes);
+        if (temp_buffer != NULL)
+            bufferState |= BUFFER_STATE_MFC;
+    }
+    if (temp_buffer == NULL) {
+        temp_buffer = SEC_OSAL_Malloc(sizeof(OMX_U8) * nSizeBytes);
+        if (temp_buffer == NULL) {
+            SEC_OSAL_PoolFree(&pSECComponent->bufferHeaderPool, temp_bufferHeader);
+            ret = OMX_ErrorInsufficientResources;
+            goto EXIT;
+        }
+    }
+
     for (i = 0; i < pSECPort->portDefinition.nBufferCountActual; i++) {
         if (pSECPort->bufferStateAllocate[i] == BUFFER_STATE_FREE) {
             pSECPort->bufferHeader[i] = temp_bufferHeader;
-            pSECPort->bufferStateAllocate[i] = (BUFFER_STATE_ALLOCATED | HEADER_STATE_ALLOCATED);
+            pSECPort->bufferStateAllocate[i] = bufferState;
             INIT_SET_SIZE_VERSION(temp_bufferHeader, OMX_BUFFERHEADERTYPE);
             temp_bufferHeader->pBuffer        = temp_buffer;
             temp_bufferHeader->nAllocLen      = nSizeBytes;
@@ -259,8 +309,11 @@ OMX_ERRORTYPE SEC_OMX_AllocateBuffer(
         }
     }
 
-    SEC_OSAL_Free(temp_bufferHeader);
-    SEC_OSAL_Free(temp_buffer);
+    SEC_OSAL_PoolFree(&pSECComponent->bufferHeaderPool, temp_bufferHeader);
+    if (bufferState & BUFFER_STATE_MFC)
+        pSECComponent->sec_mfc_freeInputBuffer(pOMXComponent, temp_buffer);
+    else
+        SEC_OSAL_Free(temp_buffer);
     ret = OMX_ErrorInsufficientResources;
 
 EXIT:
@@ -318,15 +371,25 @@ OMX_ERRORTYPE SEC_OMX_FreeBuffer(
         if (((pSECPort->bufferStateAllocate[i] | BUFFER_STATE_FREE) != 0) && (pSECPort->bufferHeader[i] != NULL)) {
             if (pSECPort->bufferHeader[i]->pBuffer == pBufferHdr->pBuffer) {
                 if (pSECPort->bufferStateAllocate[i] & BUFFER_STATE_ALLOCATED) {
-                    SEC_OSAL_Free(pSECPort->bufferHeader[i]->pBuffer);
+                    if (pSECPort->bufferStateAllocate[i] & BUFFER_STATE_MFC)
+                        pSECComponent->sec_mfc_freeInputBuffer(pOMXComponent, pSECPort->bufferHeader[i]->pBuffer);
+                    else
+                        SEC_OSAL_Free(pSECPort->bufferHeader[i]->pBuffer);
                     pSECPort->bufferHeader[i]->pBuffer = NULL;
                     pBufferHdr->pBuffer = NULL;
                 } else if (pSECPort->bufferStateAllocate[i] & BUFFER_STATE_ASSIGNED) {
-                    ; /* None*/
+#ifdef USE_ANB_ZERO_COPY
+                    /* mapped for good by useAndroidNativeBuffer */
+                    if ((nPortIndex == OUTPUT_PORT_INDEX) &&
+                        (pSECPort->bufferHeader[i]->pOutputPortPrivate != NULL)) {
+                        putVADDRtoANB(pSECPort->bufferHeader[i]->pBuffer);
+                        pSECPort->bufferHeader[i]->pOutputPortPrivate = NULL;
+                    }
+#endif
                 }
                 pSECPort->assignedBufferNum--;
                 if (pSECPort->bufferStateAllocate[i] & HEADER_STATE_ALLOCATED) {
-                    SEC_OSAL_Free(pSECPort->bufferHeader[i]);
+                    SEC_OSAL_PoolFree(&pSECComponent->bufferHeaderPool, pSECPort->bufferHeader[i]);
                     pSECPort->bufferHeader[i] = NULL;
                     pBufferHdr = NULL;
                 }
@@ -407,6 +470,500 @@ OMX_BOOL SEC_Check_BufferProcess_State(SEC_OMX_BASECOMPONENT *pSECComponent)
     }
 }
 
+static void SEC_InputBufferMark(OMX_COMPONENTTYPE *pOMXComponent, OMX_BUFFERHEADERTYPE *bufferHeader)
+{
+    SEC_OMX_BASECOMPONENT *pSECComponent = (SEC_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
+    SEC_OMX_BASEPORT      *secOMXInputPort = &pSECComponent->pSECPort[INPUT_PORT_INDEX];
+
+    if (secOMXInputPort->markType.hMarkTargetComponent != NULL ) {
+        bufferHeader->hMarkTargetComponent      = secOMXInputPort->markType.hMarkTargetComponent;
+        bufferHeader->pMarkData                 = secOMXInputPort->markType.pMarkData;
+        secOMXInputPort->markType.hMarkTargetComponent = NULL;
+        secOMXInputPort->markType.pMarkData = NULL;
+    }
+
+    if (bufferHeader->hMarkTargetComponent != NULL) {
+        if (bufferHeader->hMarkTargetComponent == pOMXComponent) {
+            pSECComponent->pCallbacks->EventHandler(pOMXComponent,
+                            pSECComponent->callbackData,
+                            OMX_EventMark,
+                            0, 0, bufferHeader->pMarkData);
+        } else {
+            pSECComponent->propagateMarkType.hMarkTargetComponent = bufferHeader->hMarkTargetComponent;
+            pSECComponent->propagateMarkType.pMarkData = bufferHeader->pMarkData;
+        }
+    }
+}
+
+/* gives an input buffer back to the client, also used for buffers decoded in place */
+OMX_ERRORTYPE SEC_InputBufferRelease(OMX_COMPONENTTYPE *pOMXComponent, OMX_BUFFERHEADERTYPE *bufferHeader)
+{
+    SEC_OMX_BASECOMPONENT *pSECComponent = (SEC_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
+    SEC_OMX_BASEPORT      *secOMXInputPort = &pSECComponent->pSECPort[INPUT_PORT_INDEX];
+
+    SEC_OMX_TraceBufferDone(&pSECComponent->trace, secOMXInputPort, INPUT_PORT_INDEX, bufferHeader);
+    if (CHECK_PORT_TUNNELED(secOMXInputPort)) {
+        OMX_FillThisBuffer(secOMXInputPort->tunneledComponent, bufferHeader);
+    } else {
+        bufferHeader->nFilledLen = 0;
+        pSECComponent->pCallbacks->EmptyBufferDone(pOMXComponent, pSECComponent->callbackData, bufferHeader);
+    }
+
+    return OMX_ErrorNone;
+}
+
+static OMX_PTR SEC_MFC_InputPoolPhyAddr(MFC_DEC_INPUT_POOL *pPool, OMX_PTR pBuffer)
+{
+    OMX_U8 *pStart = (OMX_U8 *)pPool->VirAddr + (pPool->copySize * MFC_INPUT_BUFFER_NUM_MAX);
+
+    if ((pPool->VirAddr == NULL) || ((OMX_U8 *)pBuffer < pStart) ||
+        ((OMX_U8 *)pBuffer >= pStart + (pPool->slotSize * pPool->slotNum)))
+        return NULL;
+
+    return (OMX_U8 *)pPool->PhyAddr + ((OMX_U8 *)pBuffer - (OMX_U8 *)pPool->VirAddr);
+}
+
+/* carves an input buffer out of the MFC stream memory, NULL when the caller has to malloc */
+OMX_PTR SEC_MFC_InputPoolAlloc(OMX_COMPONENTTYPE *pOMXComponent, MFC_DEC_INPUT_POOL *pPool, OMX_HANDLETYPE hMFCHandle, OMX_U32 nSizeBytes)
+{
+    SEC_OMX_BASECOMPONENT *pSECComponent = (SEC_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
+    SEC_OMX_BASEPORT      *pSECPort = &pSECComponent->pSECPort[INPUT_PORT_INDEX];
+    OMX_PTR                pStreamPhyBuffer = NULL;
+    OMX_U32                i = 0;
+
+    if ((hMFCHandle == NULL) || (pPool->bDisabled == OMX_TRUE))
+        return NULL;
+
+    if (pPool->VirAddr == NULL) {
+        pPool->slotNum = pSECPort->portDefinition.nBufferCountActual;
+        if (pPool->slotNum > MFC_INPUT_POOL_SLOT_NUM_MAX)
+            pPool->slotNum = MFC_INPUT_POOL_SLOT_NUM_MAX;
+        if (nSizeBytes > pSECPort->portDefinition.nBufferSize)
+            pPool->slotSize = MFC_INPUT_POOL_ALIGN(nSizeBytes);
+        else
+            pPool->slotSize = MFC_INPUT_POOL_ALIGN(pSECPort->portDefinition.nBufferSize);
+        pPool->copySize = SEC_MFC_InputCopySize(pSECPort->portDefinition.format.video.nFrameWidth,
+                                                pSECPort->portDefinition.format.video.nFrameHeight);
+
+        pPool->VirAddr = SsbSipMfcDecGetInBuf(hMFCHandle, &pStreamPhyBuffer,
+                                              (pPool->copySize * MFC_INPUT_BUFFER_NUM_MAX) + (pPool->slotSize * pPool->slotNum));
+        if (pPool->VirAddr == NULL) {
+            SEC_OSAL_Log(SEC_LOG_WARNING, "no MFC stream memory for %d input buffers of %d bytes, input is copied",
+                         pPool->slotNum, pPool->slotSize);
+            pPool->bDisabled = OMX_TRUE;
+            return NULL;
+        }
+        pPool->PhyAddr = pStreamPhyBuffer;
+        pPool->slotMask = 0;
+    }
+
+    if (nSizeBytes > pPool->slotSize)
+        return NULL;
+
+    for (i = 0; i < pPool->slotNum; i++) {
+        if (!(pPool->slotMask & (1 << i))) {
+            pPool->slotMask |= (1 << i);
+            return (OMX_U8 *)pPool->VirAddr + (pPool->copySize * MFC_INPUT_BUFFER_NUM_MAX) + (pPool->slotSize * i);
+        }
+    }
+
+    return NULL;
+}
+
+void SEC_MFC_InputPoolFree(MFC_DEC_INPUT_POOL *pPool, OMX_PTR pBuffer)
+{
+    OMX_U32 i = 0;
+
+    /* the memory went away with the MFC handle when the pool was reset */
+    if (SEC_MFC_InputPoolPhyAddr(pPool, pBuffer) == NULL)
+        return;
+
+    i = ((OMX_U8 *)pBuffer - ((OMX_U8 *)pPool->VirAddr + (pPool->copySize * MFC_INPUT_BUFFER_NUM_MAX))) / pPool->slotSize;
+    pPool->slotMask &= ~(1 << i);
+}
+
+/* the copy buffer one frame of a width x height stream fits in */
+OMX_U32 SEC_MFC_InputCopySize(OMX_U32 width, OMX_U32 height)
+{
+    OMX_U32 size = 0;
+
+    if ((width == 0) || (height == 0))
+        return DEFAULT_MFC_INPUT_BUFFER_SIZE;
+
+    size = (((width + 15) & (~15)) * ((height + 15) & (~15)) * 3) / 2;
+    if (size < MFC_INPUT_COPY_SIZE_MIN)
+        size = MFC_INPUT_COPY_SIZE_MIN;
+
+    return MFC_INPUT_POOL_ALIGN(size);
+}
+
+/*
+ * points the copy buffers of the slots at stream memory a width x height
+ * frame fits in. slots that are big enough already are left alone, the
+ * head of the pool is used while it fits, a bigger stream gets its own
+ * allocation and the old one goes with the handle. the keepLen bytes in
+ * slot keepIndex move along, a slot decoding from a client buffer keeps it.
+ */
+OMX_ERRORTYPE SEC_MFC_InputSlotsAlloc(MFC_DEC_INPUT_POOL *pPool, MFC_DEC_INPUT_BUFFER *pSlots, OMX_HANDLETYPE hMFCHandle,
+                                      OMX_U32 width, OMX_U32 height, int keepIndex, OMX_U32 keepLen)
+{
+    OMX_U32  copySize = SEC_MFC_InputCopySize(width, height);
+    OMX_U8  *pVirAddr = NULL;
+    OMX_PTR  pPhyAddr = NULL;
+    int      i = 0;
+
+    if ((pSlots[0].VirAddr != NULL) && ((OMX_U32)pSlots[0].bufferSize >= copySize))
+        return OMX_ErrorNone;
+
+    if ((pPool->VirAddr != NULL) && (pPool->copySize >= copySize)) {
+        pVirAddr = pPool->VirAddr;
+        pPhyAddr = pPool->PhyAddr;
+        copySize = pPool->copySize;
+    } else {
+        pVirAddr = SsbSipMfcDecGetInBuf(hMFCHandle, &pPhyAddr, copySize * MFC_INPUT_BUFFER_NUM_MAX);
+        if (pVirAddr == NULL) {
+            SEC_OSAL_Log(SEC_LOG_ERROR, "no MFC stream memory for %d copy buffers of %d bytes",
+                         MFC_INPUT_BUFFER_NUM_MAX, copySize);
+            return OMX_ErrorInsufficientResources;
+        }
+    }
+    SEC_OSAL_Log(SEC_LOG_TRACE, "copy buffers for %dx%d: %d bytes", width, height, copySize);
+
+    if ((keepLen > 0) && (pSlots[keepIndex].pBufferHeader == NULL) &&
+        (keepLen <= (OMX_U32)pSlots[keepIndex].bufferSize))
+        SEC_OSAL_Memcpy(pVirAddr + (copySize * keepIndex), pSlots[keepIndex].VirAddr, keepLen);
+
+    for (i = 0; i < MFC_INPUT_BUFFER_NUM_MAX; i++) {
+        pSlots[i].VirAddr    = pVirAddr + (copySize * i);
+        pSlots[i].PhyAddr    = (OMX_U8 *)pPhyAddr + (copySize * i);
+        pSlots[i].bufferSize = copySize;
+        if (pSlots[i].pBufferHeader == NULL) {
+            pSlots[i].StrmVirAddr = pSlots[i].VirAddr;
+            pSlots[i].StrmPhyAddr = pSlots[i].PhyAddr;
+            pSlots[i].StrmSize    = pSlots[i].bufferSize;
+        }
+    }
+
+    return OMX_ErrorNone;
+}
+
+/*
+ * points a stream slot at a client buffer of the pool, or back at its own
+ * memory when pBufferHeader is NULL or not from the pool. the client buffer
+ * held by the slot before is returned, its data is not needed any more.
+ */
+OMX_ERRORTYPE SEC_MFC_InputSlotSet(OMX_COMPONENTTYPE *pOMXComponent, MFC_DEC_INPUT_POOL *pPool, MFC_DEC_INPUT_BUFFER *pSlot, OMX_BUFFERHEADERTYPE *pBufferHeader)
+{
+    OMX_ERRORTYPE ret = OMX_ErrorNone;
+    OMX_PTR       pPhyAddr = NULL;
+
+    if (pBufferHeader != NULL) {
+        pPhyAddr = SEC_MFC_InputPoolPhyAddr(pPool, pBufferHeader->pBuffer);
+        if (pPhyAddr == NULL) {
+            pBufferHeader = NULL;
+            ret = OMX_ErrorUnsupportedSetting;
+        }
+    }
+
+    if (pSlot->pBufferHeader != NULL) {
+        SEC_InputBufferRelease(pOMXComponent, pSlot->pBufferHeader);
+        pSlot->pBufferHeader = NULL;
+    }
+
+    if (pBufferHeader != NULL) {
+        pSlot->StrmVirAddr   = pBufferHeader->pBuffer;
+        pSlot->StrmPhyAddr   = pPhyAddr;
+        pSlot->StrmSize      = pBufferHeader->nAllocLen;
+        pSlot->pBufferHeader = pBufferHeader;
+    } else {
+        pSlot->StrmVirAddr   = pSlot->VirAddr;
+        pSlot->StrmPhyAddr   = pSlot->PhyAddr;
+        pSlot->StrmSize      = pSlot->bufferSize;
+    }
+
+    return ret;
+}
+
+#if MFC_DEC_RESULT_NUM > SEC_RING_SIZE
+#error "MFC_INPUT_BUFFER_NUM_MAX is too big for the result ring"
+#endif
+
+static OMX_ERRORTYPE SEC_MFC_DecodeThread(OMX_PTR pParam)
+{
+    SEC_MFC_NBDEC_THREAD *pNBDecThread = (SEC_MFC_NBDEC_THREAD *)pParam;
+    MFC_DEC_JOB          *pJob = NULL;
+    MFC_DEC_RESULT       *pResult = NULL;
+    SSBSIP_MFC_DEC_FRAME  frame;
+    OMX_BOOL              bRerun = OMX_FALSE;
+    OMX_S64               traceStartUs = 0;
+
+    FunctionIn();
+
+    while (pNBDecThread->bExitDecodeThread == OMX_FALSE) {
+        SEC_OSAL_SemaphoreWait(pNBDecThread->hDecFrameStart);
+        if (pNBDecThread->bExitDecodeThread == OMX_TRUE)
+            break;
+
+        pJob = (MFC_DEC_JOB *)SEC_OSAL_RingGet(&pNBDecThread->jobQ);
+        if (pJob == NULL)
+            continue;
+
+        do {
+            SEC_OSAL_SemaphoreWait(pNBDecThread->hResultFree);
+            pResult = &pNBDecThread->result[pNBDecThread->indexResult];
+            pNBDecThread->indexResult = (pNBDecThread->indexResult + 1) % MFC_DEC_RESULT_NUM;
+
+            /* frames queued before a seek are not worth an MFC run */
+            if (pNBDecThread->bFlushing == OMX_TRUE) {
+                pResult->returnCodec = MFC_RET_OK;
+                pResult->status = MFC_GETOUTBUF_DECODING_ONLY;
+                pResult->indexTimestamp = pJob->indexTimestamp;
+                pResult->bLastRun = OMX_TRUE;
+                pResult->bPicture = OMX_FALSE;
+                SEC_OSAL_RingPut(&pNBDecThread->resultQ, pResult);
+                SEC_OSAL_SemaphorePost(pNBDecThread->hDecFrameEnd);
+                break;
+            }
+
+            /* the run may hand out a DPB buffer, or reuse one that is still being copied */
+            SEC_TRACE_BEGIN("vdec:wait_picture");
+            SEC_OSAL_SemaphoreWait(pNBDecThread->hPictureFree);
+            SEC_TRACE_END();
+
+            frame.phyInBuf = pJob->StrmPhyAddr;
+            frame.virInBuf = pJob->StrmVirAddr;
+            frame.inputBufferSize = pJob->StrmSize;
+            frame.lengthBufFill = pJob->oneFrameSize;
+            frame.in_frametag = pJob->indexTimestamp;
+
+            traceStartUs = SEC_OMX_TraceCodecStart(pNBDecThread->pTrace);
+            SEC_TRACE_BEGIN("vdec:mfc_turn");
+            SEC_OMX_MFC_RunBegin(pNBDecThread->pSession);
+            SEC_TRACE_END();
+            SEC_TRACE_BEGIN("vdec:mfc_run");
+            pResult->returnCodec = SsbSipMfcDecExeFrame(pNBDecThread->hMFCHandle, &frame);
+            SEC_TRACE_END();
+            SEC_OMX_MFC_RunEnd(pNBDecThread->pSession);
+            SEC_OMX_TraceCodecDone(pNBDecThread->pTrace, traceStartUs);
+            pResult->status = frame.status;
+            pResult->outputInfo = frame.output;
+            pResult->indexTimestamp = frame.out_frametag;
+
+            bRerun = ((pJob->bRerun == OMX_TRUE) &&
+                      (pResult->returnCodec == MFC_RET_OK) &&
+                      (pResult->status == MFC_GETOUTBUF_DISPLAY_ONLY)) ? OMX_TRUE : OMX_FALSE;
+            pResult->bLastRun = (bRerun == OMX_TRUE) ? OMX_FALSE : OMX_TRUE;
+            pResult->bPicture = ((pResult->returnCodec == MFC_RET_OK) &&
+                                 ((pResult->status == MFC_GETOUTBUF_DISPLAY_DECODING) ||
+                                  (pResult->status == MFC_GETOUTBUF_DISPLAY_ONLY))) ? OMX_TRUE : OMX_FALSE;
+            if (pResult->bPicture == OMX_FALSE)
+                SEC_OSAL_SemaphorePost(pNBDecThread->hPictureFree);
+
+            SEC_OSAL_RingPut(&pNBDecThread->resultQ, pResult);
+            SEC_OSAL_SemaphorePost(pNBDecThread->hDecFrameEnd);
+        } while ((bRerun == OMX_TRUE) && (pNBDecThread->bExitDecodeThread == OMX_FALSE));
+    }
+
+    SEC_OSAL_ThreadExit(NULL);
+    FunctionOut();
+
+    return OMX_ErrorNone;
+}
+
+OMX_ERRORTYPE SEC_MFC_DecodeThreadCreate(SEC_MFC_NBDEC_THREAD *pNBDecThread, OMX_HANDLETYPE hMFCHandle, SEC_OMX_TRACE *pTrace, SEC_OMX_RM_MFC_SESSION *pSession)
+{
+    OMX_ERRORTYPE ret = OMX_ErrorNone;
+    int           i = 0;
+
+    pNBDecThread->bExitDecodeThread = OMX_FALSE;
+    pNBDecThread->bFlushing = OMX_FALSE;
+    pNBDecThread->hMFCHandle = hMFCHandle;
+    pNBDecThread->pTrace = pTrace;
+    pNBDecThread->pSession = pSession;
+    pNBDecThread->indexJob = 0;
+    pNBDecThread->indexResult = 0;
+    pNBDecThread->nJobs = 0;
+    SEC_OSAL_RingCreate(&pNBDecThread->jobQ);
+    SEC_OSAL_RingCreate(&pNBDecThread->resultQ);
+
+    SEC_OSAL_SemaphoreCreate(&pNBDecThread->hDecFrameStart);
+    SEC_OSAL_SemaphoreCreate(&pNBDecThread->hDecFrameEnd);
+    SEC_OSAL_SemaphoreCreate(&pNBDecThread->hResultFree);
+    for (i = 0; i < MFC_DEC_RESULT_NUM; i++)
+        SEC_OSAL_SemaphorePost(pNBDecThread->hResultFree);
+    SEC_OSAL_SemaphoreCreate(&pNBDecThread->hPictureFree);
+    for (i = 0; i < MFC_DEC_PICTURE_HOLD_NUM; i++)
+        SEC_OSAL_SemaphorePost(pNBDecThread->hPictureFree);
+
+    ret = SEC_OSAL_ThreadCreateRole(&pNBDecThread->hNBDecodeThread,
+                                SEC_MFC_DecodeThread,
+                                pNBDecThread, SEC_OSAL_THREAD_ROLE_VIDEO);
+    if (ret != OMX_ErrorNone)
+        pNBDecThread->hNBDecodeThread = NULL;
+
+    return ret;
+}
+
+void SEC_MFC_DecodeThreadTerminate(SEC_MFC_NBDEC_THREAD *pNBDecThread)
+{
+    if (pNBDecThread->hNBDecodeThread != NULL) {
+        SEC_MFC_DecodeFlush(pNBDecThread);
+        pNBDecThread->bExitDecodeThread = OMX_TRUE;
+        SEC_OSAL_SemaphorePost(pNBDecThread->hDecFrameStart);
+        SEC_OSAL_ThreadTerminate(pNBDecThread->hNBDecodeThread);
+        pNBDecThread->hNBDecodeThread = NULL;
+    }
+
+    if (pNBDecThread->hPictureFree != NULL) {
+        SEC_OSAL_SemaphoreTerminate(pNBDecThread->hPictureFree);
+        pNBDecThread->hPictureFree = NULL;
+    }
+
+    if (pNBDecThread->hResultFree != NULL) {
+        SEC_OSAL_SemaphoreTerminate(pNBDecThread->hResultFree);
+        pNBDecThread->hResultFree = NULL;
+    }
+
+    if (pNBDecThread->hDecFrameEnd != NULL) {
+        SEC_OSAL_SemaphoreTerminate(pNBDecThread->hDecFrameEnd);
+        pNBDecThread->hDecFrameEnd = NULL;
+    }
+
+    if (pNBDecThread->hDecFrameStart != NULL) {
+        SEC_OSAL_SemaphoreTerminate(pNBDecThread->hDecFrameStart);
+        pNBDecThread->hDecFrameStart = NULL;
+    }
+
+    SEC_OSAL_RingTerminate(&pNBDecThread->jobQ);
+    SEC_OSAL_RingTerminate(&pNBDecThread->resultQ);
+}
+
+/* the slot belongs to the thread until the last result of the job is taken */
+void SEC_MFC_DecodeJobPut(SEC_MFC_NBDEC_THREAD *pNBDecThread, MFC_DEC_INPUT_BUFFER *pSlot, OMX_U32 oneFrameSize, OMX_S32 indexTimestamp, OMX_BOOL bRerun)
+{
+    MFC_DEC_JOB *pJob = &pNBDecThread->job[pNBDecThread->indexJob];
+
+    pNBDecThread->indexJob = (pNBDecThread->indexJob + 1) % MFC_INPUT_BUFFER_NUM_MAX;
+
+    pJob->StrmPhyAddr    = pSlot->StrmPhyAddr;
+    pJob->StrmVirAddr    = pSlot->StrmVirAddr;
+    pJob->StrmSize       = pSlot->StrmSize;
+    pJob->oneFrameSize   = oneFrameSize;
+    pJob->indexTimestamp = indexTimestamp;
+    pJob->bRerun         = bRerun;
+
+    pNBDecThread->nJobs++;
+    SEC_OSAL_RingPut(&pNBDecThread->jobQ, pJob);
+    SEC_OSAL_SemaphorePost(pNBDecThread->hDecFrameStart);
+}
+
+OMX_BOOL SEC_MFC_DecodeResultReady(SEC_MFC_NBDEC_THREAD *pNBDecThread)
+{
+    return (SEC_OSAL_RingGetElemNum(&pNBDecThread->resultQ) > 0) ? OMX_TRUE : OMX_FALSE;
+}
+
+/* waits for the oldest result, the caller must have a job outstanding */
+void SEC_MFC_DecodeResultGet(SEC_MFC_NBDEC_THREAD *pNBDecThread, MFC_DEC_RESULT *pResult)
+{
+    MFC_DEC_RESULT *pRingResult = NULL;
+
+    SEC_OSAL_SemaphoreWait(pNBDecThread->hDecFrameEnd);
+    pRingResult = (MFC_DEC_RESULT *)SEC_OSAL_RingGet(&pNBDecThread->resultQ);
+    SEC_OSAL_Memcpy(pResult, pRingResult, sizeof(MFC_DEC_RESULT));
+    SEC_OSAL_SemaphorePost(pNBDecThread->hResultFree);
+
+    if (pResult->bLastRun == OMX_TRUE)
+        pNBDecThread->nJobs--;
+}
+
+/* the picture of a bPicture result is copied out, the MFC may write over it again */
+void SEC_MFC_DecodePictureDone(SEC_MFC_NBDEC_THREAD *pNBDecThread)
+{
+    SEC_OSAL_SemaphorePost(pNBDecThread->hPictureFree);
+}
+
+/*
+ * drops what is queued, the MFC is idle and every slot is free afterwards.
+ * only the run in progress finishes, the jobs behind it are not decoded.
+ */
+void SEC_MFC_DecodeFlush(SEC_MFC_NBDEC_THREAD *pNBDecThread)
+{
+    MFC_DEC_RESULT result;
+
+    pNBDecThread->bFlushing = OMX_TRUE;
+    while (pNBDecThread->nJobs > 0) {
+        SEC_MFC_DecodeResultGet(pNBDecThread, &result);
+        if (result.bPicture == OMX_TRUE)
+            SEC_MFC_DecodePictureDone(pNBDecThread);
+    }
+    pNBDecThread->bFlushing = OMX_FALSE;
+}
+
+/* a run failed, the frames after it are dropped up to the next key frame */
+void SEC_MFC_DecodeRecoveryStart(MFC_DEC_RECOVERY *pRecovery, OMX_S32 returnCodec)
+{
+    /* the frames queued behind the failed one may fail as well */
+    if (pRecovery->bDropping == OMX_TRUE)
+        return;
+
+    pRecovery->nRecoveries++;
+    SEC_OSAL_Log(SEC_LOG_WARNING, "decode failed (%d), dropping to the next key frame (recovery %d)",
+                 returnCodec, pRecovery->nRecoveries);
+    pRecovery->bDropping = OMX_TRUE;
+    pRecovery->bCorrupt = OMX_TRUE;
+    pRecovery->nDropped = 0;
+}
+
+/* whether an input frame is dropped instead of decoded */
+OMX_BOOL SEC_MFC_DecodeRecoveryDrop(MFC_DEC_RECOVERY *pRecovery, OMX_BOOL bKeyFrame, OMX_TICKS timestamp)
+{
+    if (pRecovery->bDropping == OMX_FALSE)
+        return OMX_FALSE;
+
+    if ((bKeyFrame == OMX_FALSE) && (pRecovery->nDropped < MFC_DEC_RECOVERY_DROP_MAX)) {
+        pRecovery->nDropped++;
+        pRecovery->nDroppedTotal++;
+        return OMX_TRUE;
+    }
+
+    SEC_OSAL_Log(SEC_LOG_WARNING, "decoding resumed on a %s after %d dropped frames",
+                 (bKeyFrame == OMX_TRUE) ? "key frame" : "delta frame", pRecovery->nDropped);
+    pRecovery->bDropping = OMX_FALSE;
+    pRecovery->resumeTimestamp = timestamp;
+    return OMX_FALSE;
+}
+
+/* whether a displayed picture may show what the failed run broke */
+OMX_BOOL SEC_MFC_DecodeRecoveryCorrupt(MFC_DEC_RECOVERY *pRecovery, OMX_TICKS timestamp)
+{
+    if (pRecovery->bCorrupt == OMX_FALSE)
+        return OMX_FALSE;
+
+    if ((pRecovery->bDropping == OMX_FALSE) && (timestamp >= pRecovery->resumeTimestamp)) {
+        pRecovery->bCorrupt = OMX_FALSE;
+        return OMX_FALSE;
+    }
+
+    return OMX_TRUE;
+}
+
+/* a flush lands on any frame, what was broken before it is gone */
+void SEC_MFC_DecodeRecoveryReset(MFC_DEC_RECOVERY *pRecovery)
+{
+    pRecovery->bDropping = OMX_FALSE;
+    pRecovery->bCorrupt = OMX_FALSE;
+    pRecovery->nDropped = 0;
+}
+
+void SEC_MFC_DecodeRecoveryReport(MFC_DEC_RECOVERY *pRecovery, OMX_STRING componentName)
+{
+    if (pRecovery->nRecoveries == 0)
+        return;
+
+    SEC_OSAL_Log(SEC_LOG_WARNING, "%s: recovered from %d failed runs, %d frames dropped",
+                 componentName, pRecovery->nRecoveries, pRecovery->nDroppedTotal);
+}
+
 static OMX_ERRORTYPE SEC_InputBufferReturn(OMX_COMPONENTTYPE *pOMXComponent)
 {
     OMX_ERRORTYPE          ret = OMX_ErrorNone;
@@ -419,31 +976,8 @@ static OMX_ERRORTYPE SEC_InputBufferReturn(OMX_COMPONENTTYPE *pOMXComponent)
     FunctionIn();
 
     if (bufferHeader != NULL) {
-        if (secOMXInputPort->markType.hMarkTargetComponent != NULL ) {
-            bufferHeader->hMarkTargetComponent      = secOMXInputPort->markType.hMarkTargetComponent;
-            bufferHeader->pMarkData                 = secOMXInputPort->markType.pMarkData;
-            secOMXInputPort->markType.hMarkTargetComponent = NULL;
-            secOMXInputPort->markType.pMarkData = NULL;
-        }
-
-        if (bufferHeader->hMarkTargetComponent != NULL) {
-            if (bufferHeader->hMarkTargetComponent == pOMXComponent) {
-                pSECComponent->pCallbacks->EventHandler(pOMXComponent,
-                                pSECComponent->callbackData,
-                                OMX_EventMark,
-                                0, 0, bufferHeader->pMarkData);
-            } else {
-                pSECComponent->propagateMarkType.hMarkTargetComponent = bufferHeader->hMarkTargetComponent;
-                pSECComponent->propagateMarkType.pMarkData = bufferHeader->pMarkData;
-            }
-        }
-
-        if (CHECK_PORT_TUNNELED(secOMXInputPort)) {
-            OMX_FillThisBuffer(secOMXInputPort->tunneledComponent, bufferHeader);
-        } else {
-            bufferHeader->nFilledLen = 0;
-            pSECComponent->pCallbacks->EmptyBufferDone(pOMXComponent, pSECComponent->callbackData, bufferHeader);
-        }
+        SEC_InputBufferMark(pOMXComponent, bufferHeader);
+        SEC_InputBufferRelease(pOMXComponent, bufferHeader);
     }
 
     if ((pSECComponent->currentState == OMX_StatePause) &&
@@ -486,7 +1020,7 @@ OMX_ERRORTYPE SEC_InputBufferGetQueue(SEC_OMX_BASECOMPONENT *pSECComponent)
         SEC_OSAL_SemaphoreWait(pSECPort->bufferSemID);
         SEC_OSAL_MutexLock(inputUseBuffer->bufferMutex);
         if (dataBuffer->dataValid != OMX_TRUE) {
-            message = (SEC_OMX_MESSAGE *)SEC_OSAL_Dequeue(&pSECPort->bufferQ);
+            message = (SEC_OMX_MESSAGE *)SEC_OSAL_RingGet(&pSECPort->bufferQ);
             if (message == NULL) {
                 ret = OMX_ErrorUndefined;
                 SEC_OSAL_MutexUnlock(inputUseBuffer->bufferMutex);
@@ -502,7 +1036,7 @@ OMX_ERRORTYPE SEC_InputBufferGetQueue(SEC_OMX_BASECOMPONENT *pSECComponent)
             dataBuffer->nFlags = dataBuffer->bufferHeader->nFlags;
             dataBuffer->timeStamp = dataBuffer->bufferHeader->nTimeStamp;
 
-            SEC_OSAL_Free(message);
+            SEC_OSAL_PoolFree(&pSECComponent->messagePool, message);
 
             if (dataBuffer->allocSize <= dataBuffer->dataLen)
                 SEC_OSAL_Log(SEC_LOG_WARNING, "Input Buffer Full, Check input buffer size! allocSize:%d, dataLen:%d", dataBuffer->allocSize, dataBuffer->dataLen);
@@ -548,6 +1082,7 @@ static OMX_ERRORTYPE SEC_OutputBufferReturn(OMX_COMPONENTTYPE *pOMXComponent)
                             bufferHeader->nFlags, NULL);
         }
 
+        SEC_OMX_TraceBufferDone(&pSECComponent->trace, secOMXOutputPort, OUTPUT_PORT_INDEX, bufferHeader);
         if (CHECK_PORT_TUNNELED(secOMXOutputPort)) {
             OMX_EmptyThisBuffer(secOMXOutputPort->tunneledComponent, bufferHeader);
         } else {
@@ -596,7 +1131,7 @@ OMX_ERRORTYPE SEC_OutputBufferGetQueue(SEC_OMX_BASECOMPONENT *pSECComponent)
         SEC_OSAL_SemaphoreWait(pSECPort->bufferSemID);
         SEC_OSAL_MutexLock(outputUseBuffer->bufferMutex);
         if (dataBuffer->dataValid != OMX_TRUE) {
-            message = (SEC_OMX_MESSAGE *)SEC_OSAL_Dequeue(&pSECPort->bufferQ);
+            message = (SEC_OMX_MESSAGE *)SEC_OSAL_RingGet(&pSECPort->bufferQ);
             if (message == NULL) {
                 ret = OMX_ErrorUndefined;
                 SEC_OSAL_MutexUnlock(outputUseBuffer->bufferMutex);
@@ -613,8 +1148,9 @@ OMX_ERRORTYPE SEC_OutputBufferGetQueue(SEC_OMX_BASECOMPONENT *pSECComponent)
             /* dataBuffer->nTimeStamp = dataBuffer->bufferHeader->nTimeStamp; */
             pSECComponent->processData[OUTPUT_PORT_INDEX].dataBuffer = dataBuffer->bufferHeader->pBuffer;
             pSECComponent->processData[OUTPUT_PORT_INDEX].allocSize = dataBuffer->bufferHeader->nAllocLen;
+            pSECComponent->processData[OUTPUT_PORT_INDEX].specificBufferHeader.YVirAddr = dataBuffer->bufferHeader->pOutputPortPrivate;
 
-            SEC_OSAL_Free(message);
+            SEC_OSAL_PoolFree(&pSECComponent->messagePool, message);
         }
         SEC_OSAL_MutexUnlock(outputUseBuffer->bufferMutex);
         ret = OMX_ErrorNone;
@@ -675,6 +1211,7 @@ OMX_BOOL SEC_Preprocessor_InputData(OMX_COMPONENTTYPE *pOMXComponent)
     OMX_U32                checkedSize = 0;
     OMX_BOOL               flagEOF = OMX_FALSE;
     OMX_BOOL               previousFrameEOF = OMX_FALSE;
+    OMX_BOOL               bInPlace = OMX_FALSE;
 
     FunctionIn();
 
@@ -704,11 +1241,27 @@ OMX_BOOL SEC_Preprocessor_InputData(OMX_COMPONENTTYPE *pOMXComponent)
             SEC_OSAL_Log(SEC_LOG_TRACE, "sec_checkInputFrame : OMX_FALSE");
         }
 
+        /*
+         * a new frame picks its stream buffer. a whole frame filling a client
+         * buffer in MFC memory is decoded from there, the codec returns the
+         * buffer once the MFC is done with it.
+         */
+        if ((previousFrameEOF == OMX_TRUE) && (pSECComponent->sec_mfc_setInputBuffer != NULL)) {
+            if ((pSECComponent->bUseFlagEOF == OMX_TRUE) && (flagEOF == OMX_TRUE) &&
+                !(inputUseBuffer->nFlags & OMX_BUFFERFLAG_CODECCONFIG) &&
+                (inputUseBuffer->usedDataLen == 0) && (copySize > 0)) {
+                if (pSECComponent->sec_mfc_setInputBuffer(pOMXComponent, inputUseBuffer->bufferHeader) == OMX_ErrorNone)
+                    bInPlace = OMX_TRUE;
+            } else {
+                pSECComponent->sec_mfc_setInputBuffer(pOMXComponent, NULL);
+            }
+        }
+
         if (inputUseBuffer->nFlags & OMX_BUFFERFLAG_EOS)
             pSECComponent->bSaveFlagEOS = OMX_TRUE;
 
         if (((inputData->allocSize) - (inputData->dataLen)) >= copySize) {
-            if (copySize > 0)
+            if ((copySize > 0) && (bInPlace == OMX_FALSE))
                 SEC_OSAL_Memcpy(inputData->dataBuffer + inputData->dataLen, checkInputStream, copySize);
 
             inputUseBuffer->dataLen -= copySize;
@@ -762,10 +1315,15 @@ OMX_BOOL SEC_Preprocessor_InputData(OMX_COMPONENTTYPE *pOMXComponent)
             flagEOF = OMX_FALSE;
         }
 
-        if (inputUseBuffer->remainDataLen == 0)
+        if (inputUseBuffer->remainDataLen == 0) {
+            if (bInPlace == OMX_TRUE) {
+                SEC_InputBufferMark(pOMXComponent, inputUseBuffer->bufferHeader);
+                inputUseBuffer->bufferHeader = NULL;
+            }
             SEC_InputBufferReturn(pOMXComponent);
-        else
+        } else {
             inputUseBuffer->dataValid = OMX_TRUE;
+        }
     }
 
     if (flagEOF == OMX_TRUE) {
@@ -877,26 +1435,28 @@ OMX_ERRORTYPE SEC_OMX_BufferProcess(OMX_HANDLETYPE hComponent)
     FunctionIn();
 
     while (!pSECComponent->bExitBufferProcessThread) {
-        SEC_OSAL_SleepMillisec(0);
-
-        if (((pSECComponent->currentState == OMX_StatePause) ||
-            (pSECComponent->currentState == OMX_StateIdle) ||
-            (pSECComponent->transientState == SEC_OMX_TransStateLoadedToIdle) ||
-            (pSECComponent->transientState == SEC_OMX_TransStateExecutingToIdle)) &&
-            (pSECComponent->transientState != SEC_OMX_TransStateIdleToLoaded)&&
-            ((!CHECK_PORT_BEING_FLUSHED(secInputPort) && !CHECK_PORT_BEING_FLUSHED(secOutputPort)))) {
+        /*
+         * sleep until a state or port change makes the loop below runnable,
+         * all of them set pauseEvent. the state is checked again after the
+         * reset so that a change in between is not lost.
+         */
+        if (!SEC_Check_BufferProcess_State(pSECComponent) &&
+            (!CHECK_PORT_BEING_FLUSHED(secInputPort) && !CHECK_PORT_BEING_FLUSHED(secOutputPort))) {
             SEC_OSAL_SignalReset(pSECComponent->pauseEvent);
-            SEC_OSAL_SignalWait(pSECComponent->pauseEvent, DEF_MAX_WAIT_TIME);
+            if (!SEC_Check_BufferProcess_State(pSECComponent) &&
+                !pSECComponent->bExitBufferProcessThread)
+                SEC_OSAL_SignalWait(pSECComponent->pauseEvent, DEF_MAX_WAIT_TIME);
         }
 
+        /* blocks in the GetQueue calls on the port semaphores ETB/FTB post */
         while (SEC_Check_BufferProcess_State(pSECComponent) && !pSECComponent->bExitBufferProcessThread) {
-            SEC_OSAL_SleepMillisec(0);
-
             SEC_OSAL_MutexLock(outputUseBuffer->bufferMutex);
             if ((outputUseBuffer->dataValid != OMX_TRUE) &&
                 (!CHECK_PORT_BEING_FLUSHED(secOutputPort))) {
                 SEC_OSAL_MutexUnlock(outputUseBuffer->bufferMutex);
+                SEC_TRACE_BEGIN("vdec:wait_output");
                 ret = SEC_OutputBufferGetQueue(pSECComponent);
+                SEC_TRACE_END();
                 if ((ret == OMX_ErrorUndefined) ||
                     (secInputPort->portState != OMX_StateIdle) ||
                     (secOutputPort->portState != OMX_StateIdle)) {
@@ -912,7 +1472,9 @@ OMX_ERRORTYPE SEC_OMX_BufferProcess(OMX_HANDLETYPE hComponent)
                     if ((SEC_Preprocessor_InputData(pOMXComponent) == OMX_FALSE) &&
                         (!CHECK_PORT_BEING_FLUSHED(secInputPort))) {
                             SEC_OSAL_MutexUnlock(inputUseBuffer->bufferMutex);
+                            SEC_TRACE_BEGIN("vdec:wait_input");
                             ret = SEC_InputBufferGetQueue(pSECComponent);
+                            SEC_TRACE_END();
                             break;
                         }
 
@@ -921,7 +1483,9 @@ OMX_ERRORTYPE SEC_OMX_BufferProcess(OMX_HANDLETYPE hComponent)
 
                 SEC_OSAL_MutexLock(inputUseBuffer->bufferMutex);
                 SEC_OSAL_MutexLock(outputUseBuffer->bufferMutex);
+                SEC_TRACE_BEGIN("vdec:buffer_process");
                 ret = pSECComponent->sec_mfc_bufferProcess(pOMXComponent, inputData, outputData);
+                SEC_TRACE_END();
                 SEC_OSAL_MutexUnlock(outputUseBuffer->bufferMutex);
                 SEC_OSAL_MutexUnlock(inputUseBuffer->bufferMutex);
 
@@ -1059,6 +1623,21 @@ OMX_ERRORTYPE SEC_OMX_VideoDecodeGetParameter(
                 portFormat->eColorFormat       = OMX_SEC_COLOR_FormatNV12TPhysicalAddress;
                 portFormat->xFramerate           = portDefinition->format.video.xFramerate;
                 break;
+            case supportFormat_3:
+                portFormat->eCompressionFormat = OMX_VIDEO_CodingUnused;
+                portFormat->eColorFormat       = OMX_SEC_COLOR_FormatNV21Linear;
+                portFormat->xFramerate         = portDefinition->format.video.xFramerate;
+                break;
+            case supportFormat_4:
+                portFormat->eCompressionFormat = OMX_VIDEO_CodingUnused;
+                portFormat->eColorFormat       = OMX_SEC_COLOR_FormatYVU420Planar;
+                portFormat->xFramerate         = portDefinition->format.video.xFramerate;
+                break;
+            case supportFormat_5:
+                portFormat->eCompressionFormat = OMX_VIDEO_CodingUnused;
+                portFormat->eColorFormat       = OMX_COLOR_Format16bitRGB565;
+                portFormat->xFramerate         = portDefinition->format.video.xFramerate;
+                break;
             }
         }
         ret = OMX_ErrorNone;
@@ -1235,6 +1814,45 @@ OMX_ERRORTYPE SEC_OMX_VideoDecodeSetParameter(
     }
         break;
 #endif
+    case OMX_IndexParamPrepareForAdaptivePlayback:
+    {
+        SEC_OMX_PARAM_ADAPTIVE_PLAYBACK *pAdaptive = (SEC_OMX_PARAM_ADAPTIVE_PLAYBACK *)ComponentParameterStructure;
+        SEC_OMX_BASEPORT                *pSECPort = &pSECComponent->pSECPort[OUTPUT_PORT_INDEX];
+
+        ret = SEC_OMX_Check_SizeVersion(pAdaptive, sizeof(SEC_OMX_PARAM_ADAPTIVE_PLAYBACK));
+        if (ret != OMX_ErrorNone) {
+            goto EXIT;
+        }
+
+        if (pAdaptive->nPortIndex != OUTPUT_PORT_INDEX) {
+            ret = OMX_ErrorBadPortIndex;
+            goto EXIT;
+        }
+
+        /* the buffers are sized from it, so only before they are allocated */
+        if ((pSECComponent->currentState != OMX_StateLoaded) &&
+            (pSECPort->portDefinition.bEnabled == OMX_TRUE)) {
+            ret = OMX_ErrorIncorrectStateOperation;
+            goto EXIT;
+        }
+
+        /* native buffers come from the window at the picture size */
+        if ((pAdaptive->bEnable == OMX_TRUE) &&
+            ((pAdaptive->nMaxFrameWidth == 0) || (pAdaptive->nMaxFrameHeight == 0) ||
+             (pSECPort->bUseAndroidNativeBuffer == OMX_TRUE))) {
+            ret = OMX_ErrorUnsupportedSetting;
+            goto EXIT;
+        }
+
+        pSECPort->bAdaptivePlayback = pAdaptive->bEnable;
+        pSECPort->nMaxFrameWidth    = pAdaptive->nMaxFrameWidth;
+        pSECPort->nMaxFrameHeight   = pAdaptive->nMaxFrameHeight;
+        pSECPort->portDefinition.nBufferSize =
+            SEC_AdaptiveOutputBufferSize(pSECPort, pSECPort->portDefinition.nBufferSize);
+        SEC_OSAL_Log(SEC_LOG_TRACE, "adaptive playback %d, max %dx%d", pSECPort->bAdaptivePlayback,
+                     pSECPort->nMaxFrameWidth, pSECPort->nMaxFrameHeight);
+    }
+        break;
     default:
     {
         ret = SEC_OMX_SetParameter(hComponent, nIndex, ComponentParameterStructure);
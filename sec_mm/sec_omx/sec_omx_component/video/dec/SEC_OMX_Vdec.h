@@ -33,6 +33,9 @@
 #include "SEC_OMX_Def.h"
 #include "SEC_OSAL_Queue.h"
 #include "SEC_OMX_Baseport.h"
+#include "SEC_OMX_Trace.h"
+#include "SEC_OMX_Resourcemanager.h"
+#include "SsbSipMfcApi.h"
 
 #define MAX_VIDEO_INPUTBUFFER_NUM    5
 #define MAX_VIDEO_OUTPUTBUFFER_NUM   2
@@ -43,41 +46,182 @@
 #define DEFAULT_VIDEO_INPUT_BUFFER_SIZE    ((DEFAULT_FRAME_WIDTH * DEFAULT_FRAME_HEIGHT) * 2)
 #define DEFAULT_VIDEO_OUTPUT_BUFFER_SIZE   ((DEFAULT_FRAME_WIDTH * DEFAULT_FRAME_HEIGHT * 3) / 2)
 
-#define MFC_INPUT_BUFFER_NUM_MAX         2
+/*
+ * stream buffers of the input ring, the parser runs up to
+ * MFC_INPUT_BUFFER_NUM_MAX - 2 frames ahead of the one the MFC decodes.
+ * BOARD_MFC_INPUT_BUFFER_NUM overrides it, 2 is the old one frame overlap.
+ */
+#ifndef MFC_INPUT_BUFFER_NUM_MAX
+#define MFC_INPUT_BUFFER_NUM_MAX         4
+#endif
+/* decoded pictures that are waiting for the component thread */
+#define MFC_DEC_RESULT_NUM               (MFC_INPUT_BUFFER_NUM_MAX * 2)
+/* DPB buffers beyond the driver default, the queued frames may be decoded before a picture is copied out */
+#define MFC_DEC_EXTRA_BUFFER_NUM         (MFC_INPUT_BUFFER_NUM_MAX - 2)
+/*
+ * displayed pictures not copied out yet plus the one run in progress. the
+ * driver default keeps a single displayed picture intact across the next run.
+ */
+#define MFC_DEC_PICTURE_HOLD_NUM         (MFC_DEC_EXTRA_BUFFER_NUM + 2)
+/*
+ * pictures handed to the display by address stay in the DPB until the
+ * hwcomposer FIMC copied them out: one queued, one being composed, one
+ * in the FIMC
+ */
+#define MFC_DEC_DISPLAY_EXTRA_BUFFER_NUM 3
+/* frames a timestamp waits for in the MFC: the reorder in the DPB, the buffers above and the queued jobs */
+#define MFC_DEC_TIMESTAMP_DEPTH(dpbFrames) \
+    ((dpbFrames) + MFC_DEC_EXTRA_BUFFER_NUM + MFC_DEC_DISPLAY_EXTRA_BUFFER_NUM + MFC_INPUT_BUFFER_NUM_MAX + 1)
 #define DEFAULT_MFC_INPUT_BUFFER_SIZE    ((1280 * 720 * 3) / 2)
+/*
+ * the copy buffers fit one raw frame of the stream, the headers of the
+ * small ones need a bit more. an unknown size gets the default.
+ */
+#define MFC_INPUT_COPY_SIZE_MIN          (256 * 1024)
+
+/* stream buffers handed to clients start on a 2KB boundary like the MFC wants */
+#define MFC_INPUT_POOL_ALIGN(x)          (((x) + 2047) & (~2047))
+#define MFC_INPUT_POOL_SLOT_NUM_MAX      32
 
 #define INPUT_PORT_SUPPORTFORMAT_NUM_MAX    1
-#define OUTPUT_PORT_SUPPORTFORMAT_NUM_MAX   3
+#define OUTPUT_PORT_SUPPORTFORMAT_NUM_MAX   6
+
+/* OMX_SEC_COLOR_FormatYVU420Planar, the plane layout of Android YV12 */
+#define YV12_Y_STRIDE(w)                    (((w) + 15) & (~15))
+#define YV12_UV_STRIDE(w)                   (((YV12_Y_STRIDE(w) >> 1) + 15) & (~15))
+#define YV12_FRAME_SIZE(w, h)               ((YV12_Y_STRIDE(w) * (h)) + (YV12_UV_STRIDE(w) * (((h) + 1) >> 1) * 2))
 
 #ifdef USE_ANDROID_EXTENSION
 #define ANDROID_MAX_VIDEO_OUTPUTBUFFER_NUM   1
 #endif
 
+/* a thumbnail is one picture, one buffer is in the decoder while the client fills the other */
+#define THUMBNAIL_VIDEO_INPUTBUFFER_NUM      2
+#define THUMBNAIL_VIDEO_OUTPUTBUFFER_NUM     1
+
 typedef struct
 {
     void *pAddrY;
     void *pAddrC;
 } MFC_DEC_ADDR_INFO;
 
+/*
+ * what a OMX_SEC_COLOR_FormatANBNV12TPhysicalAddress native buffer holds
+ * instead of pixels, struct ADDRS in include/sec_utils.h. the latency
+ * probe's stamp follows it, see include/sec_latency.h
+ */
+typedef struct
+{
+    unsigned int addrY;
+    unsigned int addrCbCr;
+    unsigned int bufIndex;
+    unsigned int reserved;
+} MFC_DEC_ANB_ADDRS;
+
+/* one SsbSipMfcDecExeFrame for the decode thread */
+typedef struct _MFC_DEC_JOB
+{
+    void    *StrmPhyAddr;
+    void    *StrmVirAddr;
+    int      StrmSize;
+    OMX_U32  oneFrameSize;
+    OMX_S32  indexTimestamp;
+    /* the MFC only displayed a picture and did not take the stream, run it again */
+    OMX_BOOL bRerun;
+} MFC_DEC_JOB;
+
+/* what a run left in the MFC, read back by the decode thread */
+typedef struct _MFC_DEC_RESULT
+{
+    OMX_S32                      returnCodec;
+    SSBSIP_MFC_DEC_OUTBUF_STATUS status;
+    SSBSIP_MFC_DEC_OUTPUT_INFO   outputInfo;
+    OMX_S32                      indexTimestamp;  // frame tag, -1 if the MFC had none
+    OMX_BOOL                     bLastRun;        // the job is done with this one
+    OMX_BOOL                     bPicture;        // holds a DPB buffer until SEC_MFC_DecodePictureDone
+} MFC_DEC_RESULT;
+
+/*
+ * jobs go to the decode thread and results come back through two single
+ * producer rings, hDecFrameStart counts the jobs and hDecFrameEnd the
+ * results. hPictureFree keeps the MFC off the DPB buffers that are still
+ * copied out, so that the next run overlaps the colour conversion.
+ * only the decode thread touches the MFC once it runs.
+ */
 typedef struct _SEC_MFC_NBDEC_THREAD
 {
     OMX_HANDLETYPE  hNBDecodeThread;
     OMX_HANDLETYPE  hDecFrameStart;
     OMX_HANDLETYPE  hDecFrameEnd;
+    OMX_HANDLETYPE  hResultFree;
+    OMX_HANDLETYPE  hPictureFree;
     OMX_BOOL        bExitDecodeThread;
-    OMX_BOOL        bDecoderRun;
+    /* set by SEC_MFC_DecodeFlush, the queued jobs come back without a run */
+    volatile OMX_BOOL bFlushing;
+    OMX_HANDLETYPE  hMFCHandle;
+    SEC_OMX_TRACE  *pTrace;
+    SEC_OMX_RM_MFC_SESSION *pSession;
 
-    OMX_U32         oneFrameSize;
+    SEC_RING        jobQ;
+    SEC_RING        resultQ;
+    MFC_DEC_JOB     job[MFC_INPUT_BUFFER_NUM_MAX];
+    MFC_DEC_RESULT  result[MFC_DEC_RESULT_NUM];
+    OMX_U32         indexJob;       // component thread
+    OMX_U32         indexResult;    // decode thread
+    /* jobs given to the thread whose last result was not taken yet */
+    OMX_U32         nJobs;
 } SEC_MFC_NBDEC_THREAD;
 
+/* a stream without key frames is decoded on after that many are dropped */
+#define MFC_DEC_RECOVERY_DROP_MAX   60
+
+/*
+ * a run that failed leaves the references of the frames after it broken.
+ * decoding goes on without a component reset: the frames up to the next
+ * key frame are dropped, and the pictures shown before it in display
+ * order come out with OMX_BUFFERFLAG_DATACORRUPT.
+ */
+typedef struct _MFC_DEC_RECOVERY
+{
+    OMX_BOOL  bDropping;        // a run failed, waiting for a key frame
+    OMX_BOOL  bCorrupt;         // pictures before resumeTimestamp are damaged
+    OMX_TICKS resumeTimestamp;  // of the frame decoding resumed on
+    OMX_U32   nDropped;         // by this recovery
+    /* for the whole session */
+    OMX_U32   nRecoveries;
+    OMX_U32   nDroppedTotal;
+} MFC_DEC_RECOVERY;
+
 typedef struct _MFC_DEC_INPUT_BUFFER
 {
     void *PhyAddr;      // physical address
     void *VirAddr;      // virtual address
     int   bufferSize;   // input buffer alloc size
     int   dataSize;     // Data length
+
+    /* what the MFC decodes from, the buffer above or a client buffer */
+    void *StrmPhyAddr;
+    void *StrmVirAddr;
+    int   StrmSize;
+    /* client buffer decoded in place, returned when the slot is refilled */
+    OMX_BUFFERHEADERTYPE *pBufferHeader;
 } MFC_DEC_INPUT_BUFFER;
 
+/*
+ * one MFC stream allocation: the MFC_INPUT_BUFFER_NUM_MAX copy buffers
+ * followed by the input buffers SEC_OMX_AllocateBuffer hands out
+ */
+typedef struct _MFC_DEC_INPUT_POOL
+{
+    void    *PhyAddr;
+    void    *VirAddr;
+    OMX_U32  copySize;  // each of the copy buffers at the head
+    OMX_U32  slotSize;
+    OMX_U32  slotNum;
+    OMX_U32  slotMask;  // slots owned by clients
+    OMX_BOOL bDisabled; // no stream memory for it, clients get heap buffers
+} MFC_DEC_INPUT_POOL;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -121,6 +265,27 @@ OMX_ERRORTYPE SEC_OMX_VideoDecodeSetParameter(
     OMX_IN OMX_INDEXTYPE  nIndex,
     OMX_IN OMX_PTR        ComponentParameterStructure);
 OMX_ERRORTYPE SEC_OMX_VideoDecodeComponentDeinit(OMX_IN OMX_HANDLETYPE hComponent);
+OMX_ERRORTYPE SEC_InputBufferRelease(OMX_COMPONENTTYPE *pOMXComponent, OMX_BUFFERHEADERTYPE *bufferHeader);
+OMX_PTR SEC_MFC_InputPoolAlloc(OMX_COMPONENTTYPE *pOMXComponent, MFC_DEC_INPUT_POOL *pPool, OMX_HANDLETYPE hMFCHandle, OMX_U32 nSizeBytes);
+void SEC_MFC_InputPoolFree(MFC_DEC_INPUT_POOL *pPool, OMX_PTR pBuffer);
+OMX_U32 SEC_MFC_InputCopySize(OMX_U32 width, OMX_U32 height);
+OMX_U32 SEC_AdaptiveOutputBufferSize(SEC_OMX_BASEPORT *pSECOutputPort, OMX_U32 nBufferSize);
+OMX_BOOL SEC_AdaptiveResolutionFits(SEC_OMX_BASEPORT *pSECOutputPort, OMX_U32 width, OMX_U32 height);
+OMX_ERRORTYPE SEC_MFC_InputSlotsAlloc(MFC_DEC_INPUT_POOL *pPool, MFC_DEC_INPUT_BUFFER *pSlots, OMX_HANDLETYPE hMFCHandle,
+                                      OMX_U32 width, OMX_U32 height, int keepIndex, OMX_U32 keepLen);
+OMX_ERRORTYPE SEC_MFC_InputSlotSet(OMX_COMPONENTTYPE *pOMXComponent, MFC_DEC_INPUT_POOL *pPool, MFC_DEC_INPUT_BUFFER *pSlot, OMX_BUFFERHEADERTYPE *pBufferHeader);
+OMX_ERRORTYPE SEC_MFC_DecodeThreadCreate(SEC_MFC_NBDEC_THREAD *pNBDecThread, OMX_HANDLETYPE hMFCHandle, SEC_OMX_TRACE *pTrace, SEC_OMX_RM_MFC_SESSION *pSession);
+void SEC_MFC_DecodeThreadTerminate(SEC_MFC_NBDEC_THREAD *pNBDecThread);
+void SEC_MFC_DecodeJobPut(SEC_MFC_NBDEC_THREAD *pNBDecThread, MFC_DEC_INPUT_BUFFER *pSlot, OMX_U32 oneFrameSize, OMX_S32 indexTimestamp, OMX_BOOL bRerun);
+OMX_BOOL SEC_MFC_DecodeResultReady(SEC_MFC_NBDEC_THREAD *pNBDecThread);
+void SEC_MFC_DecodeResultGet(SEC_MFC_NBDEC_THREAD *pNBDecThread, MFC_DEC_RESULT *pResult);
+void SEC_MFC_DecodePictureDone(SEC_MFC_NBDEC_THREAD *pNBDecThread);
+void SEC_MFC_DecodeFlush(SEC_MFC_NBDEC_THREAD *pNBDecThread);
+void SEC_MFC_DecodeRecoveryStart(MFC_DEC_RECOVERY *pRecovery, OMX_S32 returnCodec);
+OMX_BOOL SEC_MFC_DecodeRecoveryDrop(MFC_DEC_RECOVERY *pRecovery, OMX_BOOL bKeyFrame, OMX_TICKS timestamp);
+OMX_BOOL SEC_MFC_DecodeRecoveryCorrupt(MFC_DEC_RECOVERY *pRecovery, OMX_TICKS timestamp);
+void SEC_MFC_DecodeRecoveryReset(MFC_DEC_RECOVERY *pRecovery);
+void SEC_MFC_DecodeRecoveryReport(MFC_DEC_RECOVERY *pRecovery, OMX_STRING componentName);
 
 #ifdef __cplusplus
 }
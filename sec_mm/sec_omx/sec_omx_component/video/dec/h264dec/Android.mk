@@ -10,7 +10,8 @@ LOCAL_SRC_FILES := \
 
 LOCAL_MODULE := libOMX.SEC.AVC.Decoder.aries
 
-LOCAL_CFLAGS :=
+LOCAL_CFLAGS := $(SEC_OMX_VDEC_CFLAGS)
+LOCAL_CFLAGS += $(SEC_OMX_LOG_CFLAGS)
 
 LOCAL_ARM_MODE := arm
 
@@ -32,6 +32,8 @@
 #include "SEC_OMX_Basecomponent.h"
 #include "SEC_OMX_Baseport.h"
 #include "SEC_OMX_Vdec.h"
+#include "SEC_OMX_StartCode.h"
+#include "SEC_OSAL_FimcCsc.h"
 #include "library_register.h"
 #include "SEC_OMX_H264dec.h"
 #include "SsbSipMfcApi.h"
@@ -83,10 +85,8 @@ SEC_OMX_VIDEO_PROFILELEVEL supportedAVCProfileLevels[] ={
 
 static int Check_H264_Frame(OMX_U8 *pInputStream, int buffSize, OMX_U32 flag, OMX_BOOL bPreviousFrameEOF, OMX_BOOL *pbEndOfFrame)
 {
-    OMX_U32  preFourByte       = (OMX_U32)-1;
-    int      accessUnitSize    = 0;
+    int      offset            = 0;
     int      frameTypeBoundary = 0;
-    int      nextNaluSize      = 0;
     int      naluStart         = 0;
 
     if (bPreviousFrameEOF == OMX_TRUE)
@@ -95,64 +95,56 @@ static int Check_H264_Frame(OMX_U8 *pInputStream, int buffSize, OMX_U32 flag, OM
         naluStart = 1;
 
     while (1) {
-        int inputOneByte = 0;
+        int naluType = 0;
 
-        if (accessUnitSize == buffSize)
+        offset = SEC_OMX_FindStartCode(pInputStream, offset, buffSize);
+        if (offset < 0)
             goto EXIT;
 
-        inputOneByte = *(pInputStream++);
-        accessUnitSize += 1;
+        naluType = pInputStream[offset + 3] & 0x1F;
 
-        if (preFourByte == 0x00000001 || (preFourByte << 8) == 0x00000100) {
-            int naluType = inputOneByte & 0x1F;
-
-            SEC_OSAL_Log(SEC_LOG_TRACE, "NaluType : %d", naluType);
-            if (naluStart == 0) {
+        if (naluStart == 0) {
 #ifdef ADD_SPS_PPS_I_FRAME
-                if (naluType == 1 || naluType == 5)
+            if (naluType == 1 || naluType == 5)
 #else
-                if (naluType == 1 || naluType == 5 || naluType == 7 || naluType == 8)
+            if (naluType == 1 || naluType == 5 || naluType == 7 || naluType == 8)
 #endif
-                    naluStart = 1;
-            } else {
+                naluStart = 1;
+        } else {
 #ifdef OLD_DETECT
-                frameTypeBoundary = (8 - naluType) & (naluType - 10); //AUD(9)
+            frameTypeBoundary = (8 - naluType) & (naluType - 10); //AUD(9)
 #else
-                if (naluType == 9)
-                    frameTypeBoundary = -2;
+            if (naluType == 9)
+                frameTypeBoundary = -2;
 #endif
-                if (naluType == 1 || naluType == 5) {
-                    if (accessUnitSize == buffSize) {
-                        accessUnitSize--;
-                        goto EXIT;
-                    }
-                    inputOneByte = *pInputStream++;
-                    accessUnitSize += 1;
-
-                    if (inputOneByte >= 0x80)
-                        frameTypeBoundary = -1;
-                }
-                if (frameTypeBoundary < 0) {
-                    break;
+            if (naluType == 1 || naluType == 5) {
+                /* first_mb_in_slice needs the byte behind the NAL header */
+                if (offset + 4 == buffSize) {
+                    *pbEndOfFrame = OMX_FALSE;
+                    return buffSize - 1;
                 }
+                if (pInputStream[offset + 4] >= 0x80)
+                    frameTypeBoundary = -1;
+            }
+            if (frameTypeBoundary < 0) {
+                break;
             }
-
         }
-        preFourByte = (preFourByte << 8) + inputOneByte;
+
+        /* the NAL header may be the first zero of the next prefix */
+        offset += 3;
     }
 
+    /* the frame ends in front of the next start code, leading zero included */
     *pbEndOfFrame = OMX_TRUE;
-    nextNaluSize = -5;
-    if (frameTypeBoundary == -1)
-        nextNaluSize = -6;
-    if (preFourByte != 0x00000001)
-        nextNaluSize++;
-    return (accessUnitSize + nextNaluSize);
+    if (offset > 0 && pInputStream[offset - 1] == 0x00)
+        offset--;
+    return offset;
 
 EXIT:
     *pbEndOfFrame = OMX_FALSE;
 
-    return accessUnitSize;
+    return buffSize;
 }
 
 OMX_BOOL Check_H264_StartCode(OMX_U8 *pInputStream, OMX_U32 streamSize)
@@ -175,6 +167,22 @@ OMX_BOOL Check_H264_StartCode(OMX_U8 *pInputStream, OMX_U32 streamSize)
     }
 }
 
+/* TRUE when one of the NAL units in the frame is an IDR slice */
+static OMX_BOOL Check_H264_IDRFrame(OMX_U8 *pInputStream, OMX_U32 streamSize)
+{
+    OMX_U32 i = 0;
+
+    for (i = 0; i + 3 < streamSize; i++) {
+        if ((pInputStream[i] == 0x00) && (pInputStream[i + 1] == 0x00) && (pInputStream[i + 2] == 0x01)) {
+            if ((pInputStream[i + 3] & 0x1F) == 5)
+                return OMX_TRUE;
+            i += 2;
+        }
+    }
+
+    return OMX_FALSE;
+}
+
 OMX_ERRORTYPE SEC_MFC_H264Dec_GetParameter(
     OMX_IN OMX_HANDLETYPE hComponent,
     OMX_IN OMX_INDEXTYPE  nParamIndex,
@@ -453,8 +461,19 @@ OMX_ERRORTYPE SEC_MFC_H264Dec_SetParameter(
             case OMX_COLOR_FormatYUV420Planar:
             case OMX_COLOR_FormatYUV420SemiPlanar:
             case OMX_SEC_COLOR_FormatNV12TPhysicalAddress:
+            case OMX_SEC_COLOR_FormatNV21Linear:
             case OMX_SEC_COLOR_FormatANBYUV420SemiPlanar:
-                pSECOutputPort->portDefinition.nBufferSize = (width * height * 3) / 2;
+            case OMX_SEC_COLOR_FormatANBNV12TPhysicalAddress:
+                pSECOutputPort->portDefinition.nBufferSize =
+                    SEC_AdaptiveOutputBufferSize(pSECOutputPort, (width * height * 3) / 2);
+                break;
+            case OMX_SEC_COLOR_FormatYVU420Planar:
+                pSECOutputPort->portDefinition.nBufferSize =
+                    SEC_AdaptiveOutputBufferSize(pSECOutputPort, YV12_FRAME_SIZE(width, height));
+                break;
+            case OMX_COLOR_Format16bitRGB565:
+                pSECOutputPort->portDefinition.nBufferSize =
+                    SEC_AdaptiveOutputBufferSize(pSECOutputPort, width * height * 2);
                 break;
             default:
                 SEC_OSAL_Log(SEC_LOG_ERROR, "Color format is not support!! use default YUV size!!");
@@ -643,6 +662,41 @@ OMX_ERRORTYPE SEC_MFC_H264Dec_SetConfig(
 
         pH264Dec->hMFCH264Handle.bThumbnailMode = *((OMX_BOOL *)pComponentConfigStructure);
 
+        /* only one picture is decoded, the ports get by with the fewest buffers */
+        if ((pH264Dec->hMFCH264Handle.bThumbnailMode == OMX_TRUE) &&
+            (pSECComponent->currentState == OMX_StateLoaded)) {
+            SEC_OMX_BASEPORT *pSECInputPort = &pSECComponent->pSECPort[INPUT_PORT_INDEX];
+            SEC_OMX_BASEPORT *pSECOutputPort = &pSECComponent->pSECPort[OUTPUT_PORT_INDEX];
+
+            if (pSECInputPort->assignedBufferNum == 0) {
+                pSECInputPort->portDefinition.nBufferCountActual = THUMBNAIL_VIDEO_INPUTBUFFER_NUM;
+                pSECInputPort->portDefinition.nBufferCountMin = THUMBNAIL_VIDEO_INPUTBUFFER_NUM;
+            }
+            if (pSECOutputPort->assignedBufferNum == 0) {
+                pSECOutputPort->portDefinition.nBufferCountActual = THUMBNAIL_VIDEO_OUTPUTBUFFER_NUM;
+                pSECOutputPort->portDefinition.nBufferCountMin = THUMBNAIL_VIDEO_OUTPUTBUFFER_NUM;
+            }
+        }
+
+        ret = OMX_ErrorNone;
+    }
+        break;
+    case OMX_IndexVendorLowDelayMode:
+    {
+        SEC_H264DEC_HANDLE   *pH264Dec = (SEC_H264DEC_HANDLE *)pSECComponent->hCodecHandle;
+
+        /* the display delay is given to the MFC when the stream header is decoded */
+        pH264Dec->hMFCH264Handle.bLowDelayMode = *((OMX_BOOL *)pComponentConfigStructure);
+
+        ret = OMX_ErrorNone;
+    }
+        break;
+    case OMX_IndexVendorFastSeekMode:
+    {
+        SEC_H264DEC_HANDLE   *pH264Dec = (SEC_H264DEC_HANDLE *)pSECComponent->hCodecHandle;
+
+        pH264Dec->hMFCH264Handle.bFastSeekMode = *((OMX_BOOL *)pComponentConfigStructure);
+
         ret = OMX_ErrorNone;
     }
         break;
@@ -697,6 +751,15 @@ OMX_ERRORTYPE SEC_MFC_H264Dec_GetExtensionIndex(
         SEC_H264DEC_HANDLE *pH264Dec = (SEC_H264DEC_HANDLE *)pSECComponent->hCodecHandle;
         *pIndexType = OMX_IndexVendorThumbnailMode;
         ret = OMX_ErrorNone;
+    } else if (SEC_OSAL_Strcmp(cParameterName, SEC_INDEX_PARAM_ENABLE_LOW_DELAY) == 0) {
+        *pIndexType = OMX_IndexVendorLowDelayMode;
+        ret = OMX_ErrorNone;
+    } else if (SEC_OSAL_Strcmp(cParameterName, SEC_INDEX_PARAM_ENABLE_FAST_SEEK) == 0) {
+        *pIndexType = OMX_IndexVendorFastSeekMode;
+        ret = OMX_ErrorNone;
+    } else if (SEC_OSAL_Strcmp(cParameterName, SEC_INDEX_PARAM_ADAPTIVE_PLAYBACK) == 0) {
+        *pIndexType = OMX_IndexParamPrepareForAdaptivePlayback;
+        ret = OMX_ErrorNone;
 #ifdef USE_ANDROID_EXTENSION
     } else if (SEC_OSAL_Strcmp(cParameterName, SEC_INDEX_PARAM_ENABLE_ANB) == 0) {
         *pIndexType = OMX_IndexParamEnableAndroidBuffers;
@@ -743,37 +806,147 @@ EXIT:
     return ret;
 }
 
-OMX_ERRORTYPE SEC_MFC_DecodeThread(OMX_HANDLETYPE hComponent)
+static OMX_PTR SEC_MFC_H264Dec_Open(SEC_H264DEC_HANDLE *pH264Dec)
 {
+    /* MFC(Multi Function Codec) decoder and CMM(Codec Memory Management) driver open */
+    if (pH264Dec->hMFCH264Handle.hMFCHandle == NULL) {
+        SSBIP_MFC_BUFFER_TYPE buf_type = CACHE;
+        pH264Dec->hMFCH264Handle.hMFCHandle = (OMX_PTR)SsbSipMfcDecOpen(&buf_type);
+    }
+
+    return pH264Dec->hMFCH264Handle.hMFCHandle;
+}
+
+/* input buffers are allocated before the Init, so they may open the MFC */
+OMX_PTR SEC_MFC_H264Dec_AllocInputBuffer(OMX_COMPONENTTYPE *pOMXComponent, OMX_U32 nSizeBytes)
+{
+    SEC_OMX_BASECOMPONENT *pSECComponent = (SEC_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
+    SEC_H264DEC_HANDLE    *pH264Dec = (SEC_H264DEC_HANDLE *)pSECComponent->hCodecHandle;
+
+    return SEC_MFC_InputPoolAlloc(pOMXComponent, &pH264Dec->MFCDecInputPool,
+                                  SEC_MFC_H264Dec_Open(pH264Dec), nSizeBytes);
+}
+
+void SEC_MFC_H264Dec_FreeInputBuffer(OMX_COMPONENTTYPE *pOMXComponent, OMX_PTR pBuffer)
+{
+    SEC_OMX_BASECOMPONENT *pSECComponent = (SEC_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
+    SEC_H264DEC_HANDLE    *pH264Dec = (SEC_H264DEC_HANDLE *)pSECComponent->hCodecHandle;
+
+    SEC_MFC_InputPoolFree(&pH264Dec->MFCDecInputPool, pBuffer);
+}
+
+/* picks the stream buffer the next frame goes to, a client buffer or the slot's own */
+OMX_ERRORTYPE SEC_MFC_H264Dec_SetInputBuffer(OMX_COMPONENTTYPE *pOMXComponent, OMX_BUFFERHEADERTYPE *pBufferHeader)
+{
+    SEC_OMX_BASECOMPONENT *pSECComponent = (SEC_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
+    SEC_H264DEC_HANDLE    *pH264Dec = (SEC_H264DEC_HANDLE *)pSECComponent->hCodecHandle;
+    MFC_DEC_INPUT_BUFFER  *pSlot = &pH264Dec->MFCDecInputBuffer[pH264Dec->indexInputBuffer];
     OMX_ERRORTYPE          ret = OMX_ErrorNone;
-    OMX_COMPONENTTYPE     *pOMXComponent = (OMX_COMPONENTTYPE *)hComponent;
-    SEC_OMX_BASECOMPONENT *pSECComponent = NULL;
-    SEC_H264DEC_HANDLE    *pH264Dec = NULL;
 
-    FunctionIn();
+    ret = SEC_MFC_InputSlotSet(pOMXComponent, &pH264Dec->MFCDecInputPool, pSlot, pBufferHeader);
 
-    if (hComponent == NULL) {
-        ret = OMX_ErrorBadParameter;
-        goto EXIT;
-    }
+    pH264Dec->hMFCH264Handle.pMFCStreamBuffer    = pSlot->StrmVirAddr;
+    pH264Dec->hMFCH264Handle.pMFCStreamPhyBuffer = pSlot->StrmPhyAddr;
+    pSECComponent->processData[INPUT_PORT_INDEX].dataBuffer = pSlot->StrmVirAddr;
+    pSECComponent->processData[INPUT_PORT_INDEX].allocSize  = pSlot->StrmSize;
 
-    pSECComponent = (SEC_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
-    pH264Dec = (SEC_H264DEC_HANDLE *)pSECComponent->hCodecHandle;
+    return ret;
+}
+
+/* returns the client buffers held by the slots, on flush */
+OMX_ERRORTYPE SEC_MFC_H264Dec_ReleaseInputBuffer(OMX_COMPONENTTYPE *pOMXComponent)
+{
+    SEC_OMX_BASECOMPONENT *pSECComponent = (SEC_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
+    SEC_H264DEC_HANDLE    *pH264Dec = (SEC_H264DEC_HANDLE *)pSECComponent->hCodecHandle;
+    int                    i = 0;
 
-    while (pH264Dec->NBDecThread.bExitDecodeThread == OMX_FALSE) {
-        SEC_OSAL_SemaphoreWait(pH264Dec->NBDecThread.hDecFrameStart);
+    /* the MFC may still be reading some of them */
+    SEC_MFC_DecodeFlush(&pH264Dec->NBDecThread);
+    /* a seek, for another thumbnail too, may land on any frame */
+    pH264Dec->hMFCH264Handle.bIDRFound = OMX_FALSE;
+    pH264Dec->hMFCH264Handle.nDroppedFrames = 0;
+    SEC_MFC_DecodeRecoveryReset(&pH264Dec->recovery);
 
-        if (pH264Dec->NBDecThread.bExitDecodeThread == OMX_FALSE) {
-            pH264Dec->hMFCH264Handle.returnCodec = SsbSipMfcDecExe(pH264Dec->hMFCH264Handle.hMFCHandle, pH264Dec->NBDecThread.oneFrameSize);
-            SEC_OSAL_SemaphorePost(pH264Dec->NBDecThread.hDecFrameEnd);
-        }
+    for (i = 0; i < MFC_INPUT_BUFFER_NUM_MAX; i++) {
+        if (pH264Dec->MFCDecInputBuffer[i].pBufferHeader != NULL)
+            SEC_MFC_InputSlotSet(pOMXComponent, &pH264Dec->MFCDecInputPool, &pH264Dec->MFCDecInputBuffer[i], NULL);
     }
 
-EXIT:
-    SEC_OSAL_ThreadExit(NULL);
-    FunctionOut();
+    if (pSECComponent->processData[INPUT_PORT_INDEX].dataBuffer != NULL)
+        SEC_MFC_H264Dec_SetInputBuffer(pOMXComponent, NULL);
 
-    return ret;
+    return OMX_ErrorNone;
+}
+
+/* pictures a width x height stream may hold back for reordering */
+static OMX_U32 SEC_MFC_H264Dec_DpbFrames(OMX_U32 width, OMX_U32 height)
+{
+    OMX_U32 frameMbs = ((width + 15) / 16) * ((height + 15) / 16);
+    OMX_U32 dpbFrames = H264_MAX_DPB_FRAMES;
+
+    if (frameMbs != 0)
+        dpbFrames = H264_MAX_DPB_MBS / frameMbs;
+
+    if (dpbFrames > H264_MAX_DPB_FRAMES)
+        dpbFrames = H264_MAX_DPB_FRAMES;
+    if (dpbFrames < 1)
+        dpbFrames = 1;
+
+    return dpbFrames;
+}
+
+/* adaptive playback: a crop the MFC reports with a picture replaces the one the client has */
+static void SEC_MFC_H264Dec_UpdateCrop(OMX_COMPONENTTYPE *pOMXComponent, SSBSIP_MFC_DEC_OUTPUT_INFO *pOutputInfo)
+{
+    SEC_OMX_BASECOMPONENT *pSECComponent = (SEC_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
+    SEC_OMX_BASEPORT      *secOutputPort = &pSECComponent->pSECPort[OUTPUT_PORT_INDEX];
+    OMX_CONFIG_RECTTYPE   *pCrop = &secOutputPort->cropRectangle;
+    OMX_S32                nWidth  = pOutputInfo->img_width - pOutputInfo->crop_left_offset - pOutputInfo->crop_right_offset;
+    OMX_S32                nHeight = pOutputInfo->img_height - pOutputInfo->crop_top_offset - pOutputInfo->crop_bottom_offset;
+
+    if ((pCrop->nLeft == pOutputInfo->crop_left_offset) && (pCrop->nTop == pOutputInfo->crop_top_offset) &&
+        (pCrop->nWidth == (OMX_U32)nWidth) && (pCrop->nHeight == (OMX_U32)nHeight))
+        return;
+
+    if ((nWidth <= 0) || (nHeight <= 0) ||
+        (SEC_AdaptiveResolutionFits(secOutputPort, pOutputInfo->img_width, pOutputInfo->img_height) == OMX_FALSE))
+        return;
+
+    pCrop->nLeft   = pOutputInfo->crop_left_offset;
+    pCrop->nTop    = pOutputInfo->crop_top_offset;
+    pCrop->nWidth  = nWidth;
+    pCrop->nHeight = nHeight;
+    SEC_OSAL_Log(SEC_LOG_TRACE, "adaptive crop %d,%d %dx%d", pCrop->nLeft, pCrop->nTop, pCrop->nWidth, pCrop->nHeight);
+
+    (*(pSECComponent->pCallbacks->EventHandler))
+          (pOMXComponent,
+           pSECComponent->callbackData,
+           OMX_EventPortSettingsChanged,
+           OMX_DirOutput,
+           OMX_IndexConfigCommonOutputCrop,
+           NULL);
+}
+
+/* reallocates the copy buffers when the stream turned out bigger, the frame being decoded moves along */
+static OMX_ERRORTYPE SEC_MFC_H264Dec_GrowInputBuffer(OMX_COMPONENTTYPE *pOMXComponent, int width, int height, OMX_U32 dataLen)
+{
+    SEC_OMX_BASECOMPONENT *pSECComponent = (SEC_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
+    SEC_H264DEC_HANDLE    *pH264Dec = (SEC_H264DEC_HANDLE *)pSECComponent->hCodecHandle;
+    MFC_DEC_INPUT_BUFFER  *pSlot = &pH264Dec->MFCDecInputBuffer[pH264Dec->indexInputBuffer];
+    OMX_ERRORTYPE          ret = OMX_ErrorNone;
+
+    ret = SEC_MFC_InputSlotsAlloc(&pH264Dec->MFCDecInputPool, pH264Dec->MFCDecInputBuffer,
+                                  pH264Dec->hMFCH264Handle.hMFCHandle, width, height,
+                                  pH264Dec->indexInputBuffer, dataLen);
+    if (ret != OMX_ErrorNone)
+        return ret;
+
+    pH264Dec->hMFCH264Handle.pMFCStreamBuffer    = pSlot->StrmVirAddr;
+    pH264Dec->hMFCH264Handle.pMFCStreamPhyBuffer = pSlot->StrmPhyAddr;
+    pSECComponent->processData[INPUT_PORT_INDEX].dataBuffer = pSlot->StrmVirAddr;
+    pSECComponent->processData[INPUT_PORT_INDEX].allocSize  = pSlot->StrmSize;
+
+    return OMX_ErrorNone;
 }
 
 /* MFC Init */
@@ -784,50 +957,38 @@ OMX_ERRORTYPE SEC_MFC_H264Dec_Init(OMX_COMPONENTTYPE *pOMXComponent)
     SEC_H264DEC_HANDLE    *pH264Dec = NULL;
 
     OMX_PTR hMFCHandle       = NULL;
-    OMX_PTR pStreamBuffer    = NULL;
-    OMX_PTR pStreamPhyBuffer = NULL;
 
     pH264Dec = (SEC_H264DEC_HANDLE *)pSECComponent->hCodecHandle;
     pH264Dec->hMFCH264Handle.bConfiguredMFC = OMX_FALSE;
     pSECComponent->bUseFlagEOF = OMX_FALSE;
     pSECComponent->bSaveFlagEOS = OMX_FALSE;
 
-    /* MFC(Multi Function Codec) decoder and CMM(Codec Memory Management) driver open */
-    SSBIP_MFC_BUFFER_TYPE buf_type = CACHE;
-    hMFCHandle = (OMX_PTR)SsbSipMfcDecOpen(&buf_type);
+    hMFCHandle = SEC_MFC_H264Dec_Open(pH264Dec);
     if (hMFCHandle == NULL) {
         ret = OMX_ErrorInsufficientResources;
         goto EXIT;
     }
-    pH264Dec->hMFCH264Handle.hMFCHandle = hMFCHandle;
 
-    /* Allocate decoder's input buffer */
-    pStreamBuffer = SsbSipMfcDecGetInBuf(hMFCHandle, &pStreamPhyBuffer, DEFAULT_MFC_INPUT_BUFFER_SIZE * MFC_INPUT_BUFFER_NUM_MAX);
-    if (pStreamBuffer == NULL) {
-        ret = OMX_ErrorInsufficientResources;
+    /*
+     * Allocate decoder's input buffers for the size the client set, the pool
+     * of the client buffers starts with them. the header may grow them.
+     */
+    SEC_OSAL_Memset(pH264Dec->MFCDecInputBuffer, 0, sizeof(pH264Dec->MFCDecInputBuffer));
+    ret = SEC_MFC_InputSlotsAlloc(&pH264Dec->MFCDecInputPool, pH264Dec->MFCDecInputBuffer, hMFCHandle,
+                                  pSECComponent->pSECPort[INPUT_PORT_INDEX].portDefinition.format.video.nFrameWidth,
+                                  pSECComponent->pSECPort[INPUT_PORT_INDEX].portDefinition.format.video.nFrameHeight,
+                                  0, 0);
+    if (ret != OMX_ErrorNone)
         goto EXIT;
-    }
-
-    pH264Dec->MFCDecInputBuffer[0].VirAddr = pStreamBuffer;
-    pH264Dec->MFCDecInputBuffer[0].PhyAddr = pStreamPhyBuffer;
-    pH264Dec->MFCDecInputBuffer[0].bufferSize = DEFAULT_MFC_INPUT_BUFFER_SIZE;
-    pH264Dec->MFCDecInputBuffer[0].dataSize = 0;
-    pH264Dec->MFCDecInputBuffer[1].VirAddr = (unsigned char *)pStreamBuffer + pH264Dec->MFCDecInputBuffer[0].bufferSize;
-    pH264Dec->MFCDecInputBuffer[1].PhyAddr = (unsigned char *)pStreamPhyBuffer + pH264Dec->MFCDecInputBuffer[0].bufferSize;
-    pH264Dec->MFCDecInputBuffer[1].bufferSize = DEFAULT_MFC_INPUT_BUFFER_SIZE;
-    pH264Dec->MFCDecInputBuffer[1].dataSize = 0;
     pH264Dec->indexInputBuffer = 0;
 
     pH264Dec->bFirstFrame = OMX_TRUE;
+    pH264Dec->hMFCH264Handle.bIDRFound = OMX_FALSE;
+    pH264Dec->hMFCH264Handle.nDroppedFrames = 0;
+    SEC_OSAL_Memset(&pH264Dec->recovery, 0, sizeof(pH264Dec->recovery));
+    SEC_FIMC_CscInit(&pH264Dec->fimcCsc);
 
-    pH264Dec->NBDecThread.bExitDecodeThread = OMX_FALSE;
-    pH264Dec->NBDecThread.bDecoderRun = OMX_FALSE;
-    pH264Dec->NBDecThread.oneFrameSize = 0;
-    SEC_OSAL_SemaphoreCreate(&(pH264Dec->NBDecThread.hDecFrameStart));
-    SEC_OSAL_SemaphoreCreate(&(pH264Dec->NBDecThread.hDecFrameEnd));
-    if (OMX_ErrorNone == SEC_OSAL_ThreadCreate(&pH264Dec->NBDecThread.hNBDecodeThread,
-                                                SEC_MFC_DecodeThread,
-                                                pOMXComponent)) {
+    if (OMX_ErrorNone == SEC_MFC_DecodeThreadCreate(&pH264Dec->NBDecThread, hMFCHandle, &pSECComponent->trace, &pSECComponent->mfcSession)) {
         pH264Dec->hMFCH264Handle.returnCodec = MFC_RET_OK;
     }
 
@@ -836,8 +997,10 @@ OMX_ERRORTYPE SEC_MFC_H264Dec_Init(OMX_COMPONENTTYPE *pOMXComponent)
     pSECComponent->processData[INPUT_PORT_INDEX].dataBuffer = pH264Dec->MFCDecInputBuffer[0].VirAddr;
     pSECComponent->processData[INPUT_PORT_INDEX].allocSize  = pH264Dec->MFCDecInputBuffer[0].bufferSize;
 
-    SEC_OSAL_Memset(pSECComponent->timeStamp, -19771003, sizeof(OMX_TICKS) * MAX_TIMESTAMP);
-    SEC_OSAL_Memset(pSECComponent->nFlags, 0, sizeof(OMX_U32) * MAX_FLAGS);
+    SEC_OMX_TimestampMapReset(&pSECComponent->timestampMap);
+    SEC_OMX_TimestampMapSetDepth(&pSECComponent->timestampMap,
+        MFC_DEC_TIMESTAMP_DEPTH(SEC_MFC_H264Dec_DpbFrames(pSECComponent->pSECPort[INPUT_PORT_INDEX].portDefinition.format.video.nFrameWidth,
+                                                          pSECComponent->pSECPort[INPUT_PORT_INDEX].portDefinition.format.video.nFrameHeight)));
     pH264Dec->hMFCH264Handle.indexTimestamp = 0;
     pSECComponent->getAllDelayBuffer = OMX_FALSE;
 
@@ -863,27 +1026,17 @@ OMX_ERRORTYPE SEC_MFC_H264Dec_Terminate(OMX_COMPONENTTYPE *pOMXComponent)
     pSECComponent->processData[INPUT_PORT_INDEX].dataBuffer = NULL;
     pSECComponent->processData[INPUT_PORT_INDEX].allocSize = 0;
 
-    if (pH264Dec->NBDecThread.hNBDecodeThread != NULL) {
-        pH264Dec->NBDecThread.bExitDecodeThread = OMX_TRUE;
-        SEC_OSAL_SemaphorePost(pH264Dec->NBDecThread.hDecFrameStart);
-        SEC_OSAL_ThreadTerminate(pH264Dec->NBDecThread.hNBDecodeThread);
-        pH264Dec->NBDecThread.hNBDecodeThread = NULL;
-    }
-
-    if(pH264Dec->NBDecThread.hDecFrameEnd != NULL) {
-        SEC_OSAL_SemaphoreTerminate(pH264Dec->NBDecThread.hDecFrameEnd);
-        pH264Dec->NBDecThread.hDecFrameEnd = NULL;
-    }
-
-    if(pH264Dec->NBDecThread.hDecFrameStart != NULL) {
-        SEC_OSAL_SemaphoreTerminate(pH264Dec->NBDecThread.hDecFrameStart);
-        pH264Dec->NBDecThread.hDecFrameStart = NULL;
-    }
+    SEC_MFC_DecodeThreadTerminate(&pH264Dec->NBDecThread);
+    SEC_FIMC_CscDeinit(&pH264Dec->fimcCsc);
+    SEC_MFC_DecodeRecoveryReport(&pH264Dec->recovery, pSECComponent->componentName);
 
     if (hMFCHandle != NULL) {
         SsbSipMfcDecClose(hMFCHandle);
         hMFCHandle = pH264Dec->hMFCH264Handle.hMFCHandle = NULL;
     }
+    /* the stream memory is gone with the handle, the client frees its buffers after this */
+    SEC_OSAL_Memset(&pH264Dec->MFCDecInputPool, 0, sizeof(MFC_DEC_INPUT_POOL));
+    SEC_OSAL_Memset(pH264Dec->MFCDecInputBuffer, 0, sizeof(pH264Dec->MFCDecInputBuffer));
 
 EXIT:
     FunctionOut();
@@ -902,6 +1055,10 @@ OMX_ERRORTYPE SEC_MFC_H264_Decode(OMX_COMPONENTTYPE *pOMXComponent, SEC_OMX_DATA
     int                        bufWidth = 0;
     int                        bufHeight = 0;
     OMX_BOOL                   outputDataValid = OMX_FALSE;
+    OMX_BOOL                   bQueue = OMX_FALSE;
+    OMX_BOOL                   bHoldInput = OMX_FALSE;
+    OMX_BOOL                   bDropInput = OMX_FALSE;
+    OMX_BOOL                   bPictureHeld = OMX_FALSE;
 
     FunctionIn();
 
@@ -915,11 +1072,19 @@ OMX_ERRORTYPE SEC_MFC_H264_Decode(OMX_COMPONENTTYPE *pOMXComponent, SEC_OMX_DATA
             goto EXIT;
         }
 
-        setConfVal = 0;
+        /* the decoded pictures queued behind the current one need room in the DPB */
+        setConfVal = MFC_DEC_EXTRA_BUFFER_NUM;
+        if (pSECComponent->pSECPort[OUTPUT_PORT_INDEX].portDefinition.format.video.eColorFormat ==
+            OMX_SEC_COLOR_FormatANBNV12TPhysicalAddress)
+            setConfVal += MFC_DEC_DISPLAY_EXTRA_BUFFER_NUM;
         SsbSipMfcDecSetConfig(pH264Dec->hMFCH264Handle.hMFCHandle, MFC_DEC_SETCONF_EXTRA_BUFFER_NUM, &setConfVal);
 
         /* Default number in the driver is optimized */
-        if (pH264Dec->hMFCH264Handle.bThumbnailMode == OMX_TRUE) {
+        if (pH264Dec->hMFCH264Handle.bLowDelayMode == OMX_TRUE) {
+            /* every picture is output as soon as it is decoded */
+            setConfVal = 0;
+            SsbSipMfcDecSetConfig(pH264Dec->hMFCH264Handle.hMFCHandle, MFC_DEC_SETCONF_DISPLAY_DELAY, &setConfVal);
+        } else if (pH264Dec->hMFCH264Handle.bThumbnailMode == OMX_TRUE) {
             setConfVal = 1;
             SsbSipMfcDecSetConfig(pH264Dec->hMFCH264Handle.hMFCHandle, MFC_DEC_SETCONF_DISPLAY_DELAY, &setConfVal);
         } else {
@@ -927,6 +1092,11 @@ OMX_ERRORTYPE SEC_MFC_H264_Decode(OMX_COMPONENTTYPE *pOMXComponent, SEC_OMX_DATA
             SsbSipMfcDecSetConfig(pH264Dec->hMFCH264Handle.hMFCHandle, MFC_DEC_SETCONF_DISPLAY_DELAY, &setConfVal);
         }
 
+        /* the first frame may sit in a client buffer */
+        SsbSipMfcDecSetInBuf(pH264Dec->hMFCH264Handle.hMFCHandle,
+                             pH264Dec->hMFCH264Handle.pMFCStreamPhyBuffer,
+                             pH264Dec->hMFCH264Handle.pMFCStreamBuffer,
+                             pSECComponent->processData[INPUT_PORT_INDEX].allocSize);
         pH264Dec->hMFCH264Handle.returnCodec = SsbSipMfcDecInit(pH264Dec->hMFCH264Handle.hMFCHandle, eCodecType, oneFrameSize);
         if (pH264Dec->hMFCH264Handle.returnCodec == MFC_RET_OK) {
             SSBSIP_MFC_IMG_RESOLUTION imgResol;
@@ -974,6 +1144,10 @@ OMX_ERRORTYPE SEC_MFC_H264_Decode(OMX_COMPONENTTYPE *pOMXComponent, SEC_OMX_DATA
                        NULL);
             } else if((secInputPort->portDefinition.format.video.nFrameWidth != imgResol.width) ||
                       (secInputPort->portDefinition.format.video.nFrameHeight != imgResol.height)) {
+                /* within the adaptive maximum the output buffers stay, only the crop moves */
+                OMX_U32 eventData = SEC_AdaptiveResolutionFits(secOutputPort, imgResol.width, imgResol.height) ?
+                                    OMX_IndexConfigCommonOutputCrop : 0;
+
                 SEC_OSAL_Log(SEC_LOG_TRACE, "change width height information : OMX_EventPortSettingsChanged");
                 /* change width and height information */
                 secInputPort->portDefinition.format.video.nFrameWidth = imgResol.width;
@@ -989,10 +1163,18 @@ OMX_ERRORTYPE SEC_MFC_H264_Decode(OMX_COMPONENTTYPE *pOMXComponent, SEC_OMX_DATA
                        pSECComponent->callbackData,
                        OMX_EventPortSettingsChanged, /* The command was completed */
                        OMX_DirOutput, /* This is the port index */
-                       0,
+                       eventData,
                        NULL);
             }
 
+            /* the SPS may be bigger than the client said */
+            if (SEC_MFC_H264Dec_GrowInputBuffer(pOMXComponent, imgResol.width, imgResol.height, oneFrameSize) != OMX_ErrorNone) {
+                ret = OMX_ErrorInsufficientResources;
+                goto EXIT;
+            }
+            SEC_OMX_TimestampMapSetDepth(&pSECComponent->timestampMap,
+                MFC_DEC_TIMESTAMP_DEPTH(SEC_MFC_H264Dec_DpbFrames(imgResol.width, imgResol.height)));
+
 #ifdef ADD_SPS_PPS_I_FRAME
             ret = OMX_ErrorInputDataDecodeYet;
 #else
@@ -1014,31 +1196,72 @@ OMX_ERRORTYPE SEC_MFC_H264_Decode(OMX_COMPONENTTYPE *pOMXComponent, SEC_OMX_DATA
         pSECComponent->bUseFlagEOF = OMX_TRUE;
 #endif
 
-    pSECComponent->timeStamp[pH264Dec->hMFCH264Handle.indexTimestamp] = pInputData->timeStamp;
-    pSECComponent->nFlags[pH264Dec->hMFCH264Handle.indexTimestamp] = pInputData->nFlags;
+    /*
+     * a thumbnail is taken from the first picture that decodes on its own,
+     * a fast seek shows it first. frames before it are dropped, a fast seek
+     * does not wait for a stream without IDRs for long.
+     */
+    if (((pH264Dec->hMFCH264Handle.bThumbnailMode == OMX_TRUE) ||
+         ((pH264Dec->hMFCH264Handle.bFastSeekMode == OMX_TRUE) &&
+          (pH264Dec->hMFCH264Handle.nDroppedFrames < H264_FAST_SEEK_DROP_MAX))) &&
+        (pH264Dec->hMFCH264Handle.bIDRFound == OMX_FALSE) &&
+        ((pInputData->nFlags & OMX_BUFFERFLAG_EOS) != OMX_BUFFERFLAG_EOS)) {
+        if (Check_H264_IDRFrame(pInputData->dataBuffer, oneFrameSize) == OMX_FALSE) {
+            SEC_OSAL_Log(SEC_LOG_TRACE, "frame before the first IDR dropped");
+            pH264Dec->hMFCH264Handle.nDroppedFrames++;
+            pOutputData->timeStamp = pInputData->timeStamp;
+            pOutputData->nFlags = pInputData->nFlags;
+            ret = OMX_ErrorNone;
+            goto EXIT;
+        }
+        pH264Dec->hMFCH264Handle.bIDRFound = OMX_TRUE;
+    }
+
+    /*
+     * the EOS and thumbnail handling below wants one frame in the MFC at a
+     * time, and so does low delay: a queued frame would wait for the next one
+     */
+    if ((pH264Dec->hMFCH264Handle.bThumbnailMode == OMX_FALSE) &&
+        (pH264Dec->hMFCH264Handle.bLowDelayMode == OMX_FALSE) &&
+        (pSECComponent->bSaveFlagEOS == OMX_FALSE) &&
+        (pSECComponent->getAllDelayBuffer == OMX_FALSE) &&
+        ((pInputData->nFlags & OMX_BUFFERFLAG_EOS) != OMX_BUFFERFLAG_EOS))
+        bQueue = OMX_TRUE;
 
     if ((pH264Dec->hMFCH264Handle.returnCodec == MFC_RET_OK) &&
+        (pH264Dec->bFirstFrame == OMX_FALSE) &&
+        (bQueue == OMX_TRUE) &&
+        (pH264Dec->NBDecThread.nJobs < MFC_INPUT_BUFFER_NUM_MAX - 1) &&
+        (SEC_MFC_DecodeResultReady(&pH264Dec->NBDecThread) == OMX_FALSE)) {
+        /* nothing decoded yet and the next slot is free, keep feeding the MFC */
+        pOutputData->timeStamp = pInputData->timeStamp;
+        pOutputData->nFlags = pInputData->nFlags;
+        outputDataValid = OMX_FALSE;
+        ret = OMX_ErrorNone;
+    } else if ((pH264Dec->hMFCH264Handle.returnCodec == MFC_RET_OK) &&
         (pH264Dec->bFirstFrame == OMX_FALSE)) {
         SSBSIP_MFC_DEC_OUTBUF_STATUS status;
         OMX_S32 indexTimestamp = 0;
+        MFC_DEC_RESULT result;
 
         /* wait for mfc decode done */
-        if (pH264Dec->NBDecThread.bDecoderRun == OMX_TRUE) {
-            SEC_OSAL_SemaphoreWait(pH264Dec->NBDecThread.hDecFrameEnd);
-            pH264Dec->NBDecThread.bDecoderRun = OMX_FALSE;
-        }
+        SEC_MFC_DecodeResultGet(&pH264Dec->NBDecThread, &result);
+        bPictureHeld = result.bPicture;
 
-        status = SsbSipMfcDecGetOutBuf(pH264Dec->hMFCH264Handle.hMFCHandle, &outputInfo);
+        status = result.status;
+        if (result.returnCodec != MFC_RET_OK) {
+            SEC_MFC_DecodeRecoveryStart(&pH264Dec->recovery, result.returnCodec);
+            status = MFC_GETOUTBUF_DECODING_ONLY;
+        }
+        outputInfo = result.outputInfo;
+        indexTimestamp = result.indexTimestamp;
         bufWidth  = (outputInfo.img_width + 15) & (~15);
         bufHeight = (outputInfo.img_height + 15) & (~15);
 
-        if ((SsbSipMfcDecGetConfig(pH264Dec->hMFCH264Handle.hMFCHandle, MFC_DEC_GETCONF_FRAME_TAG, &indexTimestamp) != MFC_RET_OK) ||
-            (((indexTimestamp < 0) || (indexTimestamp >= MAX_TIMESTAMP)))) {
+        if (SEC_OMX_TimestampMapGet(&pSECComponent->timestampMap, indexTimestamp,
+                                    &pOutputData->timeStamp, &pOutputData->nFlags) == OMX_FALSE) {
             pOutputData->timeStamp = pInputData->timeStamp;
             pOutputData->nFlags = (pInputData->nFlags & (~OMX_BUFFERFLAG_EOS));
-        } else {
-            pOutputData->timeStamp = pSECComponent->timeStamp[indexTimestamp];
-            pOutputData->nFlags = pSECComponent->nFlags[indexTimestamp];
         }
         SEC_OSAL_Log(SEC_LOG_TRACE, "timestamp %lld us (%.2f secs)", pOutputData->timeStamp, pOutputData->timeStamp / 1E6);
 
@@ -1048,6 +1271,25 @@ OMX_ERRORTYPE SEC_MFC_H264_Decode(OMX_COMPONENTTYPE *pOMXComponent, SEC_OMX_DATA
         }
         if (pOutputData->nFlags & OMX_BUFFERFLAG_EOS)
             outputDataValid = OMX_FALSE;
+        if ((outputDataValid == OMX_TRUE) &&
+            (SEC_MFC_DecodeRecoveryCorrupt(&pH264Dec->recovery, pOutputData->timeStamp) == OMX_TRUE))
+            pOutputData->nFlags |= OMX_BUFFERFLAG_DATACORRUPT;
+
+        if ((outputDataValid == OMX_TRUE) &&
+            (pSECComponent->pSECPort[OUTPUT_PORT_INDEX].bAdaptivePlayback == OMX_TRUE))
+            SEC_MFC_H264Dec_UpdateCrop(pOMXComponent, &outputInfo);
+
+        if ((pH264Dec->NBDecThread.nJobs > 0) || (result.bLastRun == OMX_FALSE)) {
+            /*
+             * more pictures are on the way. the input waits for a free slot,
+             * or out of the queue mode for the last one, which goes through
+             * the handling below
+             */
+            if ((bQueue == OMX_FALSE) || (pH264Dec->NBDecThread.nJobs >= MFC_INPUT_BUFFER_NUM_MAX - 1))
+                bHoldInput = OMX_TRUE;
+            ret = OMX_ErrorNone;
+            goto DECODE_RESULT_DONE;
+        }
 
         if ((status == MFC_GETOUTBUF_DISPLAY_ONLY) ||
             (pSECComponent->getAllDelayBuffer == OMX_TRUE))
@@ -1105,44 +1347,51 @@ OMX_ERRORTYPE SEC_MFC_H264_Decode(OMX_COMPONENTTYPE *pOMXComponent, SEC_OMX_DATA
         ret = OMX_ErrorNone;
     }
 
+DECODE_RESULT_DONE:
     if (ret == OMX_ErrorInputDataDecodeYet) {
+        /* feed the previous stream buffer again */
         pH264Dec->MFCDecInputBuffer[pH264Dec->indexInputBuffer].dataSize = oneFrameSize;
-        pH264Dec->indexInputBuffer++;
+        pH264Dec->indexInputBuffer += MFC_INPUT_BUFFER_NUM_MAX - 1;
         pH264Dec->indexInputBuffer %= MFC_INPUT_BUFFER_NUM_MAX;
-        pH264Dec->hMFCH264Handle.pMFCStreamBuffer    = pH264Dec->MFCDecInputBuffer[pH264Dec->indexInputBuffer].VirAddr;
-        pH264Dec->hMFCH264Handle.pMFCStreamPhyBuffer = pH264Dec->MFCDecInputBuffer[pH264Dec->indexInputBuffer].PhyAddr;
-        pSECComponent->processData[INPUT_PORT_INDEX].dataBuffer = pH264Dec->MFCDecInputBuffer[pH264Dec->indexInputBuffer].VirAddr;
-        pSECComponent->processData[INPUT_PORT_INDEX].allocSize = pH264Dec->MFCDecInputBuffer[pH264Dec->indexInputBuffer].bufferSize;
+        pH264Dec->hMFCH264Handle.pMFCStreamBuffer    = pH264Dec->MFCDecInputBuffer[pH264Dec->indexInputBuffer].StrmVirAddr;
+        pH264Dec->hMFCH264Handle.pMFCStreamPhyBuffer = pH264Dec->MFCDecInputBuffer[pH264Dec->indexInputBuffer].StrmPhyAddr;
+        pSECComponent->processData[INPUT_PORT_INDEX].dataBuffer = pH264Dec->MFCDecInputBuffer[pH264Dec->indexInputBuffer].StrmVirAddr;
+        pSECComponent->processData[INPUT_PORT_INDEX].allocSize = pH264Dec->MFCDecInputBuffer[pH264Dec->indexInputBuffer].StrmSize;
         oneFrameSize = pH264Dec->MFCDecInputBuffer[pH264Dec->indexInputBuffer].dataSize;
         //pInputData->dataLen = oneFrameSize;
         //pInputData->remainDataLen = oneFrameSize;
     }
 
-    if ((Check_H264_StartCode(pInputData->dataBuffer, pInputData->dataLen) == OMX_TRUE) &&
-        ((pOutputData->nFlags & OMX_BUFFERFLAG_EOS) != OMX_BUFFERFLAG_EOS)) {
-        SsbSipMfcDecSetConfig(pH264Dec->hMFCH264Handle.hMFCHandle, MFC_DEC_SETCONF_FRAME_TAG, &(pH264Dec->hMFCH264Handle.indexTimestamp));
-        pH264Dec->hMFCH264Handle.indexTimestamp++;
-        pH264Dec->hMFCH264Handle.indexTimestamp %= MAX_TIMESTAMP;
-
-        SsbSipMfcDecSetInBuf(pH264Dec->hMFCH264Handle.hMFCHandle,
-                             pH264Dec->hMFCH264Handle.pMFCStreamPhyBuffer,
-                             pH264Dec->hMFCH264Handle.pMFCStreamBuffer,
-                             pSECComponent->processData[INPUT_PORT_INDEX].allocSize);
+    /* after a failed run only an IDR goes to the MFC, the pictures keep coming out */
+    if ((bHoldInput == OMX_FALSE) &&
+        (ret != OMX_ErrorInputDataDecodeYet) &&
+        ((pInputData->nFlags & OMX_BUFFERFLAG_EOS) != OMX_BUFFERFLAG_EOS) &&
+        (SEC_MFC_DecodeRecoveryDrop(&pH264Dec->recovery,
+                                    Check_H264_IDRFrame(pInputData->dataBuffer, oneFrameSize),
+                                    pInputData->timeStamp) == OMX_TRUE)) {
+        SEC_OSAL_Log(SEC_LOG_TRACE, "frame before the recovery IDR dropped");
+        bDropInput = OMX_TRUE;
+    }
 
+    if ((bHoldInput == OMX_FALSE) &&
+        (bDropInput == OMX_FALSE) &&
+        (Check_H264_StartCode(pInputData->dataBuffer, pInputData->dataLen) == OMX_TRUE) &&
+        ((pOutputData->nFlags & OMX_BUFFERFLAG_EOS) != OMX_BUFFERFLAG_EOS)) {
         pH264Dec->MFCDecInputBuffer[pH264Dec->indexInputBuffer].dataSize = oneFrameSize;
-        pH264Dec->NBDecThread.oneFrameSize = oneFrameSize;
 
         /* mfc decode start */
-        SEC_OSAL_SemaphorePost(pH264Dec->NBDecThread.hDecFrameStart);
-        pH264Dec->NBDecThread.bDecoderRun = OMX_TRUE;
+        pH264Dec->hMFCH264Handle.indexTimestamp = SEC_OMX_TimestampMapPut(&pSECComponent->timestampMap,
+                                                                          pInputData->timeStamp, pInputData->nFlags);
+        SEC_MFC_DecodeJobPut(&pH264Dec->NBDecThread, &pH264Dec->MFCDecInputBuffer[pH264Dec->indexInputBuffer],
+                             oneFrameSize, pH264Dec->hMFCH264Handle.indexTimestamp, bQueue);
         pH264Dec->hMFCH264Handle.returnCodec = MFC_RET_OK;
 
         pH264Dec->indexInputBuffer++;
         pH264Dec->indexInputBuffer %= MFC_INPUT_BUFFER_NUM_MAX;
-        pH264Dec->hMFCH264Handle.pMFCStreamBuffer    = pH264Dec->MFCDecInputBuffer[pH264Dec->indexInputBuffer].VirAddr;
-        pH264Dec->hMFCH264Handle.pMFCStreamPhyBuffer = pH264Dec->MFCDecInputBuffer[pH264Dec->indexInputBuffer].PhyAddr;
-        pSECComponent->processData[INPUT_PORT_INDEX].dataBuffer = pH264Dec->MFCDecInputBuffer[pH264Dec->indexInputBuffer].VirAddr;
-        pSECComponent->processData[INPUT_PORT_INDEX].allocSize = pH264Dec->MFCDecInputBuffer[pH264Dec->indexInputBuffer].bufferSize;
+        pH264Dec->hMFCH264Handle.pMFCStreamBuffer    = pH264Dec->MFCDecInputBuffer[pH264Dec->indexInputBuffer].StrmVirAddr;
+        pH264Dec->hMFCH264Handle.pMFCStreamPhyBuffer = pH264Dec->MFCDecInputBuffer[pH264Dec->indexInputBuffer].StrmPhyAddr;
+        pSECComponent->processData[INPUT_PORT_INDEX].dataBuffer = pH264Dec->MFCDecInputBuffer[pH264Dec->indexInputBuffer].StrmVirAddr;
+        pSECComponent->processData[INPUT_PORT_INDEX].allocSize = pH264Dec->MFCDecInputBuffer[pH264Dec->indexInputBuffer].StrmSize;
         if (((pH264Dec->hMFCH264Handle.bThumbnailMode == OMX_TRUE) || (pSECComponent->bSaveFlagEOS == OMX_TRUE)) &&
             (pH264Dec->bFirstFrame == OMX_TRUE) &&
             (outputDataValid == OMX_FALSE)) {
@@ -1151,6 +1400,10 @@ OMX_ERRORTYPE SEC_MFC_H264_Decode(OMX_COMPONENTTYPE *pOMXComponent, SEC_OMX_DATA
         pH264Dec->bFirstFrame = OMX_FALSE;
     }
 
+    /* the input stays in its slot and comes back with the next call */
+    if (bHoldInput == OMX_TRUE)
+        ret = OMX_ErrorInputDataDecodeYet;
+
     /** Fill Output Buffer **/
     if (outputDataValid == OMX_TRUE) {
         SEC_OMX_BASEPORT *pSECInputPort = &pSECComponent->pSECPort[INPUT_PORT_INDEX];
@@ -1169,7 +1422,8 @@ OMX_ERRORTYPE SEC_MFC_H264_Decode(OMX_COMPONENTTYPE *pOMXComponent, SEC_OMX_DATA
         pOutputBuf[2] = (void *)pOutputData->dataBuffer + ((actualImageSize * 5) / 4);
 
 #ifdef USE_ANDROID_EXTENSION
-        if (pSECOutputPort->bUseAndroidNativeBuffer == OMX_TRUE) {
+        if ((pSECOutputPort->bUseAndroidNativeBuffer == OMX_TRUE) &&
+            (pSECOutputPort->portDefinition.format.video.eColorFormat != OMX_SEC_COLOR_FormatANBNV12TPhysicalAddress)) {
             OMX_U32 retANB = 0;
             void *pVirAddrs[2];
             actualWidth  = (outputInfo.img_width + 15) & (~15);
@@ -1198,6 +1452,22 @@ OMX_ERRORTYPE SEC_MFC_H264_Decode(OMX_COMPONENTTYPE *pOMXComponent, SEC_OMX_DATA
             SEC_OSAL_Memcpy(pOutputBuf[0] + sizeof(frameSize) + (sizeof(void *) * 2), &(outputInfo.YVirAddr), sizeof(outputInfo.YVirAddr));
             SEC_OSAL_Memcpy(pOutputBuf[0] + sizeof(frameSize) + (sizeof(void *) * 3), &(outputInfo.CVirAddr), sizeof(outputInfo.CVirAddr));
             pOutputData->dataLen = (bufWidth * bufHeight * 3) / 2;
+        } else if (pSECOutputPort->portDefinition.format.video.eColorFormat == OMX_SEC_COLOR_FormatANBNV12TPhysicalAddress) {
+            /* the display takes the picture straight from the DPB */
+            MFC_DEC_ANB_ADDRS *pAddrs = (MFC_DEC_ANB_ADDRS *)pOutputData->specificBufferHeader.YVirAddr;
+
+            if (pAddrs == NULL) {
+                SEC_OSAL_Log(SEC_LOG_ERROR, "native buffer 0x%x is not mapped", pOutputData->dataBuffer);
+                ret = OMX_ErrorOverflow;
+                goto EXIT;
+            }
+            SEC_OSAL_Log(SEC_LOG_TRACE, "NV12T out by address");
+            pAddrs->addrY    = (unsigned int)outputInfo.YPhyAddr;
+            pAddrs->addrCbCr = (unsigned int)outputInfo.CPhyAddr;
+            pAddrs->bufIndex = 0;
+            pAddrs->reserved = 0;
+            SEC_OMX_TraceCaptureStamp(&pSECComponent->trace, pOutputData->timeStamp, (OMX_PTR)(pAddrs + 1));
+            pOutputData->dataLen = (bufWidth * bufHeight * 3) / 2;
         } else {
             switch (pSECOutputPort->portDefinition.format.video.eColorFormat) {
             case OMX_COLOR_FormatYUV420Planar:
@@ -1217,10 +1487,69 @@ OMX_ERRORTYPE SEC_MFC_H264_Decode(OMX_COMPONENTTYPE *pOMXComponent, SEC_OMX_DATA
                 pOutputData->dataLen = actualImageSize * 3 / 2;
             }
                 break;
+            case OMX_SEC_COLOR_FormatNV21Linear:
+            {
+                SEC_OSAL_Log(SEC_LOG_TRACE, "NV21 out");
+                csc_tiled_to_nv21(
+                    (char *)pOutputBuf[0],
+                    (char *)pOutputBuf[1],
+                    (char *)outputInfo.YVirAddr,
+                    (char *)outputInfo.CVirAddr,
+                    actualWidth,
+                    actualHeight);
+                pOutputData->dataLen = actualImageSize * 3 / 2;
+            }
+                break;
+            case OMX_SEC_COLOR_FormatYVU420Planar:
+            {
+                int yStride  = YV12_Y_STRIDE(actualWidth);
+                int uvStride = YV12_UV_STRIDE(actualWidth);
+                char *pV = (char *)pOutputData->dataBuffer + (yStride * actualHeight);
+                char *pU = pV + (uvStride * (actualHeight >> 1));
+
+                SEC_OSAL_Log(SEC_LOG_TRACE, "YV12 out");
+                csc_tiled_to_yv12(
+                    (char *)pOutputData->dataBuffer,
+                    pV,
+                    pU,
+                    (char *)outputInfo.YVirAddr,
+                    (char *)outputInfo.CVirAddr,
+                    actualWidth,
+                    actualHeight,
+                    yStride,
+                    uvStride);
+                pOutputData->dataLen = YV12_FRAME_SIZE(actualWidth, actualHeight);
+            }
+                break;
+            case OMX_COLOR_Format16bitRGB565:
+            {
+                SEC_OSAL_Log(SEC_LOG_TRACE, "RGB565 out");
+                csc_tiled_to_rgb565(
+                    (char *)pOutputData->dataBuffer,
+                    (char *)outputInfo.YVirAddr,
+                    (char *)outputInfo.CVirAddr,
+                    actualWidth,
+                    actualHeight,
+                    actualWidth * 2,
+                    0);
+                pOutputData->dataLen = actualWidth * actualHeight * 2;
+            }
+                break;
             case OMX_COLOR_FormatYUV420SemiPlanar:
             case OMX_SEC_COLOR_FormatANBYUV420SemiPlanar:
             default:
             {
+#if defined(USE_ANDROID_EXTENSION) && defined(USE_FIMC_CSC)
+                /* the CPU converts what the FIMC can't take, or while it is busy */
+                if ((pSECOutputPort->bUseAndroidNativeBuffer == OMX_TRUE) &&
+                    (SEC_FIMC_CscTiledToANB(&pH264Dec->fimcCsc, outputInfo.YPhyAddr, outputInfo.CPhyAddr,
+                                            outputInfo.buf_width, outputInfo.buf_height,
+                                            pOutputData->dataBuffer, actualWidth, actualHeight) == OMX_ErrorNone)) {
+                    SEC_OSAL_Log(SEC_LOG_TRACE, "YUV420SP out by FIMC");
+                    pOutputData->dataLen = actualImageSize * 3 / 2;
+                    break;
+                }
+#endif
                 SEC_OSAL_Log(SEC_LOG_TRACE, "YUV420SP out");
                 csc_tiled_to_linear(
                     (unsigned char *)pOutputBuf[0],
@@ -1238,7 +1567,8 @@ OMX_ERRORTYPE SEC_MFC_H264_Decode(OMX_COMPONENTTYPE *pOMXComponent, SEC_OMX_DATA
             }
         }
 #ifdef USE_ANDROID_EXTENSION
-        if (pSECOutputPort->bUseAndroidNativeBuffer == OMX_TRUE)
+        if ((pSECOutputPort->bUseAndroidNativeBuffer == OMX_TRUE) &&
+            (pSECOutputPort->portDefinition.format.video.eColorFormat != OMX_SEC_COLOR_FormatANBNV12TPhysicalAddress))
             putVADDRtoANB(pOutputData->dataBuffer);
 #endif
     } else {
@@ -1246,6 +1576,9 @@ OMX_ERRORTYPE SEC_MFC_H264_Decode(OMX_COMPONENTTYPE *pOMXComponent, SEC_OMX_DATA
     }
 
 EXIT:
+    /* the next run of the MFC could already go on while this picture was converted */
+    if (bPictureHeld == OMX_TRUE)
+        SEC_MFC_DecodePictureDone(&pH264Dec->NBDecThread);
     FunctionOut();
 
     return ret;
@@ -1422,6 +1755,11 @@ OSCL_EXPORT_REF OMX_ERRORTYPE SEC_OMX_ComponentInit(OMX_HANDLETYPE hComponent, O
     pSECComponent->sec_mfc_bufferProcess      = &SEC_MFC_H264Dec_bufferProcess;
     pSECComponent->sec_checkInputFrame        = &Check_H264_Frame;
 
+    pSECComponent->sec_mfc_allocInputBuffer   = &SEC_MFC_H264Dec_AllocInputBuffer;
+    pSECComponent->sec_mfc_freeInputBuffer    = &SEC_MFC_H264Dec_FreeInputBuffer;
+    pSECComponent->sec_mfc_setInputBuffer     = &SEC_MFC_H264Dec_SetInputBuffer;
+    pSECComponent->sec_mfc_releaseInputBuffer = &SEC_MFC_H264Dec_ReleaseInputBuffer;
+
     pSECComponent->currentState = OMX_StateLoaded;
 
     ret = OMX_ErrorNone;
@@ -1453,6 +1791,9 @@ OMX_ERRORTYPE SEC_OMX_ComponentDeinit(OMX_HANDLETYPE hComponent)
 
     pH264Dec = (SEC_H264DEC_HANDLE *)pSECComponent->hCodecHandle;
     if (pH264Dec != NULL) {
+        /* opened by an input buffer allocation that never reached Idle */
+        if (pH264Dec->hMFCH264Handle.hMFCHandle != NULL)
+            SsbSipMfcDecClose(pH264Dec->hMFCH264Handle.hMFCHandle);
         SEC_OSAL_Free(pH264Dec);
         pH264Dec = pSECComponent->hCodecHandle = NULL;
     }
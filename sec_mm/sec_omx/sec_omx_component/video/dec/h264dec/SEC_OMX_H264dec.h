@@ -31,6 +31,11 @@
 #include "OMX_Component.h"
 #include "OMX_Video.h"
 
+/* a fast seek gives up on finding an IDR after that many frames */
+#define H264_FAST_SEEK_DROP_MAX 60
+/* the DPB a level 4.1 stream may use, the highest level the MFC decodes */
+#define H264_MAX_DPB_MBS        32768
+#define H264_MAX_DPB_FRAMES     16
 
 typedef struct _SEC_MFC_H264DEC_HANDLE
 {
@@ -40,6 +45,10 @@ typedef struct _SEC_MFC_H264DEC_HANDLE
     OMX_U32    indexTimestamp;
     OMX_BOOL bConfiguredMFC;
     OMX_BOOL bThumbnailMode;
+    OMX_BOOL bIDRFound;
+    OMX_BOOL bLowDelayMode;
+    OMX_BOOL bFastSeekMode;
+    OMX_U32  nDroppedFrames;   // frames of the fast seek dropped so far
     OMX_S32  returnCodec;
 } SEC_MFC_H264DEC_HANDLE;
 
@@ -57,6 +66,12 @@ typedef struct _SEC_H264DEC_HANDLE
     OMX_BOOL bFirstFrame;
     MFC_DEC_INPUT_BUFFER MFCDecInputBuffer[MFC_INPUT_BUFFER_NUM_MAX];
     OMX_U32  indexInputBuffer;
+    MFC_DEC_INPUT_POOL MFCDecInputPool;
+    /* a failed run is recovered from at the next IDR */
+    MFC_DEC_RECOVERY recovery;
+
+    /* decoded picture conversion on the post processor */
+    SEC_FIMC_CSC fimcCsc;
 } SEC_H264DEC_HANDLE;
 
 #ifdef __cplusplus
@@ -32,6 +32,8 @@
 #include "SEC_OMX_Basecomponent.h"
 #include "SEC_OMX_Baseport.h"
 #include "SEC_OMX_Vdec.h"
+#include "SEC_OMX_StartCode.h"
+#include "SEC_OSAL_FimcCsc.h"
 #include "library_register.h"
 #include "SEC_OMX_Mpeg4dec.h"
 #include "SsbSipMfcApi.h"
@@ -105,10 +107,21 @@ SEC_OMX_VIDEO_PROFILELEVEL supportedH263ProfileLevels[] = {
 static OMX_HANDLETYPE ghMFCHandle = NULL;
 static OMX_BOOL gbFIMV1 = OMX_FALSE;
 
+/* offset of the first 00 00 01 B6 at or after offset, -1 if there is none */
+static int Find_Mpeg4_VOP(OMX_U8 *pInputStream, int offset, int buffSize)
+{
+    while ((offset = SEC_OMX_FindStartCode(pInputStream, offset, buffSize)) >= 0) {
+        if (pInputStream[offset + 3] == 0xB6)
+            break;
+        offset += 3;
+    }
+
+    return offset;
+}
+
 static int Check_Mpeg4_Frame(OMX_U8 *pInputStream, OMX_U32 buffSize, OMX_U32 flag, OMX_BOOL bPreviousFrameEOF, OMX_BOOL *pbEndOfFrame)
 {
-    int len, readStream;
-    unsigned startCode;
+    int len;
     OMX_BOOL bFrameStart;
 
     len = 0;
@@ -141,40 +154,31 @@ static int Check_Mpeg4_Frame(OMX_U8 *pInputStream, OMX_U32 buffSize, OMX_U32 fla
     if (bPreviousFrameEOF == OMX_FALSE)
         bFrameStart = OMX_TRUE;
 
-    startCode = 0xFFFFFFFF;
     if (bFrameStart == OMX_FALSE) {
         /* find VOP start code */
-        while(startCode != 0x1B6) {
-            readStream = *(pInputStream + len);
-            startCode = (startCode << 8) | readStream;
-            len++;
-            if (len > buffSize)
-                goto EXIT;
-        }
+        len = Find_Mpeg4_VOP(pInputStream, 0, buffSize);
+        if (len < 0)
+            goto EXIT;
+        len += 4;
     }
 
     /* find next VOP start code */
-    startCode = 0xFFFFFFFF;
-    while ((startCode != 0x1B6)) {
-        readStream = *(pInputStream + len);
-        startCode = (startCode << 8) | readStream;
-        len++;
-        if (len > buffSize)
-            goto EXIT;
-    }
+    len = Find_Mpeg4_VOP(pInputStream, len, buffSize);
+    if (len < 0)
+        goto EXIT;
 
     *pbEndOfFrame = OMX_TRUE;
 
-    SEC_OSAL_Log(SEC_LOG_TRACE, "1. Check_Mpeg4_Frame returned EOF = %d, len = %d, buffSize = %d", *pbEndOfFrame, len - 4, buffSize);
+    SEC_OSAL_Log(SEC_LOG_TRACE, "1. Check_Mpeg4_Frame returned EOF = %d, len = %d, buffSize = %d", *pbEndOfFrame, len, buffSize);
 
-    return len - 4;
+    return len;
 
 EXIT :
     *pbEndOfFrame = OMX_FALSE;
 
-    SEC_OSAL_Log(SEC_LOG_TRACE, "2. Check_Mpeg4_Frame returned EOF = %d, len = %d, buffSize = %d", *pbEndOfFrame, len - 1, buffSize);
+    SEC_OSAL_Log(SEC_LOG_TRACE, "2. Check_Mpeg4_Frame returned EOF = %d, len = %d, buffSize = %d", *pbEndOfFrame, buffSize, buffSize);
 
-    return --len;
+    return buffSize;
 }
 
 static int Check_H263_Frame(OMX_U8 *pInputStream, OMX_U32 buffSize, OMX_U32 flag, OMX_BOOL bPreviousFrameEOF, OMX_BOOL *pbEndOfFrame)
@@ -266,6 +270,59 @@ OMX_BOOL Check_Stream_PrefixCode(OMX_U8 *pInputStream, OMX_U32 streamSize, CODEC
     }
 }
 
+/* n bits at a bit position, msb first, 0 past the end */
+static OMX_U32 Get_Stream_Bits(OMX_U8 *pInputStream, OMX_U32 streamSize, OMX_U32 pos, OMX_U32 n)
+{
+    OMX_U32 value = 0;
+
+    while (n-- > 0) {
+        value <<= 1;
+        if ((pos >> 3) < streamSize)
+            value |= (pInputStream[pos >> 3] >> (7 - (pos & 7))) & 1;
+        pos++;
+    }
+
+    return value;
+}
+
+/*
+ * whether the frame decodes on its own: an I-VOP, or an INTRA H.263
+ * picture. FIMV1 has no start codes to tell, it is taken for one.
+ */
+static OMX_BOOL Check_Stream_IntraFrame(OMX_U8 *pInputStream, OMX_U32 streamSize, CODEC_TYPE codecType)
+{
+    OMX_U32 i = 0;
+    OMX_U32 pos = 0;
+
+    switch (codecType) {
+    case CODEC_TYPE_MPEG4:
+        if (gbFIMV1)
+            return OMX_TRUE;
+        for (i = 0; i + 4 < streamSize; i++) {
+            if ((pInputStream[i] == 0x00) && (pInputStream[i + 1] == 0x00) &&
+                (pInputStream[i + 2] == 0x01) && (pInputStream[i + 3] == 0xB6))
+                return ((pInputStream[i + 4] >> 6) == 0) ? OMX_TRUE : OMX_FALSE;
+        }
+        return OMX_FALSE;
+    case CODEC_TYPE_H263:
+        /* 22 bit PSC, 8 bit TR, then PTYPE */
+        if ((Get_Stream_Bits(pInputStream, streamSize, 0, 22) != 0x20) || (streamSize < 6))
+            return OMX_FALSE;
+        pos = 22 + 8 + 5;
+        if (Get_Stream_Bits(pInputStream, streamSize, pos, 3) != 7)
+            return (Get_Stream_Bits(pInputStream, streamSize, pos + 3, 1) == 0) ? OMX_TRUE : OMX_FALSE;
+        /* PLUSPTYPE: UFEP, OPPTYPE when UFEP is 1, then the MPPTYPE picture type */
+        pos += 3;
+        if (Get_Stream_Bits(pInputStream, streamSize, pos, 3) == 1)
+            pos += 3 + 18;
+        else
+            pos += 3;
+        return (Get_Stream_Bits(pInputStream, streamSize, pos, 3) == 0) ? OMX_TRUE : OMX_FALSE;
+    default:
+        return OMX_TRUE;
+    }
+}
+
 OMX_ERRORTYPE SEC_MFC_Mpeg4Dec_GetParameter(
     OMX_IN    OMX_HANDLETYPE hComponent,
     OMX_IN    OMX_INDEXTYPE  nParamIndex,
@@ -611,8 +668,19 @@ OMX_ERRORTYPE SEC_MFC_Mpeg4Dec_SetParameter(
             case OMX_COLOR_FormatYUV420Planar:
             case OMX_COLOR_FormatYUV420SemiPlanar:
             case OMX_SEC_COLOR_FormatNV12TPhysicalAddress:
+            case OMX_SEC_COLOR_FormatNV21Linear:
             case OMX_SEC_COLOR_FormatANBYUV420SemiPlanar:
-                pSECOutputPort->portDefinition.nBufferSize = (width * height * 3) / 2;
+            case OMX_SEC_COLOR_FormatANBNV12TPhysicalAddress:
+                pSECOutputPort->portDefinition.nBufferSize =
+                    SEC_AdaptiveOutputBufferSize(pSECOutputPort, (width * height * 3) / 2);
+                break;
+            case OMX_SEC_COLOR_FormatYVU420Planar:
+                pSECOutputPort->portDefinition.nBufferSize =
+                    SEC_AdaptiveOutputBufferSize(pSECOutputPort, YV12_FRAME_SIZE(width, height));
+                break;
+            case OMX_COLOR_Format16bitRGB565:
+                pSECOutputPort->portDefinition.nBufferSize =
+                    SEC_AdaptiveOutputBufferSize(pSECOutputPort, width * height * 2);
                 break;
             default:
                 SEC_OSAL_Log(SEC_LOG_ERROR, "Color format is not support!! use default YUV size!!");
@@ -733,6 +801,30 @@ OMX_ERRORTYPE SEC_MFC_Mpeg4Dec_GetConfig(
     }
 
     switch (nIndex) {
+    case OMX_IndexConfigCommonOutputCrop:
+    {
+        SEC_MPEG4_HANDLE    *pMpeg4Dec = (SEC_MPEG4_HANDLE *)pSECComponent->hCodecHandle;
+        OMX_CONFIG_RECTTYPE *pDstRectType = (OMX_CONFIG_RECTTYPE *)pComponentConfigStructure;
+        OMX_CONFIG_RECTTYPE *pSrcRectType = NULL;
+
+        if (pMpeg4Dec->hMFCMpeg4Handle.bConfiguredMFC == OMX_FALSE) {
+            ret = OMX_ErrorNotReady;
+            break;
+        }
+
+        if (pDstRectType->nPortIndex != OUTPUT_PORT_INDEX) {
+            ret = OMX_ErrorBadPortIndex;
+            goto EXIT;
+        }
+
+        pSrcRectType = &pSECComponent->pSECPort[OUTPUT_PORT_INDEX].cropRectangle;
+
+        pDstRectType->nTop    = pSrcRectType->nTop;
+        pDstRectType->nLeft   = pSrcRectType->nLeft;
+        pDstRectType->nHeight = pSrcRectType->nHeight;
+        pDstRectType->nWidth  = pSrcRectType->nWidth;
+    }
+        break;
     default:
         ret = SEC_OMX_GetConfig(hComponent, nIndex, pComponentConfigStructure);
         break;
@@ -834,6 +926,9 @@ OMX_ERRORTYPE SEC_MFC_Mpeg4Dec_GetExtensionIndex(
         SEC_MPEG4_HANDLE *pMpeg4Dec = (SEC_MPEG4_HANDLE *)pSECComponent->hCodecHandle;
         *pIndexType = OMX_IndexVendorThumbnailMode;
         ret = OMX_ErrorNone;
+    } else if (SEC_OSAL_Strcmp(cParameterName, SEC_INDEX_PARAM_ADAPTIVE_PLAYBACK) == 0) {
+        *pIndexType = OMX_IndexParamPrepareForAdaptivePlayback;
+        ret = OMX_ErrorNone;
 #ifdef USE_ANDROID_EXTENSION
     } else if (SEC_OSAL_Strcmp(cParameterName, SEC_INDEX_PARAM_ENABLE_ANB) == 0) {
         *pIndexType = OMX_IndexParamEnableAndroidBuffers;
@@ -903,37 +998,95 @@ EXIT:
     return ret;
 }
 
-OMX_ERRORTYPE SEC_MFC_DecodeThread(OMX_HANDLETYPE hComponent)
+static OMX_PTR SEC_MFC_Mpeg4Dec_Open(SEC_MPEG4_HANDLE *pMpeg4Dec)
 {
+    /* MFC(Multi Format Codec) decoder and CMM(Codec Memory Management) driver open */
+    if (pMpeg4Dec->hMFCMpeg4Handle.hMFCHandle == NULL) {
+        SSBIP_MFC_BUFFER_TYPE buf_type = CACHE;
+        pMpeg4Dec->hMFCMpeg4Handle.hMFCHandle = (OMX_PTR)SsbSipMfcDecOpen(&buf_type);
+    }
+
+    return pMpeg4Dec->hMFCMpeg4Handle.hMFCHandle;
+}
+
+/* input buffers are allocated before the Init, so they may open the MFC */
+OMX_PTR SEC_MFC_Mpeg4Dec_AllocInputBuffer(OMX_COMPONENTTYPE *pOMXComponent, OMX_U32 nSizeBytes)
+{
+    SEC_OMX_BASECOMPONENT *pSECComponent = (SEC_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
+    SEC_MPEG4_HANDLE      *pMpeg4Dec = (SEC_MPEG4_HANDLE *)pSECComponent->hCodecHandle;
+
+    return SEC_MFC_InputPoolAlloc(pOMXComponent, &pMpeg4Dec->MFCDecInputPool,
+                                  SEC_MFC_Mpeg4Dec_Open(pMpeg4Dec), nSizeBytes);
+}
+
+void SEC_MFC_Mpeg4Dec_FreeInputBuffer(OMX_COMPONENTTYPE *pOMXComponent, OMX_PTR pBuffer)
+{
+    SEC_OMX_BASECOMPONENT *pSECComponent = (SEC_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
+    SEC_MPEG4_HANDLE      *pMpeg4Dec = (SEC_MPEG4_HANDLE *)pSECComponent->hCodecHandle;
+
+    SEC_MFC_InputPoolFree(&pMpeg4Dec->MFCDecInputPool, pBuffer);
+}
+
+/* picks the stream buffer the next frame goes to, a client buffer or the slot's own */
+OMX_ERRORTYPE SEC_MFC_Mpeg4Dec_SetInputBuffer(OMX_COMPONENTTYPE *pOMXComponent, OMX_BUFFERHEADERTYPE *pBufferHeader)
+{
+    SEC_OMX_BASECOMPONENT *pSECComponent = (SEC_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
+    SEC_MPEG4_HANDLE      *pMpeg4Dec = (SEC_MPEG4_HANDLE *)pSECComponent->hCodecHandle;
+    MFC_DEC_INPUT_BUFFER  *pSlot = &pMpeg4Dec->MFCDecInputBuffer[pMpeg4Dec->indexInputBuffer];
     OMX_ERRORTYPE          ret = OMX_ErrorNone;
-    OMX_COMPONENTTYPE     *pOMXComponent = (OMX_COMPONENTTYPE *)hComponent;
-    SEC_OMX_BASECOMPONENT *pSECComponent = NULL;
-    SEC_MPEG4_HANDLE      *pMpeg4Dec = NULL;
 
-    FunctionIn();
+    ret = SEC_MFC_InputSlotSet(pOMXComponent, &pMpeg4Dec->MFCDecInputPool, pSlot, pBufferHeader);
 
-    if (hComponent == NULL) {
-        ret = OMX_ErrorBadParameter;
-        goto EXIT;
-    }
+    pMpeg4Dec->hMFCMpeg4Handle.pMFCStreamBuffer    = pSlot->StrmVirAddr;
+    pMpeg4Dec->hMFCMpeg4Handle.pMFCStreamPhyBuffer = pSlot->StrmPhyAddr;
+    pSECComponent->processData[INPUT_PORT_INDEX].dataBuffer = pSlot->StrmVirAddr;
+    pSECComponent->processData[INPUT_PORT_INDEX].allocSize  = pSlot->StrmSize;
 
-    pSECComponent = (SEC_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
-    pMpeg4Dec = (SEC_MPEG4_HANDLE *)pSECComponent->hCodecHandle;
+    return ret;
+}
 
-    while (pMpeg4Dec->NBDecThread.bExitDecodeThread == OMX_FALSE) {
-        SEC_OSAL_SemaphoreWait(pMpeg4Dec->NBDecThread.hDecFrameStart);
+/* returns the client buffers held by the slots, on flush */
+OMX_ERRORTYPE SEC_MFC_Mpeg4Dec_ReleaseInputBuffer(OMX_COMPONENTTYPE *pOMXComponent)
+{
+    SEC_OMX_BASECOMPONENT *pSECComponent = (SEC_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
+    SEC_MPEG4_HANDLE      *pMpeg4Dec = (SEC_MPEG4_HANDLE *)pSECComponent->hCodecHandle;
+    int                    i = 0;
 
-        if (pMpeg4Dec->NBDecThread.bExitDecodeThread == OMX_FALSE) {
-            pMpeg4Dec->hMFCMpeg4Handle.returnCodec = SsbSipMfcDecExe(pMpeg4Dec->hMFCMpeg4Handle.hMFCHandle, pMpeg4Dec->NBDecThread.oneFrameSize);
-            SEC_OSAL_SemaphorePost(pMpeg4Dec->NBDecThread.hDecFrameEnd);
-        }
+    /* the MFC may still be reading some of them */
+    SEC_MFC_DecodeFlush(&pMpeg4Dec->NBDecThread);
+    SEC_MFC_DecodeRecoveryReset(&pMpeg4Dec->recovery);
+
+    for (i = 0; i < MFC_INPUT_BUFFER_NUM_MAX; i++) {
+        if (pMpeg4Dec->MFCDecInputBuffer[i].pBufferHeader != NULL)
+            SEC_MFC_InputSlotSet(pOMXComponent, &pMpeg4Dec->MFCDecInputPool, &pMpeg4Dec->MFCDecInputBuffer[i], NULL);
     }
 
-EXIT:
-    SEC_OSAL_ThreadExit(NULL);
-    FunctionOut();
+    if (pSECComponent->processData[INPUT_PORT_INDEX].dataBuffer != NULL)
+        SEC_MFC_Mpeg4Dec_SetInputBuffer(pOMXComponent, NULL);
 
-    return ret;
+    return OMX_ErrorNone;
+}
+
+/* reallocates the copy buffers when the stream turned out bigger, the frame being decoded moves along */
+static OMX_ERRORTYPE SEC_MFC_Mpeg4Dec_GrowInputBuffer(OMX_COMPONENTTYPE *pOMXComponent, int width, int height, OMX_U32 dataLen)
+{
+    SEC_OMX_BASECOMPONENT *pSECComponent = (SEC_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
+    SEC_MPEG4_HANDLE      *pMpeg4Dec = (SEC_MPEG4_HANDLE *)pSECComponent->hCodecHandle;
+    MFC_DEC_INPUT_BUFFER  *pSlot = &pMpeg4Dec->MFCDecInputBuffer[pMpeg4Dec->indexInputBuffer];
+    OMX_ERRORTYPE          ret = OMX_ErrorNone;
+
+    ret = SEC_MFC_InputSlotsAlloc(&pMpeg4Dec->MFCDecInputPool, pMpeg4Dec->MFCDecInputBuffer,
+                                  pMpeg4Dec->hMFCMpeg4Handle.hMFCHandle, width, height,
+                                  pMpeg4Dec->indexInputBuffer, dataLen);
+    if (ret != OMX_ErrorNone)
+        return ret;
+
+    pMpeg4Dec->hMFCMpeg4Handle.pMFCStreamBuffer    = pSlot->StrmVirAddr;
+    pMpeg4Dec->hMFCMpeg4Handle.pMFCStreamPhyBuffer = pSlot->StrmPhyAddr;
+    pSECComponent->processData[INPUT_PORT_INDEX].dataBuffer = pSlot->StrmVirAddr;
+    pSECComponent->processData[INPUT_PORT_INDEX].allocSize  = pSlot->StrmSize;
+
+    return OMX_ErrorNone;
 }
 
 /* MFC Init */
@@ -943,8 +1096,6 @@ OMX_ERRORTYPE SEC_MFC_Mpeg4Dec_Init(OMX_COMPONENTTYPE *pOMXComponent)
     SEC_OMX_BASECOMPONENT *pSECComponent = (SEC_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
     SEC_MPEG4_HANDLE      *pMpeg4Dec = NULL;
     OMX_HANDLETYPE         hMFCHandle = NULL;
-    OMX_PTR                pStreamBuffer = NULL;
-    OMX_PTR                pStreamPhyBuffer = NULL;
 
     FunctionIn();
 
@@ -953,42 +1104,31 @@ OMX_ERRORTYPE SEC_MFC_Mpeg4Dec_Init(OMX_COMPONENTTYPE *pOMXComponent)
     pSECComponent->bUseFlagEOF = OMX_FALSE;
     pSECComponent->bSaveFlagEOS = OMX_FALSE;
 
-    /* MFC(Multi Format Codec) decoder and CMM(Codec Memory Management) driver open */
-    SSBIP_MFC_BUFFER_TYPE buf_type = CACHE;
-    hMFCHandle = (OMX_PTR)SsbSipMfcDecOpen(&buf_type);
+    hMFCHandle = SEC_MFC_Mpeg4Dec_Open(pMpeg4Dec);
     if (hMFCHandle == NULL) {
         ret = OMX_ErrorInsufficientResources;
         goto EXIT;
     }
-    ghMFCHandle = pMpeg4Dec->hMFCMpeg4Handle.hMFCHandle = hMFCHandle;
-
-    /* Allocate decoder's input buffer */
-    pStreamBuffer = SsbSipMfcDecGetInBuf(hMFCHandle, &pStreamPhyBuffer, DEFAULT_MFC_INPUT_BUFFER_SIZE);
-    if (pStreamBuffer == NULL) {
-        ret = OMX_ErrorInsufficientResources;
+    ghMFCHandle = hMFCHandle;
+
+    /*
+     * Allocate decoder's input buffers for the size the client set, the pool
+     * of the client buffers starts with them. the header may grow them.
+     */
+    SEC_OSAL_Memset(pMpeg4Dec->MFCDecInputBuffer, 0, sizeof(pMpeg4Dec->MFCDecInputBuffer));
+    ret = SEC_MFC_InputSlotsAlloc(&pMpeg4Dec->MFCDecInputPool, pMpeg4Dec->MFCDecInputBuffer, hMFCHandle,
+                                  pSECComponent->pSECPort[INPUT_PORT_INDEX].portDefinition.format.video.nFrameWidth,
+                                  pSECComponent->pSECPort[INPUT_PORT_INDEX].portDefinition.format.video.nFrameHeight,
+                                  0, 0);
+    if (ret != OMX_ErrorNone)
         goto EXIT;
-    }
-
-    pMpeg4Dec->MFCDecInputBuffer[0].VirAddr = pStreamBuffer;
-    pMpeg4Dec->MFCDecInputBuffer[0].PhyAddr = pStreamPhyBuffer;
-    pMpeg4Dec->MFCDecInputBuffer[0].bufferSize = DEFAULT_MFC_INPUT_BUFFER_SIZE;
-    pMpeg4Dec->MFCDecInputBuffer[0].dataSize = 0;
-    pMpeg4Dec->MFCDecInputBuffer[1].VirAddr = (unsigned char *)pStreamBuffer + pMpeg4Dec->MFCDecInputBuffer[0].bufferSize;
-    pMpeg4Dec->MFCDecInputBuffer[1].PhyAddr = (unsigned char *)pStreamPhyBuffer + pMpeg4Dec->MFCDecInputBuffer[0].bufferSize;
-    pMpeg4Dec->MFCDecInputBuffer[1].bufferSize = DEFAULT_MFC_INPUT_BUFFER_SIZE;
-    pMpeg4Dec->MFCDecInputBuffer[1].dataSize = 0;
     pMpeg4Dec->indexInputBuffer = 0;
 
     pMpeg4Dec->bFirstFrame = OMX_TRUE;
+    SEC_OSAL_Memset(&pMpeg4Dec->recovery, 0, sizeof(pMpeg4Dec->recovery));
+    SEC_FIMC_CscInit(&pMpeg4Dec->fimcCsc);
 
-    pMpeg4Dec->NBDecThread.bExitDecodeThread = OMX_FALSE;
-    pMpeg4Dec->NBDecThread.bDecoderRun = OMX_FALSE;
-    pMpeg4Dec->NBDecThread.oneFrameSize = 0;
-    SEC_OSAL_SemaphoreCreate(&(pMpeg4Dec->NBDecThread.hDecFrameStart));
-    SEC_OSAL_SemaphoreCreate(&(pMpeg4Dec->NBDecThread.hDecFrameEnd));
-    if (OMX_ErrorNone == SEC_OSAL_ThreadCreate(&pMpeg4Dec->NBDecThread.hNBDecodeThread,
-                                                SEC_MFC_DecodeThread,
-                                                pOMXComponent)) {
+    if (OMX_ErrorNone == SEC_MFC_DecodeThreadCreate(&pMpeg4Dec->NBDecThread, hMFCHandle, &pSECComponent->trace, &pSECComponent->mfcSession)) {
         pMpeg4Dec->hMFCMpeg4Handle.returnCodec = MFC_RET_OK;
     }
 
@@ -997,8 +1137,8 @@ OMX_ERRORTYPE SEC_MFC_Mpeg4Dec_Init(OMX_COMPONENTTYPE *pOMXComponent)
     pSECComponent->processData[INPUT_PORT_INDEX].dataBuffer = pMpeg4Dec->MFCDecInputBuffer[0].VirAddr;
     pSECComponent->processData[INPUT_PORT_INDEX].allocSize = pMpeg4Dec->MFCDecInputBuffer[0].bufferSize;
 
-    SEC_OSAL_Memset(pSECComponent->timeStamp, -19771003, sizeof(OMX_TICKS) * MAX_TIMESTAMP);
-    SEC_OSAL_Memset(pSECComponent->nFlags, 0, sizeof(OMX_U32) * MAX_FLAGS);
+    SEC_OMX_TimestampMapReset(&pSECComponent->timestampMap);
+    SEC_OMX_TimestampMapSetDepth(&pSECComponent->timestampMap, MFC_DEC_TIMESTAMP_DEPTH(MPEG4_DPB_FRAMES));
     pMpeg4Dec->hMFCMpeg4Handle.indexTimestamp = 0;
     pSECComponent->getAllDelayBuffer = OMX_FALSE;
 
@@ -1026,27 +1166,17 @@ OMX_ERRORTYPE SEC_MFC_Mpeg4Dec_Terminate(OMX_COMPONENTTYPE *pOMXComponent)
     pSECComponent->processData[INPUT_PORT_INDEX].dataBuffer = NULL;
     pSECComponent->processData[INPUT_PORT_INDEX].allocSize = 0;
 
-    if (pMpeg4Dec->NBDecThread.hNBDecodeThread != NULL) {
-        pMpeg4Dec->NBDecThread.bExitDecodeThread = OMX_TRUE;
-        SEC_OSAL_SemaphorePost(pMpeg4Dec->NBDecThread.hDecFrameStart);
-        SEC_OSAL_ThreadTerminate(pMpeg4Dec->NBDecThread.hNBDecodeThread);
-        pMpeg4Dec->NBDecThread.hNBDecodeThread = NULL;
-    }
-
-    if(pMpeg4Dec->NBDecThread.hDecFrameEnd != NULL) {
-        SEC_OSAL_SemaphoreTerminate(pMpeg4Dec->NBDecThread.hDecFrameEnd);
-        pMpeg4Dec->NBDecThread.hDecFrameEnd = NULL;
-    }
-
-    if(pMpeg4Dec->NBDecThread.hDecFrameStart != NULL) {
-        SEC_OSAL_SemaphoreTerminate(pMpeg4Dec->NBDecThread.hDecFrameStart);
-        pMpeg4Dec->NBDecThread.hDecFrameStart = NULL;
-    }
+    SEC_MFC_DecodeThreadTerminate(&pMpeg4Dec->NBDecThread);
+    SEC_FIMC_CscDeinit(&pMpeg4Dec->fimcCsc);
+    SEC_MFC_DecodeRecoveryReport(&pMpeg4Dec->recovery, pSECComponent->componentName);
 
     if (hMFCHandle != NULL) {
         SsbSipMfcDecClose(hMFCHandle);
         pMpeg4Dec->hMFCMpeg4Handle.hMFCHandle = NULL;
     }
+    /* the stream memory is gone with the handle, the client frees its buffers after this */
+    SEC_OSAL_Memset(&pMpeg4Dec->MFCDecInputPool, 0, sizeof(MFC_DEC_INPUT_POOL));
+    SEC_OSAL_Memset(pMpeg4Dec->MFCDecInputBuffer, 0, sizeof(pMpeg4Dec->MFCDecInputBuffer));
 
 EXIT:
     FunctionOut();
@@ -1066,6 +1196,10 @@ OMX_ERRORTYPE SEC_MFC_Mpeg4_Decode(OMX_COMPONENTTYPE *pOMXComponent, SEC_OMX_DAT
     int                        bufWidth = 0;
     int                        bufHeight = 0;
     OMX_BOOL                   outputDataValid = OMX_FALSE;
+    OMX_BOOL                   bQueue = OMX_FALSE;
+    OMX_BOOL                   bHoldInput = OMX_FALSE;
+    OMX_BOOL                   bDropInput = OMX_FALSE;
+    OMX_BOOL                   bPictureHeld = OMX_FALSE;
 
     FunctionIn();
 
@@ -1087,8 +1221,11 @@ OMX_ERRORTYPE SEC_MFC_Mpeg4_Decode(OMX_COMPONENTTYPE *pOMXComponent, SEC_OMX_DAT
             goto EXIT;
         }
 
-        /* Set the number of extra buffer to prevent tearing */
-        configValue = 0;
+        /* Set the number of extra buffer to prevent tearing, covers the decoded pictures queued behind the current one */
+        configValue = MFC_DEC_EXTRA_BUFFER_NUM;
+        if (pSECComponent->pSECPort[OUTPUT_PORT_INDEX].portDefinition.format.video.eColorFormat ==
+            OMX_SEC_COLOR_FormatANBNV12TPhysicalAddress)
+            configValue += MFC_DEC_DISPLAY_EXTRA_BUFFER_NUM;
         SsbSipMfcDecSetConfig(hMFCHandle, MFC_DEC_SETCONF_EXTRA_BUFFER_NUM, &configValue);
 
         /* Set mpeg4 deblocking filter enable */
@@ -1100,10 +1237,16 @@ OMX_ERRORTYPE SEC_MFC_Mpeg4_Decode(OMX_COMPONENTTYPE *pOMXComponent, SEC_OMX_DAT
             SsbSipMfcDecSetConfig(hMFCHandle, MFC_DEC_SETCONF_DISPLAY_DELAY, &configValue);
         }
 
+        /* the first frame may sit in a client buffer */
+        SsbSipMfcDecSetInBuf(hMFCHandle,
+                             pMpeg4Dec->hMFCMpeg4Handle.pMFCStreamPhyBuffer,
+                             pMpeg4Dec->hMFCMpeg4Handle.pMFCStreamBuffer,
+                             pSECComponent->processData[INPUT_PORT_INDEX].allocSize);
         pMpeg4Dec->hMFCMpeg4Handle.returnCodec = SsbSipMfcDecInit(hMFCHandle, MFCCodecType, oneFrameSize);
         if (pMpeg4Dec->hMFCMpeg4Handle.returnCodec == MFC_RET_OK) {
             SSBSIP_MFC_IMG_RESOLUTION imgResol;
             SEC_OMX_BASEPORT *pInputPort = &pSECComponent->pSECPort[INPUT_PORT_INDEX];
+            SEC_OMX_BASEPORT *pOutputPort = &pSECComponent->pSECPort[OUTPUT_PORT_INDEX];
 
             if (SsbSipMfcDecGetConfig(hMFCHandle, MFC_DEC_GETCONF_BUF_WIDTH_HEIGHT, &imgResol) != MFC_RET_OK) {
                 ret = OMX_ErrorMFCInit;
@@ -1111,9 +1254,19 @@ OMX_ERRORTYPE SEC_MFC_Mpeg4_Decode(OMX_COMPONENTTYPE *pOMXComponent, SEC_OMX_DAT
                 goto EXIT;
             }
 
+            /* MPEG-4 has no cropping, the whole picture is shown */
+            pOutputPort->cropRectangle.nTop    = 0;
+            pOutputPort->cropRectangle.nLeft   = 0;
+            pOutputPort->cropRectangle.nWidth  = imgResol.width;
+            pOutputPort->cropRectangle.nHeight = imgResol.height;
+
             /** Update Frame Size **/
             if ((pInputPort->portDefinition.format.video.nFrameWidth != imgResol.width) ||
                 (pInputPort->portDefinition.format.video.nFrameHeight != imgResol.height)) {
+                /* within the adaptive maximum the output buffers stay, only the crop moves */
+                OMX_U32 eventData = SEC_AdaptiveResolutionFits(pOutputPort, imgResol.width, imgResol.height) ?
+                                    OMX_IndexConfigCommonOutputCrop : 0;
+
                 /* change width and height information */
                 pInputPort->portDefinition.format.video.nFrameWidth = imgResol.width;
                 pInputPort->portDefinition.format.video.nFrameHeight = imgResol.height;
@@ -1128,7 +1281,7 @@ OMX_ERRORTYPE SEC_MFC_Mpeg4_Decode(OMX_COMPONENTTYPE *pOMXComponent, SEC_OMX_DAT
                        pSECComponent->callbackData,
                        OMX_EventPortSettingsChanged, // The command was completed
                        OMX_DirOutput, // This is the port index
-                       0,
+                       eventData,
                        NULL);
             }
 
@@ -1136,6 +1289,12 @@ OMX_ERRORTYPE SEC_MFC_Mpeg4_Decode(OMX_COMPONENTTYPE *pOMXComponent, SEC_OMX_DAT
                     pInputPort->portDefinition.format.video.nFrameWidth,  pInputPort->portDefinition.format.video.nFrameHeight,
                     pInputPort->portDefinition.format.video.nStride, pInputPort->portDefinition.format.video.nSliceHeight);
 
+            /* the VOL may be bigger than the client said, an H.263 frame is decoded again after this */
+            if (SEC_MFC_Mpeg4Dec_GrowInputBuffer(pOMXComponent, imgResol.width, imgResol.height, oneFrameSize) != OMX_ErrorNone) {
+                ret = OMX_ErrorInsufficientResources;
+                goto EXIT;
+            }
+
             pMpeg4Dec->hMFCMpeg4Handle.bConfiguredMFC = OMX_TRUE;
             if (pMpeg4Dec->hMFCMpeg4Handle.codecType == CODEC_TYPE_MPEG4) {
                 pOutputData->timeStamp = pInputData->timeStamp;
@@ -1159,31 +1318,47 @@ OMX_ERRORTYPE SEC_MFC_Mpeg4_Decode(OMX_COMPONENTTYPE *pOMXComponent, SEC_OMX_DAT
         pSECComponent->bUseFlagEOF = OMX_TRUE;
 #endif
 
-    pSECComponent->timeStamp[pMpeg4Dec->hMFCMpeg4Handle.indexTimestamp] = pInputData->timeStamp;
-    pSECComponent->nFlags[pMpeg4Dec->hMFCMpeg4Handle.indexTimestamp] = pInputData->nFlags;
+    /* the EOS and thumbnail handling below wants one frame in the MFC at a time */
+    if ((pMpeg4Dec->hMFCMpeg4Handle.bThumbnailMode == OMX_FALSE) &&
+        (pSECComponent->bSaveFlagEOS == OMX_FALSE) &&
+        (pSECComponent->getAllDelayBuffer == OMX_FALSE) &&
+        ((pInputData->nFlags & OMX_BUFFERFLAG_EOS) != OMX_BUFFERFLAG_EOS))
+        bQueue = OMX_TRUE;
 
     if ((pMpeg4Dec->hMFCMpeg4Handle.returnCodec == MFC_RET_OK) &&
+        (pMpeg4Dec->bFirstFrame == OMX_FALSE) &&
+        (bQueue == OMX_TRUE) &&
+        (pMpeg4Dec->NBDecThread.nJobs < MFC_INPUT_BUFFER_NUM_MAX - 1) &&
+        (SEC_MFC_DecodeResultReady(&pMpeg4Dec->NBDecThread) == OMX_FALSE)) {
+        /* nothing decoded yet and the next slot is free, keep feeding the MFC */
+        pOutputData->timeStamp = pInputData->timeStamp;
+        pOutputData->nFlags = pInputData->nFlags;
+        outputDataValid = OMX_FALSE;
+        ret = OMX_ErrorNone;
+    } else if ((pMpeg4Dec->hMFCMpeg4Handle.returnCodec == MFC_RET_OK) &&
         (pMpeg4Dec->bFirstFrame == OMX_FALSE)) {
         SSBSIP_MFC_DEC_OUTBUF_STATUS status;
         OMX_S32 indexTimestamp = 0;
+        MFC_DEC_RESULT result;
 
         /* wait for mfc decode done */
-        if (pMpeg4Dec->NBDecThread.bDecoderRun == OMX_TRUE) {
-            SEC_OSAL_SemaphoreWait(pMpeg4Dec->NBDecThread.hDecFrameEnd);
-            pMpeg4Dec->NBDecThread.bDecoderRun = OMX_FALSE;
-        }
+        SEC_MFC_DecodeResultGet(&pMpeg4Dec->NBDecThread, &result);
+        bPictureHeld = result.bPicture;
 
-        status = SsbSipMfcDecGetOutBuf(hMFCHandle, &outputInfo);
+        status = result.status;
+        if (result.returnCodec != MFC_RET_OK) {
+            SEC_MFC_DecodeRecoveryStart(&pMpeg4Dec->recovery, result.returnCodec);
+            status = MFC_GETOUTBUF_DECODING_ONLY;
+        }
+        outputInfo = result.outputInfo;
+        indexTimestamp = result.indexTimestamp;
         bufWidth =  (outputInfo.img_width + 15) & (~15);
         bufHeight =  (outputInfo.img_height + 15) & (~15);
 
-        if ((SsbSipMfcDecGetConfig(hMFCHandle, MFC_DEC_GETCONF_FRAME_TAG, &indexTimestamp) != MFC_RET_OK) ||
-            (((indexTimestamp < 0) || (indexTimestamp >= MAX_TIMESTAMP)))) {
+        if (SEC_OMX_TimestampMapGet(&pSECComponent->timestampMap, indexTimestamp,
+                                    &pOutputData->timeStamp, &pOutputData->nFlags) == OMX_FALSE) {
             pOutputData->timeStamp = pInputData->timeStamp;
             pOutputData->nFlags = (pInputData->nFlags & (~OMX_BUFFERFLAG_EOS));
-        } else {
-            pOutputData->timeStamp = pSECComponent->timeStamp[indexTimestamp];
-            pOutputData->nFlags = pSECComponent->nFlags[indexTimestamp];
         }
         SEC_OSAL_Log(SEC_LOG_TRACE, "timestamp %lld us (%.2f secs)", pOutputData->timeStamp, pOutputData->timeStamp / 1E6);
 
@@ -1193,6 +1368,21 @@ OMX_ERRORTYPE SEC_MFC_Mpeg4_Decode(OMX_COMPONENTTYPE *pOMXComponent, SEC_OMX_DAT
         }
         if (pOutputData->nFlags & OMX_BUFFERFLAG_EOS)
             outputDataValid = OMX_FALSE;
+        if ((outputDataValid == OMX_TRUE) &&
+            (SEC_MFC_DecodeRecoveryCorrupt(&pMpeg4Dec->recovery, pOutputData->timeStamp) == OMX_TRUE))
+            pOutputData->nFlags |= OMX_BUFFERFLAG_DATACORRUPT;
+
+        if ((pMpeg4Dec->NBDecThread.nJobs > 0) || (result.bLastRun == OMX_FALSE)) {
+            /*
+             * more pictures are on the way. the input waits for a free slot,
+             * or out of the queue mode for the last one, which goes through
+             * the handling below
+             */
+            if ((bQueue == OMX_FALSE) || (pMpeg4Dec->NBDecThread.nJobs >= MFC_INPUT_BUFFER_NUM_MAX - 1))
+                bHoldInput = OMX_TRUE;
+            ret = OMX_ErrorNone;
+            goto DECODE_RESULT_DONE;
+        }
 
         if ((status == MFC_GETOUTBUF_DISPLAY_ONLY) ||
             (pSECComponent->getAllDelayBuffer == OMX_TRUE))
@@ -1250,44 +1440,52 @@ OMX_ERRORTYPE SEC_MFC_Mpeg4_Decode(OMX_COMPONENTTYPE *pOMXComponent, SEC_OMX_DAT
             ret = OMX_ErrorNone;
     }
 
+DECODE_RESULT_DONE:
     if (ret == OMX_ErrorInputDataDecodeYet) {
+        /* feed the previous stream buffer again */
         pMpeg4Dec->MFCDecInputBuffer[pMpeg4Dec->indexInputBuffer].dataSize = oneFrameSize;
-        pMpeg4Dec->indexInputBuffer++;
+        pMpeg4Dec->indexInputBuffer += MFC_INPUT_BUFFER_NUM_MAX - 1;
         pMpeg4Dec->indexInputBuffer %= MFC_INPUT_BUFFER_NUM_MAX;
-        pMpeg4Dec->hMFCMpeg4Handle.pMFCStreamBuffer    = pMpeg4Dec->MFCDecInputBuffer[pMpeg4Dec->indexInputBuffer].VirAddr;
-        pMpeg4Dec->hMFCMpeg4Handle.pMFCStreamPhyBuffer = pMpeg4Dec->MFCDecInputBuffer[pMpeg4Dec->indexInputBuffer].PhyAddr;
-        pSECComponent->processData[INPUT_PORT_INDEX].dataBuffer = pMpeg4Dec->MFCDecInputBuffer[pMpeg4Dec->indexInputBuffer].VirAddr;
-        pSECComponent->processData[INPUT_PORT_INDEX].allocSize = pMpeg4Dec->MFCDecInputBuffer[pMpeg4Dec->indexInputBuffer].bufferSize;
+        pMpeg4Dec->hMFCMpeg4Handle.pMFCStreamBuffer    = pMpeg4Dec->MFCDecInputBuffer[pMpeg4Dec->indexInputBuffer].StrmVirAddr;
+        pMpeg4Dec->hMFCMpeg4Handle.pMFCStreamPhyBuffer = pMpeg4Dec->MFCDecInputBuffer[pMpeg4Dec->indexInputBuffer].StrmPhyAddr;
+        pSECComponent->processData[INPUT_PORT_INDEX].dataBuffer = pMpeg4Dec->MFCDecInputBuffer[pMpeg4Dec->indexInputBuffer].StrmVirAddr;
+        pSECComponent->processData[INPUT_PORT_INDEX].allocSize = pMpeg4Dec->MFCDecInputBuffer[pMpeg4Dec->indexInputBuffer].StrmSize;
         oneFrameSize = pMpeg4Dec->MFCDecInputBuffer[pMpeg4Dec->indexInputBuffer].dataSize;
         //pInputData->dataLen = oneFrameSize;
         //pInputData->remainDataLen = oneFrameSize;
     }
 
-    if ((Check_Stream_PrefixCode(pInputData->dataBuffer, pInputData->dataLen, pMpeg4Dec->hMFCMpeg4Handle.codecType) == OMX_TRUE) &&
-        ((pOutputData->nFlags & OMX_BUFFERFLAG_EOS) != OMX_BUFFERFLAG_EOS)) {
-        SsbSipMfcDecSetConfig(hMFCHandle, MFC_DEC_SETCONF_FRAME_TAG, &(pMpeg4Dec->hMFCMpeg4Handle.indexTimestamp));
-        pMpeg4Dec->hMFCMpeg4Handle.indexTimestamp++;
-        pMpeg4Dec->hMFCMpeg4Handle.indexTimestamp %= MAX_TIMESTAMP;
-
-        SsbSipMfcDecSetInBuf(pMpeg4Dec->hMFCMpeg4Handle.hMFCHandle,
-                             pMpeg4Dec->hMFCMpeg4Handle.pMFCStreamPhyBuffer,
-                             pMpeg4Dec->hMFCMpeg4Handle.pMFCStreamBuffer,
-                             pSECComponent->processData[INPUT_PORT_INDEX].allocSize);
+    /* after a failed run only an I-VOP goes to the MFC, the pictures keep coming out */
+    if ((bHoldInput == OMX_FALSE) &&
+        (ret != OMX_ErrorInputDataDecodeYet) &&
+        ((pInputData->nFlags & OMX_BUFFERFLAG_EOS) != OMX_BUFFERFLAG_EOS) &&
+        (SEC_MFC_DecodeRecoveryDrop(&pMpeg4Dec->recovery,
+                                    Check_Stream_IntraFrame(pInputData->dataBuffer, oneFrameSize,
+                                                            pMpeg4Dec->hMFCMpeg4Handle.codecType),
+                                    pInputData->timeStamp) == OMX_TRUE)) {
+        SEC_OSAL_Log(SEC_LOG_TRACE, "frame before the recovery I-VOP dropped");
+        bDropInput = OMX_TRUE;
+    }
 
+    if ((bHoldInput == OMX_FALSE) &&
+        (bDropInput == OMX_FALSE) &&
+        (Check_Stream_PrefixCode(pInputData->dataBuffer, pInputData->dataLen, pMpeg4Dec->hMFCMpeg4Handle.codecType) == OMX_TRUE) &&
+        ((pOutputData->nFlags & OMX_BUFFERFLAG_EOS) != OMX_BUFFERFLAG_EOS)) {
         pMpeg4Dec->MFCDecInputBuffer[pMpeg4Dec->indexInputBuffer].dataSize = oneFrameSize;
-        pMpeg4Dec->NBDecThread.oneFrameSize = oneFrameSize;
 
         /* mfc decode start */
-        SEC_OSAL_SemaphorePost(pMpeg4Dec->NBDecThread.hDecFrameStart);
-        pMpeg4Dec->NBDecThread.bDecoderRun = OMX_TRUE;
+        pMpeg4Dec->hMFCMpeg4Handle.indexTimestamp = SEC_OMX_TimestampMapPut(&pSECComponent->timestampMap,
+                                                                            pInputData->timeStamp, pInputData->nFlags);
+        SEC_MFC_DecodeJobPut(&pMpeg4Dec->NBDecThread, &pMpeg4Dec->MFCDecInputBuffer[pMpeg4Dec->indexInputBuffer],
+                             oneFrameSize, pMpeg4Dec->hMFCMpeg4Handle.indexTimestamp, bQueue);
         pMpeg4Dec->hMFCMpeg4Handle.returnCodec = MFC_RET_OK;
 
         pMpeg4Dec->indexInputBuffer++;
         pMpeg4Dec->indexInputBuffer %= MFC_INPUT_BUFFER_NUM_MAX;
-        pMpeg4Dec->hMFCMpeg4Handle.pMFCStreamBuffer    = pMpeg4Dec->MFCDecInputBuffer[pMpeg4Dec->indexInputBuffer].VirAddr;
-        pMpeg4Dec->hMFCMpeg4Handle.pMFCStreamPhyBuffer = pMpeg4Dec->MFCDecInputBuffer[pMpeg4Dec->indexInputBuffer].PhyAddr;
-        pSECComponent->processData[INPUT_PORT_INDEX].dataBuffer = pMpeg4Dec->MFCDecInputBuffer[pMpeg4Dec->indexInputBuffer].VirAddr;
-        pSECComponent->processData[INPUT_PORT_INDEX].allocSize = pMpeg4Dec->MFCDecInputBuffer[pMpeg4Dec->indexInputBuffer].bufferSize;
+        pMpeg4Dec->hMFCMpeg4Handle.pMFCStreamBuffer    = pMpeg4Dec->MFCDecInputBuffer[pMpeg4Dec->indexInputBuffer].StrmVirAddr;
+        pMpeg4Dec->hMFCMpeg4Handle.pMFCStreamPhyBuffer = pMpeg4Dec->MFCDecInputBuffer[pMpeg4Dec->indexInputBuffer].StrmPhyAddr;
+        pSECComponent->processData[INPUT_PORT_INDEX].dataBuffer = pMpeg4Dec->MFCDecInputBuffer[pMpeg4Dec->indexInputBuffer].StrmVirAddr;
+        pSECComponent->processData[INPUT_PORT_INDEX].allocSize = pMpeg4Dec->MFCDecInputBuffer[pMpeg4Dec->indexInputBuffer].StrmSize;
         if (((pMpeg4Dec->hMFCMpeg4Handle.bThumbnailMode == OMX_TRUE) || (pSECComponent->bSaveFlagEOS == OMX_TRUE)) &&
             (pMpeg4Dec->bFirstFrame == OMX_TRUE) &&
             (outputDataValid == OMX_FALSE)) {
@@ -1296,6 +1494,10 @@ OMX_ERRORTYPE SEC_MFC_Mpeg4_Decode(OMX_COMPONENTTYPE *pOMXComponent, SEC_OMX_DAT
         pMpeg4Dec->bFirstFrame = OMX_FALSE;
     }
 
+    /* the input stays in its slot and comes back with the next call */
+    if (bHoldInput == OMX_TRUE)
+        ret = OMX_ErrorInputDataDecodeYet;
+
     /** Fill Output Buffer **/
     if (outputDataValid == OMX_TRUE) {
         SEC_OMX_BASEPORT *pSECInputPort = &pSECComponent->pSECPort[INPUT_PORT_INDEX];
@@ -1314,7 +1516,8 @@ OMX_ERRORTYPE SEC_MFC_Mpeg4_Decode(OMX_COMPONENTTYPE *pOMXComponent, SEC_OMX_DAT
         pOutputBuf[2] = (void *)pOutputData->dataBuffer + ((actualImageSize * 5) / 4);
 
 #ifdef USE_ANDROID_EXTENSION
-        if (pSECOutputPort->bUseAndroidNativeBuffer == OMX_TRUE) {
+        if ((pSECOutputPort->bUseAndroidNativeBuffer == OMX_TRUE) &&
+            (pSECOutputPort->portDefinition.format.video.eColorFormat != OMX_SEC_COLOR_FormatANBNV12TPhysicalAddress)) {
             OMX_U32 retANB = 0;
             void *pVirAddrs[2];
             actualWidth  = (outputInfo.img_width + 15) & (~15);
@@ -1343,6 +1546,22 @@ OMX_ERRORTYPE SEC_MFC_Mpeg4_Decode(OMX_COMPONENTTYPE *pOMXComponent, SEC_OMX_DAT
             SEC_OSAL_Memcpy(pOutputBuf[0] + sizeof(frameSize) + (sizeof(void *) * 2), &(outputInfo.YVirAddr), sizeof(outputInfo.YVirAddr));
             SEC_OSAL_Memcpy(pOutputBuf[0] + sizeof(frameSize) + (sizeof(void *) * 3), &(outputInfo.CVirAddr), sizeof(outputInfo.CVirAddr));
             pOutputData->dataLen = (bufWidth * bufHeight * 3) / 2;
+        } else if (pSECOutputPort->portDefinition.format.video.eColorFormat == OMX_SEC_COLOR_FormatANBNV12TPhysicalAddress) {
+            /* the display takes the picture straight from the DPB */
+            MFC_DEC_ANB_ADDRS *pAddrs = (MFC_DEC_ANB_ADDRS *)pOutputData->specificBufferHeader.YVirAddr;
+
+            if (pAddrs == NULL) {
+                SEC_OSAL_Log(SEC_LOG_ERROR, "native buffer 0x%x is not mapped", pOutputData->dataBuffer);
+                ret = OMX_ErrorOverflow;
+                goto EXIT;
+            }
+            SEC_OSAL_Log(SEC_LOG_TRACE, "NV12T out by address");
+            pAddrs->addrY    = (unsigned int)outputInfo.YPhyAddr;
+            pAddrs->addrCbCr = (unsigned int)outputInfo.CPhyAddr;
+            pAddrs->bufIndex = 0;
+            pAddrs->reserved = 0;
+            SEC_OMX_TraceCaptureStamp(&pSECComponent->trace, pOutputData->timeStamp, (OMX_PTR)(pAddrs + 1));
+            pOutputData->dataLen = (bufWidth * bufHeight * 3) / 2;
         } else {
             switch (pSECComponent->pSECPort[OUTPUT_PORT_INDEX].portDefinition.format.video.eColorFormat) {
             case OMX_COLOR_FormatYUV420Planar:
@@ -1362,10 +1581,69 @@ OMX_ERRORTYPE SEC_MFC_Mpeg4_Decode(OMX_COMPONENTTYPE *pOMXComponent, SEC_OMX_DAT
                 pOutputData->dataLen = actualImageSize * 3 / 2;
             }
                 break;
+            case OMX_SEC_COLOR_FormatNV21Linear:
+            {
+                SEC_OSAL_Log(SEC_LOG_TRACE, "NV21 out");
+                csc_tiled_to_nv21(
+                    (char *)pOutputBuf[0],
+                    (char *)pOutputBuf[1],
+                    (char *)outputInfo.YVirAddr,
+                    (char *)outputInfo.CVirAddr,
+                    actualWidth,
+                    actualHeight);
+                pOutputData->dataLen = actualImageSize * 3 / 2;
+            }
+                break;
+            case OMX_SEC_COLOR_FormatYVU420Planar:
+            {
+                int yStride  = YV12_Y_STRIDE(actualWidth);
+                int uvStride = YV12_UV_STRIDE(actualWidth);
+                char *pV = (char *)pOutputData->dataBuffer + (yStride * actualHeight);
+                char *pU = pV + (uvStride * (actualHeight >> 1));
+
+                SEC_OSAL_Log(SEC_LOG_TRACE, "YV12 out");
+                csc_tiled_to_yv12(
+                    (char *)pOutputData->dataBuffer,
+                    pV,
+                    pU,
+                    (char *)outputInfo.YVirAddr,
+                    (char *)outputInfo.CVirAddr,
+                    actualWidth,
+                    actualHeight,
+                    yStride,
+                    uvStride);
+                pOutputData->dataLen = YV12_FRAME_SIZE(actualWidth, actualHeight);
+            }
+                break;
+            case OMX_COLOR_Format16bitRGB565:
+            {
+                SEC_OSAL_Log(SEC_LOG_TRACE, "RGB565 out");
+                csc_tiled_to_rgb565(
+                    (char *)pOutputData->dataBuffer,
+                    (char *)outputInfo.YVirAddr,
+                    (char *)outputInfo.CVirAddr,
+                    actualWidth,
+                    actualHeight,
+                    actualWidth * 2,
+                    0);
+                pOutputData->dataLen = actualWidth * actualHeight * 2;
+            }
+                break;
             case OMX_COLOR_FormatYUV420SemiPlanar:
             case OMX_SEC_COLOR_FormatANBYUV420SemiPlanar:
             default:
             {
+#if defined(USE_ANDROID_EXTENSION) && defined(USE_FIMC_CSC)
+                /* the CPU converts what the FIMC can't take, or while it is busy */
+                if ((pSECOutputPort->bUseAndroidNativeBuffer == OMX_TRUE) &&
+                    (SEC_FIMC_CscTiledToANB(&pMpeg4Dec->fimcCsc, outputInfo.YPhyAddr, outputInfo.CPhyAddr,
+                                            outputInfo.buf_width, outputInfo.buf_height,
+                                            pOutputData->dataBuffer, actualWidth, actualHeight) == OMX_ErrorNone)) {
+                    SEC_OSAL_Log(SEC_LOG_TRACE, "YUV420SP out by FIMC");
+                    pOutputData->dataLen = actualImageSize * 3 / 2;
+                    break;
+                }
+#endif
                 SEC_OSAL_Log(SEC_LOG_TRACE, "YUV420SP out");
                 csc_tiled_to_linear(
                     (unsigned char *)pOutputBuf[0],
@@ -1383,7 +1661,8 @@ OMX_ERRORTYPE SEC_MFC_Mpeg4_Decode(OMX_COMPONENTTYPE *pOMXComponent, SEC_OMX_DAT
             }
         }
 #ifdef USE_ANDROID_EXTENSION
-        if (pSECOutputPort->bUseAndroidNativeBuffer == OMX_TRUE)
+        if ((pSECOutputPort->bUseAndroidNativeBuffer == OMX_TRUE) &&
+            (pSECOutputPort->portDefinition.format.video.eColorFormat != OMX_SEC_COLOR_FormatANBNV12TPhysicalAddress))
             putVADDRtoANB(pOutputData->dataBuffer);
 #endif
     } else {
@@ -1391,6 +1670,9 @@ OMX_ERRORTYPE SEC_MFC_Mpeg4_Decode(OMX_COMPONENTTYPE *pOMXComponent, SEC_OMX_DAT
     }
 
 EXIT:
+    /* the next run of the MFC could already go on while this picture was converted */
+    if (bPictureHeld == OMX_TRUE)
+        SEC_MFC_DecodePictureDone(&pMpeg4Dec->NBDecThread);
     FunctionOut();
 
     return ret;
@@ -1595,6 +1877,11 @@ OSCL_EXPORT_REF OMX_ERRORTYPE SEC_OMX_ComponentInit(OMX_HANDLETYPE hComponent, O
     else
         pSECComponent->sec_checkInputFrame = &Check_H263_Frame;
 
+    pSECComponent->sec_mfc_allocInputBuffer   = &SEC_MFC_Mpeg4Dec_AllocInputBuffer;
+    pSECComponent->sec_mfc_freeInputBuffer    = &SEC_MFC_Mpeg4Dec_FreeInputBuffer;
+    pSECComponent->sec_mfc_setInputBuffer     = &SEC_MFC_Mpeg4Dec_SetInputBuffer;
+    pSECComponent->sec_mfc_releaseInputBuffer = &SEC_MFC_Mpeg4Dec_ReleaseInputBuffer;
+
     pSECComponent->currentState = OMX_StateLoaded;
 
     ret = OMX_ErrorNone;
@@ -1626,6 +1913,9 @@ OMX_ERRORTYPE SEC_OMX_ComponentDeinit(OMX_HANDLETYPE hComponent)
 
     pMpeg4Dec = (SEC_MPEG4_HANDLE *)pSECComponent->hCodecHandle;
     if (pMpeg4Dec != NULL) {
+        /* opened by an input buffer allocation that never reached Idle */
+        if (pMpeg4Dec->hMFCMpeg4Handle.hMFCHandle != NULL)
+            SsbSipMfcDecClose(pMpeg4Dec->hMFCMpeg4Handle.hMFCHandle);
         SEC_OSAL_Free(pMpeg4Dec);
         pSECComponent->hCodecHandle = NULL;
     }
@@ -30,6 +30,8 @@
 #include "SEC_OMX_Def.h"
 #include "OMX_Component.h"
 
+/* the forward and backward references of a B-VOP */
+#define MPEG4_DPB_FRAMES        2
 
 typedef enum _CODEC_TYPE
 {
@@ -82,6 +84,12 @@ typedef struct _SEC_MPEG4_HANDLE
     OMX_BOOL bFirstFrame;
     MFC_DEC_INPUT_BUFFER MFCDecInputBuffer[MFC_INPUT_BUFFER_NUM_MAX];
     OMX_U32  indexInputBuffer;
+    MFC_DEC_INPUT_POOL MFCDecInputPool;
+    /* a failed run is recovered from at the next I-VOP */
+    MFC_DEC_RECOVERY recovery;
+
+    /* decoded picture conversion on the post processor */
+    SEC_FIMC_CSC fimcCsc;
 } SEC_MPEG4_HANDLE;
 
 #ifdef __cplusplus
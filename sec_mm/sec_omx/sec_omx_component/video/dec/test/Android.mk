@@ -0,0 +1,18 @@
+LOCAL_PATH := $(call my-dir)
+include $(CLEAR_VARS)
+
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_SRC_FILES := \
+	startcode_bench.c \
+	../SEC_OMX_StartCode.c
+
+LOCAL_MODULE := omx-startcode-bench
+
+LOCAL_ARM_MODE := arm
+
+LOCAL_C_INCLUDES := $(SEC_OMX_INC)/khronos \
+	$(SEC_OMX_TOP)/../../include \
+	$(SEC_OMX_COMPONENT)/video/dec
+
+include $(BUILD_EXECUTABLE)
@@ -0,0 +1,239 @@
+/*
+ *
+ * Copyright 2010 Samsung Electronics S.LSI Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Times SEC_OMX_FindStartCode against the byte at a time search the frame
+ * parsers used before, on synthetic streams of NAL units with emulation
+ * prevention applied, and checks that both find the same prefixes at
+ * every buffer alignment.
+ *
+ * usage: omx-startcode-bench [-s stream KB] [-n passes]
+ *
+ * results go to stdout as "RESULT <config> <metric> <value> <unit>" lines.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sec_bench.h>
+
+#include "SEC_OMX_StartCode.h"
+
+/* average NAL sizes: tiny P slices up to 720p I slices */
+static const int kNaluSizes[] = { 64, 1024, 16 * 1024, 128 * 1024 };
+
+/*
+ * CABAC payloads are close to uniform, CAVLC ones have more zero bytes,
+ * 1 in 16 is on the heavy side and keeps the word test honest.
+ */
+struct PayloadType {
+    int         zeroMask;
+    const char *name;
+};
+
+static const struct PayloadType kPayloads[] = {
+    { 0,  "cabac" },
+    { 15, "cavlc" },
+};
+
+/* keeps the timed loops from being optimized away */
+static volatile int gSink;
+
+static int ref_find(OMX_U8 *pStream, int offset, int streamSize)
+{
+    unsigned int preFourByte = 0xFFFFFFFF;
+    int i;
+
+    for (i = offset; i < streamSize; i++) {
+        if ((preFourByte << 8) == 0x00000100)
+            return i - 3;
+        preFourByte = (preFourByte << 8) + pStream[i];
+    }
+
+    return -1;
+}
+
+static double now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000.0 + ts.tv_nsec / 1000.0;
+}
+
+/* NAL units of about naluSize bytes, payload escaped like an encoder does */
+static int make_stream(OMX_U8 *pStream, int streamSize, int naluSize, int zeroMask)
+{
+    int pos = 0;
+    int zeros = 0;
+    int nalus = 0;
+
+    while (pos + 5 < streamSize) {
+        int end = pos + naluSize / 2 + rand() % naluSize;
+
+        if (nalus & 1)
+            pStream[pos++] = 0x00;
+        pStream[pos++] = 0x00;
+        pStream[pos++] = 0x00;
+        pStream[pos++] = 0x01;
+        pStream[pos++] = (nalus % 5) ? 0x41 : 0x65;
+        zeros = 0;
+        nalus++;
+
+        while (pos < end && pos < streamSize) {
+            OMX_U8 b = (OMX_U8)rand();
+
+            if (zeroMask && (rand() & zeroMask) == 0)
+                b = 0x00;
+
+            if (zeros >= 2 && b <= 0x03) {
+                pStream[pos++] = 0x03;
+                zeros = 0;
+                continue;
+            }
+            pStream[pos++] = b;
+            zeros = (b == 0x00) ? zeros + 1 : 0;
+        }
+        /* trailing bits, a slice never ends on a zero byte */
+        if (pos < streamSize)
+            pStream[pos++] = 0x80;
+    }
+    while (pos < streamSize)
+        pStream[pos++] = 0x80;
+
+    return nalus;
+}
+
+static int count_ref(OMX_U8 *pStream, int streamSize)
+{
+    int n = 0;
+    int offset = 0;
+
+    while ((offset = ref_find(pStream, offset, streamSize)) >= 0) {
+        offset += 3;
+        n++;
+    }
+    return n;
+}
+
+static int count_fast(OMX_U8 *pStream, int streamSize)
+{
+    int n = 0;
+    int offset = 0;
+
+    while ((offset = SEC_OMX_FindStartCode(pStream, offset, streamSize)) >= 0) {
+        offset += 3;
+        n++;
+    }
+    return n;
+}
+
+static int verify(OMX_U8 *pStream, int streamSize)
+{
+    int align;
+
+    for (align = 0; align < 4; align++) {
+        OMX_U8 *p = pStream + align;
+        int len = streamSize - 4;
+        int a = 0, b = 0;
+
+        do {
+            a = ref_find(p, a, len);
+            b = SEC_OMX_FindStartCode(p, b, len);
+            if (a != b) {
+                fprintf(stderr, "mismatch at alignment %d: %d != %d\n", align, a, b);
+                return -1;
+            }
+            a += 3;
+            b += 3;
+        } while (a > 2);
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    int streamKB = 4096;
+    int passes = 10;
+    int opt;
+    unsigned int i, j;
+
+    while ((opt = getopt(argc, argv, "s:n:")) != -1) {
+        switch (opt) {
+        case 's':
+            streamKB = atoi(optarg);
+            break;
+        case 'n':
+            passes = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-s stream KB] [-n passes]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (streamKB <= 0 || passes <= 0) {
+        fprintf(stderr, "bad stream size or pass count\n");
+        return 1;
+    }
+
+    int streamSize = streamKB * 1024;
+    OMX_U8 *pStream = (OMX_U8 *)malloc(streamSize + 8);
+    if (pStream == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    srand(1);
+    for (j = 0; j < sizeof(kPayloads) / sizeof(kPayloads[0]); j++)
+    for (i = 0; i < sizeof(kNaluSizes) / sizeof(kNaluSizes[0]); i++) {
+        char config[32];
+        double t, refUs, fastUs;
+        int nalus, n, pass;
+
+        nalus = make_stream(pStream, streamSize + 8, kNaluSizes[i], kPayloads[j].zeroMask);
+        if (verify(pStream, streamSize + 8) < 0)
+            return 1;
+
+        n = count_ref(pStream, streamSize);
+        if (count_fast(pStream, streamSize) != n) {
+            fprintf(stderr, "prefix count differs\n");
+            return 1;
+        }
+
+        t = now_us();
+        for (pass = 0; pass < passes; pass++)
+            gSink += count_ref(pStream, streamSize);
+        refUs = (now_us() - t) / passes;
+
+        t = now_us();
+        for (pass = 0; pass < passes; pass++)
+            gSink += count_fast(pStream, streamSize);
+        fastUs = (now_us() - t) / passes;
+
+        snprintf(config, sizeof(config), "%s_nalu%d", kPayloads[j].name, kNaluSizes[i]);
+        RESULT(config, "nalus", nalus, "count");
+        RESULT(config, "byte_scan", streamSize / refUs, "MB/s");
+        RESULT(config, "word_scan", streamSize / fastUs, "MB/s");
+        RESULT(config, "speedup", refUs / fastUs, "x");
+    }
+
+    free(pStream);
+    return 0;
+}
@@ -28,12 +28,15 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#define ATRACE_TAG ATRACE_TAG_VIDEO
+#include <sec_trace.h>
 #include "SEC_OMX_Macros.h"
 #include "SEC_OSAL_Event.h"
 #include "SEC_OMX_Venc.h"
 #include "SEC_OMX_Basecomponent.h"
 #include "SEC_OSAL_Thread.h"
 #include "color_space_convertor.h"
+#include "SsbSipMfcApi.h"
 
 #undef  SEC_LOG_TAG
 #define SEC_LOG_TAG    "SEC_VIDEO_ENC"
@@ -126,7 +129,7 @@ OMX_ERRORTYPE SEC_OMX_UseBuffer(
         goto EXIT;
     }
 
-    temp_bufferHeader = (OMX_BUFFERHEADERTYPE *)SEC_OSAL_Malloc(sizeof(OMX_BUFFERHEADERTYPE));
+    temp_bufferHeader = (OMX_BUFFERHEADERTYPE *)SEC_OSAL_PoolAlloc(&pSECComponent->bufferHeaderPool);
     if (temp_bufferHeader == NULL) {
         ret = OMX_ErrorInsufficientResources;
         goto EXIT;
@@ -159,7 +162,7 @@ OMX_ERRORTYPE SEC_OMX_UseBuffer(
         }
     }
 
-    SEC_OSAL_Free(temp_bufferHeader);
+    SEC_OSAL_PoolFree(&pSECComponent->bufferHeaderPool, temp_bufferHeader);
     ret = OMX_ErrorInsufficientResources;
 
 EXIT:
@@ -168,6 +171,16 @@ EXIT:
     return ret;
 }
 
+static void SEC_OMX_FreeMFCBuffer(OMX_COMPONENTTYPE *pOMXComponent, OMX_U32 nPortIndex, OMX_PTR pBuffer)
+{
+    SEC_OMX_BASECOMPONENT *pSECComponent = (SEC_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
+
+    if (nPortIndex == INPUT_PORT_INDEX)
+        pSECComponent->sec_mfc_freeInputBuffer(pOMXComponent, pBuffer);
+    else
+        pSECComponent->sec_mfc_freeOutputBuffer(pOMXComponent, pBuffer);
+}
+
 OMX_ERRORTYPE SEC_OMX_AllocateBuffer(
     OMX_IN OMX_HANDLETYPE            hComponent,
     OMX_INOUT OMX_BUFFERHEADERTYPE **ppBuffer,
@@ -181,6 +194,7 @@ OMX_ERRORTYPE SEC_OMX_AllocateBuffer(
     SEC_OMX_BASEPORT      *pSECPort = NULL;
     OMX_BUFFERHEADERTYPE  *temp_bufferHeader = NULL;
     OMX_U8                *temp_buffer = NULL;
+    OMX_U32                bufferState = BUFFER_STATE_ALLOCATED | HEADER_STATE_ALLOCATED;
     int                    i = 0;
 
     FunctionIn();
@@ -217,25 +231,40 @@ OMX_ERRORTYPE SEC_OMX_AllocateBuffer(
         goto EXIT;
     }
 
-    temp_buffer = SEC_OSAL_Malloc(sizeof(OMX_U8) * nSizeBytes);
-    if (temp_buffer == NULL) {
-        ret = OMX_ErrorInsufficientResources;
-        goto EXIT;
-    }
-
-    temp_bufferHeader = (OMX_BUFFERHEADERTYPE *)SEC_OSAL_Malloc(sizeof(OMX_BUFFERHEADERTYPE));
+    temp_bufferHeader = (OMX_BUFFERHEADERTYPE *)SEC_OSAL_PoolAlloc(&pSECComponent->bufferHeaderPool);
     if (temp_bufferHeader == NULL) {
-        SEC_OSAL_Free(temp_buffer);
-        temp_buffer = NULL;
         ret = OMX_ErrorInsufficientResources;
         goto EXIT;
     }
     SEC_OSAL_Memset(temp_bufferHeader, 0, sizeof(OMX_BUFFERHEADERTYPE));
 
+    /* linear NV12 frames in MFC memory are encoded in place instead of being copied */
+    if ((nPortIndex == INPUT_PORT_INDEX) && (pSECComponent->sec_mfc_allocInputBuffer != NULL) &&
+        (pSECPort->portDefinition.format.video.eColorFormat == OMX_COLOR_FormatYUV420SemiPlanar) &&
+        (pSECPort->bStoreMetaDataInBuffer == OMX_FALSE)) {
+        temp_buffer = pSECComponent->sec_mfc_allocInputBuffer(pOMXComponent, nSizeBytes);
+        if (temp_buffer != NULL)
+            bufferState |= BUFFER_STATE_MFC;
+    }
+    /* and the bitstream is written straight into output buffers in MFC memory */
+    if ((nPortIndex == OUTPUT_PORT_INDEX) && (pSECComponent->sec_mfc_allocOutputBuffer != NULL)) {
+        temp_buffer = pSECComponent->sec_mfc_allocOutputBuffer(pOMXComponent, nSizeBytes);
+        if (temp_buffer != NULL)
+            bufferState |= BUFFER_STATE_MFC;
+    }
+    if (temp_buffer == NULL) {
+        temp_buffer = SEC_OSAL_Malloc(sizeof(OMX_U8) * nSizeBytes);
+        if (temp_buffer == NULL) {
+            SEC_OSAL_PoolFree(&pSECComponent->bufferHeaderPool, temp_bufferHeader);
+            ret = OMX_ErrorInsufficientResources;
+            goto EXIT;
+        }
+    }
+
     for (i = 0; i < pSECPort->portDefinition.nBufferCountActual; i++) {
         if (pSECPort->bufferStateAllocate[i] == BUFFER_STATE_FREE) {
             pSECPort->bufferHeader[i] = temp_bufferHeader;
-            pSECPort->bufferStateAllocate[i] = (BUFFER_STATE_ALLOCATED | HEADER_STATE_ALLOCATED);
+            pSECPort->bufferStateAllocate[i] = bufferState;
             INIT_SET_SIZE_VERSION(temp_bufferHeader, OMX_BUFFERHEADERTYPE);
             temp_bufferHeader->pBuffer        = temp_buffer;
             temp_bufferHeader->nAllocLen        = nSizeBytes;
@@ -257,8 +286,11 @@ OMX_ERRORTYPE SEC_OMX_AllocateBuffer(
         }
     }
 
-    SEC_OSAL_Free(temp_bufferHeader);
-    SEC_OSAL_Free(temp_buffer);
+    SEC_OSAL_PoolFree(&pSECComponent->bufferHeaderPool, temp_bufferHeader);
+    if (bufferState & BUFFER_STATE_MFC)
+        SEC_OMX_FreeMFCBuffer(pOMXComponent, nPortIndex, temp_buffer);
+    else
+        SEC_OSAL_Free(temp_buffer);
     ret = OMX_ErrorInsufficientResources;
 
 EXIT:
@@ -316,7 +348,10 @@ OMX_ERRORTYPE SEC_OMX_FreeBuffer(
         if (((pSECPort->bufferStateAllocate[i] | BUFFER_STATE_FREE) != 0) && (pSECPort->bufferHeader[i] != NULL)) {
             if (pSECPort->bufferHeader[i]->pBuffer == pBufferHdr->pBuffer) {
                 if (pSECPort->bufferStateAllocate[i] & BUFFER_STATE_ALLOCATED) {
-                    SEC_OSAL_Free(pSECPort->bufferHeader[i]->pBuffer);
+                    if (pSECPort->bufferStateAllocate[i] & BUFFER_STATE_MFC)
+                        SEC_OMX_FreeMFCBuffer(pOMXComponent, nPortIndex, pSECPort->bufferHeader[i]->pBuffer);
+                    else
+                        SEC_OSAL_Free(pSECPort->bufferHeader[i]->pBuffer);
                     pSECPort->bufferHeader[i]->pBuffer = NULL;
                     pBufferHdr->pBuffer = NULL;
                 } else if (pSECPort->bufferStateAllocate[i] & BUFFER_STATE_ASSIGNED) {
@@ -324,7 +359,7 @@ OMX_ERRORTYPE SEC_OMX_FreeBuffer(
                 }
                 pSECPort->assignedBufferNum--;
                 if (pSECPort->bufferStateAllocate[i] & HEADER_STATE_ALLOCATED) {
-                    SEC_OSAL_Free(pSECPort->bufferHeader[i]);
+                    SEC_OSAL_PoolFree(&pSECComponent->bufferHeaderPool, pSECPort->bufferHeader[i]);
                     pSECPort->bufferHeader[i] = NULL;
                     pBufferHdr = NULL;
                 }
@@ -405,6 +440,181 @@ OMX_BOOL SEC_Check_BufferProcess_State(SEC_OMX_BASECOMPONENT *pSECComponent)
         return OMX_FALSE;
 }
 
+static void SEC_InputBufferMark(OMX_COMPONENTTYPE *pOMXComponent, OMX_BUFFERHEADERTYPE *bufferHeader)
+{
+    SEC_OMX_BASECOMPONENT *pSECComponent = (SEC_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
+    SEC_OMX_BASEPORT      *secOMXInputPort = &pSECComponent->pSECPort[INPUT_PORT_INDEX];
+
+    if (secOMXInputPort->markType.hMarkTargetComponent != NULL ) {
+        bufferHeader->hMarkTargetComponent      = secOMXInputPort->markType.hMarkTargetComponent;
+        bufferHeader->pMarkData                 = secOMXInputPort->markType.pMarkData;
+        secOMXInputPort->markType.hMarkTargetComponent = NULL;
+        secOMXInputPort->markType.pMarkData = NULL;
+    }
+
+    if (bufferHeader->hMarkTargetComponent != NULL) {
+        if (bufferHeader->hMarkTargetComponent == pOMXComponent) {
+            pSECComponent->pCallbacks->EventHandler(pOMXComponent,
+                            pSECComponent->callbackData,
+                            OMX_EventMark,
+                            0, 0, bufferHeader->pMarkData);
+        } else {
+            pSECComponent->propagateMarkType.hMarkTargetComponent = bufferHeader->hMarkTargetComponent;
+            pSECComponent->propagateMarkType.pMarkData = bufferHeader->pMarkData;
+        }
+    }
+}
+
+/* gives an input buffer back to the client, also used for frames encoded in place */
+OMX_ERRORTYPE SEC_InputBufferRelease(OMX_COMPONENTTYPE *pOMXComponent, OMX_BUFFERHEADERTYPE *bufferHeader)
+{
+    SEC_OMX_BASECOMPONENT *pSECComponent = (SEC_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
+    SEC_OMX_BASEPORT      *secOMXInputPort = &pSECComponent->pSECPort[INPUT_PORT_INDEX];
+
+    SEC_OMX_TraceBufferDone(&pSECComponent->trace, secOMXInputPort, INPUT_PORT_INDEX, bufferHeader);
+    if (CHECK_PORT_TUNNELED(secOMXInputPort)) {
+        OMX_FillThisBuffer(secOMXInputPort->tunneledComponent, bufferHeader);
+    } else {
+        bufferHeader->nFilledLen = 0;
+        pSECComponent->pCallbacks->EmptyBufferDone(pOMXComponent, pSECComponent->callbackData, bufferHeader);
+    }
+
+    return OMX_ErrorNone;
+}
+
+static OMX_PTR SEC_MFC_EncBufferPoolPhyAddr(MFC_ENC_BUFFER_POOL *pPool, OMX_PTR pBuffer)
+{
+    OMX_U32 i = 0;
+
+    for (i = 0; i < pPool->slotNum; i++) {
+        if (((OMX_U8 *)pBuffer >= (OMX_U8 *)pPool->VirAddr[i]) &&
+            ((OMX_U8 *)pBuffer < (OMX_U8 *)pPool->VirAddr[i] + pPool->slotSize))
+            return (OMX_U8 *)pPool->PhyAddr[i] + ((OMX_U8 *)pBuffer - (OMX_U8 *)pPool->VirAddr[i]);
+    }
+
+    return NULL;
+}
+
+/* hands out an MFC frame buffer as a port buffer, NULL when the caller has to malloc */
+OMX_PTR SEC_MFC_EncBufferPoolAlloc(OMX_COMPONENTTYPE *pOMXComponent, MFC_ENC_BUFFER_POOL *pPool, OMX_HANDLETYPE hMFCHandle, OMX_U32 nSizeBytes)
+{
+    SEC_OMX_BASECOMPONENT     *pSECComponent = (SEC_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
+    SEC_OMX_BASEPORT          *pSECPort = &pSECComponent->pSECPort[INPUT_PORT_INDEX];
+    SSBSIP_MFC_ENC_INPUT_INFO  inputInfo;
+    OMX_U32                    width = pSECPort->portDefinition.format.video.nFrameWidth;
+    OMX_U32                    height = pSECPort->portDefinition.format.video.nFrameHeight;
+    OMX_U32                    i = 0;
+
+    if ((hMFCHandle == NULL) || (pPool->bDisabled == OMX_TRUE))
+        return NULL;
+
+    /* what SsbSipMfcEncGetInBuf() allocates for one frame */
+    pPool->slotSize = ALIGN_TO_8KB(ALIGN_TO_128B(width) * ALIGN_TO_32B(height)) +
+                      ALIGN_TO_8KB(ALIGN_TO_128B(width) * ALIGN_TO_32B(height / 2));
+    if (nSizeBytes > pPool->slotSize)
+        return NULL;
+
+    /* the MFC memory is only given back with the handle, freed slots are reused */
+    for (i = 0; i < pPool->slotNum; i++) {
+        if (!(pPool->slotMask & (1 << i))) {
+            pPool->slotMask |= (1 << i);
+            return pPool->VirAddr[i];
+        }
+    }
+
+    if (pPool->slotNum >= MFC_BUFFER_POOL_SLOT_NUM_MAX)
+        return NULL;
+
+    if (SsbSipMfcEncGetInBuf(hMFCHandle, &inputInfo) != MFC_RET_OK) {
+        SEC_OSAL_Log(SEC_LOG_WARNING, "no MFC memory for buffer %d of %d bytes, its data is copied",
+                     pPool->slotNum, pPool->slotSize);
+        pPool->bDisabled = OMX_TRUE;
+        return NULL;
+    }
+    pPool->VirAddr[pPool->slotNum] = inputInfo.YVirAddr;
+    pPool->PhyAddr[pPool->slotNum] = inputInfo.YPhyAddr;
+    pPool->slotMask |= (1 << pPool->slotNum);
+
+    return pPool->VirAddr[pPool->slotNum++];
+}
+
+void SEC_MFC_EncBufferPoolFree(MFC_ENC_BUFFER_POOL *pPool, OMX_PTR pBuffer)
+{
+    OMX_U32 i = 0;
+
+    /* the memory went away with the MFC handle when the pool was reset */
+    for (i = 0; i < pPool->slotNum; i++) {
+        if (pPool->VirAddr[i] == pBuffer)
+            pPool->slotMask &= ~(1 << i);
+    }
+}
+
+/*
+ * lets the MFC encode the frame from a client buffer of the pool instead of
+ * the slot's own memory, the slot holds the buffer until it is released with
+ * a NULL pBufferHeader. the luma is followed by the chroma in a linear NV12
+ * frame, so the frame size has to keep the chroma on the MFC alignment.
+ */
+OMX_ERRORTYPE SEC_MFC_EncInputSlotSet(OMX_COMPONENTTYPE *pOMXComponent, MFC_ENC_BUFFER_POOL *pPool, MFC_ENC_INPUT_BUFFER *pSlot, OMX_BUFFERHEADERTYPE *pBufferHeader)
+{
+    SEC_OMX_BASECOMPONENT *pSECComponent = (SEC_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
+    SEC_OMX_BASEPORT      *pSECPort = &pSECComponent->pSECPort[INPUT_PORT_INDEX];
+    SEC_OMX_DATA          *inputData = &pSECComponent->processData[INPUT_PORT_INDEX];
+    OMX_U32                lumaSize = pSECPort->portDefinition.format.video.nFrameWidth *
+                                      pSECPort->portDefinition.format.video.nFrameHeight;
+    OMX_PTR                pPhyAddr = NULL;
+
+    if (pSlot->pBufferHeader != NULL) {
+        SEC_InputBufferRelease(pOMXComponent, pSlot->pBufferHeader);
+        pSlot->pBufferHeader = NULL;
+    }
+
+    if (pBufferHeader == NULL)
+        return OMX_ErrorNone;
+
+    pPhyAddr = SEC_MFC_EncBufferPoolPhyAddr(pPool, pBufferHeader->pBuffer);
+    if ((pPhyAddr == NULL) || ((lumaSize % MFC_ENC_FRAME_ALIGN) != 0) ||
+        (((OMX_U32)pPhyAddr % MFC_ENC_FRAME_ALIGN) != 0))
+        return OMX_ErrorUnsupportedSetting;
+
+    inputData->specificBufferHeader.YPhyAddr = pPhyAddr;
+    inputData->specificBufferHeader.CPhyAddr = (OMX_U8 *)pPhyAddr + lumaSize;
+    inputData->specificBufferHeader.YVirAddr = pBufferHeader->pBuffer;
+    inputData->specificBufferHeader.CVirAddr = pBufferHeader->pBuffer + lumaSize;
+    pSlot->pBufferHeader = pBufferHeader;
+
+    return OMX_ErrorNone;
+}
+
+/*
+ * a camera frame named by a metadata buffer is encoded straight from the
+ * camera's memory, which the camera refills once it has the buffer back.
+ * the slot takes the buffer from the port instead of it being returned
+ * after the frame is kicked off, the encode thread returns it as soon as
+ * the MFC has read the frame. another encoder may be reading the same
+ * frame meanwhile, the camera counts the returns, nothing here writes it.
+ */
+OMX_ERRORTYPE SEC_MFC_EncInputSlotHold(OMX_COMPONENTTYPE *pOMXComponent, MFC_ENC_INPUT_BUFFER *pSlot)
+{
+    SEC_OMX_BASECOMPONENT *pSECComponent = (SEC_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
+    SEC_OMX_DATABUFFER    *dataBuffer = &pSECComponent->secDataBuffer[INPUT_PORT_INDEX];
+
+    /* a buffer with more frames in it still has to go through the port */
+    if ((dataBuffer->bufferHeader == NULL) || (dataBuffer->remainDataLen != 0))
+        return OMX_ErrorNone;
+
+    if (pSlot->pBufferHeader != NULL) {
+        SEC_InputBufferRelease(pOMXComponent, pSlot->pBufferHeader);
+        pSlot->pBufferHeader = NULL;
+    }
+
+    SEC_InputBufferMark(pOMXComponent, dataBuffer->bufferHeader);
+    pSlot->pBufferHeader = dataBuffer->bufferHeader;
+    dataBuffer->bufferHeader = NULL;
+
+    return OMX_ErrorNone;
+}
+
 static OMX_ERRORTYPE SEC_InputBufferReturn(OMX_COMPONENTTYPE *pOMXComponent)
 {
     OMX_ERRORTYPE          ret = OMX_ErrorNone;
@@ -417,31 +627,8 @@ static OMX_ERRORTYPE SEC_InputBufferReturn(OMX_COMPONENTTYPE *pOMXComponent)
     FunctionIn();
 
     if (bufferHeader != NULL) {
-        if (secOMXInputPort->markType.hMarkTargetComponent != NULL ) {
-            bufferHeader->hMarkTargetComponent      = secOMXInputPort->markType.hMarkTargetComponent;
-            bufferHeader->pMarkData                 = secOMXInputPort->markType.pMarkData;
-            secOMXInputPort->markType.hMarkTargetComponent = NULL;
-            secOMXInputPort->markType.pMarkData = NULL;
-        }
-
-        if (bufferHeader->hMarkTargetComponent != NULL) {
-            if (bufferHeader->hMarkTargetComponent == pOMXComponent) {
-                pSECComponent->pCallbacks->EventHandler(pOMXComponent,
-                                pSECComponent->callbackData,
-                                OMX_EventMark,
-                                0, 0, bufferHeader->pMarkData);
-            } else {
-                pSECComponent->propagateMarkType.hMarkTargetComponent = bufferHeader->hMarkTargetComponent;
-                pSECComponent->propagateMarkType.pMarkData = bufferHeader->pMarkData;
-            }
-        }
-
-        if (CHECK_PORT_TUNNELED(secOMXInputPort)) {
-            OMX_FillThisBuffer(secOMXInputPort->tunneledComponent, bufferHeader);
-        } else {
-            bufferHeader->nFilledLen = 0;
-            pSECComponent->pCallbacks->EmptyBufferDone(pOMXComponent, pSECComponent->callbackData, bufferHeader);
-        }
+        SEC_InputBufferMark(pOMXComponent, bufferHeader);
+        SEC_InputBufferRelease(pOMXComponent, bufferHeader);
     }
 
     if ((pSECComponent->currentState == OMX_StatePause) &&
@@ -484,7 +671,7 @@ OMX_ERRORTYPE SEC_InputBufferGetQueue(SEC_OMX_BASECOMPONENT *pSECComponent)
         SEC_OSAL_SemaphoreWait(pSECPort->bufferSemID);
         SEC_OSAL_MutexLock(inputUseBuffer->bufferMutex);
         if (dataBuffer->dataValid != OMX_TRUE) {
-            message = (SEC_OMX_MESSAGE *)SEC_OSAL_Dequeue(&pSECPort->bufferQ);
+            message = (SEC_OMX_MESSAGE *)SEC_OSAL_RingGet(&pSECPort->bufferQ);
             if (message == NULL) {
                 ret = OMX_ErrorUndefined;
                 SEC_OSAL_MutexUnlock(inputUseBuffer->bufferMutex);
@@ -502,7 +689,7 @@ OMX_ERRORTYPE SEC_InputBufferGetQueue(SEC_OMX_BASECOMPONENT *pSECComponent)
             pSECComponent->processData[INPUT_PORT_INDEX].dataBuffer = dataBuffer->bufferHeader->pBuffer;
             pSECComponent->processData[INPUT_PORT_INDEX].allocSize = dataBuffer->bufferHeader->nAllocLen;
 
-            SEC_OSAL_Free(message);
+            SEC_OSAL_PoolFree(&pSECComponent->messagePool, message);
         }
         SEC_OSAL_MutexUnlock(inputUseBuffer->bufferMutex);
         ret = OMX_ErrorNone;
@@ -513,6 +700,35 @@ EXIT:
     return ret;
 }
 
+/* gives a filled output buffer to the client, also used for frames encoded in place */
+static void SEC_OutputBufferRelease(OMX_COMPONENTTYPE *pOMXComponent, OMX_BUFFERHEADERTYPE *bufferHeader)
+{
+    SEC_OMX_BASECOMPONENT *pSECComponent = (SEC_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
+    SEC_OMX_BASEPORT      *secOMXOutputPort = &pSECComponent->pSECPort[OUTPUT_PORT_INDEX];
+
+    if (pSECComponent->propagateMarkType.hMarkTargetComponent != NULL) {
+        bufferHeader->hMarkTargetComponent = pSECComponent->propagateMarkType.hMarkTargetComponent;
+        bufferHeader->pMarkData = pSECComponent->propagateMarkType.pMarkData;
+        pSECComponent->propagateMarkType.hMarkTargetComponent = NULL;
+        pSECComponent->propagateMarkType.pMarkData = NULL;
+    }
+
+    if (bufferHeader->nFlags & OMX_BUFFERFLAG_EOS) {
+        pSECComponent->pCallbacks->EventHandler(pOMXComponent,
+                        pSECComponent->callbackData,
+                        OMX_EventBufferFlag,
+                        OUTPUT_PORT_INDEX,
+                        bufferHeader->nFlags, NULL);
+    }
+
+    SEC_OMX_TraceBufferDone(&pSECComponent->trace, secOMXOutputPort, OUTPUT_PORT_INDEX, bufferHeader);
+    if (CHECK_PORT_TUNNELED(secOMXOutputPort)) {
+        OMX_EmptyThisBuffer(secOMXOutputPort->tunneledComponent, bufferHeader);
+    } else {
+        pSECComponent->pCallbacks->FillBufferDone(pOMXComponent, pSECComponent->callbackData, bufferHeader);
+    }
+}
+
 static OMX_ERRORTYPE SEC_OutputBufferReturn(OMX_COMPONENTTYPE *pOMXComponent)
 {
     OMX_ERRORTYPE          ret = OMX_ErrorNone;
@@ -530,26 +746,7 @@ static OMX_ERRORTYPE SEC_OutputBufferReturn(OMX_COMPONENTTYPE *pOMXComponent)
         bufferHeader->nFlags     = dataBuffer->nFlags;
         bufferHeader->nTimeStamp = dataBuffer->timeStamp;
 
-        if (pSECComponent->propagateMarkType.hMarkTargetComponent != NULL) {
-            bufferHeader->hMarkTargetComponent = pSECComponent->propagateMarkType.hMarkTargetComponent;
-            bufferHeader->pMarkData = pSECComponent->propagateMarkType.pMarkData;
-            pSECComponent->propagateMarkType.hMarkTargetComponent = NULL;
-            pSECComponent->propagateMarkType.pMarkData = NULL;
-        }
-
-        if (bufferHeader->nFlags & OMX_BUFFERFLAG_EOS) {
-            pSECComponent->pCallbacks->EventHandler(pOMXComponent,
-                            pSECComponent->callbackData,
-                            OMX_EventBufferFlag,
-                            OUTPUT_PORT_INDEX,
-                            bufferHeader->nFlags, NULL);
-        }
-
-        if (CHECK_PORT_TUNNELED(secOMXOutputPort)) {
-            OMX_EmptyThisBuffer(secOMXOutputPort->tunneledComponent, bufferHeader);
-        } else {
-            pSECComponent->pCallbacks->FillBufferDone(pOMXComponent, pSECComponent->callbackData, bufferHeader);
-        }
+        SEC_OutputBufferRelease(pOMXComponent, bufferHeader);
     }
 
     if ((pSECComponent->currentState == OMX_StatePause) &&
@@ -593,7 +790,7 @@ OMX_ERRORTYPE SEC_OutputBufferGetQueue(SEC_OMX_BASECOMPONENT *pSECComponent)
         SEC_OSAL_SemaphoreWait(pSECPort->bufferSemID);
         SEC_OSAL_MutexLock(outputUseBuffer->bufferMutex);
         if (dataBuffer->dataValid != OMX_TRUE) {
-            message = (SEC_OMX_MESSAGE *)SEC_OSAL_Dequeue(&pSECPort->bufferQ);
+            message = (SEC_OMX_MESSAGE *)SEC_OSAL_RingGet(&pSECPort->bufferQ);
             if (message == NULL) {
                 ret = OMX_ErrorUndefined;
                 SEC_OSAL_MutexUnlock(outputUseBuffer->bufferMutex);
@@ -608,7 +805,7 @@ OMX_ERRORTYPE SEC_OutputBufferGetQueue(SEC_OMX_BASECOMPONENT *pSECComponent)
             dataBuffer->dataValid =OMX_TRUE;
             /* dataBuffer->nFlags = dataBuffer->bufferHeader->nFlags; */
             /* dataBuffer->nTimeStamp = dataBuffer->bufferHeader->nTimeStamp; */
-            SEC_OSAL_Free(message);
+            SEC_OSAL_PoolFree(&pSECComponent->messagePool, message);
         }
         SEC_OSAL_MutexUnlock(outputUseBuffer->bufferMutex);
         ret = OMX_ErrorNone;
@@ -657,6 +854,72 @@ static OMX_ERRORTYPE SEC_DataReset(OMX_COMPONENTTYPE *pOMXComponent, OMX_U32 por
     return ret;
 }
 
+/*
+ * lets the MFC write the next frame straight into the output buffer waiting
+ * on the port when it is one of the pool, the buffer is held off the port
+ * until the frame comes out of the encoder with the next call. the copy into
+ * the MFC's own stream buffer is kept when the waiting buffer is still needed
+ * for this call's output or the client has no second buffer to hand in.
+ */
+OMX_BUFFERHEADERTYPE *SEC_MFC_EncOutputBufferTake(OMX_COMPONENTTYPE *pOMXComponent, MFC_ENC_BUFFER_POOL *pPool, OMX_HANDLETYPE hMFCHandle)
+{
+    SEC_OMX_BASECOMPONENT *pSECComponent = (SEC_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
+    SEC_OMX_BASEPORT      *pSECPort = &pSECComponent->pSECPort[OUTPUT_PORT_INDEX];
+    SEC_OMX_DATABUFFER    *outputUseBuffer = &pSECComponent->secDataBuffer[OUTPUT_PORT_INDEX];
+    SEC_OMX_DATA          *outputData = &pSECComponent->processData[OUTPUT_PORT_INDEX];
+    OMX_BUFFERHEADERTYPE  *bufferHeader = outputUseBuffer->bufferHeader;
+    OMX_PTR                pPhyAddr = NULL;
+
+    /* slices are handed out one per buffer, which needs the copy */
+    if ((outputUseBuffer->dataValid == OMX_TRUE) && (bufferHeader != NULL) &&
+        (pSECComponent->bSliceOutput == OMX_FALSE) &&
+        (outputUseBuffer->dataLen == 0) && (pSECPort->portDefinition.nBufferCountActual > 1) &&
+        ((outputData->dataLen == 0) || (outputData->bufferHeader != NULL)))
+        pPhyAddr = SEC_MFC_EncBufferPoolPhyAddr(pPool, bufferHeader->pBuffer);
+
+    if (pPhyAddr == NULL) {
+        SsbSipMfcEncSetOutBuf(hMFCHandle, NULL, NULL, 0);
+        return NULL;
+    }
+
+    SsbSipMfcEncSetOutBuf(hMFCHandle, pPhyAddr, bufferHeader->pBuffer, bufferHeader->nAllocLen);
+
+    outputUseBuffer->dataValid     = OMX_FALSE;
+    outputUseBuffer->dataLen       = 0;
+    outputUseBuffer->remainDataLen = 0;
+    outputUseBuffer->usedDataLen   = 0;
+    outputUseBuffer->bufferHeader  = NULL;
+    outputUseBuffer->nFlags        = 0;
+    outputUseBuffer->timeStamp     = 0;
+
+    return bufferHeader;
+}
+
+/* gives the output buffers held for the MFC back empty, on an output port flush */
+void SEC_MFC_EncOutputBufferFlush(OMX_COMPONENTTYPE *pOMXComponent, OMX_BUFFERHEADERTYPE **ppBufferHeader, OMX_HANDLETYPE hMFCHandle)
+{
+    SEC_OMX_BASECOMPONENT *pSECComponent = (SEC_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
+    SEC_OMX_DATA          *outputData = &pSECComponent->processData[OUTPUT_PORT_INDEX];
+
+    if (outputData->bufferHeader != NULL) {
+        outputData->bufferHeader->nFilledLen = 0;
+        outputData->bufferHeader->nFlags     = 0;
+        SEC_OutputBufferRelease(pOMXComponent, outputData->bufferHeader);
+        outputData->bufferHeader = NULL;
+        SEC_DataReset(pOMXComponent, OUTPUT_PORT_INDEX);
+    }
+
+    if (*ppBufferHeader != NULL) {
+        (*ppBufferHeader)->nFilledLen = 0;
+        (*ppBufferHeader)->nFlags     = 0;
+        SEC_OutputBufferRelease(pOMXComponent, *ppBufferHeader);
+        *ppBufferHeader = NULL;
+    }
+
+    if (hMFCHandle != NULL)
+        SsbSipMfcEncSetOutBuf(hMFCHandle, NULL, NULL, 0);
+}
+
 OMX_BOOL SEC_Preprocessor_InputData(OMX_COMPONENTTYPE *pOMXComponent)
 {
     OMX_BOOL               ret = OMX_FALSE;
@@ -670,6 +933,7 @@ OMX_BOOL SEC_Preprocessor_InputData(OMX_COMPONENTTYPE *pOMXComponent)
     OMX_BOOL               flagEOS = OMX_FALSE;
     OMX_BOOL               flagEOF = OMX_FALSE;
     OMX_BOOL               previousFrameEOF = OMX_FALSE;
+    OMX_BOOL               bInPlace = OMX_FALSE;
 
     if (inputUseBuffer->dataValid == OMX_TRUE) {
         checkInputStream = inputUseBuffer->bufferHeader->pBuffer + inputUseBuffer->usedDataLen;
@@ -762,21 +1026,37 @@ OMX_BOOL SEC_Preprocessor_InputData(OMX_COMPONENTTYPE *pOMXComponent)
                     SEC_OSAL_Log(SEC_LOG_TRACE, "width:%d, height:%d, Ysize:%d", width, height, ALIGN_TO_8KB(ALIGN_TO_128B(width) * ALIGN_TO_32B(height)));
                     SEC_OSAL_Log(SEC_LOG_TRACE, "width:%d, height:%d, Csize:%d", width, height, ALIGN_TO_8KB(ALIGN_TO_128B(width) * ALIGN_TO_32B(height / 2)));
 
-                    switch (pSECPort->portDefinition.format.video.eColorFormat) {
-                    case OMX_COLOR_FormatYUV420Planar:
-                        /* Real YUV420P Data */
-                        csc_linear_to_tiled(inputData->specificBufferHeader.YVirAddr,
-                                                checkInputStream, width, height);
-                        csc_linear_to_tiled_interleave(inputData->specificBufferHeader.CVirAddr,
-                                                 checkInputStream + (width * height),
-                                                 checkInputStream + (((width * height) * 5) / 4),
-                                                 width, height >> 1);
-                        break;
-                    case OMX_COLOR_FormatYUV420SemiPlanar:
-                    default:
-                        SEC_OSAL_Memcpy(inputData->specificBufferHeader.YVirAddr, checkInputStream, (width * height));
-                        SEC_OSAL_Memcpy(inputData->specificBufferHeader.CVirAddr, checkInputStream + (width * height), (width * height / 2));
-                        break;
+                    /*
+                     * a client buffer of MFC memory holding just one linear NV12
+                     * frame is encoded from there, the codec returns the buffer
+                     * once the MFC is done with it. the last frame is copied,
+                     * the codec encodes it from its own memory.
+                     */
+                    if ((pSECPort->portDefinition.format.video.eColorFormat == OMX_COLOR_FormatYUV420SemiPlanar) &&
+                        (pSECComponent->sec_mfc_setInputBuffer != NULL) &&
+                        (previousFrameEOF == OMX_TRUE) && (inputUseBuffer->usedDataLen == 0) &&
+                        (copySize == checkInputStreamLen) && !(inputUseBuffer->nFlags & OMX_BUFFERFLAG_EOS) &&
+                        (inputUseBuffer->bufferHeader->nFilledLen >= ((width * height * 3) / 2)) &&
+                        (pSECComponent->sec_mfc_setInputBuffer(pOMXComponent, inputUseBuffer->bufferHeader) == OMX_ErrorNone))
+                        bInPlace = OMX_TRUE;
+
+                    if (bInPlace == OMX_FALSE) {
+                        switch (pSECPort->portDefinition.format.video.eColorFormat) {
+                        case OMX_COLOR_FormatYUV420Planar:
+                            /* Real YUV420P Data */
+                            csc_linear_to_tiled(inputData->specificBufferHeader.YVirAddr,
+                                                    checkInputStream, width, height);
+                            csc_linear_to_tiled_interleave(inputData->specificBufferHeader.CVirAddr,
+                                                     checkInputStream + (width * height),
+                                                     checkInputStream + (((width * height) * 5) / 4),
+                                                     width, height >> 1);
+                            break;
+                        case OMX_COLOR_FormatYUV420SemiPlanar:
+                        default:
+                            SEC_OSAL_Memcpy(inputData->specificBufferHeader.YVirAddr, checkInputStream, (width * height));
+                            SEC_OSAL_Memcpy(inputData->specificBufferHeader.CVirAddr, checkInputStream + (width * height), (width * height / 2));
+                            break;
+                        }
                     }
                 }
             }
@@ -815,6 +1095,10 @@ OMX_BOOL SEC_Preprocessor_InputData(OMX_COMPONENTTYPE *pOMXComponent)
         }
 
         if (inputUseBuffer->remainDataLen == 0) {
+            if (bInPlace == OMX_TRUE) {
+                SEC_InputBufferMark(pOMXComponent, inputUseBuffer->bufferHeader);
+                inputUseBuffer->bufferHeader = NULL;
+            }
             if(flagEOF == OMX_FALSE)
                 SEC_InputBufferReturn(pOMXComponent);
         } else {
@@ -837,6 +1121,37 @@ OMX_BOOL SEC_Preprocessor_InputData(OMX_COMPONENTTYPE *pOMXComponent)
     return ret;
 }
 
+/* FALSE when the frame comes before the start time stamp and is dropped */
+/* length of the NAL unit pBuffer starts with, up to the next start code */
+static OMX_U32 SEC_Postprocess_NalUnitSize(OMX_U8 *pBuffer, OMX_U32 size)
+{
+    OMX_U32 i;
+
+    for (i = 4; i + 3 <= size; i++) {
+        if ((pBuffer[i] == 0x00) && (pBuffer[i + 1] == 0x00) && (pBuffer[i + 2] == 0x01))
+            return (pBuffer[i - 1] == 0x00) ? (i - 1) : i;
+    }
+
+    return size;
+}
+
+static OMX_BOOL SEC_Postprocess_CheckTimeStamp(SEC_OMX_BASECOMPONENT *pSECComponent, SEC_OMX_DATA *outputData)
+{
+    if (pSECComponent->checkTimeStamp.needCheckStartTimeStamp == OMX_TRUE) {
+        if (pSECComponent->checkTimeStamp.startTimeStamp != outputData->timeStamp)
+            return OMX_FALSE;
+
+        pSECComponent->checkTimeStamp.startTimeStamp = -19761123;
+        pSECComponent->checkTimeStamp.nStartFlags = 0x0;
+        pSECComponent->checkTimeStamp.needSetStartTimeStamp = OMX_FALSE;
+        pSECComponent->checkTimeStamp.needCheckStartTimeStamp = OMX_FALSE;
+    } else if (pSECComponent->checkTimeStamp.needSetStartTimeStamp == OMX_TRUE) {
+        return OMX_FALSE;
+    }
+
+    return OMX_TRUE;
+}
+
 OMX_BOOL SEC_Postprocess_OutputData(OMX_COMPONENTTYPE *pOMXComponent)
 {
     OMX_BOOL               ret = OMX_FALSE;
@@ -845,27 +1160,60 @@ OMX_BOOL SEC_Postprocess_OutputData(OMX_COMPONENTTYPE *pOMXComponent)
     SEC_OMX_DATA          *outputData = &pSECComponent->processData[OUTPUT_PORT_INDEX];
     OMX_U32                copySize = 0;
 
-    if (outputUseBuffer->dataValid == OMX_TRUE) {
-        if (pSECComponent->checkTimeStamp.needCheckStartTimeStamp == OMX_TRUE) {
-            if (pSECComponent->checkTimeStamp.startTimeStamp == outputData->timeStamp){
-                pSECComponent->checkTimeStamp.startTimeStamp = -19761123;
-                pSECComponent->checkTimeStamp.nStartFlags = 0x0;
-                pSECComponent->checkTimeStamp.needSetStartTimeStamp = OMX_FALSE;
-                pSECComponent->checkTimeStamp.needCheckStartTimeStamp = OMX_FALSE;
-            } else {
-                SEC_DataReset(pOMXComponent, OUTPUT_PORT_INDEX);
+    /* encoded straight into a client buffer, that one goes back instead of a copy */
+    if (outputData->bufferHeader != NULL) {
+        OMX_BUFFERHEADERTYPE *bufferHeader = outputData->bufferHeader;
 
-                ret = OMX_TRUE;
-                goto EXIT;
-            }
-        } else if (pSECComponent->checkTimeStamp.needSetStartTimeStamp == OMX_TRUE) {
+        bufferHeader->nFilledLen = outputData->remainDataLen;
+        bufferHeader->nOffset    = (outputData->dataBuffer + outputData->usedDataLen) - bufferHeader->pBuffer;
+        bufferHeader->nFlags     = outputData->nFlags;
+        bufferHeader->nTimeStamp = outputData->timeStamp;
+
+        if (SEC_Postprocess_CheckTimeStamp(pSECComponent, outputData) == OMX_FALSE) {
+            bufferHeader->nFilledLen = 0;
+            bufferHeader->nFlags     = 0;
+        }
+
+        SEC_OutputBufferRelease(pOMXComponent, bufferHeader);
+        outputData->bufferHeader = NULL;
+        SEC_DataReset(pOMXComponent, OUTPUT_PORT_INDEX);
+
+        ret = OMX_TRUE;
+        goto EXIT;
+    }
+
+    if (outputUseBuffer->dataValid == OMX_TRUE) {
+        if (SEC_Postprocess_CheckTimeStamp(pSECComponent, outputData) == OMX_FALSE) {
             SEC_DataReset(pOMXComponent, OUTPUT_PORT_INDEX);
 
             ret = OMX_TRUE;
             goto EXIT;
         }
 
-        if (outputData->remainDataLen <= (outputUseBuffer->allocSize - outputUseBuffer->dataLen)) {
+        copySize = outputData->remainDataLen;
+        if ((pSECComponent->bSliceOutput == OMX_TRUE) && (copySize > 0) &&
+            !(outputData->nFlags & OMX_BUFFERFLAG_CODECCONFIG))
+            copySize = SEC_Postprocess_NalUnitSize(outputData->dataBuffer + outputData->usedDataLen, copySize);
+
+        if ((copySize < outputData->remainDataLen) &&
+            (copySize <= (outputUseBuffer->allocSize - outputUseBuffer->dataLen))) {
+            /* a slice before the last one of the frame, the rest goes out with the next buffers */
+            SEC_OSAL_Memcpy((outputUseBuffer->bufferHeader->pBuffer + outputUseBuffer->dataLen),
+                (outputData->dataBuffer + outputData->usedDataLen),
+                 copySize);
+
+            outputUseBuffer->dataLen += copySize;
+            outputUseBuffer->remainDataLen += copySize;
+            outputUseBuffer->nFlags = outputData->nFlags & (~(OMX_BUFFERFLAG_ENDOFFRAME | OMX_BUFFERFLAG_EOS));
+            outputUseBuffer->timeStamp = outputData->timeStamp;
+
+            ret = OMX_FALSE;
+
+            outputData->remainDataLen -= copySize;
+            outputData->usedDataLen += copySize;
+
+            SEC_OutputBufferReturn(pOMXComponent);
+        } else if (outputData->remainDataLen <= (outputUseBuffer->allocSize - outputUseBuffer->dataLen)) {
             copySize = outputData->remainDataLen;
             if (copySize > 0)
                 SEC_OSAL_Memcpy((outputUseBuffer->bufferHeader->pBuffer + outputUseBuffer->dataLen),
@@ -933,26 +1281,28 @@ OMX_ERRORTYPE SEC_OMX_BufferProcess(OMX_HANDLETYPE hComponent)
     FunctionIn();
 
     while (!pSECComponent->bExitBufferProcessThread) {
-        SEC_OSAL_SleepMillisec(0);
-
-        if (((pSECComponent->currentState == OMX_StatePause) ||
-            (pSECComponent->currentState == OMX_StateIdle) ||
-            (pSECComponent->transientState == SEC_OMX_TransStateLoadedToIdle) ||
-            (pSECComponent->transientState == SEC_OMX_TransStateExecutingToIdle)) &&
-            (pSECComponent->transientState != SEC_OMX_TransStateIdleToLoaded)&&
-            ((!CHECK_PORT_BEING_FLUSHED(secInputPort) && !CHECK_PORT_BEING_FLUSHED(secOutputPort)))) {
+        /*
+         * sleep until a state or port change makes the loop below runnable,
+         * all of them set pauseEvent. the state is checked again after the
+         * reset so that a change in between is not lost.
+         */
+        if (!SEC_Check_BufferProcess_State(pSECComponent) &&
+            (!CHECK_PORT_BEING_FLUSHED(secInputPort) && !CHECK_PORT_BEING_FLUSHED(secOutputPort))) {
             SEC_OSAL_SignalReset(pSECComponent->pauseEvent);
-            SEC_OSAL_SignalWait(pSECComponent->pauseEvent, DEF_MAX_WAIT_TIME);
+            if (!SEC_Check_BufferProcess_State(pSECComponent) &&
+                !pSECComponent->bExitBufferProcessThread)
+                SEC_OSAL_SignalWait(pSECComponent->pauseEvent, DEF_MAX_WAIT_TIME);
         }
 
+        /* blocks in the GetQueue calls on the port semaphores ETB/FTB post */
         while (SEC_Check_BufferProcess_State(pSECComponent) && !pSECComponent->bExitBufferProcessThread) {
-            SEC_OSAL_SleepMillisec(0);
-
             SEC_OSAL_MutexLock(outputUseBuffer->bufferMutex);
             if ((outputUseBuffer->dataValid != OMX_TRUE) &&
                 (!CHECK_PORT_BEING_FLUSHED(secOutputPort))) {
                 SEC_OSAL_MutexUnlock(outputUseBuffer->bufferMutex);
+                SEC_TRACE_BEGIN("venc:wait_output");
                 ret = SEC_OutputBufferGetQueue(pSECComponent);
+                SEC_TRACE_END();
                 if ((ret == OMX_ErrorUndefined) ||
                     (secInputPort->portState != OMX_StateIdle) ||
                     (secOutputPort->portState != OMX_StateIdle)) {
@@ -968,7 +1318,9 @@ OMX_ERRORTYPE SEC_OMX_BufferProcess(OMX_HANDLETYPE hComponent)
                     if ((SEC_Preprocessor_InputData(pOMXComponent) == OMX_FALSE) &&
                         (!CHECK_PORT_BEING_FLUSHED(secInputPort))) {
                             SEC_OSAL_MutexUnlock(inputUseBuffer->bufferMutex);
+                            SEC_TRACE_BEGIN("venc:wait_input");
                             ret = SEC_InputBufferGetQueue(pSECComponent);
+                            SEC_TRACE_END();
                             break;
                     }
 
@@ -977,7 +1329,9 @@ OMX_ERRORTYPE SEC_OMX_BufferProcess(OMX_HANDLETYPE hComponent)
 
                 SEC_OSAL_MutexLock(inputUseBuffer->bufferMutex);
                 SEC_OSAL_MutexLock(outputUseBuffer->bufferMutex);
+                SEC_TRACE_BEGIN("venc:buffer_process");
                 ret = pSECComponent->sec_mfc_bufferProcess(pOMXComponent, inputData, outputData);
+                SEC_TRACE_END();
 
                 if (inputUseBuffer->remainDataLen == 0)
                     SEC_InputBufferReturn(pOMXComponent);
@@ -1010,6 +1364,156 @@ EXIT:
     return ret;
 }
 
+OMX_ERRORTYPE SEC_MFC_EncGetRuntimeConfig(OMX_COMPONENTTYPE *pOMXComponent, OMX_INDEXTYPE nIndex, OMX_PTR pComponentConfigStructure)
+{
+    OMX_ERRORTYPE          ret = OMX_ErrorNone;
+    SEC_OMX_BASECOMPONENT *pSECComponent = (SEC_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
+
+    switch (nIndex) {
+    case OMX_IndexConfigVideoBitrate:
+    {
+        OMX_VIDEO_CONFIG_BITRATETYPE *pBitrate = (OMX_VIDEO_CONFIG_BITRATETYPE *)pComponentConfigStructure;
+
+        ret = SEC_OMX_Check_SizeVersion(pBitrate, sizeof(OMX_VIDEO_CONFIG_BITRATETYPE));
+        if (ret != OMX_ErrorNone)
+            break;
+        if (pBitrate->nPortIndex != OUTPUT_PORT_INDEX) {
+            ret = OMX_ErrorBadPortIndex;
+            break;
+        }
+
+        pBitrate->nEncodeBitrate = pSECComponent->pSECPort[OUTPUT_PORT_INDEX].portDefinition.format.video.nBitrate;
+    }
+        break;
+    case OMX_IndexConfigVideoFramerate:
+    {
+        OMX_CONFIG_FRAMERATETYPE *pFramerate = (OMX_CONFIG_FRAMERATETYPE *)pComponentConfigStructure;
+
+        ret = SEC_OMX_Check_SizeVersion(pFramerate, sizeof(OMX_CONFIG_FRAMERATETYPE));
+        if (ret != OMX_ErrorNone)
+            break;
+        if (pFramerate->nPortIndex >= pSECComponent->portParam.nPorts) {
+            ret = OMX_ErrorBadPortIndex;
+            break;
+        }
+
+        pFramerate->xEncodeFramerate = pSECComponent->pSECPort[pFramerate->nPortIndex].portDefinition.format.video.xFramerate;
+    }
+        break;
+    default:
+        ret = OMX_ErrorUnsupportedIndex;
+        break;
+    }
+
+    return ret;
+}
+
+/*
+ * records a bitrate, frame rate or IDR request for the running stream, the
+ * MFC may be encoding right now so SEC_MFC_EncApplyRuntimeConfig passes it
+ * on when the codec starts the next frame.
+ */
+OMX_ERRORTYPE SEC_MFC_EncSetRuntimeConfig(OMX_COMPONENTTYPE *pOMXComponent, MFC_ENC_RUNTIME_CONFIG *pConfig, OMX_INDEXTYPE nIndex, OMX_PTR pComponentConfigStructure)
+{
+    OMX_ERRORTYPE          ret = OMX_ErrorNone;
+    SEC_OMX_BASECOMPONENT *pSECComponent = (SEC_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
+
+    switch (nIndex) {
+    case OMX_IndexConfigVideoBitrate:
+    {
+        OMX_VIDEO_CONFIG_BITRATETYPE *pBitrate = (OMX_VIDEO_CONFIG_BITRATETYPE *)pComponentConfigStructure;
+
+        ret = SEC_OMX_Check_SizeVersion(pBitrate, sizeof(OMX_VIDEO_CONFIG_BITRATETYPE));
+        if (ret != OMX_ErrorNone)
+            break;
+        if (pBitrate->nPortIndex != OUTPUT_PORT_INDEX) {
+            ret = OMX_ErrorBadPortIndex;
+            break;
+        }
+        if (pBitrate->nEncodeBitrate == 0) {
+            ret = OMX_ErrorBadParameter;
+            break;
+        }
+
+        pSECComponent->pSECPort[OUTPUT_PORT_INDEX].portDefinition.format.video.nBitrate = pBitrate->nEncodeBitrate;
+        pConfig->bBitrate = OMX_TRUE;
+    }
+        break;
+    case OMX_IndexConfigVideoFramerate:
+    {
+        OMX_CONFIG_FRAMERATETYPE *pFramerate = (OMX_CONFIG_FRAMERATETYPE *)pComponentConfigStructure;
+        OMX_U32                   i = 0;
+
+        ret = SEC_OMX_Check_SizeVersion(pFramerate, sizeof(OMX_CONFIG_FRAMERATETYPE));
+        if (ret != OMX_ErrorNone)
+            break;
+        if (pFramerate->nPortIndex >= pSECComponent->portParam.nPorts) {
+            ret = OMX_ErrorBadPortIndex;
+            break;
+        }
+        if ((pFramerate->xEncodeFramerate >> 16) == 0) {
+            ret = OMX_ErrorBadParameter;
+            break;
+        }
+
+        /* the encoder is set up from the input port frame rate, both ports follow */
+        for (i = 0; i < pSECComponent->portParam.nPorts; i++)
+            pSECComponent->pSECPort[i].portDefinition.format.video.xFramerate = pFramerate->xEncodeFramerate;
+        pConfig->bFramerate = OMX_TRUE;
+    }
+        break;
+    case OMX_IndexConfigVideoIntraVOPRefresh:
+    {
+        OMX_CONFIG_INTRAREFRESHVOPTYPE *pIntraRefresh = (OMX_CONFIG_INTRAREFRESHVOPTYPE *)pComponentConfigStructure;
+
+        ret = SEC_OMX_Check_SizeVersion(pIntraRefresh, sizeof(OMX_CONFIG_INTRAREFRESHVOPTYPE));
+        if (ret != OMX_ErrorNone)
+            break;
+        if (pIntraRefresh->nPortIndex != OUTPUT_PORT_INDEX) {
+            ret = OMX_ErrorBadPortIndex;
+            break;
+        }
+
+        if (pIntraRefresh->IntraRefreshVOP == OMX_TRUE)
+            pConfig->bIntraRefresh = OMX_TRUE;
+    }
+        break;
+    default:
+        ret = OMX_ErrorUnsupportedIndex;
+        break;
+    }
+
+    return ret;
+}
+
+/* called with the MFC idle, before the next frame is started */
+void SEC_MFC_EncApplyRuntimeConfig(OMX_COMPONENTTYPE *pOMXComponent, MFC_ENC_RUNTIME_CONFIG *pConfig, OMX_HANDLETYPE hMFCHandle)
+{
+    SEC_OMX_BASECOMPONENT *pSECComponent = (SEC_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
+    unsigned int           value = 0;
+
+    if (pConfig->bBitrate == OMX_TRUE) {
+        pConfig->bBitrate = OMX_FALSE;
+        value = pSECComponent->pSECPort[OUTPUT_PORT_INDEX].portDefinition.format.video.nBitrate;
+        if (SsbSipMfcEncSetConfig(hMFCHandle, MFC_ENC_SETCONF_CHANGE_BIT_RATE, &value) != MFC_RET_OK)
+            SEC_OSAL_Log(SEC_LOG_WARNING, "%s: bitrate %d is not taken", __FUNCTION__, value);
+    }
+
+    if (pConfig->bFramerate == OMX_TRUE) {
+        pConfig->bFramerate = OMX_FALSE;
+        value = pSECComponent->pSECPort[INPUT_PORT_INDEX].portDefinition.format.video.xFramerate >> 16;
+        if (SsbSipMfcEncSetConfig(hMFCHandle, MFC_ENC_SETCONF_CHANGE_FRAME_RATE, &value) != MFC_RET_OK)
+            SEC_OSAL_Log(SEC_LOG_WARNING, "%s: frame rate %d is not taken", __FUNCTION__, value);
+    }
+
+    if (pConfig->bIntraRefresh == OMX_TRUE) {
+        pConfig->bIntraRefresh = OMX_FALSE;
+        value = MFC_FRAME_TYPE_I_FRAME;
+        if (SsbSipMfcEncSetConfig(hMFCHandle, MFC_ENC_SETCONF_FRAME_TYPE, &value) != MFC_RET_OK)
+            SEC_OSAL_Log(SEC_LOG_WARNING, "%s: IDR request is not taken", __FUNCTION__);
+    }
+}
+
 OMX_ERRORTYPE SEC_OMX_VideoEncodeGetParameter(
     OMX_IN OMX_HANDLETYPE hComponent,
     OMX_IN OMX_INDEXTYPE  nParamIndex,
@@ -46,6 +46,10 @@
 
 #define MFC_INPUT_BUFFER_NUM_MAX            2
 
+/* the chroma of a linear NV12 frame the MFC encodes in place starts on a 2KB boundary */
+#define MFC_ENC_FRAME_ALIGN                 2048
+#define MFC_BUFFER_POOL_SLOT_NUM_MAX        32
+
 #ifdef USE_ANDROID_EXTENSION
 #define INPUT_PORT_SUPPORTFORMAT_NUM_MAX    4
 #else
@@ -65,15 +69,6 @@ typedef struct
     void *pAddrC;
 } MFC_ENC_ADDR_INFO;
 
-typedef struct _SEC_MFC_NBENC_THREAD
-{
-    OMX_HANDLETYPE  hNBEncodeThread;
-    OMX_HANDLETYPE  hEncFrameStart;
-    OMX_HANDLETYPE  hEncFrameEnd;
-    OMX_BOOL        bExitEncodeThread;
-    OMX_BOOL        bEncoderRun;
-} SEC_MFC_NBENC_THREAD;
-
 typedef struct _MFC_ENC_INPUT_BUFFER
 {
     void *YPhyAddr; // physical address of Y
@@ -84,8 +79,45 @@ typedef struct _MFC_ENC_INPUT_BUFFER
     int CBufferSize; // input buffer alloc size of CbCr
     int YDataSize;  // input size of Y data
     int CDataSize;  // input size of CbCr data
+
+    /* client frame encoded in place of the buffer above, returned once it is encoded */
+    OMX_BUFFERHEADERTYPE *pBufferHeader;
 } MFC_ENC_INPUT_BUFFER;
 
+typedef struct _SEC_MFC_NBENC_THREAD
+{
+    OMX_HANDLETYPE  hNBEncodeThread;
+    OMX_HANDLETYPE  hEncFrameStart;
+    OMX_HANDLETYPE  hEncFrameEnd;
+    OMX_BOOL        bExitEncodeThread;
+    OMX_BOOL        bEncoderRun;
+
+    /* slot of the frame being encoded, the thread returns its client buffer */
+    MFC_ENC_INPUT_BUFFER *pEncodeSlot;
+} SEC_MFC_NBENC_THREAD;
+
+/*
+ * input or output buffers SEC_OMX_AllocateBuffer hands out, each one an
+ * MFC frame buffer of its own
+ */
+typedef struct _MFC_ENC_BUFFER_POOL
+{
+    void    *PhyAddr[MFC_BUFFER_POOL_SLOT_NUM_MAX];
+    void    *VirAddr[MFC_BUFFER_POOL_SLOT_NUM_MAX];
+    OMX_U32  slotSize;
+    OMX_U32  slotNum;   // slots allocated from the MFC
+    OMX_U32  slotMask;  // slots owned by clients
+    OMX_BOOL bDisabled; // no MFC memory left, clients get heap buffers
+} MFC_ENC_BUFFER_POOL;
+
+/* stream settings changed with SetConfig, given to the MFC before the next frame */
+typedef struct _MFC_ENC_RUNTIME_CONFIG
+{
+    OMX_BOOL bBitrate;
+    OMX_BOOL bFramerate;
+    OMX_BOOL bIntraRefresh;
+} MFC_ENC_RUNTIME_CONFIG;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -129,6 +161,16 @@ OMX_ERRORTYPE SEC_OMX_VideoEncodeSetParameter(
     OMX_IN OMX_INDEXTYPE  nIndex,
     OMX_IN OMX_PTR        ComponentParameterStructure);
 OMX_ERRORTYPE SEC_OMX_VideoEncodeComponentDeinit(OMX_IN OMX_HANDLETYPE hComponent);
+OMX_ERRORTYPE SEC_InputBufferRelease(OMX_COMPONENTTYPE *pOMXComponent, OMX_BUFFERHEADERTYPE *bufferHeader);
+OMX_PTR SEC_MFC_EncBufferPoolAlloc(OMX_COMPONENTTYPE *pOMXComponent, MFC_ENC_BUFFER_POOL *pPool, OMX_HANDLETYPE hMFCHandle, OMX_U32 nSizeBytes);
+void SEC_MFC_EncBufferPoolFree(MFC_ENC_BUFFER_POOL *pPool, OMX_PTR pBuffer);
+OMX_ERRORTYPE SEC_MFC_EncInputSlotSet(OMX_COMPONENTTYPE *pOMXComponent, MFC_ENC_BUFFER_POOL *pPool, MFC_ENC_INPUT_BUFFER *pSlot, OMX_BUFFERHEADERTYPE *pBufferHeader);
+OMX_ERRORTYPE SEC_MFC_EncInputSlotHold(OMX_COMPONENTTYPE *pOMXComponent, MFC_ENC_INPUT_BUFFER *pSlot);
+OMX_BUFFERHEADERTYPE *SEC_MFC_EncOutputBufferTake(OMX_COMPONENTTYPE *pOMXComponent, MFC_ENC_BUFFER_POOL *pPool, OMX_HANDLETYPE hMFCHandle);
+void SEC_MFC_EncOutputBufferFlush(OMX_COMPONENTTYPE *pOMXComponent, OMX_BUFFERHEADERTYPE **ppBufferHeader, OMX_HANDLETYPE hMFCHandle);
+OMX_ERRORTYPE SEC_MFC_EncGetRuntimeConfig(OMX_COMPONENTTYPE *pOMXComponent, OMX_INDEXTYPE nIndex, OMX_PTR pComponentConfigStructure);
+OMX_ERRORTYPE SEC_MFC_EncSetRuntimeConfig(OMX_COMPONENTTYPE *pOMXComponent, MFC_ENC_RUNTIME_CONFIG *pConfig, OMX_INDEXTYPE nIndex, OMX_PTR pComponentConfigStructure);
+void SEC_MFC_EncApplyRuntimeConfig(OMX_COMPONENTTYPE *pOMXComponent, MFC_ENC_RUNTIME_CONFIG *pConfig, OMX_HANDLETYPE hMFCHandle);
 
 #ifdef __cplusplus
 }
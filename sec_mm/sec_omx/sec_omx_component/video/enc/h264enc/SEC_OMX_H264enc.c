@@ -32,6 +32,8 @@
 #include "SEC_OMX_Basecomponent.h"
 #include "SEC_OMX_Baseport.h"
 #include "SEC_OMX_Venc.h"
+#include "SEC_OSAL_FimcCsc.h"
+#include "SEC_OSAL_Thread.h"
 #include "library_register.h"
 #include "SEC_OMX_H264enc.h"
 #include "SsbSipMfcApi.h"
@@ -133,9 +135,9 @@ OMX_U32 OMXAVCLevelToLevelIDC(OMX_VIDEO_AVCLEVELTYPE level)
 
 OMX_U8 *FindDelimiter(OMX_U8 *pBuffer, OMX_U32 size)
 {
-    int i;
+    OMX_U32 i;
 
-    for (i = 0; i < size - 3; i++) {
+    for (i = 0; i + 3 < size; i++) {
         if ((pBuffer[i] == 0x00)   &&
             (pBuffer[i+1] == 0x00) &&
             (pBuffer[i+2] == 0x00) &&
@@ -146,6 +148,62 @@ OMX_U8 *FindDelimiter(OMX_U8 *pBuffer, OMX_U32 size)
     return NULL;
 }
 
+/* copies the header the MFC made at init and splits it into SPS and PPS */
+static OMX_ERRORTYPE H264Enc_KeepHeader(SEC_MFC_H264ENC_HANDLE *pHandle, OMX_U8 *pStream, OMX_U32 size)
+{
+    OMX_U8 *p = NULL;
+
+    if (pHandle->headerSize != size) {
+        if (pHandle->pHeader != NULL)
+            SEC_OSAL_Free(pHandle->pHeader);
+        pHandle->headerSize = 0;
+        pHandle->pHeader = SEC_OSAL_Malloc(size);
+        if (pHandle->pHeader == NULL)
+            return OMX_ErrorInsufficientResources;
+        pHandle->headerSize = size;
+    }
+    SEC_OSAL_Memcpy(pHandle->pHeader, pStream, size);
+    SEC_OSAL_Memcpy(&pHandle->headerParam, &pHandle->mfcVideoAvc, sizeof(SSBSIP_MFC_ENC_H264_PARAM));
+
+    if (size > 4)
+        p = FindDelimiter(pHandle->pHeader + 4, size - 4);
+    if (p == NULL)
+        p = pHandle->pHeader + size;
+
+    pHandle->headerData.pHeaderSPS = (OMX_PTR)pHandle->pHeader;
+    pHandle->headerData.SPSLen = p - pHandle->pHeader;
+    pHandle->headerData.pHeaderPPS = (OMX_PTR)p;
+    pHandle->headerData.PPSLen = size - pHandle->headerData.SPSLen;
+
+    return OMX_ErrorNone;
+}
+
+/*
+ * puts SPS and PPS in front of an IDR, in the buffer it was encoded to.
+ * a client buffer ends at nAllocLen, the own stream buffer at its half.
+ */
+static void H264Enc_PrependHeader(SEC_MFC_H264ENC_HANDLE *pHandle, SEC_OMX_DATA *pOutputData)
+{
+    OMX_U32 room = MAX_ENCODER_OUTPUT_BUFFER_SIZE / 2;
+
+    if ((pHandle->pHeader == NULL) || (pOutputData->dataLen == 0))
+        return;
+
+    if (pOutputData->bufferHeader != NULL)
+        room = pOutputData->bufferHeader->nAllocLen - (pOutputData->dataBuffer - pOutputData->bufferHeader->pBuffer);
+
+    if (pHandle->headerSize + pOutputData->dataLen > room) {
+        SEC_OSAL_Log(SEC_LOG_WARNING, "no room for SPS/PPS in front of the IDR: %d + %d > %d",
+                     pHandle->headerSize, pOutputData->dataLen, room);
+        return;
+    }
+
+    memmove(pOutputData->dataBuffer + pHandle->headerSize, pOutputData->dataBuffer, pOutputData->dataLen);
+    SEC_OSAL_Memcpy(pOutputData->dataBuffer, pHandle->pHeader, pHandle->headerSize);
+    pOutputData->dataLen += pHandle->headerSize;
+    pOutputData->allocSize = pOutputData->dataLen;
+}
+
 void H264PrintParams(SSBSIP_MFC_ENC_H264_PARAM h264Arg)
 {
     SEC_OSAL_Log(SEC_LOG_TRACE, "SourceWidth             : %d\n", h264Arg.SourceWidth);
@@ -197,7 +255,7 @@ void Set_H264ENC_Param(SSBSIP_MFC_ENC_H264_PARAM *pH264Arg, SEC_OMX_BASECOMPONEN
     pH264Arg->SourceWidth  = pSECOutputPort->portDefinition.format.video.nFrameWidth;
     pH264Arg->SourceHeight = pSECOutputPort->portDefinition.format.video.nFrameHeight;
     pH264Arg->IDRPeriod    = pH264Enc->AVCComponent[OUTPUT_PORT_INDEX].nPFrames + 1;
-    pH264Arg->SliceMode    = 0;
+    pH264Arg->SliceMode    = 0;             // 0: single, 1: MB count, 2: byte count
     pH264Arg->RandomIntraMBRefresh = 0;
     pH264Arg->EnableFRMRateControl = 1;        // 0: Disable, 1: Frame level RC
     pH264Arg->Bitrate      = pSECOutputPort->portDefinition.format.video.nBitrate;
@@ -216,6 +274,12 @@ void Set_H264ENC_Param(SSBSIP_MFC_ENC_H264_PARAM *pH264Arg, SEC_OMX_BASECOMPONEN
     pH264Arg->FrameQp_B    = 20;
     pH264Arg->FrameRate    = (pSECInputPort->portDefinition.format.video.xFramerate) >> 16;
     pH264Arg->SliceArgument = 0;          // Slice mb/byte size number
+    if (pH264Enc->AVCComponent[OUTPUT_PORT_INDEX].nSliceHeaderSpacing > 0) {
+        pH264Arg->SliceMode = (pH264Enc->AVCSliceFmo[OUTPUT_PORT_INDEX].eSliceMode == OMX_VIDEO_SLICEMODE_AVCByteSlice) ? 2 : 1;
+        pH264Arg->SliceArgument = pH264Enc->AVCComponent[OUTPUT_PORT_INDEX].nSliceHeaderSpacing;
+    }
+    /* a packetiser can send the first slices while the later ones are copied */
+    pSECComponent->bSliceOutput = (pH264Arg->SliceMode != 0) ? OMX_TRUE : OMX_FALSE;
     pH264Arg->NumberBFrames = 0;            // 0 ~ 2
     pH264Arg->NumberReferenceFrames = 1;
     pH264Arg->NumberRefForPframes   = 1;
@@ -421,6 +485,25 @@ OMX_ERRORTYPE SEC_MFC_H264Enc_GetParameter(
         pDstErrorCorrectionType->bEnableRVLC = pSrcErrorCorrectionType->bEnableRVLC;
     }
         break;
+    case OMX_IndexParamVideoSliceFMO:
+    {
+        OMX_VIDEO_PARAM_AVCSLICEFMO *pDstSliceFmo = (OMX_VIDEO_PARAM_AVCSLICEFMO *)pComponentParameterStructure;
+        SEC_H264ENC_HANDLE          *pH264Enc = NULL;
+
+        ret = SEC_OMX_Check_SizeVersion(pDstSliceFmo, sizeof(OMX_VIDEO_PARAM_AVCSLICEFMO));
+        if (ret != OMX_ErrorNone) {
+            goto EXIT;
+        }
+
+        if (pDstSliceFmo->nPortIndex >= ALL_PORT_NUM) {
+            ret = OMX_ErrorBadPortIndex;
+            goto EXIT;
+        }
+
+        pH264Enc = (SEC_H264ENC_HANDLE *)pSECComponent->hCodecHandle;
+        SEC_OSAL_Memcpy(pDstSliceFmo, &pH264Enc->AVCSliceFmo[pDstSliceFmo->nPortIndex], sizeof(OMX_VIDEO_PARAM_AVCSLICEFMO));
+    }
+        break;
     default:
         ret = SEC_OMX_VideoEncodeGetParameter(hComponent, nParamIndex, pComponentParameterStructure);
         break;
@@ -556,6 +639,32 @@ OMX_ERRORTYPE SEC_MFC_H264Enc_SetParameter(
         pDstErrorCorrectionType->bEnableRVLC = pSrcErrorCorrectionType->bEnableRVLC;
     }
         break;
+    case OMX_IndexParamVideoSliceFMO:
+    {
+        OMX_VIDEO_PARAM_AVCSLICEFMO *pSrcSliceFmo = (OMX_VIDEO_PARAM_AVCSLICEFMO *)pComponentParameterStructure;
+        SEC_H264ENC_HANDLE          *pH264Enc = NULL;
+
+        ret = SEC_OMX_Check_SizeVersion(pSrcSliceFmo, sizeof(OMX_VIDEO_PARAM_AVCSLICEFMO));
+        if (ret != OMX_ErrorNone) {
+            goto EXIT;
+        }
+
+        if (pSrcSliceFmo->nPortIndex >= ALL_PORT_NUM) {
+            ret = OMX_ErrorBadPortIndex;
+            goto EXIT;
+        }
+
+        /* the MFC has no slice groups */
+        if ((pSrcSliceFmo->nNumSliceGroups > 1) ||
+            (pSrcSliceFmo->eSliceMode > OMX_VIDEO_SLICEMODE_AVCByteSlice)) {
+            ret = OMX_ErrorUnsupportedSetting;
+            goto EXIT;
+        }
+
+        pH264Enc = (SEC_H264ENC_HANDLE *)pSECComponent->hCodecHandle;
+        SEC_OSAL_Memcpy(&pH264Enc->AVCSliceFmo[pSrcSliceFmo->nPortIndex], pSrcSliceFmo, sizeof(OMX_VIDEO_PARAM_AVCSLICEFMO));
+    }
+        break;
     default:
         ret = SEC_OMX_VideoEncodeSetParameter(hComponent, nIndex, pComponentParameterStructure);
         break;
@@ -603,6 +712,10 @@ OMX_ERRORTYPE SEC_MFC_H264Enc_GetConfig(
     }
 
     switch (nIndex) {
+    case OMX_IndexConfigVideoBitrate:
+    case OMX_IndexConfigVideoFramerate:
+        ret = SEC_MFC_EncGetRuntimeConfig(pOMXComponent, nIndex, pComponentConfigStructure);
+        break;
     default:
         ret = SEC_OMX_GetConfig(hComponent, nIndex, pComponentConfigStructure);
         break;
@@ -646,6 +759,24 @@ OMX_ERRORTYPE SEC_MFC_H264Enc_SetConfig(
     }
 
     switch (nIndex) {
+    case OMX_IndexConfigVideoBitrate:
+    case OMX_IndexConfigVideoFramerate:
+    case OMX_IndexConfigVideoIntraVOPRefresh:
+    {
+        SEC_H264ENC_HANDLE *pH264Enc = (SEC_H264ENC_HANDLE *)pSECComponent->hCodecHandle;
+
+        ret = SEC_MFC_EncSetRuntimeConfig(pOMXComponent, &pH264Enc->hMFCH264Handle.runtimeConfig, nIndex, pComponentConfigStructure);
+    }
+        break;
+    case OMX_IndexVendorPrependSPSPPS:
+    {
+        SEC_H264ENC_HANDLE *pH264Enc = (SEC_H264ENC_HANDLE *)pSECComponent->hCodecHandle;
+
+        pH264Enc->hMFCH264Handle.bPrependHeader = *((OMX_BOOL *)pComponentConfigStructure);
+
+        ret = OMX_ErrorNone;
+    }
+        break;
     default:
         ret = SEC_OMX_SetConfig(hComponent, nIndex, pComponentConfigStructure);
         break;
@@ -693,16 +824,17 @@ OMX_ERRORTYPE SEC_MFC_H264Enc_GetExtensionIndex(
         goto EXIT;
     }
 
+    if (SEC_OSAL_Strcmp(cParameterName, SEC_INDEX_CONFIG_PREPEND_SPSPPS) == 0) {
+        *pIndexType = OMX_IndexVendorPrependSPSPPS;
+        ret = OMX_ErrorNone;
 #ifdef USE_ANDROID_EXTENSION
-    if (SEC_OSAL_Strcmp(cParameterName, SEC_INDEX_PARAM_STORE_METADATA_BUFFER) == 0) {
+    } else if (SEC_OSAL_Strcmp(cParameterName, SEC_INDEX_PARAM_STORE_METADATA_BUFFER) == 0) {
         *pIndexType = OMX_IndexParamStoreMetaDataBuffer;
         ret = OMX_ErrorNone;
+#endif
     } else {
         ret = SEC_OMX_GetExtensionIndex(hComponent, cParameterName, pIndexType);
     }
-#else
-    ret = SEC_OMX_GetExtensionIndex(hComponent, cParameterName, pIndexType);
-#endif
 
 EXIT:
     FunctionOut();
@@ -756,7 +888,14 @@ OMX_ERRORTYPE SEC_MFC_EncodeThread(OMX_HANDLETYPE hComponent)
         SEC_OSAL_SemaphoreWait(pH264Enc->NBEncThread.hEncFrameStart);
 
         if (pH264Enc->NBEncThread.bExitEncodeThread == OMX_FALSE) {
+            SEC_OMX_MFC_RunBegin(&pSECComponent->mfcSession);
             pH264Enc->hMFCH264Handle.returnCodec = SsbSipMfcEncExe(pH264Enc->hMFCH264Handle.hMFCHandle);
+            SEC_OMX_MFC_RunEnd(&pSECComponent->mfcSession);
+            /* the MFC is done reading the frame, a client buffer it was in goes back now */
+            if (pH264Enc->NBEncThread.pEncodeSlot != NULL) {
+                SEC_MFC_EncInputSlotSet(pOMXComponent, &pH264Enc->MFCEncInputPool, pH264Enc->NBEncThread.pEncodeSlot, NULL);
+                pH264Enc->NBEncThread.pEncodeSlot = NULL;
+            }
             SEC_OSAL_SemaphorePost(pH264Enc->NBEncThread.hEncFrameEnd);
         }
     }
@@ -768,23 +907,23 @@ EXIT:
     return ret;
 }
 
-/* MFC Init */
-OMX_ERRORTYPE SEC_MFC_H264Enc_Init(OMX_COMPONENTTYPE *pOMXComponent)
+/*
+ * opens the MFC and allocates the two frame buffers input is copied to.
+ * input buffers are allocated before the Init, so they may open it first.
+ */
+static OMX_ERRORTYPE SEC_MFC_H264Enc_Open(OMX_COMPONENTTYPE *pOMXComponent)
 {
     OMX_ERRORTYPE              ret = OMX_ErrorNone;
     SEC_OMX_BASECOMPONENT     *pSECComponent = (SEC_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
-    SEC_OMX_BASEPORT          *pSECInputPort = &pSECComponent->pSECPort[INPUT_PORT_INDEX];
     SEC_OMX_BASEPORT          *pSECOutputPort = &pSECComponent->pSECPort[OUTPUT_PORT_INDEX];
-    SEC_H264ENC_HANDLE        *pH264Enc = NULL;
-    OMX_PTR                    hMFCHandle = NULL;
+    SEC_H264ENC_HANDLE        *pH264Enc = (SEC_H264ENC_HANDLE *)pSECComponent->hCodecHandle;
+    OMX_HANDLETYPE             hMFCHandle = NULL;
     OMX_S32                    returnCodec = 0;
 
     FunctionIn();
 
-    pH264Enc = (SEC_H264ENC_HANDLE *)pSECComponent->hCodecHandle;
-    pH264Enc->hMFCH264Handle.bConfiguredMFC = OMX_FALSE;
-    pSECComponent->bUseFlagEOF = OMX_FALSE;
-    pSECComponent->bSaveFlagEOS = OMX_FALSE;
+    if (pH264Enc->hMFCH264Handle.hMFCHandle != NULL)
+        goto EXIT;
 
     /* MFC(Multi Function Codec) encoder and CMM(Codec Memory Management) driver open */
     SSBIP_MFC_BUFFER_TYPE buf_type = CACHE;
@@ -832,6 +971,141 @@ OMX_ERRORTYPE SEC_MFC_H264Enc_Init(OMX_COMPONENTTYPE *pOMXComponent)
     SEC_OSAL_Log(SEC_LOG_TRACE, "pH264Enc->hMFCH264Handle.inputInfo.YVirAddr : 0x%x", pH264Enc->hMFCH264Handle.inputInfo.YVirAddr);
     SEC_OSAL_Log(SEC_LOG_TRACE, "pH264Enc->hMFCH264Handle.inputInfo.CVirAddr : 0x%x", pH264Enc->hMFCH264Handle.inputInfo.CVirAddr);
 
+EXIT:
+    /* the handle is of no use without its copy buffers */
+    if ((ret != OMX_ErrorNone) && (hMFCHandle != NULL)) {
+        SsbSipMfcEncClose(hMFCHandle);
+        pH264Enc->hMFCH264Handle.hMFCHandle = NULL;
+    }
+
+    FunctionOut();
+
+    return ret;
+}
+
+OMX_PTR SEC_MFC_H264Enc_AllocInputBuffer(OMX_COMPONENTTYPE *pOMXComponent, OMX_U32 nSizeBytes)
+{
+    SEC_OMX_BASECOMPONENT *pSECComponent = (SEC_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
+    SEC_H264ENC_HANDLE    *pH264Enc = (SEC_H264ENC_HANDLE *)pSECComponent->hCodecHandle;
+
+    if (SEC_MFC_H264Enc_Open(pOMXComponent) != OMX_ErrorNone)
+        return NULL;
+
+    return SEC_MFC_EncBufferPoolAlloc(pOMXComponent, &pH264Enc->MFCEncInputPool,
+                                     pH264Enc->hMFCH264Handle.hMFCHandle, nSizeBytes);
+}
+
+void SEC_MFC_H264Enc_FreeInputBuffer(OMX_COMPONENTTYPE *pOMXComponent, OMX_PTR pBuffer)
+{
+    SEC_OMX_BASECOMPONENT *pSECComponent = (SEC_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
+    SEC_H264ENC_HANDLE    *pH264Enc = (SEC_H264ENC_HANDLE *)pSECComponent->hCodecHandle;
+
+    SEC_MFC_EncBufferPoolFree(&pH264Enc->MFCEncInputPool, pBuffer);
+}
+
+/* encodes the next frame from a client buffer instead of the current slot */
+OMX_ERRORTYPE SEC_MFC_H264Enc_SetInputBuffer(OMX_COMPONENTTYPE *pOMXComponent, OMX_BUFFERHEADERTYPE *pBufferHeader)
+{
+    SEC_OMX_BASECOMPONENT *pSECComponent = (SEC_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
+    SEC_H264ENC_HANDLE    *pH264Enc = (SEC_H264ENC_HANDLE *)pSECComponent->hCodecHandle;
+
+    return SEC_MFC_EncInputSlotSet(pOMXComponent, &pH264Enc->MFCEncInputPool,
+                                   &pH264Enc->MFCEncInputBuffer[pH264Enc->indexInputBuffer], pBufferHeader);
+}
+
+/* returns the client buffers held by the slots, on flush */
+OMX_ERRORTYPE SEC_MFC_H264Enc_ReleaseInputBuffer(OMX_COMPONENTTYPE *pOMXComponent)
+{
+    SEC_OMX_BASECOMPONENT *pSECComponent = (SEC_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
+    SEC_H264ENC_HANDLE    *pH264Enc = (SEC_H264ENC_HANDLE *)pSECComponent->hCodecHandle;
+    MFC_ENC_INPUT_BUFFER  *pSlot = NULL;
+    int                    i = 0;
+
+    /* the MFC may still be reading one of them */
+    if (pH264Enc->NBEncThread.bEncoderRun == OMX_TRUE) {
+        SEC_OSAL_SemaphoreWait(pH264Enc->NBEncThread.hEncFrameEnd);
+        pH264Enc->NBEncThread.bEncoderRun = OMX_FALSE;
+    }
+
+    for (i = 0; i < MFC_INPUT_BUFFER_NUM_MAX; i++) {
+        if (pH264Enc->MFCEncInputBuffer[i].pBufferHeader != NULL)
+            SEC_MFC_EncInputSlotSet(pOMXComponent, &pH264Enc->MFCEncInputPool, &pH264Enc->MFCEncInputBuffer[i], NULL);
+    }
+
+    /* the next frame is copied to the current slot again */
+    pSlot = &pH264Enc->MFCEncInputBuffer[pH264Enc->indexInputBuffer];
+    pSECComponent->processData[INPUT_PORT_INDEX].specificBufferHeader.YPhyAddr = pSlot->YPhyAddr;
+    pSECComponent->processData[INPUT_PORT_INDEX].specificBufferHeader.CPhyAddr = pSlot->CPhyAddr;
+    pSECComponent->processData[INPUT_PORT_INDEX].specificBufferHeader.YVirAddr = pSlot->YVirAddr;
+    pSECComponent->processData[INPUT_PORT_INDEX].specificBufferHeader.CVirAddr = pSlot->CVirAddr;
+
+    return OMX_ErrorNone;
+}
+
+OMX_PTR SEC_MFC_H264Enc_AllocOutputBuffer(OMX_COMPONENTTYPE *pOMXComponent, OMX_U32 nSizeBytes)
+{
+    SEC_OMX_BASECOMPONENT *pSECComponent = (SEC_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
+    SEC_H264ENC_HANDLE   *pH264Enc = (SEC_H264ENC_HANDLE *)pSECComponent->hCodecHandle;
+
+    if (SEC_MFC_H264Enc_Open(pOMXComponent) != OMX_ErrorNone)
+        return NULL;
+
+    return SEC_MFC_EncBufferPoolAlloc(pOMXComponent, &pH264Enc->MFCEncOutputPool,
+                                     pH264Enc->hMFCH264Handle.hMFCHandle, nSizeBytes);
+}
+
+void SEC_MFC_H264Enc_FreeOutputBuffer(OMX_COMPONENTTYPE *pOMXComponent, OMX_PTR pBuffer)
+{
+    SEC_OMX_BASECOMPONENT *pSECComponent = (SEC_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
+    SEC_H264ENC_HANDLE   *pH264Enc = (SEC_H264ENC_HANDLE *)pSECComponent->hCodecHandle;
+
+    SEC_MFC_EncBufferPoolFree(&pH264Enc->MFCEncOutputPool, pBuffer);
+}
+
+/* returns the client buffers the MFC writes to, on flush */
+OMX_ERRORTYPE SEC_MFC_H264Enc_ReleaseOutputBuffer(OMX_COMPONENTTYPE *pOMXComponent)
+{
+    SEC_OMX_BASECOMPONENT *pSECComponent = (SEC_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
+    SEC_H264ENC_HANDLE   *pH264Enc = (SEC_H264ENC_HANDLE *)pSECComponent->hCodecHandle;
+
+    if (pH264Enc->NBEncThread.bEncoderRun == OMX_TRUE) {
+        SEC_OSAL_SemaphoreWait(pH264Enc->NBEncThread.hEncFrameEnd);
+        pH264Enc->NBEncThread.bEncoderRun = OMX_FALSE;
+    }
+
+    /* the frame in the encoder went to a buffer given back now, it is dropped */
+    if (pH264Enc->pOutputBufferHeader != NULL) {
+        SEC_MFC_EncInputSlotSet(pOMXComponent, &pH264Enc->MFCEncInputPool,
+                                &pH264Enc->MFCEncInputBuffer[(pH264Enc->indexInputBuffer + MFC_INPUT_BUFFER_NUM_MAX - 1) % MFC_INPUT_BUFFER_NUM_MAX],
+                                NULL);
+        pH264Enc->bFirstFrame = OMX_TRUE;
+    }
+
+    SEC_MFC_EncOutputBufferFlush(pOMXComponent, &pH264Enc->pOutputBufferHeader, pH264Enc->hMFCH264Handle.hMFCHandle);
+
+    return OMX_ErrorNone;
+}
+
+/* MFC Init */
+OMX_ERRORTYPE SEC_MFC_H264Enc_Init(OMX_COMPONENTTYPE *pOMXComponent)
+{
+    OMX_ERRORTYPE              ret = OMX_ErrorNone;
+    SEC_OMX_BASECOMPONENT     *pSECComponent = (SEC_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
+    SEC_OMX_BASEPORT          *pSECInputPort = &pSECComponent->pSECPort[INPUT_PORT_INDEX];
+    SEC_H264ENC_HANDLE        *pH264Enc = NULL;
+
+    FunctionIn();
+
+    pH264Enc = (SEC_H264ENC_HANDLE *)pSECComponent->hCodecHandle;
+    pH264Enc->hMFCH264Handle.bConfiguredMFC = OMX_FALSE;
+    SEC_OSAL_Memset(&pH264Enc->hMFCH264Handle.runtimeConfig, 0, sizeof(MFC_ENC_RUNTIME_CONFIG));
+    pSECComponent->bUseFlagEOF = OMX_FALSE;
+    pSECComponent->bSaveFlagEOS = OMX_FALSE;
+
+    ret = SEC_MFC_H264Enc_Open(pOMXComponent);
+    if (ret != OMX_ErrorNone)
+        goto EXIT;
+
     pSECComponent->processData[INPUT_PORT_INDEX].specificBufferHeader.YPhyAddr = pH264Enc->MFCEncInputBuffer[0].YPhyAddr;
     pSECComponent->processData[INPUT_PORT_INDEX].specificBufferHeader.CPhyAddr = pH264Enc->MFCEncInputBuffer[0].CPhyAddr;
     pSECComponent->processData[INPUT_PORT_INDEX].specificBufferHeader.YVirAddr = pH264Enc->MFCEncInputBuffer[0].YVirAddr;
@@ -841,19 +1115,20 @@ OMX_ERRORTYPE SEC_MFC_H264Enc_Init(OMX_COMPONENTTYPE *pOMXComponent)
 
     pH264Enc->indexInputBuffer = 0;
     pH264Enc->bFirstFrame = OMX_TRUE;
+    SEC_FIMC_CscInit(&pH264Enc->fimcCsc);
 
     pH264Enc->NBEncThread.bExitEncodeThread = OMX_FALSE;
     pH264Enc->NBEncThread.bEncoderRun = OMX_FALSE;
+    pH264Enc->NBEncThread.pEncodeSlot = NULL;
     SEC_OSAL_SemaphoreCreate(&(pH264Enc->NBEncThread.hEncFrameStart));
     SEC_OSAL_SemaphoreCreate(&(pH264Enc->NBEncThread.hEncFrameEnd));
-    if (OMX_ErrorNone == SEC_OSAL_ThreadCreate(&pH264Enc->NBEncThread.hNBEncodeThread,
+    if (OMX_ErrorNone == SEC_OSAL_ThreadCreateRole(&pH264Enc->NBEncThread.hNBEncodeThread,
                                                 SEC_MFC_EncodeThread,
-                                                pOMXComponent)) {
+                                                pOMXComponent, SEC_OSAL_THREAD_ROLE_VIDEO)) {
         pH264Enc->hMFCH264Handle.returnCodec = MFC_RET_OK;
     }
 
-    SEC_OSAL_Memset(pSECComponent->timeStamp, -19771003, sizeof(OMX_TICKS) * MAX_TIMESTAMP);
-    SEC_OSAL_Memset(pSECComponent->nFlags, 0, sizeof(OMX_U32) * MAX_FLAGS);
+    SEC_OMX_TimestampMapReset(&pSECComponent->timestampMap);
     pH264Enc->hMFCH264Handle.indexTimestamp = 0;
 
 EXIT:
@@ -880,6 +1155,7 @@ OMX_ERRORTYPE SEC_MFC_H264Enc_Terminate(OMX_COMPONENTTYPE *pOMXComponent)
         SEC_OSAL_ThreadTerminate(pH264Enc->NBEncThread.hNBEncodeThread);
         pH264Enc->NBEncThread.hNBEncodeThread = NULL;
     }
+    SEC_FIMC_CscDeinit(&pH264Enc->fimcCsc);
 
     if(pH264Enc->NBEncThread.hEncFrameEnd != NULL) {
         SEC_OSAL_SemaphoreTerminate(pH264Enc->NBEncThread.hEncFrameEnd);
@@ -896,6 +1172,12 @@ OMX_ERRORTYPE SEC_MFC_H264Enc_Terminate(OMX_COMPONENTTYPE *pOMXComponent)
         SsbSipMfcEncClose(hMFCHandle);
         hMFCHandle = pH264Enc->hMFCH264Handle.hMFCHandle = NULL;
     }
+    /* the MFC memory is gone with the handle, the client frees its buffers after this */
+    SEC_OSAL_Memset(&pH264Enc->MFCEncInputPool, 0, sizeof(MFC_ENC_BUFFER_POOL));
+    SEC_OSAL_Memset(&pH264Enc->MFCEncOutputPool, 0, sizeof(MFC_ENC_BUFFER_POOL));
+    pH264Enc->pOutputBufferHeader = NULL;
+    pH264Enc->MFCEncInputBuffer[0].pBufferHeader = NULL;
+    pH264Enc->MFCEncInputBuffer[1].pBufferHeader = NULL;
 
 EXIT:
     FunctionOut();
@@ -913,6 +1195,7 @@ OMX_ERRORTYPE SEC_MFC_H264_Encode(OMX_COMPONENTTYPE *pOMXComponent, SEC_OMX_DATA
     SEC_OMX_BASEPORT          *pSECPort = NULL;
     MFC_ENC_ADDR_INFO          addrInfo;
     OMX_U32                    oneFrameSize = pInputData->dataLen;
+    OMX_BOOL                   bCameraFrame = OMX_FALSE;
 
     FunctionIn();
 
@@ -930,26 +1213,21 @@ OMX_ERRORTYPE SEC_MFC_H264_Encode(OMX_COMPONENTTYPE *pOMXComponent, SEC_OMX_DATA
             SEC_OSAL_Log(SEC_LOG_TRACE, "%s - SsbSipMfcEncGetOutBuf Failed\n", __func__);
             ret = OMX_ErrorUndefined;
             goto EXIT;
-        } else {
-            char *p = NULL;
-            int iSpsSize = 0;
-            int iPpsSize = 0;
-
-            p = FindDelimiter((OMX_U8 *)outputInfo.StrmVirAddr + 4, outputInfo.headerSize - 4);
-
-            iSpsSize = (unsigned int)p - (unsigned int)outputInfo.StrmVirAddr;
-            pH264Enc->hMFCH264Handle.headerData.pHeaderSPS = (OMX_PTR)outputInfo.StrmVirAddr;
-            pH264Enc->hMFCH264Handle.headerData.SPSLen = iSpsSize;
+        }
 
-            iPpsSize = outputInfo.headerSize - iSpsSize;
-            pH264Enc->hMFCH264Handle.headerData.pHeaderPPS = outputInfo.StrmVirAddr + iSpsSize;
-            pH264Enc->hMFCH264Handle.headerData.PPSLen = iPpsSize;
+        /* the same parameters give the same header, a restart sends the one kept */
+        if ((pH264Enc->hMFCH264Handle.pHeader == NULL) ||
+            (pH264Enc->hMFCH264Handle.headerSize != outputInfo.headerSize) ||
+            (memcmp(&pH264Enc->hMFCH264Handle.headerParam, &pH264Enc->hMFCH264Handle.mfcVideoAvc,
+                    sizeof(SSBSIP_MFC_ENC_H264_PARAM)) != 0)) {
+            ret = H264Enc_KeepHeader(&pH264Enc->hMFCH264Handle, (OMX_U8 *)outputInfo.StrmVirAddr, outputInfo.headerSize);
+            if (ret != OMX_ErrorNone)
+                goto EXIT;
         }
 
-        /* SEC_OSAL_Memcpy((void*)(pOutputData->dataBuffer), (const void*)(outputInfo.StrmVirAddr), outputInfo.headerSize); */
-        pOutputData->dataBuffer = outputInfo.StrmVirAddr;
-        pOutputData->allocSize = outputInfo.headerSize;
-        pOutputData->dataLen = outputInfo.headerSize;
+        pOutputData->dataBuffer = pH264Enc->hMFCH264Handle.pHeader;
+        pOutputData->allocSize = pH264Enc->hMFCH264Handle.headerSize;
+        pOutputData->dataLen = pH264Enc->hMFCH264Handle.headerSize;
         pOutputData->timeStamp = 0;
         pOutputData->nFlags |= OMX_BUFFERFLAG_CODECCONFIG;
         pOutputData->nFlags |= OMX_BUFFERFLAG_ENDOFFRAME;
@@ -988,9 +1266,11 @@ OMX_ERRORTYPE SEC_MFC_H264_Encode(OMX_COMPONENTTYPE *pOMXComponent, SEC_OMX_DATA
         pInputInfo->CPhyAddr = addrInfo.pAddrC;
 #ifdef USE_ANDROID_EXTENSION
     } else if (pSECPort->bStoreMetaDataInBuffer != OMX_FALSE) {
-        ret = preprocessMetaDataInBuffers(pOMXComponent, pInputData->dataBuffer, pInputInfo);
+        ret = preprocessMetaDataInBuffers(pOMXComponent, pInputData->dataBuffer, pInputInfo, &pH264Enc->fimcCsc);
         if (ret != OMX_ErrorNone)
             goto EXIT;
+        /* a gralloc frame is converted to our own slot, a camera frame is read in place */
+        bCameraFrame = (isMetadataBufferTypeGrallocSource(pInputData->dataBuffer) == OMX_FALSE) ? OMX_TRUE : OMX_FALSE;
 #endif
     } else {
         /* Real input data */
@@ -998,8 +1278,8 @@ OMX_ERRORTYPE SEC_MFC_H264_Encode(OMX_COMPONENTTYPE *pOMXComponent, SEC_OMX_DATA
         pInputInfo->CPhyAddr = pSECComponent->processData[INPUT_PORT_INDEX].specificBufferHeader.CPhyAddr;
     }
 
-    pSECComponent->timeStamp[pH264Enc->hMFCH264Handle.indexTimestamp] = pInputData->timeStamp;
-    pSECComponent->nFlags[pH264Enc->hMFCH264Handle.indexTimestamp] = pInputData->nFlags;
+    pH264Enc->hMFCH264Handle.indexTimestamp = SEC_OMX_TimestampMapPut(&pSECComponent->timestampMap,
+                                                                  pInputData->timeStamp, pInputData->nFlags);
 
     if ((pH264Enc->hMFCH264Handle.returnCodec == MFC_RET_OK) &&
         (pH264Enc->bFirstFrame == OMX_FALSE)) {
@@ -1013,12 +1293,10 @@ OMX_ERRORTYPE SEC_MFC_H264_Encode(OMX_COMPONENTTYPE *pOMXComponent, SEC_OMX_DATA
 
         pH264Enc->hMFCH264Handle.returnCodec = SsbSipMfcEncGetOutBuf(pH264Enc->hMFCH264Handle.hMFCHandle, &outputInfo);
         if ((SsbSipMfcEncGetConfig(pH264Enc->hMFCH264Handle.hMFCHandle, MFC_ENC_GETCONF_FRAME_TAG, &indexTimestamp) != MFC_RET_OK) ||
-            (((indexTimestamp < 0) || (indexTimestamp >= MAX_TIMESTAMP)))){
+            (SEC_OMX_TimestampMapGet(&pSECComponent->timestampMap, indexTimestamp,
+                                     &pOutputData->timeStamp, &pOutputData->nFlags) == OMX_FALSE)) {
             pOutputData->timeStamp = pInputData->timeStamp;
             pOutputData->nFlags = pInputData->nFlags;
-        } else {
-            pOutputData->timeStamp = pSECComponent->timeStamp[indexTimestamp];
-            pOutputData->nFlags = pSECComponent->nFlags[indexTimestamp];
         }
 
         if (pH264Enc->hMFCH264Handle.returnCodec == MFC_RET_OK) {
@@ -1027,10 +1305,15 @@ OMX_ERRORTYPE SEC_MFC_H264_Encode(OMX_COMPONENTTYPE *pOMXComponent, SEC_OMX_DATA
             pOutputData->allocSize = outputInfo.dataSize;
             pOutputData->dataLen = outputInfo.dataSize;
             pOutputData->usedDataLen = 0;
+            pOutputData->bufferHeader = pH264Enc->pOutputBufferHeader;
+            pH264Enc->pOutputBufferHeader = NULL;
 
             pOutputData->nFlags |= OMX_BUFFERFLAG_ENDOFFRAME;
-            if (outputInfo.frameType == MFC_FRAME_TYPE_I_FRAME)
-                    pOutputData->nFlags |= OMX_BUFFERFLAG_SYNCFRAME;
+            if (outputInfo.frameType == MFC_FRAME_TYPE_I_FRAME) {
+                pOutputData->nFlags |= OMX_BUFFERFLAG_SYNCFRAME;
+                if (pH264Enc->hMFCH264Handle.bPrependHeader == OMX_TRUE)
+                    H264Enc_PrependHeader(&pH264Enc->hMFCH264Handle, pOutputData);
+            }
 
             SEC_OSAL_Log(SEC_LOG_TRACE, "MFC Encode OK!!!!!!!!!!!!!!!!!!!!!!!!!!!!!\n");
 
@@ -1068,6 +1351,10 @@ OMX_ERRORTYPE SEC_MFC_H264_Encode(OMX_COMPONENTTYPE *pOMXComponent, SEC_OMX_DATA
         ret = OMX_ErrorUndefined;
         goto EXIT;
     } else {
+        /* the camera gets the frame back once the encode thread saw the MFC through it */
+        if (bCameraFrame == OMX_TRUE)
+            SEC_MFC_EncInputSlotHold(pOMXComponent, &pH264Enc->MFCEncInputBuffer[pH264Enc->indexInputBuffer]);
+        pH264Enc->NBEncThread.pEncodeSlot = &pH264Enc->MFCEncInputBuffer[pH264Enc->indexInputBuffer];
         pH264Enc->indexInputBuffer++;
         pH264Enc->indexInputBuffer %= MFC_INPUT_BUFFER_NUM_MAX;
         pSECComponent->processData[INPUT_PORT_INDEX].specificBufferHeader.YPhyAddr = pH264Enc->MFCEncInputBuffer[pH264Enc->indexInputBuffer].YPhyAddr;
@@ -1078,13 +1365,13 @@ OMX_ERRORTYPE SEC_MFC_H264_Encode(OMX_COMPONENTTYPE *pOMXComponent, SEC_OMX_DATA
         pSECComponent->processData[INPUT_PORT_INDEX].specificBufferHeader.CSize = pH264Enc->MFCEncInputBuffer[pH264Enc->indexInputBuffer].CBufferSize;
     }
 
+    SEC_MFC_EncApplyRuntimeConfig(pOMXComponent, &pH264Enc->hMFCH264Handle.runtimeConfig, pH264Enc->hMFCH264Handle.hMFCHandle);
     SsbSipMfcEncSetConfig(pH264Enc->hMFCH264Handle.hMFCHandle, MFC_ENC_SETCONF_FRAME_TAG, &(pH264Enc->hMFCH264Handle.indexTimestamp));
+    pH264Enc->pOutputBufferHeader = SEC_MFC_EncOutputBufferTake(pOMXComponent, &pH264Enc->MFCEncOutputPool, pH264Enc->hMFCH264Handle.hMFCHandle);
 
     /* mfc encode start */
     SEC_OSAL_SemaphorePost(pH264Enc->NBEncThread.hEncFrameStart);
     pH264Enc->NBEncThread.bEncoderRun = OMX_TRUE;
-    pH264Enc->hMFCH264Handle.indexTimestamp++;
-    pH264Enc->hMFCH264Handle.indexTimestamp %= MAX_TIMESTAMP;
     pH264Enc->bFirstFrame = OMX_FALSE;
 
 EXIT:
@@ -1243,6 +1530,11 @@ OSCL_EXPORT_REF OMX_ERRORTYPE SEC_OMX_ComponentInit(OMX_HANDLETYPE hComponent, O
         pH264Enc->AVCComponent[i].nPortIndex = i;
         pH264Enc->AVCComponent[i].eProfile   = OMX_VIDEO_AVCProfileBaseline;
         pH264Enc->AVCComponent[i].eLevel     = OMX_VIDEO_AVCLevel31;
+
+        INIT_SET_SIZE_VERSION(&pH264Enc->AVCSliceFmo[i], OMX_VIDEO_PARAM_AVCSLICEFMO);
+        pH264Enc->AVCSliceFmo[i].nPortIndex      = i;
+        pH264Enc->AVCSliceFmo[i].nNumSliceGroups = 1;
+        pH264Enc->AVCSliceFmo[i].eSliceMode      = OMX_VIDEO_SLICEMODE_AVCDefault;
     }
 
     pOMXComponent->GetParameter      = &SEC_MFC_H264Enc_GetParameter;
@@ -1258,6 +1550,14 @@ OSCL_EXPORT_REF OMX_ERRORTYPE SEC_OMX_ComponentInit(OMX_HANDLETYPE hComponent, O
     pSECComponent->sec_mfc_bufferProcess      = &SEC_MFC_H264Enc_bufferProcess;
     pSECComponent->sec_checkInputFrame        = NULL;
 
+    pSECComponent->sec_mfc_allocInputBuffer   = &SEC_MFC_H264Enc_AllocInputBuffer;
+    pSECComponent->sec_mfc_freeInputBuffer    = &SEC_MFC_H264Enc_FreeInputBuffer;
+    pSECComponent->sec_mfc_setInputBuffer     = &SEC_MFC_H264Enc_SetInputBuffer;
+    pSECComponent->sec_mfc_releaseInputBuffer = &SEC_MFC_H264Enc_ReleaseInputBuffer;
+    pSECComponent->sec_mfc_allocOutputBuffer  = &SEC_MFC_H264Enc_AllocOutputBuffer;
+    pSECComponent->sec_mfc_freeOutputBuffer   = &SEC_MFC_H264Enc_FreeOutputBuffer;
+    pSECComponent->sec_mfc_releaseOutputBuffer = &SEC_MFC_H264Enc_ReleaseOutputBuffer;
+
     pSECComponent->currentState = OMX_StateLoaded;
 
     ret = OMX_ErrorNone;
@@ -1289,6 +1589,11 @@ OMX_ERRORTYPE SEC_OMX_ComponentDeinit(OMX_HANDLETYPE hComponent)
 
     pH264Enc = (SEC_H264ENC_HANDLE *)pSECComponent->hCodecHandle;
     if (pH264Enc != NULL) {
+        /* opened by an input buffer allocation that never reached Idle */
+        if (pH264Enc->hMFCH264Handle.hMFCHandle != NULL)
+            SsbSipMfcEncClose(pH264Enc->hMFCH264Handle.hMFCHandle);
+        if (pH264Enc->hMFCH264Handle.pHeader != NULL)
+            SEC_OSAL_Free(pH264Enc->hMFCH264Handle.pHeader);
         SEC_OSAL_Free(pH264Enc);
         pH264Enc = pSECComponent->hCodecHandle = NULL;
     }
@@ -49,7 +49,13 @@ typedef struct _SEC_MFC_H264ENC_HANDLE
 /*    SSBSIP_MFC_ENC_OUTPUT_INFO outputInfo; */
     OMX_U32 indexTimestamp;
     OMX_BOOL bConfiguredMFC;
+    MFC_ENC_RUNTIME_CONFIG runtimeConfig;
+    /* SPS and PPS made for headerParam, kept over Terminate for the next Init */
     EXTRA_DATA headerData;
+    OMX_U8 *pHeader;
+    OMX_U32 headerSize;
+    SSBSIP_MFC_ENC_H264_PARAM headerParam;
+    OMX_BOOL bPrependHeader;
     OMX_S32 returnCodec;
 } SEC_MFC_H264ENC_HANDLE;
 
@@ -57,6 +63,8 @@ typedef struct _SEC_H264ENC_HANDLE
 {
     /* OMX Codec specific */
     OMX_VIDEO_PARAM_AVCTYPE AVCComponent[ALL_PORT_NUM];
+    /* eSliceMode picks how AVCComponent's nSliceHeaderSpacing counts, MBs or bytes */
+    OMX_VIDEO_PARAM_AVCSLICEFMO AVCSliceFmo[ALL_PORT_NUM];
     OMX_VIDEO_PARAM_ERRORCORRECTIONTYPE errorCorrectionType[ALL_PORT_NUM];
 
     /* SEC MFC Codec specific */
@@ -67,6 +75,11 @@ typedef struct _SEC_H264ENC_HANDLE
     OMX_BOOL bFirstFrame;
     MFC_ENC_INPUT_BUFFER MFCEncInputBuffer[MFC_INPUT_BUFFER_NUM_MAX];
     OMX_U32  indexInputBuffer;
+    MFC_ENC_BUFFER_POOL MFCEncInputPool;
+    MFC_ENC_BUFFER_POOL MFCEncOutputPool;
+    /* client buffer the frame in the encoder is written to */
+    OMX_BUFFERHEADERTYPE *pOutputBufferHeader;
+    SEC_FIMC_CSC fimcCsc;
 } SEC_H264ENC_HANDLE;
 
 #ifdef __cplusplus
@@ -11,6 +11,7 @@ LOCAL_SRC_FILES := \
 LOCAL_MODULE := libOMX.SEC.M4V.Encoder.aries
 
 LOCAL_CFLAGS :=
+LOCAL_CFLAGS += $(SEC_OMX_LOG_CFLAGS)
 
 LOCAL_ARM_MODE := arm
 
@@ -33,6 +33,8 @@
 #include "SEC_OMX_Basecomponent.h"
 #include "SEC_OMX_Baseport.h"
 #include "SEC_OMX_Venc.h"
+#include "SEC_OSAL_FimcCsc.h"
+#include "SEC_OSAL_Thread.h"
 #include "library_register.h"
 #include "SEC_OMX_Mpeg4enc.h"
 #include "SsbSipMfcApi.h"
@@ -749,6 +751,10 @@ OMX_ERRORTYPE SEC_MFC_Mpeg4Enc_GetConfig(
     }
 
     switch (nIndex) {
+    case OMX_IndexConfigVideoBitrate:
+    case OMX_IndexConfigVideoFramerate:
+        ret = SEC_MFC_EncGetRuntimeConfig(pOMXComponent, nIndex, pComponentConfigStructure);
+        break;
     default:
         ret = SEC_OMX_GetConfig(hComponent, nIndex, pComponentConfigStructure);
         break;
@@ -792,6 +798,15 @@ OMX_ERRORTYPE SEC_MFC_Mpeg4Enc_SetConfig(
     }
 
     switch (nIndex) {
+    case OMX_IndexConfigVideoBitrate:
+    case OMX_IndexConfigVideoFramerate:
+    case OMX_IndexConfigVideoIntraVOPRefresh:
+    {
+        SEC_MPEG4ENC_HANDLE *pMpeg4Enc = (SEC_MPEG4ENC_HANDLE *)pSECComponent->hCodecHandle;
+
+        ret = SEC_MFC_EncSetRuntimeConfig(pOMXComponent, &pMpeg4Enc->hMFCMpeg4Handle.runtimeConfig, nIndex, pComponentConfigStructure);
+    }
+        break;
     default:
         ret = SEC_OMX_SetConfig(hComponent, nIndex, pComponentConfigStructure);
         break;
@@ -925,7 +940,14 @@ OMX_ERRORTYPE SEC_MFC_EncodeThread(OMX_HANDLETYPE hComponent)
         SEC_OSAL_SemaphoreWait(pMpeg4Enc->NBEncThread.hEncFrameStart);
 
         if (pMpeg4Enc->NBEncThread.bExitEncodeThread == OMX_FALSE) {
+            SEC_OMX_MFC_RunBegin(&pSECComponent->mfcSession);
             pMpeg4Enc->hMFCMpeg4Handle.returnCodec = SsbSipMfcEncExe(pMpeg4Enc->hMFCMpeg4Handle.hMFCHandle);
+            SEC_OMX_MFC_RunEnd(&pSECComponent->mfcSession);
+            /* the MFC is done reading the frame, a client buffer it was in goes back now */
+            if (pMpeg4Enc->NBEncThread.pEncodeSlot != NULL) {
+                SEC_MFC_EncInputSlotSet(pOMXComponent, &pMpeg4Enc->MFCEncInputPool, pMpeg4Enc->NBEncThread.pEncodeSlot, NULL);
+                pMpeg4Enc->NBEncThread.pEncodeSlot = NULL;
+            }
             SEC_OSAL_SemaphorePost(pMpeg4Enc->NBEncThread.hEncFrameEnd);
         }
     }
@@ -937,24 +959,23 @@ EXIT:
     return ret;
 }
 
-/* MFC Init */
-OMX_ERRORTYPE SEC_MFC_Mpeg4Enc_Init(OMX_COMPONENTTYPE *pOMXComponent)
+/*
+ * opens the MFC and allocates the two frame buffers input is copied to.
+ * input buffers are allocated before the Init, so they may open it first.
+ */
+static OMX_ERRORTYPE SEC_MFC_Mpeg4Enc_Open(OMX_COMPONENTTYPE *pOMXComponent)
 {
     OMX_ERRORTYPE              ret = OMX_ErrorNone;
     SEC_OMX_BASECOMPONENT     *pSECComponent = (SEC_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
-    SEC_OMX_BASEPORT          *pSECInputPort = &pSECComponent->pSECPort[INPUT_PORT_INDEX];
     SEC_OMX_BASEPORT          *pSECOutputPort = &pSECComponent->pSECPort[OUTPUT_PORT_INDEX];
-    SEC_OMX_BASEPORT          *pSECPort = NULL;
-    SEC_MPEG4ENC_HANDLE       *pMpeg4Enc = NULL;
+    SEC_MPEG4ENC_HANDLE       *pMpeg4Enc = (SEC_MPEG4ENC_HANDLE *)pSECComponent->hCodecHandle;
     OMX_HANDLETYPE             hMFCHandle = NULL;
     OMX_S32                    returnCodec = 0;
 
     FunctionIn();
 
-    pMpeg4Enc = (SEC_MPEG4ENC_HANDLE *)pSECComponent->hCodecHandle;
-    pMpeg4Enc->hMFCMpeg4Handle.bConfiguredMFC = OMX_FALSE;
-    pSECComponent->bUseFlagEOF = OMX_FALSE;
-    pSECComponent->bSaveFlagEOS = OMX_FALSE;
+    if (pMpeg4Enc->hMFCMpeg4Handle.hMFCHandle != NULL)
+        goto EXIT;
 
     /* MFC(Multi Format Codec) encoder and CMM(Codec Memory Management) driver open */
     SSBIP_MFC_BUFFER_TYPE buf_type = CACHE;
@@ -1010,6 +1031,142 @@ OMX_ERRORTYPE SEC_MFC_Mpeg4Enc_Init(OMX_COMPONENTTYPE *pOMXComponent)
     SEC_OSAL_Log(SEC_LOG_TRACE, "pMpeg4Enc->hMFCMpeg4Handle.inputInfo.YVirAddr : 0x%x", pMpeg4Enc->hMFCMpeg4Handle.inputInfo.YVirAddr);
     SEC_OSAL_Log(SEC_LOG_TRACE, "pMpeg4Enc->hMFCMpeg4Handle.inputInfo.CVirAddr : 0x%x", pMpeg4Enc->hMFCMpeg4Handle.inputInfo.CVirAddr);
 
+EXIT:
+    /* the handle is of no use without its copy buffers */
+    if ((ret != OMX_ErrorNone) && (hMFCHandle != NULL)) {
+        SsbSipMfcEncClose(hMFCHandle);
+        pMpeg4Enc->hMFCMpeg4Handle.hMFCHandle = NULL;
+    }
+
+    FunctionOut();
+
+    return ret;
+}
+
+OMX_PTR SEC_MFC_Mpeg4Enc_AllocInputBuffer(OMX_COMPONENTTYPE *pOMXComponent, OMX_U32 nSizeBytes)
+{
+    SEC_OMX_BASECOMPONENT *pSECComponent = (SEC_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
+    SEC_MPEG4ENC_HANDLE   *pMpeg4Enc = (SEC_MPEG4ENC_HANDLE *)pSECComponent->hCodecHandle;
+
+    if (SEC_MFC_Mpeg4Enc_Open(pOMXComponent) != OMX_ErrorNone)
+        return NULL;
+
+    return SEC_MFC_EncBufferPoolAlloc(pOMXComponent, &pMpeg4Enc->MFCEncInputPool,
+                                     pMpeg4Enc->hMFCMpeg4Handle.hMFCHandle, nSizeBytes);
+}
+
+void SEC_MFC_Mpeg4Enc_FreeInputBuffer(OMX_COMPONENTTYPE *pOMXComponent, OMX_PTR pBuffer)
+{
+    SEC_OMX_BASECOMPONENT *pSECComponent = (SEC_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
+    SEC_MPEG4ENC_HANDLE   *pMpeg4Enc = (SEC_MPEG4ENC_HANDLE *)pSECComponent->hCodecHandle;
+
+    SEC_MFC_EncBufferPoolFree(&pMpeg4Enc->MFCEncInputPool, pBuffer);
+}
+
+/* encodes the next frame from a client buffer instead of the current slot */
+OMX_ERRORTYPE SEC_MFC_Mpeg4Enc_SetInputBuffer(OMX_COMPONENTTYPE *pOMXComponent, OMX_BUFFERHEADERTYPE *pBufferHeader)
+{
+    SEC_OMX_BASECOMPONENT *pSECComponent = (SEC_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
+    SEC_MPEG4ENC_HANDLE   *pMpeg4Enc = (SEC_MPEG4ENC_HANDLE *)pSECComponent->hCodecHandle;
+
+    return SEC_MFC_EncInputSlotSet(pOMXComponent, &pMpeg4Enc->MFCEncInputPool,
+                                   &pMpeg4Enc->MFCEncInputBuffer[pMpeg4Enc->indexInputBuffer], pBufferHeader);
+}
+
+/* returns the client buffers held by the slots, on flush */
+OMX_ERRORTYPE SEC_MFC_Mpeg4Enc_ReleaseInputBuffer(OMX_COMPONENTTYPE *pOMXComponent)
+{
+    SEC_OMX_BASECOMPONENT *pSECComponent = (SEC_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
+    SEC_MPEG4ENC_HANDLE   *pMpeg4Enc = (SEC_MPEG4ENC_HANDLE *)pSECComponent->hCodecHandle;
+    MFC_ENC_INPUT_BUFFER  *pSlot = NULL;
+    int                    i = 0;
+
+    /* the MFC may still be reading one of them */
+    if (pMpeg4Enc->NBEncThread.bEncoderRun == OMX_TRUE) {
+        SEC_OSAL_SemaphoreWait(pMpeg4Enc->NBEncThread.hEncFrameEnd);
+        pMpeg4Enc->NBEncThread.bEncoderRun = OMX_FALSE;
+    }
+
+    for (i = 0; i < MFC_INPUT_BUFFER_NUM_MAX; i++) {
+        if (pMpeg4Enc->MFCEncInputBuffer[i].pBufferHeader != NULL)
+            SEC_MFC_EncInputSlotSet(pOMXComponent, &pMpeg4Enc->MFCEncInputPool, &pMpeg4Enc->MFCEncInputBuffer[i], NULL);
+    }
+
+    /* the next frame is copied to the current slot again */
+    pSlot = &pMpeg4Enc->MFCEncInputBuffer[pMpeg4Enc->indexInputBuffer];
+    pSECComponent->processData[INPUT_PORT_INDEX].specificBufferHeader.YPhyAddr = pSlot->YPhyAddr;
+    pSECComponent->processData[INPUT_PORT_INDEX].specificBufferHeader.CPhyAddr = pSlot->CPhyAddr;
+    pSECComponent->processData[INPUT_PORT_INDEX].specificBufferHeader.YVirAddr = pSlot->YVirAddr;
+    pSECComponent->processData[INPUT_PORT_INDEX].specificBufferHeader.CVirAddr = pSlot->CVirAddr;
+
+    return OMX_ErrorNone;
+}
+
+OMX_PTR SEC_MFC_Mpeg4Enc_AllocOutputBuffer(OMX_COMPONENTTYPE *pOMXComponent, OMX_U32 nSizeBytes)
+{
+    SEC_OMX_BASECOMPONENT *pSECComponent = (SEC_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
+    SEC_MPEG4ENC_HANDLE  *pMpeg4Enc = (SEC_MPEG4ENC_HANDLE *)pSECComponent->hCodecHandle;
+
+    if (SEC_MFC_Mpeg4Enc_Open(pOMXComponent) != OMX_ErrorNone)
+        return NULL;
+
+    return SEC_MFC_EncBufferPoolAlloc(pOMXComponent, &pMpeg4Enc->MFCEncOutputPool,
+                                     pMpeg4Enc->hMFCMpeg4Handle.hMFCHandle, nSizeBytes);
+}
+
+void SEC_MFC_Mpeg4Enc_FreeOutputBuffer(OMX_COMPONENTTYPE *pOMXComponent, OMX_PTR pBuffer)
+{
+    SEC_OMX_BASECOMPONENT *pSECComponent = (SEC_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
+    SEC_MPEG4ENC_HANDLE  *pMpeg4Enc = (SEC_MPEG4ENC_HANDLE *)pSECComponent->hCodecHandle;
+
+    SEC_MFC_EncBufferPoolFree(&pMpeg4Enc->MFCEncOutputPool, pBuffer);
+}
+
+/* returns the client buffers the MFC writes to, on flush */
+OMX_ERRORTYPE SEC_MFC_Mpeg4Enc_ReleaseOutputBuffer(OMX_COMPONENTTYPE *pOMXComponent)
+{
+    SEC_OMX_BASECOMPONENT *pSECComponent = (SEC_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
+    SEC_MPEG4ENC_HANDLE  *pMpeg4Enc = (SEC_MPEG4ENC_HANDLE *)pSECComponent->hCodecHandle;
+
+    if (pMpeg4Enc->NBEncThread.bEncoderRun == OMX_TRUE) {
+        SEC_OSAL_SemaphoreWait(pMpeg4Enc->NBEncThread.hEncFrameEnd);
+        pMpeg4Enc->NBEncThread.bEncoderRun = OMX_FALSE;
+    }
+
+    /* the frame in the encoder went to a buffer given back now, it is dropped */
+    if (pMpeg4Enc->pOutputBufferHeader != NULL) {
+        SEC_MFC_EncInputSlotSet(pOMXComponent, &pMpeg4Enc->MFCEncInputPool,
+                                &pMpeg4Enc->MFCEncInputBuffer[(pMpeg4Enc->indexInputBuffer + MFC_INPUT_BUFFER_NUM_MAX - 1) % MFC_INPUT_BUFFER_NUM_MAX],
+                                NULL);
+        pMpeg4Enc->bFirstFrame = OMX_TRUE;
+    }
+
+    SEC_MFC_EncOutputBufferFlush(pOMXComponent, &pMpeg4Enc->pOutputBufferHeader, pMpeg4Enc->hMFCMpeg4Handle.hMFCHandle);
+
+    return OMX_ErrorNone;
+}
+
+/* MFC Init */
+OMX_ERRORTYPE SEC_MFC_Mpeg4Enc_Init(OMX_COMPONENTTYPE *pOMXComponent)
+{
+    OMX_ERRORTYPE              ret = OMX_ErrorNone;
+    SEC_OMX_BASECOMPONENT     *pSECComponent = (SEC_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
+    SEC_OMX_BASEPORT          *pSECInputPort = &pSECComponent->pSECPort[INPUT_PORT_INDEX];
+    SEC_OMX_BASEPORT          *pSECPort = NULL;
+    SEC_MPEG4ENC_HANDLE       *pMpeg4Enc = NULL;
+
+    FunctionIn();
+
+    pMpeg4Enc = (SEC_MPEG4ENC_HANDLE *)pSECComponent->hCodecHandle;
+    pMpeg4Enc->hMFCMpeg4Handle.bConfiguredMFC = OMX_FALSE;
+    SEC_OSAL_Memset(&pMpeg4Enc->hMFCMpeg4Handle.runtimeConfig, 0, sizeof(MFC_ENC_RUNTIME_CONFIG));
+    pSECComponent->bUseFlagEOF = OMX_FALSE;
+    pSECComponent->bSaveFlagEOS = OMX_FALSE;
+
+    ret = SEC_MFC_Mpeg4Enc_Open(pOMXComponent);
+    if (ret != OMX_ErrorNone)
+        goto EXIT;
+
     pSECComponent->processData[INPUT_PORT_INDEX].specificBufferHeader.YPhyAddr = pMpeg4Enc->MFCEncInputBuffer[0].YPhyAddr;
     pSECComponent->processData[INPUT_PORT_INDEX].specificBufferHeader.CPhyAddr = pMpeg4Enc->MFCEncInputBuffer[0].CPhyAddr;
     pSECComponent->processData[INPUT_PORT_INDEX].specificBufferHeader.YVirAddr = pMpeg4Enc->MFCEncInputBuffer[0].YVirAddr;
@@ -1019,19 +1176,20 @@ OMX_ERRORTYPE SEC_MFC_Mpeg4Enc_Init(OMX_COMPONENTTYPE *pOMXComponent)
 
     pMpeg4Enc->indexInputBuffer = 0;
     pMpeg4Enc->bFirstFrame = OMX_TRUE;
+    SEC_FIMC_CscInit(&pMpeg4Enc->fimcCsc);
 
     pMpeg4Enc->NBEncThread.bExitEncodeThread = OMX_FALSE;
     pMpeg4Enc->NBEncThread.bEncoderRun = OMX_FALSE;
+    pMpeg4Enc->NBEncThread.pEncodeSlot = NULL;
     SEC_OSAL_SemaphoreCreate(&(pMpeg4Enc->NBEncThread.hEncFrameStart));
     SEC_OSAL_SemaphoreCreate(&(pMpeg4Enc->NBEncThread.hEncFrameEnd));
-    if (OMX_ErrorNone == SEC_OSAL_ThreadCreate(&pMpeg4Enc->NBEncThread.hNBEncodeThread,
+    if (OMX_ErrorNone == SEC_OSAL_ThreadCreateRole(&pMpeg4Enc->NBEncThread.hNBEncodeThread,
                                                 SEC_MFC_EncodeThread,
-                                                pOMXComponent)) {
+                                                pOMXComponent, SEC_OSAL_THREAD_ROLE_VIDEO)) {
         pMpeg4Enc->hMFCMpeg4Handle.returnCodec = MFC_RET_OK;
     }
 
-    SEC_OSAL_Memset(pSECComponent->timeStamp, -19771003, sizeof(OMX_TICKS) * MAX_TIMESTAMP);
-    SEC_OSAL_Memset(pSECComponent->nFlags, 0, sizeof(OMX_U32) * MAX_FLAGS);
+    SEC_OMX_TimestampMapReset(&pSECComponent->timestampMap);
     pMpeg4Enc->hMFCMpeg4Handle.indexTimestamp = 0;
 
 EXIT:
@@ -1058,6 +1216,7 @@ OMX_ERRORTYPE SEC_MFC_Mpeg4Enc_Terminate(OMX_COMPONENTTYPE *pOMXComponent)
         SEC_OSAL_ThreadTerminate(pMpeg4Enc->NBEncThread.hNBEncodeThread);
         pMpeg4Enc->NBEncThread.hNBEncodeThread = NULL;
     }
+    SEC_FIMC_CscDeinit(&pMpeg4Enc->fimcCsc);
 
     if(pMpeg4Enc->NBEncThread.hEncFrameEnd != NULL) {
         SEC_OSAL_SemaphoreTerminate(pMpeg4Enc->NBEncThread.hEncFrameEnd);
@@ -1074,6 +1233,12 @@ OMX_ERRORTYPE SEC_MFC_Mpeg4Enc_Terminate(OMX_COMPONENTTYPE *pOMXComponent)
         SsbSipMfcEncClose(hMFCHandle);
         pMpeg4Enc->hMFCMpeg4Handle.hMFCHandle = NULL;
     }
+    /* the MFC memory is gone with the handle, the client frees its buffers after this */
+    SEC_OSAL_Memset(&pMpeg4Enc->MFCEncInputPool, 0, sizeof(MFC_ENC_BUFFER_POOL));
+    SEC_OSAL_Memset(&pMpeg4Enc->MFCEncOutputPool, 0, sizeof(MFC_ENC_BUFFER_POOL));
+    pMpeg4Enc->pOutputBufferHeader = NULL;
+    pMpeg4Enc->MFCEncInputBuffer[0].pBufferHeader = NULL;
+    pMpeg4Enc->MFCEncInputBuffer[1].pBufferHeader = NULL;
 
 EXIT:
     FunctionOut();
@@ -1092,6 +1257,7 @@ OMX_ERRORTYPE SEC_MFC_Mpeg4_Encode(OMX_COMPONENTTYPE *pOMXComponent, SEC_OMX_DAT
     SEC_OMX_BASEPORT          *pSECPort = NULL;
     MFC_ENC_ADDR_INFO          addrInfo;
     OMX_U32                    oneFrameSize = pInputData->dataLen;
+    OMX_BOOL                   bCameraFrame = OMX_FALSE;
 
     FunctionIn();
 
@@ -1158,9 +1324,11 @@ OMX_ERRORTYPE SEC_MFC_Mpeg4_Encode(OMX_COMPONENTTYPE *pOMXComponent, SEC_OMX_DAT
         pInputInfo->CPhyAddr = addrInfo.pAddrC;
 #ifdef USE_ANDROID_EXTENSION
     } else if (pSECPort->bStoreMetaDataInBuffer != OMX_FALSE) {
-        ret = preprocessMetaDataInBuffers(pOMXComponent, pInputData->dataBuffer, pInputInfo);
+        ret = preprocessMetaDataInBuffers(pOMXComponent, pInputData->dataBuffer, pInputInfo, &pMpeg4Enc->fimcCsc);
         if (ret != OMX_ErrorNone)
             goto EXIT;
+        /* a gralloc frame is converted to our own slot, a camera frame is read in place */
+        bCameraFrame = (isMetadataBufferTypeGrallocSource(pInputData->dataBuffer) == OMX_FALSE) ? OMX_TRUE : OMX_FALSE;
 #endif
     } else {
         /* Real input data */
@@ -1168,8 +1336,8 @@ OMX_ERRORTYPE SEC_MFC_Mpeg4_Encode(OMX_COMPONENTTYPE *pOMXComponent, SEC_OMX_DAT
         pInputInfo->CPhyAddr = pSECComponent->processData[INPUT_PORT_INDEX].specificBufferHeader.CPhyAddr;
     }
 
-    pSECComponent->timeStamp[pMpeg4Enc->hMFCMpeg4Handle.indexTimestamp] = pInputData->timeStamp;
-    pSECComponent->nFlags[pMpeg4Enc->hMFCMpeg4Handle.indexTimestamp] = pInputData->nFlags;
+    pMpeg4Enc->hMFCMpeg4Handle.indexTimestamp = SEC_OMX_TimestampMapPut(&pSECComponent->timestampMap,
+                                                                  pInputData->timeStamp, pInputData->nFlags);
 
     if ((pMpeg4Enc->hMFCMpeg4Handle.returnCodec == MFC_RET_OK) &&
         (pMpeg4Enc->bFirstFrame == OMX_FALSE)) {
@@ -1183,12 +1351,10 @@ OMX_ERRORTYPE SEC_MFC_Mpeg4_Encode(OMX_COMPONENTTYPE *pOMXComponent, SEC_OMX_DAT
 
         pMpeg4Enc->hMFCMpeg4Handle.returnCodec = SsbSipMfcEncGetOutBuf(hMFCHandle, &outputInfo);
         if ((SsbSipMfcEncGetConfig(hMFCHandle, MFC_ENC_GETCONF_FRAME_TAG, &indexTimestamp) != MFC_RET_OK) ||
-            (((indexTimestamp < 0) || (indexTimestamp >= MAX_TIMESTAMP)))) {
+            (SEC_OMX_TimestampMapGet(&pSECComponent->timestampMap, indexTimestamp,
+                                     &pOutputData->timeStamp, &pOutputData->nFlags) == OMX_FALSE)) {
             pOutputData->timeStamp = pInputData->timeStamp;
             pOutputData->nFlags = pInputData->nFlags;
-        } else {
-            pOutputData->timeStamp = pSECComponent->timeStamp[indexTimestamp];
-            pOutputData->nFlags = pSECComponent->nFlags[indexTimestamp];
         }
 
         if (pMpeg4Enc->hMFCMpeg4Handle.returnCodec == MFC_RET_OK) {
@@ -1197,6 +1363,8 @@ OMX_ERRORTYPE SEC_MFC_Mpeg4_Encode(OMX_COMPONENTTYPE *pOMXComponent, SEC_OMX_DAT
             pOutputData->allocSize = outputInfo.dataSize;
             pOutputData->dataLen = outputInfo.dataSize;
             pOutputData->usedDataLen = 0;
+            pOutputData->bufferHeader = pMpeg4Enc->pOutputBufferHeader;
+            pMpeg4Enc->pOutputBufferHeader = NULL;
 
             pOutputData->nFlags |= OMX_BUFFERFLAG_ENDOFFRAME;
             if (outputInfo.frameType == MFC_FRAME_TYPE_I_FRAME)
@@ -1236,6 +1404,10 @@ OMX_ERRORTYPE SEC_MFC_Mpeg4_Encode(OMX_COMPONENTTYPE *pOMXComponent, SEC_OMX_DAT
         ret = OMX_ErrorUndefined;
         goto EXIT;
     } else {
+        /* the camera gets the frame back once the encode thread saw the MFC through it */
+        if (bCameraFrame == OMX_TRUE)
+            SEC_MFC_EncInputSlotHold(pOMXComponent, &pMpeg4Enc->MFCEncInputBuffer[pMpeg4Enc->indexInputBuffer]);
+        pMpeg4Enc->NBEncThread.pEncodeSlot = &pMpeg4Enc->MFCEncInputBuffer[pMpeg4Enc->indexInputBuffer];
         pMpeg4Enc->indexInputBuffer++;
         pMpeg4Enc->indexInputBuffer %= MFC_INPUT_BUFFER_NUM_MAX;
         pSECComponent->processData[INPUT_PORT_INDEX].specificBufferHeader.YPhyAddr = pMpeg4Enc->MFCEncInputBuffer[pMpeg4Enc->indexInputBuffer].YPhyAddr;
@@ -1246,13 +1418,13 @@ OMX_ERRORTYPE SEC_MFC_Mpeg4_Encode(OMX_COMPONENTTYPE *pOMXComponent, SEC_OMX_DAT
         pSECComponent->processData[INPUT_PORT_INDEX].specificBufferHeader.CSize = pMpeg4Enc->MFCEncInputBuffer[pMpeg4Enc->indexInputBuffer].CBufferSize;
     }
 
+    SEC_MFC_EncApplyRuntimeConfig(pOMXComponent, &pMpeg4Enc->hMFCMpeg4Handle.runtimeConfig, hMFCHandle);
     SsbSipMfcEncSetConfig(hMFCHandle, MFC_ENC_SETCONF_FRAME_TAG, &(pMpeg4Enc->hMFCMpeg4Handle.indexTimestamp));
+    pMpeg4Enc->pOutputBufferHeader = SEC_MFC_EncOutputBufferTake(pOMXComponent, &pMpeg4Enc->MFCEncOutputPool, hMFCHandle);
 
     /* mfc encode start */
     SEC_OSAL_SemaphorePost(pMpeg4Enc->NBEncThread.hEncFrameStart);
     pMpeg4Enc->NBEncThread.bEncoderRun = OMX_TRUE;
-    pMpeg4Enc->hMFCMpeg4Handle.indexTimestamp++;
-    pMpeg4Enc->hMFCMpeg4Handle.indexTimestamp %= MAX_TIMESTAMP;
     pMpeg4Enc->bFirstFrame = OMX_FALSE;
 
 EXIT:
@@ -1467,6 +1639,14 @@ OSCL_EXPORT_REF OMX_ERRORTYPE SEC_OMX_ComponentInit(OMX_HANDLETYPE hComponent, O
     pSECComponent->sec_mfc_bufferProcess      = &SEC_MFC_Mpeg4Enc_bufferProcess;
     pSECComponent->sec_checkInputFrame        = NULL;
 
+    pSECComponent->sec_mfc_allocInputBuffer   = &SEC_MFC_Mpeg4Enc_AllocInputBuffer;
+    pSECComponent->sec_mfc_freeInputBuffer    = &SEC_MFC_Mpeg4Enc_FreeInputBuffer;
+    pSECComponent->sec_mfc_setInputBuffer     = &SEC_MFC_Mpeg4Enc_SetInputBuffer;
+    pSECComponent->sec_mfc_releaseInputBuffer = &SEC_MFC_Mpeg4Enc_ReleaseInputBuffer;
+    pSECComponent->sec_mfc_allocOutputBuffer  = &SEC_MFC_Mpeg4Enc_AllocOutputBuffer;
+    pSECComponent->sec_mfc_freeOutputBuffer   = &SEC_MFC_Mpeg4Enc_FreeOutputBuffer;
+    pSECComponent->sec_mfc_releaseOutputBuffer = &SEC_MFC_Mpeg4Enc_ReleaseOutputBuffer;
+
     pSECComponent->currentState = OMX_StateLoaded;
 
     ret = OMX_ErrorNone;
@@ -1498,6 +1678,9 @@ OMX_ERRORTYPE SEC_OMX_ComponentDeinit(OMX_HANDLETYPE hComponent)
 
     pMpeg4Enc = (SEC_MPEG4ENC_HANDLE *)pSECComponent->hCodecHandle;
     if (pMpeg4Enc != NULL) {
+        /* opened by an input buffer allocation that never reached Idle */
+        if (pMpeg4Enc->hMFCMpeg4Handle.hMFCHandle != NULL)
+            SsbSipMfcEncClose(pMpeg4Enc->hMFCMpeg4Handle.hMFCHandle);
         SEC_OSAL_Free(pMpeg4Enc);
         pMpeg4Enc = pSECComponent->hCodecHandle = NULL;
     }
@@ -46,6 +46,7 @@ typedef struct _SEC_MFC_MPEG4ENC_HANDLE
     SSBSIP_MFC_ENC_INPUT_INFO  inputInfo;
     OMX_U32                    indexTimestamp;
     OMX_BOOL                   bConfiguredMFC;
+    MFC_ENC_RUNTIME_CONFIG     runtimeConfig;
     CODEC_TYPE                 codecType;
     OMX_S32                    returnCodec;
 } SEC_MFC_MPEG4ENC_HANDLE;
@@ -65,6 +66,11 @@ typedef struct _SEC_MPEG4ENC_HANDLE
     OMX_BOOL bFirstFrame;
     MFC_ENC_INPUT_BUFFER MFCEncInputBuffer[MFC_INPUT_BUFFER_NUM_MAX];
     OMX_U32  indexInputBuffer;
+    MFC_ENC_BUFFER_POOL MFCEncInputPool;
+    MFC_ENC_BUFFER_POOL MFCEncOutputPool;
+    /* client buffer the frame in the encoder is written to */
+    OMX_BUFFERHEADERTYPE *pOutputBufferHeader;
+    SEC_FIMC_CSC fimcCsc;
 } SEC_MPEG4ENC_HANDLE;
 
 
@@ -10,6 +10,7 @@ LOCAL_SRC_FILES := SEC_OMX_Component_Register.c \
 LOCAL_MODULE := libSEC_OMX_Core.aries
 
 LOCAL_CFLAGS :=
+LOCAL_CFLAGS += $(SEC_OMX_LOG_CFLAGS)
 
 LOCAL_ARM_MODE := arm
 
@@ -48,20 +48,99 @@
 #define REGISTRY_FILENAME "secomxregistry"
 
 
+/* asks a library for its components, for registry entries without a cached list */
+static int SEC_OMX_Component_Query(char *libName, SEC_OMX_COMPONENT_REGLIST *componentList, int totalCompNum)
+{
+    int            componentNum = 0;
+    int            libraryCompNum = 0;
+    OMX_HANDLETYPE soHandle;
+    const char    *errorMsg;
+    int (*SEC_OMX_COMPONENT_Library_Register)(SECRegisterComponentType **secComponents);
+    SECRegisterComponentType **secComponentsTemp;
+
+    if ((soHandle = SEC_OSAL_dlopen(libName, RTLD_NOW)) != NULL) {
+        SEC_OSAL_dlerror();    /* clear error*/
+        if ((SEC_OMX_COMPONENT_Library_Register = SEC_OSAL_dlsym(soHandle, "SEC_OMX_COMPONENT_Library_Register")) != NULL) {
+            int i = 0, j = 0;
+
+            libraryCompNum = (*SEC_OMX_COMPONENT_Library_Register)(NULL);
+            secComponentsTemp = (SECRegisterComponentType **)SEC_OSAL_Malloc(sizeof(SECRegisterComponentType*) * libraryCompNum);
+            for (i = 0; i < libraryCompNum; i++) {
+                secComponentsTemp[i] = SEC_OSAL_Malloc(sizeof(SECRegisterComponentType));
+                SEC_OSAL_Memset(secComponentsTemp[i], 0, sizeof(SECRegisterComponentType));
+            }
+            (*SEC_OMX_COMPONENT_Library_Register)(secComponentsTemp);
+
+            componentNum = libraryCompNum;
+            if (totalCompNum + componentNum > MAX_OMX_COMPONENT_NUM)
+                componentNum = MAX_OMX_COMPONENT_NUM - totalCompNum;
+            for (i = 0; i < componentNum; i++) {
+                SEC_OSAL_Strcpy(componentList[totalCompNum + i].component.componentName, secComponentsTemp[i]->componentName);
+                for (j = 0; j < secComponentsTemp[i]->totalRoleNum; j++)
+                    SEC_OSAL_Strcpy(componentList[totalCompNum + i].component.roles[j], secComponentsTemp[i]->roles[j]);
+                componentList[totalCompNum + i].component.totalRoleNum = secComponentsTemp[i]->totalRoleNum;
+
+                SEC_OSAL_Strcpy(componentList[totalCompNum + i].libName, libName);
+            }
+            for (i = 0; i < libraryCompNum; i++) {
+                SEC_OSAL_Free(secComponentsTemp[i]);
+            }
+
+            SEC_OSAL_Free(secComponentsTemp);
+        } else {
+            if ((errorMsg = SEC_OSAL_dlerror()) != NULL)
+                SEC_OSAL_Log(SEC_LOG_WARNING, "dlsym failed: %s", errorMsg);
+        }
+        SEC_OSAL_dlclose(soHandle);
+    } else {
+        SEC_OSAL_Log(SEC_LOG_WARNING, "dlopen failed: %s", SEC_OSAL_dlerror());
+    }
+
+    return componentNum;
+}
+
+/*
+ * "<componentName> <role>..." indented under its library line, the cached
+ * entry the library would return, so that nothing is loaded before
+ * SEC_OMX_GetHandle.
+ */
+static OMX_BOOL SEC_OMX_Component_Parse(char *line, char *libName, SEC_OMX_COMPONENT_REGLIST *pComponent)
+{
+    char *token = NULL;
+    char *save = NULL;
+    int   roleNum = 0;
+
+    token = strtok_r(line, " \t\r\n", &save);
+    if ((token == NULL) || (SEC_OSAL_Strlen(token) >= MAX_OMX_COMPONENT_NAME_SIZE))
+        return OMX_FALSE;
+
+    SEC_OSAL_Memset(pComponent, 0, sizeof(SEC_OMX_COMPONENT_REGLIST));
+    SEC_OSAL_Strcpy(pComponent->component.componentName, token);
+    while (((token = strtok_r(NULL, " \t\r\n", &save)) != NULL) && (roleNum < MAX_OMX_COMPONENT_ROLE_NUM)) {
+        if (SEC_OSAL_Strlen(token) >= MAX_OMX_COMPONENT_ROLE_SIZE)
+            return OMX_FALSE;
+        SEC_OSAL_Strcpy(pComponent->component.roles[roleNum++], token);
+    }
+    if (roleNum == 0)
+        return OMX_FALSE;
+    pComponent->component.totalRoleNum = roleNum;
+    SEC_OSAL_Strcpy(pComponent->libName, libName);
+
+    return OMX_TRUE;
+}
+
 OMX_ERRORTYPE SEC_OMX_Component_Register(SEC_OMX_COMPONENT_REGLIST **compList, OMX_U32 *compNum)
 {
     OMX_ERRORTYPE  ret = OMX_ErrorNone;
-    int            componentNum = 0, roleNum = 0, totalCompNum = 0;
+    int            totalCompNum = 0;
     int            read;
     char          *omxregistryfile = NULL;
     char          *line = NULL;
     char          *libName;
     FILE          *omxregistryfp;
     size_t         len;
-    OMX_HANDLETYPE soHandle;
-    const char    *errorMsg;
-    int (*SEC_OMX_COMPONENT_Library_Register)(SECRegisterComponentType **secComponents);
-    SECRegisterComponentType **secComponentsTemp;
+    OMX_BOOL       bLibraryOpen = OMX_FALSE;
+    OMX_BOOL       bLibraryCached = OMX_FALSE;
     SEC_OMX_COMPONENT_REGLIST *componentList;
 
     FunctionIn();
@@ -71,11 +150,11 @@ OMX_ERRORTYPE SEC_OMX_Component_Register(SEC_OMX_COMPONENT_REGLIST **compList, O
     SEC_OSAL_Strcat(omxregistryfile, REGISTRY_FILENAME);
 
     omxregistryfp = fopen(omxregistryfile, "r");
+    SEC_OSAL_Free(omxregistryfile);
     if (omxregistryfp == NULL) {
         ret = OMX_ErrorUndefined;
         goto EXIT;
     }
-    SEC_OSAL_Free(omxregistryfile);
 
     fseek(omxregistryfp, 0, 0);
     componentList = (SEC_OMX_COMPONENT_REGLIST *)SEC_OSAL_Malloc(sizeof(SEC_OMX_COMPONENT_REGLIST) * MAX_OMX_COMPONENT_NUM);
@@ -85,52 +164,33 @@ OMX_ERRORTYPE SEC_OMX_Component_Register(SEC_OMX_COMPONENT_REGLIST **compList, O
     while ((read = getline(&line, &len, omxregistryfp)) != -1) {
         if ((*line == 'l') && (*(line + 1) == 'i') && (*(line + 2) == 'b') &&
             (*(line + 3) == 'O') && (*(line + 4) == 'M') && (*(line + 5) == 'X')) {
+            /* a library line without a cached list is asked directly */
+            if ((bLibraryOpen == OMX_TRUE) && (bLibraryCached == OMX_FALSE))
+                totalCompNum += SEC_OMX_Component_Query(libName, componentList, totalCompNum);
+
             SEC_OSAL_Memset(libName, 0, MAX_OMX_COMPONENT_LIBNAME_SIZE);
             SEC_OSAL_Strncpy(libName, line, SEC_OSAL_Strlen(line)-1);
             SEC_OSAL_Log(SEC_LOG_TRACE, "libName : %s", libName);
-
-            if ((soHandle = SEC_OSAL_dlopen(libName, RTLD_NOW)) != NULL) {
-                SEC_OSAL_dlerror();    /* clear error*/
-                if ((SEC_OMX_COMPONENT_Library_Register = SEC_OSAL_dlsym(soHandle, "SEC_OMX_COMPONENT_Library_Register")) != NULL) {
-                    int i = 0, j = 0;
-
-                    componentNum = (*SEC_OMX_COMPONENT_Library_Register)(NULL);
-                    secComponentsTemp = (SECRegisterComponentType **)SEC_OSAL_Malloc(sizeof(SECRegisterComponentType*) * componentNum);
-                    for (i = 0; i < componentNum; i++) {
-                        secComponentsTemp[i] = SEC_OSAL_Malloc(sizeof(SECRegisterComponentType));
-                        SEC_OSAL_Memset(secComponentsTemp[i], 0, sizeof(SECRegisterComponentType));
-                    }
-                    (*SEC_OMX_COMPONENT_Library_Register)(secComponentsTemp);
-
-                    for (i = 0; i < componentNum; i++) {
-                        SEC_OSAL_Strcpy(componentList[totalCompNum].component.componentName, secComponentsTemp[i]->componentName);
-                        for (j = 0; j < secComponentsTemp[i]->totalRoleNum; j++)
-                            SEC_OSAL_Strcpy(componentList[totalCompNum].component.roles[j], secComponentsTemp[i]->roles[j]);
-                        componentList[totalCompNum].component.totalRoleNum = secComponentsTemp[i]->totalRoleNum;
-
-                        SEC_OSAL_Strcpy(componentList[totalCompNum].libName, libName);
-
-                        totalCompNum++;
-                    }
-                    for (i = 0; i < componentNum; i++) {
-                        SEC_OSAL_Free(secComponentsTemp[i]);
-                    }
-
-                    SEC_OSAL_Free(secComponentsTemp);
-                } else {
-                    if ((errorMsg = SEC_OSAL_dlerror()) != NULL)
-                        SEC_OSAL_Log(SEC_LOG_WARNING, "dlsym failed: %s", errorMsg);
-                }
-                SEC_OSAL_dlclose(soHandle);
-            } else {
-                SEC_OSAL_Log(SEC_LOG_WARNING, "dlopen failed: %s", SEC_OSAL_dlerror());
+            bLibraryOpen = OMX_TRUE;
+            bLibraryCached = OMX_FALSE;
+        } else if (((*line == ' ') || (*line == '\t')) && (bLibraryOpen == OMX_TRUE)) {
+            if (totalCompNum >= MAX_OMX_COMPONENT_NUM)
+                continue;
+            if (SEC_OMX_Component_Parse(line, libName, &componentList[totalCompNum]) == OMX_TRUE) {
+                SEC_OSAL_Log(SEC_LOG_TRACE, "cached component : %s", componentList[totalCompNum].component.componentName);
+                totalCompNum++;
+                bLibraryCached = OMX_TRUE;
             }
         } else {
             /* not a component name line. skip */
             continue;
         }
     }
+    if ((bLibraryOpen == OMX_TRUE) && (bLibraryCached == OMX_FALSE))
+        totalCompNum += SEC_OMX_Component_Query(libName, componentList, totalCompNum);
 
+    if (line != NULL)
+        free(line);
     SEC_OSAL_Free(libName);
     fclose(omxregistryfp);
 
@@ -146,7 +206,14 @@ EXIT:
 OMX_ERRORTYPE SEC_OMX_Component_Unregister(SEC_OMX_COMPONENT_REGLIST *componentList)
 {
     OMX_ERRORTYPE ret = OMX_ErrorNone;
+    int           i = 0;
 
+    for (i = 0; i < MAX_OMX_COMPONENT_NUM; i++) {
+        if (componentList[i].libHandle != NULL) {
+            SEC_OSAL_dlclose(componentList[i].libHandle);
+            componentList[i].libHandle = NULL;
+        }
+    }
     SEC_OSAL_Memset(componentList, 0, sizeof(SEC_OMX_COMPONENT_REGLIST) * MAX_OMX_COMPONENT_NUM);
     SEC_OSAL_Free(componentList);
 
@@ -238,6 +305,21 @@ EXIT:
     return ret;
 }
 
+/*
+ * an extra reference on a loaded component library, so that freeing the
+ * last instance does not unmap it and the next player does not pay the
+ * dlopen and relocation again. dropped in SEC_OMX_Component_Unregister.
+ */
+void SEC_OMX_ComponentHold(SEC_OMX_COMPONENT_REGLIST *regComponent)
+{
+    if (regComponent->libHandle != NULL)
+        return;
+
+    regComponent->libHandle = SEC_OSAL_dlopen(regComponent->libName, RTLD_NOW);
+    if (regComponent->libHandle != NULL)
+        SEC_OSAL_Log(SEC_LOG_TRACE, "%s kept loaded", regComponent->libName);
+}
+
 OMX_ERRORTYPE SEC_OMX_ComponentUnload(SEC_OMX_COMPONENT *sec_component)
 {
     OMX_ERRORTYPE ret = OMX_ErrorNone;
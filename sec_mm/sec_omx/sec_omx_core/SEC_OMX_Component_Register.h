@@ -44,6 +44,8 @@ typedef struct _SEC_OMX_COMPONENT_REGLIST
 {
     SECRegisterComponentType component;
     OMX_U8  libName[MAX_OMX_COMPONENT_LIBNAME_SIZE];
+    /* taken at the first load and kept until unregister, the library stays mapped between instances */
+    OMX_HANDLETYPE libHandle;
 } SEC_OMX_COMPONENT_REGLIST;
 
 struct SEC_OMX_COMPONENT;
@@ -66,6 +68,7 @@ OMX_ERRORTYPE SEC_OMX_Component_Register(SEC_OMX_COMPONENT_REGLIST **compList, O
 OMX_ERRORTYPE SEC_OMX_Component_Unregister(SEC_OMX_COMPONENT_REGLIST *componentList);
 OMX_ERRORTYPE SEC_OMX_ComponentLoad(SEC_OMX_COMPONENT *sec_component);
 OMX_ERRORTYPE SEC_OMX_ComponentUnload(SEC_OMX_COMPONENT *sec_component);
+void          SEC_OMX_ComponentHold(SEC_OMX_COMPONENT_REGLIST *regComponent);
 
 
 #ifdef __cplusplus
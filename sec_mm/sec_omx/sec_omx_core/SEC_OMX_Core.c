@@ -181,6 +181,7 @@ OMX_API OMX_ERRORTYPE OMX_APIENTRY SEC_OMX_GetHandle(
             }
 
             SEC_OSAL_MutexLock(&ghLoadComponentListMutex);
+            SEC_OMX_ComponentHold(&gComponentList[i]);
             if (gLoadComponentList == NULL) {
                 gLoadComponentList = loadComponent;
             } else {
@@ -43,9 +43,6 @@
 #define MAX_OMX_COMPONENT_LIBNAME_SIZE     OMX_MAX_STRINGNAME_SIZE * 2
 #define MAX_OMX_MIMETYPE_SIZE              OMX_MAX_STRINGNAME_SIZE
 
-#define MAX_TIMESTAMP        17
-#define MAX_FLAGS            17
-
 #define USE_ANDROID_EXTENSION
 
 
@@ -67,6 +64,21 @@ typedef enum _SEC_OMX_INDEXTYPE
 {
 #define SEC_INDEX_PARAM_ENABLE_THUMBNAIL "OMX.SEC.index.ThumbnailMode"
     OMX_IndexVendorThumbnailMode        = 0x7F000001,
+    /* OMX_BOOL, pictures in decode order for streams without reordering */
+#define SEC_INDEX_PARAM_ENABLE_LOW_DELAY "OMX.SEC.index.LowDelayMode"
+    OMX_IndexVendorLowDelayMode         = 0x7F000002,
+    /* any config, logs the buffer latencies traced so far */
+#define SEC_INDEX_CONFIG_DUMP_LATENCY "OMX.SEC.index.DumpLatency"
+    OMX_IndexVendorDumpLatency          = 0x7F000003,
+    /* OMX_BOOL, after a flush the frames before the next IDR are dropped */
+#define SEC_INDEX_PARAM_ENABLE_FAST_SEEK "OMX.SEC.index.FastSeekMode"
+    OMX_IndexVendorFastSeekMode         = 0x7F000004,
+    /* OMX_BOOL, the H.264 encoder repeats SPS and PPS in front of every IDR */
+#define SEC_INDEX_CONFIG_PREPEND_SPSPPS "OMX.SEC.index.PrependSPSPPSToIDR"
+    OMX_IndexVendorPrependSPSPPS        = 0x7F000005,
+    /* SEC_OMX_CONFIG_MFC_CAPACITY, what the MFC has left for another session */
+#define SEC_INDEX_CONFIG_MFC_CAPACITY "OMX.SEC.index.MFCCapacity"
+    OMX_IndexVendorMFCCapacity          = 0x7F000006,
 
     /* for Android Native Window */
 #define SEC_INDEX_PARAM_ENABLE_ANB "OMX.google.android.index.enableAndroidNativeBuffers"
@@ -78,6 +90,9 @@ typedef enum _SEC_OMX_INDEXTYPE
     /* for Android Store Metadata Inbuffer */
 #define SEC_INDEX_PARAM_STORE_METADATA_BUFFER "OMX.google.android.index.storeMetaDataInBuffers"
     OMX_IndexParamStoreMetaDataBuffer     = 0x7F000014,
+    /* SEC_OMX_PARAM_ADAPTIVE_PLAYBACK, output buffers sized once for the largest picture */
+#define SEC_INDEX_PARAM_ADAPTIVE_PLAYBACK "OMX.google.android.index.prepareForAdaptivePlayback"
+    OMX_IndexParamPrepareForAdaptivePlayback = 0x7F000015,
 
     /* for Android PV OpenCore*/
     OMX_COMPONENT_CAPABILITY_TYPE_INDEX = 0xFF7A347
@@ -109,8 +124,14 @@ typedef enum _SEC_OMX_TRANS_STATETYPE {
 
 typedef enum _SEC_OMX_COLOR_FORMATTYPE {
     OMX_SEC_COLOR_FormatNV12TPhysicalAddress = 0x7F000001, /**< Reserved region for introducing Vendor Extensions */
+    /* YUV420SP with CrCb order, HAL_PIXEL_FORMAT_YCrCb_420_SP */
+    OMX_SEC_COLOR_FormatNV21Linear = 0x7F000011,
+    /* YV12: V plane before U, 16 aligned luma stride and chroma stride ALIGN(stride / 2, 16) */
+    OMX_SEC_COLOR_FormatYVU420Planar = 0x7F000012,
     /* for Android Native Window */
     OMX_SEC_COLOR_FormatANBYUV420SemiPlanar = 0x100,
+    /* the decoded NV12T pictures by physical address, HAL_PIXEL_FORMAT_CUSTOM_YCbCr_420_SP_TILED */
+    OMX_SEC_COLOR_FormatANBNV12TPhysicalAddress = 0x112,
     /* for Android surface texture encode */
     OMX_COLOR_FormatAndroidOpaque = 0x7F000789
 }SEC_OMX_COLOR_FORMATTYPE;
@@ -120,10 +141,32 @@ typedef enum _SEC_OMX_SUPPORTFORMAT_TYPE
     supportFormat_0 = 0x00,
     supportFormat_1,
     supportFormat_2,
-    supportFormat_3
+    supportFormat_3,
+    supportFormat_4,
+    supportFormat_5
 } SEC_OMX_SUPPORTFORMAT_TYPE;
 
 
+/* same layout as the Android PrepareForAdaptivePlaybackParams */
+typedef struct _SEC_OMX_PARAM_ADAPTIVE_PLAYBACK
+{
+    OMX_U32         nSize;
+    OMX_VERSIONTYPE nVersion;
+    OMX_U32         nPortIndex;
+    OMX_BOOL        bEnable;
+    OMX_U32         nMaxFrameWidth;
+    OMX_U32         nMaxFrameHeight;
+} SEC_OMX_PARAM_ADAPTIVE_PLAYBACK;
+
+typedef struct _SEC_OMX_CONFIG_MFC_CAPACITY
+{
+    OMX_U32         nSize;
+    OMX_VERSIONTYPE nVersion;
+    OMX_U32         nFreeSessions;
+    OMX_U32         nFreeMB;        /* frame macroblocks another session may have */
+    OMX_U32         nLoad;          /* percent of the last second the MFC was running */
+} SEC_OMX_CONFIG_MFC_CAPACITY;
+
 /* for Android */
 typedef struct _OMXComponentCapabilityFlagsType
 {
@@ -13,12 +13,14 @@ LOCAL_SRC_FILES := \
 	SEC_OSAL_Semaphore.c \
 	SEC_OSAL_Library.c \
 	SEC_OSAL_Log.c \
-	SEC_OSAL_Buffer.cpp
+	SEC_OSAL_Buffer.cpp \
+	SEC_OSAL_FimcCsc.c
 
 
 LOCAL_MODULE := libsecosal.aries
 
-LOCAL_CFLAGS :=
+LOCAL_CFLAGS := $(SEC_OMX_VDEC_CFLAGS)
+LOCAL_CFLAGS += $(SEC_OMX_LOG_CFLAGS)
 
 LOCAL_STATIC_LIBRARIES :=
 
@@ -38,6 +38,7 @@ extern "C" {
 #include "SEC_OSAL_Memory.h"
 #include "SEC_OSAL_Semaphore.h"
 #include "SEC_OSAL_Buffer.h"
+#include "SEC_OSAL_FimcCsc.h"
 #include "SEC_OMX_Basecomponent.h"
 
 #define SEC_LOG_OFF
@@ -54,8 +55,16 @@ extern "C" {
 #include <hardware/hardware.h>
 #include <MetadataBufferType.h>
 #include "hal_public.h"
+#include "s5p_fimc.h"
+#include <sec_latency.h>
 
 #define HAL_PIXEL_FORMAT_C110_NV12          0x100
+/* the MFC takes its frame addresses in 2KB units */
+#define MFC_ENC_FRAME_ALIGN                 2048
+
+#ifndef GRALLOC_USAGE_PHYS_CONTIG
+#define GRALLOC_USAGE_PHYS_CONTIG           GRALLOC_USAGE_PRIVATE_1
+#endif
 
 using namespace android;
 
@@ -147,6 +156,36 @@ OMX_U32 putVADDRtoANB(OMX_PTR pUnreadableBuffer)
     return mapper.unlock(buf->handle);
 }
 
+/* physical planes of a native buffer for the hardware, no lock needed */
+OMX_U32 getPADDRfromANB(OMX_PTR pUnreadableBuffer, unsigned int pPhyAddrs[])
+{
+    static const IMG_gralloc_module_public_t *pGrallocModule = NULL;
+    android_native_buffer_t *buf;
+    OMX_U32 ret = 0;
+
+    FunctionIn();
+
+    if (pGrallocModule == NULL) {
+        const hw_module_t *module = NULL;
+        if (hw_get_module(GRALLOC_HARDWARE_MODULE_ID, &module) == 0)
+            pGrallocModule = (const IMG_gralloc_module_public_t *)module;
+    }
+    if ((pGrallocModule == NULL) || (pGrallocModule->GetPhyAddrs == NULL)) {
+        ret = -1;
+        goto EXIT;
+    }
+
+    buf = (android_native_buffer_t *)pUnreadableBuffer;
+    ret = pGrallocModule->GetPhyAddrs(pGrallocModule, buf->handle, pPhyAddrs);
+    if (ret != 0)
+        SEC_OSAL_Log(SEC_LOG_TRACE, "GetPhyAddrs Error, Error code:%d", ret);
+
+EXIT:
+    FunctionOut();
+
+    return ret;
+}
+
 OMX_ERRORTYPE enableAndroidNativeBuffer(OMX_HANDLETYPE hComponent, OMX_PTR ComponentParameterStructure)
 {
     OMX_ERRORTYPE          ret = OMX_ErrorNone;
@@ -177,7 +216,12 @@ OMX_ERRORTYPE enableAndroidNativeBuffer(OMX_HANDLETYPE hComponent, OMX_PTR Compo
     } else {
         SEC_OSAL_Log(SEC_LOG_TRACE, "enable AndroidNativeBuffer");
         pSECPort->bUseAndroidNativeBuffer = OMX_TRUE;
+#ifdef USE_ANB_ZERO_COPY
+        /* the display reads the MFC pictures itself, see SEC_OMX_Vdec.h */
+        pSECPort->portDefinition.format.video.eColorFormat = (OMX_COLOR_FORMATTYPE)OMX_SEC_COLOR_FormatANBNV12TPhysicalAddress;
+#else
         pSECPort->portDefinition.format.video.eColorFormat = (OMX_COLOR_FORMATTYPE)OMX_SEC_COLOR_FormatANBYUV420SemiPlanar;
+#endif
     }
 
     ret = OMX_ErrorNone;
@@ -202,6 +246,10 @@ OMX_ERRORTYPE getAndroidNativeBuffer(OMX_HANDLETYPE hComponent, OMX_PTR Componen
     pganbp = (GetAndroidNativeBufferUsageParams *)ComponentParameterStructure;
 
     pganbp->nUsage = GRALLOC_USAGE_SW_WRITE_OFTEN;
+#ifdef USE_FIMC_CSC
+    /* lets the FIMC write the decoded pictures, see SEC_OSAL_FimcCsc.c */
+    pganbp->nUsage |= GRALLOC_USAGE_PHYS_CONTIG;
+#endif
 
     ret = OMX_ErrorNone;
 
@@ -254,7 +302,7 @@ OMX_ERRORTYPE UseBufferANB(
         goto EXIT;
     }
 
-    temp_bufferHeader = (OMX_BUFFERHEADERTYPE *)SEC_OSAL_Malloc(sizeof(OMX_BUFFERHEADERTYPE));
+    temp_bufferHeader = (OMX_BUFFERHEADERTYPE *)SEC_OSAL_PoolAlloc(&pSECComponent->bufferHeaderPool);
     if (temp_bufferHeader == NULL) {
         ret = OMX_ErrorInsufficientResources;
         goto EXIT;
@@ -287,7 +335,7 @@ OMX_ERRORTYPE UseBufferANB(
         }
     }
 
-    SEC_OSAL_Free(temp_bufferHeader);
+    SEC_OSAL_PoolFree(&pSECComponent->bufferHeaderPool, temp_bufferHeader);
     ret = OMX_ErrorInsufficientResources;
 
 EXIT:
@@ -320,6 +368,21 @@ OMX_ERRORTYPE useAndroidNativeBuffer(OMX_HANDLETYPE hComponent, OMX_PTR Componen
     ret = UseBufferANB(hComponent, puanbp->bufferHeader, puanbp->nPortIndex,
                        puanbp->pAppPrivate, frameSize, (OMX_U8 *)buffer);
 
+#ifdef USE_ANB_ZERO_COPY
+    /*
+     * only the address record is written, the buffer stays mapped until
+     * it is freed instead of a lock and unlock per frame
+     */
+    if ((ret == OMX_ErrorNone) && (puanbp->nPortIndex == OUTPUT_PORT_INDEX)) {
+        void *pVirAddrs[3] = {NULL, NULL, NULL};
+
+        if (getVADDRfromANB(buffer, buf->width, buf->height, pVirAddrs) == 0)
+            (*puanbp->bufferHeader)->pOutputPortPrivate = pVirAddrs[0];
+        else
+            SEC_OSAL_Log(SEC_LOG_ERROR, "native buffer 0x%x can't be mapped", buffer);
+    }
+#endif
+
 EXIT:
     FunctionOut();
 
@@ -374,7 +437,83 @@ OMX_BOOL isMetadataBufferTypeGrallocSource(OMX_BYTE pInputDataBuffer)
         return OMX_FALSE;
 }
 
-OMX_ERRORTYPE preprocessMetaDataInBuffers(OMX_HANDLETYPE hComponent, OMX_BYTE pInputDataBuffer, BUFFER_ADDRESS_INFO *pInputInfo)
+#ifdef USE_FIMC_CSC
+/*
+ * RGB to linear NV12 straight into the MFC input buffer, keeping the GPU
+ * to the UI. Only a physically contiguous gralloc buffer can be read.
+ */
+static OMX_ERRORTYPE fimcConvertGrallocSource(SEC_FIMC_CSC *pCsc, IMG_gralloc_module_public_t *module,
+                                              buffer_handle_t buf, SEC_OMX_BASEPORT *pSECPort,
+                                              SEC_BUFFER_HEADER *pMFCBuffer, BUFFER_ADDRESS_INFO *pInputInfo)
+{
+    IMG_native_handle_t *img = (IMG_native_handle_t *)buf;
+    SEC_FIMC_CSC_FRAME   src, dst;
+    unsigned int         phyAddrs[MAX_SUB_ALLOCS] = {0, 0, 0};
+    unsigned int         yPhyAddr = (unsigned int)pMFCBuffer->YPhyAddr;
+    unsigned int         cOffset = (unsigned int)pMFCBuffer->CPhyAddr - yPhyAddr;
+    int                  width = pSECPort->portDefinition.format.video.nFrameWidth;
+    int                  height = pSECPort->portDefinition.format.video.nFrameHeight;
+    int                  fbHeight;
+
+    switch (img->iFormat) {
+    case HAL_PIXEL_FORMAT_RGBA_8888:
+    case HAL_PIXEL_FORMAT_RGBX_8888:
+    case HAL_PIXEL_FORMAT_BGRA_8888:
+        src.format = V4L2_PIX_FMT_RGB32;
+        break;
+    case HAL_PIXEL_FORMAT_RGB_565:
+        src.format = V4L2_PIX_FMT_RGB565;
+        break;
+    default:
+        return OMX_ErrorUnsupportedSetting;
+    }
+
+    if (!(img->usage & GRALLOC_USAGE_PHYS_CONTIG) || (module->GetPhyAddrs == NULL) ||
+        (module->GetPhyAddrs(module, buf, phyAddrs) != 0) || (phyAddrs[0] == 0))
+        return OMX_ErrorUnsupportedSetting;
+
+    /*
+     * the FIMC writes the CbCr plane right after a width wide frame buffer.
+     * the MFC's own chroma buffer is used when the frame buffer reaches it
+     * exactly, the first aligned line after the picture otherwise.
+     */
+    if (((cOffset % width) == 0) && ((int)(cOffset / width) >= height)) {
+        fbHeight = cOffset / width;
+    } else {
+        for (fbHeight = height; ((width * fbHeight) % MFC_ENC_FRAME_ALIGN) != 0; fbHeight++)
+            ;
+        if ((width * fbHeight) + ((width * height) / 2) > pMFCBuffer->YSize + pMFCBuffer->CSize)
+            return OMX_ErrorUnsupportedSetting;
+    }
+
+    /* gralloc lines are HW_ALIGN pixels long */
+    src.fullWidth  = ALIGN(img->iWidth, HW_ALIGN);
+    src.fullHeight = img->iHeight;
+    src.width      = img->iWidth;
+    src.height     = img->iHeight;
+    src.phyAddr[0] = phyAddrs[0];
+    src.phyAddr[1] = 0;
+
+    dst.format     = V4L2_PIX_FMT_NV12;
+    dst.fullWidth  = width;
+    dst.fullHeight = fbHeight;
+    dst.width      = width;
+    dst.height     = height;
+    dst.phyAddr[0] = yPhyAddr;
+    dst.phyAddr[1] = 0;
+
+    if (SEC_FIMC_CscConvert(pCsc, &src, &dst) != OMX_ErrorNone)
+        return OMX_ErrorNotReady;
+
+    pInputInfo->YPhyAddr = (void *)yPhyAddr;
+    pInputInfo->CPhyAddr = (void *)(yPhyAddr + (width * fbHeight));
+
+    return OMX_ErrorNone;
+}
+#endif
+
+OMX_ERRORTYPE preprocessMetaDataInBuffers(OMX_HANDLETYPE hComponent, OMX_BYTE pInputDataBuffer, BUFFER_ADDRESS_INFO *pInputInfo,
+                                          SEC_FIMC_CSC *pCsc)
 {
     OMX_ERRORTYPE          ret = OMX_ErrorNone;
     OMX_COMPONENTTYPE     *pOMXComponent = NULL;
@@ -400,6 +539,34 @@ OMX_ERRORTYPE preprocessMetaDataInBuffers(OMX_HANDLETYPE hComponent, OMX_BYTE pI
     if (type == kMetadataBufferTypeCameraSource) {
         SEC_OSAL_Memcpy(&pInputInfo->YPhyAddr, pInputDataBuffer + 4, sizeof(void *));
         SEC_OSAL_Memcpy(&pInputInfo->CPhyAddr, pInputDataBuffer + 4 + sizeof(void *), sizeof(void *));
+
+        /* the frame may be shared with another encoder, which can't have
+         * it scaled: both have to be set up for the size the camera records.
+         * the front camera swaps width and height, so the area is compared */
+        if (pSECComponent->processData[INPUT_PORT_INDEX].dataLen >= 28) {
+            OMX_U32 frameWidth = 0;
+            OMX_U32 frameHeight = 0;
+
+            SEC_OSAL_Memcpy(&frameWidth, pInputDataBuffer + 20, sizeof(frameWidth));
+            SEC_OSAL_Memcpy(&frameHeight, pInputDataBuffer + 24, sizeof(frameHeight));
+            if ((frameWidth * frameHeight) !=
+                (pSECPort->portDefinition.format.video.nFrameWidth *
+                 pSECPort->portDefinition.format.video.nFrameHeight)) {
+                SEC_OSAL_Log(SEC_LOG_ERROR, "camera frame %dx%d, the encoder is set up for %dx%d",
+                             frameWidth, frameHeight,
+                             pSECPort->portDefinition.format.video.nFrameWidth,
+                             pSECPort->portDefinition.format.video.nFrameHeight);
+                ret = OMX_ErrorUnsupportedSetting;
+                goto EXIT;
+            }
+        }
+
+        /* a camera with the latency probe on puts the stamp behind the size */
+        if (pSECComponent->processData[INPUT_PORT_INDEX].dataLen >=
+            (SEC_LATENCY_METADATA_OFFSET + sizeof(struct sec_latency_stamp))) {
+            SEC_OMX_TraceCaptureIn(&pSECComponent->trace, pInputDataBuffer + SEC_LATENCY_METADATA_OFFSET,
+                                   pSECComponent->processData[INPUT_PORT_INDEX].timeStamp);
+        }
     } else if (type == kMetadataBufferTypeGrallocSource){
         IMG_gralloc_module_public_t *module = (IMG_gralloc_module_public_t *)pSECPort->pIMGGrallocModule;
         OMX_PTR pUnreadableBuffer = NULL;
@@ -426,6 +593,15 @@ OMX_ERRORTYPE preprocessMetaDataInBuffers(OMX_HANDLETYPE hComponent, OMX_BYTE pI
         /**************************************/
         buffer_handle_t buf = *((buffer_handle_t *) (pInputDataBuffer + 4));
         SEC_OSAL_Log(SEC_LOG_TRACE, "buffer handle %p)\n", buf);
+#ifdef USE_FIMC_CSC
+        if ((pCsc != NULL) &&
+            (fimcConvertGrallocSource(pCsc, module, buf, pSECPort,
+                                      &pSECComponent->processData[INPUT_PORT_INDEX].specificBufferHeader,
+                                      pInputInfo) == OMX_ErrorNone)) {
+            SEC_OSAL_Log(SEC_LOG_TRACE, "RGB to NV12 by FIMC");
+            goto EXIT;
+        }
+#endif
         err = module->Blit(module, buf, pVirAddrs, HAL_PIXEL_FORMAT_C110_NV12);
         if(err) {
             SEC_OSAL_Log(SEC_LOG_ERROR, "module->Blit() failed (err=%d)\n", err);
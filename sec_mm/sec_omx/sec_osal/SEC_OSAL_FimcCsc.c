@@ -0,0 +1,322 @@
+/*
+ *
+ * Copyright 2010 Samsung Electronics S.LSI Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * @file        SEC_OSAL_FimcCsc.c
+ * @brief       colour conversion of the codec frames on the FIMC
+ * @version     1.0
+ */
+
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/ioctl.h>
+
+#include "s5p_fimc.h"
+#include "SEC_OSAL_FimcCsc.h"
+#include "SEC_OSAL_Memory.h"
+#include "SEC_OSAL_Buffer.h"
+
+#undef  SEC_LOG_TAG
+#define SEC_LOG_TAG    "SEC_FIMC_CSC"
+#define SEC_LOG_OFF
+#include "SEC_OSAL_Log.h"
+
+
+static void SEC_FIMC_CscClose(SEC_FIMC_CSC *pCsc)
+{
+    if (pCsc->fd >= 0) {
+        sec_v4l2_gen_close(&pCsc->gen);
+        close(pCsc->fd);
+    }
+    pCsc->fd = -1;
+    pCsc->bConfigured = OMX_FALSE;
+}
+
+/* hands the device back to the overlay or the camera for a while */
+static void SEC_FIMC_CscBackOff(SEC_FIMC_CSC *pCsc)
+{
+    SEC_FIMC_CscClose(pCsc);
+    pCsc->nRetryFrames = SEC_FIMC_CSC_RETRY_FRAMES;
+}
+
+static OMX_BOOL SEC_FIMC_CscSameGeometry(SEC_FIMC_CSC_FRAME *pOld, SEC_FIMC_CSC_FRAME *pNew)
+{
+    if ((pOld->format != pNew->format) ||
+        (pOld->fullWidth != pNew->fullWidth) || (pOld->fullHeight != pNew->fullHeight) ||
+        (pOld->width != pNew->width) || (pOld->height != pNew->height))
+        return OMX_FALSE;
+    return OMX_TRUE;
+}
+
+static int SEC_FIMC_CscOpen(SEC_FIMC_CSC *pCsc)
+{
+    struct v4l2_capability cap;
+    struct v4l2_control    vc;
+
+    pCsc->fd = open(SEC_FIMC_CSC_DEV, O_RDWR);
+    if (pCsc->fd < 0) {
+        SEC_OSAL_Log(SEC_LOG_TRACE, "%s busy (%d)", SEC_FIMC_CSC_DEV, errno);
+        return -1;
+    }
+
+    if ((ioctl(pCsc->fd, VIDIOC_QUERYCAP, &cap) < 0) ||
+        !(cap.capabilities & V4L2_CAP_STREAMING) ||
+        !(cap.capabilities & V4L2_CAP_VIDEO_OUTPUT)) {
+        SEC_OSAL_Log(SEC_LOG_ERROR, "%s is no post processor", SEC_FIMC_CSC_DEV);
+        goto ERROR;
+    }
+
+    vc.id = V4L2_CID_FIMC_VERSION;
+    vc.value = 0;
+    if (ioctl(pCsc->fd, VIDIOC_G_CTRL, &vc) < 0)
+        goto ERROR;
+    pCsc->hwVer = vc.value;
+
+    sec_v4l2_gen_open(&pCsc->gen, pCsc->fd);
+    return 0;
+
+ERROR:
+    SEC_FIMC_CscClose(pCsc);
+    return -1;
+}
+
+/* the other users of the device may have left a transform behind */
+static int SEC_FIMC_CscClearTransform(SEC_FIMC_CSC *pCsc)
+{
+    struct v4l2_control vc;
+
+    vc.id = V4L2_CID_ROTATION;
+    vc.value = 0;
+    if (ioctl(pCsc->fd, VIDIOC_S_CTRL, &vc) < 0)
+        return -1;
+    vc.id = V4L2_CID_HFLIP;
+    if (ioctl(pCsc->fd, VIDIOC_S_CTRL, &vc) < 0)
+        return -1;
+    vc.id = V4L2_CID_VFLIP;
+    if (ioctl(pCsc->fd, VIDIOC_S_CTRL, &vc) < 0)
+        return -1;
+
+    return 0;
+}
+
+static int SEC_FIMC_CscSetSource(SEC_FIMC_CSC *pCsc, SEC_FIMC_CSC_FRAME *pSrc)
+{
+    struct v4l2_format fmt;
+    struct v4l2_crop   crop;
+
+    SEC_OSAL_Memset(&fmt, 0, sizeof(fmt));
+    fmt.type                = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+    fmt.fmt.pix.width       = pSrc->fullWidth;
+    fmt.fmt.pix.height      = pSrc->fullHeight;
+    fmt.fmt.pix.pixelformat = pSrc->format;
+    fmt.fmt.pix.field       = V4L2_FIELD_NONE;
+    if (ioctl(pCsc->fd, VIDIOC_S_FMT, &fmt) < 0) {
+        SEC_OSAL_Log(SEC_LOG_ERROR, "VIDIOC_S_FMT source %dx%d failed (%d)", pSrc->fullWidth, pSrc->fullHeight, errno);
+        return -1;
+    }
+
+    SEC_OSAL_Memset(&crop, 0, sizeof(crop));
+    crop.type     = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+    crop.c.width  = pSrc->width;
+    crop.c.height = pSrc->height;
+    if (ioctl(pCsc->fd, VIDIOC_S_CROP, &crop) < 0) {
+        SEC_OSAL_Log(SEC_LOG_ERROR, "VIDIOC_S_CROP %dx%d failed (%d)", pSrc->width, pSrc->height, errno);
+        return -1;
+    }
+
+    return 0;
+}
+
+/* the window goes after the frame buffer, the driver checks it against its size */
+static int SEC_FIMC_CscSetWindow(SEC_FIMC_CSC *pCsc, SEC_FIMC_CSC_FRAME *pDst)
+{
+    struct v4l2_format fmt;
+
+    SEC_OSAL_Memset(&fmt, 0, sizeof(fmt));
+    fmt.type             = V4L2_BUF_TYPE_VIDEO_OVERLAY;
+    fmt.fmt.win.w.width  = pDst->width;
+    fmt.fmt.win.w.height = pDst->height;
+    if (ioctl(pCsc->fd, VIDIOC_S_FMT, &fmt) < 0) {
+        SEC_OSAL_Log(SEC_LOG_ERROR, "VIDIOC_S_FMT window %dx%d failed (%d)", pDst->width, pDst->height, errno);
+        return -1;
+    }
+
+    return 0;
+}
+
+static int SEC_FIMC_CscOneShot(SEC_FIMC_CSC *pCsc, struct fimc_buf *pSrcBuf)
+{
+    struct v4l2_requestbuffers req;
+    struct v4l2_buffer         buf;
+    enum v4l2_buf_type         type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+    int                        ret = 0;
+
+    req.count  = 1;
+    req.type   = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+    req.memory = V4L2_MEMORY_USERPTR;
+    if (ioctl(pCsc->fd, VIDIOC_REQBUFS, &req) < 0)
+        return -1;
+
+    if (ioctl(pCsc->fd, VIDIOC_STREAMON, &type) < 0) {
+        ret = -1;
+        goto CLEAR_BUF;
+    }
+
+    SEC_OSAL_Memset(&buf, 0, sizeof(buf));
+    buf.type      = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+    buf.memory    = V4L2_MEMORY_USERPTR;
+    buf.m.userptr = (unsigned long)pSrcBuf;
+    buf.index     = 0;
+    if ((ioctl(pCsc->fd, VIDIOC_QBUF, &buf) < 0) ||
+        (ioctl(pCsc->fd, VIDIOC_DQBUF, &buf) < 0))
+        ret = -1;
+
+    if (ioctl(pCsc->fd, VIDIOC_STREAMOFF, &type) < 0)
+        ret = -1;
+
+CLEAR_BUF:
+    req.count = 0;
+    ioctl(pCsc->fd, VIDIOC_REQBUFS, &req);
+
+    return ret;
+}
+
+void SEC_FIMC_CscInit(SEC_FIMC_CSC *pCsc)
+{
+    SEC_OSAL_Memset(pCsc, 0, sizeof(SEC_FIMC_CSC));
+    pCsc->fd = -1;
+}
+
+void SEC_FIMC_CscDeinit(SEC_FIMC_CSC *pCsc)
+{
+    SEC_FIMC_CscClose(pCsc);
+    pCsc->nRetryFrames = 0;
+}
+
+OMX_ERRORTYPE SEC_FIMC_CscConvert(SEC_FIMC_CSC *pCsc, SEC_FIMC_CSC_FRAME *pSrc, SEC_FIMC_CSC_FRAME *pDst)
+{
+    struct v4l2_framebuffer fbuf;
+    struct fimc_buf         srcBuf;
+    OMX_BOOL                bNewGeometry = OMX_FALSE;
+
+    /* the post processor works on 8 pixel wide, even sized windows */
+    if ((pDst->width & 7) || (pDst->height & 1) || (pDst->width < 16) || (pDst->height < 8) ||
+        (pSrc->width < 16) || (pSrc->height < 8))
+        return OMX_ErrorUnsupportedSetting;
+
+    if (pCsc->nRetryFrames > 0) {
+        pCsc->nRetryFrames--;
+        return OMX_ErrorNotReady;
+    }
+
+    if ((pCsc->fd < 0) && (SEC_FIMC_CscOpen(pCsc) < 0)) {
+        pCsc->nRetryFrames = SEC_FIMC_CSC_RETRY_FRAMES;
+        return OMX_ErrorNotReady;
+    }
+
+    /* libfimc users lock the node per job, a display job there goes first */
+    if ((flock(pCsc->fd, LOCK_EX | LOCK_NB) < 0) && (errno == EWOULDBLOCK))
+        return OMX_ErrorNotReady;
+
+    /* whoever had it since the last frame left the driver set up their way */
+    if (sec_v4l2_gen_changed(&pCsc->gen))
+        pCsc->bConfigured = OMX_FALSE;
+
+    /* steady streams keep their geometry, only the addresses change */
+    if ((pCsc->bConfigured == OMX_FALSE) ||
+        (SEC_FIMC_CscSameGeometry(&pCsc->src, pSrc) == OMX_FALSE) ||
+        (SEC_FIMC_CscSameGeometry(&pCsc->dst, pDst) == OMX_FALSE)) {
+        bNewGeometry = OMX_TRUE;
+        /* anything failing below leaves the driver state unknown */
+        pCsc->bConfigured = OMX_FALSE;
+        sec_v4l2_gen_bump(&pCsc->gen);
+        if ((SEC_FIMC_CscClearTransform(pCsc) < 0) ||
+            (SEC_FIMC_CscSetSource(pCsc, pSrc) < 0))
+            goto ERROR;
+    }
+
+    /* the destination moves to another buffer every frame */
+    if (ioctl(pCsc->fd, VIDIOC_G_FBUF, &fbuf) < 0)
+        goto ERROR;
+    fbuf.base            = (void *)pDst->phyAddr[0];
+    fbuf.fmt.width       = pDst->fullWidth;
+    fbuf.fmt.height      = pDst->fullHeight;
+    fbuf.fmt.pixelformat = pDst->format;
+    if (ioctl(pCsc->fd, VIDIOC_S_FBUF, &fbuf) < 0)
+        goto ERROR;
+
+    if (bNewGeometry == OMX_TRUE) {
+        if (SEC_FIMC_CscSetWindow(pCsc, pDst) < 0)
+            goto ERROR;
+        pCsc->src = *pSrc;
+        pCsc->dst = *pDst;
+        pCsc->bConfigured = OMX_TRUE;
+    }
+
+    SEC_OSAL_Memset(&srcBuf, 0, sizeof(srcBuf));
+    srcBuf.base[0] = (dma_addr_t)pSrc->phyAddr[0];
+    srcBuf.base[1] = (dma_addr_t)pSrc->phyAddr[1];
+    if (SEC_FIMC_CscOneShot(pCsc, &srcBuf) < 0)
+        goto ERROR;
+
+    flock(pCsc->fd, LOCK_UN);
+    return OMX_ErrorNone;
+
+ERROR:
+    SEC_OSAL_Log(SEC_LOG_WARNING, "FIMC conversion failed (%d), back to the fallback", errno);
+    /* closing the node drops the lock */
+    SEC_FIMC_CscBackOff(pCsc);
+    return OMX_ErrorHardware;
+}
+
+OMX_ERRORTYPE SEC_FIMC_CscTiledToANB(SEC_FIMC_CSC *pCsc, void *pYPhyAddr, void *pCPhyAddr,
+                                     int bufWidth, int bufHeight,
+                                     OMX_PTR pANB, int width, int height)
+{
+    SEC_FIMC_CSC_FRAME src, dst;
+    unsigned int       phyAddrs[3] = {0, 0, 0};
+
+    if (getPADDRfromANB(pANB, phyAddrs) != 0)
+        return OMX_ErrorUnsupportedSetting;
+
+    /* the FIMC puts the CbCr plane right after the Y plane */
+    if ((phyAddrs[0] == 0) ||
+        ((phyAddrs[1] != 0) && (phyAddrs[1] != phyAddrs[0] + (width * height))))
+        return OMX_ErrorUnsupportedSetting;
+
+    src.format     = V4L2_PIX_FMT_NV12T;
+    src.fullWidth  = bufWidth;
+    src.fullHeight = bufHeight;
+    src.width      = width;
+    src.height     = height;
+    src.phyAddr[0] = (unsigned int)pYPhyAddr;
+    src.phyAddr[1] = (unsigned int)pCPhyAddr;
+
+    dst.format     = V4L2_PIX_FMT_NV12;
+    dst.fullWidth  = width;
+    dst.fullHeight = height;
+    dst.width      = width;
+    dst.height     = height;
+    dst.phyAddr[0] = phyAddrs[0];
+    dst.phyAddr[1] = 0;
+
+    return SEC_FIMC_CscConvert(pCsc, &src, &dst);
+}
@@ -0,0 +1,85 @@
+/*
+ *
+ * Copyright 2010 Samsung Electronics S.LSI Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * @file        SEC_OSAL_FimcCsc.h
+ * @brief       colour conversion of the codec frames on the FIMC
+ * @version     1.0
+ */
+
+#ifndef SEC_OSAL_FIMC_CSC
+#define SEC_OSAL_FIMC_CSC
+
+#include <sec_v4l2.h>
+
+#include "OMX_Types.h"
+#include "OMX_Core.h"
+
+/* the post processor the codecs borrow, the overlay keeps /dev/video1 */
+#define SEC_FIMC_CSC_DEV            "/dev/video2"
+/* frames converted on the CPU or GPU before a busy or failing FIMC is tried again */
+#define SEC_FIMC_CSC_RETRY_FRAMES   30
+
+typedef struct _SEC_FIMC_CSC_FRAME
+{
+    unsigned int format;        // V4L2_PIX_FMT_*
+    /* the whole buffer: the source is cropped from it, the destination window sits in it */
+    int          fullWidth;
+    int          fullHeight;
+    int          width;
+    int          height;
+    /* a destination CbCr plane follows its Y plane, only phyAddr[0] is used */
+    unsigned int phyAddr[2];
+} SEC_FIMC_CSC_FRAME;
+
+typedef struct _SEC_FIMC_CSC
+{
+    int                fd;
+    unsigned int       hwVer;
+    int                nRetryFrames;
+    /* the geometry the driver was last set up for, addresses left out */
+    OMX_BOOL           bConfigured;
+    SEC_FIMC_CSC_FRAME src;
+    SEC_FIMC_CSC_FRAME dst;
+    /* the tvout and the camera recording program the device too */
+    struct sec_v4l2_gen gen;
+} SEC_FIMC_CSC;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void SEC_FIMC_CscInit(SEC_FIMC_CSC *pCsc);
+void SEC_FIMC_CscDeinit(SEC_FIMC_CSC *pCsc);
+
+/*
+ * Converts and scales the source crop into the destination window, both
+ * physically contiguous. Anything but OMX_ErrorNone leaves the frame to
+ * the caller's own conversion.
+ */
+OMX_ERRORTYPE SEC_FIMC_CscConvert(SEC_FIMC_CSC *pCsc, SEC_FIMC_CSC_FRAME *pSrc, SEC_FIMC_CSC_FRAME *pDst);
+
+/* the width x height top left of a decoded NV12T picture into an NV12 Android native buffer */
+OMX_ERRORTYPE SEC_FIMC_CscTiledToANB(SEC_FIMC_CSC *pCsc, void *pYPhyAddr, void *pCPhyAddr,
+                                     int bufWidth, int bufHeight,
+                                     OMX_PTR pANB, int width, int height);
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif
@@ -24,10 +24,30 @@
  *   2010.7.15 : Create
  */
 
+#include <stdlib.h>
 #include <utils/Log.h>
+#include <cutils/properties.h>
 
 #include "SEC_OSAL_Log.h"
 
+/* -1 until the property is read, racing readers read the same value */
+int gSEC_OSAL_LogLevel = -1;
+
+int _SEC_OSAL_LogLevelInit(void)
+{
+    char value[PROPERTY_VALUE_MAX];
+    int  level;
+
+    property_get(SEC_LOG_LEVEL_PROPERTY, value, "1");
+    level = atoi(value);
+    if (level < SEC_LOG_TRACE)
+        level = SEC_LOG_TRACE;
+    if (level > SEC_LOG_ERROR)
+        level = SEC_LOG_ERROR;
+    gSEC_OSAL_LogLevel = level;
+
+    return level;
+}
 
 void _SEC_OSAL_Log(SEC_LOG_LEVEL logLevel, const char *tag, const char *msg, ...)
 {
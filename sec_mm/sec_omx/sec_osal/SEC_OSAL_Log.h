@@ -23,6 +23,8 @@
  * @history
  *   2010.7.15 : Create
  *   2010.8.27 : Add trace function
+ *   trace calls compile to nothing unless SEC_LOG_TRACE_ON, the rest
+ *   is checked against SEC_LOG_LEVEL_PROPERTY, read once
  */
 
 #ifndef SEC_OSAL_LOG
@@ -51,22 +53,36 @@ typedef enum _LOG_LEVEL
     SEC_LOG_ERROR
 } SEC_LOG_LEVEL;
 
-#ifdef SEC_LOG
-#define SEC_OSAL_Log(a, ...)    ((void)_SEC_OSAL_Log(a, SEC_LOG_TAG, __VA_ARGS__))
+/* 0 trace, 1 warning, 2 error, read on the first message */
+#define SEC_LOG_LEVEL_PROPERTY  "debug.sec.omx.loglevel"
+
+/* the lowest level a file compiles in, a constant so the rest goes away */
+#if defined(SEC_LOG) && defined(SEC_LOG_TRACE_ON)
+#define SEC_LOG_MIN_LEVEL       SEC_LOG_TRACE
+#elif defined(SEC_LOG)
+#define SEC_LOG_MIN_LEVEL       SEC_LOG_WARNING
 #else
-#define SEC_OSAL_Log(a, ...)                                                \
+#define SEC_LOG_MIN_LEVEL       SEC_LOG_ERROR
+#endif
+
+extern int gSEC_OSAL_LogLevel;
+extern int _SEC_OSAL_LogLevelInit(void);
+
+#define SEC_OSAL_LogLevel()     ((gSEC_OSAL_LogLevel >= 0) ? gSEC_OSAL_LogLevel : _SEC_OSAL_LogLevelInit())
+
+/* the arguments are only evaluated once the level is let through */
+#define SEC_OSAL_Log(a, ...)                                            \
     do {                                                                \
-        if (a == SEC_LOG_ERROR)                                     \
-            ((void)_SEC_OSAL_Log(a, SEC_LOG_TAG, __VA_ARGS__)); \
+        if (((a) >= SEC_LOG_MIN_LEVEL) && ((int)(a) >= SEC_OSAL_LogLevel())) \
+            _SEC_OSAL_Log(a, SEC_LOG_TAG, __VA_ARGS__);                 \
     } while (0)
-#endif
 
-#ifdef SEC_TRACE
-#define FunctionIn() _SEC_OSAL_Log(SEC_LOG_TRACE, SEC_LOG_TAG, "%s In , Line: %d", __FUNCTION__, __LINE__)
-#define FunctionOut() _SEC_OSAL_Log(SEC_LOG_TRACE, SEC_LOG_TAG, "%s Out , Line: %d", __FUNCTION__, __LINE__)
+#if defined(SEC_TRACE) && defined(SEC_LOG_TRACE_ON)
+#define FunctionIn()    SEC_OSAL_Log(SEC_LOG_TRACE, "%s In , Line: %d", __FUNCTION__, __LINE__)
+#define FunctionOut()   SEC_OSAL_Log(SEC_LOG_TRACE, "%s Out , Line: %d", __FUNCTION__, __LINE__)
 #else
-#define FunctionIn() ((void *)0)
-#define FunctionOut() ((void *)0)
+#define FunctionIn()    ((void *)0)
+#define FunctionOut()   ((void *)0)
 #endif
 
 extern void _SEC_OSAL_Log(SEC_LOG_LEVEL logLevel, const char *tag, const char *msg, ...);
@@ -29,6 +29,7 @@
 #include <string.h>
 
 #include "SEC_OSAL_Memory.h"
+#include "SEC_OSAL_Mutex.h"
 
 #define SEC_LOG_OFF
 #include "SEC_OSAL_Log.h"
@@ -69,3 +70,94 @@ OMX_PTR SEC_OSAL_Memmove(OMX_PTR dest, OMX_PTR src, OMX_S32 n)
 {
     return memmove(dest, src, n);
 }
+
+OMX_ERRORTYPE SEC_OSAL_PoolCreate(SEC_OSAL_POOL *pPool, OMX_U32 objSize, OMX_U32 objNum)
+{
+    OMX_ERRORTYPE ret = OMX_ErrorNone;
+    OMX_U32       i = 0;
+
+    if ((pPool == NULL) || (objSize == 0) || (objNum == 0))
+        return OMX_ErrorBadParameter;
+
+    memset(pPool, 0, sizeof(SEC_OSAL_POOL));
+    /* every object holds the free list link and keeps the block aligned */
+    pPool->objSize = (objSize < sizeof(OMX_PTR)) ? ((sizeof(OMX_PTR) + 7) & (~7)) : ((objSize + 7) & (~7));
+    pPool->objNum = objNum;
+
+    ret = SEC_OSAL_MutexCreate(&pPool->hMutex);
+    if (ret != OMX_ErrorNone)
+        return ret;
+
+    pPool->pBlock = (OMX_U8 *)SEC_OSAL_Malloc(pPool->objSize * pPool->objNum);
+    if (pPool->pBlock == NULL) {
+        SEC_OSAL_MutexTerminate(pPool->hMutex);
+        pPool->hMutex = NULL;
+        return OMX_ErrorInsufficientResources;
+    }
+
+    for (i = 0; i < pPool->objNum; i++) {
+        OMX_PTR *pObj = (OMX_PTR *)(pPool->pBlock + (pPool->objSize * i));
+
+        *pObj = pPool->pFree;
+        pPool->pFree = pObj;
+    }
+
+    return OMX_ErrorNone;
+}
+
+/* the objects still out are gone with the block, heap ones are the owner's to free */
+void SEC_OSAL_PoolTerminate(SEC_OSAL_POOL *pPool)
+{
+    if ((pPool == NULL) || (pPool->pBlock == NULL))
+        return;
+
+    if (pPool->nHeapObj > 0)
+        SEC_OSAL_Log(SEC_LOG_TRACE, "pool of %d byte objects overflowed %d times", pPool->objSize, pPool->nHeapObj);
+
+    SEC_OSAL_Free(pPool->pBlock);
+    SEC_OSAL_MutexTerminate(pPool->hMutex);
+    memset(pPool, 0, sizeof(SEC_OSAL_POOL));
+}
+
+OMX_PTR SEC_OSAL_PoolAlloc(SEC_OSAL_POOL *pPool)
+{
+    OMX_PTR *pObj = NULL;
+
+    if (pPool == NULL)
+        return NULL;
+    if (pPool->pBlock == NULL)
+        return SEC_OSAL_Malloc(pPool->objSize);
+
+    SEC_OSAL_MutexLock(pPool->hMutex);
+    pObj = (OMX_PTR *)pPool->pFree;
+    if (pObj != NULL) {
+        pPool->pFree = *pObj;
+    } else {
+        pPool->nHeapObj++;
+    }
+    SEC_OSAL_MutexUnlock(pPool->hMutex);
+
+    if (pObj == NULL)
+        pObj = (OMX_PTR *)SEC_OSAL_Malloc(pPool->objSize);
+
+    return (OMX_PTR)pObj;
+}
+
+void SEC_OSAL_PoolFree(SEC_OSAL_POOL *pPool, OMX_PTR addr)
+{
+    OMX_PTR *pObj = (OMX_PTR *)addr;
+
+    if ((pPool == NULL) || (addr == NULL))
+        return;
+
+    if ((pPool->pBlock == NULL) || ((OMX_U8 *)addr < pPool->pBlock) ||
+        ((OMX_U8 *)addr >= pPool->pBlock + (pPool->objSize * pPool->objNum))) {
+        SEC_OSAL_Free(addr);
+        return;
+    }
+
+    SEC_OSAL_MutexLock(pPool->hMutex);
+    *pObj = pPool->pFree;
+    pPool->pFree = pObj;
+    SEC_OSAL_MutexUnlock(pPool->hMutex);
+}
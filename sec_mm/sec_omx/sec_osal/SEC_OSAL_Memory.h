@@ -28,7 +28,22 @@
 #define SEC_OSAL_MEMORY
 
 #include "OMX_Types.h"
+#include "OMX_Core.h"
 
+/*
+ * fixed size objects carved out of one block, for the ones allocated and
+ * freed over and over while a component lives. an empty pool hands out
+ * heap objects instead, SEC_OSAL_PoolFree tells them apart.
+ */
+typedef struct _SEC_OSAL_POOL
+{
+    OMX_U8        *pBlock;
+    OMX_U32        objSize;
+    OMX_U32        objNum;
+    OMX_PTR        pFree;      // free objects, linked through their first word
+    OMX_U32        nHeapObj;   // objects the block had no room for
+    OMX_HANDLETYPE hMutex;
+} SEC_OSAL_POOL;
 
 #ifdef __cplusplus
 extern "C" {
@@ -39,6 +54,11 @@ void    SEC_OSAL_Free(OMX_PTR addr);
 OMX_PTR SEC_OSAL_Memset(OMX_PTR dest, OMX_S32 c, OMX_S32 n);
 OMX_PTR SEC_OSAL_Memcpy(OMX_PTR dest, OMX_PTR src, OMX_S32 n);
 
+OMX_ERRORTYPE SEC_OSAL_PoolCreate(SEC_OSAL_POOL *pPool, OMX_U32 objSize, OMX_U32 objNum);
+void          SEC_OSAL_PoolTerminate(SEC_OSAL_POOL *pPool);
+OMX_PTR       SEC_OSAL_PoolAlloc(SEC_OSAL_POOL *pPool);
+void          SEC_OSAL_PoolFree(SEC_OSAL_POOL *pPool, OMX_PTR addr);
+
 #ifdef __cplusplus
 }
 #endif
@@ -29,6 +29,8 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <cutils/atomic.h>
+
 #include "SEC_OSAL_Memory.h"
 #include "SEC_OSAL_Mutex.h"
 #include "SEC_OSAL_Queue.h"
@@ -37,8 +39,6 @@
 OMX_ERRORTYPE SEC_OSAL_QueueCreate(SEC_QUEUE *queueHandle)
 {
     int i = 0;
-    SEC_QElem *newqelem = NULL;
-    SEC_QElem *currentqelem = NULL;
     SEC_QUEUE *queue = (SEC_QUEUE *)queueHandle;
 
     OMX_ERRORTYPE ret = OMX_ErrorNone;
@@ -50,55 +50,35 @@ OMX_ERRORTYPE SEC_OSAL_QueueCreate(SEC_QUEUE *queueHandle)
     if (ret != OMX_ErrorNone)
         return ret;
 
-    queue->first = (SEC_QElem *)SEC_OSAL_Malloc(sizeof(SEC_QElem));
-    if (queue->first == NULL)
+    queue->elements = (SEC_QElem *)SEC_OSAL_Malloc(sizeof(SEC_QElem) * (MAX_QUEUE_ELEMENTS - 1));
+    if (queue->elements == NULL) {
+        SEC_OSAL_MutexTerminate(queue->qMutex);
+        queue->qMutex = NULL;
         return OMX_ErrorInsufficientResources;
-
-    SEC_OSAL_Memset(queue->first, 0, sizeof(SEC_QElem));
-    currentqelem = queue->last = queue->first;
-    queue->numElem = 0;
-
-    for (i = 0; i < (MAX_QUEUE_ELEMENTS - 2); i++) {
-        newqelem = (SEC_QElem *)SEC_OSAL_Malloc(sizeof(SEC_QElem));
-        if (newqelem == NULL) {
-            while (queue->first != NULL) {
-                currentqelem = queue->first->qNext;
-                SEC_OSAL_Free((OMX_PTR)queue->first);
-                queue->first = currentqelem;
-            }
-            return OMX_ErrorInsufficientResources;
-        } else {
-            SEC_OSAL_Memset(newqelem, 0, sizeof(SEC_QElem));
-            currentqelem->qNext = newqelem;
-            currentqelem = newqelem;
-        }
     }
 
-    currentqelem->qNext = queue->first;
+    SEC_OSAL_Memset(queue->elements, 0, sizeof(SEC_QElem) * (MAX_QUEUE_ELEMENTS - 1));
+    for (i = 0; i < (MAX_QUEUE_ELEMENTS - 2); i++)
+        queue->elements[i].qNext = &queue->elements[i + 1];
+    queue->elements[MAX_QUEUE_ELEMENTS - 2].qNext = &queue->elements[0];
+
+    queue->first = queue->last = &queue->elements[0];
+    queue->numElem = 0;
 
     return OMX_ErrorNone;
 }
 
 OMX_ERRORTYPE SEC_OSAL_QueueTerminate(SEC_QUEUE *queueHandle)
 {
-    int i = 0;
-    SEC_QElem *currentqelem = NULL;
     SEC_QUEUE *queue = (SEC_QUEUE *)queueHandle;
     OMX_ERRORTYPE ret = OMX_ErrorNone;
 
     if (!queue)
         return OMX_ErrorBadParameter;
 
-    for ( i = 0; i < (MAX_QUEUE_ELEMENTS - 2); i++) {
-        currentqelem = queue->first->qNext;
-        SEC_OSAL_Free(queue->first);
-        queue->first = currentqelem;
-    }
-
-    if(queue->first) {
-        SEC_OSAL_Free(queue->first);
-        queue->first = NULL;
-    }
+    SEC_OSAL_Free(queue->elements);
+    queue->elements = NULL;
+    queue->first = queue->last = NULL;
 
     ret = SEC_OSAL_MutexTerminate(queue->qMutex);
 
@@ -147,6 +127,20 @@ void *SEC_OSAL_Dequeue(SEC_QUEUE *queueHandle)
     return data;
 }
 
+void *SEC_OSAL_QueuePeek(SEC_QUEUE *queueHandle)
+{
+    void *data = NULL;
+    SEC_QUEUE *queue = (SEC_QUEUE *)queueHandle;
+    if (queue == NULL)
+        return NULL;
+
+    SEC_OSAL_MutexLock(queue->qMutex);
+    if (queue->numElem > 0)
+        data = queue->first->data;
+    SEC_OSAL_MutexUnlock(queue->qMutex);
+    return data;
+}
+
 int SEC_OSAL_GetElemNum(SEC_QUEUE *queueHandle)
 {
     int ElemNum = 0;
@@ -172,3 +166,68 @@ int SEC_OSAL_SetElemNum(SEC_QUEUE *queueHandle, int ElemNum)
     return ElemNum;
 }
 
+OMX_ERRORTYPE SEC_OSAL_RingCreate(SEC_RING *ring)
+{
+    if (ring == NULL)
+        return OMX_ErrorBadParameter;
+
+    SEC_OSAL_Memset(ring, 0, sizeof(SEC_RING));
+    return OMX_ErrorNone;
+}
+
+OMX_ERRORTYPE SEC_OSAL_RingTerminate(SEC_RING *ring)
+{
+    if (ring == NULL)
+        return OMX_ErrorBadParameter;
+
+    ring->head = ring->tail = 0;
+    return OMX_ErrorNone;
+}
+
+/* producer side */
+int SEC_OSAL_RingPut(SEC_RING *ring, void *data)
+{
+    int32_t tail, head;
+
+    if (ring == NULL)
+        return -1;
+
+    tail = ring->tail;
+    head = android_atomic_acquire_load(&ring->head);
+    if ((uint32_t)(tail - head) >= SEC_RING_SIZE)
+        return -1;
+
+    ring->data[tail & (SEC_RING_SIZE - 1)] = data;
+    /* the slot is written before the consumer can see it */
+    android_atomic_release_store(tail + 1, &ring->tail);
+    return 0;
+}
+
+/* consumer side */
+void *SEC_OSAL_RingGet(SEC_RING *ring)
+{
+    int32_t head, tail;
+    void *data = NULL;
+
+    if (ring == NULL)
+        return NULL;
+
+    head = ring->head;
+    tail = android_atomic_acquire_load(&ring->tail);
+    if (head == tail)
+        return NULL;
+
+    data = ring->data[head & (SEC_RING_SIZE - 1)];
+    /* the slot is read before the producer can reuse it */
+    android_atomic_release_store(head + 1, &ring->head);
+    return data;
+}
+
+int SEC_OSAL_RingGetElemNum(SEC_RING *ring)
+{
+    if (ring == NULL)
+        return -1;
+
+    return (int)(uint32_t)(android_atomic_acquire_load(&ring->tail) -
+                           android_atomic_acquire_load(&ring->head));
+}
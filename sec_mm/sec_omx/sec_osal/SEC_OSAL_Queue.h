@@ -27,12 +27,18 @@
 #ifndef SEC_OSAL_QUEUE
 #define SEC_OSAL_QUEUE
 
+#include <stdint.h>
+
 #include "OMX_Types.h"
 #include "OMX_Core.h"
 
 
 #define MAX_QUEUE_ELEMENTS    10
 
+/* slots of a SEC_RING, a power of two that holds MAX_BUFFER_NUM of a port */
+#define SEC_RING_SIZE         32
+#define SEC_CACHE_LINE        64
+
 typedef struct _SEC_QElem
 {
     void              *data;
@@ -45,8 +51,23 @@ typedef struct _SEC_QUEUE
     SEC_QElem     *last;
     int            numElem;
     OMX_HANDLETYPE qMutex;
+    SEC_QElem     *elements;  // one block for the whole ring
 } SEC_QUEUE;
 
+/*
+ * single producer, single consumer ring without a lock. the producer only
+ * writes tail, the consumer only writes head, each on its own cache line.
+ * callers that need to block pair it with a semaphore, like the ports do.
+ */
+typedef struct _SEC_RING
+{
+    volatile int32_t head;
+    char             headPad[SEC_CACHE_LINE - sizeof(int32_t)];
+    volatile int32_t tail;
+    char             tailPad[SEC_CACHE_LINE - sizeof(int32_t)];
+    void            *data[SEC_RING_SIZE];
+} SEC_RING;
+
 
 #ifdef __cplusplus
 extern "C" {
@@ -56,9 +77,17 @@ OMX_ERRORTYPE SEC_OSAL_QueueCreate(SEC_QUEUE *queueHandle);
 OMX_ERRORTYPE SEC_OSAL_QueueTerminate(SEC_QUEUE *queueHandle);
 int           SEC_OSAL_Queue(SEC_QUEUE *queueHandle, void *data);
 void         *SEC_OSAL_Dequeue(SEC_QUEUE *queueHandle);
+/* the element the next Dequeue returns, left in the queue */
+void         *SEC_OSAL_QueuePeek(SEC_QUEUE *queueHandle);
 int           SEC_OSAL_GetElemNum(SEC_QUEUE *queueHandle);
 int           SEC_OSAL_SetElemNum(SEC_QUEUE *queueHandle, int ElemNum);
 
+OMX_ERRORTYPE SEC_OSAL_RingCreate(SEC_RING *ring);
+OMX_ERRORTYPE SEC_OSAL_RingTerminate(SEC_RING *ring);
+int           SEC_OSAL_RingPut(SEC_RING *ring, void *data);
+void         *SEC_OSAL_RingGet(SEC_RING *ring);
+int           SEC_OSAL_RingGetElemNum(SEC_RING *ring);
+
 #ifdef __cplusplus
 }
 #endif
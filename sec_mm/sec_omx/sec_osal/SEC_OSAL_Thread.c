@@ -31,6 +31,8 @@
 #include <semaphore.h>
 #include <errno.h>
 
+#include <sec_thread.h>
+
 #include "SEC_OSAL_Memory.h"
 #include "SEC_OSAL_Thread.h"
 
@@ -46,10 +48,40 @@ typedef struct _SEC_THREAD_HANDLE_TYPE
     pthread_attr_t     attr;
     struct sched_param schedparam;
     int                stack_size;
+    void            *(*function)(void *);
+    void              *argument;
+    SEC_OSAL_THREAD_ROLE role;
 } SEC_THREAD_HANDLE_TYPE;
 
 
+/* the role has to be taken by the thread itself, nice and cgroup are per thread */
+static void *SEC_OSAL_ThreadStart(void *data)
+{
+    SEC_THREAD_HANDLE_TYPE *thread = (SEC_THREAD_HANDLE_TYPE *)data;
+    int err = 0;
+
+    switch (thread->role) {
+    case SEC_OSAL_THREAD_ROLE_VIDEO:
+        err = sec_thread_set_role(SEC_THREAD_ROLE_VIDEO);
+        break;
+    case SEC_OSAL_THREAD_ROLE_BACKGROUND:
+        err = sec_thread_set_role(SEC_THREAD_ROLE_BACKGROUND);
+        break;
+    default:
+        break;
+    }
+    if (err != 0)
+        SEC_OSAL_Log(SEC_LOG_ERROR, "thread role %d not fully applied: %d", thread->role, err);
+
+    return thread->function(thread->argument);
+}
+
 OMX_ERRORTYPE SEC_OSAL_ThreadCreate(OMX_HANDLETYPE *threadHandle, OMX_PTR function_name, OMX_PTR argument)
+{
+    return SEC_OSAL_ThreadCreateRole(threadHandle, function_name, argument, SEC_OSAL_THREAD_ROLE_DEFAULT);
+}
+
+OMX_ERRORTYPE SEC_OSAL_ThreadCreateRole(OMX_HANDLETYPE *threadHandle, OMX_PTR function_name, OMX_PTR argument, SEC_OSAL_THREAD_ROLE role)
 {
     FunctionIn();
 
@@ -59,7 +91,15 @@ OMX_ERRORTYPE SEC_OSAL_ThreadCreate(OMX_HANDLETYPE *threadHandle, OMX_PTR functi
     OMX_ERRORTYPE ret = OMX_ErrorNone;
 
     thread = SEC_OSAL_Malloc(sizeof(SEC_THREAD_HANDLE_TYPE));
+    if (thread == NULL) {
+        *threadHandle = NULL;
+        ret = OMX_ErrorInsufficientResources;
+        goto EXIT;
+    }
     SEC_OSAL_Memset(thread, 0, sizeof(SEC_THREAD_HANDLE_TYPE));
+    thread->function = (void *(*)(void *))function_name;
+    thread->argument = (void *)argument;
+    thread->role = role;
 
     pthread_attr_init(&thread->attr);
     if (thread->stack_size != 0)
@@ -75,8 +115,7 @@ OMX_ERRORTYPE SEC_OSAL_ThreadCreate(OMX_HANDLETYPE *threadHandle, OMX_PTR functi
         goto EXIT;
     }
 
-    result = pthread_create(&thread->pthread, &thread->attr, function_name, (void *)argument);
-    /* pthread_setschedparam(thread->pthread, SCHED_RR, &thread->schedparam); */
+    result = pthread_create(&thread->pthread, &thread->attr, SEC_OSAL_ThreadStart, (void *)thread);
 
     switch (result) {
     case 0:
@@ -85,10 +124,12 @@ OMX_ERRORTYPE SEC_OSAL_ThreadCreate(OMX_HANDLETYPE *threadHandle, OMX_PTR functi
         break;
     case EAGAIN:
         *threadHandle = NULL;
+        SEC_OSAL_Free(thread);
         ret = OMX_ErrorInsufficientResources;
         break;
     default:
         *threadHandle = NULL;
+        SEC_OSAL_Free(thread);
         ret = OMX_ErrorUndefined;
         break;
     }
@@ -35,7 +35,16 @@
 extern "C" {
 #endif
 
+/* what the thread works for, it picks the nice level and cgroup */
+typedef enum _SEC_OSAL_THREAD_ROLE
+{
+    SEC_OSAL_THREAD_ROLE_DEFAULT = 0,   /* whatever the creator runs at */
+    SEC_OSAL_THREAD_ROLE_VIDEO,         /* decode, encode and the buffers between */
+    SEC_OSAL_THREAD_ROLE_BACKGROUND
+} SEC_OSAL_THREAD_ROLE;
+
 OMX_ERRORTYPE SEC_OSAL_ThreadCreate(OMX_HANDLETYPE *threadHandle, OMX_PTR function_name, OMX_PTR argument);
+OMX_ERRORTYPE SEC_OSAL_ThreadCreateRole(OMX_HANDLETYPE *threadHandle, OMX_PTR function_name, OMX_PTR argument, SEC_OSAL_THREAD_ROLE role);
 OMX_ERRORTYPE SEC_OSAL_ThreadTerminate(OMX_HANDLETYPE threadHandle);
 OMX_ERRORTYPE SEC_OSAL_ThreadCancel(OMX_HANDLETYPE threadHandle);
 void          SEC_OSAL_ThreadExit(void *value_ptr);